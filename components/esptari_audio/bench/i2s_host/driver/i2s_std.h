@@ -0,0 +1,67 @@
+/**
+ * @file i2s_std.h
+ * @brief I2S TX channel stand-in: a timed DMA list played into a file
+ *
+ * Models what the sink relies on in the IDF driver: a circular list of
+ * dma_desc_num descriptors of dma_frame_num frames, played one descriptor
+ * period after another on CLOCK_MONOTONIC. A finished descriptor raises
+ * on_sent, is cleared (auto_clear) and goes to a free queue one shorter
+ * than the list; when that queue is already full the oldest entry is
+ * dropped and on_send_q_ovf raised, as the driver does. Writes fill the
+ * oldest free descriptor; a preload fills the list in order before the
+ * channel is enabled.
+ *
+ * Host-only additions are prefixed host_i2s_. Played frames go to an
+ * optional raw 16-bit stereo file, and the channel counts descriptors
+ * that came round without having been written since their last turn,
+ * which is what the sink's underrun count should match.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct i2s_channel_obj_t *i2s_chan_handle_t;
+
+typedef struct {
+    void *data;
+    size_t size;
+} i2s_event_data_t;
+
+typedef bool (*i2s_isr_callback_t)(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
+
+typedef struct {
+    i2s_isr_callback_t on_recv;
+    i2s_isr_callback_t on_recv_q_ovf;
+    i2s_isr_callback_t on_sent;
+    i2s_isr_callback_t on_send_q_ovf;
+} i2s_event_callbacks_t;
+
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t handle,
+                                              const i2s_event_callbacks_t *callbacks, void *user_data);
+esp_err_t i2s_channel_preload_data(i2s_chan_handle_t tx_handle, const void *src, size_t size,
+                                   size_t *bytes_loaded);
+esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void *src, size_t size,
+                            size_t *bytes_written, uint32_t timeout_ms);
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle);
+esp_err_t i2s_channel_disable(i2s_chan_handle_t handle);
+
+typedef struct {
+    uint32_t played;                ///< Descriptors the DMA finished
+    uint32_t stale;                 ///< Of those, not written since their last turn
+} host_i2s_stats_t;
+
+/**
+ * @brief 16-bit stereo TX channel, standard mode set up, not enabled
+ *
+ * @param out Raw output, or NULL
+ */
+esp_err_t host_i2s_new_tx(uint32_t sample_rate, uint32_t desc_num, uint32_t frame_num, FILE *out,
+                          i2s_chan_handle_t *handle);
+void host_i2s_del(i2s_chan_handle_t handle);
+void host_i2s_get_stats(i2s_chan_handle_t handle, host_i2s_stats_t *stats);
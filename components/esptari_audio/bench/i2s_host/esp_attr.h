@@ -0,0 +1,8 @@
+/**
+ * @file esp_attr.h
+ * @brief Placement attributes, meaningless on a host
+ */
+
+#pragma once
+
+#define IRAM_ATTR
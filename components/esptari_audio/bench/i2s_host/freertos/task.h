@@ -0,0 +1,132 @@
+/**
+ * @file task.h
+ * @brief Tasks as detached pthreads, with direct-to-task notifications
+ *
+ * Priorities, stack sizes and cores are ignored. vTaskDelete() only deletes
+ * the calling task. Its record is poisoned rather than freed, and a
+ * notification given to a deleted task aborts: on FreeRTOS the handle
+ * would point at a freed TCB. A task finds its own record through a
+ * thread-local set in the translation unit that created it, which is the
+ * one that takes its notifications.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+
+#define HOST_TASK_LIVE      0x7A5C11FEu
+#define HOST_TASK_DELETED   0xDEADDEADu
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct host_task {
+    uint32_t magic;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notified;
+} host_task_t;
+
+typedef host_task_t *TaskHandle_t;
+
+static __thread host_task_t *host_current_task;
+
+static inline void *host_task_main(void *arg)
+{
+    host_task_t *task = arg;
+
+    host_current_task = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                                 uint32_t stack_size, void *arg,
+                                                 UBaseType_t priority, TaskHandle_t *handle,
+                                                 int core)
+{
+    pthread_t thread;
+    host_task_t *task = calloc(1, sizeof(*task));
+
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    (void)core;
+    if (!task) {
+        return pdFAIL;
+    }
+    task->magic = HOST_TASK_LIVE;
+    task->fn = fn;
+    task->arg = arg;
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->cond);
+    if (handle) {
+        *handle = task;
+    }
+    if (pthread_create(&thread, NULL, host_task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    return pdPASS;
+}
+
+static inline void host_task_delete(void)
+{
+    host_task_t *task = host_current_task;
+
+    pthread_mutex_lock(&task->lock);
+    task->magic = HOST_TASK_DELETED;
+    pthread_mutex_unlock(&task->lock);
+    pthread_exit(NULL);
+}
+
+#define vTaskDelete(task)   host_task_delete()
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000u);
+}
+
+static inline void xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    if (task->magic != HOST_TASK_LIVE) {
+        fprintf(stderr, "xTaskNotifyGive: task %p was deleted\n", (void *)task);
+        abort();
+    }
+    task->notified++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+static inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) {
+        *woken = pdFALSE;
+    }
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    host_task_t *task = host_current_task;
+    struct timespec deadline = host_deadline(ticks);
+    uint32_t count;
+
+    pthread_mutex_lock(&task->lock);
+    while (!task->notified && ticks) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&task->cond, &task->lock);
+        } else if (pthread_cond_timedwait(&task->cond, &task->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    count = task->notified;
+    task->notified = clear || !count ? 0 : count - 1;
+    pthread_mutex_unlock(&task->lock);
+    return count;
+}
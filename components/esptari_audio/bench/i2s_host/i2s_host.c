@@ -0,0 +1,253 @@
+/**
+ * @file i2s_host.c
+ * @brief I2S TX channel stand-in for the host sink build
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2s_std.h"
+
+#define HOST_FRAME_BYTES    4       // 16-bit stereo
+
+struct i2s_channel_obj_t {
+    uint32_t sample_rate;
+    uint32_t desc_num;
+    uint32_t frame_num;
+    size_t desc_bytes;
+    uint8_t *buf;                   // desc_num descriptors back to back
+    bool *fresh;                    // Written since its last turn
+
+    uint32_t *free_q;               // desc_num - 1 entries, oldest first
+    uint32_t free_head;
+    uint32_t free_count;
+    int cur;                        // Descriptor being written, -1 for none
+    size_t cur_pos;
+    size_t preload_pos;
+
+    i2s_event_callbacks_t callbacks;
+    void *user_data;
+
+    pthread_mutex_t lock;
+    pthread_cond_t freed;
+    pthread_t dma;
+    bool enabled;
+    bool stop;                      // __atomic
+    FILE *out;
+    host_i2s_stats_t stats;
+};
+
+static void host_add_ns(struct timespec *ts, uint64_t ns)
+{
+    ns += (uint64_t)ts->tv_nsec;
+    ts->tv_sec += (time_t)(ns / 1000000000u);
+    ts->tv_nsec = (long)(ns % 1000000000u);
+}
+
+static void *host_dma_main(void *arg)
+{
+    i2s_chan_handle_t ch = arg;
+    struct timespec start, due;
+    uint32_t play = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t n = 1; !__atomic_load_n(&ch->stop, __ATOMIC_RELAXED); n++) {
+        uint8_t *desc = ch->buf + play * ch->desc_bytes;
+        i2s_event_data_t event = { .data = desc, .size = ch->desc_bytes };
+        bool overflow;
+
+        // End of descriptor n, on the sample clock rather than after the last one
+        due = start;
+        host_add_ns(&due, n * ch->frame_num * 1000000000ull / ch->sample_rate);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+
+        pthread_mutex_lock(&ch->lock);
+        if (ch->out) {
+            fwrite(desc, 1, ch->desc_bytes, ch->out);
+        }
+        ch->stats.played++;
+        ch->stats.stale += !ch->fresh[play];
+        ch->fresh[play] = false;
+        pthread_mutex_unlock(&ch->lock);
+
+        // The order of the driver's EOF interrupt
+        if (ch->callbacks.on_sent) {
+            ch->callbacks.on_sent(ch, &event, ch->user_data);
+        }
+        pthread_mutex_lock(&ch->lock);
+        overflow = ch->free_count == ch->desc_num - 1;
+        if (overflow) {
+            ch->free_head = (ch->free_head + 1) % (ch->desc_num - 1);
+            ch->free_count--;
+        }
+        pthread_mutex_unlock(&ch->lock);
+        if (overflow && ch->callbacks.on_send_q_ovf) {
+            event.data = NULL;
+            ch->callbacks.on_send_q_ovf(ch, &event, ch->user_data);
+        }
+        pthread_mutex_lock(&ch->lock);
+        memset(desc, 0, ch->desc_bytes);
+        ch->free_q[(ch->free_head + ch->free_count) % (ch->desc_num - 1)] = play;
+        ch->free_count++;
+        pthread_cond_signal(&ch->freed);
+        pthread_mutex_unlock(&ch->lock);
+
+        play = (play + 1) % ch->desc_num;
+    }
+    return NULL;
+}
+
+esp_err_t host_i2s_new_tx(uint32_t sample_rate, uint32_t desc_num, uint32_t frame_num, FILE *out,
+                          i2s_chan_handle_t *handle)
+{
+    i2s_chan_handle_t ch;
+
+    if (!sample_rate || desc_num < 2 || !frame_num) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ch = calloc(1, sizeof(*ch));
+    if (!ch) {
+        return ESP_ERR_NO_MEM;
+    }
+    ch->sample_rate = sample_rate;
+    ch->desc_num = desc_num;
+    ch->frame_num = frame_num;
+    ch->desc_bytes = (size_t)frame_num * HOST_FRAME_BYTES;
+    ch->buf = calloc(desc_num, ch->desc_bytes);
+    ch->fresh = calloc(desc_num, sizeof(bool));
+    ch->free_q = calloc(desc_num - 1, sizeof(uint32_t));
+    if (!ch->buf || !ch->fresh || !ch->free_q) {
+        host_i2s_del(ch);
+        return ESP_ERR_NO_MEM;
+    }
+    ch->cur = -1;
+    ch->out = out;
+    pthread_mutex_init(&ch->lock, NULL);
+    host_cond_init(&ch->freed);
+    *handle = ch;
+    return ESP_OK;
+}
+
+void host_i2s_del(i2s_chan_handle_t handle)
+{
+    if (handle->enabled) {
+        i2s_channel_disable(handle);
+    }
+    free(handle->buf);
+    free(handle->fresh);
+    free(handle->free_q);
+    free(handle);
+}
+
+void host_i2s_get_stats(i2s_chan_handle_t handle, host_i2s_stats_t *stats)
+{
+    pthread_mutex_lock(&handle->lock);
+    *stats = handle->stats;
+    pthread_mutex_unlock(&handle->lock);
+}
+
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t handle,
+                                              const i2s_event_callbacks_t *callbacks, void *user_data)
+{
+    if (handle->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->callbacks = *callbacks;
+    handle->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_preload_data(i2s_chan_handle_t tx_handle, const void *src, size_t size,
+                                   size_t *bytes_loaded)
+{
+    size_t room = tx_handle->desc_num * tx_handle->desc_bytes - tx_handle->preload_pos;
+    size_t bytes = size < room ? size : room;
+
+    if (tx_handle->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memcpy(tx_handle->buf + tx_handle->preload_pos, src, bytes);
+    for (size_t pos = tx_handle->preload_pos; pos < tx_handle->preload_pos + bytes;
+         pos += tx_handle->desc_bytes) {
+        tx_handle->fresh[pos / tx_handle->desc_bytes] = true;
+    }
+    tx_handle->preload_pos += bytes;
+    *bytes_loaded = bytes;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void *src, size_t size,
+                            size_t *bytes_written, uint32_t timeout_ms)
+{
+    struct timespec deadline = host_deadline(timeout_ms);
+    const uint8_t *in = src;
+    esp_err_t ret = ESP_OK;
+
+    *bytes_written = 0;
+    pthread_mutex_lock(&handle->lock);
+    if (!handle->enabled) {
+        pthread_mutex_unlock(&handle->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    while (*bytes_written < size) {
+        size_t bytes;
+
+        if (handle->cur < 0) {
+            while (!handle->free_count && timeout_ms
+                   && pthread_cond_timedwait(&handle->freed, &handle->lock, &deadline) != ETIMEDOUT) {
+            }
+            if (!handle->free_count) {
+                ret = ESP_ERR_TIMEOUT;
+                break;
+            }
+            handle->cur = (int)handle->free_q[handle->free_head];
+            handle->free_head = (handle->free_head + 1) % (handle->desc_num - 1);
+            handle->free_count--;
+            handle->cur_pos = 0;
+            handle->fresh[handle->cur] = true;
+        }
+        bytes = handle->desc_bytes - handle->cur_pos;
+        if (bytes > size - *bytes_written) {
+            bytes = size - *bytes_written;
+        }
+        memcpy(handle->buf + handle->cur * handle->desc_bytes + handle->cur_pos, in + *bytes_written, bytes);
+        handle->cur_pos += bytes;
+        *bytes_written += bytes;
+        if (handle->cur_pos == handle->desc_bytes) {
+            handle->cur = -1;
+        }
+    }
+    pthread_mutex_unlock(&handle->lock);
+    return ret;
+}
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle)
+{
+    if (handle->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    __atomic_store_n(&handle->stop, false, __ATOMIC_RELAXED);
+    if (pthread_create(&handle->dma, NULL, host_dma_main, handle) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    handle->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_disable(i2s_chan_handle_t handle)
+{
+    if (!handle->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    __atomic_store_n(&handle->stop, true, __ATOMIC_RELAXED);
+    pthread_join(handle->dma, NULL);
+    handle->enabled = false;
+
+    // Back to the state after channel creation
+    memset(handle->buf, 0, handle->desc_num * handle->desc_bytes);
+    memset(handle->fresh, 0, handle->desc_num * sizeof(bool));
+    handle->free_head = 0;
+    handle->free_count = 0;
+    handle->cur = -1;
+    handle->preload_pos = 0;
+    return ESP_OK;
+}
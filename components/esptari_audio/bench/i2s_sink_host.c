@@ -0,0 +1,139 @@
+/**
+ * @file i2s_sink_host.c
+ * @brief Host run of the I2S sink against a timed stand-in channel
+ *
+ * Emulates a PAL ST in real time, one scanline group at a time: a 440 Hz
+ * YM tone goes through the mixer, whose sink is i2s_sink_feed(), and the
+ * sink task refills a stand-in channel (i2s_host/) that plays descriptors
+ * on the host clock into an optional raw file. Each 20 ms frame is
+ * emulated in the first load% of its time and the rest is idle, as behind
+ * VBL pacing. An optional stall halfway through holds the emulation long
+ * enough to provoke underruns.
+ *
+ * Reports the sink's measured latency and underruns next to the
+ * descriptors the channel actually played stale.
+ *
+ * Usage: i2s_sink_host [seconds] [lines_per_group] [desc_num] [load%] [stall_ms] [out.raw]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "esptari_audio.h"
+#include "esptari_i2s_sink.h"
+
+#define HOST_CLOCK_HZ       8000000
+#define HOST_LINE_CYCLES    512
+#define HOST_FRAME_CYCLES   (313 * HOST_LINE_CYCLES)    /**< PAL, 50.08 Hz */
+#define HOST_RING_FRAMES    2048
+#define HOST_TONE_HZ        440.0
+
+static audio_mixer_t s_mx;
+static i2s_sink_t s_sink;
+static int16_t s_ym[AUDIO_BLOCK_MAX * 2];
+
+static void host_sleep_until(const struct timespec *start, double s)
+{
+    struct timespec due = *start;
+    long long ns = (long long)(s * 1e9) + due.tv_nsec;
+
+    due.tv_sec += (time_t)(ns / 1000000000LL);
+    due.tv_nsec = (long)(ns % 1000000000LL);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    uint32_t lines = argc > 2 ? (uint32_t)atoi(argv[2]) : 16;
+    uint32_t desc_num = argc > 3 ? (uint32_t)atoi(argv[3]) : 4;
+    double load = (argc > 4 ? atof(argv[4]) : 80.0) / 100.0;
+    double stall = (argc > 5 ? atof(argv[5]) : 0.0) / 1000.0;
+    FILE *out = argc > 6 ? fopen(argv[6], "wb") : NULL;
+    uint32_t group_frames = i2s_sink_group_frames(AUDIO_OUT_RATE, HOST_CLOCK_HZ, HOST_LINE_CYCLES, lines);
+    uint64_t group_cycles = (uint64_t)lines * HOST_LINE_CYCLES;
+    uint64_t total_cycles = (uint64_t)(seconds * HOST_CLOCK_HZ);
+    double frame_s = (double)HOST_FRAME_CYCLES / HOST_CLOCK_HZ;
+    i2s_chan_handle_t tx;
+    i2s_sink_stats_t stats;
+    host_i2s_stats_t played;
+    struct timespec start;
+    uint64_t tone_pos = 0;
+    bool stalled = false;
+
+    if (argc > 6 && !out) {
+        perror(argv[6]);
+        return 1;
+    }
+    if (host_i2s_new_tx(AUDIO_OUT_RATE, desc_num, group_frames, out, &tx) != ESP_OK) {
+        return 1;
+    }
+    i2s_sink_config_t sink_config = {
+        .tx = tx,
+        .sample_rate = AUDIO_OUT_RATE,
+        .frames_per_desc = group_frames,
+        .desc_num = desc_num,
+        .ring_frames = HOST_RING_FRAMES,
+    };
+    audio_mixer_config_t mixer_config = {
+        .clock_hz = HOST_CLOCK_HZ,
+        .ym_rate = AUDIO_OUT_RATE,
+        .sink = i2s_sink_feed,
+        .sink_ctx = &s_sink,
+    };
+    if (i2s_sink_init(&s_sink, &sink_config) != ESP_OK) {
+        fprintf(stderr, "i2s_sink_host: bad sink configuration\n");
+        return 1;
+    }
+    audio_mixer_init(&s_mx, &mixer_config);
+    i2s_sink_start(&s_sink);
+
+    printf("i2s_sink_host: %u lines per group = %u frames = %.2f ms per descriptor, %u descriptors, "
+           "load %.0f%%, stall %.0f ms\n", lines, group_frames, group_frames * 1e3 / AUDIO_OUT_RATE,
+           desc_num, load * 100, stall * 1e3);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t cycles = 0; cycles < total_cycles; cycles += group_cycles) {
+        uint64_t frame = cycles / HOST_FRAME_CYCLES;
+        double within = (double)(cycles % HOST_FRAME_CYCLES) / HOST_FRAME_CYCLES;
+        uint64_t due = (cycles + group_cycles) * AUDIO_OUT_RATE / HOST_CLOCK_HZ
+                       - cycles * AUDIO_OUT_RATE / HOST_CLOCK_HZ;
+
+        if (stall > 0.0 && !stalled && cycles >= total_cycles / 2) {
+            host_sleep_until(&start, (double)frame * frame_s + within * load * frame_s + stall);
+            start.tv_sec += (time_t)stall;
+            start.tv_nsec += (long)((stall - (time_t)stall) * 1e9);
+            if (start.tv_nsec >= 1000000000L) {
+                start.tv_sec++;
+                start.tv_nsec -= 1000000000L;
+            }
+            stalled = true;
+        }
+        host_sleep_until(&start, (double)frame * frame_s + within * load * frame_s);
+
+        for (uint64_t i = 0; i < due; i++, tone_pos++) {
+            int16_t s = (int16_t)lrint(8000 * sin(2 * M_PI * HOST_TONE_HZ * tone_pos / AUDIO_OUT_RATE));
+            s_ym[2 * i] = s_ym[2 * i + 1] = s;
+        }
+        audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_ym, (int)due);
+        audio_mixer_frame(&s_mx, (uint32_t)group_cycles);
+    }
+
+    i2s_sink_stop(&s_sink);
+    i2s_sink_get_stats(&s_sink, &stats);
+    host_i2s_get_stats(tx, &played);
+
+    printf("  latency        %6.2f ms min, %6.2f ms avg, %6.2f ms max\n",
+           stats.latency_min_us / 1e3, stats.latency_avg_us / 1e3, stats.latency_max_us / 1e3);
+    printf("  descriptors    %u written, %u sent, %u underruns (channel played %u stale)\n",
+           stats.desc_written, stats.desc_sent, stats.underruns, played.stale);
+    printf("  ring overruns  %u frames\n", stats.ring_overruns);
+
+    i2s_sink_free(&s_sink);
+    host_i2s_del(tx);
+    if (out) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file mixer_bench.c
+ * @brief Host benchmark for the audio output stage
+ *
+ * Pushes one 50 Hz frame of YM2149 and DMA sound at a time and mixes it
+ * into a 960-frame 48 kHz block, for every DMA rate, with and without the
+ * LMC1992 shelves, and with the YM at 48 kHz (no resampling) or at
+ * 62.5 kHz (resampled). Reports host time and cycles per block, and the
+ * share of a 400 MHz core that makes at 50 blocks per second.
+ *
+ * Usage: mixer_bench [host_mhz] [seconds]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esptari_audio.h"
+
+#define BENCH_CLOCK_HZ      8000000
+#define BENCH_FRAME_CYCLES  160000      /**< 50 Hz VBL */
+#define BENCH_BLOCKS_PER_S  50
+#define BENCH_P4_CLOCK_MHZ  400.0
+#define BENCH_PASSES        5           /**< Best of, to ride out host noise */
+
+typedef struct {
+    const char *name;
+    uint32_t ym_rate;
+    uint32_t dma_rate;                  /**< 0: DMA sound off */
+    bool tone;
+} bench_case_t;
+
+static audio_mixer_t s_mx;
+static int16_t s_ym[4096 * 2];
+static int8_t s_dma[4096 * 2];
+static volatile int32_t s_sink_sum;
+
+/** Host clock from /proc/cpuinfo, 0 if unknown */
+static double bench_host_mhz(void)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0.0;
+
+    if (!f) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "cpu MHz", 7) == 0) {
+            const char *colon = strchr(line, ':');
+            if (colon) {
+                mhz = atof(colon + 1);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    return mhz;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/** Stands in for the I2S sink, touching the block so it is not optimised out */
+static void bench_sink(void *ctx, const int16_t *frames, int count)
+{
+    s_sink_sum += frames[0] + frames[2 * count - 1];
+}
+
+/** Source frames a chip at @p rate produces in frame @p frame */
+static int bench_due(uint32_t rate, int frame)
+{
+    return (int)((uint64_t)(frame + 1) * BENCH_FRAME_CYCLES * rate / BENCH_CLOCK_HZ
+                 - (uint64_t)frame * BENCH_FRAME_CYCLES * rate / BENCH_CLOCK_HZ);
+}
+
+/**
+ * @return Host seconds per block, best of BENCH_PASSES
+ */
+static double bench_run(const bench_case_t *bc, int blocks, audio_stream_t *stream)
+{
+    audio_mixer_config_t config = {
+        .clock_hz = BENCH_CLOCK_HZ,
+        .ym_rate = bc->ym_rate,
+        .stream = stream,
+        .sink = bench_sink,
+    };
+    double best = 0.0;
+
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double elapsed = 0.0;
+
+        audio_mixer_init(&s_mx, &config);
+        if (bc->dma_rate) {
+            audio_mixer_set_dma_rate(&s_mx, bc->dma_rate);
+        }
+        if (bc->tone) {
+            audio_mixer_lmc_write(&s_mx, (AUDIO_LMC_ADDRESS << 9) | (AUDIO_LMC_BASS << 6) | 10);
+            audio_mixer_lmc_write(&s_mx, (AUDIO_LMC_ADDRESS << 9) | (AUDIO_LMC_TREBLE << 6) | 4);
+        }
+        for (int frame = 0; frame < blocks; frame++) {
+            int ym = bench_due(bc->ym_rate, frame);
+            int dma = bc->dma_rate ? bench_due(bc->dma_rate, frame) : 0;
+
+            double t0 = bench_now();
+            audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_ym, ym);
+            audio_mixer_push_dma(&s_mx, s_dma, dma, true);
+            audio_mixer_frame(&s_mx, BENCH_FRAME_CYCLES);
+            elapsed += bench_now() - t0;
+
+            // The WebSocket task keeps up
+            audio_span_t span;
+            uint32_t queued = audio_stream_read_acquire(stream, audio_stream_available(stream), &span);
+            audio_stream_read_release(stream, queued);
+        }
+        if (!pass || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best / blocks;
+}
+
+int main(int argc, char **argv)
+{
+    static const bench_case_t cases[] = {
+        { "ym48",           AUDIO_OUT_RATE, 0,                  false },
+        { "ym48+dma6",      AUDIO_OUT_RATE, AUDIO_DMA_RATE_6K,  false },
+        { "ym48+dma12",     AUDIO_OUT_RATE, AUDIO_DMA_RATE_12K, false },
+        { "ym48+dma25",     AUDIO_OUT_RATE, AUDIO_DMA_RATE_25K, false },
+        { "ym48+dma50",     AUDIO_OUT_RATE, AUDIO_DMA_RATE_50K, false },
+        { "ym48+dma50+tone", AUDIO_OUT_RATE, AUDIO_DMA_RATE_50K, true },
+        { "ym62+dma50+tone", 62500,          AUDIO_DMA_RATE_50K, true },
+    };
+    double host_mhz = argc > 1 ? atof(argv[1]) : bench_host_mhz();
+    int blocks = (argc > 2 ? atoi(argv[2]) : 20) * BENCH_BLOCKS_PER_S;
+    static audio_stream_t stream;
+
+    // Busy, full-scale-ish material so nothing takes a shortcut
+    for (int i = 0; i < 4096; i++) {
+        s_ym[2 * i] = s_ym[2 * i + 1] = (int16_t)lrint(12000 * sin(2 * M_PI * i / 37.0));
+        s_dma[2 * i] = (int8_t)lrint(90 * sin(2 * M_PI * i / 23.0));
+        s_dma[2 * i + 1] = (int8_t)lrint(90 * sin(2 * M_PI * i / 29.0));
+    }
+    if (audio_stream_init(&stream, AUDIO_OUT_RATE, AUDIO_OUT_RATE / BENCH_BLOCKS_PER_S, 4096) != ESP_OK) {
+        return 1;
+    }
+
+    printf("mixer_bench: %d-frame blocks, %d blocks per case (best of %d)",
+           AUDIO_OUT_RATE / BENCH_BLOCKS_PER_S, blocks, BENCH_PASSES);
+    if (host_mhz > 0.0) {
+        printf(", host %.0f MHz\n", host_mhz);
+    } else {
+        printf(", host clock unknown (pass it as the first argument)\n");
+    }
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        double s_per_block = bench_run(&cases[i], blocks, &stream);
+
+        printf("  %-16s %8.1f us/block", cases[i].name, s_per_block * 1e6);
+        if (host_mhz > 0.0) {
+            double cycles = s_per_block * host_mhz * 1e6;
+            printf(", %8.0f cycles/block, %.2f%% of %.0f MHz", cycles,
+                   cycles * BENCH_BLOCKS_PER_S / (BENCH_P4_CLOCK_MHZ * 1e6) * 100, BENCH_P4_CLOCK_MHZ);
+        }
+        printf("\n");
+    }
+    audio_stream_free(&stream);
+    return 0;
+}
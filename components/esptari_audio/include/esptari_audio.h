@@ -0,0 +1,203 @@
+/**
+ * @file esptari_audio.h
+ * @brief STe audio output stage
+ *
+ * The sound chips render at their own rates: the YM2149 at whatever rate
+ * its core was configured for, DMA sound at one of the four STe rates
+ * from signed 8-bit frames. The mixer resamples each source to
+ * AUDIO_OUT_RATE with a polyphase windowed-sinc filter, mixes them the
+ * way the LMC1992 input select does, applies its master and left/right
+ * volume and bass/treble shelves, and delivers one 48 kHz stereo block
+ * per emulated frame to the WebSocket audio_stream_t and to a local sink
+ * (I2S).
+ *
+ * Everything past setup is fixed point: Q14 filter taps with a 32.32
+ * phase, Q14 gains and first-order shelves on integer integrators.
+ * Filter kernels are computed in float when a source changes rate, which
+ * DMA sound does only when the program writes its mode register.
+ *
+ * Pure bookkeeping without locks: the emulation task pushes source
+ * frames and calls audio_mixer_frame() at the end of each frame. The
+ * stream it feeds is the one structure shared with another core
+ * (esptari_audio_stream.h).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esptari_audio_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_OUT_RATE          48000
+#define AUDIO_OUT_CHANNELS      AUDIO_STREAM_CHANNELS
+#define AUDIO_BLOCK_MAX         1024    ///< Frames per delivered block, one 47 Hz frame
+#define AUDIO_SRC_FIFO          2048    ///< Source frames buffered, power of two
+
+#define AUDIO_RS_PHASES         64
+#define AUDIO_RS_TAPS           16      ///< Output lags by AUDIO_RS_TAPS / 2 - 1 source frames
+#define AUDIO_RS_CUTOFF         0.45f   ///< Of the lower of the source and output rates
+
+// STe DMA sound rates, by the two rate bits of $FF8921
+#define AUDIO_DMA_RATE_6K       6258
+#define AUDIO_DMA_RATE_12K      12517
+#define AUDIO_DMA_RATE_25K      25033
+#define AUDIO_DMA_RATE_50K      50066
+
+// LMC1992 registers, bits 8-6 of a Microwire command
+#define AUDIO_LMC_ADDRESS       2       ///< Device address, bits 10-9
+#define AUDIO_LMC_MIX           0       ///< 0: YM at -12 dB, 1: YM, 2: DMA only
+#define AUDIO_LMC_BASS          1       ///< 0-12: -12 to +12 dB in 2 dB steps
+#define AUDIO_LMC_TREBLE        2       ///< 0-12
+#define AUDIO_LMC_MASTER        3       ///< 0-40: -80 to 0 dB in 2 dB steps
+#define AUDIO_LMC_RIGHT         4       ///< 0-20: -40 to 0 dB
+#define AUDIO_LMC_LEFT          5       ///< 0-20
+
+/**
+ * @brief Local output, given each block as it is mixed
+ */
+typedef void (*audio_sink_fn)(void *ctx, const int16_t *frames, int count);
+
+typedef enum {
+    AUDIO_SRC_YM = 0,
+    AUDIO_SRC_DMA,
+    AUDIO_SRC_COUNT,
+} audio_src_id_t;
+
+/**
+ * @brief One source, its FIFO and its resampler
+ */
+typedef struct {
+    uint32_t rate;
+    bool bypass;                    ///< At AUDIO_OUT_RATE, no filtering
+    bool pushed;                    ///< Fed since the last block: running dry is an underrun
+    int16_t fifo[AUDIO_SRC_FIFO][2];
+    uint32_t head;                  ///< Frames pushed, wrapping
+    uint32_t tail;                  ///< Frames consumed, wrapping
+    uint64_t step;                  ///< Source frames per output frame, 32.32
+    uint64_t phase;                 ///< Output position past the newest history frame, 32.32
+    int16_t hist[2 * AUDIO_RS_TAPS][2];  ///< Last AUDIO_RS_TAPS frames, stored twice
+    int hpos;
+    int16_t kernel[AUDIO_RS_PHASES + 1][AUDIO_RS_TAPS];  ///< Q14, each phase sums to 1
+} audio_source_t;
+
+typedef struct {
+    uint8_t mix;
+    uint8_t bass;
+    uint8_t treble;
+    uint8_t master;
+    uint8_t left;
+    uint8_t right;
+} audio_lmc_t;
+
+typedef struct {
+    uint32_t clock_hz;              ///< Emulated CPU clock, frame lengths are in its cycles
+    uint32_t ym_rate;               ///< Rate the YM2149 renders at; AUDIO_OUT_RATE skips its filter
+    audio_stream_t *stream;         ///< WebSocket side, optional
+    audio_sink_fn sink;             ///< Local output, optional
+    void *sink_ctx;
+} audio_mixer_config_t;
+
+typedef struct {
+    uint32_t blocks;
+    uint64_t frames;                ///< Output frames mixed
+    uint32_t underruns[AUDIO_SRC_COUNT];  ///< Source frames missing while fed, the last one held
+    uint32_t overruns[AUDIO_SRC_COUNT];   ///< Source frames dropped, FIFO full
+    uint32_t clipped;               ///< Output samples saturated
+} audio_mixer_stats_t;
+
+typedef struct {
+    audio_mixer_config_t config;
+    audio_source_t src[AUDIO_SRC_COUNT];
+    audio_lmc_t lmc;
+
+    // Derived from lmc
+    int32_t ym_gain;                ///< Q14
+    int32_t volume[2];              ///< Q14, left and right
+    int32_t bass_gain;              ///< Shelf gain minus one, Q12
+    int32_t treble_gain;
+    int32_t bass_a;                 ///< Integrator gains, Q15
+    int32_t treble_a;
+    bool flat;                      ///< Both shelves at 0 dB
+
+    int32_t bass_lp[2];             ///< Integrator states, samples << 8
+    int32_t treble_lp[2];
+
+    uint64_t out_acc;               ///< Output frames owed, times clock_hz
+    int32_t acc[AUDIO_BLOCK_MAX * 2];
+    int16_t block[AUDIO_BLOCK_MAX * 2];  ///< Last delivered block
+
+    audio_mixer_stats_t stats;
+} audio_mixer_t;
+
+/** DMA sound rate of the two rate bits of the mode register */
+static inline uint32_t audio_dma_rate(uint8_t mode)
+{
+    static const uint32_t rates[4] = {
+        AUDIO_DMA_RATE_6K, AUDIO_DMA_RATE_12K, AUDIO_DMA_RATE_25K, AUDIO_DMA_RATE_50K,
+    };
+    return rates[mode & 3];
+}
+
+// Mixer
+
+/**
+ * @brief Reset the mixer, LMC1992 at its power-on state
+ *
+ * The DMA source starts at AUDIO_DMA_RATE_50K.
+ *
+ * @return ESP_ERR_INVALID_ARG for a zero clock or a YM rate the
+ *         resampler cannot take (zero, or over twice AUDIO_OUT_RATE)
+ */
+esp_err_t audio_mixer_init(audio_mixer_t *mx, const audio_mixer_config_t *config);
+
+/**
+ * @brief Change the DMA sound rate
+ *
+ * Takes effect at once, on frames still queued too; the DMA engine
+ * latches a new rate at frame start, so there are rarely any.
+ *
+ * @return ESP_ERR_INVALID_ARG for a rate the resampler cannot take
+ */
+esp_err_t audio_mixer_set_dma_rate(audio_mixer_t *mx, uint32_t rate);
+
+/**
+ * @brief Queue stereo int16 frames of @p id at its rate
+ *
+ * Frames past AUDIO_SRC_FIFO replace the oldest queued ones.
+ */
+void audio_mixer_push(audio_mixer_t *mx, audio_src_id_t id, const int16_t *frames, int count);
+
+/**
+ * @brief Queue DMA sound as fetched: signed 8-bit, interleaved if @p stereo
+ */
+void audio_mixer_push_dma(audio_mixer_t *mx, const int8_t *data, int count, bool stereo);
+
+/**
+ * @brief Apply an 11-bit Microwire command
+ *
+ * @return ESP_ERR_INVALID_ARG for another device address or a register
+ *         the LMC1992 does not have; values past a register's range are
+ *         clamped
+ */
+esp_err_t audio_mixer_lmc_write(audio_mixer_t *mx, uint16_t command);
+
+/**
+ * @brief Mix the output of @p cycles CPU cycles and deliver it
+ *
+ * Renders the 48 kHz frames those cycles are worth, carrying the
+ * fraction to the next call, into mx->block, then writes them to the
+ * stream and hands them to the sink. A frame longer than AUDIO_BLOCK_MAX
+ * output frames is delivered in several blocks.
+ *
+ * @return Output frames rendered
+ */
+int audio_mixer_frame(audio_mixer_t *mx, uint32_t cycles);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,161 @@
+/**
+ * @file esptari_audio_stream.h
+ * @brief Lock-free single-producer, single-consumer audio ring
+ *
+ * IMPLEMENTATION_PLAN.md 3.3 gives audio_stream_t bare write and read
+ * positions; the CPU budget then puts the emulation that fills it on Core 0
+ * and the streaming that drains it on Core 1. This is that ring made safe
+ * for exactly one producer and one consumer task.
+ *
+ * Each position is written by one side only and sits on its own cache
+ * line with that side's private state, so the two cores do not bounce a
+ * line on every access. Positions are free-running frame counts and the
+ * capacity is a power of two. A side takes the other side's position
+ * with an acquire load only when its cached copy says there is not
+ * enough room or data, and publishes its own with a release store once
+ * per span: a whole block costs two atomic accesses, not one per sample.
+ *
+ * Spans are acquired, filled or drained in place, then committed or
+ * released. They come in up to two parts because of the wrap.
+ *
+ * Overruns are frames the producer wanted to write but had no room for;
+ * they are dropped, since the consumer owns the data it has not read.
+ * Underruns are frames the consumer asked for that were not there. An
+ * optional watermark callback fires when the fill crosses high_mark
+ * upwards (from the producer) or low_mark downwards (from the consumer),
+ * once per crossing as that side sees it, which is what the sync engine
+ * steers on.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_STREAM_CHANNELS   2
+#define AUDIO_CACHE_LINE        64      ///< ESP32-P4 L1 data cache line
+
+typedef enum {
+    AUDIO_STREAM_MARK_LOW,      ///< Fill fell to low_mark or below, from the consumer
+    AUDIO_STREAM_MARK_HIGH,     ///< Fill rose to high_mark or above, from the producer
+} audio_stream_mark_t;
+
+/**
+ * @brief Watermark callback, runs on the task that crossed the mark
+ *
+ * Must be short and must not touch the ring.
+ */
+typedef void (*audio_stream_mark_fn)(void *ctx, audio_stream_mark_t mark, uint32_t fill);
+
+/**
+ * @brief Up to two runs of interleaved stereo int16 frames
+ */
+typedef struct {
+    int16_t *data[2];
+    uint32_t frames[2];
+} audio_span_t;
+
+/**
+ * @brief Stereo int16 frame ring, one producer and one consumer
+ *
+ * Aligned to AUDIO_CACHE_LINE; allocate it statically or with an aligned
+ * allocator.
+ */
+typedef struct {
+    // Set up before either side runs, read-only after
+    int16_t *buffer;
+    uint32_t sample_rate;
+    uint32_t samples_per_frame;     // Frames per emulated frame, nominal
+    uint32_t capacity;              // Frames, power of two
+    uint32_t low_mark;
+    uint32_t high_mark;
+    audio_stream_mark_fn on_mark;
+    void *mark_ctx;
+
+    // Producer side
+    uint32_t write_pos __attribute__((aligned(AUDIO_CACHE_LINE)));
+    uint32_t read_cache;            // read_pos as the producer last saw it
+    uint32_t overruns;
+    bool above_high;
+
+    // Consumer side
+    uint32_t read_pos __attribute__((aligned(AUDIO_CACHE_LINE)));
+    uint32_t write_cache;           // write_pos as the consumer last saw it
+    uint32_t underruns;
+    bool below_low;
+} __attribute__((aligned(AUDIO_CACHE_LINE))) audio_stream_t;
+
+/**
+ * @brief Allocate the ring of a zeroed or freed stream
+ *
+ * The stream is left untouched on failure.
+ *
+ * @return ESP_ERR_INVALID_ARG unless @p capacity is a power of two,
+ *         ESP_ERR_INVALID_STATE if the stream still holds a buffer,
+ *         ESP_ERR_NO_MEM
+ */
+esp_err_t audio_stream_init(audio_stream_t *stream, uint32_t sample_rate,
+                            uint32_t samples_per_frame, uint32_t capacity);
+void audio_stream_free(audio_stream_t *stream);
+
+/**
+ * @brief Set the watermarks and their callback, before either side runs
+ *
+ * @return ESP_ERR_INVALID_ARG unless low < high <= capacity
+ */
+esp_err_t audio_stream_set_marks(audio_stream_t *stream, uint32_t low, uint32_t high,
+                                 audio_stream_mark_fn fn, void *ctx);
+
+/** Frames queued; exact from either side when the other is idle */
+uint32_t audio_stream_available(const audio_stream_t *stream);
+
+// Producer
+
+/**
+ * @brief Room for up to @p want frames
+ *
+ * Frames of @p want beyond the room are counted as overruns.
+ *
+ * @return Frames in @p span
+ */
+uint32_t audio_stream_write_acquire(audio_stream_t *stream, uint32_t want, audio_span_t *span);
+
+/** Publish the first @p frames frames of the acquired span */
+void audio_stream_write_commit(audio_stream_t *stream, uint32_t frames);
+
+/**
+ * @brief Copy in through a span
+ *
+ * @return Frames written, fewer than @p count when the ring is full
+ */
+uint32_t audio_stream_write(audio_stream_t *stream, const int16_t *frames, uint32_t count);
+
+// Consumer
+
+/**
+ * @brief Up to @p want queued frames
+ *
+ * Frames of @p want beyond those queued are counted as underruns.
+ *
+ * @return Frames in @p span
+ */
+uint32_t audio_stream_read_acquire(audio_stream_t *stream, uint32_t want, audio_span_t *span);
+
+/** Hand the first @p frames frames of the acquired span back to the producer */
+void audio_stream_read_release(audio_stream_t *stream, uint32_t frames);
+
+/**
+ * @brief Copy out through a span
+ *
+ * @return Frames read, fewer than @p count when the ring runs empty
+ */
+uint32_t audio_stream_read(audio_stream_t *stream, int16_t *frames, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,135 @@
+/**
+ * @file esptari_i2s_sink.h
+ * @brief Low-latency local output on an I2S codec
+ *
+ * The 06_I2SCodec example writes whole clips with i2s_channel_write(...,
+ * portMAX_DELAY), which buffers as much as the DMA holds and blocks at
+ * will. For a speaker on the board the output should instead trail the
+ * emulation by a few milliseconds.
+ *
+ * The emulation calls audio_mixer_frame() once per scanline group rather
+ * than once per frame and hands the mixer i2s_sink_feed() as its sink,
+ * which queues each block on the sink's own audio_stream_t. One I2S DMA
+ * descriptor holds exactly one such group (i2s_sink_group_frames()), so
+ * the DMA is refilled at the rate the emulation produces and the DMA
+ * list, dma_desc_num descriptors, is the whole hardware latency.
+ *
+ * A task, pinned to the core of the caller's choosing, sleeps until the
+ * DMA reports a descriptor sent and then moves whole descriptors from the
+ * ring into the ones the driver has freed, never blocking. The ring's
+ * high watermark, set at one full DMA list, also wakes it from the
+ * producer side. At start it waits for that list of audio, loads it with
+ * i2s_channel_preload_data() and only then enables the channel. The list
+ * is circular: a descriptor left out of the preload would play as silence
+ * ahead of everything written later.
+ *
+ * Latency is measured at every refill as the audio queued between the
+ * emulation and the DAC: ring fill plus descriptors written and not yet
+ * sent. A descriptor the DMA had to play without fresh data (the driver
+ * clears it) is counted as an underrun. Nothing is dropped to make up for
+ * one: the output then trails by the silence played, which shows in the
+ * latency and in the ring's fill for the sync engine to steer on.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/i2s_std.h"
+#include "esptari_audio_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I2S_SINK_FRAME_BYTES        (AUDIO_STREAM_CHANNELS * sizeof(int16_t))
+#define I2S_SINK_DMA_BYTES_MAX      4092    ///< Per descriptor, a GDMA limit
+
+typedef struct {
+    i2s_chan_handle_t tx;           ///< Standard mode set up, 16-bit stereo, not enabled
+    uint32_t sample_rate;
+    uint32_t frames_per_desc;       ///< Must match the channel's dma_frame_num
+    uint32_t desc_num;              ///< Must match the channel's dma_desc_num
+    uint32_t ring_frames;           ///< Ring capacity, a power of two
+    int core;                       ///< Core of the refill task
+    UBaseType_t priority;
+} i2s_sink_config_t;
+
+typedef struct {
+    uint32_t desc_written;          ///< Preload included
+    uint32_t desc_sent;             ///< Descriptors the DMA finished
+    uint32_t underruns;             ///< Descriptors the DMA sent without fresh data
+    uint32_t ring_overruns;         ///< Frames the mixer had no room for
+    uint32_t latency_min_us;
+    uint32_t latency_max_us;
+    uint32_t latency_avg_us;
+} i2s_sink_stats_t;
+
+typedef struct {
+    i2s_sink_config_t config;
+    audio_stream_t ring;
+    TaskHandle_t task;              // __atomic, cleared before the task deletes itself
+    uint32_t notifiers;             // __atomic, sink_notify() calls in flight
+    bool stop;                      // __atomic, set by i2s_sink_stop()
+    bool running;                   // __atomic, cleared as the task ends
+
+    uint32_t desc_written;
+    uint32_t desc_fill;             // Frames in a descriptor the driver took in part
+    uint32_t desc_sent;             // __atomic, from the I2S ISR
+    uint32_t underruns;             // __atomic, from the I2S ISR
+
+    uint32_t latency_min_us;
+    uint32_t latency_max_us;
+    uint64_t latency_sum_us;
+    uint32_t latency_samples;
+} i2s_sink_t;
+
+/**
+ * @brief Frames in one group of @p lines scanlines of @p line_cycles CPU cycles, rounded up
+ *
+ * An ST PAL line is 512 cycles at 8 MHz; 16 lines make 50 frames at 48 kHz.
+ */
+static inline uint32_t i2s_sink_group_frames(uint32_t sample_rate, uint32_t clock_hz,
+                                             uint32_t line_cycles, uint32_t lines)
+{
+    uint64_t cycles = (uint64_t)line_cycles * lines;
+
+    return (uint32_t)((cycles * sample_rate + clock_hz - 1) / clock_hz);
+}
+
+/**
+ * @brief Allocate the ring and hook the DMA events of config->tx
+ *
+ * @return ESP_ERR_INVALID_ARG for a descriptor over I2S_SINK_DMA_BYTES_MAX
+ *         or a ring smaller than the DMA list,
+ *         ESP_ERR_NO_MEM, or the error of registering the callbacks
+ */
+esp_err_t i2s_sink_init(i2s_sink_t *sink, const i2s_sink_config_t *config);
+
+/**
+ * @brief Start the refill task; the channel is enabled once preloaded
+ */
+esp_err_t i2s_sink_start(i2s_sink_t *sink);
+
+/**
+ * @brief Stop the task and disable the channel, waiting for both
+ *
+ * i2s_sink_feed() may go on afterwards; the audio then only fills the
+ * ring until the next start.
+ */
+void i2s_sink_stop(i2s_sink_t *sink);
+void i2s_sink_free(i2s_sink_t *sink);
+
+/**
+ * @brief audio_sink_fn for audio_mixer_config_t, run by the emulation task
+ */
+void i2s_sink_feed(void *ctx, const int16_t *frames, int count);
+
+void i2s_sink_get_stats(const i2s_sink_t *sink, i2s_sink_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,183 @@
+/**
+ * @file audio_stream.c
+ * @brief Lock-free single-producer, single-consumer audio ring
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esptari_audio_stream.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#define STREAM_ALLOC(size)  heap_caps_calloc(1, (size), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define STREAM_FREE(ptr)    heap_caps_free(ptr)
+#else
+#define STREAM_ALLOC(size)  calloc(1, (size))
+#define STREAM_FREE(ptr)    free(ptr)
+#endif
+
+#define FRAME_BYTES     (AUDIO_STREAM_CHANNELS * sizeof(int16_t))
+
+esp_err_t audio_stream_init(audio_stream_t *stream, uint32_t sample_rate,
+                            uint32_t samples_per_frame, uint32_t capacity)
+{
+    int16_t *buffer;
+
+    if (!stream || !capacity || (capacity & (capacity - 1))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream->buffer) {
+        return ESP_ERR_INVALID_STATE;       // Would leak it; audio_stream_free() first
+    }
+    buffer = STREAM_ALLOC(capacity * FRAME_BYTES);
+    if (!buffer) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(stream, 0, sizeof(*stream));
+    stream->buffer = buffer;
+    stream->sample_rate = sample_rate;
+    stream->samples_per_frame = samples_per_frame;
+    stream->capacity = capacity;
+    stream->high_mark = capacity + 1;       // Never reached until set
+    return ESP_OK;
+}
+
+void audio_stream_free(audio_stream_t *stream)
+{
+    STREAM_FREE(stream->buffer);
+    stream->buffer = NULL;
+}
+
+esp_err_t audio_stream_set_marks(audio_stream_t *stream, uint32_t low, uint32_t high,
+                                 audio_stream_mark_fn fn, void *ctx)
+{
+    if (low >= high || high > stream->capacity) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    stream->low_mark = low;
+    stream->high_mark = high;
+    stream->on_mark = fn;
+    stream->mark_ctx = ctx;
+    stream->above_high = false;
+    stream->below_low = true;               // Starts empty: the first crossing is upwards
+    return ESP_OK;
+}
+
+uint32_t audio_stream_available(const audio_stream_t *stream)
+{
+    uint32_t read = __atomic_load_n(&stream->read_pos, __ATOMIC_ACQUIRE);
+    uint32_t write = __atomic_load_n(&stream->write_pos, __ATOMIC_ACQUIRE);
+
+    return write - read;
+}
+
+/** Split @p count frames from position @p pos into the runs before and after the wrap */
+static void stream_span(audio_stream_t *stream, uint32_t pos, uint32_t count, audio_span_t *span)
+{
+    uint32_t at = pos & (stream->capacity - 1);
+    uint32_t first = stream->capacity - at;
+
+    if (first > count) {
+        first = count;
+    }
+    span->data[0] = stream->buffer + at * AUDIO_STREAM_CHANNELS;
+    span->frames[0] = first;
+    span->data[1] = stream->buffer;
+    span->frames[1] = count - first;
+}
+
+uint32_t audio_stream_write_acquire(audio_stream_t *stream, uint32_t want, audio_span_t *span)
+{
+    uint32_t room = stream->capacity - (stream->write_pos - stream->read_cache);
+
+    if (room < want) {
+        stream->read_cache = __atomic_load_n(&stream->read_pos, __ATOMIC_ACQUIRE);
+        room = stream->capacity - (stream->write_pos - stream->read_cache);
+        if (room < want) {
+            stream->overruns += want - room;
+            want = room;
+        }
+    }
+    stream_span(stream, stream->write_pos, want, span);
+    return want;
+}
+
+void audio_stream_write_commit(audio_stream_t *stream, uint32_t frames)
+{
+    uint32_t write = stream->write_pos + frames;
+
+    __atomic_store_n(&stream->write_pos, write, __ATOMIC_RELEASE);
+
+    if (write - stream->read_cache >= stream->high_mark) {
+        // The cached read position overstates the fill; confirm
+        stream->read_cache = __atomic_load_n(&stream->read_pos, __ATOMIC_ACQUIRE);
+    }
+    uint32_t fill = write - stream->read_cache;
+    if (fill < stream->high_mark) {
+        stream->above_high = false;
+    } else if (!stream->above_high) {
+        stream->above_high = true;
+        if (stream->on_mark) {
+            stream->on_mark(stream->mark_ctx, AUDIO_STREAM_MARK_HIGH, fill);
+        }
+    }
+}
+
+uint32_t audio_stream_write(audio_stream_t *stream, const int16_t *frames, uint32_t count)
+{
+    audio_span_t span;
+
+    count = audio_stream_write_acquire(stream, count, &span);
+    memcpy(span.data[0], frames, span.frames[0] * FRAME_BYTES);
+    memcpy(span.data[1], frames + span.frames[0] * AUDIO_STREAM_CHANNELS, span.frames[1] * FRAME_BYTES);
+    audio_stream_write_commit(stream, count);
+    return count;
+}
+
+uint32_t audio_stream_read_acquire(audio_stream_t *stream, uint32_t want, audio_span_t *span)
+{
+    uint32_t queued = stream->write_cache - stream->read_pos;
+
+    if (queued < want) {
+        stream->write_cache = __atomic_load_n(&stream->write_pos, __ATOMIC_ACQUIRE);
+        queued = stream->write_cache - stream->read_pos;
+        if (queued < want) {
+            stream->underruns += want - queued;
+            want = queued;
+        }
+    }
+    stream_span(stream, stream->read_pos, want, span);
+    return want;
+}
+
+void audio_stream_read_release(audio_stream_t *stream, uint32_t frames)
+{
+    uint32_t read = stream->read_pos + frames;
+
+    __atomic_store_n(&stream->read_pos, read, __ATOMIC_RELEASE);
+
+    if (stream->write_cache - read <= stream->low_mark || stream->below_low) {
+        // The cached write position understates the fill; confirm
+        stream->write_cache = __atomic_load_n(&stream->write_pos, __ATOMIC_ACQUIRE);
+    }
+    uint32_t fill = stream->write_cache - read;
+    if (fill > stream->low_mark) {
+        stream->below_low = false;
+    } else if (!stream->below_low) {
+        stream->below_low = true;
+        if (stream->on_mark) {
+            stream->on_mark(stream->mark_ctx, AUDIO_STREAM_MARK_LOW, fill);
+        }
+    }
+}
+
+uint32_t audio_stream_read(audio_stream_t *stream, int16_t *frames, uint32_t count)
+{
+    audio_span_t span;
+
+    count = audio_stream_read_acquire(stream, count, &span);
+    memcpy(frames, span.data[0], span.frames[0] * FRAME_BYTES);
+    memcpy(frames + span.frames[0] * AUDIO_STREAM_CHANNELS, span.data[1], span.frames[1] * FRAME_BYTES);
+    audio_stream_read_release(stream, count);
+    return count;
+}
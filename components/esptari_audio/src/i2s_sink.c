@@ -0,0 +1,249 @@
+/**
+ * @file i2s_sink.c
+ * @brief Low-latency local output on an I2S codec
+ */
+
+#include <string.h>
+#include "esp_attr.h"
+#include "esptari_i2s_sink.h"
+
+#define SINK_STACK_SIZE     3072
+#define SINK_WAIT_MS        20      // Wake-up without a DMA event, stop requests only
+#define SINK_WRITE_MS       1       // on_sent runs before the driver frees the descriptor
+
+static bool IRAM_ATTR sink_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *ctx)
+{
+    i2s_sink_t *sink = ctx;
+    BaseType_t woken = pdFALSE;
+
+    (void)handle;
+    (void)event;
+    __atomic_fetch_add(&sink->desc_sent, 1, __ATOMIC_RELAXED);
+    vTaskNotifyGiveFromISR(sink->task, &woken);
+    return woken == pdTRUE;
+}
+
+/** Every descriptor was free when one more finished: it went out without fresh data */
+static bool IRAM_ATTR sink_on_underrun(i2s_chan_handle_t handle, i2s_event_data_t *event, void *ctx)
+{
+    i2s_sink_t *sink = ctx;
+
+    (void)handle;
+    (void)event;
+    __atomic_fetch_add(&sink->underruns, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+/**
+ * Descriptors between the next one written and the DAC, the playing one
+ * included: the list less those freed and not refilled. An underrun pops
+ * a freed descriptor to play it, so it is not counted as played.
+ */
+static uint32_t sink_queued(const i2s_sink_t *sink)
+{
+    uint32_t sent = __atomic_load_n(&sink->desc_sent, __ATOMIC_RELAXED);    // First: errs high
+    uint32_t queued = sink->desc_written - (sent - __atomic_load_n(&sink->underruns, __ATOMIC_RELAXED));
+
+    return queued > sink->config.desc_num ? sink->config.desc_num : queued;
+}
+
+/**
+ * One descriptor of frames from the ring, into the DMA or its preload. Only
+ * what the driver took leaves the ring; it finishes a descriptor it was
+ * given in part on the next call.
+ */
+static esp_err_t sink_write_desc(i2s_sink_t *sink, bool preload)
+{
+    audio_span_t span;
+    uint32_t want = sink->config.frames_per_desc - sink->desc_fill;
+    uint32_t done_frames = 0;
+    esp_err_t ret = ESP_OK;
+
+    audio_stream_read_acquire(&sink->ring, want, &span);
+    for (int part = 0; part < 2 && ret == ESP_OK; part++) {
+        size_t bytes = span.frames[part] * I2S_SINK_FRAME_BYTES;
+        size_t done = 0;
+
+        if (!bytes) {
+            continue;
+        }
+        if (preload) {
+            ret = i2s_channel_preload_data(sink->config.tx, span.data[part], bytes, &done);
+        } else {
+            ret = i2s_channel_write(sink->config.tx, span.data[part], bytes, &done, SINK_WRITE_MS);
+        }
+        if (ret == ESP_OK && done != bytes) {
+            ret = ESP_ERR_TIMEOUT;
+        }
+        done_frames += done / I2S_SINK_FRAME_BYTES;
+    }
+    audio_stream_read_release(&sink->ring, done_frames);
+    sink->desc_fill += done_frames;
+    if (sink->desc_fill == sink->config.frames_per_desc) {
+        sink->desc_fill = 0;
+        sink->desc_written++;
+    }
+    return ret;
+}
+
+static void sink_measure(i2s_sink_t *sink)
+{
+    uint64_t frames = audio_stream_available(&sink->ring)
+                      + (uint64_t)sink_queued(sink) * sink->config.frames_per_desc;
+    uint32_t us = (uint32_t)(frames * 1000000 / sink->config.sample_rate);
+
+    if (!sink->latency_samples || us < sink->latency_min_us) {
+        sink->latency_min_us = us;
+    }
+    if (us > sink->latency_max_us) {
+        sink->latency_max_us = us;
+    }
+    sink->latency_sum_us += us;
+    sink->latency_samples++;
+}
+
+/**
+ * Wake the task from another task, if it still runs. It clears sink->task
+ * and waits for notifiers to drain before it deletes itself, so a handle
+ * read here stays valid until the notification is given.
+ */
+static void sink_notify(i2s_sink_t *sink)
+{
+    __atomic_fetch_add(&sink->notifiers, 1, __ATOMIC_SEQ_CST);
+    TaskHandle_t task = __atomic_load_n(&sink->task, __ATOMIC_SEQ_CST);
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+    __atomic_fetch_sub(&sink->notifiers, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Ring watermark: the producer filled a whole DMA list, enough to preload
+ * or to refill every free descriptor, so wake the task rather than wait
+ * for the next DMA event. Stays attached after a stop, as a no-op.
+ */
+static void sink_on_mark(void *ctx, audio_stream_mark_t mark, uint32_t fill)
+{
+    (void)fill;
+    if (mark == AUDIO_STREAM_MARK_HIGH) {
+        sink_notify(ctx);
+    }
+}
+
+static bool sink_stopping(const i2s_sink_t *sink)
+{
+    return __atomic_load_n(&sink->stop, __ATOMIC_RELAXED);
+}
+
+static void sink_task(void *arg)
+{
+    i2s_sink_t *sink = arg;
+    const i2s_sink_config_t *config = &sink->config;
+    uint32_t preload = config->desc_num * config->frames_per_desc;
+
+    while (!sink_stopping(sink) && audio_stream_available(&sink->ring) < preload) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SINK_WAIT_MS));     // From sink_on_mark()
+    }
+    for (uint32_t i = 0; !sink_stopping(sink) && i < config->desc_num; i++) {
+        sink_write_desc(sink, true);
+    }
+    if (!sink_stopping(sink)) {
+        i2s_channel_enable(config->tx);
+    }
+
+    while (!sink_stopping(sink)) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SINK_WAIT_MS));
+        while (sink_queued(sink) < config->desc_num
+               && audio_stream_available(&sink->ring) >= config->frames_per_desc) {
+            if (sink_write_desc(sink, false) != ESP_OK) {
+                break;
+            }
+        }
+        sink_measure(sink);
+    }
+
+    i2s_channel_disable(config->tx);    // No more on_sent from here
+    __atomic_store_n(&sink->task, NULL, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&sink->notifiers, __ATOMIC_ACQUIRE)) {
+        vTaskDelay(1);
+    }
+    __atomic_store_n(&sink->running, false, __ATOMIC_RELEASE);    // Stats final from here
+    vTaskDelete(NULL);
+}
+
+esp_err_t i2s_sink_init(i2s_sink_t *sink, const i2s_sink_config_t *config)
+{
+    const i2s_event_callbacks_t callbacks = {
+        .on_sent = sink_on_sent,
+        .on_send_q_ovf = sink_on_underrun,
+    };
+    esp_err_t ret;
+
+    memset(sink, 0, sizeof(*sink));
+    if (!config->sample_rate || !config->frames_per_desc || !config->desc_num
+        || config->frames_per_desc * I2S_SINK_FRAME_BYTES > I2S_SINK_DMA_BYTES_MAX
+        || config->ring_frames < config->desc_num * config->frames_per_desc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sink->config = *config;
+    ret = audio_stream_init(&sink->ring, config->sample_rate, config->frames_per_desc,
+                            config->ring_frames);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    // Only the high mark is used; the low one is the ring running dry
+    ret = audio_stream_set_marks(&sink->ring, 0, config->desc_num * config->frames_per_desc,
+                                 sink_on_mark, sink);
+    if (ret == ESP_OK) {
+        ret = i2s_channel_register_event_callback(config->tx, &callbacks, sink);
+    }
+    if (ret != ESP_OK) {
+        audio_stream_free(&sink->ring);
+    }
+    return ret;
+}
+
+esp_err_t i2s_sink_start(i2s_sink_t *sink)
+{
+    sink->stop = false;
+    sink->running = true;
+    if (xTaskCreatePinnedToCore(sink_task, "i2s_sink", SINK_STACK_SIZE, sink,
+                                sink->config.priority, &sink->task, sink->config.core) != pdPASS) {
+        sink->running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void i2s_sink_stop(i2s_sink_t *sink)
+{
+    __atomic_store_n(&sink->stop, true, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&sink->running, __ATOMIC_ACQUIRE)) {
+        sink_notify(sink);
+        vTaskDelay(1);
+    }
+}
+
+void i2s_sink_free(i2s_sink_t *sink)
+{
+    audio_stream_free(&sink->ring);
+}
+
+void i2s_sink_feed(void *ctx, const int16_t *frames, int count)
+{
+    i2s_sink_t *sink = ctx;
+
+    audio_stream_write(&sink->ring, frames, (uint32_t)count);
+}
+
+void i2s_sink_get_stats(const i2s_sink_t *sink, i2s_sink_stats_t *stats)
+{
+    stats->desc_written = sink->desc_written;
+    stats->desc_sent = __atomic_load_n(&sink->desc_sent, __ATOMIC_RELAXED);
+    stats->underruns = __atomic_load_n(&sink->underruns, __ATOMIC_RELAXED);
+    stats->ring_overruns = sink->ring.overruns;
+    stats->latency_min_us = sink->latency_min_us;
+    stats->latency_max_us = sink->latency_max_us;
+    stats->latency_avg_us = sink->latency_samples
+                            ? (uint32_t)(sink->latency_sum_us / sink->latency_samples) : 0;
+}
@@ -0,0 +1,332 @@
+/**
+ * @file mixer.c
+ * @brief Polyphase resampling, LMC1992 mix, volume and tone
+ */
+
+#include <math.h>
+#include <string.h>
+#include "esptari_audio.h"
+
+#define RS_ONE              (1ull << 32)
+#define RS_PHASE_SHIFT      26          // 32 - log2(AUDIO_RS_PHASES)
+#define RS_MAX_RATE         (2 * AUDIO_OUT_RATE)
+
+#define LMC_MIX_YM_FULL     1
+#define LMC_BASS_FLAT       6
+#define LMC_MASTER_MAX      40
+#define LMC_SIDE_MAX        20
+
+/** 16384 * 10^(-2k / 20): attenuation in 2 dB steps, Q14 */
+static const int16_t s_db_steps[LMC_MASTER_MAX + 1] = {
+    16384, 13014, 10338, 8211, 6523, 5181, 4115, 3269, 2597, 2063,
+    1638, 1301, 1034, 821, 652, 518, 412, 327, 260, 206,
+    164, 130, 103, 82, 65, 52, 41, 33, 26, 21,
+    16, 13, 10, 8, 7, 5, 4, 3, 3, 2,
+    2,
+};
+
+/** 10^(dB / 20) - 1 from -12 to +12 dB in 2 dB steps, Q12 */
+static const int16_t s_tone_gain[2 * LMC_BASS_FLAT + 1] = {
+    -3067, -2801, -2465, -2043, -1512, -842, 0, 1061, 2396, 4077, 6193, 8857, 12210,
+};
+
+/**
+ * One-pole shelf coefficients by step, g / (1 + g) with g = tan(pi fc /
+ * AUDIO_OUT_RATE), Q15: trapezoidal integrators, so the shelves keep their
+ * analog shape up to Nyquist. Corners are 100 Hz and 5 kHz; a cut moves
+ * its corner by the gain so that it is the exact inverse of the boost of
+ * the same size.
+ */
+static const int16_t s_bass_a[2 * LMC_BASS_FLAT + 1] = {
+    832, 665, 530, 422, 336, 268, 213, 213, 213, 213, 213, 213, 213,
+};
+static const int16_t s_treble_a[2 * LMC_BASS_FLAT + 1] = {
+    2494, 3083, 3796, 4653, 5675, 6884, 8304, 8304, 8304, 8304, 8304, 8304, 8304,
+};
+
+/** YM share of the mix by input select, Q14; 3 is reserved and plays DMA only */
+static const int16_t s_ym_mix[4] = { 4115, 16384, 0, 0 };
+
+static bool rs_rate_valid(uint32_t rate)
+{
+    return rate && rate <= RS_MAX_RATE;
+}
+
+/**
+ * Blackman-windowed sinc at AUDIO_RS_CUTOFF of the lower rate, one row per
+ * sub-frame position plus the next whole frame for interpolating, each
+ * row summing to exactly 1 << 14. Same construction as the YM2149 BLEP.
+ */
+static void rs_set_rate(audio_source_t *src, uint32_t rate)
+{
+    const int half = AUDIO_RS_TAPS / 2;
+    float cutoff = AUDIO_RS_CUTOFF;
+
+    src->rate = rate;
+    src->step = ((uint64_t)rate << 32) / AUDIO_OUT_RATE;
+    src->bypass = rate == AUDIO_OUT_RATE;
+    if (src->bypass) {
+        return;
+    }
+    if (rate > AUDIO_OUT_RATE) {
+        cutoff = cutoff * AUDIO_OUT_RATE / rate;
+    }
+    for (int p = 0; p <= AUDIO_RS_PHASES; p++) {
+        float frac = (float)p / AUDIO_RS_PHASES;
+        float taps[AUDIO_RS_TAPS];
+        float total = 0.0f;
+
+        for (int k = 0; k < AUDIO_RS_TAPS; k++) {
+            float t = k - half - frac + 1;
+            float x = 2 * cutoff * t;
+            float sinc = x == 0.0f ? 1.0f : sinf((float)M_PI * x) / ((float)M_PI * x);
+            float w = (t + half) / AUDIO_RS_TAPS;
+            float window = (w >= 0.0f && w <= 1.0f)
+                ? 0.42f - 0.5f * cosf(2 * (float)M_PI * w) + 0.08f * cosf(4 * (float)M_PI * w)
+                : 0.0f;
+
+            taps[k] = sinc * window;
+            total += taps[k];
+        }
+        int sum = 0;
+        for (int k = 0; k < AUDIO_RS_TAPS; k++) {
+            src->kernel[p][k] = (int16_t)lrintf(taps[k] / total * 16384);
+            sum += src->kernel[p][k];
+        }
+        src->kernel[p][half] += 16384 - sum;    // Exact DC gain despite rounding
+    }
+}
+
+/** Next source frame into the history; held if the FIFO ran dry */
+static void rs_pull(audio_mixer_t *mx, audio_source_t *src, int id)
+{
+    const int16_t *frame;
+    int newest = src->hpos;
+
+    src->hpos = (src->hpos + 1) % AUDIO_RS_TAPS;
+    if (src->tail != src->head) {
+        frame = src->fifo[src->tail++ & (AUDIO_SRC_FIFO - 1)];
+    } else {
+        frame = src->hist[newest];
+        mx->stats.underruns[id] += src->pushed;
+    }
+    int16_t l = frame[0], r = frame[1];
+    src->hist[src->hpos][0] = src->hist[src->hpos + AUDIO_RS_TAPS][0] = l;
+    src->hist[src->hpos][1] = src->hist[src->hpos + AUDIO_RS_TAPS][1] = r;
+}
+
+/** Resample @p count output frames of source @p id into mx->acc, scaled by @p gain (Q14) */
+static void rs_render(audio_mixer_t *mx, int id, int count, int32_t gain, bool add)
+{
+    audio_source_t *src = &mx->src[id];
+    int32_t *acc = mx->acc;
+
+    for (int i = 0; i < count; i++) {
+        int32_t l, r;
+
+        src->phase += src->step;
+        while (src->phase >= RS_ONE) {
+            src->phase -= RS_ONE;
+            rs_pull(mx, src, id);
+        }
+        if (src->bypass) {
+            l = src->hist[src->hpos][0];
+            r = src->hist[src->hpos][1];
+        } else {
+            // Taps from the oldest frame to the newest, phase interpolated
+            const int16_t (*h)[2] = &src->hist[src->hpos + 1];
+            uint32_t frac = (uint32_t)src->phase;
+            const int16_t *k0 = src->kernel[frac >> RS_PHASE_SHIFT];
+            const int16_t *k1 = k0 + AUDIO_RS_TAPS;
+            int32_t w = (frac >> (RS_PHASE_SHIFT - 15)) & 0x7FFF;
+            int32_t sl = 1 << 13, sr = 1 << 13;
+
+            for (int k = 0; k < AUDIO_RS_TAPS; k++) {
+                int32_t c = k0[k] + (((k1[k] - k0[k]) * w) >> 15);
+                sl += h[k][0] * c;
+                sr += h[k][1] * c;
+            }
+            l = sl >> 14;
+            r = sr >> 14;
+        }
+        if (gain != 16384) {
+            l = (l * gain) >> 14;
+            r = (r * gain) >> 14;
+        }
+        if (add) {
+            acc[2 * i] += l;
+            acc[2 * i + 1] += r;
+        } else {
+            acc[2 * i] = l;
+            acc[2 * i + 1] = r;
+        }
+    }
+}
+
+static void lmc_update(audio_mixer_t *mx)
+{
+    const audio_lmc_t *lmc = &mx->lmc;
+    int32_t master = s_db_steps[LMC_MASTER_MAX - lmc->master];
+
+    mx->ym_gain = s_ym_mix[lmc->mix];
+    mx->volume[0] = (master * s_db_steps[LMC_SIDE_MAX - lmc->left]) >> 14;
+    mx->volume[1] = (master * s_db_steps[LMC_SIDE_MAX - lmc->right]) >> 14;
+    mx->bass_gain = s_tone_gain[lmc->bass];
+    mx->bass_a = s_bass_a[lmc->bass];
+    mx->treble_gain = s_tone_gain[lmc->treble];
+    mx->treble_a = s_treble_a[lmc->treble];
+    mx->flat = lmc->bass == LMC_BASS_FLAT && lmc->treble == LMC_BASS_FLAT;
+}
+
+/** Volume, tone and saturation of mx->acc into mx->block */
+static void lmc_render(audio_mixer_t *mx, int count)
+{
+    for (int i = 0; i < 2 * count; i++) {
+        int ch = i & 1;
+        int32_t v = (mx->acc[i] * mx->volume[ch]) >> 14;
+
+        if (!mx->flat) {
+            // Parallel shelves: v + (gb - 1) * lowpass(v) + (gt - 1) * highpass(v)
+            int32_t in = v * 256;
+            int32_t bv = (int32_t)(((int64_t)(in - mx->bass_lp[ch]) * mx->bass_a) >> 15);
+            int32_t tv = (int32_t)(((int64_t)(in - mx->treble_lp[ch]) * mx->treble_a) >> 15);
+            int32_t bass = mx->bass_lp[ch] + bv;
+            int32_t treble = in - (mx->treble_lp[ch] + tv);
+
+            mx->bass_lp[ch] = bass + bv;
+            mx->treble_lp[ch] += 2 * tv;
+            v += (mx->bass_gain * (bass >> 8)) >> 12;
+            v += (mx->treble_gain * (treble >> 8)) >> 12;
+        }
+        if (v > INT16_MAX || v < INT16_MIN) {
+            v = v > 0 ? INT16_MAX : INT16_MIN;
+            mx->stats.clipped++;
+        }
+        mx->block[i] = (int16_t)v;
+    }
+}
+
+esp_err_t audio_mixer_init(audio_mixer_t *mx, const audio_mixer_config_t *config)
+{
+    if (!config->clock_hz || !rs_rate_valid(config->ym_rate)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(mx, 0, sizeof(*mx));
+    mx->config = *config;
+    rs_set_rate(&mx->src[AUDIO_SRC_YM], config->ym_rate);
+    rs_set_rate(&mx->src[AUDIO_SRC_DMA], AUDIO_DMA_RATE_50K);
+
+    mx->lmc = (audio_lmc_t) {
+        .mix = LMC_MIX_YM_FULL,
+        .bass = LMC_BASS_FLAT,
+        .treble = LMC_BASS_FLAT,
+        .master = LMC_MASTER_MAX,
+        .left = LMC_SIDE_MAX,
+        .right = LMC_SIDE_MAX,
+    };
+    lmc_update(mx);
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_set_dma_rate(audio_mixer_t *mx, uint32_t rate)
+{
+    if (!rs_rate_valid(rate)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (rate != mx->src[AUDIO_SRC_DMA].rate) {
+        rs_set_rate(&mx->src[AUDIO_SRC_DMA], rate);
+    }
+    return ESP_OK;
+}
+
+void audio_mixer_push(audio_mixer_t *mx, audio_src_id_t id, const int16_t *frames, int count)
+{
+    audio_source_t *src = &mx->src[id];
+
+    for (int i = 0; i < count; i++) {
+        if (src->head - src->tail == AUDIO_SRC_FIFO) {
+            src->tail++;
+            mx->stats.overruns[id]++;
+        }
+        int16_t *slot = src->fifo[src->head++ & (AUDIO_SRC_FIFO - 1)];
+        slot[0] = frames[2 * i];
+        slot[1] = frames[2 * i + 1];
+    }
+    src->pushed |= count > 0;
+}
+
+void audio_mixer_push_dma(audio_mixer_t *mx, const int8_t *data, int count, bool stereo)
+{
+    audio_source_t *src = &mx->src[AUDIO_SRC_DMA];
+
+    for (int i = 0; i < count; i++) {
+        int16_t l = (int16_t)(data[stereo ? 2 * i : i] * 256);
+        int16_t r = stereo ? (int16_t)(data[2 * i + 1] * 256) : l;
+
+        if (src->head - src->tail == AUDIO_SRC_FIFO) {
+            src->tail++;
+            mx->stats.overruns[AUDIO_SRC_DMA]++;
+        }
+        int16_t *slot = src->fifo[src->head++ & (AUDIO_SRC_FIFO - 1)];
+        slot[0] = l;
+        slot[1] = r;
+    }
+    src->pushed |= count > 0;
+}
+
+esp_err_t audio_mixer_lmc_write(audio_mixer_t *mx, uint16_t command)
+{
+    static const uint8_t max[6] = { 3, 12, 12, LMC_MASTER_MAX, LMC_SIDE_MAX, LMC_SIDE_MAX };
+    int reg = (command >> 6) & 7;
+    uint8_t val = command & 0x3F;
+
+    if (((command >> 9) & 3) != AUDIO_LMC_ADDRESS || reg > AUDIO_LMC_LEFT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (val > max[reg]) {
+        val = max[reg];
+    }
+    switch (reg) {
+    case AUDIO_LMC_MIX:    mx->lmc.mix = val;    break;
+    case AUDIO_LMC_BASS:   mx->lmc.bass = val;   break;
+    case AUDIO_LMC_TREBLE: mx->lmc.treble = val; break;
+    case AUDIO_LMC_MASTER: mx->lmc.master = val; break;
+    case AUDIO_LMC_RIGHT:  mx->lmc.right = val;  break;
+    case AUDIO_LMC_LEFT:   mx->lmc.left = val;   break;
+    }
+    lmc_update(mx);
+    return ESP_OK;
+}
+
+int audio_mixer_frame(audio_mixer_t *mx, uint32_t cycles)
+{
+    uint64_t owed;
+    int total;
+
+    mx->out_acc += (uint64_t)cycles * AUDIO_OUT_RATE;
+    owed = mx->out_acc / mx->config.clock_hz;
+    mx->out_acc -= owed * mx->config.clock_hz;
+    total = (int)owed;
+
+    while (owed) {
+        int count = owed > AUDIO_BLOCK_MAX ? AUDIO_BLOCK_MAX : (int)owed;
+
+        rs_render(mx, AUDIO_SRC_DMA, count, 16384, false);
+        rs_render(mx, AUDIO_SRC_YM, count, mx->ym_gain, true);     // Drains its FIFO even muted
+        lmc_render(mx, count);
+
+        if (mx->config.stream) {
+            audio_stream_write(mx->config.stream, mx->block, count);   // Counts its overruns
+        }
+        if (mx->config.sink) {
+            mx->config.sink(mx->config.sink_ctx, mx->block, count);
+        }
+        mx->stats.blocks++;
+        mx->stats.frames += count;
+        owed -= count;
+    }
+    for (int id = 0; id < AUDIO_SRC_COUNT; id++) {
+        mx->src[id].pushed = false;
+    }
+    return total;
+}
@@ -0,0 +1,234 @@
+/**
+ * @file test_audio_stream.c
+ * @brief SPSC audio ring tests: spans, counters, watermarks, two threads
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include "unity.h"
+#include "esptari_audio_stream.h"
+
+#define STRESS_CAPACITY     256
+#define STRESS_FRAMES       (1u << 21)
+
+static audio_stream_t s_stream;
+
+typedef struct {
+    uint32_t low;
+    uint32_t high;
+    uint32_t last_fill;
+} marks_t;
+
+static void count_mark(void *ctx, audio_stream_mark_t mark, uint32_t fill)
+{
+    marks_t *marks = ctx;
+
+    __atomic_fetch_add(mark == AUDIO_STREAM_MARK_LOW ? &marks->low : &marks->high, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&marks->last_fill, fill, __ATOMIC_RELAXED);
+}
+
+static void fill_frames(int16_t *frames, uint32_t count, uint32_t seq)
+{
+    for (uint32_t i = 0; i < count; i++, seq++) {
+        frames[2 * i] = (int16_t)seq;
+        frames[2 * i + 1] = (int16_t)~seq;
+    }
+}
+
+TEST_CASE("audio stream spans wrap and count overruns and underruns", "[audio]")
+{
+    audio_span_t span;
+    int16_t in[16 * 2], out[16 * 2];
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_stream_init(&s_stream, 48000, 960, 12));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_init(&s_stream, 48000, 960, 8));
+    TEST_ASSERT_EQUAL(0, (uintptr_t)&s_stream.write_pos % AUDIO_CACHE_LINE);
+    TEST_ASSERT_EQUAL(AUDIO_CACHE_LINE, (uintptr_t)&s_stream.read_pos - (uintptr_t)&s_stream.write_pos);
+
+    fill_frames(in, 16, 0);
+    TEST_ASSERT_EQUAL(6, audio_stream_write(&s_stream, in, 6));
+    TEST_ASSERT_EQUAL(4, audio_stream_read(&s_stream, out, 4));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(in, out, 4 * 2);
+
+    // 6 frames of room from position 6: two before the wrap, four after
+    TEST_ASSERT_EQUAL(6, audio_stream_write_acquire(&s_stream, 10, &span));
+    TEST_ASSERT_EQUAL(4, s_stream.overruns);
+    TEST_ASSERT_EQUAL(2, span.frames[0]);
+    TEST_ASSERT_EQUAL(4, span.frames[1]);
+    TEST_ASSERT_EQUAL_PTR(s_stream.buffer + 6 * 2, span.data[0]);
+    TEST_ASSERT_EQUAL_PTR(s_stream.buffer, span.data[1]);
+    memcpy(span.data[0], in + 6 * 2, span.frames[0] * 4);
+    memcpy(span.data[1], in + 8 * 2, span.frames[1] * 4);
+    audio_stream_write_commit(&s_stream, 6);
+    TEST_ASSERT_EQUAL(8, audio_stream_available(&s_stream));
+
+    // Drain across the wrap in place, releasing in two steps
+    TEST_ASSERT_EQUAL(8, audio_stream_read_acquire(&s_stream, 8, &span));
+    TEST_ASSERT_EQUAL(4, span.frames[0]);
+    TEST_ASSERT_EQUAL(4, span.frames[1]);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(in + 4 * 2, span.data[0], 4 * 2);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(in + 8 * 2, span.data[1], 4 * 2);
+    audio_stream_read_release(&s_stream, 5);
+    TEST_ASSERT_EQUAL(3, audio_stream_read(&s_stream, out, 5));
+    TEST_ASSERT_EQUAL(2, s_stream.underruns);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(in + 9 * 2, out, 3 * 2);
+    TEST_ASSERT_EQUAL(0, audio_stream_available(&s_stream));
+
+    audio_stream_free(&s_stream);
+}
+
+TEST_CASE("audio stream init validates first and refuses to re-init", "[audio]")
+{
+    int16_t in[4 * 2], out[4 * 2];
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_init(&s_stream, 48000, 960, 8));
+    int16_t *buffer = s_stream.buffer;
+    fill_frames(in, 4, 7);
+    TEST_ASSERT_EQUAL(4, audio_stream_write(&s_stream, in, 4));
+
+    // Neither a bad capacity nor a second init touches the live stream
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_stream_init(&s_stream, 48000, 960, 12));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, audio_stream_init(&s_stream, 44100, 882, 16));
+    TEST_ASSERT_EQUAL_PTR(buffer, s_stream.buffer);
+    TEST_ASSERT_EQUAL(8, s_stream.capacity);
+    TEST_ASSERT_EQUAL(48000, s_stream.sample_rate);
+    TEST_ASSERT_EQUAL(4, audio_stream_read(&s_stream, out, 4));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(in, out, 4 * 2);
+
+    audio_stream_free(&s_stream);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_init(&s_stream, 44100, 882, 16));
+    TEST_ASSERT_EQUAL(16, s_stream.capacity);
+    TEST_ASSERT_EQUAL(0, audio_stream_available(&s_stream));
+    audio_stream_free(&s_stream);
+}
+
+TEST_CASE("audio stream watermarks fire once per crossing", "[audio]")
+{
+    marks_t marks = {0};
+    int16_t frames[64 * 2] = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_init(&s_stream, 48000, 960, 64));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_stream_set_marks(&s_stream, 40, 40, count_mark, &marks));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_stream_set_marks(&s_stream, 8, 65, count_mark, &marks));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_set_marks(&s_stream, 8, 48, count_mark, &marks));
+
+    audio_stream_write(&s_stream, frames, 40);
+    TEST_ASSERT_EQUAL(0, marks.high);
+    audio_stream_write(&s_stream, frames, 10);
+    audio_stream_write(&s_stream, frames, 10);
+    TEST_ASSERT_EQUAL(1, marks.high);
+    TEST_ASSERT_EQUAL(50, marks.last_fill);
+
+    audio_stream_read(&s_stream, frames, 30);
+    audio_stream_read(&s_stream, frames, 20);
+    TEST_ASSERT_EQUAL(0, marks.low);
+    audio_stream_read(&s_stream, frames, 4);
+    audio_stream_read(&s_stream, frames, 4);
+    TEST_ASSERT_EQUAL(1, marks.low);
+    TEST_ASSERT_EQUAL(6, marks.last_fill);
+
+    // The producer sees the fill low again, which re-arms the high mark
+    audio_stream_write(&s_stream, frames, 1);
+    audio_stream_write(&s_stream, frames, 50);
+    TEST_ASSERT_EQUAL(2, marks.high);
+    TEST_ASSERT_EQUAL(1, marks.low);
+
+    audio_stream_free(&s_stream);
+}
+
+typedef struct {
+    uint32_t seed;
+    uint32_t frames;                // Frames moved
+    uint32_t short_by;              // Wanted but not granted, as the ring counts it
+    uint32_t errors;
+} stress_side_t;
+
+static uint32_t stress_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 16;
+}
+
+/** 1 to 96 frames, none past STRESS_FRAMES */
+static uint32_t stress_want(stress_side_t *side)
+{
+    uint32_t want = 1 + stress_rand(&side->seed) % 96;
+    uint32_t left = STRESS_FRAMES - side->frames;
+
+    return want < left ? want : left;
+}
+
+static void *stress_producer(void *arg)
+{
+    stress_side_t *side = arg;
+    audio_span_t span;
+
+    while (side->frames < STRESS_FRAMES) {
+        uint32_t want = stress_want(side);
+        uint32_t got = audio_stream_write_acquire(&s_stream, want, &span);
+
+        side->short_by += want - got;
+        fill_frames(span.data[0], span.frames[0], side->frames);
+        fill_frames(span.data[1], span.frames[1], side->frames + span.frames[0]);
+        audio_stream_write_commit(&s_stream, got);
+        side->frames += got;
+        if (!got) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *stress_consumer(void *arg)
+{
+    stress_side_t *side = arg;
+    audio_span_t span;
+
+    while (side->frames < STRESS_FRAMES) {
+        uint32_t want = stress_want(side);
+        uint32_t got = audio_stream_read_acquire(&s_stream, want, &span);
+
+        side->short_by += want - got;
+        for (int part = 0; part < 2; part++) {
+            for (uint32_t i = 0; i < span.frames[part]; i++, side->frames++) {
+                const int16_t *frame = span.data[part] + 2 * i;
+
+                side->errors += frame[0] != (int16_t)side->frames || frame[1] != (int16_t)~side->frames;
+            }
+        }
+        audio_stream_read_release(&s_stream, got);
+        if (!got) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+TEST_CASE("audio stream survives a producer and a consumer thread", "[audio]")
+{
+    marks_t marks = {0};
+    stress_side_t producer = { .seed = 1 };
+    stress_side_t consumer = { .seed = 2 };
+    pthread_t threads[2];
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_init(&s_stream, 48000, 960, STRESS_CAPACITY));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_set_marks(&s_stream, STRESS_CAPACITY / 4,
+                                                     STRESS_CAPACITY * 3 / 4, count_mark, &marks));
+    TEST_ASSERT_EQUAL(0, pthread_create(&threads[0], NULL, stress_producer, &producer));
+    TEST_ASSERT_EQUAL(0, pthread_create(&threads[1], NULL, stress_consumer, &consumer));
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    // Every frame arrived once, in order, and the counters match both sides
+    TEST_ASSERT_EQUAL(0, consumer.errors);
+    TEST_ASSERT_EQUAL(STRESS_FRAMES, producer.frames);
+    TEST_ASSERT_EQUAL(STRESS_FRAMES, consumer.frames);
+    TEST_ASSERT_EQUAL(0, audio_stream_available(&s_stream));
+    TEST_ASSERT_EQUAL(producer.short_by, s_stream.overruns);
+    TEST_ASSERT_EQUAL(consumer.short_by, s_stream.underruns);
+    TEST_ASSERT_GREATER_THAN(0, marks.low + marks.high);
+
+    audio_stream_free(&s_stream);
+}
@@ -0,0 +1,198 @@
+/**
+ * @file test_i2s_sink.c
+ * @brief I2S sink tests: preload and refill, underruns, stop, feeds after stop
+ *
+ * On a host the channel is the timed stand-in of bench/i2s_host, which
+ * also counts the descriptors it played stale. On a target it is a real
+ * TX channel with no pins; the DMA runs all the same. The feed is paced
+ * by the ring fill, not by a clock, so the tests hold on a loaded host.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "esptari_i2s_sink.h"
+
+#define TEST_RATE           48000
+#define TEST_DESC_FRAMES    240     // 5 ms
+#define TEST_DESC_NUM       4
+#define TEST_RING_FRAMES    2048
+#define TEST_WAIT_TICKS     2000    // Per wait, far longer than any test needs
+
+static i2s_sink_t s_sink;
+static int16_t s_desc[TEST_DESC_FRAMES * 2];
+
+#ifdef ESP_PLATFORM
+#include "driver/i2s_std.h"
+
+static i2s_chan_handle_t test_new_tx(void)
+{
+    i2s_chan_config_t chan_config = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
+    i2s_std_config_t std_config = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(TEST_RATE),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = I2S_GPIO_UNUSED,
+            .ws = I2S_GPIO_UNUSED,
+            .dout = I2S_GPIO_UNUSED,
+            .din = I2S_GPIO_UNUSED,
+        },
+    };
+    i2s_chan_handle_t tx;
+
+    chan_config.dma_desc_num = TEST_DESC_NUM;
+    chan_config.dma_frame_num = TEST_DESC_FRAMES;
+    chan_config.auto_clear = true;
+    TEST_ASSERT_EQUAL(ESP_OK, i2s_new_channel(&chan_config, &tx, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, i2s_channel_init_std_mode(tx, &std_config));
+    return tx;
+}
+
+static void test_del_tx(i2s_chan_handle_t tx)
+{
+    i2s_del_channel(tx);
+}
+#else
+static i2s_chan_handle_t test_new_tx(void)
+{
+    i2s_chan_handle_t tx;
+
+    TEST_ASSERT_EQUAL(ESP_OK, host_i2s_new_tx(TEST_RATE, TEST_DESC_NUM, TEST_DESC_FRAMES, NULL, &tx));
+    return tx;
+}
+
+static void test_del_tx(i2s_chan_handle_t tx)
+{
+    host_i2s_del(tx);
+}
+#endif
+
+static i2s_chan_handle_t test_start(void)
+{
+    i2s_chan_handle_t tx = test_new_tx();
+    i2s_sink_config_t config = {
+        .tx = tx,
+        .sample_rate = TEST_RATE,
+        .frames_per_desc = TEST_DESC_FRAMES,
+        .desc_num = TEST_DESC_NUM,
+        .ring_frames = TEST_RING_FRAMES,
+        .priority = 5,
+    };
+
+    for (int i = 0; i < TEST_DESC_FRAMES; i++) {
+        s_desc[2 * i] = (int16_t)(i * 100);
+        s_desc[2 * i + 1] = (int16_t)(-i * 100);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, i2s_sink_init(&s_sink, &config));
+    TEST_ASSERT_EQUAL(ESP_OK, i2s_sink_start(&s_sink));
+    return tx;
+}
+
+static uint32_t test_sent(void)
+{
+    i2s_sink_stats_t stats;
+
+    i2s_sink_get_stats(&s_sink, &stats);
+    return stats.desc_sent;
+}
+
+/** Keep a DMA list of audio in the ring until @p count more descriptors have been sent */
+static void test_feed_for(uint32_t count)
+{
+    uint32_t until = test_sent() + count;
+
+    for (int ticks = 0; test_sent() < until; ) {
+        if (audio_stream_available(&s_sink.ring) < TEST_DESC_NUM * TEST_DESC_FRAMES) {
+            i2s_sink_feed(&s_sink, s_desc, TEST_DESC_FRAMES);
+        } else {
+            TEST_ASSERT_LESS_THAN(TEST_WAIT_TICKS, ticks++);
+            vTaskDelay(1);
+        }
+    }
+}
+
+/** Feed nothing while @p count more descriptors are sent */
+static void test_starve_for(uint32_t count)
+{
+    uint32_t until = test_sent() + count;
+
+    for (int ticks = 0; test_sent() < until; ticks++) {
+        TEST_ASSERT_LESS_THAN(TEST_WAIT_TICKS, ticks);
+        vTaskDelay(1);
+    }
+}
+
+TEST_CASE("i2s sink preloads a full list, refills and stops", "[audio]")
+{
+    i2s_chan_handle_t tx = test_start();
+    i2s_sink_stats_t stats;
+
+    /* Nothing is played before the whole list is there to preload */
+    i2s_sink_feed(&s_sink, s_desc, TEST_DESC_FRAMES);
+    vTaskDelay(pdMS_TO_TICKS(30));
+    TEST_ASSERT_EQUAL(0, test_sent());
+
+    test_feed_for(40);
+    i2s_sink_stop(&s_sink);
+    TEST_ASSERT_FALSE(s_sink.running);
+    TEST_ASSERT_NULL(s_sink.task);
+
+    i2s_sink_get_stats(&s_sink, &stats);
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_DESC_NUM + 36, stats.desc_written);
+    TEST_ASSERT_GREATER_OR_EQUAL(40, stats.desc_sent);
+    TEST_ASSERT_EQUAL(0, stats.ring_overruns);
+    /* A list in the DMA and one in the ring, with slack for a late wake-up */
+    TEST_ASSERT_LESS_OR_EQUAL((2 * TEST_DESC_NUM + 2) * 5000, stats.latency_max_us);
+
+    i2s_sink_free(&s_sink);
+    test_del_tx(tx);
+}
+
+TEST_CASE("i2s sink counts the descriptors played without fresh data", "[audio]")
+{
+    i2s_chan_handle_t tx = test_start();
+    i2s_sink_stats_t stats;
+
+    test_feed_for(10);
+    i2s_sink_get_stats(&s_sink, &stats);
+    uint32_t before = stats.underruns;
+
+    /* The ring and the list drain within about ten descriptors, the rest are stale */
+    test_starve_for(24);
+    i2s_sink_get_stats(&s_sink, &stats);
+    TEST_ASSERT_GREATER_OR_EQUAL(before + 10, stats.underruns);
+
+    /* Fed again, it goes back to playing fresh descriptors */
+    test_feed_for(20);
+    i2s_sink_stop(&s_sink);
+#ifndef ESP_PLATFORM
+    host_i2s_stats_t played;
+
+    i2s_sink_get_stats(&s_sink, &stats);
+    host_i2s_get_stats(tx, &played);
+    TEST_ASSERT_UINT32_WITHIN(1, played.stale, stats.underruns);
+#endif
+
+    i2s_sink_free(&s_sink);
+    test_del_tx(tx);
+}
+
+TEST_CASE("i2s sink takes feeds after stop", "[audio]")
+{
+    i2s_chan_handle_t tx = test_start();
+
+    test_feed_for(10);
+    test_starve_for(2 * TEST_DESC_NUM + 2);
+    i2s_sink_stop(&s_sink);
+
+    /* The emulation goes on: the ring crosses its high mark with the task gone */
+    TEST_ASSERT_LESS_THAN(TEST_DESC_NUM * TEST_DESC_FRAMES, audio_stream_available(&s_sink.ring));
+    for (int i = 0; i < TEST_RING_FRAMES / TEST_DESC_FRAMES + 2; i++) {
+        i2s_sink_feed(&s_sink, s_desc, TEST_DESC_FRAMES);
+    }
+    TEST_ASSERT_EQUAL(TEST_RING_FRAMES, audio_stream_available(&s_sink.ring));
+    TEST_ASSERT_GREATER_THAN(0, s_sink.ring.overruns);
+
+    i2s_sink_free(&s_sink);
+    test_del_tx(tx);
+}
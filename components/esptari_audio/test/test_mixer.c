@@ -0,0 +1,287 @@
+/**
+ * @file test_mixer.c
+ * @brief Output stage tests: block sizes, resampling, LMC1992, sinks
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "unity.h"
+#include "esptari_audio.h"
+
+#define CLOCK_HZ        8000000
+#define FRAME_CYCLES    160000      // 50 Hz
+#define FRAME_OUT       (AUDIO_OUT_RATE / 50)
+
+static audio_mixer_t s_mx;
+static int16_t s_in[4096 * 2];
+static int8_t s_dma[4096 * 2];
+static int16_t s_sunk[FRAME_OUT * 2];
+static int s_sunk_count;
+
+static void test_sink(void *ctx, const int16_t *frames, int count)
+{
+    memcpy(s_sunk, frames, (size_t)count * 2 * sizeof(int16_t));
+    s_sunk_count = count;
+    (*(int *)ctx)++;
+}
+
+static void mixer_init(uint32_t ym_rate)
+{
+    audio_mixer_config_t config = {
+        .clock_hz = CLOCK_HZ,
+        .ym_rate = ym_rate,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_init(&s_mx, &config));
+}
+
+static uint16_t lmc(int reg, int val)
+{
+    return (uint16_t)((AUDIO_LMC_ADDRESS << 9) | (reg << 6) | val);
+}
+
+/** Source frames produced over @p frame emulated frames, as a chip with its own accumulator does */
+static int frames_due(uint32_t rate, int frame)
+{
+    return (int)((uint64_t)(frame + 1) * FRAME_CYCLES * rate / CLOCK_HZ
+                 - (uint64_t)frame * FRAME_CYCLES * rate / CLOCK_HZ);
+}
+
+/** Play a @p hz sine on DMA at @p rate for @p frames frames, return the output RMS of the last */
+static double play_dma_sine(uint32_t rate, double hz, double amp, int frames)
+{
+    static double t;
+    double sum = 0.0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_set_dma_rate(&s_mx, rate));
+    for (int f = 0; f < frames; f++) {
+        int n = frames_due(rate, f);
+
+        for (int i = 0; i < n; i++, t += 1.0 / rate) {
+            s_dma[i] = (int8_t)lrint(amp * sin(2 * M_PI * hz * t));
+        }
+        audio_mixer_push_dma(&s_mx, s_dma, n, false);
+        TEST_ASSERT_EQUAL(FRAME_OUT, audio_mixer_frame(&s_mx, FRAME_CYCLES));
+    }
+    for (int i = 0; i < FRAME_OUT; i++) {
+        sum += (double)s_mx.block[2 * i] * s_mx.block[2 * i];
+    }
+    return sqrt(sum / FRAME_OUT);
+}
+
+/** Amplitude of @p hz in the left channel of the last block, Hann windowed */
+static double block_level(double hz)
+{
+    double re = 0.0, im = 0.0;
+
+    for (int i = 0; i < FRAME_OUT; i++) {
+        double w = 0.5 - 0.5 * cos(2 * M_PI * i / FRAME_OUT);
+        double x = s_mx.block[2 * i] * w;
+
+        re += x * cos(2 * M_PI * hz * i / AUDIO_OUT_RATE);
+        im += x * sin(2 * M_PI * hz * i / AUDIO_OUT_RATE);
+    }
+    return 4 * sqrt(re * re + im * im) / FRAME_OUT;
+}
+
+TEST_CASE("mixer delivers one block per frame, carrying the fraction", "[audio]")
+{
+    int total = 0;
+
+    mixer_init(AUDIO_OUT_RATE);
+    TEST_ASSERT_EQUAL(FRAME_OUT, audio_mixer_frame(&s_mx, FRAME_CYCLES));
+
+    // 60 Hz: 133333.3 cycles, 800 frames on average
+    for (int f = 0; f < 60; f++) {
+        int n = audio_mixer_frame(&s_mx, f % 3 == 2 ? 133334 : 133333);
+        TEST_ASSERT_INT_WITHIN(1, 800, n);
+        total += n;
+    }
+    TEST_ASSERT_EQUAL(AUDIO_OUT_RATE, total);
+
+    // A stalled second comes out in blocks of at most AUDIO_BLOCK_MAX
+    uint32_t blocks = s_mx.stats.blocks;
+    TEST_ASSERT_EQUAL(2 * FRAME_OUT, audio_mixer_frame(&s_mx, 2 * FRAME_CYCLES));
+    TEST_ASSERT_EQUAL(blocks + 2, s_mx.stats.blocks);
+
+    audio_mixer_config_t bad = { .clock_hz = CLOCK_HZ, .ym_rate = 0 };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_mixer_init(&s_mx, &bad));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_set_dma_rate(&s_mx, AUDIO_DMA_RATE_6K));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_mixer_set_dma_rate(&s_mx, 200000));
+}
+
+TEST_CASE("mixer passes a 48 kHz YM source through bit-exact at flat settings", "[audio]")
+{
+    mixer_init(AUDIO_OUT_RATE);
+    for (int i = 0; i < FRAME_OUT * 2; i++) {
+        s_in[i] = (int16_t)(i * 37 - 20000);
+    }
+    audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_in, FRAME_OUT);
+    TEST_ASSERT_EQUAL(FRAME_OUT, audio_mixer_frame(&s_mx, FRAME_CYCLES));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(s_in, s_mx.block, FRAME_OUT * 2);
+    TEST_ASSERT_EQUAL(0, s_mx.stats.underruns[AUDIO_SRC_YM]);
+}
+
+TEST_CASE("mixer resamples every DMA rate at unity gain", "[audio]")
+{
+    static const uint32_t rates[] = {
+        AUDIO_DMA_RATE_6K, AUDIO_DMA_RATE_12K, AUDIO_DMA_RATE_25K, AUDIO_DMA_RATE_50K,
+    };
+    // 100 of 127 in 8 bits, scaled by 256
+    const double expect = 100 * 256 / sqrt(2);
+
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        mixer_init(AUDIO_OUT_RATE);
+        double rms = play_dma_sine(rates[i], 1000.0, 100.0, 20);
+        TEST_ASSERT_FLOAT_WITHIN(expect * 0.02, expect, rms);
+        TEST_ASSERT_EQUAL(0, s_mx.stats.overruns[AUDIO_SRC_DMA]);
+    }
+}
+
+TEST_CASE("mixer stays in step with a source at its own rate", "[audio]")
+{
+    mixer_init(AUDIO_OUT_RATE);
+    play_dma_sine(AUDIO_DMA_RATE_25K, 440.0, 90.0, 500);
+
+    // Each underrun delays the resampler by a frame, so they stop after a few
+    TEST_ASSERT_LESS_OR_EQUAL(3, s_mx.stats.underruns[AUDIO_SRC_DMA]);
+    TEST_ASSERT_EQUAL(0, s_mx.stats.overruns[AUDIO_SRC_DMA]);
+    TEST_ASSERT_LESS_OR_EQUAL(4, s_mx.src[AUDIO_SRC_DMA].head - s_mx.src[AUDIO_SRC_DMA].tail);
+    TEST_ASSERT_EQUAL(0, s_mx.stats.clipped);
+}
+
+TEST_CASE("mixer filters DMA images above the source band", "[audio]")
+{
+    static const uint32_t rates[] = { AUDIO_DMA_RATE_6K, AUDIO_DMA_RATE_12K, AUDIO_DMA_RATE_25K };
+
+    // A 1 kHz tone held at each rate has images at rate -/+ 1 kHz
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        mixer_init(AUDIO_OUT_RATE);
+        play_dma_sine(rates[i], 1000.0, 100.0, 20);
+
+        double tone = block_level(1000.0);
+        TEST_ASSERT_TRUE(block_level(rates[i] - 1000.0) < tone * 0.001);   // -60 dB
+        TEST_ASSERT_TRUE(block_level(rates[i] + 1000.0) < tone * 0.001);
+    }
+}
+
+TEST_CASE("mixer applies the LMC1992 input select and volumes", "[audio]")
+{
+    mixer_init(AUDIO_OUT_RATE);
+    for (int i = 0; i < FRAME_OUT; i++) {
+        s_in[2 * i] = s_in[2 * i + 1] = 16000;
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_lmc_write(&s_mx, lmc(AUDIO_LMC_MIX, 0)));
+    audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_in, FRAME_OUT);
+    audio_mixer_frame(&s_mx, FRAME_CYCLES);
+    TEST_ASSERT_INT_WITHIN(8, 4019, s_mx.block[100]);       // -12 dB
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_lmc_write(&s_mx, lmc(AUDIO_LMC_MIX, 2)));
+    audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_in, FRAME_OUT);
+    audio_mixer_frame(&s_mx, FRAME_CYCLES);
+    TEST_ASSERT_EQUAL(0, s_mx.block[100]);
+    TEST_ASSERT_EQUAL(0, s_mx.src[AUDIO_SRC_YM].head - s_mx.src[AUDIO_SRC_YM].tail);
+
+    // Master -20 dB, left a further -6 dB
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_lmc_write(&s_mx, lmc(AUDIO_LMC_MIX, 1)));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_lmc_write(&s_mx, lmc(AUDIO_LMC_MASTER, 30)));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_lmc_write(&s_mx, lmc(AUDIO_LMC_LEFT, 17)));
+    audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_in, FRAME_OUT);
+    audio_mixer_frame(&s_mx, FRAME_CYCLES);
+    TEST_ASSERT_INT_WITHIN(4, 802, s_mx.block[100]);
+    TEST_ASSERT_INT_WITHIN(4, 1600, s_mx.block[101]);
+
+    // Out of range values clamp; other devices and registers are refused
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_lmc_write(&s_mx, lmc(AUDIO_LMC_MASTER, 63)));
+    TEST_ASSERT_EQUAL(40, s_mx.lmc.master);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_mixer_lmc_write(&s_mx, (1 << 9) | 40));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_mixer_lmc_write(&s_mx, lmc(6, 0)));
+}
+
+TEST_CASE("mixer bass and treble shelves", "[audio]")
+{
+    static const struct {
+        int reg;
+        int val;
+        double hz;
+        double gain_db;
+        double tol_db;
+    } cases[] = {
+        { AUDIO_LMC_BASS,   12,    40.0, 12.0, 1.5 },
+        { AUDIO_LMC_BASS,    0,    40.0, -12.0, 1.5 },
+        { AUDIO_LMC_BASS,   12,  4000.0, 0.0, 0.5 },
+        { AUDIO_LMC_TREBLE, 12, 20000.0, 12.0, 1.5 },
+        { AUDIO_LMC_TREBLE,  0, 20000.0, -12.0, 1.5 },
+        { AUDIO_LMC_TREBLE, 12,   300.0, 0.0, 0.5 },
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        double t = 0.0, sum = 0.0;
+        const double amp = 4000.0;
+
+        mixer_init(AUDIO_OUT_RATE);
+        TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_lmc_write(&s_mx, lmc(cases[c].reg, cases[c].val)));
+        for (int f = 0; f < 10; f++) {
+            for (int i = 0; i < FRAME_OUT; i++, t += 1.0 / AUDIO_OUT_RATE) {
+                s_in[2 * i] = s_in[2 * i + 1] = (int16_t)lrint(amp * sin(2 * M_PI * cases[c].hz * t));
+            }
+            audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_in, FRAME_OUT);
+            audio_mixer_frame(&s_mx, FRAME_CYCLES);
+        }
+        for (int i = 0; i < FRAME_OUT; i++) {
+            sum += (double)s_mx.block[2 * i] * s_mx.block[2 * i];
+        }
+        double db = 20 * log10(sqrt(sum / FRAME_OUT) / (amp / sqrt(2)));
+        TEST_ASSERT_FLOAT_WITHIN(cases[c].tol_db, cases[c].gain_db, db);
+    }
+}
+
+TEST_CASE("mixer feeds the stream and the sink the same block", "[audio]")
+{
+    static audio_stream_t stream;
+    int calls = 0;
+    int16_t back[FRAME_OUT * 2];
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, audio_stream_init(&stream, AUDIO_OUT_RATE, FRAME_OUT, 1000));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_stream_init(&stream, AUDIO_OUT_RATE, FRAME_OUT, 2048));
+
+    audio_mixer_config_t config = {
+        .clock_hz = CLOCK_HZ,
+        .ym_rate = AUDIO_OUT_RATE,
+        .stream = &stream,
+        .sink = test_sink,
+        .sink_ctx = &calls,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, audio_mixer_init(&s_mx, &config));
+    for (int i = 0; i < FRAME_OUT * 2; i++) {
+        s_in[i] = (int16_t)(i * 11);
+    }
+    audio_mixer_push(&s_mx, AUDIO_SRC_YM, s_in, FRAME_OUT);
+    audio_mixer_frame(&s_mx, FRAME_CYCLES);
+
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL(FRAME_OUT, s_sunk_count);
+    TEST_ASSERT_EQUAL(FRAME_OUT, audio_stream_available(&stream));
+    TEST_ASSERT_EQUAL(FRAME_OUT, audio_stream_read(&stream, back, FRAME_OUT));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(s_sunk, back, FRAME_OUT * 2);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(s_in, back, FRAME_OUT * 2);
+
+    // Nobody reading: the third frame only partly fits, and wraps
+    audio_mixer_frame(&s_mx, FRAME_CYCLES);
+    audio_mixer_frame(&s_mx, FRAME_CYCLES);
+    audio_mixer_frame(&s_mx, FRAME_CYCLES);
+    TEST_ASSERT_EQUAL(2048, audio_stream_available(&stream));
+    TEST_ASSERT_EQUAL(3 * FRAME_OUT - 2048, stream.overruns);
+
+    // The YM FIFO ran dry after the first frame: its last frame is held
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(FRAME_OUT, audio_stream_read(&stream, back, FRAME_OUT));
+        TEST_ASSERT_EQUAL(s_in[FRAME_OUT * 2 - 2], back[FRAME_OUT * 2 - 2]);
+        TEST_ASSERT_EQUAL(s_in[FRAME_OUT * 2 - 1], back[FRAME_OUT * 2 - 1]);
+    }
+    TEST_ASSERT_EQUAL(2048 - 2 * FRAME_OUT, audio_stream_read(&stream, back, FRAME_OUT));
+    TEST_ASSERT_EQUAL(0, s_mx.stats.underruns[AUDIO_SRC_YM]);
+
+    audio_stream_free(&stream);
+}
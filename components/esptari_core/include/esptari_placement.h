@@ -0,0 +1,156 @@
+/**
+ * @file esptari_placement.h
+ * @brief Fast-memory placement of hot emulator data
+ *
+ * The P4 has 8 KB of TCM and 768 KB of L2MEM next to 32 MB of PSRAM. Hot
+ * structures go through this module so that a machine profile can decide
+ * which of them live in fast memory:
+ *
+ *     "placement": { "cpu_regs": "tcm", "scheduler": "tcm",
+ *                    "opcode_table": "l2", "st_ram_low": "l2",
+ *                    "palette_lut": "l2" }
+ *
+ * The firmware allocates the scheduler and low ST RAM itself. The CPU and
+ * video components are loaded into PSRAM with their data, so they ask for
+ * their hot structures by name through cpu_config_t::alloc_hot and
+ * video_config_t::alloc_hot, which the firmware points at
+ * place_alloc_by_name() and place_free_by_name(). A component given no
+ * callbacks, or NULL back, keeps its own copy in PSRAM.
+ *
+ * Each region has a byte budget. An allocation that does not fit its
+ * declared region, or that the heap refuses, spills to the next slower
+ * region (TCM -> L2 -> PSRAM) and is counted as a spill. The counters are
+ * of allocations, not of accesses to what was allocated.
+ *
+ * On a host build every region is plain malloc(), with the same budgets and
+ * accounting, so profiles and reports can be checked off target.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Memory regions, fastest first
+ */
+typedef enum {
+    PLACE_REGION_TCM = 0,
+    PLACE_REGION_L2,
+    PLACE_REGION_PSRAM,
+    PLACE_REGION_COUNT
+} place_region_t;
+
+/**
+ * @brief Placeable structures
+ */
+typedef enum {
+    PLACE_CPU_REGS = 0,         ///< CPU register file (the component's m68k_cpu_t)
+    PLACE_OPCODE_TABLE,         ///< Copy of the CPU's opcode handler table, 256 KB on target
+    PLACE_ST_RAM_LOW,           ///< First 64 KB of ST RAM (esptari_memory_t::ram_low)
+    PLACE_PALETTE_LUT,          ///< Shifter state: palettes, pair table, per-line RGB565
+    PLACE_SCHED,                ///< Event scheduler and its heap (sched_create())
+    PLACE_ITEM_COUNT
+} place_item_t;
+
+// Default budgets. The rest of L2MEM belongs to IDF, the network stack and
+// DMA buffers.
+#define PLACE_TCM_BUDGET_DEFAULT    (8 * 1024)
+#define PLACE_L2_BUDGET_DEFAULT     (384 * 1024)
+#define PLACE_PSRAM_BUDGET_DEFAULT  SIZE_MAX
+
+#define PLACE_ALIGN                 64      ///< Cache line
+
+typedef struct {
+    size_t budget[PLACE_REGION_COUNT];      ///< Bytes each region may hand out
+} place_config_t;
+
+/**
+ * @brief Per-region accounting
+ */
+typedef struct {
+    size_t budget;
+    size_t used;                ///< Bytes currently placed here
+    size_t peak;
+    uint32_t items;             ///< Structures currently placed here
+    uint32_t requested;         ///< Allocations that asked for this region
+    uint32_t placed;            ///< ... and got it
+    uint32_t spills;            ///< ... and went to a slower region
+} place_region_stats_t;
+
+/**
+ * @brief Per-structure placement
+ */
+typedef struct {
+    place_region_t declared;
+    place_region_t actual;      ///< Valid while allocated
+    size_t size;                ///< 0 when not allocated
+} place_item_info_t;
+
+typedef struct {
+    place_region_stats_t region[PLACE_REGION_COUNT];
+    place_item_info_t item[PLACE_ITEM_COUNT];
+} place_stats_t;
+
+/**
+ * @brief Reset budgets, declarations and counters
+ *
+ * Declarations return to the defaults: registers and scheduler in TCM,
+ * opcode table, low RAM and palette LUT in L2.
+ *
+ * @param config Budgets, NULL for the PLACE_*_BUDGET_DEFAULT values
+ * @return ESP_ERR_INVALID_STATE if anything is still allocated
+ */
+esp_err_t place_init(const place_config_t *config);
+
+/**
+ * @brief Choose the region for a structure
+ *
+ * Takes effect on the next place_alloc() of @p item.
+ */
+esp_err_t place_declare(place_item_t item, place_region_t region);
+
+/**
+ * @brief place_declare() by profile names, e.g. ("st_ram_low", "l2")
+ *
+ * @return ESP_ERR_NOT_FOUND for an unknown item or region name
+ */
+esp_err_t place_declare_by_name(const char *item, const char *region);
+
+/**
+ * @brief Allocate the storage of @p item, PLACE_ALIGN aligned
+ *
+ * One allocation per item; free it before allocating again.
+ *
+ * @return NULL if already allocated or no region could hold it
+ */
+void *place_alloc(place_item_t item, size_t size);
+
+void place_free(place_item_t item);
+
+/**
+ * @brief place_alloc() by profile name, for component_alloc_hot_fn
+ *
+ * @return NULL for an unknown name, as for a failed allocation
+ */
+void *place_alloc_by_name(const char *item, size_t size);
+
+/** place_free() by profile name, for component_free_hot_fn */
+void place_free_by_name(const char *item);
+
+/** Region @p item ended up in; its declared region if not allocated */
+place_region_t place_region_of(place_item_t item);
+
+void place_get_stats(place_stats_t *out);
+
+const char *place_region_name(place_region_t region);
+const char *place_item_name(place_item_t item);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,193 @@
+/**
+ * @file esptari_sched.h
+ * @brief Cycle-batched event scheduler
+ *
+ * Central timing model of the emulated machine. Time is counted in CPU
+ * clock cycles since reset. Timed hardware (GLUE HBL/VBL, MFP timers,
+ * ACIA, FDC, DMA sound) posts its next deadline as an event; the CPU runs
+ * in one execute() slice up to the earliest deadline, then the due events
+ * fire. Nothing is stepped per instruction.
+ *
+ * Chips whose state only matters when it is looked at (YM2149, DMA sound,
+ * Shifter) are registered as devices and run lazily: the I/O handler calls
+ * sched_sync() before touching their registers, which advances them to the
+ * exact current cycle, including the part of the CPU slice already run.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "component_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Timed event sources, one slot each
+ */
+typedef enum {
+    SCHED_EV_HBL = 0,           ///< GLUE horizontal blank
+    SCHED_EV_VBL,               ///< GLUE vertical blank
+    SCHED_EV_MFP_TIMER_A,
+    SCHED_EV_MFP_TIMER_B,
+    SCHED_EV_MFP_TIMER_C,
+    SCHED_EV_MFP_TIMER_D,
+    SCHED_EV_ACIA_IKBD,         ///< Keyboard ACIA byte complete
+    SCHED_EV_ACIA_MIDI,         ///< MIDI ACIA byte complete
+    SCHED_EV_FDC,               ///< WD1772 command phase
+    SCHED_EV_DMA_SOUND,         ///< STe DMA sound frame end
+    SCHED_EV_COUNT
+} sched_event_id_t;
+
+#define SCHED_MAX_DEVICES   8
+#define SCHED_NEVER         UINT64_MAX
+
+/**
+ * @brief Event handler
+ *
+ * @param ctx  Context given to sched_register()
+ * @param when Cycle the event was due; periodic sources reschedule from
+ *             this, not from sched_now(), so slice overshoot never drifts
+ */
+typedef void (*sched_callback_t)(void *ctx, uint64_t when);
+
+/**
+ * @brief Lazily clocked chip
+ *
+ * @p run advances the chip by @p cycles CPU cycles; the chip applies its
+ * own clock divider.
+ */
+typedef struct {
+    void (*run)(void *ctx, int cycles);
+    void *ctx;
+    uint64_t synced;            ///< Cycle the chip has been run up to
+} sched_device_t;
+
+/**
+ * @brief Slice statistics since the last sched_reset_stats()
+ */
+typedef struct {
+    uint64_t slices;            ///< execute() calls
+    uint64_t cycles;            ///< Cycles run by the CPU
+    uint64_t events;            ///< Event callbacks fired
+    uint64_t cut_short;         ///< Slices ended early by a nearer new deadline
+    uint64_t syncs;             ///< Lazy device catch-ups that ran the device
+    uint32_t min_slice;
+    uint32_t max_slice;
+    uint32_t avg_slice;         ///< cycles / slices
+} sched_stats_t;
+
+typedef struct {
+    uint64_t when;
+    sched_callback_t callback;
+    void *ctx;
+    int heap_pos;               ///< Index in heap[], -1 when not scheduled
+} sched_event_t;
+
+/**
+ * @brief Scheduler state
+ *
+ * Pending events are kept in a binary min-heap of event ids ordered by
+ * deadline.
+ */
+typedef struct {
+    const cpu_interface_t *cpu;
+    uint64_t now;               ///< Time at the start of the running slice
+    uint64_t slice_end;         ///< Deadline of the running slice
+    bool in_slice;
+
+    sched_event_t events[SCHED_EV_COUNT];
+    uint8_t heap[SCHED_EV_COUNT];
+    int heap_size;
+
+    sched_device_t *devices[SCHED_MAX_DEVICES];
+    int device_count;
+
+    sched_stats_t stats;
+} esptari_sched_t;
+
+/**
+ * @brief Initialize the scheduler at cycle 0
+ *
+ * @param cpu CPU to drive; its get_elapsed() is used for mid-slice time
+ */
+void sched_init(esptari_sched_t *s, const cpu_interface_t *cpu);
+
+/**
+ * @brief Allocate a scheduler where the profile placed it and initialize it
+ *
+ * The state is PLACE_SCHED of esptari_placement.h: the slice loop reads it
+ * between every CPU slice, so it defaults to TCM.
+ *
+ * @return NULL if it is already allocated or no region could hold it
+ */
+esptari_sched_t *sched_create(const cpu_interface_t *cpu);
+
+/** Free a scheduler from sched_create() */
+void sched_destroy(esptari_sched_t *s);
+
+/**
+ * @brief Attach the handler for an event source
+ */
+esp_err_t sched_register(esptari_sched_t *s, sched_event_id_t id,
+                         sched_callback_t callback, void *ctx);
+
+/**
+ * @brief Add a lazily clocked chip, synced from the current time
+ *
+ * @return ESP_ERR_NO_MEM when SCHED_MAX_DEVICES are registered
+ */
+esp_err_t sched_add_device(esptari_sched_t *s, sched_device_t *dev);
+
+/**
+ * @brief Current cycle, exact to the instruction even inside a CPU slice
+ */
+uint64_t sched_now(const esptari_sched_t *s);
+
+/**
+ * @brief Schedule (or move) an event to absolute cycle @p when
+ *
+ * If called from a chip register write during a slice and the new deadline
+ * is earlier than the slice end, the CPU is stopped after the current
+ * instruction so the event fires on time.
+ */
+void sched_at(esptari_sched_t *s, sched_event_id_t id, uint64_t when);
+
+/** Schedule an event @p cycles after sched_now() */
+void sched_in(esptari_sched_t *s, sched_event_id_t id, uint32_t cycles);
+
+void sched_cancel(esptari_sched_t *s, sched_event_id_t id);
+
+/**
+ * @return Deadline of @p id, SCHED_NEVER if not scheduled
+ */
+uint64_t sched_deadline(const esptari_sched_t *s, sched_event_id_t id);
+
+/**
+ * @brief Bring a lazy chip up to sched_now()
+ *
+ * Call from the chip's I/O handler before reading or writing registers.
+ */
+void sched_sync(esptari_sched_t *s, sched_device_t *dev);
+
+/** Bring every registered chip up to sched_now() */
+void sched_sync_all(esptari_sched_t *s);
+
+/**
+ * @brief Run the machine until cycle @p until
+ *
+ * Executes the CPU in slices bounded by the earliest event, fires due
+ * events, and finally syncs all devices so audio and video are complete up
+ * to @p until. The CPU may overshoot by part of an instruction.
+ */
+void sched_run(esptari_sched_t *s, uint64_t until);
+
+void sched_get_stats(const esptari_sched_t *s, sched_stats_t *out);
+void sched_reset_stats(esptari_sched_t *s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,265 @@
+/**
+ * @file placement.c
+ * @brief Fast-memory placement of hot emulator data
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esptari_placement.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+typedef struct {
+    place_region_t declared;
+    place_region_t actual;
+    size_t size;
+    void *ptr;
+} place_slot_t;
+
+static place_slot_t s_slots[PLACE_ITEM_COUNT];
+static place_region_stats_t s_regions[PLACE_REGION_COUNT];
+static bool s_initialized;
+
+static const char *const s_region_names[PLACE_REGION_COUNT] = {
+    [PLACE_REGION_TCM]   = "tcm",
+    [PLACE_REGION_L2]    = "l2",
+    [PLACE_REGION_PSRAM] = "psram",
+};
+
+static const char *const s_item_names[PLACE_ITEM_COUNT] = {
+    [PLACE_CPU_REGS]     = "cpu_regs",
+    [PLACE_OPCODE_TABLE] = "opcode_table",
+    [PLACE_ST_RAM_LOW]   = "st_ram_low",
+    [PLACE_PALETTE_LUT]  = "palette_lut",
+    [PLACE_SCHED]        = "scheduler",
+};
+
+static const place_region_t s_default_region[PLACE_ITEM_COUNT] = {
+    [PLACE_CPU_REGS]     = PLACE_REGION_TCM,
+    [PLACE_OPCODE_TABLE] = PLACE_REGION_L2,
+    [PLACE_ST_RAM_LOW]   = PLACE_REGION_L2,
+    [PLACE_PALETTE_LUT]  = PLACE_REGION_L2,
+    [PLACE_SCHED]        = PLACE_REGION_TCM,
+};
+
+// ---------------------------------------------------------------------------
+// Region allocators
+// ---------------------------------------------------------------------------
+
+#ifdef ESP_PLATFORM
+
+static void *region_alloc(place_region_t region, size_t size)
+{
+    uint32_t caps;
+
+    switch (region) {
+    case PLACE_REGION_TCM:
+#ifdef MALLOC_CAP_TCM
+        caps = MALLOC_CAP_TCM;
+        break;
+#else
+        return NULL;
+#endif
+    case PLACE_REGION_L2:
+        caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        break;
+    default:
+        caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+        break;
+    }
+    return heap_caps_aligned_alloc(PLACE_ALIGN, size, caps);
+}
+
+static void region_free(void *ptr)
+{
+    heap_caps_free(ptr);
+}
+
+#else
+
+// Host: every region is the C heap, only the accounting differs
+static void *region_alloc(place_region_t region, size_t size)
+{
+    void *ptr = NULL;
+
+    (void)region;
+    return posix_memalign(&ptr, PLACE_ALIGN, size) == 0 ? ptr : NULL;
+}
+
+static void region_free(void *ptr)
+{
+    free(ptr);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// API
+// ---------------------------------------------------------------------------
+
+esp_err_t place_init(const place_config_t *config)
+{
+    for (int i = 0; i < PLACE_ITEM_COUNT; i++) {
+        if (s_slots[i].ptr) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    memset(s_regions, 0, sizeof(s_regions));
+    if (config) {
+        for (int r = 0; r < PLACE_REGION_COUNT; r++) {
+            s_regions[r].budget = config->budget[r];
+        }
+    } else {
+        s_regions[PLACE_REGION_TCM].budget = PLACE_TCM_BUDGET_DEFAULT;
+        s_regions[PLACE_REGION_L2].budget = PLACE_L2_BUDGET_DEFAULT;
+        s_regions[PLACE_REGION_PSRAM].budget = PLACE_PSRAM_BUDGET_DEFAULT;
+    }
+    for (int i = 0; i < PLACE_ITEM_COUNT; i++) {
+        s_slots[i] = (place_slot_t) { .declared = s_default_region[i] };
+    }
+    s_initialized = true;
+    return ESP_OK;
+}
+
+static void place_ensure_init(void)
+{
+    if (!s_initialized) {
+        place_init(NULL);
+    }
+}
+
+esp_err_t place_declare(place_item_t item, place_region_t region)
+{
+    if ((unsigned)item >= PLACE_ITEM_COUNT || (unsigned)region >= PLACE_REGION_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    place_ensure_init();
+    s_slots[item].declared = region;
+    return ESP_OK;
+}
+
+/** Item called @p name, PLACE_ITEM_COUNT if there is none */
+static int place_item_by_name(const char *name)
+{
+    int i;
+
+    for (i = 0; i < PLACE_ITEM_COUNT && strcmp(name, s_item_names[i]) != 0; i++) {
+    }
+    return i;
+}
+
+esp_err_t place_declare_by_name(const char *item, const char *region)
+{
+    int i, r;
+
+    if (!item || !region) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i = place_item_by_name(item);
+    for (r = 0; r < PLACE_REGION_COUNT && strcmp(region, s_region_names[r]) != 0; r++) {
+    }
+    if (i == PLACE_ITEM_COUNT || r == PLACE_REGION_COUNT) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return place_declare((place_item_t)i, (place_region_t)r);
+}
+
+void *place_alloc(place_item_t item, size_t size)
+{
+    if ((unsigned)item >= PLACE_ITEM_COUNT || size == 0) {
+        return NULL;
+    }
+    place_ensure_init();
+
+    place_slot_t *slot = &s_slots[item];
+    if (slot->ptr) {
+        return NULL;
+    }
+    s_regions[slot->declared].requested++;
+
+    // Declared region first, then each slower one
+    for (int r = slot->declared; r < PLACE_REGION_COUNT; r++) {
+        place_region_stats_t *reg = &s_regions[r];
+        if (size > reg->budget - reg->used) {
+            continue;
+        }
+        void *ptr = region_alloc((place_region_t)r, size);
+        if (!ptr) {
+            continue;
+        }
+
+        slot->ptr = ptr;
+        slot->size = size;
+        slot->actual = (place_region_t)r;
+        reg->used += size;
+        reg->items++;
+        if (reg->used > reg->peak) {
+            reg->peak = reg->used;
+        }
+        if (r == (int)slot->declared) {
+            s_regions[slot->declared].placed++;
+        } else {
+            s_regions[slot->declared].spills++;
+        }
+        return ptr;
+    }
+    return NULL;
+}
+
+void place_free(place_item_t item)
+{
+    if ((unsigned)item >= PLACE_ITEM_COUNT || !s_slots[item].ptr) {
+        return;
+    }
+    place_slot_t *slot = &s_slots[item];
+    place_region_stats_t *reg = &s_regions[slot->actual];
+
+    region_free(slot->ptr);
+    reg->used -= slot->size;
+    reg->items--;
+    slot->ptr = NULL;
+    slot->size = 0;
+}
+
+void *place_alloc_by_name(const char *item, size_t size)
+{
+    return item ? place_alloc((place_item_t)place_item_by_name(item), size) : NULL;
+}
+
+void place_free_by_name(const char *item)
+{
+    if (item) {
+        place_free((place_item_t)place_item_by_name(item));
+    }
+}
+
+place_region_t place_region_of(place_item_t item)
+{
+    place_ensure_init();
+    return s_slots[item].ptr ? s_slots[item].actual : s_slots[item].declared;
+}
+
+void place_get_stats(place_stats_t *out)
+{
+    place_ensure_init();
+    memcpy(out->region, s_regions, sizeof(s_regions));
+    for (int i = 0; i < PLACE_ITEM_COUNT; i++) {
+        out->item[i].declared = s_slots[i].declared;
+        out->item[i].actual = s_slots[i].ptr ? s_slots[i].actual : s_slots[i].declared;
+        out->item[i].size = s_slots[i].size;
+    }
+}
+
+const char *place_region_name(place_region_t region)
+{
+    return (unsigned)region < PLACE_REGION_COUNT ? s_region_names[region] : "?";
+}
+
+const char *place_item_name(place_item_t item)
+{
+    return (unsigned)item < PLACE_ITEM_COUNT ? s_item_names[item] : "?";
+}
@@ -0,0 +1,265 @@
+/**
+ * @file sched.c
+ * @brief Cycle-batched event scheduler
+ */
+
+#include <limits.h>
+#include <string.h>
+#include "esptari_sched.h"
+#include "esptari_placement.h"
+
+// Keep slice budgets well inside the int execute() takes
+#define SCHED_MAX_SLICE     (INT_MAX / 2)
+
+static void heap_swap(esptari_sched_t *s, int a, int b)
+{
+    uint8_t ia = s->heap[a], ib = s->heap[b];
+    s->heap[a] = ib;
+    s->heap[b] = ia;
+    s->events[ib].heap_pos = a;
+    s->events[ia].heap_pos = b;
+}
+
+static bool heap_less(const esptari_sched_t *s, int a, int b)
+{
+    return s->events[s->heap[a]].when < s->events[s->heap[b]].when;
+}
+
+static void heap_sift_up(esptari_sched_t *s, int pos)
+{
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!heap_less(s, pos, parent)) {
+            break;
+        }
+        heap_swap(s, pos, parent);
+        pos = parent;
+    }
+}
+
+static void heap_sift_down(esptari_sched_t *s, int pos)
+{
+    for (;;) {
+        int l = 2 * pos + 1, r = l + 1, min = pos;
+        if (l < s->heap_size && heap_less(s, l, min)) {
+            min = l;
+        }
+        if (r < s->heap_size && heap_less(s, r, min)) {
+            min = r;
+        }
+        if (min == pos) {
+            break;
+        }
+        heap_swap(s, pos, min);
+        pos = min;
+    }
+}
+
+static void heap_remove(esptari_sched_t *s, int pos)
+{
+    int last = --s->heap_size;
+
+    s->events[s->heap[pos]].heap_pos = -1;
+    if (pos != last) {
+        s->heap[pos] = s->heap[last];
+        s->events[s->heap[pos]].heap_pos = pos;
+        heap_sift_up(s, pos);
+        heap_sift_down(s, pos);
+    }
+}
+
+void sched_init(esptari_sched_t *s, const cpu_interface_t *cpu)
+{
+    memset(s, 0, sizeof(*s));
+    s->cpu = cpu;
+    for (int i = 0; i < SCHED_EV_COUNT; i++) {
+        s->events[i].when = SCHED_NEVER;
+        s->events[i].heap_pos = -1;
+    }
+    sched_reset_stats(s);
+}
+
+esptari_sched_t *sched_create(const cpu_interface_t *cpu)
+{
+    esptari_sched_t *s = place_alloc(PLACE_SCHED, sizeof(*s));
+
+    if (s) {
+        sched_init(s, cpu);
+    }
+    return s;
+}
+
+void sched_destroy(esptari_sched_t *s)
+{
+    if (s) {
+        place_free(PLACE_SCHED);
+    }
+}
+
+esp_err_t sched_register(esptari_sched_t *s, sched_event_id_t id,
+                         sched_callback_t callback, void *ctx)
+{
+    if ((unsigned)id >= SCHED_EV_COUNT || !callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s->events[id].callback = callback;
+    s->events[id].ctx = ctx;
+    return ESP_OK;
+}
+
+esp_err_t sched_add_device(esptari_sched_t *s, sched_device_t *dev)
+{
+    if (!dev || !dev->run) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s->device_count == SCHED_MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->synced = sched_now(s);
+    s->devices[s->device_count++] = dev;
+    return ESP_OK;
+}
+
+uint64_t sched_now(const esptari_sched_t *s)
+{
+    if (s->in_slice && s->cpu->get_elapsed) {
+        return s->now + (uint64_t)s->cpu->get_elapsed();
+    }
+    return s->now;
+}
+
+void sched_at(esptari_sched_t *s, sched_event_id_t id, uint64_t when)
+{
+    sched_event_t *ev = &s->events[id];
+
+    ev->when = when;
+    if (ev->heap_pos < 0) {
+        ev->heap_pos = s->heap_size;
+        s->heap[s->heap_size++] = (uint8_t)id;
+        heap_sift_up(s, ev->heap_pos);
+    } else {
+        heap_sift_up(s, ev->heap_pos);
+        heap_sift_down(s, ev->heap_pos);
+    }
+
+    // A register write moved a deadline into the running slice
+    if (s->in_slice && when < s->slice_end) {
+        s->slice_end = when;
+        s->cpu->stop();
+        s->stats.cut_short++;
+    }
+}
+
+void sched_in(esptari_sched_t *s, sched_event_id_t id, uint32_t cycles)
+{
+    sched_at(s, id, sched_now(s) + cycles);
+}
+
+void sched_cancel(esptari_sched_t *s, sched_event_id_t id)
+{
+    sched_event_t *ev = &s->events[id];
+
+    if (ev->heap_pos >= 0) {
+        heap_remove(s, ev->heap_pos);
+    }
+    ev->when = SCHED_NEVER;
+}
+
+uint64_t sched_deadline(const esptari_sched_t *s, sched_event_id_t id)
+{
+    return s->events[id].heap_pos >= 0 ? s->events[id].when : SCHED_NEVER;
+}
+
+void sched_sync(esptari_sched_t *s, sched_device_t *dev)
+{
+    uint64_t now = sched_now(s);
+
+    if (dev->synced >= now) {
+        return;
+    }
+    while (dev->synced < now) {
+        uint64_t delta = now - dev->synced;
+        int step = delta > SCHED_MAX_SLICE ? SCHED_MAX_SLICE : (int)delta;
+        dev->run(dev->ctx, step);
+        dev->synced += (uint64_t)step;
+    }
+    s->stats.syncs++;
+}
+
+void sched_sync_all(esptari_sched_t *s)
+{
+    for (int i = 0; i < s->device_count; i++) {
+        sched_sync(s, s->devices[i]);
+    }
+}
+
+/**
+ * @brief Fire every event due at or before s->now, earliest first
+ *
+ * The event leaves the heap before its callback runs, so the callback is
+ * free to schedule it again.
+ */
+static void sched_fire_due(esptari_sched_t *s)
+{
+    while (s->heap_size && s->events[s->heap[0]].when <= s->now) {
+        sched_event_t *ev = &s->events[s->heap[0]];
+        uint64_t when = ev->when;
+
+        heap_remove(s, 0);
+        ev->when = SCHED_NEVER;
+        s->stats.events++;
+        if (ev->callback) {
+            ev->callback(ev->ctx, when);
+        }
+    }
+}
+
+void sched_run(esptari_sched_t *s, uint64_t until)
+{
+    sched_fire_due(s);
+
+    while (s->now < until) {
+        uint64_t deadline = until;
+        if (s->heap_size && s->events[s->heap[0]].when < deadline) {
+            deadline = s->events[s->heap[0]].when;
+        }
+
+        uint64_t budget = deadline - s->now;
+        if (budget > SCHED_MAX_SLICE) {
+            budget = SCHED_MAX_SLICE;
+        }
+        s->slice_end = s->now + budget;
+        s->in_slice = true;
+        int used = s->cpu->execute((int)budget);
+        s->in_slice = false;
+        s->now += (uint64_t)used;
+
+        s->stats.slices++;
+        s->stats.cycles += (uint64_t)used;
+        if ((uint32_t)used < s->stats.min_slice) {
+            s->stats.min_slice = (uint32_t)used;
+        }
+        if ((uint32_t)used > s->stats.max_slice) {
+            s->stats.max_slice = (uint32_t)used;
+        }
+
+        sched_fire_due(s);
+    }
+
+    sched_sync_all(s);
+}
+
+void sched_get_stats(const esptari_sched_t *s, sched_stats_t *out)
+{
+    *out = s->stats;
+    if (out->slices == 0) {
+        out->min_slice = 0;
+    }
+    out->avg_slice = out->slices ? (uint32_t)(out->cycles / out->slices) : 0;
+}
+
+void sched_reset_stats(esptari_sched_t *s)
+{
+    memset(&s->stats, 0, sizeof(s->stats));
+    s->stats.min_slice = UINT32_MAX;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file test_placement.c
+ * @brief Fast-memory placement tests
+ *
+ * Only the accounting is checked, so the same cases hold on the host
+ * fallback and on target (the TCM cases need an IDF with MALLOC_CAP_TCM).
+ */
+
+#include <stdint.h>
+#include "unity.h"
+#include "esptari_placement.h"
+#include "esptari_sched.h"
+
+static void free_all(void)
+{
+    for (int i = 0; i < PLACE_ITEM_COUNT; i++) {
+        place_free((place_item_t)i);
+    }
+}
+
+TEST_CASE("place defaults put hot state in TCM and L2", "[placement]")
+{
+    place_stats_t st;
+
+    free_all();
+    TEST_ASSERT_EQUAL(ESP_OK, place_init(NULL));
+    TEST_ASSERT_EQUAL(PLACE_REGION_TCM, place_region_of(PLACE_SCHED));
+    TEST_ASSERT_EQUAL(PLACE_REGION_L2, place_region_of(PLACE_ST_RAM_LOW));
+    TEST_ASSERT_EQUAL(PLACE_REGION_TCM, place_region_of(PLACE_CPU_REGS));
+    TEST_ASSERT_EQUAL(PLACE_REGION_L2, place_region_of(PLACE_OPCODE_TABLE));
+    TEST_ASSERT_EQUAL(PLACE_REGION_L2, place_region_of(PLACE_PALETTE_LUT));
+
+    void *sched = place_alloc(PLACE_SCHED, 256);
+    void *low = place_alloc(PLACE_ST_RAM_LOW, 4096);
+    TEST_ASSERT_NOT_NULL(sched);
+    TEST_ASSERT_NOT_NULL(low);
+    TEST_ASSERT_EQUAL(0, (uintptr_t)sched % PLACE_ALIGN);
+
+    place_get_stats(&st);
+    TEST_ASSERT_EQUAL(256, st.region[PLACE_REGION_TCM].used);
+    TEST_ASSERT_EQUAL(1, st.region[PLACE_REGION_TCM].placed);
+    TEST_ASSERT_EQUAL(4096, st.region[PLACE_REGION_L2].used);
+    TEST_ASSERT_EQUAL(1, st.region[PLACE_REGION_L2].items);
+    TEST_ASSERT_EQUAL(4096, st.item[PLACE_ST_RAM_LOW].size);
+
+    place_free(PLACE_SCHED);
+    place_get_stats(&st);
+    TEST_ASSERT_EQUAL(0, st.region[PLACE_REGION_TCM].used);
+    TEST_ASSERT_EQUAL(256, st.region[PLACE_REGION_TCM].peak);
+    free_all();
+}
+
+TEST_CASE("place spills to the next region over budget", "[placement]")
+{
+    place_config_t cfg = { .budget = { 1024, 64 * 1024, SIZE_MAX } };
+    place_stats_t st;
+
+    free_all();
+    TEST_ASSERT_EQUAL(ESP_OK, place_init(&cfg));
+    // Scheduler does not fit TCM
+    TEST_ASSERT_NOT_NULL(place_alloc(PLACE_SCHED, 1536));
+    TEST_ASSERT_EQUAL(PLACE_REGION_L2, place_region_of(PLACE_SCHED));
+    // 64 KB of low RAM does not fit beside it in L2 either
+    TEST_ASSERT_NOT_NULL(place_alloc(PLACE_ST_RAM_LOW, 64 * 1024));
+    TEST_ASSERT_EQUAL(PLACE_REGION_PSRAM, place_region_of(PLACE_ST_RAM_LOW));
+
+    place_get_stats(&st);
+    TEST_ASSERT_EQUAL(1, st.region[PLACE_REGION_TCM].requested);
+    TEST_ASSERT_EQUAL(0, st.region[PLACE_REGION_TCM].placed);
+    TEST_ASSERT_EQUAL(1, st.region[PLACE_REGION_TCM].spills);
+    TEST_ASSERT_EQUAL(1, st.region[PLACE_REGION_L2].spills);
+    TEST_ASSERT_EQUAL(1536, st.region[PLACE_REGION_L2].used);
+    TEST_ASSERT_EQUAL(64 * 1024, st.region[PLACE_REGION_PSRAM].used);
+    TEST_ASSERT_EQUAL(PLACE_REGION_TCM, st.item[PLACE_SCHED].declared);
+    TEST_ASSERT_EQUAL(PLACE_REGION_L2, st.item[PLACE_SCHED].actual);
+    free_all();
+}
+
+TEST_CASE("place profile declarations by name", "[placement]")
+{
+    free_all();
+    TEST_ASSERT_EQUAL(ESP_OK, place_init(NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, place_declare_by_name("scheduler", "psram"));
+    TEST_ASSERT_EQUAL(ESP_OK, place_declare_by_name("st_ram_low", "tcm"));
+    TEST_ASSERT_EQUAL(PLACE_REGION_PSRAM, place_region_of(PLACE_SCHED));
+    TEST_ASSERT_EQUAL(PLACE_REGION_TCM, place_region_of(PLACE_ST_RAM_LOW));
+
+    TEST_ASSERT_EQUAL(ESP_OK, place_declare_by_name("opcode_table", "psram"));
+    TEST_ASSERT_EQUAL(PLACE_REGION_PSRAM, place_region_of(PLACE_OPCODE_TABLE));
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, place_declare_by_name("line_buffer", "l2"));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, place_declare_by_name("scheduler", "iram"));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, place_declare(PLACE_ITEM_COUNT, PLACE_REGION_L2));
+    TEST_ASSERT_EQUAL_STRING("scheduler", place_item_name(PLACE_SCHED));
+    TEST_ASSERT_EQUAL_STRING("l2", place_region_name(PLACE_REGION_L2));
+}
+
+TEST_CASE("place one allocation per item", "[placement]")
+{
+    free_all();
+    TEST_ASSERT_EQUAL(ESP_OK, place_init(NULL));
+    TEST_ASSERT_NOT_NULL(place_alloc(PLACE_SCHED, 128));
+    TEST_ASSERT_NULL(place_alloc(PLACE_SCHED, 128));
+    TEST_ASSERT_NULL(place_alloc(PLACE_ST_RAM_LOW, 0));
+    // Budgets cannot change under live allocations
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, place_init(NULL));
+    free_all();
+    TEST_ASSERT_EQUAL(ESP_OK, place_init(NULL));
+}
+
+TEST_CASE("place component storage by name", "[placement]")
+{
+    place_stats_t st;
+
+    free_all();
+    TEST_ASSERT_EQUAL(ESP_OK, place_init(NULL));
+    // What the CPU and Shifter components ask for through alloc_hot
+    void *regs = place_alloc_by_name("cpu_regs", 160);
+    void *table = place_alloc_by_name("opcode_table", 256 * 1024);
+    void *lut = place_alloc_by_name("palette_lut", 20 * 1024);
+    TEST_ASSERT_NOT_NULL(regs);
+    TEST_ASSERT_NOT_NULL(table);
+    TEST_ASSERT_NOT_NULL(lut);
+    TEST_ASSERT_NULL(place_alloc_by_name("cpu_regs", 160));
+    TEST_ASSERT_NULL(place_alloc_by_name("dsp_regs", 160));
+    TEST_ASSERT_NULL(place_alloc_by_name(NULL, 160));
+
+    // With low RAM the defaults still fit their regions
+    TEST_ASSERT_NOT_NULL(place_alloc(PLACE_ST_RAM_LOW, 64 * 1024));
+    place_get_stats(&st);
+    TEST_ASSERT_EQUAL(PLACE_REGION_TCM, st.item[PLACE_CPU_REGS].actual);
+    TEST_ASSERT_EQUAL(PLACE_REGION_L2, st.item[PLACE_OPCODE_TABLE].actual);
+    TEST_ASSERT_EQUAL(PLACE_REGION_L2, st.item[PLACE_PALETTE_LUT].actual);
+    TEST_ASSERT_EQUAL(3, st.region[PLACE_REGION_L2].items);
+    TEST_ASSERT_EQUAL(0, st.region[PLACE_REGION_L2].spills);
+
+    place_free_by_name("opcode_table");
+    place_free_by_name("dsp_regs");
+    place_free_by_name(NULL);
+    place_get_stats(&st);
+    TEST_ASSERT_EQUAL(0, st.item[PLACE_OPCODE_TABLE].size);
+    TEST_ASSERT_EQUAL(2, st.region[PLACE_REGION_L2].items);
+    free_all();
+}
+
+TEST_CASE("place scheduler from sched_create", "[placement]")
+{
+    place_stats_t st;
+
+    free_all();
+    TEST_ASSERT_EQUAL(ESP_OK, place_init(NULL));
+    esptari_sched_t *s = sched_create(NULL);
+    TEST_ASSERT_NOT_NULL(s);
+    TEST_ASSERT_EQUAL_UINT64(SCHED_NEVER, sched_deadline(s, SCHED_EV_VBL));
+    TEST_ASSERT_NULL(sched_create(NULL));
+
+    place_get_stats(&st);
+    TEST_ASSERT_EQUAL(sizeof(*s), st.item[PLACE_SCHED].size);
+    TEST_ASSERT_EQUAL(PLACE_REGION_TCM, st.item[PLACE_SCHED].declared);
+    sched_destroy(s);
+    place_get_stats(&st);
+    TEST_ASSERT_EQUAL(0, st.item[PLACE_SCHED].size);
+}
@@ -0,0 +1,222 @@
+/**
+ * @file test_sched.c
+ * @brief Event scheduler unit tests
+ *
+ * A fake CPU executes 4-cycle "instructions" and can run a hook at a given
+ * cycle, standing in for a chip register access in the middle of a slice.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "esptari_sched.h"
+
+#define FAKE_INSN_CYCLES    4
+
+static esptari_sched_t s_sched;
+static int s_elapsed;
+static bool s_stopped;
+static uint64_t s_hook_at;
+static void (*s_hook)(void);
+
+static int fake_execute(int cycles)
+{
+    s_elapsed = 0;
+    s_stopped = false;
+    do {
+        uint64_t now = s_sched.now + (uint64_t)s_elapsed;
+        if (s_hook && now >= s_hook_at) {
+            void (*hook)(void) = s_hook;
+            s_hook = NULL;
+            hook();
+        }
+        s_elapsed += FAKE_INSN_CYCLES;
+    } while (s_elapsed < cycles && !s_stopped);
+    return s_elapsed;
+}
+
+static void fake_stop(void)
+{
+    s_stopped = true;
+}
+
+static int fake_get_elapsed(void)
+{
+    return s_elapsed;
+}
+
+static const cpu_interface_t s_fake_cpu = {
+    .interface_version = CPU_INTERFACE_V1,
+    .name              = "fake",
+    .execute           = fake_execute,
+    .stop              = fake_stop,
+    .get_elapsed       = fake_get_elapsed,
+};
+
+static void reset_fake(void)
+{
+    s_hook = NULL;
+    s_hook_at = 0;
+    sched_init(&s_sched, &s_fake_cpu);
+}
+
+// Records (id, due cycle, actual cycle) of fired events
+static struct {
+    int id;
+    uint64_t when;
+    uint64_t now;
+} s_log[64];
+static int s_log_count;
+
+static void log_event(void *ctx, uint64_t when)
+{
+    if (s_log_count < 64) {
+        s_log[s_log_count].id = (int)(intptr_t)ctx;
+        s_log[s_log_count].when = when;
+        s_log[s_log_count].now = sched_now(&s_sched);
+        s_log_count++;
+    }
+}
+
+static void hbl_periodic(void *ctx, uint64_t when)
+{
+    log_event(ctx, when);
+    sched_at(&s_sched, SCHED_EV_HBL, when + 512);
+}
+
+TEST_CASE("sched periodic event does not drift", "[sched]")
+{
+    sched_stats_t st;
+
+    reset_fake();
+    s_log_count = 0;
+    sched_register(&s_sched, SCHED_EV_HBL, hbl_periodic, (void *)SCHED_EV_HBL);
+    sched_at(&s_sched, SCHED_EV_HBL, 512);
+    sched_run(&s_sched, 512 * 10);
+
+    TEST_ASSERT_EQUAL(10, s_log_count);
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_UINT64(512u * (uint64_t)(i + 1), s_log[i].when);
+        TEST_ASSERT_UINT32_WITHIN(FAKE_INSN_CYCLES, s_log[i].when, s_log[i].now);
+    }
+
+    sched_get_stats(&s_sched, &st);
+    TEST_ASSERT_EQUAL_UINT64(10, st.events);
+    TEST_ASSERT_UINT32_WITHIN(FAKE_INSN_CYCLES, 512, st.avg_slice);
+    TEST_ASSERT_EQUAL_UINT64(s_sched.now, st.cycles);
+}
+
+TEST_CASE("sched fires events in deadline order", "[sched]")
+{
+    reset_fake();
+    s_log_count = 0;
+    sched_register(&s_sched, SCHED_EV_FDC, log_event, (void *)SCHED_EV_FDC);
+    sched_register(&s_sched, SCHED_EV_MFP_TIMER_A, log_event, (void *)SCHED_EV_MFP_TIMER_A);
+    sched_register(&s_sched, SCHED_EV_ACIA_IKBD, log_event, (void *)SCHED_EV_ACIA_IKBD);
+    sched_at(&s_sched, SCHED_EV_FDC, 3000);
+    sched_at(&s_sched, SCHED_EV_MFP_TIMER_A, 1000);
+    sched_at(&s_sched, SCHED_EV_ACIA_IKBD, 2000);
+    // Moving an already queued event re-sorts it
+    sched_at(&s_sched, SCHED_EV_FDC, 1500);
+
+    sched_run(&s_sched, 4000);
+
+    TEST_ASSERT_EQUAL(3, s_log_count);
+    TEST_ASSERT_EQUAL(SCHED_EV_MFP_TIMER_A, s_log[0].id);
+    TEST_ASSERT_EQUAL(SCHED_EV_FDC, s_log[1].id);
+    TEST_ASSERT_EQUAL(SCHED_EV_ACIA_IKBD, s_log[2].id);
+    TEST_ASSERT_EQUAL_UINT64(1500, s_log[1].when);
+}
+
+TEST_CASE("sched cancel removes a pending event", "[sched]")
+{
+    reset_fake();
+    s_log_count = 0;
+    sched_register(&s_sched, SCHED_EV_VBL, log_event, (void *)SCHED_EV_VBL);
+    sched_register(&s_sched, SCHED_EV_HBL, log_event, (void *)SCHED_EV_HBL);
+    sched_at(&s_sched, SCHED_EV_VBL, 100);
+    sched_at(&s_sched, SCHED_EV_HBL, 200);
+    sched_cancel(&s_sched, SCHED_EV_VBL);
+    TEST_ASSERT_EQUAL_UINT64(SCHED_NEVER, sched_deadline(&s_sched, SCHED_EV_VBL));
+    TEST_ASSERT_EQUAL_UINT64(200, sched_deadline(&s_sched, SCHED_EV_HBL));
+
+    sched_run(&s_sched, 1000);
+    TEST_ASSERT_EQUAL(1, s_log_count);
+    TEST_ASSERT_EQUAL(SCHED_EV_HBL, s_log[0].id);
+}
+
+static void hook_start_timer(void)
+{
+    // MFP timer programmed mid-slice with a short delay
+    sched_in(&s_sched, SCHED_EV_MFP_TIMER_B, 100);
+}
+
+TEST_CASE("sched register write shortens the running slice", "[sched]")
+{
+    sched_stats_t st;
+
+    reset_fake();
+    s_log_count = 0;
+    sched_register(&s_sched, SCHED_EV_MFP_TIMER_B, log_event, (void *)SCHED_EV_MFP_TIMER_B);
+    s_hook_at = 200;
+    s_hook = hook_start_timer;
+
+    sched_run(&s_sched, 10000);
+
+    TEST_ASSERT_EQUAL(1, s_log_count);
+    TEST_ASSERT_EQUAL_UINT64(300, s_log[0].when);
+    TEST_ASSERT_UINT32_WITHIN(FAKE_INSN_CYCLES, 300, s_log[0].now);
+    sched_get_stats(&s_sched, &st);
+    TEST_ASSERT_EQUAL_UINT64(1, st.cut_short);
+}
+
+static uint64_t s_dev_cycles;
+
+static void dev_run(void *ctx, int cycles)
+{
+    s_dev_cycles += (uint64_t)cycles;
+}
+
+static sched_device_t s_dev = { .run = dev_run };
+
+static void hook_touch_device(void)
+{
+    sched_sync(&s_sched, &s_dev);
+    TEST_ASSERT_EQUAL_UINT64(sched_now(&s_sched), s_dev_cycles);
+    // Already there: a second touch on the same cycle runs nothing
+    sched_sync(&s_sched, &s_dev);
+}
+
+TEST_CASE("sched lazy device catches up to the exact cycle", "[sched]")
+{
+    reset_fake();
+    s_dev_cycles = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, sched_add_device(&s_sched, &s_dev));
+    s_hook_at = 1234;
+    s_hook = hook_touch_device;
+
+    sched_run(&s_sched, 5000);
+
+    // Synced once mid-slice by the hook, then to the end by sched_run()
+    TEST_ASSERT_EQUAL_UINT64(s_sched.now, s_dev_cycles);
+    TEST_ASSERT_EQUAL_UINT64(s_sched.now, s_dev.synced);
+    TEST_ASSERT_EQUAL_UINT64(2, s_sched.stats.syncs);
+
+    // Nothing left to catch up
+    sched_sync_all(&s_sched);
+    TEST_ASSERT_EQUAL_UINT64(2, s_sched.stats.syncs);
+}
+
+TEST_CASE("sched rejects bad registrations", "[sched]")
+{
+    static sched_device_t devs[SCHED_MAX_DEVICES + 1];
+
+    reset_fake();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sched_register(&s_sched, SCHED_EV_COUNT, log_event, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sched_register(&s_sched, SCHED_EV_HBL, NULL, NULL));
+    for (int i = 0; i < SCHED_MAX_DEVICES; i++) {
+        devs[i].run = dev_run;
+        TEST_ASSERT_EQUAL(ESP_OK, sched_add_device(&s_sched, &devs[i]));
+    }
+    devs[SCHED_MAX_DEVICES].run = dev_run;
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, sched_add_device(&s_sched, &devs[SCHED_MAX_DEVICES]));
+}
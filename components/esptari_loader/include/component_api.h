@@ -0,0 +1,245 @@
+/**
+ * @file component_api.h
+ * @brief Standard interfaces between the firmware and dynamic components
+ *
+ * Every .ebin component exports exactly one of the interface tables below
+ * through its entry point. The tables are plain C structs of function
+ * pointers so that a component can be relocated into PSRAM and linked
+ * against the firmware without any symbol resolution beyond the entry.
+ *
+ * See IMPLEMENTATION_PLAN.md, Phase 1 "Component Interfaces".
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPU_INTERFACE_V1    0x00010000
+#define VIDEO_INTERFACE_V1  0x00010000
+#define AUDIO_INTERFACE_V1  0x00010000
+
+/**
+ * @brief Component type, matches the EBIN header "Type" field
+ */
+typedef enum {
+    COMPONENT_CPU   = 1,
+    COMPONENT_VIDEO = 2,
+    COMPONENT_AUDIO = 3,
+    COMPONENT_IO    = 4,
+} component_type_t;
+
+/**
+ * @brief System bus as seen by a bus master (CPU, Blitter, DMA)
+ *
+ * Installed by the loader through cpu_interface_t::set_bus. Addresses are
+ * physical bus addresses; the CPU masks them to its address width before
+ * calling. Word and long accesses are big-endian, as on the real bus.
+ */
+typedef struct {
+    uint8_t  (*read_byte)(uint32_t addr);
+    uint16_t (*read_word)(uint32_t addr);
+    uint32_t (*read_long)(uint32_t addr);
+    void     (*write_byte)(uint32_t addr, uint8_t val);
+    void     (*write_word)(uint32_t addr, uint16_t val);
+    void     (*write_long)(uint32_t addr, uint32_t val);
+
+    /**
+     * Interrupt acknowledge cycle for @p level. Returns the vector number
+     * supplied by the device (MFP), or -1 to request an autovector
+     * (HBL/VBL on the ST). May be NULL, meaning always autovector.
+     */
+    int      (*int_ack)(int level);
+
+    /** Driven by the RESET instruction. May be NULL. */
+    void     (*reset_devices)(void);
+} bus_interface_t;
+
+/**
+ * @brief CPU register snapshot used for save states and the debugger
+ */
+typedef struct {
+    uint32_t d[8];
+    uint32_t a[8];          ///< a[7] is the active stack pointer
+    uint32_t pc;
+    uint32_t usp;
+    uint32_t ssp;
+    uint16_t sr;
+    uint64_t cycles;        ///< Total cycles executed since reset
+} cpu_state_t;
+
+/**
+ * @brief Placed storage for a component's hot data
+ *
+ * A component is loaded into PSRAM, its .bss and rodata with it. For the
+ * structures it touches on every instruction or pixel it asks the firmware
+ * for memory by placement item name ("cpu_regs", "opcode_table",
+ * "palette_lut", see esptari_placement.h), which the machine profile puts
+ * in TCM, L2MEM or PSRAM. NULL back, or NULL callbacks, means the component
+ * keeps its own copy. What init() took is given back in shutdown().
+ */
+typedef void *(*component_alloc_hot_fn)(const char *item, size_t size);
+typedef void (*component_free_hot_fn)(const char *item);
+
+/**
+ * @brief CPU configuration passed to cpu_interface_t::init
+ *
+ * Filled in from the "cpu" entry of the machine profile.
+ */
+typedef struct {
+    uint32_t clock_hz;      ///< Nominal clock, e.g. 8000000 for the ST
+    uint32_t flags;         ///< CPU_CONFIG_* option bits
+    component_alloc_hot_fn alloc_hot;   ///< May be NULL
+    component_free_hot_fn free_hot;
+} cpu_config_t;
+
+// cpu_config_t::flags
+#define CPU_CONFIG_BLOCK_CACHE  (1u << 0)   ///< Replay hot code from a basic-block cache
+
+// cpu_interface_t::features
+#define CPU_FEATURE_BLOCK_CACHE (1u << 0)   ///< Honors CPU_CONFIG_BLOCK_CACHE
+
+// Standard CPU component interface
+typedef struct {
+    uint32_t interface_version;     // Must be CPU_INTERFACE_V1
+    const char *name;               // "MC68000", "MC68030", etc.
+    uint32_t features;              // Feature flags
+
+    // Lifecycle
+    int  (*init)(void *config);     // config is a cpu_config_t *
+    void (*reset)(void);
+    void (*shutdown)(void);
+
+    // Execution
+    int  (*execute)(int cycles);    // Returns cycles consumed
+    void (*stop)(void);
+    int  (*get_elapsed)(void);      // Cycles consumed so far by the running execute()
+
+    // State
+    void (*get_state)(cpu_state_t *state);
+    void (*set_state)(const cpu_state_t *state);
+
+    // Interrupts
+    void (*set_irq)(int level);
+    void (*set_nmi)(void);
+
+    // Bus interface (set by loader)
+    void (*set_bus)(const bus_interface_t *bus);
+
+    // Memory changed behind the CPU's back (DMA, program loading); drops
+    // any cached decode of [addr, addr + len). NULL if nothing is cached.
+    void (*invalidate)(uint32_t addr, uint32_t len);
+
+    // Debug (optional)
+    int  (*disassemble)(uint32_t pc, char *buf, int len);
+    void (*set_breakpoint)(uint32_t addr);
+} cpu_interface_t;
+
+/**
+ * @brief Current video mode as reported by the video component
+ */
+typedef struct {
+    uint16_t width;         ///< Visible pixels per line
+    uint16_t height;        ///< Visible lines per frame
+    uint8_t  planes;        ///< Bitplanes (1, 2, 4, 8) or 16 for true color
+    uint8_t  refresh_hz;    ///< 50, 60 or 71
+} video_mode_t;
+
+#define VIDEO_MAX_LINES     400
+#define VIDEO_DIRTY_WORDS   ((VIDEO_MAX_LINES + 31) / 32)   ///< uint32_t per line bitmap
+
+/**
+ * @brief Video component configuration, passed to video_interface_t::init
+ *
+ * get_cycle lets the chip timestamp register writes within a scanline
+ * (sched_now() in the firmware). fetch reads video RAM as 68000 words in
+ * host order (mem_video_read()) and returns 0 on success.
+ *
+ * buffer_count is the number of output buffers render_scanline() cycles
+ * through. With it set, a line is only redrawn until every buffer holds
+ * its current content; 0 redraws every line of every frame.
+ */
+typedef struct {
+    uint32_t clock_hz;                  ///< CPU clock the cycle counts refer to
+    uint64_t (*get_cycle)(void *ctx);
+    void *cycle_ctx;
+    int (*fetch)(uint32_t addr, uint16_t *dst, size_t words);
+    uint8_t buffer_count;
+    component_alloc_hot_fn alloc_hot;   ///< May be NULL, see component_alloc_hot_fn
+    component_free_hot_fn free_hot;
+} video_config_t;
+
+// Standard video component interface (Shifter, VIDEL, etc.)
+typedef struct {
+    uint32_t interface_version;
+    const char *name;
+
+    int  (*init)(void *config);
+    void (*reset)(void);
+    void (*shutdown)(void);
+
+    // Rendering, RGB565. render_scanline() is called once per visible line
+    // at the end of its HBL; line 0 starts a new frame.
+    void (*render_scanline)(int line, uint8_t *buffer);
+    void (*render_frame)(uint8_t *framebuffer);
+
+    // Timing
+    int  (*get_hpos)(void);
+    int  (*get_vpos)(void);
+    bool (*in_vblank)(void);
+    bool (*in_hblank)(void);
+
+    // Register access
+    uint16_t (*read_reg)(uint32_t addr);
+    void     (*write_reg)(uint32_t addr, uint16_t val);
+
+    // Mode info
+    void (*get_mode)(video_mode_t *mode);
+
+    // Dirty lines (optional). mark_written() reports a write to RAM (see
+    // mem_watch_writes()); get_dirty() fills a VIDEO_DIRTY_WORDS bitmap of
+    // the lines that changed since the previous frame, as rendered since
+    // line 0.
+    void (*mark_written)(uint32_t addr, uint32_t len);
+    void (*get_dirty)(uint32_t *bitmap);
+
+    // Palette of each line at its first pixel, VIDEO_MAX_LINES x 16 RGB565,
+    // for streaming indexed pixels (optional). Valid until the next render.
+    const uint16_t *(*get_line_palettes)(void);
+} video_interface_t;
+
+// Standard audio component interface (YM2149, DMA Sound, DSP)
+typedef struct {
+    uint32_t interface_version;
+    const char *name;
+
+    int  (*init)(uint32_t sample_rate);
+    void (*reset)(void);
+    void (*shutdown)(void);
+
+    // Audio generation
+    void (*generate)(int16_t *buffer, int samples);
+
+    // Register access
+    uint8_t (*read_reg)(uint32_t addr);
+    void    (*write_reg)(uint32_t addr, uint8_t val);
+
+    // Timing
+    void (*clock)(int cycles);
+
+    // Running on a core of its own (optional, NULL if not supported).
+    // start_async() hands execution over; the firmware's task on the other
+    // core then calls run_async() in a loop, which returns the clocks run,
+    // 0 when the chip has caught up with clock().
+    void (*start_async)(void);
+    int  (*run_async)(void);
+} audio_interface_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,249 @@
+/**
+ * @file mem_bench.c
+ * @brief Host benchmark for the memory storage order
+ *
+ * Runs the m68k_bench instruction mix on the MC68000 core with RAM and ROM
+ * behind mem_bus(), then replays the bus accesses recorded from that run
+ * straight against mem_read_* / mem_write_*, which isolates the cost of the
+ * accessors from the CPU. Built twice: mem_bench with MEM_WORD_SWAPPED=1
+ * (halfword loads, byte addresses XORed) and mem_bench_bytes with
+ * MEM_WORD_SWAPPED=0 (68000 byte order, swap on every word access).
+ *
+ * Usage: mem_bench [emulated_mcycles] [replay_passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esptari_memory.h"
+#include "m68k_bench_prog.h"
+
+extern const cpu_interface_t *m68000_entry(void);
+
+#define BENCH_RAM_SIZE      0x100000
+#define BENCH_ROM_SIZE      (192 * 1024)
+#define BENCH_PASSES        5           /**< Best of, to ride out host noise */
+#define BENCH_TRACE_SLICES  2048        /**< Slices recorded for the replay */
+#define BENCH_TRACE_MAX     (1u << 20)
+
+static uint8_t s_ram[BENCH_RAM_SIZE];
+static uint8_t s_rom[BENCH_ROM_SIZE];
+
+// ---------------------------------------------------------------------------
+// Access trace
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    TR_READ_BYTE,
+    TR_READ_WORD,
+    TR_READ_LONG,
+    TR_WRITE_BYTE,
+    TR_WRITE_WORD,
+    TR_WRITE_LONG,
+} trace_op_t;
+
+typedef struct {
+    uint32_t addr;      // Bits 24-31: trace_op_t
+    uint32_t val;
+} trace_entry_t;
+
+static trace_entry_t *s_trace;
+static uint32_t s_trace_len;
+
+static void trace(trace_op_t op, uint32_t addr, uint32_t val)
+{
+    if (s_trace_len < BENCH_TRACE_MAX) {
+        s_trace[s_trace_len].addr = ((uint32_t)op << 24) | (addr & MEM_ADDR_MASK);
+        s_trace[s_trace_len].val = val;
+        s_trace_len++;
+    }
+}
+
+static uint8_t rec_read_byte(uint32_t addr)
+{
+    trace(TR_READ_BYTE, addr, 0);
+    return mem_read_byte(addr);
+}
+
+static uint16_t rec_read_word(uint32_t addr)
+{
+    trace(TR_READ_WORD, addr, 0);
+    return mem_read_word(addr);
+}
+
+static uint32_t rec_read_long(uint32_t addr)
+{
+    trace(TR_READ_LONG, addr, 0);
+    return mem_read_long(addr);
+}
+
+static void rec_write_byte(uint32_t addr, uint8_t val)
+{
+    trace(TR_WRITE_BYTE, addr, val);
+    mem_write_byte(addr, val);
+}
+
+static void rec_write_word(uint32_t addr, uint16_t val)
+{
+    trace(TR_WRITE_WORD, addr, val);
+    mem_write_word(addr, val);
+}
+
+static void rec_write_long(uint32_t addr, uint32_t val)
+{
+    trace(TR_WRITE_LONG, addr, val);
+    mem_write_long(addr, val);
+}
+
+static const bus_interface_t s_rec_bus = {
+    .read_byte     = rec_read_byte,
+    .read_word     = rec_read_word,
+    .read_long     = rec_read_long,
+    .write_byte    = rec_write_byte,
+    .write_word    = rec_write_word,
+    .write_long    = rec_write_long,
+};
+
+/** Replay the trace; the sum keeps the reads from being optimised out */
+static uint32_t trace_replay(void)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < s_trace_len; i++) {
+        uint32_t addr = s_trace[i].addr & MEM_ADDR_MASK;
+        uint32_t val = s_trace[i].val;
+
+        switch ((trace_op_t)(s_trace[i].addr >> 24)) {
+        case TR_READ_BYTE:  sum += mem_read_byte(addr); break;
+        case TR_READ_WORD:  sum += mem_read_word(addr); break;
+        case TR_READ_LONG:  sum += mem_read_long(addr); break;
+        case TR_WRITE_BYTE: mem_write_byte(addr, (uint8_t)val); break;
+        case TR_WRITE_WORD: mem_write_word(addr, (uint16_t)val); break;
+        case TR_WRITE_LONG: mem_write_long(addr, val); break;
+        }
+    }
+    return sum;
+}
+
+// ---------------------------------------------------------------------------
+// Machine
+// ---------------------------------------------------------------------------
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_load(esptari_memory_t *mem)
+{
+    static const uint8_t vectors[8] = {
+        BENCH_SSP >> 24, (BENCH_SSP >> 16) & 0xFF, (BENCH_SSP >> 8) & 0xFF, BENCH_SSP & 0xFF,
+        BENCH_PROG_START >> 24, (BENCH_PROG_START >> 16) & 0xFF,
+        (BENCH_PROG_START >> 8) & 0xFF, BENCH_PROG_START & 0xFF,
+    };
+
+    memset(s_ram, 0, sizeof(s_ram));
+    memset(s_rom, 0, sizeof(s_rom));
+    memcpy(s_rom, vectors, sizeof(vectors));
+    mem_load_image(s_rom, sizeof(s_rom));
+
+    *mem = (esptari_memory_t) {
+        .ram      = s_ram,
+        .rom      = s_rom,
+        .ram_size = BENCH_RAM_SIZE,
+        .rom_size = BENCH_ROM_SIZE,
+        .rom_base = MEM_ROM_BASE_ST,
+    };
+    if (mem_init(mem) != ESP_OK) {
+        fprintf(stderr, "mem_bench: mem_init failed\n");
+        exit(1);
+    }
+    bench_load_program(mem_bus());
+}
+
+/**
+ * @brief Run @p slices execute() slices over @p bus
+ *
+ * @return Host seconds spent in execute(), or a negative value if the CPU
+ *         left the program
+ */
+static double bench_run(const cpu_interface_t *cpu, const bus_interface_t *bus,
+                        int64_t slices, cpu_state_t *state)
+{
+    cpu_config_t config = { .clock_hz = 8000000 };
+    esptari_memory_t mem;
+
+    bench_load(&mem);
+    cpu->set_bus(bus);
+    cpu->init(&config);
+    cpu->reset();
+
+    double t0 = bench_now();
+    for (int64_t i = 0; i < slices; i++) {
+        cpu->execute(BENCH_SLICE);
+    }
+    double elapsed = bench_now() - t0;
+
+    cpu->get_state(state);
+    cpu->shutdown();
+    if (state->pc < BENCH_PROG_START || state->pc >= BENCH_PROG_END) {
+        fprintf(stderr, "mem_bench: CPU left the program, PC=%06lx\n",
+                (unsigned long)state->pc);
+        return -1.0;
+    }
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    double mcycles = argc > 1 ? atof(argv[1]) : 100.0;
+    int replays = argc > 2 ? atoi(argv[2]) : 50;
+    int64_t slices = (int64_t)(mcycles * 1e6) / BENCH_SLICE;
+    const cpu_interface_t *cpu = m68000_entry();
+    cpu_state_t state;
+    double t_cpu = 0.0, t_replay = 0.0;
+    uint32_t sum = 0;
+
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double t = bench_run(cpu, mem_bus(), slices, &state);
+        if (t < 0.0) {
+            return 1;
+        }
+        t_cpu = (pass == 0 || t < t_cpu) ? t : t_cpu;
+    }
+
+    // Record the accesses of the first BENCH_TRACE_SLICES slices
+    s_trace = malloc(BENCH_TRACE_MAX * sizeof(*s_trace));
+    if (!s_trace) {
+        return 1;
+    }
+    cpu_state_t rec_state;
+    if (bench_run(cpu, &s_rec_bus, BENCH_TRACE_SLICES, &rec_state) < 0.0) {
+        return 1;
+    }
+
+    // Replay from the same starting memory image
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        esptari_memory_t mem;
+        bench_load(&mem);
+        double t0 = bench_now();
+        for (int i = 0; i < replays; i++) {
+            sum += trace_replay();
+        }
+        double t = bench_now() - t0;
+        t_replay = (pass == 0 || t < t_replay) ? t : t_replay;
+    }
+    free(s_trace);
+
+    double accesses = (double)s_trace_len * replays;
+    printf("mem_bench: %s storage, best of %d\n",
+           MEM_WORD_SWAPPED ? "word-swapped" : "big-endian", BENCH_PASSES);
+    printf("  cpu          %8.2f MHz emulated over %lld cycles\n",
+           (double)state.cycles / t_cpu / 1e6, (long long)state.cycles);
+    printf("  replay       %8.2f ns per access, %u accesses x %d (checksum %08lx)\n",
+           t_replay / accesses * 1e9, (unsigned)s_trace_len, replays, (unsigned long)sum);
+    return 0;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file esptari_memory.h
+ * @brief Emulated address space
+ *
+ * The 24-bit bus is split into 32 KB pages. RAM and ROM pages map straight
+ * to host memory, so an access is one table load, one test and the load
+ * itself. Only I/O ($FF8000-$FFFFFF), the cartridge port and unmapped
+ * (bus error) pages go through mem_io_t callbacks. 32 KB rather than 64 KB
+ * so that the I/O area starts on a page boundary and $FF0000-$FF7FFF keeps
+ * its own bus error page.
+ *
+ * mem_read_* / mem_write_* have the bus_interface_t signatures and are
+ * handed to the CPU through mem_bus().
+ *
+ * With MEM_WORD_SWAPPED (CONFIG_ESPTARI_MEM_WORD_SWAPPED) RAM and ROM are
+ * stored as native little-endian 16-bit words: a 68000 word access is a
+ * plain halfword load or store, a byte access XORs the address with 1. The
+ * conversion is paid once, by mem_load_image() when a ROM or program is
+ * loaded and by the mem_dma_* / mem_video_* helpers for bus masters.
+ * Word and long accesses must be even, as on the 68000.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "component_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_ADDR_MASK       0x00FFFFFF
+#define MEM_PAGE_SHIFT      15
+#define MEM_PAGE_SIZE       (1u << MEM_PAGE_SHIFT)
+#define MEM_PAGE_MASK       (MEM_PAGE_SIZE - 1)
+#define MEM_PAGES           ((MEM_ADDR_MASK + 1) >> MEM_PAGE_SHIFT)
+
+#ifndef MEM_WORD_SWAPPED
+#define MEM_WORD_SWAPPED    0
+#endif
+
+// Host offset of 68000 byte address a within a mapped buffer is a ^ MEM_BYTE_XOR
+#define MEM_BYTE_XOR        (MEM_WORD_SWAPPED ? 1u : 0u)
+
+// Atari ST memory map (IMPLEMENTATION_PLAN.md, Phase 2)
+#define MEM_CART_BASE       0xFA0000
+#define MEM_CART_SIZE       0x020000
+#define MEM_ROM_BASE_ST     0xFC0000    // TOS 1.0x, 192 KB
+#define MEM_ROM_BASE_STE    0xE00000    // TOS 1.06+, 256 KB
+#define MEM_IO_BASE         0xFF8000
+#define MEM_IO_SIZE         0x008000
+
+/**
+ * @brief Memory regions
+ *
+ * Buffers are allocated by the caller (PSRAM) and must stay valid while
+ * mapped. Sizes must be multiples of MEM_PAGE_SIZE; rom_base and the RAM
+ * size must be page aligned. ram and rom are in storage order (see
+ * mem_load_image()); the cartridge is read through a handler and stays
+ * big-endian.
+ *
+ * When ram_low is set, $000000 to ram_low_size (vectors and system
+ * variables, PLACE_ST_RAM_LOW) is served from it instead of ram, which
+ * lets the hottest part of ST RAM live in internal memory. ram still spans
+ * the full ram_size; its first ram_low_size bytes are unused.
+ */
+typedef struct {
+    uint8_t *ram;           // Main RAM (PSRAM)
+    uint8_t *rom;           // TOS ROM (from SD card)
+    uint8_t *cartridge;     // Cartridge ROM (optional)
+    uint32_t ram_size;
+    uint32_t rom_size;
+    uint32_t rom_base;      // MEM_ROM_BASE_ST or MEM_ROM_BASE_STE
+    uint32_t cart_size;
+    uint8_t *ram_low;       // Optional fast copy of the first ram_low_size bytes (L2MEM)
+    uint32_t ram_low_size;
+} esptari_memory_t;
+
+/**
+ * @brief Handlers for pages without a host mapping
+ *
+ * Addresses are full 24-bit bus addresses. Long accesses arrive as two
+ * word accesses, high word first, as on the 68000 bus.
+ */
+typedef struct {
+    uint8_t  (*read8)(void *ctx, uint32_t addr);
+    uint16_t (*read16)(void *ctx, uint32_t addr);
+    void     (*write8)(void *ctx, uint32_t addr, uint8_t val);
+    void     (*write16)(void *ctx, uint32_t addr, uint16_t val);
+    void *ctx;
+} mem_io_t;
+
+/**
+ * @brief Called on an access to an unmapped page or a write to ROM
+ */
+typedef void (*mem_bus_error_cb_t)(void *ctx, uint32_t addr, bool write);
+
+/**
+ * @brief Build the ST memory map
+ *
+ * RAM from $000000, ROM at rom_base, the cartridge port when a cartridge
+ * is given, everything else bus error. I/O stays bus error until the
+ * machine maps its chips with mem_map_io(). The ROM's reset SSP/PC are
+ * copied to $000000-$000007, where the ST overlays them.
+ */
+esp_err_t mem_init(esptari_memory_t *mem);
+
+/** Map host RAM, read/write direct */
+esp_err_t mem_map_ram(uint32_t base, uint32_t size, uint8_t *host);
+
+/** Map host ROM, direct reads, writes raise a bus error */
+esp_err_t mem_map_rom(uint32_t base, uint32_t size, const uint8_t *host);
+
+/** Route a range through @p io; @p io must stay valid while mapped */
+esp_err_t mem_map_io(uint32_t base, uint32_t size, const mem_io_t *io);
+
+/** Make a range raise bus errors */
+esp_err_t mem_map_bus_error(uint32_t base, uint32_t size);
+
+void mem_set_bus_error_callback(mem_bus_error_cb_t cb, void *ctx);
+
+/**
+ * @brief Called after a write to a watched RAM page
+ */
+typedef void (*mem_watch_cb_t)(void *ctx, uint32_t addr, uint32_t len);
+
+/**
+ * @brief Report writes to the RAM pages overlapping [base, base + size)
+ *
+ * Used to track which screen lines changed. Reads of watched pages stay
+ * direct; writes take a handler that stores and then calls @p cb, so only
+ * the one or two pages holding the screen pay for it. @p cb sees every
+ * write to those pages, including mem_dma_write(), and filters by address
+ * itself. Replaces the previous watch; a NULL @p cb removes it.
+ */
+esp_err_t mem_watch_writes(uint32_t base, uint32_t size, mem_watch_cb_t cb, void *ctx);
+
+/**
+ * @brief Called when RAM changes behind the CPU
+ *
+ * Has the cpu_interface_t::invalidate signature, so the CPU's entry can be
+ * passed straight in. mem_dma_write() and mem_load_image() on a buffer
+ * inside mapped RAM call it with the bus range written, so a CPU that
+ * caches decoded code drops what the write replaced. CPU writes do not
+ * come here; the CPU sees those itself. NULL removes it.
+ */
+typedef void (*mem_invalidate_cb_t)(uint32_t addr, uint32_t len);
+
+void mem_set_invalidate_callback(mem_invalidate_cb_t cb);
+
+/** Bus errors since mem_init() */
+uint32_t mem_bus_error_count(void);
+
+// Memory access callbacks
+uint8_t  mem_read_byte(uint32_t addr);
+uint16_t mem_read_word(uint32_t addr);
+uint32_t mem_read_long(uint32_t addr);
+void     mem_write_byte(uint32_t addr, uint8_t val);
+void     mem_write_word(uint32_t addr, uint16_t val);
+void     mem_write_long(uint32_t addr, uint32_t val);
+
+/**
+ * @brief Convert a big-endian image to storage order, in place
+ *
+ * Call once on the TOS image before mem_init(), and on anything copied
+ * straight into RAM behind the bus (program loader, snapshots). The
+ * conversion is a no-op unless MEM_WORD_SWAPPED; when @p buf lies in
+ * mapped RAM the invalidate callback is told either way. @p len must be
+ * even.
+ */
+void mem_load_image(uint8_t *buf, size_t len);
+
+/**
+ * @brief DMA transfers between RAM and a big-endian byte stream
+ *
+ * For the FDC/ACSI DMA and DMA sound. RAM only, @p addr and @p len even.
+ * mem_dma_write() reports what it wrote to the watch and invalidate
+ * callbacks.
+ *
+ * @return ESP_ERR_INVALID_ARG if the range is not inside RAM
+ */
+esp_err_t mem_dma_read(uint32_t addr, uint8_t *dst, size_t len);
+esp_err_t mem_dma_write(uint32_t addr, const uint8_t *src, size_t len);
+
+/**
+ * @brief Fetch video RAM as 68000 words in host order, for the Shifter
+ *
+ * A plain copy when MEM_WORD_SWAPPED.
+ *
+ * @return ESP_ERR_INVALID_ARG if the range is not inside RAM or @p addr is odd
+ */
+esp_err_t mem_video_read(uint32_t addr, uint16_t *dst, size_t words);
+
+/** bus_interface_t over mem_read_* / mem_write_*, for cpu->set_bus() */
+const bus_interface_t *mem_bus(void);
+
+#ifdef __cplusplus
+}
+#endif
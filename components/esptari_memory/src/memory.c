@@ -0,0 +1,555 @@
+/**
+ * @file memory.c
+ * @brief Page-table dispatch for the emulated address space
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "esptari_memory.h"
+
+#define MEM_LIKELY(x)   __builtin_expect(!!(x), 1)
+
+#if MEM_WORD_SWAPPED && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "MEM_WORD_SWAPPED stores little-endian words; big-endian hosts want it off"
+#endif
+
+// Even-address offset into a page, for halfword accesses in swapped mode
+#define MEM_WORD_MASK   (MEM_PAGE_MASK & ~1u)
+
+/**
+ * @brief One 32 KB page
+ *
+ * read/write point at the host copy of the page, or are NULL when the
+ * access has to go through io. ROM pages have a read pointer only.
+ */
+typedef struct {
+    uint8_t *read;
+    uint8_t *write;
+    const mem_io_t *io;
+} mem_page_t;
+
+static mem_page_t s_pages[MEM_PAGES];
+static const esptari_memory_t *s_mem;
+static mem_bus_error_cb_t s_bus_error_cb;
+static void *s_bus_error_ctx;
+static uint32_t s_bus_errors;
+static mem_watch_cb_t s_watch_cb;
+static void *s_watch_ctx;
+static mem_invalidate_cb_t s_invalidate_cb;
+
+// ---------------------------------------------------------------------------
+// Bus error and cartridge handlers
+// ---------------------------------------------------------------------------
+
+static void bus_error(uint32_t addr, bool write)
+{
+    s_bus_errors++;
+    if (s_bus_error_cb) {
+        s_bus_error_cb(s_bus_error_ctx, addr, write);
+    }
+}
+
+static uint8_t berr_read8(void *ctx, uint32_t addr)
+{
+    bus_error(addr, false);
+    return 0xFF;
+}
+
+static uint16_t berr_read16(void *ctx, uint32_t addr)
+{
+    bus_error(addr, false);
+    return 0xFFFF;
+}
+
+static void berr_write8(void *ctx, uint32_t addr, uint8_t val)
+{
+    bus_error(addr, true);
+}
+
+static void berr_write16(void *ctx, uint32_t addr, uint16_t val)
+{
+    bus_error(addr, true);
+}
+
+static const mem_io_t s_bus_error_io = {
+    .read8   = berr_read8,
+    .read16  = berr_read16,
+    .write8  = berr_write8,
+    .write16 = berr_write16,
+};
+
+static uint8_t cart_read8(void *ctx, uint32_t addr)
+{
+    const esptari_memory_t *mem = ctx;
+    uint32_t off = addr - MEM_CART_BASE;
+
+    return off < mem->cart_size ? mem->cartridge[off] : 0xFF;
+}
+
+static uint16_t cart_read16(void *ctx, uint32_t addr)
+{
+    return (uint16_t)((cart_read8(ctx, addr) << 8) | cart_read8(ctx, addr + 1));
+}
+
+static mem_io_t s_cart_io = {
+    .read8   = cart_read8,
+    .read16  = cart_read16,
+    .write8  = berr_write8,
+    .write16 = berr_write16,
+};
+
+// ---------------------------------------------------------------------------
+// Mapping
+// ---------------------------------------------------------------------------
+
+static bool mem_range_ok(uint32_t base, uint32_t size)
+{
+    return size != 0 && ((base | size) & MEM_PAGE_MASK) == 0 &&
+           base <= MEM_ADDR_MASK && size <= (MEM_ADDR_MASK + 1) - base;
+}
+
+static void mem_set_pages(uint32_t base, uint32_t size, uint8_t *read, uint8_t *write,
+                          const mem_io_t *io)
+{
+    uint32_t first = base >> MEM_PAGE_SHIFT;
+    uint32_t count = size >> MEM_PAGE_SHIFT;
+
+    for (uint32_t i = 0; i < count; i++) {
+        mem_page_t *p = &s_pages[first + i];
+        p->read = read ? read + i * MEM_PAGE_SIZE : NULL;
+        p->write = write ? write + i * MEM_PAGE_SIZE : NULL;
+        p->io = io;
+    }
+}
+
+esp_err_t mem_map_ram(uint32_t base, uint32_t size, uint8_t *host)
+{
+    if (!mem_range_ok(base, size) || !host) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mem_set_pages(base, size, host, host, &s_bus_error_io);
+    return ESP_OK;
+}
+
+esp_err_t mem_map_rom(uint32_t base, uint32_t size, const uint8_t *host)
+{
+    if (!mem_range_ok(base, size) || !host) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Never written through: write is NULL, so writes take the bus error io
+    mem_set_pages(base, size, (uint8_t *)host, NULL, &s_bus_error_io);
+    return ESP_OK;
+}
+
+esp_err_t mem_map_io(uint32_t base, uint32_t size, const mem_io_t *io)
+{
+    if (!mem_range_ok(base, size) || !io || !io->read8 || !io->read16 ||
+        !io->write8 || !io->write16) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mem_set_pages(base, size, NULL, NULL, io);
+    return ESP_OK;
+}
+
+esp_err_t mem_map_bus_error(uint32_t base, uint32_t size)
+{
+    if (!mem_range_ok(base, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mem_set_pages(base, size, NULL, NULL, &s_bus_error_io);
+    return ESP_OK;
+}
+
+/**
+ * @brief Host address of RAM offset @p addr
+ *
+ * @param run Set to the number of bytes contiguous from there
+ */
+static uint8_t *mem_ram_at(uint32_t addr, size_t *run)
+{
+    if (s_mem->ram_low && addr < s_mem->ram_low_size) {
+        if (run) {
+            *run = s_mem->ram_low_size - addr;
+        }
+        return s_mem->ram_low + addr;
+    }
+    if (run) {
+        *run = s_mem->ram_size - addr;
+    }
+    return s_mem->ram + addr;
+}
+
+esp_err_t mem_init(esptari_memory_t *mem)
+{
+    esp_err_t err;
+
+    if (!mem || !mem->ram || !mem->rom || mem->rom_size < 8) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mem->ram_low && mem->ram_low_size > mem->ram_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_bus_errors = 0;
+    s_watch_cb = NULL;
+    mem_set_pages(0, MEM_ADDR_MASK + 1, NULL, NULL, &s_bus_error_io);
+
+    err = mem_map_ram(0, mem->ram_size, mem->ram);
+    if (err == ESP_OK && mem->ram_low) {
+        err = mem_map_ram(0, mem->ram_low_size, mem->ram_low);
+    }
+    if (err == ESP_OK) {
+        err = mem_map_rom(mem->rom_base, mem->rom_size, mem->rom);
+    }
+    if (err == ESP_OK && mem->cartridge) {
+        if (mem->cart_size > MEM_CART_SIZE) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        s_cart_io.ctx = mem;
+        err = mem_map_io(MEM_CART_BASE, MEM_CART_SIZE, &s_cart_io);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Reset SSP and PC are read from ROM through the overlay at address 0.
+    // Whole words, so the copy is the same in either storage order.
+    s_mem = mem;
+    uint8_t *low = mem_ram_at(0, NULL);
+    for (int i = 0; i < 8; i++) {
+        low[i] = mem->rom[i];
+    }
+    return ESP_OK;
+}
+
+void mem_set_bus_error_callback(mem_bus_error_cb_t cb, void *ctx)
+{
+    s_bus_error_cb = cb;
+    s_bus_error_ctx = ctx;
+}
+
+void mem_set_invalidate_callback(mem_invalidate_cb_t cb)
+{
+    s_invalidate_cb = cb;
+}
+
+uint32_t mem_bus_error_count(void)
+{
+    return s_bus_errors;
+}
+
+// ---------------------------------------------------------------------------
+// Storage order
+// ---------------------------------------------------------------------------
+
+#if MEM_WORD_SWAPPED
+
+static inline uint16_t mem_ld16(const uint8_t *b)
+{
+    uint16_t v;
+    memcpy(&v, __builtin_assume_aligned(b, 2), sizeof(v));
+    return v;
+}
+
+static inline void mem_st16(uint8_t *b, uint16_t v)
+{
+    memcpy(__builtin_assume_aligned(b, 2), &v, sizeof(v));
+}
+
+#else
+
+static inline uint16_t mem_ld16(const uint8_t *b)
+{
+    return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+static inline void mem_st16(uint8_t *b, uint16_t v)
+{
+    b[0] = (uint8_t)(v >> 8);
+    b[1] = (uint8_t)v;
+}
+
+#endif
+
+/**
+ * @brief Tell the CPU about a load into RAM behind the bus
+ *
+ * Only buffers inside ram or ram_low have a bus address; the TOS image and
+ * anything staged elsewhere are not code the CPU can have cached yet.
+ */
+static void mem_loaded(const uint8_t *buf, size_t len)
+{
+    uintptr_t p = (uintptr_t)buf;
+
+    if (!s_invalidate_cb || !s_mem || !len) {
+        return;
+    }
+    if (s_mem->ram_low && p >= (uintptr_t)s_mem->ram_low &&
+        p - (uintptr_t)s_mem->ram_low < s_mem->ram_low_size) {
+        s_invalidate_cb((uint32_t)(p - (uintptr_t)s_mem->ram_low), (uint32_t)len);
+    } else if (p >= (uintptr_t)s_mem->ram && p - (uintptr_t)s_mem->ram < s_mem->ram_size) {
+        s_invalidate_cb((uint32_t)(p - (uintptr_t)s_mem->ram), (uint32_t)len);
+    }
+}
+
+void mem_load_image(uint8_t *buf, size_t len)
+{
+#if MEM_WORD_SWAPPED
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        uint8_t t = buf[i];
+        buf[i] = buf[i + 1];
+        buf[i + 1] = t;
+    }
+#endif
+    mem_loaded(buf, len);
+}
+
+// ---------------------------------------------------------------------------
+// Write watch. Watched RAM pages keep their read pointer, writes come here.
+// ---------------------------------------------------------------------------
+
+static uint8_t watch_read8(void *ctx, uint32_t addr)
+{
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+    return p->read[(addr & MEM_PAGE_MASK) ^ MEM_BYTE_XOR];
+}
+
+static uint16_t watch_read16(void *ctx, uint32_t addr)
+{
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+    return mem_ld16(p->read + (addr & MEM_WORD_MASK));
+}
+
+static void watch_write8(void *ctx, uint32_t addr, uint8_t val)
+{
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    p->read[(addr & MEM_PAGE_MASK) ^ MEM_BYTE_XOR] = val;
+    s_watch_cb(s_watch_ctx, addr, 1);
+}
+
+static void watch_write16(void *ctx, uint32_t addr, uint16_t val)
+{
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    mem_st16(p->read + (addr & MEM_WORD_MASK), val);
+    s_watch_cb(s_watch_ctx, addr, 2);
+}
+
+static const mem_io_t s_watch_io = {
+    .read8   = watch_read8,
+    .read16  = watch_read16,
+    .write8  = watch_write8,
+    .write16 = watch_write16,
+};
+
+esp_err_t mem_watch_writes(uint32_t base, uint32_t size, mem_watch_cb_t cb, void *ctx)
+{
+    // Drop the previous watch
+    for (int i = 0; i < MEM_PAGES; i++) {
+        if (s_pages[i].io == &s_watch_io) {
+            s_pages[i].write = s_pages[i].read;
+            s_pages[i].io = &s_bus_error_io;
+        }
+    }
+    s_watch_cb = NULL;
+    if (!cb) {
+        return ESP_OK;
+    }
+    if (size == 0 || (base & MEM_ADDR_MASK) != base || size > (MEM_ADDR_MASK + 1) - base) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_watch_cb = cb;
+    s_watch_ctx = ctx;
+    for (uint32_t i = base >> MEM_PAGE_SHIFT; i <= (base + size - 1) >> MEM_PAGE_SHIFT; i++) {
+        mem_page_t *p = &s_pages[i];
+        // RAM only: ROM and I/O pages have no write pointer to take over
+        if (p->read && p->write) {
+            p->write = NULL;
+            p->io = &s_watch_io;
+        }
+    }
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Access. RAM/ROM: one table load, one NULL test, the access itself.
+// ---------------------------------------------------------------------------
+
+uint8_t mem_read_byte(uint32_t addr)
+{
+    addr &= MEM_ADDR_MASK;
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    if (MEM_LIKELY(p->read)) {
+        return p->read[(addr & MEM_PAGE_MASK) ^ MEM_BYTE_XOR];
+    }
+    return p->io->read8(p->io->ctx, addr);
+}
+
+uint16_t mem_read_word(uint32_t addr)
+{
+    addr &= MEM_ADDR_MASK;
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    if (MEM_LIKELY(p->read)) {
+        return mem_ld16(p->read + (addr & MEM_WORD_MASK));
+    }
+    return p->io->read16(p->io->ctx, addr);
+}
+
+uint32_t mem_read_long(uint32_t addr)
+{
+    addr &= MEM_ADDR_MASK;
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    if (MEM_LIKELY(p->read) && (addr & MEM_PAGE_MASK) <= MEM_PAGE_SIZE - 4) {
+        const uint8_t *b = p->read + (addr & MEM_WORD_MASK);
+        return ((uint32_t)mem_ld16(b) << 16) | mem_ld16(b + 2);
+    }
+    return ((uint32_t)mem_read_word(addr) << 16) | mem_read_word(addr + 2);
+}
+
+void mem_write_byte(uint32_t addr, uint8_t val)
+{
+    addr &= MEM_ADDR_MASK;
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    if (MEM_LIKELY(p->write)) {
+        p->write[(addr & MEM_PAGE_MASK) ^ MEM_BYTE_XOR] = val;
+        return;
+    }
+    p->io->write8(p->io->ctx, addr, val);
+}
+
+void mem_write_word(uint32_t addr, uint16_t val)
+{
+    addr &= MEM_ADDR_MASK;
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    if (MEM_LIKELY(p->write)) {
+        mem_st16(p->write + (addr & MEM_WORD_MASK), val);
+        return;
+    }
+    p->io->write16(p->io->ctx, addr, val);
+}
+
+void mem_write_long(uint32_t addr, uint32_t val)
+{
+    addr &= MEM_ADDR_MASK;
+    const mem_page_t *p = &s_pages[addr >> MEM_PAGE_SHIFT];
+
+    if (MEM_LIKELY(p->write) && (addr & MEM_PAGE_MASK) <= MEM_PAGE_SIZE - 4) {
+        uint8_t *b = p->write + (addr & MEM_WORD_MASK);
+        mem_st16(b, (uint16_t)(val >> 16));
+        mem_st16(b + 2, (uint16_t)val);
+        return;
+    }
+    mem_write_word(addr, (uint16_t)(val >> 16));
+    mem_write_word(addr + 2, (uint16_t)val);
+}
+
+// ---------------------------------------------------------------------------
+// Bus masters. They see RAM directly, not through the page table.
+// ---------------------------------------------------------------------------
+
+static bool mem_ram_range_ok(uint32_t addr, size_t len)
+{
+    return s_mem && ((addr | len) & 1) == 0 && addr <= s_mem->ram_size &&
+           len <= s_mem->ram_size - addr;
+}
+
+esp_err_t mem_dma_read(uint32_t addr, uint8_t *dst, size_t len)
+{
+    if (!mem_ram_range_ok(addr, len) || !dst) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (len) {
+        size_t n;
+        const uint8_t *src = mem_ram_at(addr, &n);
+        n = n < len ? n : len;
+#if MEM_WORD_SWAPPED
+        for (size_t i = 0; i < n; i += 2) {
+            dst[i] = src[i + 1];
+            dst[i + 1] = src[i];
+        }
+#else
+        memcpy(dst, src, n);
+#endif
+        addr += (uint32_t)n;
+        dst += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mem_dma_write(uint32_t addr, const uint8_t *src, size_t len)
+{
+    if (!mem_ram_range_ok(addr, len) || !src) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (len) {
+        size_t n;
+        uint8_t *dst = mem_ram_at(addr, &n);
+        n = n < len ? n : len;
+#if MEM_WORD_SWAPPED
+        for (size_t i = 0; i < n; i += 2) {
+            dst[i] = src[i + 1];
+            dst[i + 1] = src[i];
+        }
+#else
+        memcpy(dst, src, n);
+#endif
+        if (s_watch_cb) {
+            s_watch_cb(s_watch_ctx, addr, (uint32_t)n);
+        }
+        if (s_invalidate_cb) {
+            s_invalidate_cb(addr, (uint32_t)n);
+        }
+        addr += (uint32_t)n;
+        src += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mem_video_read(uint32_t addr, uint16_t *dst, size_t words)
+{
+    size_t len = words * 2;
+
+    if (!mem_ram_range_ok(addr, len) || !dst) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (len) {
+        size_t n;
+        const uint8_t *src = mem_ram_at(addr, &n);
+        n = n < len ? n : len;
+#if MEM_WORD_SWAPPED
+        memcpy(dst, src, n);
+#else
+        for (size_t i = 0; i < n / 2; i++) {
+            dst[i] = mem_ld16(src + i * 2);
+        }
+#endif
+        addr += (uint32_t)n;
+        dst += n / 2;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static const bus_interface_t s_bus = {
+    .read_byte     = mem_read_byte,
+    .read_word     = mem_read_word,
+    .read_long     = mem_read_long,
+    .write_byte    = mem_write_byte,
+    .write_word    = mem_write_word,
+    .write_long    = mem_write_long,
+    .int_ack       = NULL,
+    .reset_devices = NULL,
+};
+
+const bus_interface_t *mem_bus(void)
+{
+    return &s_bus;
+}
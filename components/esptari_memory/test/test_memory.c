@@ -0,0 +1,359 @@
+/**
+ * @file test_memory.c
+ * @brief Memory map and page-table dispatch tests
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "esptari_memory.h"
+
+#define TEST_RAM_SIZE   (512 * 1024)
+#define TEST_ROM_SIZE   (192 * 1024)
+
+static uint8_t s_ram[TEST_RAM_SIZE];
+static uint8_t s_rom[TEST_ROM_SIZE];
+static uint8_t s_cart[4];
+static esptari_memory_t s_mem;
+
+static uint32_t s_berr_addr;
+static bool s_berr_write;
+
+static void on_bus_error(void *ctx, uint32_t addr, bool write)
+{
+    s_berr_addr = addr;
+    s_berr_write = write;
+}
+
+// Host byte holding 68000 byte address a of a mapped buffer
+#define RAW(buf, a)     ((buf)[(a) ^ MEM_BYTE_XOR])
+
+static uint8_t rom_byte(uint32_t i)
+{
+    return (uint8_t)(i ^ (i >> 8));
+}
+
+static void setup_st(bool with_cart)
+{
+    memset(s_ram, 0, sizeof(s_ram));
+    for (uint32_t i = 0; i < TEST_ROM_SIZE; i++) {
+        s_rom[i] = rom_byte(i);
+    }
+    mem_load_image(s_rom, sizeof(s_rom));
+    memcpy(s_cart, "\xAB\xCD\xEF\x12", 4);
+
+    s_mem = (esptari_memory_t) {
+        .ram       = s_ram,
+        .rom       = s_rom,
+        .cartridge = with_cart ? s_cart : NULL,
+        .ram_size  = TEST_RAM_SIZE,
+        .rom_size  = TEST_ROM_SIZE,
+        .rom_base  = MEM_ROM_BASE_ST,
+        .cart_size = with_cart ? sizeof(s_cart) : 0,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, mem_init(&s_mem));
+    mem_set_bus_error_callback(on_bus_error, NULL);
+    s_berr_addr = 0;
+}
+
+// Fake I/O chip: records the last access
+static struct {
+    uint32_t addr;
+    uint32_t val;
+    int writes;
+} s_io;
+
+static uint8_t io_read8(void *ctx, uint32_t addr)
+{
+    s_io.addr = addr;
+    return (uint8_t)addr;
+}
+
+static uint16_t io_read16(void *ctx, uint32_t addr)
+{
+    s_io.addr = addr;
+    return (uint16_t)(0x1000 | (addr & 0xFFF));
+}
+
+static void io_write8(void *ctx, uint32_t addr, uint8_t val)
+{
+    s_io.addr = addr;
+    s_io.val = val;
+    s_io.writes++;
+}
+
+static void io_write16(void *ctx, uint32_t addr, uint16_t val)
+{
+    s_io.addr = addr;
+    s_io.val = val;
+    s_io.writes++;
+}
+
+static const mem_io_t s_test_io = {
+    .read8   = io_read8,
+    .read16  = io_read16,
+    .write8  = io_write8,
+    .write16 = io_write16,
+};
+
+TEST_CASE("mem RAM is big endian and direct", "[memory]")
+{
+    setup_st(false);
+    mem_write_long(0x1000, 0x12345678);
+    TEST_ASSERT_EQUAL_HEX8(0x12, RAW(s_ram, 0x1000));
+    TEST_ASSERT_EQUAL_HEX8(0x78, RAW(s_ram, 0x1003));
+    TEST_ASSERT_EQUAL_HEX16(0x1234, mem_read_word(0x1000));
+    TEST_ASSERT_EQUAL_HEX8(0x56, mem_read_byte(0x1002));
+
+    mem_write_word(0x2000, 0xBEEF);
+    mem_write_byte(0x2001, 0x42);
+    TEST_ASSERT_EQUAL_HEX32(0xBE420000, mem_read_long(0x2000));
+    TEST_ASSERT_EQUAL_UINT32(0, mem_bus_error_count());
+}
+
+TEST_CASE("mem long access across a page boundary", "[memory]")
+{
+    setup_st(false);
+    mem_write_long(MEM_PAGE_SIZE - 2, 0xCAFEF00D);
+    TEST_ASSERT_EQUAL_HEX32(0xCAFEF00D, mem_read_long(MEM_PAGE_SIZE - 2));
+    TEST_ASSERT_EQUAL_HEX16(0xF00D, mem_read_word(MEM_PAGE_SIZE));
+}
+
+TEST_CASE("mem address bus is 24 bits", "[memory]")
+{
+    setup_st(false);
+    mem_write_word(0xFF000100, 0x5AA5);
+    TEST_ASSERT_EQUAL_HEX16(0x5AA5, mem_read_word(0x100));
+}
+
+TEST_CASE("mem ROM reads direct, writes bus error", "[memory]")
+{
+    setup_st(false);
+    TEST_ASSERT_EQUAL_HEX8(rom_byte(0x1235), mem_read_byte(MEM_ROM_BASE_ST + 0x1235));
+    TEST_ASSERT_EQUAL_HEX16((rom_byte(0x1234) << 8) | rom_byte(0x1235),
+                            mem_read_word(MEM_ROM_BASE_ST + 0x1234));
+    mem_write_word(MEM_ROM_BASE_ST + 0x10, 0);
+    TEST_ASSERT_EQUAL_HEX8(rom_byte(0x10), mem_read_byte(MEM_ROM_BASE_ST + 0x10));
+    TEST_ASSERT_EQUAL_UINT32(1, mem_bus_error_count());
+    TEST_ASSERT_EQUAL_HEX32(MEM_ROM_BASE_ST + 0x10, s_berr_addr);
+    TEST_ASSERT_TRUE(s_berr_write);
+}
+
+TEST_CASE("mem reset vectors overlay from ROM", "[memory]")
+{
+    setup_st(false);
+    TEST_ASSERT_EQUAL_HEX32(mem_read_long(MEM_ROM_BASE_ST), mem_read_long(0));
+    TEST_ASSERT_EQUAL_HEX32(mem_read_long(MEM_ROM_BASE_ST + 4), mem_read_long(4));
+}
+
+TEST_CASE("mem unmapped space raises bus errors", "[memory]")
+{
+    setup_st(false);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, mem_read_word(TEST_RAM_SIZE));
+    TEST_ASSERT_EQUAL_HEX32(TEST_RAM_SIZE, s_berr_addr);
+    TEST_ASSERT_FALSE(s_berr_write);
+    // I/O is unmapped until the machine maps its chips
+    mem_write_byte(0xFF8800, 0);
+    TEST_ASSERT_EQUAL_HEX32(0xFF8800, s_berr_addr);
+    // No cartridge inserted
+    mem_read_byte(MEM_CART_BASE);
+    TEST_ASSERT_EQUAL_UINT32(3, mem_bus_error_count());
+}
+
+TEST_CASE("mem I/O pages dispatch to handlers", "[memory]")
+{
+    setup_st(false);
+    memset(&s_io, 0, sizeof(s_io));
+    TEST_ASSERT_EQUAL(ESP_OK, mem_map_io(MEM_IO_BASE, MEM_IO_SIZE, &s_test_io));
+
+    TEST_ASSERT_EQUAL_HEX8(0x01, mem_read_byte(0xFF8201));
+    TEST_ASSERT_EQUAL_HEX32(0xFF8201, s_io.addr);
+    TEST_ASSERT_EQUAL_HEX16(0x1240, mem_read_word(0xFF8240));
+
+    // Longs are two word cycles, high word first
+    mem_write_long(0xFFFA00, 0x11223344);
+    TEST_ASSERT_EQUAL(2, s_io.writes);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFA02, s_io.addr);
+    TEST_ASSERT_EQUAL_HEX32(0x3344, s_io.val);
+    TEST_ASSERT_EQUAL_HEX32(0x1A001A02, mem_read_long(0xFFFA00));
+
+    // $FF0000-$FF7FFF is a separate page and still a bus error
+    mem_read_byte(0xFF7FFF);
+    TEST_ASSERT_EQUAL_UINT32(1, mem_bus_error_count());
+}
+
+TEST_CASE("mem cartridge goes through its handler", "[memory]")
+{
+    setup_st(true);
+    TEST_ASSERT_EQUAL_HEX16(0xABCD, mem_read_word(MEM_CART_BASE));
+    TEST_ASSERT_EQUAL_HEX32(0xABCDEF12, mem_read_long(MEM_CART_BASE));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, mem_read_byte(MEM_CART_BASE + 4));
+    mem_write_byte(MEM_CART_BASE, 0);
+    TEST_ASSERT_EQUAL_UINT32(1, mem_bus_error_count());
+}
+
+TEST_CASE("mem rejects unaligned mappings", "[memory]")
+{
+    setup_st(false);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mem_map_ram(0x100, MEM_PAGE_SIZE, s_ram));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mem_map_ram(0, MEM_PAGE_SIZE + 2, s_ram));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mem_map_io(0xFF8000, 0x10000, &s_test_io));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mem_map_bus_error(0, 0));
+}
+
+TEST_CASE("mem DMA moves big-endian byte streams", "[memory]")
+{
+    static const uint8_t sector[6] = { 0x60, 0x1C, 0x4E, 0x75, 0x12, 0x34 };
+    uint8_t back[6];
+
+    setup_st(false);
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(0x8000, sector, sizeof(sector)));
+    TEST_ASSERT_EQUAL_HEX16(0x601C, mem_read_word(0x8000));
+    TEST_ASSERT_EQUAL_HEX32(0x4E751234, mem_read_long(0x8002));
+
+    mem_write_word(0x8004, 0xABCD);
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_read(0x8000, back, sizeof(back)));
+    TEST_ASSERT_EQUAL_HEX8(0xAB, back[4]);
+    TEST_ASSERT_EQUAL_HEX8(0xCD, back[5]);
+    TEST_ASSERT_EQUAL_MEMORY(sector, back, 4);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mem_dma_read(TEST_RAM_SIZE - 2, back, 4));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mem_dma_write(0x8001, sector, 2));
+}
+
+TEST_CASE("mem Shifter fetch returns 68000 words", "[memory]")
+{
+    uint16_t words[4];
+
+    setup_st(false);
+    mem_write_long(0x78000, 0x80004000);
+    mem_write_byte(0x78004, 0x20);
+    mem_write_byte(0x78007, 0x01);
+    TEST_ASSERT_EQUAL(ESP_OK, mem_video_read(0x78000, words, 4));
+    TEST_ASSERT_EQUAL_HEX16(0x8000, words[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x4000, words[1]);
+    TEST_ASSERT_EQUAL_HEX16(0x2000, words[2]);
+    TEST_ASSERT_EQUAL_HEX16(0x0001, words[3]);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mem_video_read(0x78001, words, 1));
+}
+
+TEST_CASE("mem low RAM can live in its own buffer", "[memory]")
+{
+    static uint8_t low[2 * MEM_PAGE_SIZE];
+    static const uint8_t data[4] = { 0x11, 0x22, 0x33, 0x44 };
+    uint8_t back[4];
+
+    setup_st(false);
+    memset(low, 0, sizeof(low));
+    s_mem.ram_low = low;
+    s_mem.ram_low_size = sizeof(low);
+    TEST_ASSERT_EQUAL(ESP_OK, mem_init(&s_mem));
+
+    // Reset vectors land in the low buffer
+    TEST_ASSERT_EQUAL_HEX32(mem_read_long(MEM_ROM_BASE_ST), mem_read_long(0));
+    TEST_ASSERT_EQUAL_HEX8(rom_byte(0), RAW(low, 0));
+
+    mem_write_word(0x42E, 0x1234);
+    TEST_ASSERT_EQUAL_HEX8(0x12, RAW(low, 0x42E));
+    mem_write_word(sizeof(low), 0x5678);
+    TEST_ASSERT_EQUAL_HEX8(0x56, RAW(s_ram, sizeof(low)));
+
+    // DMA across the split
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(sizeof(low) - 2, data, sizeof(data)));
+    TEST_ASSERT_EQUAL_HEX32(0x11223344, mem_read_long(sizeof(low) - 2));
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_read(sizeof(low) - 2, back, sizeof(back)));
+    TEST_ASSERT_EQUAL_MEMORY(data, back, sizeof(data));
+
+    s_mem.ram_low_size = TEST_RAM_SIZE * 2;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, mem_init(&s_mem));
+    s_mem.ram_low = NULL;
+    s_mem.ram_low_size = 0;
+}
+
+static uint32_t s_watch_addr, s_watch_len;
+static int s_watch_calls;
+
+static void on_watch(void *ctx, uint32_t addr, uint32_t len)
+{
+    s_watch_addr = addr;
+    s_watch_len = len;
+    s_watch_calls++;
+}
+
+TEST_CASE("mem watched pages report writes", "[memory]")
+{
+    static const uint8_t data[4] = { 1, 2, 3, 4 };
+
+    setup_st(false);
+    s_watch_calls = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, mem_watch_writes(0x78000, 32000, on_watch, NULL));
+
+    mem_write_word(0x78100, 0xF00F);
+    TEST_ASSERT_EQUAL(1, s_watch_calls);
+    TEST_ASSERT_EQUAL_HEX32(0x78100, s_watch_addr);
+    TEST_ASSERT_EQUAL(2, s_watch_len);
+    TEST_ASSERT_EQUAL_HEX16(0xF00F, mem_read_word(0x78100));
+
+    // Longs arrive as two words
+    mem_write_long(0x78200, 0x12345678);
+    TEST_ASSERT_EQUAL(3, s_watch_calls);
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, mem_read_long(0x78200));
+    mem_write_byte(0x78301, 0xAA);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, mem_read_byte(0x78301));
+
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(0x78400, data, sizeof(data)));
+    TEST_ASSERT_EQUAL(5, s_watch_calls);
+    TEST_ASSERT_EQUAL(4, s_watch_len);
+
+    // Pages outside the watch stay direct
+    mem_write_word(0x1000, 0);
+    TEST_ASSERT_EQUAL(5, s_watch_calls);
+
+    TEST_ASSERT_EQUAL(ESP_OK, mem_watch_writes(0, 0, NULL, NULL));
+    mem_write_word(0x78100, 0);
+    TEST_ASSERT_EQUAL(5, s_watch_calls);
+    TEST_ASSERT_EQUAL_UINT32(0, mem_bus_error_count());
+}
+
+static uint32_t s_inval_addr, s_inval_len;
+static int s_inval_calls;
+
+static void on_invalidate(uint32_t addr, uint32_t len)
+{
+    s_inval_addr = addr;
+    s_inval_len = len;
+    s_inval_calls++;
+}
+
+TEST_CASE("mem DMA and image loads invalidate CPU caches", "[memory]")
+{
+    static const uint8_t code[4] = { 0x53, 0x80, 0x60, 0xFC };
+
+    setup_st(false);
+    s_inval_calls = 0;
+    mem_set_invalidate_callback(on_invalidate);
+
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(0x1000, code, sizeof(code)));
+    TEST_ASSERT_EQUAL(1, s_inval_calls);
+    TEST_ASSERT_EQUAL_HEX32(0x1000, s_inval_addr);
+    TEST_ASSERT_EQUAL(4, s_inval_len);
+
+    // A program copied into RAM behind the bus
+    memcpy(s_ram + 0x2000, code, sizeof(code));
+    mem_load_image(s_ram + 0x2000, sizeof(code));
+    TEST_ASSERT_EQUAL(2, s_inval_calls);
+    TEST_ASSERT_EQUAL_HEX32(0x2000, s_inval_addr);
+    TEST_ASSERT_EQUAL_HEX16(0x5380, mem_read_word(0x2000));
+
+    // Buffers outside RAM have no bus address (twice, to leave the ROM as it was)
+    mem_load_image(s_rom, 2);
+    mem_load_image(s_rom, 2);
+    TEST_ASSERT_EQUAL(2, s_inval_calls);
+
+    // CPU writes are the CPU's own business
+    mem_write_word(0x1000, 0x4E71);
+    TEST_ASSERT_EQUAL(2, s_inval_calls);
+
+    mem_set_invalidate_callback(NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(0x1000, code, sizeof(code)));
+    TEST_ASSERT_EQUAL(2, s_inval_calls);
+}
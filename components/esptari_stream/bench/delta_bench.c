@@ -0,0 +1,300 @@
+/**
+ * @file delta_bench.c
+ * @brief Host round-trip benchmark for the delta-frame codec
+ *
+ * Encodes frame sequences, decodes every packet and checks the rendered
+ * RGB565 frame against the source, then reports the packet sizes next to
+ * the 512000-byte raw_frame_packet_t frame of IMPLEMENTATION_PLAN.md 3.2
+ * (640x400 RGB565) and the time spent on each side.
+ *
+ * Built-in sequences stand in for recordings:
+ * - gem_low / gem_high: GEM desktop with a moving mouse pointer and text
+ *   being typed into a window, ST low (320x200x4) and high (640x400x1)
+ * - scroll: a text screen scrolling one pixel per frame, ST high
+ * - demo: raster bars through per-row palettes and a 96x64 animated
+ *   sprite, ST low
+ *
+ * A recorded sequence is a file of back-to-back frames of width * height
+ * colour index bytes, shown through a fixed palette:
+ *
+ * Usage: delta_bench [frames]
+ *        delta_bench file width height bpp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esptari_delta.h"
+
+#define BENCH_FRAMES        500
+#define BENCH_RAW_BYTES     (640 * 400 * 2)     /**< raw_frame_packet_t payload */
+#define BENCH_FPS           50
+
+static uint8_t s_index[DELTA_MAX_WIDTH * DELTA_MAX_HEIGHT];
+static uint16_t s_palette[DELTA_MAX_HEIGHT * 16];
+static uint16_t s_expect[DELTA_MAX_WIDTH * DELTA_MAX_HEIGHT];
+static uint16_t s_out[DELTA_MAX_WIDTH * DELTA_MAX_HEIGHT];
+
+typedef struct {
+    const char *name;
+    uint16_t width;
+    uint16_t height;
+    uint8_t bpp;
+    bool per_row;
+    void (*render)(int frame, int width, int height);   // Fills s_index, s_palette
+} bench_seq_t;
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t bench_hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    return x ^ (x >> 16);
+}
+
+/** 8x8 glyph cell @p ch: pseudo-random strokes, blank for ch % 5 == 0 */
+static bool bench_glyph(uint32_t ch, int x, int y)
+{
+    if (ch % 5 == 0 || x == 7 || y == 7) {
+        return false;
+    }
+    return bench_hash(ch * 64 + (uint32_t)(y * 8 + x)) & 1;
+}
+
+static void bench_grey_palette(void)
+{
+    for (int i = 0; i < 16; i++) {
+        s_palette[i] = (uint16_t)(((i * 2) << 11) | ((i * 4) << 5) | (i * 2));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Sequences
+// ---------------------------------------------------------------------------
+
+static void seq_gem(int frame, int width, int height)
+{
+    int scale = width / 320;                    // High res doubles everything
+    int wx0 = 40 * scale, wx1 = 280 * scale;
+    int wy0 = 30 * (height / 200), wy1 = 170 * (height / 200);
+    int typed = frame / 4;                      // Characters typed so far
+    int cols = (wx1 - wx0 - 16) / 8;
+    int mx = 20 + (frame * 3) % (width - 60);   // Mouse pointer
+    int my = 20 + (frame * 2) % (height - 60);
+
+    bench_grey_palette();
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t c;
+            if (x >= wx0 && x < wx1 && y >= wy0 && y < wy1) {
+                int tx = x - wx0 - 8, ty = y - wy0 - 8;
+                int n = ty >= 0 && tx >= 0 && tx < cols * 8 ? (ty / 8) * cols + tx / 8 : -1;
+                c = n >= 0 && n < typed && bench_glyph((uint32_t)n, tx % 8, ty % 8) ? 1 : 0;
+            } else {
+                c = ((x ^ y) & 1) ? 1 : 0;      // 50% desktop dither
+            }
+            if (x >= mx && x < mx + 16 && y >= my && y < my + 16 && x - mx <= y - my) {
+                c = 1;                          // Arrow pointer
+            }
+            s_index[y * width + x] = c;
+        }
+    }
+}
+
+static void seq_scroll(int frame, int width, int height)
+{
+    bench_grey_palette();
+    for (int y = 0; y < height; y++) {
+        int sy = y + frame;
+        for (int x = 0; x < width; x++) {
+            uint32_t ch = (uint32_t)((sy / 8) * (width / 8) + x / 8);
+            s_index[y * width + x] = bench_glyph(ch, x % 8, sy % 8);
+        }
+    }
+}
+
+static void seq_demo(int frame, int width, int height)
+{
+    int sx = 40 + (frame * 2) % (width - 140);
+    int sy = 40 + frame % (height - 110);
+
+    bench_grey_palette();
+    for (int y = 0; y < height; y++) {
+        // Colour 0 cycles through a moving bar; the rest of the palette stays
+        memcpy(&s_palette[y * 16], s_palette, 16 * sizeof(uint16_t));
+        int bar = (y + frame * 3) % 64;
+        s_palette[y * 16] = bar < 16 ? (uint16_t)((bar * 2) << 11) : 0;
+        for (int x = 0; x < width; x++) {
+            uint8_t c = (uint8_t)(((x / 16) + (y / 16)) & 1 ? 2 : 0);
+            if (x >= sx && x < sx + 96 && y >= sy && y < sy + 64) {
+                c = (uint8_t)(((x - sx) ^ (y - sy) ^ frame) & 15);
+            }
+            s_index[y * width + x] = c;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Round trip
+// ---------------------------------------------------------------------------
+
+static void bench_expect(const delta_frame_t *f)
+{
+    uint32_t colours = 1u << f->bpp;
+
+    for (int y = 0; y < f->height; y++) {
+        const uint16_t *pal = f->palette + (f->palette_per_row ? (size_t)y * colours : 0);
+        for (int x = 0; x < f->width; x++) {
+            s_expect[y * f->width + x] = pal[f->index[y * f->width + x] & (colours - 1)];
+        }
+    }
+}
+
+/**
+ * @brief Encode and decode @p frames frames
+ *
+ * @param next Produces frame i in s_index / s_palette, false at the end
+ * @return false if a decoded frame differs from its source
+ */
+static bool bench_run(const char *name, const delta_frame_t *proto,
+                      bool (*next)(const bench_seq_t *, int), const bench_seq_t *seq,
+                      int frames)
+{
+    delta_encoder_t enc;
+    delta_decoder_t dec;
+    uint32_t cap = delta_max_packet_size(proto->width, proto->height, proto->bpp);
+    uint8_t *pkt = malloc(cap);
+    double t_enc = 0.0, t_dec = 0.0;
+    uint64_t bytes = 0, key_bytes = 0, max_bytes = 0;
+    int n = 0;
+
+    if (!pkt || delta_encoder_init(&enc) != ESP_OK || delta_decoder_init(&dec) != ESP_OK) {
+        fprintf(stderr, "delta_bench: out of memory\n");
+        exit(1);
+    }
+
+    for (; n < frames && next(seq, n); n++) {
+        delta_frame_t f = *proto;
+        uint32_t len;
+        f.timestamp = (uint32_t)(n * 1000 / BENCH_FPS);
+
+        double t0 = bench_now();
+        esp_err_t err = delta_encode(&enc, &f, pkt, cap, &len);
+        double t1 = bench_now();
+        if (err == ESP_OK) {
+            err = delta_decode(&dec, pkt, len);
+        }
+        double t2 = bench_now();
+        if (err != ESP_OK) {
+            fprintf(stderr, "delta_bench: %s frame %d: error 0x%x\n", name, n, (unsigned)err);
+            return false;
+        }
+        t_enc += t1 - t0;
+        t_dec += t2 - t1;
+
+        delta_decoder_render(&dec, s_out);
+        bench_expect(&f);
+        if (memcmp(s_out, s_expect, (size_t)f.width * f.height * sizeof(uint16_t)) != 0) {
+            fprintf(stderr, "delta_bench: %s frame %d differs after decoding\n", name, n);
+            return false;
+        }
+        if (n == 0) {
+            key_bytes = len;
+        } else {
+            bytes += len;
+            max_bytes = len > max_bytes ? len : max_bytes;
+        }
+    }
+
+    double avg = n > 1 ? (double)bytes / (n - 1) : (double)key_bytes;
+    printf("  %-10s %3dx%3dx%d %6d %9llu %9.0f %9llu %7.1fx %8.3f %8.1f %8.1f\n",
+           name, proto->width, proto->height, proto->bpp, n,
+           (unsigned long long)key_bytes, avg, (unsigned long long)max_bytes,
+           BENCH_RAW_BYTES / avg, avg * BENCH_FPS / 1e6,
+           t_enc / n * 1e6, t_dec / n * 1e6);
+
+    delta_encoder_free(&enc);
+    delta_decoder_free(&dec);
+    free(pkt);
+    return true;
+}
+
+static bool next_generated(const bench_seq_t *seq, int frame)
+{
+    seq->render(frame, seq->width, seq->height);
+    return true;
+}
+
+static FILE *s_file;
+
+static bool next_recorded(const bench_seq_t *seq, int frame)
+{
+    size_t size = (size_t)seq->width * seq->height;
+    return fread(s_index, 1, size, s_file) == size;
+}
+
+static void bench_header(void)
+{
+    printf("  %-10s %-9s %6s %9s %9s %9s %8s %8s %8s %8s\n", "sequence", "mode", "frames",
+           "key B", "avg B", "max B", "vs raw", "MB/s", "enc us", "dec us");
+}
+
+int main(int argc, char **argv)
+{
+    static const bench_seq_t seqs[] = {
+        { "gem_low",  320, 200, 4, false, seq_gem },
+        { "gem_high", 640, 400, 1, false, seq_gem },
+        { "scroll",   640, 400, 1, false, seq_scroll },
+        { "demo",     320, 200, 4, true,  seq_demo },
+    };
+    bool ok = true;
+
+    printf("delta_bench: round trip, raw frame %d bytes, MB/s at %d fps\n",
+           BENCH_RAW_BYTES, BENCH_FPS);
+    bench_header();
+
+    if (argc == 5) {
+        bench_seq_t rec = {
+            .name = "recorded",
+            .width = (uint16_t)atoi(argv[2]),
+            .height = (uint16_t)atoi(argv[3]),
+            .bpp = (uint8_t)atoi(argv[4]),
+        };
+        delta_frame_t f = {
+            .width = rec.width, .height = rec.height, .bpp = rec.bpp,
+            .index = s_index, .palette = s_palette,
+        };
+        if (rec.width > DELTA_MAX_WIDTH || rec.height > DELTA_MAX_HEIGHT) {
+            fprintf(stderr, "delta_bench: frame too large\n");
+            return 1;
+        }
+        s_file = fopen(argv[1], "rb");
+        if (!s_file) {
+            perror(argv[1]);
+            return 1;
+        }
+        bench_grey_palette();
+        ok = bench_run(rec.name, &f, next_recorded, &rec, 1 << 30);
+        fclose(s_file);
+        return ok ? 0 : 1;
+    }
+
+    int frames = argc > 1 ? atoi(argv[1]) : BENCH_FRAMES;
+    for (size_t i = 0; i < sizeof(seqs) / sizeof(seqs[0]); i++) {
+        delta_frame_t f = {
+            .width = seqs[i].width, .height = seqs[i].height, .bpp = seqs[i].bpp,
+            .index = s_index, .palette = s_palette, .palette_per_row = seqs[i].per_row,
+        };
+        ok &= bench_run(seqs[i].name, &f, next_generated, &seqs[i], frames);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file esptari_av_sync.h
+ * @brief Audio clock recovery against the browser's playback clock
+ *
+ * The emulated machine is the master clock: audio and video timestamps
+ * are derived from CPU cycle counts, so a frame and the sound of the same
+ * VBL carry the same time whatever the emulation speed. The browser plays
+ * the audio on its own crystal, which never runs at exactly the rate the
+ * ESP32 produces samples, and every emulator stall or catch-up moves the
+ * two further apart. IMPLEMENTATION_PLAN.md 3.6 fixed that by jumping the
+ * read position on more than 5 ms of drift, which clicks.
+ *
+ * Instead the browser reports how many samples it has played
+ * (stream_sync_packet_t, about every 100 ms). Samples sent minus samples
+ * played is the audio in flight and queued, the end-to-end latency. A PI
+ * loop steers it to target_latency_us by resampling the YM/DMA mix with
+ * a ratio trimmed by at most max_correction_ppm (0.5% by default, a pitch
+ * change well below what is audible). The resampler is a 4-point Hermite
+ * interpolator with a 32.32 fixed-point phase, so the trimming is
+ * continuous: no sample is ever dropped or repeated.
+ *
+ * Pure bookkeeping without locks or clocks: the caller passes timestamps
+ * and serialises the calls.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esptari_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AV_SYNC_TARGET_LATENCY_US   20000   ///< Default, under the plan's 30 ms budget
+#define AV_SYNC_MAX_LATENCY_US      30000
+#define AV_SYNC_MAX_CORRECTION_PPM  5000
+
+/**
+ * @brief Playback position report, browser to ESP32
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // STREAM_MSG_SYNC
+    uint32_t played;        // Sample frames played since the stream started, wrapping
+    uint32_t timestamp;     // Browser clock, milliseconds, informational
+} stream_sync_packet_t;
+
+typedef struct {
+    uint32_t clock_hz;              ///< Emulated CPU clock, the master clock
+    uint32_t in_rate;               ///< Rate of the mix, in emulated time
+    uint32_t out_rate;              ///< Rate the browser plays at
+    uint8_t  channels;              ///< 1 or 2, interleaved int16
+    uint32_t target_latency_us;     ///< 0: AV_SYNC_TARGET_LATENCY_US
+    uint32_t max_correction_ppm;    ///< 0: AV_SYNC_MAX_CORRECTION_PPM
+} av_sync_config_t;
+
+typedef struct {
+    uint32_t reports;
+    uint32_t underruns;             ///< Reports with nothing left in flight
+    uint32_t over_max;              ///< Reports above AV_SYNC_MAX_LATENCY_US
+    uint32_t clamped;               ///< Reports that wanted more than max_correction_ppm
+    uint32_t discontinuities;       ///< Mix chunks not following on from the last one
+    int32_t  latency_us;            ///< Smoothed sent minus played
+    int32_t  min_latency_us;        ///< Since the loop settled, see av_sync_reset_stats()
+    int32_t  max_latency_us;
+    int32_t  correction_ppm;        ///< Positive: input consumed faster than nominal
+} av_sync_stats_t;
+
+/**
+ * @brief Clock recovery state (IMPLEMENTATION_PLAN.md 3.6)
+ */
+typedef struct {
+    int64_t video_pts;              ///< Emulated time of the last frame, us
+    int64_t audio_pts;              ///< Emulated time of the next mix sample, us
+    int64_t frame_duration_us;      ///< Between the last two frames: 20000 at 50 Hz, 16667 at 60 Hz
+
+    av_sync_config_t config;
+    uint64_t nominal_step;          ///< Input frames per output frame, 32.32
+    uint64_t step;                  ///< nominal_step with the correction applied
+    uint64_t phase;                 ///< Output position past hist[1], 32.32
+    int16_t  hist[4][2];            ///< Last four input frames
+    bool     primed;                ///< A chunk has been processed
+    float    integral_ppm;
+    uint64_t in_frames;
+    uint64_t sent;                  ///< Output frames produced
+    uint64_t played;                ///< Last reported, unwrapped
+    uint32_t latency_reports;       ///< Reports smoothed into stats.latency_us, kept by av_sync_reset_stats()
+    av_sync_stats_t stats;
+} av_sync_t;
+
+esp_err_t av_sync_init(av_sync_t *sync, const av_sync_config_t *config);
+
+/**
+ * @brief Emulated time of a cycle count
+ */
+int64_t av_sync_cycles_to_us(const av_sync_t *sync, uint64_t cycles);
+
+/**
+ * @brief Stamp a frame at its VBL
+ *
+ * @return Its presentation time, on the same clock as the audio timestamps
+ */
+int64_t av_sync_video_frame(av_sync_t *sync, uint64_t cycles);
+
+/**
+ * @brief Largest output of av_sync_process() for @p in_frames
+ */
+uint32_t av_sync_max_out(const av_sync_t *sync, uint32_t in_frames);
+
+/**
+ * @brief Resample one chunk of the mix for sending
+ *
+ * Everything produced counts as sent.
+ *
+ * @param cycles Master clock at the first sample of @p in
+ * @param out Room for av_sync_max_out(@p in_frames) frames
+ * @param pts_us Set to the emulated time of the first output frame
+ *
+ * @return Output frames, 0 if @p out_cap is below av_sync_max_out()
+ */
+uint32_t av_sync_process(av_sync_t *sync, uint64_t cycles, const int16_t *in, uint32_t in_frames,
+                         int16_t *out, uint32_t out_cap, int64_t *pts_us);
+
+/**
+ * @brief Feed a playback position report and retrim the ratio
+ *
+ * @param played Sample frames played, as sent by the browser (wrapping)
+ */
+void av_sync_report(av_sync_t *sync, uint32_t played);
+
+/**
+ * @brief av_sync_report() from a received stream_sync_packet_t
+ *
+ * @return ESP_ERR_INVALID_ARG if it is not one
+ */
+esp_err_t av_sync_report_packet(av_sync_t *sync, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Plan 3.6's drift: audio_pts - video_pts, for monitoring only
+ */
+int64_t av_sync_drift_us(const av_sync_t *sync);
+
+void av_sync_get_stats(const av_sync_t *sync, av_sync_stats_t *stats);
+
+/**
+ * @brief Restart the counters and the latency range, the loop keeps its state
+ */
+void av_sync_reset_stats(av_sync_t *sync);
+
+#ifdef __cplusplus
+}
+#endif
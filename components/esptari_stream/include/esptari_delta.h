@@ -0,0 +1,171 @@
+/**
+ * @file esptari_delta.h
+ * @brief Delta-frame video codec for the WebSocket stream
+ *
+ * Instead of RGB565 frames, the stream carries the emulated screen as
+ * colour indices packed at the mode's depth (1, 2, 4 or 8 bpp) plus the
+ * palettes that map them, and each packet holds only what changed since
+ * the previous one:
+ *
+ * - the frame is cut into DELTA_TILE_W x DELTA_TILE_H pixel tiles; a tile
+ *   is sent when any of its packed bytes differ from what the client has,
+ *   PackBits-compressed when that is smaller
+ * - palettes are sent as blocks, each applying from a given row down,
+ *   which covers per-line raster colours; the blocks are only resent when
+ *   they change
+ *
+ * A keyframe carries every tile and the palettes and does not depend on
+ * earlier packets. Every other packet names the frame it applies on top
+ * of (base_frame); a decoder that has not seen that frame rejects it with
+ * ESP_ERR_INVALID_STATE and the server asks the encoder for a keyframe
+ * (delta_encoder_request_key()), as it does when a client joins.
+ *
+ * Packet layout, little-endian:
+ *
+ *     delta_packet_header_t
+ *     palette_count x { uint16_t row; uint16_t rgb565[1 << bpp]; }
+ *     tile_count    x { delta_tile_header_t; uint8_t data[length]; }
+ *
+ * Tile data is DELTA_TILE_H rows of DELTA_TILE_W * bpp / 8 bytes, leftmost
+ * pixel in the most significant bits, before compression. Tiles are in
+ * ascending index order, row-major over the frame.
+ *
+ * Palette changes within a line are not representable; producers send the
+ * palette in effect at the start of each line. Per-row palettes are
+ * limited to 4 bpp, which covers every ST mode.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esptari_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DELTA_TILE_W        32
+#define DELTA_TILE_H        8
+#define DELTA_MAX_WIDTH     640
+#define DELTA_MAX_HEIGHT    400
+
+/** Palette blocks of one packet at most: a 16-colour palette per row */
+#define DELTA_PAL_MAX       (DELTA_MAX_HEIGHT * (2 + 2 * 16))
+
+#define DELTA_FLAG_KEY      0x01    ///< Self-contained, base_frame is ignored
+
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // STREAM_MSG_VIDEO_DELTA
+    uint8_t  flags;         // DELTA_FLAG_*
+    uint8_t  bpp;           // 1, 2, 4 or 8
+    uint8_t  reserved;
+    uint32_t timestamp;     // Milliseconds
+    uint32_t frame_number;
+    uint32_t base_frame;    // Frame the client must hold to apply this one
+    uint16_t width;
+    uint16_t height;
+    uint16_t palette_count; // 0: palettes unchanged
+    uint16_t tile_count;
+} delta_packet_header_t;
+
+typedef enum {
+    DELTA_TILE_RAW = 0,
+    DELTA_TILE_RLE = 1,     ///< PackBits
+} delta_tile_encoding_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t index;         // Row-major tile number
+    uint8_t  encoding;      // delta_tile_encoding_t
+    uint16_t length;        // Bytes of data that follow
+} delta_tile_header_t;
+
+/**
+ * @brief One emulated frame, as the encoder takes it
+ */
+typedef struct {
+    uint16_t width;             // Pixels, multiple of DELTA_TILE_W
+    uint16_t height;            // Multiple of DELTA_TILE_H
+    uint8_t  bpp;               // 1, 2, 4 or 8
+    const uint8_t  *index;      // width * height colour indices
+    const uint16_t *palette;    // RGB565, 1 << bpp entries per palette
+    bool     palette_per_row;   // palette holds one palette per row (bpp <= 4)
+    const uint32_t *dirty;      // Rows that may differ from the last frame, NULL for all
+    uint32_t timestamp;         // Milliseconds
+} delta_frame_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t keyframes;
+    uint64_t tiles_sent;
+    uint64_t tiles_rle;
+    uint64_t bytes_out;
+} delta_stats_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t  bpp;
+    bool     key_pending;
+    uint32_t frame_number;
+    uint8_t *ref;               // Packed frame as the client holds it
+    uint8_t *band;              // One packed band of DELTA_TILE_H rows
+    uint8_t *pal;               // Palette blocks the client holds
+    uint32_t pal_len;
+    delta_stats_t stats;
+} delta_encoder_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t  bpp;
+    bool     valid;             // A keyframe has been applied
+    uint32_t frame_number;
+    uint8_t *frame;             // Packed frame
+    uint8_t *pal;               // Palette blocks, as received
+    uint32_t pal_len;
+} delta_decoder_t;
+
+/**
+ * @brief Upper bound of a packet for a mode, for sizing the output buffer
+ */
+uint32_t delta_max_packet_size(uint16_t width, uint16_t height, uint8_t bpp);
+
+esp_err_t delta_encoder_init(delta_encoder_t *enc);
+void delta_encoder_free(delta_encoder_t *enc);
+
+/** Make the next packet a keyframe (client joined or lost a packet) */
+void delta_encoder_request_key(delta_encoder_t *enc);
+
+/**
+ * @brief Encode a frame against the previous one
+ *
+ * A mode change forces a keyframe. Unchanged frames still produce a
+ * header-only packet, which keeps frame numbers contiguous.
+ *
+ * @param out_len Set to the packet length
+ * @return ESP_ERR_INVALID_ARG for an unsupported mode,
+ *         ESP_ERR_INVALID_SIZE if @p cap is smaller than
+ *         delta_max_packet_size() and the packet does not fit
+ */
+esp_err_t delta_encode(delta_encoder_t *enc, const delta_frame_t *frame,
+                       uint8_t *out, uint32_t cap, uint32_t *out_len);
+
+esp_err_t delta_decoder_init(delta_decoder_t *dec);
+void delta_decoder_free(delta_decoder_t *dec);
+
+/**
+ * @brief Apply a packet
+ *
+ * @return ESP_ERR_INVALID_STATE if it builds on a frame this decoder does
+ *         not hold (request a keyframe), ESP_ERR_INVALID_SIZE if malformed
+ */
+esp_err_t delta_decode(delta_decoder_t *dec, const uint8_t *pkt, uint32_t len);
+
+/** Expand the decoded frame to width * height RGB565 pixels */
+void delta_decoder_render(const delta_decoder_t *dec, uint16_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,135 @@
+/**
+ * @file esptari_stream.h
+ * @brief Binary WebSocket message formats for /ws/stream
+ *
+ * Every message starts with a one-byte type (IMPLEMENTATION_PLAN.md, 3.4).
+ * Multi-byte fields are little-endian, which is what both the ESP32 and
+ * the browser's DataView default to on the hosts we target.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    STREAM_MSG_VIDEO_RAW     = 0x01,    ///< raw_frame_packet_t
+    STREAM_MSG_AUDIO         = 0x02,
+    STREAM_MSG_VIDEO_DELTA   = 0x03,    ///< delta_packet_header_t, see esptari_delta.h
+    STREAM_MSG_VIDEO_INDEXED = 0x04,    ///< indexed_frame_packet_t
+    STREAM_MSG_VIDEO_JPEG    = 0x05,    ///< Plan 3.4 header without format, then a JPEG (camera example)
+    STREAM_MSG_SYNC          = 0x06,    ///< stream_sync_packet_t, browser to ESP32, see esptari_av_sync.h
+    STREAM_MSG_AUDIO_CODED   = 0x07,    ///< ADPCM or Opus frames (camera example, ws_audio_codec.h)
+} stream_msg_type_t;
+
+/**
+ * @brief Video encodings a /ws/stream or /stream client can ask for
+ */
+typedef enum {
+    STREAM_VIDEO_MJPEG = 0,         ///< Fallback, works with a plain <img>
+    STREAM_VIDEO_RAW,
+    STREAM_VIDEO_DELTA,
+    STREAM_VIDEO_INDEXED,
+} stream_video_mode_t;
+
+typedef enum {
+    STREAM_FORMAT_RGB565 = 0,
+    STREAM_FORMAT_RGB888 = 1,
+} stream_format_t;
+
+/**
+ * @brief Full frame (IMPLEMENTATION_PLAN.md, 3.2 option B)
+ *
+ * 640x400 RGB565 is 512 KB, 25.6 MB/s at 50 fps.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // STREAM_MSG_VIDEO_RAW
+    uint32_t timestamp;     // Milliseconds
+    uint32_t frame_number;
+    uint16_t width;
+    uint16_t height;
+    uint8_t  format;        // stream_format_t
+    uint8_t  data[];        // Pixel data
+} raw_frame_packet_t;
+
+typedef enum {
+    STREAM_PIXELS_PLANAR = 0,       ///< Screen memory: bpp interleaved plane words per 16 pixels
+    STREAM_PIXELS_CHUNKY = 1,       ///< Packed indices, leftmost pixel in the high bits
+} stream_pixel_layout_t;
+
+/**
+ * @brief Native screen: colour indices at the emulated resolution
+ *
+ * The browser maps indices through the palettes and scales, so the ESP32
+ * neither converts to RGB565 nor doubles lines: an ST low-res frame is
+ * 32000 bytes plus palettes against 512000 for a 640x400 raw frame.
+ *
+ *     indexed_frame_packet_t
+ *     palette_count x { uint16_t row; uint16_t rgb565[1 << bpp]; }
+ *     height x (width * bpp / 8) bytes of pixels
+ *
+ * Each palette block applies from its row down; the first is for row 0.
+ * Planar words are little-endian like every other field.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // STREAM_MSG_VIDEO_INDEXED
+    uint32_t timestamp;     // Milliseconds
+    uint32_t frame_number;
+    uint16_t width;
+    uint16_t height;
+    uint8_t  bpp;           // 1, 2, 4 or 8
+    uint8_t  layout;        // stream_pixel_layout_t
+    uint16_t palette_count;
+} indexed_frame_packet_t;
+
+/**
+ * @brief Frame to send as an indexed_frame_packet_t
+ */
+typedef struct {
+    uint16_t width;             // Multiple of 16
+    uint16_t height;
+    uint8_t  bpp;               // 1, 2, 4 or 8
+    uint8_t  layout;            // stream_pixel_layout_t
+    const uint16_t *planar;     // STREAM_PIXELS_PLANAR: screen words, host order
+    const uint8_t  *index;      // STREAM_PIXELS_CHUNKY: width * height indices
+    const uint16_t *palette;    // RGB565, 1 << bpp entries per palette
+    bool     palette_per_row;   // One palette per row (bpp <= 4), e.g.
+                                // video_interface_t::get_line_palettes()
+    uint32_t palette_stride;    // Entries between row palettes, 0 for 1 << bpp
+    uint32_t timestamp;
+    uint32_t frame_number;
+} stream_indexed_frame_t;
+
+/** Parse a client's format choice ("mjpeg", "raw", "delta", "indexed"); MJPEG otherwise */
+stream_video_mode_t stream_video_mode_parse(const char *name);
+
+/**
+ * @brief Palette blocks as used by delta and indexed packets
+ *
+ * Consecutive rows with equal palettes share a block.
+ *
+ * @param stride Entries between row palettes when @p per_row
+ * @return Bytes written, or 0 if over @p cap
+ */
+uint32_t stream_write_palettes(const uint16_t *palette, bool per_row, uint32_t stride,
+                               uint16_t height, uint8_t bpp,
+                               uint8_t *dst, uint32_t cap, uint16_t *count);
+
+/** Upper bound of an indexed packet */
+uint32_t stream_indexed_max_size(uint16_t width, uint16_t height, uint8_t bpp);
+
+/**
+ * @return ESP_ERR_INVALID_ARG for an unsupported frame,
+ *         ESP_ERR_INVALID_SIZE if it does not fit in @p cap
+ */
+esp_err_t stream_build_indexed(const stream_indexed_frame_t *frame, uint8_t *out,
+                               uint32_t cap, uint32_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
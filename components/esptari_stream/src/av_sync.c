@@ -0,0 +1,256 @@
+/**
+ * @file av_sync.c
+ * @brief Audio clock recovery against the browser's playback clock
+ */
+
+#include <string.h>
+#include "esptari_av_sync.h"
+
+#define AV_SYNC_ONE         (1ull << 32)
+
+/*
+ * Loop gains, per millisecond of latency error. The latency moves by
+ * (skew - correction) / 1000 ms per second, which makes the loop a second
+ * order system with a natural frequency of sqrt(KI / 1000) = 0.2 rad/s
+ * and a damping of KP / (2000 * 0.2) = 0.8: a step settles in about 25 s,
+ * slow enough that the pitch glides instead of wobbling. The latency of
+ * a single report saws by a whole mix chunk, hence the heavy smoothing.
+ */
+#define AV_SYNC_KP          320.0f  // ppm per ms
+#define AV_SYNC_KI          40.0f   // ppm per ms per second
+#define AV_SYNC_SLEW_PPM_S  2000.0f // Fastest change of the correction
+
+static uint64_t av_sync_step(const av_sync_t *sync, int32_t ppm)
+{
+    return sync->nominal_step + (uint64_t)((int64_t)(sync->nominal_step >> 8) * ppm / 1000000 * 256);
+}
+
+esp_err_t av_sync_init(av_sync_t *sync, const av_sync_config_t *config)
+{
+    if (!sync || !config || !config->clock_hz || !config->in_rate || !config->out_rate ||
+            !config->channels || config->channels > 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(sync, 0, sizeof(*sync));
+    sync->config = *config;
+    if (!sync->config.target_latency_us) {
+        sync->config.target_latency_us = AV_SYNC_TARGET_LATENCY_US;
+    }
+    if (!sync->config.max_correction_ppm) {
+        sync->config.max_correction_ppm = AV_SYNC_MAX_CORRECTION_PPM;
+    }
+    sync->nominal_step = ((uint64_t)config->in_rate << 32) / config->out_rate;
+    sync->step = sync->nominal_step;
+    av_sync_reset_stats(sync);
+
+    return ESP_OK;
+}
+
+int64_t av_sync_cycles_to_us(const av_sync_t *sync, uint64_t cycles)
+{
+    /* Split so that a day of cycles at 32 MHz does not overflow */
+    uint64_t hz = sync->config.clock_hz;
+
+    return (int64_t)(cycles / hz * 1000000 + cycles % hz * 1000000 / hz);
+}
+
+int64_t av_sync_video_frame(av_sync_t *sync, uint64_t cycles)
+{
+    int64_t pts = av_sync_cycles_to_us(sync, cycles);
+
+    if (sync->video_pts && pts > sync->video_pts) {
+        sync->frame_duration_us = pts - sync->video_pts;
+    }
+    sync->video_pts = pts;
+
+    return pts;
+}
+
+uint32_t av_sync_max_out(const av_sync_t *sync, uint32_t in_frames)
+{
+    /* Slowest step: nominal less the largest correction, plus the phase carried over */
+    uint64_t min_step = av_sync_step(sync, -(int32_t)sync->config.max_correction_ppm);
+
+    return (uint32_t)(((uint64_t)in_frames << 32) / min_step) + 2;
+}
+
+/**
+ * @brief 4-point, 3rd-order Hermite between p[1] and p[2], t in [0, 1) as Q16
+ */
+static inline int16_t av_sync_hermite(int32_t p0, int32_t p1, int32_t p2, int32_t p3, int32_t t)
+{
+    /* Coefficients times two, so that the halves stay integers */
+    int64_t c1 = p2 - p0;
+    int64_t c2 = 2 * p0 - 5 * p1 + 4 * p2 - p3;
+    int64_t c3 = (p3 - p0) + 3 * (p1 - p2);
+    int64_t v = ((((c3 * t) >> 16) + c2) * t >> 16);
+
+    v = (((v + c1) * t) >> 16) + 2 * (int64_t)p1;
+    v >>= 1;
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+uint32_t av_sync_process(av_sync_t *sync, uint64_t cycles, const int16_t *in, uint32_t in_frames,
+                         int16_t *out, uint32_t out_cap, int64_t *pts_us)
+{
+    uint8_t channels = sync->config.channels;
+    int64_t chunk_pts = av_sync_cycles_to_us(sync, cycles);
+    int64_t frame_us = 1000000 / sync->config.in_rate + 1;
+    uint32_t produced = 0;
+
+    if (!in_frames || out_cap < av_sync_max_out(sync, in_frames)) {
+        return 0;
+    }
+
+    /* The cycle count is the time base; a chunk that does not follow on is a reset or a pause */
+    if (sync->primed && (chunk_pts - sync->audio_pts > frame_us || sync->audio_pts - chunk_pts > frame_us)) {
+        sync->stats.discontinuities++;
+        sync->primed = false;
+    }
+    if (!sync->primed) {
+        for (int i = 0; i < 4; i++) {
+            for (int c = 0; c < channels; c++) {
+                sync->hist[i][c] = in[c];
+            }
+        }
+        sync->phase = 0;
+        sync->primed = true;
+    }
+
+    /* The first output sits between hist[1] and hist[2], two input frames before in[0] */
+    *pts_us = chunk_pts + (int64_t)((sync->phase >> 16) * 1000000 >> 16) / sync->config.in_rate
+              - 2 * 1000000 / (int64_t)sync->config.in_rate;
+
+    for (uint32_t i = 0; i < in_frames; i++) {
+        memmove(sync->hist[0], sync->hist[1], sizeof(sync->hist[0]) * 3);
+        for (int c = 0; c < channels; c++) {
+            sync->hist[3][c] = in[i * channels + c];
+        }
+
+        while (sync->phase < AV_SYNC_ONE) {
+            int32_t t = (int32_t)(sync->phase >> 16);
+
+            for (int c = 0; c < channels; c++) {
+                out[produced * channels + c] = av_sync_hermite(sync->hist[0][c], sync->hist[1][c],
+                                                               sync->hist[2][c], sync->hist[3][c], t);
+            }
+            produced++;
+            sync->phase += sync->step;
+        }
+        sync->phase -= AV_SYNC_ONE;
+    }
+
+    sync->in_frames += in_frames;
+    sync->sent += produced;
+    sync->audio_pts = chunk_pts + (int64_t)in_frames * 1000000 / sync->config.in_rate;
+
+    return produced;
+}
+
+void av_sync_report(av_sync_t *sync, uint32_t played)
+{
+    const av_sync_config_t *config = &sync->config;
+    int32_t delta = (int32_t)(played - (uint32_t)sync->played);
+
+    /* A report overtaken by a newer one tells nothing new */
+    if (delta < 0) {
+        return;
+    }
+    sync->played += (uint32_t)delta;
+    sync->stats.reports++;
+
+    int64_t in_flight = (int64_t)(sync->sent - sync->played);
+    if (in_flight <= 0) {
+        sync->stats.underruns++;
+        in_flight = 0;
+    }
+    int32_t latency_us = (int32_t)(in_flight * 1000000 / config->out_rate);
+
+    /* Seeded from the first report ever, not the first since the stats were reset */
+    if (sync->latency_reports++ == 0) {
+        sync->stats.latency_us = latency_us;
+    } else {
+        sync->stats.latency_us += (latency_us - sync->stats.latency_us) / 8;
+    }
+    if (latency_us > AV_SYNC_MAX_LATENCY_US) {
+        sync->stats.over_max++;
+    }
+    if (latency_us < sync->stats.min_latency_us) {
+        sync->stats.min_latency_us = latency_us;
+    }
+    if (latency_us > sync->stats.max_latency_us) {
+        sync->stats.max_latency_us = latency_us;
+    }
+
+    /* Time is measured in played samples, so the loop needs no clock of its own */
+    float dt_s = (float)delta / config->out_rate;
+    float err_ms = (float)(sync->stats.latency_us - (int32_t)config->target_latency_us) / 1000.0f;
+    float max_ppm = (float)config->max_correction_ppm;
+
+    sync->integral_ppm += AV_SYNC_KI * err_ms * dt_s;
+    if (sync->integral_ppm > max_ppm) {
+        sync->integral_ppm = max_ppm;
+    } else if (sync->integral_ppm < -max_ppm) {
+        sync->integral_ppm = -max_ppm;
+    }
+
+    float ppm = AV_SYNC_KP * err_ms + sync->integral_ppm;
+    if (ppm > max_ppm || ppm < -max_ppm) {
+        sync->stats.clamped++;
+        ppm = ppm > 0 ? max_ppm : -max_ppm;
+    }
+
+    float slew = AV_SYNC_SLEW_PPM_S * dt_s;
+    float prev = (float)sync->stats.correction_ppm;
+    if (ppm > prev + slew) {
+        ppm = prev + slew;
+    } else if (ppm < prev - slew) {
+        ppm = prev - slew;
+    }
+
+    sync->stats.correction_ppm = (int32_t)ppm;
+    sync->step = av_sync_step(sync, sync->stats.correction_ppm);
+}
+
+esp_err_t av_sync_report_packet(av_sync_t *sync, const uint8_t *data, uint32_t len)
+{
+    stream_sync_packet_t pkt;
+
+    if (!data || len != sizeof(pkt) || data[0] != STREAM_MSG_SYNC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(&pkt, data, sizeof(pkt));
+    av_sync_report(sync, pkt.played);
+
+    return ESP_OK;
+}
+
+int64_t av_sync_drift_us(const av_sync_t *sync)
+{
+    return sync->audio_pts - sync->video_pts;
+}
+
+void av_sync_get_stats(const av_sync_t *sync, av_sync_stats_t *stats)
+{
+    *stats = sync->stats;
+}
+
+void av_sync_reset_stats(av_sync_t *sync)
+{
+    av_sync_stats_t *stats = &sync->stats;
+
+    stats->reports = 0;
+    stats->underruns = 0;
+    stats->over_max = 0;
+    stats->clamped = 0;
+    stats->discontinuities = 0;
+    stats->min_latency_us = INT32_MAX;
+    stats->max_latency_us = 0;
+}
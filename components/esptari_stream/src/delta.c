@@ -0,0 +1,425 @@
+/**
+ * @file delta.c
+ * @brief Delta-frame video codec for the WebSocket stream
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esptari_delta.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#define DELTA_ALLOC(size)   heap_caps_calloc(1, (size), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define DELTA_FREE(ptr)     heap_caps_free(ptr)
+#else
+#define DELTA_ALLOC(size)   calloc(1, (size))
+#define DELTA_FREE(ptr)     free(ptr)
+#endif
+
+#define DELTA_FRAME_MAX     (DELTA_MAX_WIDTH * DELTA_MAX_HEIGHT)    // Packed bytes at 8 bpp
+#define DELTA_TILE_MAX      (DELTA_TILE_W * DELTA_TILE_H)           // Tile bytes at 8 bpp
+
+static bool delta_mode_valid(uint16_t width, uint16_t height, uint8_t bpp)
+{
+    return (bpp == 1 || bpp == 2 || bpp == 4 || bpp == 8) &&
+           width > 0 && width <= DELTA_MAX_WIDTH && width % DELTA_TILE_W == 0 &&
+           height > 0 && height <= DELTA_MAX_HEIGHT && height % DELTA_TILE_H == 0;
+}
+
+static uint32_t delta_pal_block_size(uint8_t bpp)
+{
+    return 2 + 2 * (1u << bpp);
+}
+
+uint32_t delta_max_packet_size(uint16_t width, uint16_t height, uint8_t bpp)
+{
+    uint32_t tiles = (uint32_t)(width / DELTA_TILE_W) * (height / DELTA_TILE_H);
+    uint32_t tile_bytes = DELTA_TILE_W * bpp / 8 * DELTA_TILE_H;
+    uint32_t palettes = bpp <= 4 ? height : 1;
+
+    return (uint32_t)sizeof(delta_packet_header_t) + palettes * delta_pal_block_size(bpp) +
+           tiles * ((uint32_t)sizeof(delta_tile_header_t) + tile_bytes);
+}
+
+// ---------------------------------------------------------------------------
+// PackBits
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Compress @p n bytes
+ *
+ * Control byte c < 128: c + 1 literal bytes follow; c >= 128: the next byte
+ * repeats c - 126 times (2 to 129).
+ *
+ * @return Compressed length, or 0 if it would exceed @p cap
+ */
+static uint32_t delta_rle_encode(const uint8_t *src, uint32_t n, uint8_t *dst, uint32_t cap)
+{
+    uint32_t i = 0, o = 0;
+
+    while (i < n) {
+        uint32_t run = 1;
+        while (i + run < n && run < 129 && src[i + run] == src[i]) {
+            run++;
+        }
+        if (run >= 2) {
+            if (o + 2 > cap) {
+                return 0;
+            }
+            dst[o++] = (uint8_t)(run + 126);
+            dst[o++] = src[i];
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of two or more
+        uint32_t lit = 1;
+        while (i + lit < n && lit < 128 &&
+               !(i + lit + 1 < n && src[i + lit] == src[i + lit + 1])) {
+            lit++;
+        }
+        if (o + 1 + lit > cap) {
+            return 0;
+        }
+        dst[o++] = (uint8_t)(lit - 1);
+        memcpy(dst + o, src + i, lit);
+        o += lit;
+        i += lit;
+    }
+    return o;
+}
+
+/** @return false unless @p src expands to exactly @p n bytes */
+static bool delta_rle_decode(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t n)
+{
+    uint32_t i = 0, o = 0;
+
+    while (i < len) {
+        uint8_t c = src[i++];
+        if (c < 128) {
+            uint32_t lit = (uint32_t)c + 1;
+            if (i + lit > len || o + lit > n) {
+                return false;
+            }
+            memcpy(dst + o, src + i, lit);
+            i += lit;
+            o += lit;
+        } else {
+            uint32_t run = (uint32_t)c - 126;
+            if (i >= len || o + run > n) {
+                return false;
+            }
+            memset(dst + o, src[i++], run);
+            o += run;
+        }
+    }
+    return o == n;
+}
+
+// ---------------------------------------------------------------------------
+// Encoder
+// ---------------------------------------------------------------------------
+
+esp_err_t delta_encoder_init(delta_encoder_t *enc)
+{
+    memset(enc, 0, sizeof(*enc));
+    enc->ref = DELTA_ALLOC(DELTA_FRAME_MAX);
+    enc->band = DELTA_ALLOC(DELTA_MAX_WIDTH * DELTA_TILE_H);
+    enc->pal = DELTA_ALLOC(DELTA_PAL_MAX);
+    if (!enc->ref || !enc->band || !enc->pal) {
+        delta_encoder_free(enc);
+        return ESP_ERR_NO_MEM;
+    }
+    enc->key_pending = true;
+    return ESP_OK;
+}
+
+void delta_encoder_free(delta_encoder_t *enc)
+{
+    DELTA_FREE(enc->ref);
+    DELTA_FREE(enc->band);
+    DELTA_FREE(enc->pal);
+    enc->ref = enc->band = enc->pal = NULL;
+}
+
+void delta_encoder_request_key(delta_encoder_t *enc)
+{
+    enc->key_pending = true;
+}
+
+static void delta_pack_row(const uint8_t *index, uint8_t *dst, int width, int bpp)
+{
+    uint8_t mask = (uint8_t)((1u << bpp) - 1);
+    int ppb = 8 / bpp;
+
+    for (int x = 0; x < width; x += ppb) {
+        uint8_t b = 0;
+        for (int j = 0; j < ppb; j++) {
+            b = (uint8_t)((b << bpp) | (index[x + j] & mask));
+        }
+        *dst++ = b;
+    }
+}
+
+static bool delta_band_dirty(const uint32_t *dirty, int row)
+{
+    for (int y = row; y < row + DELTA_TILE_H; y++) {
+        if ((dirty[y / 32] >> (y % 32)) & 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t delta_encode(delta_encoder_t *enc, const delta_frame_t *frame,
+                       uint8_t *out, uint32_t cap, uint32_t *out_len)
+{
+    delta_packet_header_t hdr = {
+        .type      = STREAM_MSG_VIDEO_DELTA,
+        .bpp       = frame->bpp,
+        .timestamp = frame->timestamp,
+        .width     = frame->width,
+        .height    = frame->height,
+    };
+    uint8_t tile[DELTA_TILE_MAX];
+    uint8_t rle[DELTA_TILE_MAX];
+
+    if (!delta_mode_valid(frame->width, frame->height, frame->bpp) ||
+        !frame->index || !frame->palette || (frame->palette_per_row && frame->bpp > 4)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (frame->width != enc->width || frame->height != enc->height || frame->bpp != enc->bpp) {
+        enc->width = frame->width;
+        enc->height = frame->height;
+        enc->bpp = frame->bpp;
+        enc->key_pending = true;
+    }
+    if (cap < sizeof(hdr)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    bool key = enc->key_pending;
+    // Until this packet is out, the client's state is unknown
+    enc->key_pending = true;
+
+    uint8_t *p = out + sizeof(hdr);
+    uint8_t *end = out + cap;
+
+    // Palettes: resent only when they differ from what the client has
+    uint16_t pal_count;
+    uint32_t pal_len = stream_write_palettes(frame->palette, frame->palette_per_row,
+                                             1u << frame->bpp, frame->height, frame->bpp,
+                                             p, (uint32_t)(end - p), &pal_count);
+    if (pal_len == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (key || pal_len != enc->pal_len || memcmp(p, enc->pal, pal_len) != 0) {
+        memcpy(enc->pal, p, pal_len);
+        enc->pal_len = pal_len;
+        hdr.palette_count = pal_count;
+        p += pal_len;
+    }
+
+    // Tiles, one band of DELTA_TILE_H rows at a time
+    int stride = frame->width * frame->bpp / 8;
+    int tile_row = DELTA_TILE_W * frame->bpp / 8;
+    int tiles_x = frame->width / DELTA_TILE_W;
+    uint32_t tile_bytes = (uint32_t)tile_row * DELTA_TILE_H;
+
+    for (int row = 0; row < frame->height; row += DELTA_TILE_H) {
+        if (!key && frame->dirty && !delta_band_dirty(frame->dirty, row)) {
+            continue;
+        }
+        for (int y = 0; y < DELTA_TILE_H; y++) {
+            delta_pack_row(frame->index + (size_t)(row + y) * frame->width,
+                           enc->band + y * stride, frame->width, frame->bpp);
+        }
+        uint8_t *ref = enc->ref + (size_t)row * stride;
+        for (int tx = 0; tx < tiles_x; tx++) {
+            int off = tx * tile_row;
+            bool changed = key;
+            for (int y = 0; y < DELTA_TILE_H && !changed; y++) {
+                changed = memcmp(enc->band + y * stride + off, ref + y * stride + off, tile_row) != 0;
+            }
+            if (!changed) {
+                continue;
+            }
+            for (int y = 0; y < DELTA_TILE_H; y++) {
+                memcpy(tile + y * tile_row, enc->band + y * stride + off, tile_row);
+                memcpy(ref + y * stride + off, tile + y * tile_row, tile_row);
+            }
+
+            delta_tile_header_t th = {
+                .index    = (uint16_t)((row / DELTA_TILE_H) * tiles_x + tx),
+                .encoding = DELTA_TILE_RAW,
+                .length   = (uint16_t)tile_bytes,
+            };
+            const uint8_t *data = tile;
+            uint32_t rle_len = delta_rle_encode(tile, tile_bytes, rle, tile_bytes - 1);
+            if (rle_len) {
+                th.encoding = DELTA_TILE_RLE;
+                th.length = (uint16_t)rle_len;
+                data = rle;
+                enc->stats.tiles_rle++;
+            }
+            if ((uint32_t)(end - p) < sizeof(th) + th.length) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(p, &th, sizeof(th));
+            memcpy(p + sizeof(th), data, th.length);
+            p += sizeof(th) + th.length;
+            hdr.tile_count++;
+            enc->stats.tiles_sent++;
+        }
+    }
+
+    hdr.flags = key ? DELTA_FLAG_KEY : 0;
+    hdr.base_frame = enc->frame_number;
+    hdr.frame_number = ++enc->frame_number;
+    memcpy(out, &hdr, sizeof(hdr));
+
+    enc->key_pending = false;
+    enc->stats.frames++;
+    enc->stats.keyframes += key;
+    enc->stats.bytes_out += (uint64_t)(p - out);
+    *out_len = (uint32_t)(p - out);
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Decoder
+// ---------------------------------------------------------------------------
+
+esp_err_t delta_decoder_init(delta_decoder_t *dec)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->frame = DELTA_ALLOC(DELTA_FRAME_MAX);
+    dec->pal = DELTA_ALLOC(DELTA_PAL_MAX);
+    if (!dec->frame || !dec->pal) {
+        delta_decoder_free(dec);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void delta_decoder_free(delta_decoder_t *dec)
+{
+    DELTA_FREE(dec->frame);
+    DELTA_FREE(dec->pal);
+    dec->frame = dec->pal = NULL;
+}
+
+static esp_err_t delta_decode_body(delta_decoder_t *dec, const delta_packet_header_t *hdr,
+                                   const uint8_t *p, const uint8_t *end)
+{
+    if (hdr->palette_count) {
+        uint32_t block = delta_pal_block_size(hdr->bpp);
+        uint32_t pal_len = hdr->palette_count * block;
+        uint16_t prev_row = 0;
+        if (pal_len > DELTA_PAL_MAX || pal_len > (uint32_t)(end - p)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        for (uint32_t i = 0; i < hdr->palette_count; i++) {
+            uint16_t row;
+            memcpy(&row, p + i * block, 2);
+            if ((i == 0 && row != 0) || (i > 0 && row <= prev_row) || row >= hdr->height) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            prev_row = row;
+        }
+        memcpy(dec->pal, p, pal_len);
+        dec->pal_len = pal_len;
+        p += pal_len;
+    } else if (hdr->flags & DELTA_FLAG_KEY) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    int stride = hdr->width * hdr->bpp / 8;
+    int tile_row = DELTA_TILE_W * hdr->bpp / 8;
+    int tiles_x = hdr->width / DELTA_TILE_W;
+    uint32_t tiles = (uint32_t)tiles_x * (hdr->height / DELTA_TILE_H);
+    uint32_t tile_bytes = (uint32_t)tile_row * DELTA_TILE_H;
+    uint8_t tile[DELTA_TILE_MAX];
+
+    for (uint32_t i = 0; i < hdr->tile_count; i++) {
+        delta_tile_header_t th;
+        if ((uint32_t)(end - p) < sizeof(th)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(&th, p, sizeof(th));
+        p += sizeof(th);
+        if (th.index >= tiles || th.length > (uint32_t)(end - p)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (th.encoding == DELTA_TILE_RAW) {
+            if (th.length != tile_bytes) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(tile, p, tile_bytes);
+        } else if (th.encoding != DELTA_TILE_RLE ||
+                   !delta_rle_decode(p, th.length, tile, tile_bytes)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        p += th.length;
+
+        uint8_t *dst = dec->frame + (size_t)(th.index / tiles_x) * DELTA_TILE_H * stride +
+                       (th.index % tiles_x) * tile_row;
+        for (int y = 0; y < DELTA_TILE_H; y++) {
+            memcpy(dst + y * stride, tile + y * tile_row, tile_row);
+        }
+    }
+    return p == end ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t delta_decode(delta_decoder_t *dec, const uint8_t *pkt, uint32_t len)
+{
+    delta_packet_header_t hdr;
+
+    if (len < sizeof(hdr)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&hdr, pkt, sizeof(hdr));
+    if (hdr.type != STREAM_MSG_VIDEO_DELTA || !delta_mode_valid(hdr.width, hdr.height, hdr.bpp)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (hdr.flags & DELTA_FLAG_KEY) {
+        dec->width = hdr.width;
+        dec->height = hdr.height;
+        dec->bpp = hdr.bpp;
+    } else if (!dec->valid || hdr.base_frame != dec->frame_number ||
+               hdr.width != dec->width || hdr.height != dec->height || hdr.bpp != dec->bpp) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = delta_decode_body(dec, &hdr, pkt + sizeof(hdr), pkt + len);
+    // A packet that failed half way may have been partly applied
+    dec->valid = err == ESP_OK;
+    dec->frame_number = hdr.frame_number;
+    return err;
+}
+
+void delta_decoder_render(const delta_decoder_t *dec, uint16_t *out)
+{
+    uint32_t block = delta_pal_block_size(dec->bpp);
+    uint32_t colours = 1u << dec->bpp;
+    uint8_t mask = (uint8_t)(colours - 1);
+    int stride = dec->width * dec->bpp / 8;
+    uint16_t pal[256] = {0};
+    uint32_t next = 0;      // Offset of the next palette block
+
+    for (int row = 0; row < dec->height; row++) {
+        if (next < dec->pal_len) {
+            uint16_t start;
+            memcpy(&start, dec->pal + next, 2);
+            if (start == row) {
+                memcpy(pal, dec->pal + next + 2, colours * 2);
+                next += block;
+            }
+        }
+        const uint8_t *src = dec->frame + (size_t)row * stride;
+        for (int x = 0; x < dec->width; x++) {
+            int bit = x * dec->bpp;
+            int shift = 8 - dec->bpp - bit % 8;
+            *out++ = pal[(src[bit / 8] >> shift) & mask];
+        }
+    }
+}
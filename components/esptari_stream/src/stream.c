@@ -0,0 +1,121 @@
+/**
+ * @file stream.c
+ * @brief Stream message helpers shared by the packet formats
+ */
+
+#include <string.h>
+#include "esptari_stream.h"
+
+stream_video_mode_t stream_video_mode_parse(const char *name)
+{
+    static const char *const names[] = {
+        [STREAM_VIDEO_MJPEG]   = "mjpeg",
+        [STREAM_VIDEO_RAW]     = "raw",
+        [STREAM_VIDEO_DELTA]   = "delta",
+        [STREAM_VIDEO_INDEXED] = "indexed",
+    };
+
+    for (size_t i = 0; name && i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return (stream_video_mode_t)i;
+        }
+    }
+    return STREAM_VIDEO_MJPEG;
+}
+
+uint32_t stream_write_palettes(const uint16_t *palette, bool per_row, uint32_t stride,
+                               uint16_t height, uint8_t bpp,
+                               uint8_t *dst, uint32_t cap, uint16_t *count)
+{
+    uint32_t colours = 1u << bpp;
+    uint32_t block = 2 + 2 * colours;
+    const uint16_t *prev = NULL;
+    uint32_t len = 0;
+    int rows = per_row ? height : 1;
+
+    *count = 0;
+    for (int row = 0; row < rows; row++) {
+        const uint16_t *pal = palette + (size_t)row * stride;
+        if (prev && memcmp(prev, pal, colours * 2) == 0) {
+            continue;
+        }
+        if (len + block > cap) {
+            return 0;
+        }
+        uint16_t r = (uint16_t)row;
+        memcpy(dst + len, &r, 2);
+        memcpy(dst + len + 2, pal, colours * 2);
+        len += block;
+        (*count)++;
+        prev = pal;
+    }
+    return len;
+}
+
+uint32_t stream_indexed_max_size(uint16_t width, uint16_t height, uint8_t bpp)
+{
+    uint32_t palettes = bpp <= 4 ? height : 1;
+
+    return (uint32_t)sizeof(indexed_frame_packet_t) + palettes * (2 + 2 * (1u << bpp)) +
+           (uint32_t)width * height * bpp / 8;
+}
+
+esp_err_t stream_build_indexed(const stream_indexed_frame_t *frame, uint8_t *out,
+                               uint32_t cap, uint32_t *out_len)
+{
+    uint8_t bpp = frame->bpp;
+    bool planar = frame->layout == STREAM_PIXELS_PLANAR;
+    indexed_frame_packet_t hdr = {
+        .type         = STREAM_MSG_VIDEO_INDEXED,
+        .timestamp    = frame->timestamp,
+        .frame_number = frame->frame_number,
+        .width        = frame->width,
+        .height       = frame->height,
+        .bpp          = bpp,
+        .layout       = frame->layout,
+    };
+
+    if ((bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8) || frame->width == 0 ||
+        frame->width % 16 != 0 || frame->height == 0 || !frame->palette ||
+        (frame->palette_per_row && bpp > 4) ||
+        (planar ? !frame->planar : frame->layout != STREAM_PIXELS_CHUNKY || !frame->index)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cap < sizeof(hdr)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t *p = out + sizeof(hdr);
+    uint32_t stride = frame->palette_stride ? frame->palette_stride : 1u << bpp;
+    uint16_t pal_count;
+    uint32_t pal_len = stream_write_palettes(frame->palette, frame->palette_per_row, stride,
+                                             frame->height, bpp, p, cap - sizeof(hdr),
+                                             &pal_count);
+    uint32_t pixels = (uint32_t)frame->width * frame->height * bpp / 8;
+    if (pal_len == 0 || cap - sizeof(hdr) - pal_len < pixels) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    hdr.palette_count = pal_count;
+    p += pal_len;
+
+    if (planar) {
+        // Screen words straight from video RAM; the targets are little-endian
+        memcpy(p, frame->planar, pixels);
+    } else {
+        uint8_t mask = (uint8_t)((1u << bpp) - 1);
+        int ppb = 8 / bpp;
+        const uint8_t *index = frame->index;
+        for (uint32_t i = 0; i < pixels; i++, index += ppb) {
+            uint8_t b = 0;
+            for (int j = 0; j < ppb; j++) {
+                b = (uint8_t)((b << bpp) | (index[j] & mask));
+            }
+            p[i] = b;
+        }
+    }
+    p += pixels;
+
+    memcpy(out, &hdr, sizeof(hdr));
+    *out_len = (uint32_t)(p - out);
+    return ESP_OK;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file test_av_sync.c
+ * @brief Clock recovery: resampler accuracy and the loop under clock skew
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include "unity.h"
+#include "esptari_av_sync.h"
+
+#define ST_CLOCK_HZ     8000000
+#define RATE            48000
+#define CHUNK           240             // 5 ms of mix per emulator slice
+#define CHUNK_CYCLES    (CHUNK * ST_CLOCK_HZ / RATE)
+
+static int16_t s_in[CHUNK * 2];
+static int16_t s_out[CHUNK * 2 * 2];
+
+static av_sync_config_t config(uint32_t in_rate, uint8_t channels)
+{
+    return (av_sync_config_t) {
+        .clock_hz = ST_CLOCK_HZ,
+        .in_rate = in_rate,
+        .out_rate = RATE,
+        .channels = channels,
+    };
+}
+
+TEST_CASE("av_sync passes the mix through at the nominal ratio", "[stream]")
+{
+    av_sync_t sync;
+    av_sync_config_t cfg = config(RATE, 2);
+    int64_t pts;
+
+    TEST_ASSERT_EQUAL(ESP_OK, av_sync_init(&sync, &cfg));
+
+    for (int chunk = 0; chunk < 4; chunk++) {
+        for (int i = 0; i < CHUNK * 2; i++) {
+            s_in[i] = (int16_t)(rand() - RAND_MAX / 2);
+        }
+        uint32_t n = av_sync_process(&sync, (uint64_t)chunk * CHUNK_CYCLES, s_in, CHUNK,
+                                     s_out, sizeof(s_out) / 4, &pts);
+
+        /* Integer steps land on the input samples: a plain two frame delay */
+        TEST_ASSERT_EQUAL(CHUNK, n);
+        TEST_ASSERT_EQUAL(chunk * 5000 - 41, pts);
+        for (int i = 2; i < CHUNK; i++) {
+            TEST_ASSERT_EQUAL(s_in[(i - 2) * 2], s_out[i * 2]);
+            TEST_ASSERT_EQUAL(s_in[(i - 2) * 2 + 1], s_out[i * 2 + 1]);
+        }
+    }
+    TEST_ASSERT_EQUAL(4 * CHUNK, sync.sent);
+    TEST_ASSERT_EQUAL(20000, sync.audio_pts);
+    TEST_ASSERT_EQUAL(0, sync.stats.discontinuities);
+
+    /* An emulator reset restarts the cycle count */
+    av_sync_process(&sync, 0, s_in, CHUNK, s_out, sizeof(s_out) / 4, &pts);
+    TEST_ASSERT_EQUAL(1, sync.stats.discontinuities);
+
+    /* A short output buffer is refused rather than overrun */
+    TEST_ASSERT_EQUAL(0, av_sync_process(&sync, CHUNK_CYCLES, s_in, CHUNK, s_out, CHUNK, &pts));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, av_sync_init(&sync, &(av_sync_config_t) { .clock_hz = 1 }));
+}
+
+TEST_CASE("av_sync converts between rates on the cycle clock", "[stream]")
+{
+    av_sync_t sync;
+    av_sync_config_t cfg = config(50066, 1);
+    uint64_t cycles = 0;
+    int64_t pts;
+
+    TEST_ASSERT_EQUAL(ESP_OK, av_sync_init(&sync, &cfg));
+    memset(s_in, 0, sizeof(s_in));
+    for (int chunk = 0; chunk < 1000; chunk++) {
+        av_sync_process(&sync, cycles, s_in, CHUNK, s_out, sizeof(s_out) / 2, &pts);
+        cycles += (uint64_t)CHUNK * ST_CLOCK_HZ / 50066;
+    }
+    TEST_ASSERT_UINT32_WITHIN(2, 1000ull * CHUNK * RATE / 50066, sync.sent);
+    TEST_ASSERT_EQUAL(0, sync.stats.discontinuities);
+
+    TEST_ASSERT_EQUAL(20000, av_sync_video_frame(&sync, 160000));
+    TEST_ASSERT_EQUAL(40000, av_sync_video_frame(&sync, 320000));
+    TEST_ASSERT_EQUAL(20000, sync.frame_duration_us);
+}
+
+TEST_CASE("av_sync keeps smoothing the latency across a stats reset", "[stream]")
+{
+    av_sync_t sync;
+    av_sync_config_t cfg = config(RATE, 1);
+    int64_t pts;
+
+    TEST_ASSERT_EQUAL(ESP_OK, av_sync_init(&sync, &cfg));
+    for (int chunk = 0; chunk < 40; chunk++) {
+        av_sync_process(&sync, (uint64_t)chunk * CHUNK_CYCLES, s_in, CHUNK, s_out, sizeof(s_out) / 2, &pts);
+    }
+
+    /* 20 ms in flight, then 100 ms: one report moves the average by an eighth of the step */
+    av_sync_report(&sync, (uint32_t)sync.sent - RATE / 50);
+    TEST_ASSERT_EQUAL(20000, sync.stats.latency_us);
+    av_sync_reset_stats(&sync);
+    TEST_ASSERT_EQUAL(0, sync.stats.reports);
+    for (int chunk = 40; chunk < 60; chunk++) {
+        av_sync_process(&sync, (uint64_t)chunk * CHUNK_CYCLES, s_in, CHUNK, s_out, sizeof(s_out) / 2, &pts);
+    }
+    av_sync_report(&sync, (uint32_t)sync.sent - RATE / 10);
+    TEST_ASSERT_EQUAL(1, sync.stats.reports);
+    TEST_ASSERT_EQUAL(20000 + 80000 / 8, sync.stats.latency_us);
+    TEST_ASSERT_EQUAL(100000, sync.stats.max_latency_us);
+}
+
+TEST_CASE("av_sync trims the ratio without clicks", "[stream]")
+{
+    av_sync_t sync;
+    av_sync_config_t cfg = config(RATE, 1);
+    int16_t last = 0;
+    int32_t max_step = 0, min_ppm = 0, max_ppm = 0;
+    uint32_t n_in = 0;
+    int64_t pts;
+
+    TEST_ASSERT_EQUAL(ESP_OK, av_sync_init(&sync, &cfg));
+
+    /* 1 kHz at 16000: consecutive samples differ by at most 16000 * 2 pi / 48 */
+    for (int chunk = 0; chunk < 4800; chunk++) {
+        for (int i = 0; i < CHUNK; i++, n_in++) {
+            s_in[i] = (int16_t)lrint(16000 * sin(2 * M_PI * 1000 * n_in / RATE));
+        }
+        uint32_t n = av_sync_process(&sync, (uint64_t)chunk * CHUNK_CYCLES, s_in, CHUNK,
+                                     s_out, sizeof(s_out) / 2, &pts);
+        for (uint32_t i = 0; i < n; i++) {
+            int32_t d = abs(s_out[i] - last);
+            if (chunk && d > max_step) {
+                max_step = d;
+            }
+            last = s_out[i];
+        }
+
+        /* Swing the loop between both limits: far too late, then starved */
+        uint32_t played = (chunk / 1200) % 2 ? (uint32_t)sync.sent : (uint32_t)sync.sent - RATE / 10;
+        av_sync_report(&sync, played);
+        if (sync.stats.correction_ppm < min_ppm) {
+            min_ppm = sync.stats.correction_ppm;
+        }
+        if (sync.stats.correction_ppm > max_ppm) {
+            max_ppm = sync.stats.correction_ppm;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(AV_SYNC_MAX_CORRECTION_PPM, max_ppm);
+    TEST_ASSERT_EQUAL(-AV_SYNC_MAX_CORRECTION_PPM, min_ppm);
+    TEST_ASSERT_GREATER_THAN(0, sync.stats.clamped);
+    TEST_ASSERT_LESS_OR_EQUAL(2110, max_step);
+    TEST_ASSERT_GREATER_THAN(2000, max_step);
+}
+
+TEST_CASE("av_sync accepts only sync packets", "[stream]")
+{
+    av_sync_t sync;
+    av_sync_config_t cfg = config(RATE, 2);
+    stream_sync_packet_t pkt = { .type = STREAM_MSG_SYNC, .played = 0, .timestamp = 1234 };
+
+    TEST_ASSERT_EQUAL(9, sizeof(pkt));
+    TEST_ASSERT_EQUAL(ESP_OK, av_sync_init(&sync, &cfg));
+    TEST_ASSERT_EQUAL(ESP_OK, av_sync_report_packet(&sync, (const uint8_t *)&pkt, sizeof(pkt)));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, av_sync_report_packet(&sync, (const uint8_t *)&pkt, 5));
+    pkt.type = STREAM_MSG_AUDIO;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, av_sync_report_packet(&sync, (const uint8_t *)&pkt, sizeof(pkt)));
+    TEST_ASSERT_EQUAL(1, sync.stats.reports);
+}
+
+/*
+ * One minute of an emulator whose clock is off by skew_ppm against the
+ * browser's, with 2..6 ms of network delay each way. Time steps are 250 us
+ * of browser time.
+ */
+typedef struct {
+    uint64_t end;           // Output frames up to the end of a chunk
+    int64_t produced_us;
+} sim_chunk_t;
+
+static void simulate_skew(int32_t skew_ppm)
+{
+    static int16_t out[CHUNK * 2];
+    static sim_chunk_t chunks[64];
+    static struct {
+        uint64_t sent;
+        int64_t arrival_us;
+    } net[64];
+    av_sync_t sync;
+    av_sync_config_t cfg = config(RATE, 1);
+    uint32_t chunk = 0, n_chunks = 0, n_net = 0;
+    uint64_t arrived = 0, played = 0;
+    int64_t last_arrival = 0, report_due = -1, mean_ppm = 0;
+    uint32_t pending = 0, underruns = 0, samples = 0;
+    int32_t max_e2e = 0;
+    bool playing = false;
+    int64_t pts;
+
+    TEST_ASSERT_EQUAL(ESP_OK, av_sync_init(&sync, &cfg));
+    memset(s_in, 0, sizeof(s_in));
+
+    for (int64_t now = 0; now < 60000000; now += 250) {
+        bool settled = now >= 30000000;
+
+        /* Emulator: a chunk every 5 ms of emulated time */
+        while ((int64_t)chunk * 5000 * 1000000 / (1000000 + skew_ppm) <= now) {
+            uint32_t n = av_sync_process(&sync, (uint64_t)chunk * CHUNK_CYCLES, s_in, CHUNK,
+                                         out, CHUNK * 2, &pts);
+            int64_t arrival = now + 2000 + (int64_t)(chunk * 7919 % 4001);
+
+            last_arrival = arrival > last_arrival ? arrival : last_arrival;
+            net[n_net % 64].sent = sync.sent;
+            net[n_net % 64].arrival_us = last_arrival;
+            chunks[n_net % 64] = (sim_chunk_t) { sync.sent, now };
+            n_net++;
+            (void)n;
+            chunk++;
+        }
+
+        /* Browser: receive, then play 12 frames per step once 10 ms are buffered */
+        while (n_chunks < n_net && net[n_chunks % 64].arrival_us <= now) {
+            arrived = net[n_chunks % 64].sent;
+            n_chunks++;
+        }
+        if (!playing && arrived - played >= RATE / 100) {
+            playing = true;
+        }
+        if (playing) {
+            uint64_t next = played + 12;
+            if (next > arrived) {
+                if (settled) {
+                    underruns++;
+                }
+                next = arrived;
+            }
+            /* The first frame of a chunk played: how long since the emulator made it */
+            for (uint32_t i = n_net > 64 ? n_net - 64 : 0; i < n_net; i++) {
+                uint64_t start = chunks[i % 64].end - CHUNK;
+                if (start >= played && start < next && settled) {
+                    int32_t e2e = (int32_t)(now - chunks[i % 64].produced_us);
+                    max_e2e = e2e > max_e2e ? e2e : max_e2e;
+                }
+            }
+            played = next;
+        }
+
+        /* Position report every 100 ms, reaching the ESP32 3 ms later */
+        if (playing && now % 100000 == 0) {
+            pending = (uint32_t)played;
+            report_due = now + 3000;
+        }
+        if (report_due >= 0 && now >= report_due) {
+            av_sync_report(&sync, pending);
+            report_due = -1;
+            if (settled) {
+                mean_ppm += sync.stats.correction_ppm;
+                samples++;
+            }
+        }
+        if (now == 30000000) {
+            av_sync_reset_stats(&sync);
+        }
+    }
+
+    av_sync_stats_t stats;
+    av_sync_get_stats(&sync, &stats);
+    mean_ppm /= samples;
+    printf("skew %+5d ppm: correction %+5d ppm (mean %+5d), latency %d..%d us, e2e max %d us\n",
+           (int)skew_ppm, (int)stats.correction_ppm, (int)mean_ppm, (int)stats.min_latency_us,
+           (int)stats.max_latency_us, (int)max_e2e);
+
+    TEST_ASSERT_EQUAL(0, underruns);
+    TEST_ASSERT_EQUAL(0, stats.underruns);
+    TEST_ASSERT_EQUAL(0, stats.over_max);
+    TEST_ASSERT_LESS_THAN(AV_SYNC_MAX_LATENCY_US, stats.max_latency_us);
+    TEST_ASSERT_LESS_THAN(AV_SYNC_MAX_LATENCY_US, max_e2e);
+    TEST_ASSERT_INT_WITHIN(150, skew_ppm, mean_ppm);
+    TEST_ASSERT_INT_WITHIN(1000, skew_ppm, stats.correction_ppm);
+}
+
+TEST_CASE("av_sync holds latency under 30 ms with clock skew", "[stream]")
+{
+    static const int32_t skews[] = { 0, 1000, -1000, 4000, -4000 };
+
+    for (size_t i = 0; i < sizeof(skews) / sizeof(skews[0]); i++) {
+        simulate_skew(skews[i]);
+    }
+}
@@ -0,0 +1,227 @@
+/**
+ * @file test_delta.c
+ * @brief Delta-frame codec round trips
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esptari_delta.h"
+
+#define W   320
+#define H   200
+
+static uint8_t s_index[W * H];
+static uint16_t s_palette[H * 16];
+static uint16_t s_expect[W * H];
+static uint16_t s_out[W * H];
+static uint8_t s_pkt[160 * 1024];
+
+static delta_frame_t make_frame(uint8_t bpp, bool per_row)
+{
+    return (delta_frame_t) {
+        .width = W,
+        .height = H,
+        .bpp = bpp,
+        .index = s_index,
+        .palette = s_palette,
+        .palette_per_row = per_row,
+    };
+}
+
+/** What the client should display for @p f */
+static void expected(const delta_frame_t *f)
+{
+    uint32_t colours = 1u << f->bpp;
+
+    for (int y = 0; y < f->height; y++) {
+        const uint16_t *pal = f->palette + (f->palette_per_row ? (size_t)y * colours : 0);
+        for (int x = 0; x < f->width; x++) {
+            s_expect[y * f->width + x] = pal[s_index[y * f->width + x] & (colours - 1)];
+        }
+    }
+}
+
+static uint32_t round_trip(delta_encoder_t *enc, delta_decoder_t *dec, const delta_frame_t *f)
+{
+    uint32_t len;
+
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encode(enc, f, s_pkt, sizeof(s_pkt), &len));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_decode(dec, s_pkt, len));
+    expected(f);
+    delta_decoder_render(dec, s_out);
+    TEST_ASSERT_EQUAL(0, memcmp(s_expect, s_out, sizeof(uint16_t) * f->width * f->height));
+    return len;
+}
+
+static void fill_desktop(void)
+{
+    // GEM-like: dithered background with a plain window
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            bool window = x >= 40 && x < 280 && y >= 30 && y < 170;
+            s_index[y * W + x] = window ? 0 : (uint8_t)(((x ^ y) & 1) ? 3 : 1);
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        s_palette[i] = (uint16_t)(i * 0x1111);
+    }
+}
+
+TEST_CASE("delta keyframe then small change", "[delta]")
+{
+    delta_encoder_t enc;
+    delta_decoder_t dec;
+    delta_frame_t f = make_frame(4, false);
+
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encoder_init(&enc));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_decoder_init(&dec));
+    fill_desktop();
+
+    uint32_t key = round_trip(&enc, &dec, &f);
+    TEST_ASSERT_EQUAL(1, enc.stats.keyframes);
+    TEST_ASSERT_TRUE(key < W * H / 2);      // RLE beats the packed frame
+
+    // Mouse pointer sized change touches at most four tiles
+    for (int y = 104; y < 120; y++) {
+        for (int x = 150; x < 166; x++) {
+            s_index[y * W + x] = 15;
+        }
+    }
+    uint64_t tiles = enc.stats.tiles_sent;
+    uint32_t len = round_trip(&enc, &dec, &f);
+    TEST_ASSERT_TRUE(enc.stats.tiles_sent - tiles <= 4);
+    TEST_ASSERT_TRUE(len < 600);
+
+    // Nothing changed: header only
+    len = round_trip(&enc, &dec, &f);
+    TEST_ASSERT_EQUAL(sizeof(delta_packet_header_t), len);
+
+    delta_encoder_free(&enc);
+    delta_decoder_free(&dec);
+}
+
+TEST_CASE("delta random frames round trip at every depth", "[delta]")
+{
+    static const uint8_t depths[] = { 1, 2, 4, 8 };
+    delta_encoder_t enc;
+    delta_decoder_t dec;
+    static uint16_t palette256[256];
+
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encoder_init(&enc));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_decoder_init(&dec));
+    srand(7);
+    for (size_t d = 0; d < sizeof(depths); d++) {
+        delta_frame_t f = make_frame(depths[d], false);
+        f.palette = palette256;
+        for (int i = 0; i < 256; i++) {
+            palette256[i] = (uint16_t)rand();
+        }
+        for (int pass = 0; pass < 3; pass++) {
+            for (int i = 0; i < W * H; i++) {
+                s_index[i] = (uint8_t)rand();
+            }
+            round_trip(&enc, &dec, &f);
+        }
+    }
+    TEST_ASSERT_EQUAL(4, enc.stats.keyframes);      // One per mode change
+
+    delta_encoder_free(&enc);
+    delta_decoder_free(&dec);
+}
+
+TEST_CASE("delta per-row palettes and palette-only changes", "[delta]")
+{
+    delta_encoder_t enc;
+    delta_decoder_t dec;
+    delta_frame_t f = make_frame(4, true);
+
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encoder_init(&enc));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_decoder_init(&dec));
+    fill_desktop();
+    for (int y = 0; y < H; y++) {
+        memcpy(&s_palette[y * 16], s_palette, 16 * sizeof(uint16_t));
+    }
+    round_trip(&enc, &dec, &f);
+
+    // Raster bar: colour 0 changes on rows 50-59 only
+    for (int y = 50; y < 60; y++) {
+        s_palette[y * 16] = (uint16_t)(0xF800 + y);
+    }
+    uint64_t tiles = enc.stats.tiles_sent;
+    uint32_t len = round_trip(&enc, &dec, &f);
+    TEST_ASSERT_EQUAL(tiles, enc.stats.tiles_sent);
+    TEST_ASSERT_EQUAL(sizeof(delta_packet_header_t) + 12 * 34, len);
+
+    delta_encoder_free(&enc);
+    delta_decoder_free(&dec);
+}
+
+TEST_CASE("delta lost packet needs a keyframe", "[delta]")
+{
+    delta_encoder_t enc;
+    delta_decoder_t dec;
+    delta_frame_t f = make_frame(4, false);
+    uint32_t len;
+
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encoder_init(&enc));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_decoder_init(&dec));
+    fill_desktop();
+
+    // A client that joins mid-stream cannot use a delta
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encode(&enc, &f, s_pkt, sizeof(s_pkt), &len));
+    s_index[0] = 9;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encode(&enc, &f, s_pkt, sizeof(s_pkt), &len));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, delta_decode(&dec, s_pkt, len));
+
+    delta_encoder_request_key(&enc);
+    round_trip(&enc, &dec, &f);
+    TEST_ASSERT_EQUAL(2, enc.stats.keyframes);
+
+    // Dropped packet: the next one no longer applies
+    s_index[1] = 9;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encode(&enc, &f, s_pkt, sizeof(s_pkt), &len));
+    s_index[2] = 9;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encode(&enc, &f, s_pkt, sizeof(s_pkt), &len));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, delta_decode(&dec, s_pkt, len));
+
+    // Truncated packet
+    delta_encoder_request_key(&enc);
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encode(&enc, &f, s_pkt, sizeof(s_pkt), &len));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, delta_decode(&dec, s_pkt, len - 1));
+
+    delta_encoder_free(&enc);
+    delta_decoder_free(&dec);
+}
+
+TEST_CASE("delta dirty rows limit the comparison", "[delta]")
+{
+    delta_encoder_t enc;
+    delta_decoder_t dec;
+    delta_frame_t f = make_frame(4, false);
+    uint32_t dirty[(H + 31) / 32] = {0};
+    uint32_t len;
+
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encoder_init(&enc));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_decoder_init(&dec));
+    fill_desktop();
+    round_trip(&enc, &dec, &f);
+
+    // A change on a row reported clean is not looked at
+    f.dirty = dirty;
+    s_index[10 * W] = 15;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_encode(&enc, &f, s_pkt, sizeof(s_pkt), &len));
+    TEST_ASSERT_EQUAL(sizeof(delta_packet_header_t), len);
+    TEST_ASSERT_EQUAL(ESP_OK, delta_decode(&dec, s_pkt, len));
+
+    dirty[0] = 1u << 10;
+    round_trip(&enc, &dec, &f);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE,
+                      delta_encode(&enc, &f, s_pkt, 8, &len));
+    TEST_ASSERT_TRUE(delta_max_packet_size(W, H, 4) > W * H / 2);
+
+    delta_encoder_free(&enc);
+    delta_decoder_free(&dec);
+}
@@ -0,0 +1,199 @@
+/**
+ * @file test_indexed.c
+ * @brief Indexed-pixel packets decoded the way the browser does
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esptari_stream.h"
+
+#define W       320
+#define H       200
+#define PIXELS  (640 * 400)     // Largest ST screen
+
+static uint8_t s_index[PIXELS];
+static uint16_t s_planar[32000 / 2];
+static uint16_t s_palette[H * 16];
+static uint16_t s_expect[PIXELS];
+static uint16_t s_out[PIXELS];
+static uint8_t s_pkt[64 * 1024];
+
+/** ST screen words from colour indices, plane words interleaved per 16 pixels */
+static void to_planar(int width, int height, uint8_t bpp)
+{
+    uint16_t *w = s_planar;
+
+    for (int i = 0; i < width * height; i += 16) {
+        for (int p = 0; p < bpp; p++) {
+            uint16_t word = 0;
+            for (int x = 0; x < 16; x++) {
+                word = (uint16_t)((word << 1) | ((s_index[i + x] >> p) & 1));
+            }
+            *w++ = word;
+        }
+    }
+}
+
+/** Reference client: expand a packet to RGB565 */
+static void decode(const uint8_t *pkt, uint32_t len)
+{
+    indexed_frame_packet_t hdr;
+    memcpy(&hdr, pkt, sizeof(hdr));
+    TEST_ASSERT_EQUAL(STREAM_MSG_VIDEO_INDEXED, hdr.type);
+
+    uint32_t colours = 1u << hdr.bpp;
+    uint32_t block = 2 + 2 * colours;
+    const uint8_t *pal = pkt + sizeof(hdr);
+    const uint8_t *pix = pal + hdr.palette_count * block;
+    uint32_t row_bytes = (uint32_t)hdr.width * hdr.bpp / 8;
+    TEST_ASSERT_EQUAL(pix + row_bytes * hdr.height - pkt, len);
+
+    const uint8_t *cur = NULL;
+    int next = 0;
+    for (int y = 0; y < hdr.height; y++) {
+        uint16_t row;
+        while (next < hdr.palette_count &&
+               (memcpy(&row, pal + next * block, 2), row <= y)) {
+            cur = pal + next * block + 2;
+            next++;
+        }
+        TEST_ASSERT_NOT_NULL(cur);
+        const uint8_t *line = pix + y * row_bytes;
+        for (int x = 0; x < hdr.width; x++) {
+            uint32_t c = 0;
+            if (hdr.layout == STREAM_PIXELS_PLANAR) {
+                const uint8_t *group = line + (x / 16) * hdr.bpp * 2;
+                for (int p = 0; p < hdr.bpp; p++) {
+                    uint16_t word = (uint16_t)(group[p * 2] | (group[p * 2 + 1] << 8));
+                    c |= ((word >> (15 - x % 16)) & 1u) << p;
+                }
+            } else {
+                int ppb = 8 / hdr.bpp;
+                c = (line[x / ppb] >> ((ppb - 1 - x % ppb) * hdr.bpp)) & (colours - 1);
+            }
+            uint16_t rgb;
+            memcpy(&rgb, cur + c * 2, 2);
+            s_out[y * hdr.width + x] = rgb;
+        }
+    }
+}
+
+static void expected(int width, int height, uint8_t bpp, bool per_row, uint32_t stride)
+{
+    for (int y = 0; y < height; y++) {
+        const uint16_t *pal = s_palette + (per_row ? (size_t)y * stride : 0);
+        for (int x = 0; x < width; x++) {
+            s_expect[y * width + x] = pal[s_index[y * width + x] & ((1u << bpp) - 1)];
+        }
+    }
+}
+
+TEST_CASE("indexed planar and chunky frames at every ST depth", "[stream]")
+{
+    static const struct { uint16_t w, h; uint8_t bpp; } modes[] = {
+        { 320, 200, 4 }, { 640, 200, 2 }, { 640, 400, 1 },
+    };
+
+    srand(3);
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        int w = modes[m].w, h = modes[m].h;
+        uint8_t bpp = modes[m].bpp;
+        for (int i = 0; i < 16; i++) {
+            s_palette[i] = (uint16_t)rand();
+        }
+        for (int i = 0; i < w * h; i++) {
+            s_index[i] = (uint8_t)(rand() & ((1 << bpp) - 1));
+        }
+        to_planar(w, h, bpp);
+        expected(w, h, bpp, false, 0);
+
+        for (int layout = STREAM_PIXELS_PLANAR; layout <= STREAM_PIXELS_CHUNKY; layout++) {
+            stream_indexed_frame_t f = {
+                .width = (uint16_t)w, .height = (uint16_t)h, .bpp = bpp,
+                .layout = (uint8_t)layout, .planar = s_planar, .index = s_index,
+                .palette = s_palette,
+            };
+            uint32_t len;
+            TEST_ASSERT_EQUAL(ESP_OK, stream_build_indexed(&f, s_pkt, sizeof(s_pkt), &len));
+            TEST_ASSERT_TRUE(len <= stream_indexed_max_size(f.width, f.height, bpp));
+            TEST_ASSERT_EQUAL(sizeof(indexed_frame_packet_t) + 2 + 2 * (1 << bpp) + 32000, len);
+            decode(s_pkt, len);
+            TEST_ASSERT_EQUAL(0, memcmp(s_expect, s_out, sizeof(uint16_t) * w * h));
+        }
+    }
+}
+
+TEST_CASE("indexed low res with per-line palettes", "[stream]")
+{
+    static uint16_t line_rgb[H * 16];    // Shifter layout: 16 entries per line
+    uint32_t len;
+
+    for (int i = 0; i < W * H; i++) {
+        s_index[i] = (uint8_t)((i / 7 + i / W) & 15);
+    }
+    for (int y = 0; y < H; y++) {
+        for (int c = 0; c < 16; c++) {
+            line_rgb[y * 16 + c] = (uint16_t)(c * 0x0821);
+        }
+    }
+    for (int y = 100; y < 110; y++) {
+        line_rgb[y * 16] = (uint16_t)(0xF800 | y);   // Raster bar in colour 0
+    }
+    memcpy(s_palette, line_rgb, sizeof(line_rgb));
+    to_planar(W, H, 4);
+
+    stream_indexed_frame_t f = {
+        .width = W, .height = H, .bpp = 4, .layout = STREAM_PIXELS_PLANAR,
+        .planar = s_planar, .palette = line_rgb, .palette_per_row = true,
+        .palette_stride = 16, .frame_number = 9,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, stream_build_indexed(&f, s_pkt, sizeof(s_pkt), &len));
+    decode(s_pkt, len);
+    expected(W, H, 4, true, 16);
+    TEST_ASSERT_EQUAL(0, memcmp(s_expect, s_out, sizeof(uint16_t) * W * H));
+
+    // Bar rows plus the row after it: 12 blocks, far under a 640x400 RGB565 frame
+    TEST_ASSERT_EQUAL(sizeof(indexed_frame_packet_t) + 12 * 34 + 32000, len);
+    TEST_ASSERT_TRUE(len * 15 < 640 * 400 * 2);
+
+    f.layout = STREAM_PIXELS_CHUNKY;
+    f.index = s_index;
+    TEST_ASSERT_EQUAL(ESP_OK, stream_build_indexed(&f, s_pkt, sizeof(s_pkt), &len));
+    decode(s_pkt, len);
+    TEST_ASSERT_EQUAL(0, memcmp(s_expect, s_out, sizeof(uint16_t) * W * H));
+}
+
+TEST_CASE("indexed rejects unsupported frames", "[stream]")
+{
+    stream_indexed_frame_t f = {
+        .width = W, .height = H, .bpp = 4, .layout = STREAM_PIXELS_CHUNKY,
+        .index = s_index, .palette = s_palette,
+    };
+    uint32_t len;
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, stream_build_indexed(&f, s_pkt, 1000, &len));
+    f.bpp = 3;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, stream_build_indexed(&f, s_pkt, sizeof(s_pkt), &len));
+    f.bpp = 8;
+    f.palette_per_row = true;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, stream_build_indexed(&f, s_pkt, sizeof(s_pkt), &len));
+    f.bpp = 4;
+    f.palette_per_row = false;
+    f.width = 100;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, stream_build_indexed(&f, s_pkt, sizeof(s_pkt), &len));
+    f.width = W;
+    f.layout = STREAM_PIXELS_PLANAR;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, stream_build_indexed(&f, s_pkt, sizeof(s_pkt), &len));
+}
+
+TEST_CASE("stream video mode names", "[stream]")
+{
+    TEST_ASSERT_EQUAL(STREAM_VIDEO_INDEXED, stream_video_mode_parse("indexed"));
+    TEST_ASSERT_EQUAL(STREAM_VIDEO_DELTA, stream_video_mode_parse("delta"));
+    TEST_ASSERT_EQUAL(STREAM_VIDEO_RAW, stream_video_mode_parse("raw"));
+    TEST_ASSERT_EQUAL(STREAM_VIDEO_MJPEG, stream_video_mode_parse("mjpeg"));
+    TEST_ASSERT_EQUAL(STREAM_VIDEO_MJPEG, stream_video_mode_parse("h264"));
+    TEST_ASSERT_EQUAL(STREAM_VIDEO_MJPEG, stream_video_mode_parse(NULL));
+}
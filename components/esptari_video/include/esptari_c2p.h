@@ -0,0 +1,94 @@
+/**
+ * @file esptari_c2p.h
+ * @brief Planar to chunky (RGB565) conversion kernels
+ *
+ * Atari screens are stored as interleaved bitplanes: each group of 16
+ * pixels is @c bpp consecutive words, one per plane, leftmost pixel in
+ * bit 15. ST low, medium and high resolution are 4, 2 and 1 planes; the
+ * Falcon VIDEL adds 8 planes and 16 bpp true colour (one RGB565 word per
+ * pixel, copied as is). Source words are in host order, as returned by
+ * mem_video_read().
+ *
+ * Two kernels exist per depth and c2p_get() picks one:
+ * - table: bytes of each plane are spread through a 256-entry table, the
+ *   classic approach, with two 4-bit pixels per lookup of c2p_lut_t::pair
+ * - word:  plane bits are spread by shift-and-mask on whole words, trading
+ *   the spread table's loads for ALU operations
+ *
+ * c2p_ref_line() is the per-pixel reference both are tested against.
+ *
+ * The kernels only depend on <stdint.h> and are compiled into the
+ * dynamic video components as well as the firmware.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define C2P_GROUP_PIXELS    16
+
+/**
+ * @brief Palette in the form the kernels read it
+ */
+typedef struct {
+    uint16_t rgb[256];          ///< RGB565 per colour index
+    uint32_t pair[256];         ///< rgb[i & 15] | rgb[i >> 4] << 16, for <= 4 bpp
+    bool     pair_dirty;        ///< rgb[0..15] changed since pair[] was built
+} c2p_lut_t;
+
+typedef enum {
+    C2P_IMPL_AUTO,              ///< Fastest measured kernel for the depth
+    C2P_IMPL_TABLE,
+    C2P_IMPL_WORD,
+} c2p_impl_t;
+
+/**
+ * @brief Convert one line
+ *
+ * @param src    groups * bpp planar words (groups * 16 at 16 bpp)
+ * @param dst    groups * 16 RGB565 pixels
+ * @param groups Number of 16-pixel groups
+ * @param lut    Palette; pair[] must be current (see c2p_lut_update())
+ */
+typedef void (*c2p_line_fn)(const uint16_t *src, uint16_t *dst, int groups,
+                            const c2p_lut_t *lut);
+
+/**
+ * @brief Kernel for a depth
+ *
+ * @param bpp 1, 2, 4, 8 or 16
+ * @return NULL for any other depth
+ */
+c2p_line_fn c2p_get(int bpp, c2p_impl_t impl);
+
+/** Rebuild pair[] if rgb[0..15] changed */
+static inline void c2p_lut_update(c2p_lut_t *lut)
+{
+    if (lut->pair_dirty) {
+        for (int i = 0; i < 256; i++) {
+            lut->pair[i] = (uint32_t)lut->rgb[i & 15] | ((uint32_t)lut->rgb[i >> 4] << 16);
+        }
+        lut->pair_dirty = false;
+    }
+}
+
+/**
+ * @brief Colour indices instead of RGB565, for palette effects and the
+ *        indexed stream
+ *
+ * @param bpp 1, 2, 4 or 8
+ */
+void c2p_to_index(const uint16_t *src, uint8_t *dst, int groups, int bpp);
+
+/** Per-pixel reference conversion */
+void c2p_ref_line(const uint16_t *src, uint16_t *dst, int groups, int bpp,
+                  const c2p_lut_t *lut);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file esptari_video.h
+ * @brief Emulated frame buffer and changed-row tracking
+ *
+ * Double-buffered RGB565 frames in PSRAM (IMPLEMENTATION_PLAN.md, 3.1).
+ * Every published frame carries a bitmap of the rows that differ from the
+ * frame published before it, built from the video component's dirty lines
+ * (video_interface_t::get_dirty). A streamer sends only those rows; if it
+ * skips frames it ORs their bitmaps together first.
+ *
+ * Hand-off between the emulation and streaming tasks is left to the
+ * caller.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "component_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FB_MAX_WIDTH        640
+#define FB_MAX_HEIGHT       VIDEO_MAX_LINES
+#define FB_BYTES_PER_PIXEL  2       ///< RGB565
+
+/**
+ * @brief Double-buffered frame buffer
+ */
+typedef struct {
+    uint8_t *buffer[2];         // RGB565 frames
+    uint8_t  current;           // Current write buffer
+    uint32_t width;             // Current resolution width
+    uint32_t height;            // Current resolution height
+    uint32_t frame_number;      // Frame counter for sync
+    int64_t  timestamp_us;      // Frame timestamp
+    uint32_t dirty[2][VIDEO_DIRTY_WORDS];  // Rows changed vs the previous frame
+    bool     mode_changed;      // Next published frame is dirty throughout
+} framebuffer_t;
+
+// Row bitmap helpers
+
+static inline bool video_dirty_test(const uint32_t *bitmap, int row)
+{
+    return (bitmap[row / 32] >> (row % 32)) & 1;
+}
+
+static inline void video_dirty_set(uint32_t *bitmap, int row)
+{
+    bitmap[row / 32] |= 1u << (row % 32);
+}
+
+/** dst |= src, for merging the bitmaps of frames that were not sent */
+static inline void video_dirty_merge(uint32_t *dst, const uint32_t *src)
+{
+    for (int i = 0; i < VIDEO_DIRTY_WORDS; i++) {
+        dst[i] |= src[i];
+    }
+}
+
+/** Number of dirty rows among the first @p rows */
+int video_dirty_count(const uint32_t *bitmap, int rows);
+
+/**
+ * @brief Allocate both buffers at FB_MAX_WIDTH x FB_MAX_HEIGHT
+ *
+ * @return ESP_ERR_NO_MEM if PSRAM is exhausted
+ */
+esp_err_t fb_init(framebuffer_t *fb);
+void fb_free(framebuffer_t *fb);
+
+/**
+ * @brief Set the output resolution; the next frame is sent whole
+ *
+ * @return ESP_ERR_INVALID_ARG beyond FB_MAX_WIDTH x FB_MAX_HEIGHT
+ */
+esp_err_t fb_set_mode(framebuffer_t *fb, uint32_t width, uint32_t height);
+
+/** Buffer the video component renders into */
+static inline uint8_t *fb_back(framebuffer_t *fb)
+{
+    return fb->buffer[fb->current];
+}
+
+/**
+ * @brief Publish the back buffer as the newest frame and swap
+ *
+ * @param lines      Dirty line bitmap from the video component
+ * @param line_scale Output rows per emulated line (2 for 200-line modes
+ *                   doubled to 400 rows)
+ */
+void fb_publish(framebuffer_t *fb, const uint32_t *lines, int line_scale, int64_t timestamp_us);
+
+/**
+ * @brief Newest published frame
+ *
+ * @param dirty Set to its changed-row bitmap (may be NULL)
+ */
+const uint8_t *fb_front(const framebuffer_t *fb, const uint32_t **dirty);
+
+#ifdef __cplusplus
+}
+#endif
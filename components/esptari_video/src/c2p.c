@@ -0,0 +1,257 @@
+/**
+ * @file c2p.c
+ * @brief Planar to chunky (RGB565) conversion kernels
+ */
+
+#include <string.h>
+#include "esptari_c2p.h"
+
+/** Byte b to eight 4-bit pixels, bit 7 (leftmost) in the lowest nibble */
+static uint32_t s_spread4[256];
+
+/** Nibble n to four 8-bit pixels, bit 3 (leftmost) in the lowest byte */
+static uint32_t s_spread8[16];
+
+static void c2p_build_tables(void)
+{
+    for (int b = 0; b < 256; b++) {
+        uint32_t v = 0;
+        for (int j = 0; j < 8; j++) {
+            if (b & (0x80 >> j)) {
+                v |= 1u << (4 * j);
+            }
+        }
+        s_spread4[b] = v;
+    }
+    for (int n = 0; n < 16; n++) {
+        uint32_t v = 0;
+        for (int j = 0; j < 4; j++) {
+            if (n & (0x8 >> j)) {
+                v |= 1u << (8 * j);
+            }
+        }
+        s_spread8[n] = v;
+    }
+}
+
+static inline void c2p_init(void)
+{
+    if (!s_spread4[1]) {
+        c2p_build_tables();
+    }
+}
+
+/** Eight pixels of 4-bit indices, leftmost in the lowest byte, through pair[] */
+static inline void c2p_emit8(uint16_t *dst, uint32_t n, const uint32_t *pair)
+{
+    uint32_t px[4] = {
+        pair[n & 0xFF],
+        pair[(n >> 8) & 0xFF],
+        pair[(n >> 16) & 0xFF],
+        pair[n >> 24],
+    };
+    memcpy(dst, px, sizeof(px));
+}
+
+// ---------------------------------------------------------------------------
+// Table kernels
+// ---------------------------------------------------------------------------
+
+static inline uint32_t c2p_table_half(const uint16_t *w, int planes, int shift)
+{
+    uint32_t n = 0;
+
+    for (int p = 0; p < planes; p++) {
+        n |= s_spread4[(w[p] >> shift) & 0xFF] << p;
+    }
+    return n;
+}
+
+static inline void c2p_table_n(const uint16_t *src, uint16_t *dst, int groups,
+                               const c2p_lut_t *lut, int planes)
+{
+    for (int g = 0; g < groups; g++, src += planes, dst += 16) {
+        c2p_emit8(dst, c2p_table_half(src, planes, 8), lut->pair);
+        c2p_emit8(dst + 8, c2p_table_half(src, planes, 0), lut->pair);
+    }
+}
+
+static void c2p_table_1(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    c2p_table_n(src, dst, groups, lut, 1);
+}
+
+static void c2p_table_2(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    c2p_table_n(src, dst, groups, lut, 2);
+}
+
+static void c2p_table_4(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    c2p_table_n(src, dst, groups, lut, 4);
+}
+
+static void c2p_table_8(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    for (int g = 0; g < groups; g++, src += 8) {
+        for (int shift = 12; shift >= 0; shift -= 4) {
+            uint32_t n = 0;
+            for (int p = 0; p < 8; p++) {
+                n |= s_spread8[(src[p] >> shift) & 0xF] << p;
+            }
+            *dst++ = lut->rgb[n & 0xFF];
+            *dst++ = lut->rgb[(n >> 8) & 0xFF];
+            *dst++ = lut->rgb[(n >> 16) & 0xFF];
+            *dst++ = lut->rgb[n >> 24];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Word kernels
+// ---------------------------------------------------------------------------
+
+/** Bit i of a byte to bit 0 of nibble i */
+static inline uint32_t c2p_bits_to_nibbles(uint32_t b)
+{
+    b = (b | (b << 12)) & 0x000F000Fu;
+    b = (b | (b << 6)) & 0x03030303u;
+    return (b | (b << 3)) & 0x11111111u;
+}
+
+/** Bit i of a nibble to bit 0 of byte i */
+static inline uint32_t c2p_bits_to_bytes(uint32_t n)
+{
+    n = (n | (n << 14)) & 0x00030003u;
+    return (n | (n << 7)) & 0x01010101u;
+}
+
+static inline uint32_t c2p_word_half(const uint16_t *w, int planes, int shift)
+{
+    uint32_t n = 0;
+
+    for (int p = 0; p < planes; p++) {
+        n |= c2p_bits_to_nibbles((w[p] >> shift) & 0xFF) << p;
+    }
+    // Nibble j now holds pixel 7 - j: swap the nibbles of each byte so
+    // byte k holds pixels 7 - 2k (left) and 6 - 2k, then read bytes 3..0
+    n = ((n >> 4) & 0x0F0F0F0Fu) | ((n & 0x0F0F0F0Fu) << 4);
+    return (n >> 24) | ((n >> 8) & 0xFF00u) | ((n << 8) & 0xFF0000u) | (n << 24);
+}
+
+static inline void c2p_word_n(const uint16_t *src, uint16_t *dst, int groups,
+                              const c2p_lut_t *lut, int planes)
+{
+    for (int g = 0; g < groups; g++, src += planes, dst += 16) {
+        c2p_emit8(dst, c2p_word_half(src, planes, 8), lut->pair);
+        c2p_emit8(dst + 8, c2p_word_half(src, planes, 0), lut->pair);
+    }
+}
+
+static void c2p_word_1(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    c2p_word_n(src, dst, groups, lut, 1);
+}
+
+static void c2p_word_2(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    c2p_word_n(src, dst, groups, lut, 2);
+}
+
+static void c2p_word_4(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    c2p_word_n(src, dst, groups, lut, 4);
+}
+
+static void c2p_word_8(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    for (int g = 0; g < groups; g++, src += 8) {
+        for (int shift = 12; shift >= 0; shift -= 4) {
+            uint32_t n = 0;
+            for (int p = 0; p < 8; p++) {
+                n |= c2p_bits_to_bytes((src[p] >> shift) & 0xF) << p;
+            }
+            // Byte j holds pixel 3 - j
+            *dst++ = lut->rgb[n >> 24];
+            *dst++ = lut->rgb[(n >> 16) & 0xFF];
+            *dst++ = lut->rgb[(n >> 8) & 0xFF];
+            *dst++ = lut->rgb[n & 0xFF];
+        }
+    }
+}
+
+static void c2p_copy_16(const uint16_t *src, uint16_t *dst, int groups, const c2p_lut_t *lut)
+{
+    (void)lut;
+    memcpy(dst, src, (size_t)groups * C2P_GROUP_PIXELS * sizeof(uint16_t));
+}
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+/** Depths in the order of the kernel tables */
+static const uint8_t s_depths[] = { 1, 2, 4, 8, 16 };
+
+static const c2p_line_fn s_table_kernels[] = {
+    c2p_table_1, c2p_table_2, c2p_table_4, c2p_table_8, c2p_copy_16,
+};
+
+static const c2p_line_fn s_word_kernels[] = {
+    c2p_word_1, c2p_word_2, c2p_word_4, c2p_word_8, c2p_copy_16,
+};
+
+c2p_line_fn c2p_get(int bpp, c2p_impl_t impl)
+{
+    c2p_init();
+    for (size_t i = 0; i < sizeof(s_depths); i++) {
+        if (s_depths[i] == bpp) {
+            // Table kernels win at every depth in c2p_bench, so AUTO uses them
+            return impl == C2P_IMPL_WORD ? s_word_kernels[i] : s_table_kernels[i];
+        }
+    }
+    return NULL;
+}
+
+void c2p_to_index(const uint16_t *src, uint8_t *dst, int groups, int bpp)
+{
+    c2p_init();
+    for (int g = 0; g < groups; g++, src += bpp) {
+        if (bpp == 8) {
+            for (int shift = 12; shift >= 0; shift -= 4, dst += 4) {
+                uint32_t n = 0;
+                for (int p = 0; p < 8; p++) {
+                    n |= s_spread8[(src[p] >> shift) & 0xF] << p;
+                }
+                for (int j = 0; j < 4; j++) {
+                    dst[j] = (uint8_t)(n >> (8 * j));
+                }
+            }
+            continue;
+        }
+        for (int shift = 8; shift >= 0; shift -= 8, dst += 8) {
+            uint32_t n = c2p_table_half(src, bpp, shift);
+            for (int j = 0; j < 8; j++) {
+                dst[j] = (uint8_t)((n >> (4 * j)) & 15);
+            }
+        }
+    }
+}
+
+void c2p_ref_line(const uint16_t *src, uint16_t *dst, int groups, int bpp,
+                  const c2p_lut_t *lut)
+{
+    for (int x = 0; x < groups * C2P_GROUP_PIXELS; x++) {
+        if (bpp == 16) {
+            dst[x] = src[x];
+            continue;
+        }
+        const uint16_t *w = src + (x / C2P_GROUP_PIXELS) * bpp;
+        int bit = 15 - x % C2P_GROUP_PIXELS;
+        int index = 0;
+        for (int p = 0; p < bpp; p++) {
+            index |= ((w[p] >> bit) & 1) << p;
+        }
+        dst[x] = lut->rgb[index];
+    }
+}
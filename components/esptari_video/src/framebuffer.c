@@ -0,0 +1,98 @@
+/**
+ * @file framebuffer.c
+ * @brief Emulated frame buffer and changed-row tracking
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esptari_video.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#define FB_ALLOC(size)  heap_caps_calloc(1, (size), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define FB_FREE(ptr)    heap_caps_free(ptr)
+#else
+#define FB_ALLOC(size)  calloc(1, (size))
+#define FB_FREE(ptr)    free(ptr)
+#endif
+
+#define FB_BUFFER_SIZE  (FB_MAX_WIDTH * FB_MAX_HEIGHT * FB_BYTES_PER_PIXEL)
+
+int video_dirty_count(const uint32_t *bitmap, int rows)
+{
+    int n = 0;
+
+    for (int i = 0; i < rows; i++) {
+        n += video_dirty_test(bitmap, i);
+    }
+    return n;
+}
+
+esp_err_t fb_init(framebuffer_t *fb)
+{
+    memset(fb, 0, sizeof(*fb));
+    for (int i = 0; i < 2; i++) {
+        fb->buffer[i] = FB_ALLOC(FB_BUFFER_SIZE);
+        if (!fb->buffer[i]) {
+            fb_free(fb);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    fb->mode_changed = true;
+    return ESP_OK;
+}
+
+void fb_free(framebuffer_t *fb)
+{
+    for (int i = 0; i < 2; i++) {
+        FB_FREE(fb->buffer[i]);
+        fb->buffer[i] = NULL;
+    }
+}
+
+esp_err_t fb_set_mode(framebuffer_t *fb, uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0 || width > FB_MAX_WIDTH || height > FB_MAX_HEIGHT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (width != fb->width || height != fb->height) {
+        fb->width = width;
+        fb->height = height;
+        fb->mode_changed = true;
+    }
+    return ESP_OK;
+}
+
+void fb_publish(framebuffer_t *fb, const uint32_t *lines, int line_scale, int64_t timestamp_us)
+{
+    uint32_t *dirty = fb->dirty[fb->current];
+
+    memset(dirty, 0, sizeof(fb->dirty[0]));
+    if (fb->mode_changed || !lines) {
+        for (uint32_t row = 0; row < fb->height; row++) {
+            video_dirty_set(dirty, (int)row);
+        }
+        fb->mode_changed = false;
+    } else {
+        int scale = line_scale > 0 ? line_scale : 1;
+        for (uint32_t row = 0; row < fb->height; row++) {
+            if (video_dirty_test(lines, (int)row / scale)) {
+                video_dirty_set(dirty, (int)row);
+            }
+        }
+    }
+
+    fb->timestamp_us = timestamp_us;
+    fb->frame_number++;
+    fb->current ^= 1;
+}
+
+const uint8_t *fb_front(const framebuffer_t *fb, const uint32_t **dirty)
+{
+    int front = fb->current ^ 1;
+
+    if (dirty) {
+        *dirty = fb->dirty[front];
+    }
+    return fb->buffer[front];
+}
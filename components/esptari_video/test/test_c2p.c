@@ -0,0 +1,118 @@
+/**
+ * @file test_c2p.c
+ * @brief Planar to chunky kernels against the per-pixel reference
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "unity.h"
+#include "esptari_c2p.h"
+
+#define TEST_GROUPS 40      // 640 pixels
+
+static const int s_depths[] = { 1, 2, 4, 8, 16 };
+
+static uint32_t s_seed = 12345;
+
+static uint16_t rand16(void)
+{
+    s_seed = s_seed * 1103515245u + 12345u;
+    return (uint16_t)(s_seed >> 16);
+}
+
+static void random_lut(c2p_lut_t *lut)
+{
+    for (int i = 0; i < 256; i++) {
+        lut->rgb[i] = rand16();
+    }
+    lut->pair_dirty = true;
+    c2p_lut_update(lut);
+}
+
+static void check_kernel(int bpp, c2p_impl_t impl)
+{
+    static uint16_t src[TEST_GROUPS * 16];
+    static uint16_t ref[TEST_GROUPS * 16];
+    static uint16_t out[TEST_GROUPS * 16];
+    static c2p_lut_t lut;
+    c2p_line_fn fn = c2p_get(bpp, impl);
+
+    TEST_ASSERT_NOT_NULL(fn);
+    for (int pass = 0; pass < 8; pass++) {
+        random_lut(&lut);
+        for (int i = 0; i < TEST_GROUPS * 16; i++) {
+            src[i] = rand16();
+        }
+        c2p_ref_line(src, ref, TEST_GROUPS, bpp, &lut);
+        fn(src, out, TEST_GROUPS, &lut);
+        TEST_ASSERT_EQUAL(0, memcmp(ref, out, sizeof(ref)));
+    }
+}
+
+TEST_CASE("c2p table kernels match the reference", "[c2p]")
+{
+    for (size_t i = 0; i < sizeof(s_depths) / sizeof(s_depths[0]); i++) {
+        check_kernel(s_depths[i], C2P_IMPL_TABLE);
+    }
+}
+
+TEST_CASE("c2p word kernels match the reference", "[c2p]")
+{
+    for (size_t i = 0; i < sizeof(s_depths) / sizeof(s_depths[0]); i++) {
+        check_kernel(s_depths[i], C2P_IMPL_WORD);
+    }
+}
+
+TEST_CASE("c2p auto kernels match the reference", "[c2p]")
+{
+    for (size_t i = 0; i < sizeof(s_depths) / sizeof(s_depths[0]); i++) {
+        check_kernel(s_depths[i], C2P_IMPL_AUTO);
+    }
+    TEST_ASSERT_NULL(c2p_get(3, C2P_IMPL_AUTO));
+}
+
+TEST_CASE("c2p plane order and leftmost pixel", "[c2p]")
+{
+    static c2p_lut_t lut;
+    uint16_t src[4] = { 0x8000, 0x0000, 0x0000, 0x0001 };   // Pixel 0 = 1, pixel 15 = 8
+    uint8_t index[16];
+    uint16_t out[16];
+
+    for (int i = 0; i < 16; i++) {
+        lut.rgb[i] = (uint16_t)(0x100 * i);
+    }
+    lut.pair_dirty = true;
+    c2p_lut_update(&lut);
+
+    c2p_to_index(src, index, 1, 4);
+    TEST_ASSERT_EQUAL(1, index[0]);
+    TEST_ASSERT_EQUAL(0, index[1]);
+    TEST_ASSERT_EQUAL(8, index[15]);
+
+    c2p_get(4, C2P_IMPL_AUTO)(src, out, 1, &lut);
+    TEST_ASSERT_EQUAL_HEX16(0x0100, out[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x0800, out[15]);
+}
+
+TEST_CASE("c2p indices match the reference", "[c2p]")
+{
+    static uint16_t src[TEST_GROUPS * 8];
+    static uint16_t ref[TEST_GROUPS * 16];
+    static uint8_t index[TEST_GROUPS * 16];
+    static c2p_lut_t lut;
+
+    for (int i = 0; i < 256; i++) {
+        lut.rgb[i] = (uint16_t)i;   // Identity: reference output is the index
+    }
+    for (size_t d = 0; d < 4; d++) {
+        int bpp = s_depths[d];
+        for (int i = 0; i < TEST_GROUPS * bpp; i++) {
+            src[i] = rand16();
+        }
+        c2p_ref_line(src, ref, TEST_GROUPS, bpp, &lut);
+        c2p_to_index(src, index, TEST_GROUPS, bpp);
+        for (int x = 0; x < TEST_GROUPS * 16; x++) {
+            TEST_ASSERT_EQUAL(ref[x], index[x]);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * @file test_framebuffer.c
+ * @brief Frame buffer and changed-row bitmap tests
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "unity.h"
+#include "esptari_video.h"
+
+TEST_CASE("fb first frame after a mode change is fully dirty", "[video]")
+{
+    framebuffer_t fb;
+    const uint32_t *dirty;
+    uint32_t lines[VIDEO_DIRTY_WORDS] = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, fb_init(&fb));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, fb_set_mode(&fb, 800, 400));
+    TEST_ASSERT_EQUAL(ESP_OK, fb_set_mode(&fb, 320, 200));
+
+    uint8_t *back = fb_back(&fb);
+    fb_publish(&fb, lines, 1, 1000);
+    TEST_ASSERT_EQUAL_PTR(back, fb_front(&fb, &dirty));
+    TEST_ASSERT_EQUAL(200, video_dirty_count(dirty, FB_MAX_HEIGHT));
+    TEST_ASSERT_EQUAL(1, fb.frame_number);
+
+    // Nothing changed: the next frame is clean and the buffers swapped back
+    fb_publish(&fb, lines, 1, 2000);
+    TEST_ASSERT_EQUAL_PTR(fb_back(&fb), back);
+    fb_front(&fb, &dirty);
+    TEST_ASSERT_EQUAL(0, video_dirty_count(dirty, FB_MAX_HEIGHT));
+    TEST_ASSERT_EQUAL(2000, fb.timestamp_us);
+
+    fb_free(&fb);
+}
+
+TEST_CASE("fb scales dirty lines to output rows", "[video]")
+{
+    framebuffer_t fb;
+    const uint32_t *dirty;
+    uint32_t lines[VIDEO_DIRTY_WORDS] = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, fb_init(&fb));
+    TEST_ASSERT_EQUAL(ESP_OK, fb_set_mode(&fb, 640, 400));
+    fb_publish(&fb, NULL, 2, 0);
+
+    video_dirty_set(lines, 0);
+    video_dirty_set(lines, 199);
+    fb_publish(&fb, lines, 2, 0);
+    fb_front(&fb, &dirty);
+    TEST_ASSERT_EQUAL(4, video_dirty_count(dirty, FB_MAX_HEIGHT));
+    TEST_ASSERT_TRUE(video_dirty_test(dirty, 0));
+    TEST_ASSERT_TRUE(video_dirty_test(dirty, 1));
+    TEST_ASSERT_TRUE(video_dirty_test(dirty, 398));
+    TEST_ASSERT_TRUE(video_dirty_test(dirty, 399));
+
+    fb_free(&fb);
+}
+
+TEST_CASE("fb merged bitmaps cover skipped frames", "[video]")
+{
+    framebuffer_t fb;
+    const uint32_t *dirty;
+    uint32_t lines[VIDEO_DIRTY_WORDS] = {0};
+    uint32_t pending[VIDEO_DIRTY_WORDS] = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, fb_init(&fb));
+    TEST_ASSERT_EQUAL(ESP_OK, fb_set_mode(&fb, 320, 200));
+    fb_publish(&fb, NULL, 1, 0);
+
+    // A streamer that falls behind sends the union of what it missed
+    for (int i = 0; i < 3; i++) {
+        memset(lines, 0, sizeof(lines));
+        video_dirty_set(lines, 10 * (i + 1));
+        fb_publish(&fb, lines, 1, 0);
+        fb_front(&fb, &dirty);
+        video_dirty_merge(pending, dirty);
+    }
+    TEST_ASSERT_EQUAL(3, video_dirty_count(pending, FB_MAX_HEIGHT));
+    TEST_ASSERT_TRUE(video_dirty_test(pending, 10));
+    TEST_ASSERT_TRUE(video_dirty_test(pending, 20));
+    TEST_ASSERT_TRUE(video_dirty_test(pending, 30));
+
+    fb_free(&fb);
+}
@@ -0,0 +1,260 @@
+/**
+ * @file dsp56k_bench.c
+ * @brief Host benchmark for the DSP56001 interpreter
+ *
+ * Runs two kernels for the given seconds of 32 MHz DSP time: a 32-tap FIR
+ * (DO loop of MAC with two parallel moves and modulo addressing, what
+ * Falcon audio code spends its time in) and a branch kernel (bit tests,
+ * conditional jumps, subroutine calls). Reports emulated instructions
+ * per second, the speed against a real 32 MHz DSP and the share of a
+ * 400 MHz core running the DSP in real time takes, scaled by clock.
+ *
+ * Then runs the FIR behind the host port in lock-step: a second thread
+ * plays the Core 1 task calling dsp56k_run_async() while the main thread
+ * clocks the DSP in 68030 slices and sends it a word every few hundred
+ * microseconds, and reports how often either side had to wait. That run
+ * needs two host CPUs to mean anything, as the firmware has two P4 cores.
+ *
+ * dsp56k_bench_nocache is the same source built with DSP56K_DECODE_ALWAYS,
+ * the baseline the decode cache is measured against.
+ *
+ * Usage: dsp56k_bench [host_mhz] [seconds]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "dsp56k.h"
+
+#define BENCH_P4_CLOCK_MHZ  400.0
+#define BENCH_PASSES        3           /**< Best of, to ride out host noise */
+#define BENCH_SLICE         64          /**< 68030 cycles per dsp56k_host_clock() */
+#define BENCH_WORD_SLICES   64          /**< Slices between host port words */
+
+#ifdef DSP56K_DECODE_ALWAYS
+#define BENCH_VARIANT       "decoding every instruction"
+#else
+#define BENCH_VARIANT       "decode cache"
+#endif
+
+typedef struct {
+    const char *name;
+    const uint32_t *program;
+    size_t words;
+} bench_kernel_t;
+
+static const uint32_t s_fir[] = {
+    0x300000,               // move #0,r0
+    0x340000,               // move #0,r4
+    0x051FA0,               // movec #31,m0
+    0x051FA4,               // movec #31,m4
+    0xF09813,               // clr a x:(r0)+,x0 y:(r4)+,y0
+    0x061F80, 0x000007,     // do #31,_end
+    0xF098D2,               // mac x0,y0,a x:(r0)+,x0 y:(r4)+,y0     _end
+    0x2000D3,               // macr x0,y0,a
+    0x0C0004,               // jmp $4
+};
+
+static const uint32_t s_branch[] = {
+    0x300000,               // move #0,r0
+    0x0B0000,               // bchg #0,x:$0
+    0x0A0080, 0x000005,     // jclr #0,x:$0,$5
+    0x200040,               // add x0,a
+    0x0D0008,               // jsr $8
+    0x0C0001,               // jmp $1
+    0x000000,               // nop
+    0x200003,               // tst a
+    0x0E300B,               // jpl $b
+    0x200013,               // clr a
+    0x00000C,               // rts
+};
+
+/** The FIR per word from the host port */
+static const uint32_t s_host_fir[] = {
+    0x0AA980, 0x000000,     // jclr #0,x:$ffe9,*
+    0x44F000, 0x00FFEB,     // move x:$ffeb,x0
+    0xF09813,               // clr a x:(r0)+,x0 y:(r4)+,y0
+    0x061F80, 0x000007,     // do #31,_end
+    0xF098D2,               // mac x0,y0,a x:(r0)+,x0 y:(r4)+,y0     _end
+    0x0AA981, 0x000008,     // jclr #1,x:$ffe9,*
+    0x567000, 0x00FFEB,     // move a,x:$ffeb
+    0x0C0000,               // jmp $0
+};
+
+static dsp56k_t s_dsp;
+static volatile int s_done;
+
+/** Host clock from /proc/cpuinfo, 0 if unknown */
+static double bench_host_mhz(void)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0.0;
+
+    if (!f) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "cpu MHz", 7) == 0) {
+            const char *colon = strchr(line, ':');
+            if (colon) {
+                mhz = atof(colon + 1);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    return mhz;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_load(const uint32_t *program, size_t words)
+{
+    dsp56k_config_t config = {
+        .dsp_hz = DSP56K_CLOCK_HZ,
+        .host_hz = DSP56K_HOST_HZ,
+        .ssi_rate = 48000,
+        .boot_from_host = false,
+    };
+
+    dsp56k_init(&s_dsp, &config);
+    for (size_t i = 0; i < words; i++) {
+        dsp56k_write_p(&s_dsp, (uint32_t)i, program[i]);
+    }
+    // Coefficients and samples
+    for (int i = 0; i < 32; i++) {
+        s_dsp.x_int[i] = (uint32_t)(i * 0x31415) & 0xFFFFFF;
+        s_dsp.y_int[i] = (uint32_t)(0x20000 - i * 0x1000) & 0xFFFFFF;
+    }
+    s_dsp.xy[0] = 0x123456;
+    s_dsp.m[0] = 31;
+    s_dsp.m[4] = 31;
+}
+
+/** Seconds of host time to run @p clocks of @p k, best of BENCH_PASSES */
+static double bench_run(const bench_kernel_t *k, uint64_t clocks, uint64_t *instructions)
+{
+    double best = 1e9;
+
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        bench_load(k->program, k->words);
+
+        double start = bench_now();
+        dsp56k_execute(&s_dsp, clocks);
+        double elapsed = bench_now() - start;
+
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        *instructions = s_dsp.stats.instructions;
+    }
+    return best;
+}
+
+static void *bench_core1(void *arg)
+{
+    while (!s_done) {
+        if (!dsp56k_run_async(&s_dsp)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/** Host port lock-step run, returns host seconds and the words echoed */
+static double bench_lock_step(int seconds, uint32_t *words)
+{
+    uint64_t slices = (uint64_t)seconds * DSP56K_HOST_HZ / BENCH_SLICE;
+    pthread_t thread;
+    uint32_t sent = 0, received = 0;
+
+    bench_load(s_host_fir, sizeof(s_host_fir) / sizeof(s_host_fir[0]));
+    dsp56k_start_async(&s_dsp);
+    s_done = 0;
+    if (pthread_create(&thread, NULL, bench_core1, NULL)) {
+        return 0.0;
+    }
+
+    double start = bench_now();
+    for (uint64_t i = 0; i < slices; i++) {
+        dsp56k_host_clock(&s_dsp, BENCH_SLICE);
+        if (i % BENCH_WORD_SLICES) {
+            continue;
+        }
+        uint8_t isr = dsp56k_host_read(&s_dsp, DSP56K_HOST_ISR);
+        if (isr & DSP56K_ISR_RXDF) {
+            dsp56k_host_read(&s_dsp, DSP56K_HOST_RXH);
+            dsp56k_host_read(&s_dsp, DSP56K_HOST_RXM);
+            dsp56k_host_read(&s_dsp, DSP56K_HOST_RXL);
+            received++;
+        }
+        if ((isr & DSP56K_ISR_TXDE) && sent == received) {
+            dsp56k_host_write(&s_dsp, DSP56K_HOST_RXH, (uint8_t)(sent >> 8));
+            dsp56k_host_write(&s_dsp, DSP56K_HOST_RXM, (uint8_t)sent);
+            dsp56k_host_write(&s_dsp, DSP56K_HOST_RXL, 0);
+            sent++;
+        }
+    }
+    double elapsed = bench_now() - start;
+
+    s_done = 1;
+    pthread_join(thread, NULL);
+    *words = received;
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    static const bench_kernel_t kernels[] = {
+        { "fir32",  s_fir,    sizeof(s_fir) / sizeof(s_fir[0]) },
+        { "branch", s_branch, sizeof(s_branch) / sizeof(s_branch[0]) },
+    };
+    double host_mhz = argc > 1 ? atof(argv[1]) : bench_host_mhz();
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    uint64_t clocks = (uint64_t)seconds * DSP56K_CLOCK_HZ;
+
+    if (seconds <= 0) {
+        return 1;
+    }
+
+    printf("dsp56k_bench: %d s of 32 MHz DSP time, %s (best of %d)", seconds, BENCH_VARIANT, BENCH_PASSES);
+    if (host_mhz > 0.0) {
+        printf(", host %.0f MHz\n", host_mhz);
+    } else {
+        printf(", host clock unknown (pass it as the first argument)\n");
+    }
+
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        uint64_t instructions = 0;
+        double elapsed = bench_run(&kernels[i], clocks, &instructions);
+        double s_per_s = elapsed / seconds;
+
+        printf("  %-8s %7.1f Minstr/s, %5.2fx real time", kernels[i].name,
+               instructions / elapsed / 1e6, 1.0 / s_per_s);
+        if (host_mhz > 0.0) {
+            printf(", %.1f%% of %.0f MHz", s_per_s * host_mhz / BENCH_P4_CLOCK_MHZ * 100, BENCH_P4_CLOCK_MHZ);
+        }
+        printf("\n");
+    }
+
+    uint32_t words = 0;
+    double elapsed = bench_lock_step(seconds, &words);
+    printf("  lock-step %5.2fx real time, %u host port words, %llu host waits, %llu window waits,"
+           " %llu decodes\n", seconds / elapsed, words,
+           (unsigned long long)s_dsp.stats.host_waits, (unsigned long long)s_dsp.stats.window_waits,
+           (unsigned long long)s_dsp.stats.decodes);
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        printf("  (one host CPU: both sides spin on it, the lock-step figure is not meaningful)\n");
+    }
+    return 0;
+}
@@ -0,0 +1,447 @@
+/**
+ * @file dsp56k.h
+ * @brief Motorola DSP56001 core internal state, host port and SSI
+ *
+ * The Falcon's DSP runs at 32 MHz, one instruction every two clocks, next
+ * to a 16 MHz 68030. It gets a core of its own and an interpreter that
+ * does no decoding on the hot path: every P-memory word is decoded once
+ * into a dsp56k_insn_t (handler, ALU handler, opcode, extension word,
+ * length and clocks) held in a direct-mapped cache indexed by address.
+ * A slot whose tag does not match the PC is decoded again, so a miss
+ * costs one decode. Writes that can reach P memory (MOVEM, X and Y writes
+ * to the external SRAM P is aliased to, host loads) drop the slots of the
+ * written word and of the word before it, whose extension it may be.
+ *
+ * Parallel instructions read their move sources, run the ALU half through
+ * dsp56k_alu_table, then write the move destinations, which is the
+ * order the chip's pipeline gives. N, Z, E and U are evaluated lazily from
+ * the last ALU result; V, C and L are kept in the SR as they are set.
+ *
+ * Time is counted in DSP clocks. Instructions cost the clocks of the
+ * manual's timing table without wait states.
+ *
+ * Memory is the Falcon's: 512 words of internal P RAM, 256 of X and Y RAM
+ * with the data ROMs above them, and 32K words of external SRAM that P
+ * sees whole, Y as its lower 16K and X as its upper 16K.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "component_api.h"
+
+#define DSP56K_INLINE           static inline __attribute__((always_inline))
+#define DSP56K_LIKELY(x)        __builtin_expect(!!(x), 1)
+#define DSP56K_UNLIKELY(x)      __builtin_expect(!!(x), 0)
+
+#define DSP56K_CLOCK_HZ         32000000    ///< Falcon
+#define DSP56K_HOST_HZ          16000000    ///< Falcon 68030
+
+#define DSP56K_P_INT_WORDS      512
+#define DSP56K_XY_INT_WORDS     256
+#define DSP56K_ROM_WORDS        256
+#define DSP56K_EXT_WORDS        32768       ///< Falcon DSP SRAM
+#define DSP56K_PERIPH_BASE      0xFFC0      ///< X:$FFC0-$FFFF on-chip peripherals
+
+#define DSP56K_PCACHE_WORDS     4096        ///< Decoded words, direct mapped, power of two
+#define DSP56K_PCACHE_EMPTY     (-1)
+
+#define DSP56K_STACK_DEPTH      15
+#define DSP56K_BOOT_WORDS       512         ///< Bootstrap from the host port
+#define DSP56K_SSI_SLOTS_MAX    32
+#define DSP56K_SSI_RING         4096        ///< Stereo frames each way, power of two
+
+#define DSP56K_WINDOW_DEFAULT   32000       ///< 1 ms of DSP clocks the DSP may lag the host by
+#define DSP56K_ASYNC_CHUNK      2048        ///< DSP clocks per dsp56k_run_async() call
+
+// Status register: MR in bits 15-8, CCR in 7-0
+#define DSP56K_SR_C             0x0001
+#define DSP56K_SR_V             0x0002
+#define DSP56K_SR_Z             0x0004
+#define DSP56K_SR_N             0x0008
+#define DSP56K_SR_U             0x0010
+#define DSP56K_SR_E             0x0020
+#define DSP56K_SR_L             0x0040
+#define DSP56K_SR_S             0x0080
+#define DSP56K_SR_I             0x0300      ///< Interrupt mask
+#define DSP56K_SR_I_SHIFT       8
+#define DSP56K_SR_S01           0x0C00      ///< Scaling mode, not emulated
+#define DSP56K_SR_T             0x2000
+#define DSP56K_SR_LF            0x8000
+#define DSP56K_SR_LAZY          (DSP56K_SR_N | DSP56K_SR_Z | DSP56K_SR_E | DSP56K_SR_U)
+
+#define DSP56K_OMR_DE           0x04        ///< Data ROMs enabled
+
+// Stack pointer register
+#define DSP56K_SP_PTR           0x0F
+#define DSP56K_SP_SE            0x10        ///< Stack error
+#define DSP56K_SP_UF            0x20        ///< Underflow
+
+// Interrupt vectors, P-memory addresses
+#define DSP56K_VEC_RESET        0x00
+#define DSP56K_VEC_STACK        0x02
+#define DSP56K_VEC_SWI          0x06
+#define DSP56K_VEC_SSI_RX       0x0C
+#define DSP56K_VEC_SSI_RX_EXC   0x0E
+#define DSP56K_VEC_SSI_TX       0x10
+#define DSP56K_VEC_SSI_TX_EXC   0x12
+#define DSP56K_VEC_HOST_RX      0x20
+#define DSP56K_VEC_HOST_TX      0x22
+#define DSP56K_VEC_HOST_CMD     0x24        ///< Reset value of the host vector
+#define DSP56K_VEC_ILLEGAL      0x3E
+
+// Peripheral registers, X memory
+#define DSP56K_PCC              0xFFE1
+#define DSP56K_HCR              0xFFE8
+#define DSP56K_HSR              0xFFE9
+#define DSP56K_HRX              0xFFEB      ///< HTX when written
+#define DSP56K_CRA              0xFFEC
+#define DSP56K_CRB              0xFFED
+#define DSP56K_SSISR            0xFFEE      ///< TSR when written
+#define DSP56K_SSI_RX           0xFFEF      ///< TX when written
+#define DSP56K_IPR              0xFFFF
+
+// HCR and HSR bits
+#define DSP56K_HCR_HRIE         0x01
+#define DSP56K_HCR_HTIE         0x02
+#define DSP56K_HCR_HCIE         0x04
+#define DSP56K_HCR_HF2          0x08
+#define DSP56K_HCR_HF3          0x10
+#define DSP56K_HSR_HRDF         0x01
+#define DSP56K_HSR_HTDE         0x02
+#define DSP56K_HSR_HCP          0x04
+#define DSP56K_HSR_HF0          0x08
+#define DSP56K_HSR_HF1          0x10
+
+// Host side registers, byte offsets from $FFFFA200 on the Falcon
+#define DSP56K_HOST_ICR         0
+#define DSP56K_HOST_CVR         1
+#define DSP56K_HOST_ISR         2
+#define DSP56K_HOST_IVR         3
+#define DSP56K_HOST_RXH         5           ///< TXH when written
+#define DSP56K_HOST_RXM         6
+#define DSP56K_HOST_RXL         7
+
+#define DSP56K_ICR_RREQ         0x01
+#define DSP56K_ICR_TREQ         0x02
+#define DSP56K_ICR_HF0          0x08
+#define DSP56K_ICR_HF1          0x10
+#define DSP56K_ICR_INIT         0x80
+#define DSP56K_CVR_HV           0x1F
+#define DSP56K_CVR_HC           0x80
+#define DSP56K_ISR_RXDF         0x01
+#define DSP56K_ISR_TXDE         0x02
+#define DSP56K_ISR_TRDY         0x04
+#define DSP56K_ISR_HF2          0x08
+#define DSP56K_ISR_HF3          0x10
+#define DSP56K_ISR_HREQ         0x80
+
+// SSI control and status bits
+#define DSP56K_CRA_DC_SHIFT     8
+#define DSP56K_CRA_DC_MASK      0x1F
+#define DSP56K_CRA_WL_SHIFT     13
+#define DSP56K_CRB_TE           0x1000
+#define DSP56K_CRB_RE           0x2000
+#define DSP56K_CRB_TIE          0x4000
+#define DSP56K_CRB_RIE          0x8000
+#define DSP56K_SSISR_TFS        0x04
+#define DSP56K_SSISR_RFS        0x08
+#define DSP56K_SSISR_TUE        0x10
+#define DSP56K_SSISR_ROE        0x20
+#define DSP56K_SSISR_TDE        0x40
+#define DSP56K_SSISR_RDF        0x80
+
+/**
+ * @brief Interrupt sources, highest priority first within a level
+ */
+enum {
+    DSP56K_IRQ_HOST_CMD = 0,
+    DSP56K_IRQ_HOST_RX,
+    DSP56K_IRQ_HOST_TX,
+    DSP56K_IRQ_SSI_RX_EXC,
+    DSP56K_IRQ_SSI_RX,
+    DSP56K_IRQ_SSI_TX_EXC,
+    DSP56K_IRQ_SSI_TX,
+    DSP56K_IRQ_COUNT
+};
+
+typedef struct dsp56k dsp56k_t;
+typedef struct dsp56k_insn dsp56k_insn_t;
+
+typedef void (*dsp56k_handler_t)(dsp56k_t *dsp, const dsp56k_insn_t *insn);
+typedef void (*dsp56k_alu_t)(dsp56k_t *dsp, uint32_t op);
+
+/**
+ * @brief One decoded P-memory word
+ */
+struct dsp56k_insn {
+    dsp56k_handler_t run;
+    dsp56k_alu_t alu;           ///< ALU half of a parallel instruction
+    uint32_t op;
+    uint32_t ext;               ///< Second word, if any
+    int32_t tag;                ///< P address decoded here, DSP56K_PCACHE_EMPTY if none
+    uint8_t words;
+    uint8_t clocks;
+};
+
+typedef struct {
+    uint32_t dsp_hz;
+    uint32_t host_hz;           ///< Clock of the cycles given to dsp56k_host_clock()
+    uint32_t ssi_rate;          ///< SSI frames per second, from the Falcon crossbar
+    uint32_t window;            ///< DSP clocks the DSP may fall behind before the host waits
+    bool boot_from_host;        ///< Reset loads P:$0000 from the host port
+} dsp56k_config_t;
+
+typedef struct {
+    uint64_t instructions;
+    uint64_t decodes;           ///< Cache slots filled
+    uint64_t invalidations;     ///< Cached slots dropped by writes to P memory
+    uint64_t interrupts;
+    uint64_t ssi_frames;
+    uint64_t ssi_underruns;     ///< Frames generate() found no output for
+    uint64_t host_waits;        ///< Host accesses that had to wait for the DSP
+    uint64_t window_waits;      ///< dsp56k_host_clock() calls that waited
+} dsp56k_stats_t;
+
+struct dsp56k {
+    // Data ALU
+    uint32_t xy[4];             ///< X0, X1, Y0, Y1
+    int64_t acc[2];             ///< A, B, 56 bits sign-extended
+    int64_t lazy_res;           ///< Result N, Z, E and U are due from
+    bool lazy;
+
+    // Address generation
+    uint16_t r[8];
+    uint16_t n[8];
+    uint16_t m[8];
+
+    // Program control
+    uint32_t pc;
+    uint16_t sr;
+    uint8_t omr;
+    uint8_t sp;
+    uint16_t la;
+    uint16_t lc;
+    uint16_t ssh[DSP56K_STACK_DEPTH + 1];
+    uint16_t ssl[DSP56K_STACK_DEPTH + 1];
+    uint32_t loop_next;         ///< LA + 1 while LF is set, out of range otherwise
+
+    uint64_t cycle;             ///< DSP clocks since reset
+    uint64_t service_at;        ///< Cycle of the next event or pending interrupt check
+    uint64_t stop_at;           ///< Instructions run while cycle is below this
+    bool stopped;               ///< WAIT or STOP, until an interrupt
+    bool booting;
+    uint16_t boot_count;
+
+    // Interrupts
+    uint32_t pending;           ///< 1 << DSP56K_IRQ_*, conditions currently asserted
+    uint8_t host_vector;        ///< Vector of the pending host command
+
+    // Memory
+    uint32_t p_int[DSP56K_P_INT_WORDS];
+    uint32_t x_int[DSP56K_XY_INT_WORDS];
+    uint32_t y_int[DSP56K_XY_INT_WORDS];
+    uint32_t ext[DSP56K_EXT_WORDS];
+    uint32_t periph[64];        ///< X:$FFC0-$FFFF as last written
+
+    // Host interface
+    uint32_t hrx;               ///< DSP receive register
+    uint32_t htx;               ///< DSP transmit register
+    uint8_t hcr;
+    uint8_t hsr;
+    uint8_t icr;
+    uint8_t cvr;
+    uint8_t isr;
+    uint8_t ivr;
+    uint8_t tx[3];              ///< Host TXH, TXM, TXL
+    uint8_t rx[3];              ///< Host RXH, RXM, RXL
+
+    // SSI
+    uint32_t cra;
+    uint32_t crb;
+    uint8_t ssisr;
+    uint32_t ssi_tx;
+    uint32_t ssi_rx;
+    uint32_t ssi_shift;         ///< Last word sent, repeated on underrun
+    uint32_t ssi_slot;          ///< Slot of the frame due next
+    uint64_t ssi_slots;         ///< Slots since the SSI was configured
+    uint64_t ssi_base;          ///< Cycle slot 0 of the count was due
+    uint64_t ssi_next;          ///< Cycle of the next slot, UINT64_MAX when off
+    int16_t ssi_frame[2];       ///< Slots 0 and 1 of the frame being sent
+    int16_t ssi_in[2];
+
+    int16_t out_ring[DSP56K_SSI_RING][2];   ///< DSP to generate(), SPSC
+    uint32_t out_head;          ///< __atomic, written by the DSP
+    uint32_t out_tail;          ///< __atomic, written by generate()
+    int16_t in_ring[DSP56K_SSI_RING][2];    ///< dsp56k_ssi_feed() to the DSP, SPSC
+    uint32_t in_head;           ///< __atomic, written by the host
+    uint32_t in_tail;           ///< __atomic, written by the DSP
+
+    // Lock-step with the host CPU
+    dsp56k_config_t config;
+    uint64_t host_time;         ///< DSP clocks the host CPU has reached
+    uint64_t host_frac;         ///< Remainder of the conversion, in host_hz units
+    uint64_t horizon;           ///< __atomic, the DSP runs up to here
+    uint64_t dsp_time;          ///< __atomic, cycle published by the DSP
+    bool async;                 ///< Another core calls dsp56k_run_async()
+
+    dsp56k_stats_t stats;
+    dsp56k_insn_t pcache[DSP56K_PCACHE_WORDS];
+};
+
+/** ALU half of parallel instructions, one per opcode low byte */
+extern const dsp56k_alu_t dsp56k_alu_table[256];
+
+/** Generated by tools/dsp56k_gen.py */
+extern const uint32_t dsp56k_rom_x[DSP56K_ROM_WORDS];
+extern const uint32_t dsp56k_rom_y[DSP56K_ROM_WORDS];
+
+void dsp56k_init(dsp56k_t *dsp, const dsp56k_config_t *config);
+void dsp56k_reset(dsp56k_t *dsp);
+
+/**
+ * @brief Run until dsp->cycle reaches @p until
+ *
+ * The last instruction may overshoot. Single-threaded callers use this
+ * directly; dsp56k_host_clock() and dsp56k_run_async() wrap it.
+ */
+void dsp56k_execute(dsp56k_t *dsp, uint64_t until);
+
+// Decode cache (dsp56k_pcache.c)
+const dsp56k_insn_t *dsp56k_decode(dsp56k_t *dsp, uint32_t pc);
+void dsp56k_pcache_flush(dsp56k_t *dsp);
+void dsp56k_p_written(dsp56k_t *dsp, uint32_t addr);
+
+// Decoder and the handlers the core needs to recognise (dsp56k_ops.c)
+void dsp56k_decode_op(dsp56k_insn_t *insn, uint32_t op, uint32_t ext);
+void dsp56k_illegal(dsp56k_t *dsp, const dsp56k_insn_t *insn);
+void dsp56k_op_jsr(dsp56k_t *dsp, const dsp56k_insn_t *insn);
+void dsp56k_op_jsr_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn);
+
+// Program control (dsp56k_core.c)
+void dsp56k_push(dsp56k_t *dsp, uint16_t hi, uint16_t lo);
+void dsp56k_pop(dsp56k_t *dsp, uint16_t *hi, uint16_t *lo);
+void dsp56k_set_sr(dsp56k_t *dsp, uint16_t sr);
+uint16_t dsp56k_get_sr(dsp56k_t *dsp);
+void dsp56k_interrupt(dsp56k_t *dsp, uint32_t vector, int level);
+void dsp56k_loop_end(dsp56k_t *dsp);
+
+// Memory (dsp56k_core.c)
+uint32_t dsp56k_read_x(dsp56k_t *dsp, uint32_t addr);
+uint32_t dsp56k_read_y(dsp56k_t *dsp, uint32_t addr);
+uint32_t dsp56k_read_p(dsp56k_t *dsp, uint32_t addr);
+void dsp56k_write_x(dsp56k_t *dsp, uint32_t addr, uint32_t val);
+void dsp56k_write_y(dsp56k_t *dsp, uint32_t addr, uint32_t val);
+void dsp56k_write_p(dsp56k_t *dsp, uint32_t addr, uint32_t val);
+
+// Peripherals, DSP side (dsp56k_periph.c)
+uint32_t dsp56k_periph_read(dsp56k_t *dsp, uint32_t addr);
+void dsp56k_periph_write(dsp56k_t *dsp, uint32_t addr, uint32_t val);
+void dsp56k_periph_event(dsp56k_t *dsp);
+void dsp56k_periph_reset(dsp56k_t *dsp);
+void dsp56k_irq_update(dsp56k_t *dsp);
+
+// Host side of the host port, SSI audio (dsp56k_periph.c)
+uint8_t dsp56k_host_read(dsp56k_t *dsp, uint32_t reg);
+void dsp56k_host_write(dsp56k_t *dsp, uint32_t reg, uint8_t val);
+int dsp56k_ssi_generate(dsp56k_t *dsp, int16_t *out, int frames);
+int dsp56k_ssi_feed(dsp56k_t *dsp, const int16_t *in, int frames);
+
+// Lock-step with the host CPU (dsp56k_sync.c)
+void dsp56k_host_clock(dsp56k_t *dsp, int host_cycles);
+void dsp56k_host_sync(dsp56k_t *dsp);
+void dsp56k_start_async(dsp56k_t *dsp);
+int dsp56k_run_async(dsp56k_t *dsp);
+
+// ---------------------------------------------------------------------------
+// Register helpers
+// ---------------------------------------------------------------------------
+
+DSP56K_INLINE int64_t dsp56k_sx56(int64_t v)
+{
+    return (int64_t)((uint64_t)v << 8) >> 8;
+}
+
+DSP56K_INLINE int32_t dsp56k_sx24(uint32_t v)
+{
+    return (int32_t)(v << 8) >> 8;
+}
+
+/** Value of a 24-bit register placed in A1, as the ALU sees it */
+DSP56K_INLINE int64_t dsp56k_acc_of24(uint32_t v)
+{
+    return (int64_t)dsp56k_sx24(v) * (1LL << 24);
+}
+
+/** Resolve the lazily kept N, Z, E and U into dsp->sr */
+DSP56K_INLINE void dsp56k_flags(dsp56k_t *dsp)
+{
+    if (dsp->lazy) {
+        int64_t r = dsp->lazy_res;
+        int64_t top = r >> 47;
+        uint16_t sr = dsp->sr & (uint16_t)~DSP56K_SR_LAZY;
+
+        if (r == 0) {
+            sr |= DSP56K_SR_Z;
+        }
+        if (r < 0) {
+            sr |= DSP56K_SR_N;
+        }
+        if (top != 0 && top != -1) {
+            sr |= DSP56K_SR_E;
+        }
+        if (((r >> 46) ^ (r >> 47)) & 1) {
+            // Normalized
+        } else {
+            sr |= DSP56K_SR_U;
+        }
+        dsp->sr = sr;
+        dsp->lazy = false;
+    }
+}
+
+/**
+ * @brief Accumulator as a 24-bit move source, limited if it does not fit in 48 bits
+ */
+DSP56K_INLINE uint32_t dsp56k_acc_limit24(dsp56k_t *dsp, int64_t v)
+{
+    int64_t top = v >> 47;
+
+    if (DSP56K_UNLIKELY(top != 0 && top != -1)) {
+        dsp->sr |= DSP56K_SR_L;
+        return v < 0 ? 0x800000 : 0x7FFFFF;
+    }
+    return (uint32_t)(v >> 24) & 0xFFFFFF;
+}
+
+/**
+ * @brief Decoded instruction at @p pc, decoding it on a miss
+ *
+ * DSP56K_DECODE_ALWAYS decodes every time, the baseline the bench compares
+ * the cache against.
+ */
+DSP56K_INLINE const dsp56k_insn_t *dsp56k_lookup(dsp56k_t *dsp, uint32_t pc)
+{
+#ifndef DSP56K_DECODE_ALWAYS
+    const dsp56k_insn_t *insn = &dsp->pcache[pc & (DSP56K_PCACHE_WORDS - 1)];
+
+    if (DSP56K_LIKELY(insn->tag == (int32_t)pc)) {
+        return insn;
+    }
+#endif
+    return dsp56k_decode(dsp, pc);
+}
+
+/** Mark the SR or an interrupt condition changed: re-evaluate before the next instruction */
+DSP56K_INLINE void dsp56k_service_now(dsp56k_t *dsp)
+{
+    dsp->service_at = 0;
+    dsp->stop_at = 0;
+}
+
+DSP56K_INLINE void dsp56k_loop_update(dsp56k_t *dsp)
+{
+    dsp->loop_next = (dsp->sr & DSP56K_SR_LF) ? (uint32_t)dsp->la + 1 : 0x20000;
+}
@@ -0,0 +1,435 @@
+/**
+ * @file dsp56k_alu.c
+ * @brief Data ALU half of parallel instructions
+ *
+ * The low byte of a parallel instruction selects the operation, its
+ * source and, in bit 3, the destination accumulator. Each byte maps to
+ * its own function so the source is known at compile time; the move half
+ * calls it between reading and writing its operands.
+ *
+ * Accumulators are kept sign-extended from bit 55. Results that do not
+ * fit set V and L; N, Z, E and U are left to dsp56k_flags().
+ */
+
+#include "dsp56k.h"
+
+#define ACC_D(op)       (((op) >> 3) & 1)
+#define MASK56          0x00FFFFFFFFFFFFFFULL
+#define A1_MASK         (0xFFFFFFLL << 24)
+
+static inline void alu_set(dsp56k_t *dsp, int d, int64_t r)
+{
+    dsp->acc[d] = r;
+    dsp->lazy_res = r;
+    dsp->lazy = true;
+}
+
+/** V and L if @p r overflowed 56 bits, V cleared otherwise */
+static inline uint16_t alu_v(uint16_t sr, int64_t r)
+{
+    sr &= ~DSP56K_SR_V;
+    if (r != dsp56k_sx56(r)) {
+        sr |= DSP56K_SR_V | DSP56K_SR_L;
+    }
+    return sr;
+}
+
+/** @p a + @p s + carry with C and V, stored to D unless it is a compare */
+static inline void alu_add(dsp56k_t *dsp, int d, int64_t a, int64_t s, int carry)
+{
+    int64_t r = a + s + carry;
+    uint16_t sr = alu_v(dsp->sr, r) & ~DSP56K_SR_C;
+
+    if ((((uint64_t)a & MASK56) + ((uint64_t)s & MASK56) + (uint64_t)carry) >> 56) {
+        sr |= DSP56K_SR_C;
+    }
+    dsp->sr = sr;
+    alu_set(dsp, d, dsp56k_sx56(r));
+}
+
+static inline int64_t alu_sub_flags(dsp56k_t *dsp, int64_t a, int64_t s, int borrow)
+{
+    int64_t r = a - s - borrow;
+    uint16_t sr = alu_v(dsp->sr, r) & ~DSP56K_SR_C;
+
+    if (((uint64_t)a & MASK56) < ((uint64_t)s & MASK56) + (uint64_t)borrow) {
+        sr |= DSP56K_SR_C;
+    }
+    dsp->sr = sr;
+    return dsp56k_sx56(r);
+}
+
+static inline void alu_sub(dsp56k_t *dsp, int d, int64_t a, int64_t s, int borrow)
+{
+    alu_set(dsp, d, alu_sub_flags(dsp, a, s, borrow));
+}
+
+static inline void alu_cmp(dsp56k_t *dsp, int64_t a, int64_t s)
+{
+    dsp->lazy_res = alu_sub_flags(dsp, a, s, 0);
+    dsp->lazy = true;
+}
+
+/** Convergent rounding to A1 */
+static inline int64_t alu_round(int64_t r)
+{
+    int64_t t = r + 0x800000;
+
+    if ((r & 0xFFFFFF) == 0x800000) {
+        t &= ~0x1000000LL;
+    }
+    return t & ~0xFFFFFFLL;
+}
+
+/** Logical result in A1: N and Z from it, V cleared, C as given */
+static inline void alu_logic(dsp56k_t *dsp, int d, uint32_t a1, uint16_t c_mask, uint16_t c)
+{
+    uint16_t sr;
+
+    dsp56k_flags(dsp);
+    a1 &= 0xFFFFFF;
+    dsp->acc[d] = (dsp->acc[d] & ~A1_MASK) | ((int64_t)a1 << 24);
+    sr = dsp->sr & ~(DSP56K_SR_N | DSP56K_SR_Z | DSP56K_SR_V | c_mask);
+    if (a1 & 0x800000) {
+        sr |= DSP56K_SR_N;
+    }
+    if (a1 == 0) {
+        sr |= DSP56K_SR_Z;
+    }
+    dsp->sr = sr | c;
+}
+
+static inline uint32_t alu_a1(dsp56k_t *dsp, int d)
+{
+    return (uint32_t)(dsp->acc[d] >> 24) & 0xFFFFFF;
+}
+
+static inline int64_t alu_abs(int64_t v)
+{
+    return v < 0 ? -v : v;
+}
+
+/** X1:X0 or Y1:Y0 as a 48-bit operand */
+static inline int64_t alu_long(uint32_t hi, uint32_t lo)
+{
+    return dsp56k_acc_of24(hi) | lo;
+}
+
+static inline int64_t alu_product(uint32_t s1, uint32_t s2, uint32_t op)
+{
+    int64_t p = (int64_t)dsp56k_sx24(s1) * dsp56k_sx24(s2) * 2;
+
+    return (op & 4) ? -p : p;
+}
+
+// ---------------------------------------------------------------------------
+// JJJ = 000 and 001: accumulator with accumulator
+// ---------------------------------------------------------------------------
+
+static void alu_move(dsp56k_t *dsp, uint32_t op)
+{
+}
+
+static void alu_tfr_acc(dsp56k_t *dsp, uint32_t op)
+{
+    dsp->acc[ACC_D(op)] = dsp->acc[ACC_D(op) ^ 1];
+}
+
+static void alu_addr(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+
+    alu_add(dsp, d, dsp->acc[d] >> 1, dsp->acc[d ^ 1], 0);
+}
+
+static void alu_tst(dsp56k_t *dsp, uint32_t op)
+{
+    dsp->sr &= ~DSP56K_SR_V;
+    dsp->lazy_res = dsp->acc[ACC_D(op)];
+    dsp->lazy = true;
+}
+
+static void alu_cmp_acc(dsp56k_t *dsp, uint32_t op)
+{
+    alu_cmp(dsp, dsp->acc[ACC_D(op)], dsp->acc[ACC_D(op) ^ 1]);
+}
+
+static void alu_subr(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+
+    alu_sub(dsp, d, dsp->acc[d] >> 1, dsp->acc[d ^ 1], 0);
+}
+
+static void alu_cmpm_acc(dsp56k_t *dsp, uint32_t op)
+{
+    alu_cmp(dsp, alu_abs(dsp->acc[ACC_D(op)]), alu_abs(dsp->acc[ACC_D(op) ^ 1]));
+}
+
+static void alu_add_acc(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+
+    alu_add(dsp, d, dsp->acc[d], dsp->acc[d ^ 1], 0);
+}
+
+static void alu_rnd(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+    int64_t r = alu_round(dsp->acc[d]);
+
+    dsp->sr = alu_v(dsp->sr, r);
+    alu_set(dsp, d, dsp56k_sx56(r));
+}
+
+static void alu_addl(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+
+    alu_add(dsp, d, dsp->acc[d] * 2, dsp->acc[d ^ 1], 0);
+}
+
+static void alu_clr(dsp56k_t *dsp, uint32_t op)
+{
+    dsp->sr &= ~DSP56K_SR_V;
+    alu_set(dsp, ACC_D(op), 0);
+}
+
+static void alu_sub_acc(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+
+    alu_sub(dsp, d, dsp->acc[d], dsp->acc[d ^ 1], 0);
+}
+
+static void alu_subl(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+
+    alu_sub(dsp, d, dsp->acc[d] * 2, dsp->acc[d ^ 1], 0);
+}
+
+static void alu_not(dsp56k_t *dsp, uint32_t op)
+{
+    alu_logic(dsp, ACC_D(op), ~alu_a1(dsp, ACC_D(op)), 0, 0);
+}
+
+// ---------------------------------------------------------------------------
+// JJJ = 010 and 011: X or Y as a long source, shifts and sign
+// ---------------------------------------------------------------------------
+
+#define ALU_LONG(name, hi, lo) \
+    static void alu_add_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_add(dsp, ACC_D(op), dsp->acc[ACC_D(op)], alu_long(dsp->xy[hi], dsp->xy[lo]), 0); \
+    } \
+    static void alu_adc_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_add(dsp, ACC_D(op), dsp->acc[ACC_D(op)], alu_long(dsp->xy[hi], dsp->xy[lo]), \
+                dsp->sr & DSP56K_SR_C); \
+    } \
+    static void alu_sub_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_sub(dsp, ACC_D(op), dsp->acc[ACC_D(op)], alu_long(dsp->xy[hi], dsp->xy[lo]), 0); \
+    } \
+    static void alu_sbc_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_sub(dsp, ACC_D(op), dsp->acc[ACC_D(op)], alu_long(dsp->xy[hi], dsp->xy[lo]), \
+                dsp->sr & DSP56K_SR_C); \
+    }
+
+ALU_LONG(x, 1, 0)
+ALU_LONG(y, 3, 2)
+
+static void alu_asr(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+    int64_t v = dsp->acc[d];
+
+    dsp->sr = (dsp->sr & ~(DSP56K_SR_C | DSP56K_SR_V)) | (uint16_t)(v & 1);
+    alu_set(dsp, d, v >> 1);
+}
+
+static void alu_asl(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+    int64_t v = dsp->acc[d];
+    int64_t r = dsp56k_sx56(v * 2);
+    uint16_t sr = dsp->sr & ~(DSP56K_SR_C | DSP56K_SR_V);
+
+    if (v < 0) {
+        sr |= DSP56K_SR_C;
+    }
+    if ((v ^ r) < 0) {
+        sr |= DSP56K_SR_V | DSP56K_SR_L;
+    }
+    dsp->sr = sr;
+    alu_set(dsp, d, r);
+}
+
+static void alu_lsr(dsp56k_t *dsp, uint32_t op)
+{
+    uint32_t a1 = alu_a1(dsp, ACC_D(op));
+
+    alu_logic(dsp, ACC_D(op), a1 >> 1, DSP56K_SR_C, a1 & 1);
+}
+
+static void alu_lsl(dsp56k_t *dsp, uint32_t op)
+{
+    uint32_t a1 = alu_a1(dsp, ACC_D(op));
+
+    alu_logic(dsp, ACC_D(op), a1 << 1, DSP56K_SR_C, (a1 >> 23) & 1);
+}
+
+static void alu_ror(dsp56k_t *dsp, uint32_t op)
+{
+    uint32_t a1 = alu_a1(dsp, ACC_D(op));
+
+    alu_logic(dsp, ACC_D(op), (a1 >> 1) | ((uint32_t)(dsp->sr & DSP56K_SR_C) << 23), DSP56K_SR_C, a1 & 1);
+}
+
+static void alu_rol(dsp56k_t *dsp, uint32_t op)
+{
+    uint32_t a1 = alu_a1(dsp, ACC_D(op));
+
+    alu_logic(dsp, ACC_D(op), (a1 << 1) | (dsp->sr & DSP56K_SR_C), DSP56K_SR_C, (a1 >> 23) & 1);
+}
+
+static void alu_abs_acc(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+    int64_t r = alu_abs(dsp->acc[d]);
+
+    dsp->sr = alu_v(dsp->sr, r);
+    alu_set(dsp, d, dsp56k_sx56(r));
+}
+
+static void alu_neg(dsp56k_t *dsp, uint32_t op)
+{
+    int d = ACC_D(op);
+    int64_t r = -dsp->acc[d];
+
+    dsp->sr = alu_v(dsp->sr, r);
+    alu_set(dsp, d, dsp56k_sx56(r));
+}
+
+// ---------------------------------------------------------------------------
+// JJJ = 1xx: X0, Y0, X1 or Y1 in A1
+// ---------------------------------------------------------------------------
+
+#define ALU_WORD(name, reg) \
+    static void alu_add_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_add(dsp, ACC_D(op), dsp->acc[ACC_D(op)], dsp56k_acc_of24(dsp->xy[reg]), 0); \
+    } \
+    static void alu_tfr_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        dsp->acc[ACC_D(op)] = dsp56k_acc_of24(dsp->xy[reg]); \
+    } \
+    static void alu_or_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_logic(dsp, ACC_D(op), alu_a1(dsp, ACC_D(op)) | dsp->xy[reg], 0, 0); \
+    } \
+    static void alu_eor_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_logic(dsp, ACC_D(op), alu_a1(dsp, ACC_D(op)) ^ dsp->xy[reg], 0, 0); \
+    } \
+    static void alu_sub_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_sub(dsp, ACC_D(op), dsp->acc[ACC_D(op)], dsp56k_acc_of24(dsp->xy[reg]), 0); \
+    } \
+    static void alu_cmp_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_cmp(dsp, dsp->acc[ACC_D(op)], dsp56k_acc_of24(dsp->xy[reg])); \
+    } \
+    static void alu_and_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_logic(dsp, ACC_D(op), alu_a1(dsp, ACC_D(op)) & dsp->xy[reg], 0, 0); \
+    } \
+    static void alu_cmpm_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        alu_cmp(dsp, alu_abs(dsp->acc[ACC_D(op)]), alu_abs(dsp56k_acc_of24(dsp->xy[reg]))); \
+    }
+
+ALU_WORD(x0, 0)
+ALU_WORD(y0, 2)
+ALU_WORD(x1, 1)
+ALU_WORD(y1, 3)
+
+// ---------------------------------------------------------------------------
+// Multiplies: QQQ picks the pair, bit 2 negates, bits 1-0 the operation.
+// MPY and MAC leave C alone.
+// ---------------------------------------------------------------------------
+
+#define ALU_MUL(name, s1, s2) \
+    static void alu_mpy_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        dsp->sr &= ~DSP56K_SR_V; \
+        alu_set(dsp, ACC_D(op), alu_product(dsp->xy[s1], dsp->xy[s2], op)); \
+    } \
+    static void alu_mpyr_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        int64_t r = alu_round(alu_product(dsp->xy[s1], dsp->xy[s2], op)); \
+        dsp->sr = alu_v(dsp->sr, r); \
+        alu_set(dsp, ACC_D(op), dsp56k_sx56(r)); \
+    } \
+    static void alu_mac_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        int64_t r = dsp->acc[ACC_D(op)] + alu_product(dsp->xy[s1], dsp->xy[s2], op); \
+        dsp->sr = alu_v(dsp->sr, r); \
+        alu_set(dsp, ACC_D(op), dsp56k_sx56(r)); \
+    } \
+    static void alu_macr_##name(dsp56k_t *dsp, uint32_t op) \
+    { \
+        int64_t r = alu_round(dsp->acc[ACC_D(op)] + alu_product(dsp->xy[s1], dsp->xy[s2], op)); \
+        dsp->sr = alu_v(dsp->sr, r); \
+        alu_set(dsp, ACC_D(op), dsp56k_sx56(r)); \
+    }
+
+ALU_MUL(x0x0, 0, 0)
+ALU_MUL(y0y0, 2, 2)
+ALU_MUL(x1x0, 1, 0)
+ALU_MUL(y1y0, 3, 2)
+ALU_MUL(x0y1, 0, 3)
+ALU_MUL(y0x0, 2, 0)
+ALU_MUL(x1y0, 1, 2)
+ALU_MUL(y1x1, 3, 1)
+
+// ---------------------------------------------------------------------------
+// Table
+// ---------------------------------------------------------------------------
+
+/** Both destinations of byte @p b */
+#define ALU2(b, fn)     [(b)] = (fn), [(b) | 8] = (fn)
+
+#define ALU_MUL_ROW(q, name) \
+    ALU2(0x80 | ((q) << 4), alu_mpy_##name), ALU2(0x84 | ((q) << 4), alu_mpy_##name), \
+    ALU2(0x81 | ((q) << 4), alu_mpyr_##name), ALU2(0x85 | ((q) << 4), alu_mpyr_##name), \
+    ALU2(0x82 | ((q) << 4), alu_mac_##name), ALU2(0x86 | ((q) << 4), alu_mac_##name), \
+    ALU2(0x83 | ((q) << 4), alu_macr_##name), ALU2(0x87 | ((q) << 4), alu_macr_##name)
+
+#define ALU_WORD_ROW(j, name) \
+    ALU2(0x40 | ((j) << 4), alu_add_##name), ALU2(0x41 | ((j) << 4), alu_tfr_##name), \
+    ALU2(0x42 | ((j) << 4), alu_or_##name), ALU2(0x43 | ((j) << 4), alu_eor_##name), \
+    ALU2(0x44 | ((j) << 4), alu_sub_##name), ALU2(0x45 | ((j) << 4), alu_cmp_##name), \
+    ALU2(0x46 | ((j) << 4), alu_and_##name), ALU2(0x47 | ((j) << 4), alu_cmpm_##name)
+
+const dsp56k_alu_t dsp56k_alu_table[256] = {
+    [0x00] = alu_move,
+    ALU2(0x01, alu_tfr_acc), ALU2(0x02, alu_addr), ALU2(0x03, alu_tst),
+    ALU2(0x05, alu_cmp_acc), ALU2(0x06, alu_subr), ALU2(0x07, alu_cmpm_acc),
+
+    ALU2(0x10, alu_add_acc), ALU2(0x11, alu_rnd), ALU2(0x12, alu_addl), ALU2(0x13, alu_clr),
+    ALU2(0x14, alu_sub_acc), ALU2(0x16, alu_subl), ALU2(0x17, alu_not),
+
+    ALU2(0x20, alu_add_x), ALU2(0x21, alu_adc_x), ALU2(0x22, alu_asr), ALU2(0x23, alu_lsr),
+    ALU2(0x24, alu_sub_x), ALU2(0x25, alu_sbc_x), ALU2(0x26, alu_abs_acc), ALU2(0x27, alu_ror),
+
+    ALU2(0x30, alu_add_y), ALU2(0x31, alu_adc_y), ALU2(0x32, alu_asl), ALU2(0x33, alu_lsl),
+    ALU2(0x34, alu_sub_y), ALU2(0x35, alu_sbc_y), ALU2(0x36, alu_neg), ALU2(0x37, alu_rol),
+
+    ALU_WORD_ROW(0, x0), ALU_WORD_ROW(1, y0), ALU_WORD_ROW(2, x1), ALU_WORD_ROW(3, y1),
+
+    ALU_MUL_ROW(0, x0x0), ALU_MUL_ROW(1, y0y0), ALU_MUL_ROW(2, x1x0), ALU_MUL_ROW(3, y1y0),
+    ALU_MUL_ROW(4, x0y1), ALU_MUL_ROW(5, y0x0), ALU_MUL_ROW(6, x1y0), ALU_MUL_ROW(7, y1x1),
+};
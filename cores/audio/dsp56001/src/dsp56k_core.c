@@ -0,0 +1,337 @@
+/**
+ * @file dsp56k_core.c
+ * @brief DSP56001 memory map, program control and the run loop
+ */
+
+#include <string.h>
+#include "dsp56k.h"
+
+// ---------------------------------------------------------------------------
+// Memory map
+// ---------------------------------------------------------------------------
+
+/** External SRAM word @p e was written: drop the P addresses it backs */
+static void dsp56k_ext_written(dsp56k_t *dsp, uint32_t e)
+{
+    if (e >= DSP56K_P_INT_WORDS) {
+        dsp56k_p_written(dsp, e);
+    }
+    dsp56k_p_written(dsp, e | 0x8000);
+}
+
+uint32_t dsp56k_read_x(dsp56k_t *dsp, uint32_t addr)
+{
+    if (addr < DSP56K_XY_INT_WORDS) {
+        return dsp->x_int[addr];
+    }
+    if (addr < DSP56K_XY_INT_WORDS + DSP56K_ROM_WORDS && (dsp->omr & DSP56K_OMR_DE)) {
+        return dsp56k_rom_x[addr - DSP56K_XY_INT_WORDS];
+    }
+    if (addr >= DSP56K_PERIPH_BASE) {
+        return dsp56k_periph_read(dsp, addr);
+    }
+    return dsp->ext[(addr & 0x3FFF) | 0x4000];
+}
+
+uint32_t dsp56k_read_y(dsp56k_t *dsp, uint32_t addr)
+{
+    if (addr < DSP56K_XY_INT_WORDS) {
+        return dsp->y_int[addr];
+    }
+    if (addr < DSP56K_XY_INT_WORDS + DSP56K_ROM_WORDS && (dsp->omr & DSP56K_OMR_DE)) {
+        return dsp56k_rom_y[addr - DSP56K_XY_INT_WORDS];
+    }
+    return dsp->ext[addr & 0x3FFF];
+}
+
+uint32_t dsp56k_read_p(dsp56k_t *dsp, uint32_t addr)
+{
+    if (addr < DSP56K_P_INT_WORDS) {
+        return dsp->p_int[addr];
+    }
+    return dsp->ext[addr & 0x7FFF];
+}
+
+void dsp56k_write_x(dsp56k_t *dsp, uint32_t addr, uint32_t val)
+{
+    val &= 0xFFFFFF;
+    if (addr < DSP56K_XY_INT_WORDS) {
+        dsp->x_int[addr] = val;
+    } else if (addr < DSP56K_XY_INT_WORDS + DSP56K_ROM_WORDS && (dsp->omr & DSP56K_OMR_DE)) {
+        // ROM
+    } else if (addr >= DSP56K_PERIPH_BASE) {
+        dsp56k_periph_write(dsp, addr, val);
+    } else {
+        uint32_t e = (addr & 0x3FFF) | 0x4000;
+
+        dsp->ext[e] = val;
+        dsp56k_ext_written(dsp, e);
+    }
+}
+
+void dsp56k_write_y(dsp56k_t *dsp, uint32_t addr, uint32_t val)
+{
+    val &= 0xFFFFFF;
+    if (addr < DSP56K_XY_INT_WORDS) {
+        dsp->y_int[addr] = val;
+    } else if (addr < DSP56K_XY_INT_WORDS + DSP56K_ROM_WORDS && (dsp->omr & DSP56K_OMR_DE)) {
+        // ROM
+    } else {
+        uint32_t e = addr & 0x3FFF;
+
+        dsp->ext[e] = val;
+        dsp56k_ext_written(dsp, e);
+    }
+}
+
+void dsp56k_write_p(dsp56k_t *dsp, uint32_t addr, uint32_t val)
+{
+    val &= 0xFFFFFF;
+    if (addr < DSP56K_P_INT_WORDS) {
+        dsp->p_int[addr] = val;
+        dsp56k_p_written(dsp, addr);
+    } else {
+        uint32_t e = addr & 0x7FFF;
+
+        dsp->ext[e] = val;
+        dsp56k_ext_written(dsp, e);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Program control
+// ---------------------------------------------------------------------------
+
+void dsp56k_push(dsp56k_t *dsp, uint16_t hi, uint16_t lo)
+{
+    uint8_t sp = (dsp->sp & DSP56K_SP_PTR) + 1;
+
+    if (sp > DSP56K_STACK_DEPTH) {
+        // Stack error interrupt not emulated; the push wraps like the pointer
+        dsp->sp |= DSP56K_SP_SE;
+        sp &= DSP56K_SP_PTR;
+    }
+    dsp->sp = (dsp->sp & ~DSP56K_SP_PTR) | sp;
+    dsp->ssh[sp] = hi;
+    dsp->ssl[sp] = lo;
+}
+
+void dsp56k_pop(dsp56k_t *dsp, uint16_t *hi, uint16_t *lo)
+{
+    uint8_t sp = dsp->sp & DSP56K_SP_PTR;
+
+    *hi = dsp->ssh[sp];
+    *lo = dsp->ssl[sp];
+    if (sp == 0) {
+        dsp->sp |= DSP56K_SP_SE | DSP56K_SP_UF;
+    }
+    dsp->sp = (dsp->sp & ~DSP56K_SP_PTR) | ((sp - 1) & DSP56K_SP_PTR);
+}
+
+uint16_t dsp56k_get_sr(dsp56k_t *dsp)
+{
+    dsp56k_flags(dsp);
+    return dsp->sr;
+}
+
+void dsp56k_set_sr(dsp56k_t *dsp, uint16_t sr)
+{
+    dsp->lazy = false;
+    dsp->sr = sr & 0xEFFF;
+    dsp56k_loop_update(dsp);
+    // A lowered mask may let a pending interrupt in
+    dsp56k_service_now(dsp);
+}
+
+void dsp56k_loop_end(dsp56k_t *dsp)
+{
+    uint16_t pc, sr;
+
+    if (dsp->lc == 1) {
+        dsp56k_pop(dsp, &pc, &sr);
+        dsp->sr = (dsp->sr & ~DSP56K_SR_LF) | (sr & DSP56K_SR_LF);
+        dsp56k_pop(dsp, &dsp->la, &dsp->lc);
+        dsp56k_loop_update(dsp);
+    } else {
+        dsp->lc--;
+        dsp->pc = dsp->ssh[dsp->sp & DSP56K_SP_PTR];
+    }
+}
+
+static bool dsp56k_is_jsr(const dsp56k_insn_t *insn)
+{
+    return insn->run == dsp56k_op_jsr || insn->run == dsp56k_op_jsr_ea;
+}
+
+void dsp56k_interrupt(dsp56k_t *dsp, uint32_t vector, int level)
+{
+    const dsp56k_insn_t *insn = dsp56k_lookup(dsp, vector);
+
+    dsp->stopped = false;
+    dsp->stats.interrupts++;
+    dsp->cycle += insn->clocks;
+    if (dsp56k_is_jsr(insn)) {
+        // Long interrupt: the JSR stacks the interrupted PC and SR
+        uint16_t sr;
+
+        insn->run(dsp, insn);
+        sr = dsp56k_get_sr(dsp) & ~(DSP56K_SR_LF | DSP56K_SR_T | DSP56K_SR_S01 | DSP56K_SR_I);
+        dsp->sr = sr | (uint16_t)((level < 2 ? level + 1 : 3) << DSP56K_SR_I_SHIFT);
+        dsp56k_loop_update(dsp);
+    } else {
+        // Fast interrupt: the two words at the vector, then back
+        uint32_t pc = dsp->pc;
+
+        dsp->pc = vector + insn->words;
+        insn->run(dsp, insn);
+        if (insn->words == 1) {
+            insn = dsp56k_lookup(dsp, vector + 1);
+            dsp->cycle += insn->clocks;
+            dsp->pc = vector + 2;
+            insn->run(dsp, insn);
+        }
+        dsp->pc = pc;
+    }
+    dsp56k_service_now(dsp);
+}
+
+/** Highest-priority pending interrupt the SR mask lets in, taken */
+static void dsp56k_check_interrupts(dsp56k_t *dsp)
+{
+    static const uint8_t vectors[DSP56K_IRQ_COUNT] = {
+        [DSP56K_IRQ_HOST_CMD]   = 0,
+        [DSP56K_IRQ_HOST_RX]    = DSP56K_VEC_HOST_RX,
+        [DSP56K_IRQ_HOST_TX]    = DSP56K_VEC_HOST_TX,
+        [DSP56K_IRQ_SSI_RX_EXC] = DSP56K_VEC_SSI_RX_EXC,
+        [DSP56K_IRQ_SSI_RX]     = DSP56K_VEC_SSI_RX,
+        [DSP56K_IRQ_SSI_TX_EXC] = DSP56K_VEC_SSI_TX_EXC,
+        [DSP56K_IRQ_SSI_TX]     = DSP56K_VEC_SSI_TX,
+    };
+    uint32_t ipr = dsp->periph[DSP56K_IPR - DSP56K_PERIPH_BASE];
+    int host_level = (int)((ipr >> 10) & 3) - 1;
+    int ssi_level = (int)((ipr >> 12) & 3) - 1;
+    int mask = (dsp->sr & DSP56K_SR_I) >> DSP56K_SR_I_SHIFT;
+    int best = -1, best_level = -1;
+
+    for (int irq = 0; irq < DSP56K_IRQ_COUNT; irq++) {
+        int level = irq <= DSP56K_IRQ_HOST_TX ? host_level : ssi_level;
+
+        if ((dsp->pending & (1u << irq)) && level >= mask && level > best_level) {
+            best = irq;
+            best_level = level;
+        }
+    }
+    if (best < 0) {
+        return;
+    }
+
+    uint32_t vector = vectors[best];
+    if (best == DSP56K_IRQ_HOST_CMD) {
+        vector = dsp->host_vector;
+        dsp->hsr &= ~DSP56K_HSR_HCP;
+        dsp->cvr &= ~DSP56K_CVR_HC;
+        dsp56k_irq_update(dsp);
+    }
+    dsp56k_interrupt(dsp, vector, best_level);
+}
+
+/** Bootstrap: words from the host port to P:$0000 until 512 or HF0 */
+static void dsp56k_boot_step(dsp56k_t *dsp)
+{
+    while (dsp->booting && (dsp->hsr & DSP56K_HSR_HRDF)) {
+        uint32_t word = dsp56k_periph_read(dsp, DSP56K_HRX);
+
+        dsp56k_write_p(dsp, dsp->boot_count++, word);
+        if (dsp->boot_count == DSP56K_BOOT_WORDS) {
+            dsp->booting = false;
+        }
+    }
+    if (dsp->hsr & DSP56K_HSR_HF0) {
+        dsp->booting = false;
+    }
+    if (!dsp->booting) {
+        dsp->pc = 0;
+    }
+}
+
+static void dsp56k_service(dsp56k_t *dsp)
+{
+    while (dsp->cycle >= dsp->ssi_next) {
+        dsp56k_periph_event(dsp);
+    }
+    dsp->service_at = dsp->ssi_next;
+    if (dsp->booting) {
+        dsp56k_boot_step(dsp);
+    }
+    if (dsp->pending && !dsp->booting) {
+        dsp56k_check_interrupts(dsp);
+    }
+}
+
+void dsp56k_execute(dsp56k_t *dsp, uint64_t until)
+{
+    uint64_t instructions = 0;
+
+    while (dsp->cycle < until) {
+        if (dsp->cycle >= dsp->service_at) {
+            dsp56k_service(dsp);
+        }
+        dsp->stop_at = dsp->service_at < until ? dsp->service_at : until;
+        if (dsp->stopped || dsp->booting) {
+            // Nothing changes before the next event or host access
+            if (dsp->cycle < dsp->stop_at) {
+                dsp->cycle = dsp->stop_at;
+            }
+            continue;
+        }
+        while (dsp->cycle < dsp->stop_at) {
+            const dsp56k_insn_t *insn = dsp56k_lookup(dsp, dsp->pc);
+
+            dsp->pc += insn->words;
+            dsp->cycle += insn->clocks;
+            insn->run(dsp, insn);
+            if (dsp->pc == dsp->loop_next) {
+                dsp56k_loop_end(dsp);
+            }
+            instructions++;
+        }
+    }
+    dsp->stats.instructions += instructions;
+}
+
+// ---------------------------------------------------------------------------
+// Reset
+// ---------------------------------------------------------------------------
+
+void dsp56k_reset(dsp56k_t *dsp)
+{
+    memset(dsp->xy, 0, sizeof(dsp->xy));
+    memset(dsp->acc, 0, sizeof(dsp->acc));
+    memset(dsp->r, 0, sizeof(dsp->r));
+    memset(dsp->n, 0, sizeof(dsp->n));
+    memset(dsp->m, 0xFF, sizeof(dsp->m));
+    dsp->lazy = false;
+    dsp->sr = DSP56K_SR_I;
+    dsp->omr = 0;
+    dsp->sp = 0;
+    dsp->la = 0;
+    dsp->lc = 0;
+    dsp56k_loop_update(dsp);
+    dsp->pc = DSP56K_VEC_RESET;
+    dsp->stopped = false;
+    dsp->booting = dsp->config.boot_from_host;
+    dsp->boot_count = 0;
+    dsp56k_periph_reset(dsp);
+    dsp56k_service_now(dsp);
+}
+
+void dsp56k_init(dsp56k_t *dsp, const dsp56k_config_t *config)
+{
+    memset(dsp, 0, sizeof(*dsp));
+    dsp->config = *config;
+    if (!dsp->config.window) {
+        dsp->config.window = DSP56K_WINDOW_DEFAULT;
+    }
+    dsp56k_pcache_flush(dsp);
+    dsp56k_reset(dsp);
+}
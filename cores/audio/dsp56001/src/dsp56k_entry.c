@@ -0,0 +1,94 @@
+/**
+ * @file dsp56k_entry.c
+ * @brief audio_interface_t adapter for the Falcon DSP56001
+ *
+ * As with the other components the interface has no context argument, so
+ * the single DSP instance lives here. read_reg() and write_reg() are the
+ * host port at $FFFFA200, clock() takes 68030 cycles, and generate()
+ * returns what the DSP sent over the SSI, one frame per output sample:
+ * the crossbar clocks the SSI at the output rate.
+ */
+
+#include <stddef.h>
+#include "dsp56k.h"
+
+static dsp56k_t s_dsp;
+
+static int dsp56k_if_init(uint32_t sample_rate)
+{
+    dsp56k_config_t config = {
+        .dsp_hz = DSP56K_CLOCK_HZ,
+        .host_hz = DSP56K_HOST_HZ,
+        .ssi_rate = sample_rate,
+        .window = DSP56K_WINDOW_DEFAULT,
+        .boot_from_host = true,
+    };
+
+    if (!sample_rate) {
+        return -1;
+    }
+    dsp56k_init(&s_dsp, &config);
+    return 0;
+}
+
+static void dsp56k_if_reset(void)
+{
+    dsp56k_host_sync(&s_dsp);
+    dsp56k_reset(&s_dsp);
+}
+
+static void dsp56k_if_shutdown(void)
+{
+}
+
+static void dsp56k_if_generate(int16_t *buffer, int samples)
+{
+    dsp56k_ssi_generate(&s_dsp, buffer, samples);
+}
+
+static uint8_t dsp56k_if_read_reg(uint32_t addr)
+{
+    return dsp56k_host_read(&s_dsp, addr);
+}
+
+static void dsp56k_if_write_reg(uint32_t addr, uint8_t val)
+{
+    dsp56k_host_write(&s_dsp, addr, val);
+}
+
+static void dsp56k_if_clock(int cycles)
+{
+    dsp56k_host_clock(&s_dsp, cycles);
+}
+
+static void dsp56k_if_start_async(void)
+{
+    dsp56k_start_async(&s_dsp);
+}
+
+static int dsp56k_if_run_async(void)
+{
+    return dsp56k_run_async(&s_dsp);
+}
+
+static const audio_interface_t s_dsp56k_interface = {
+    .interface_version = AUDIO_INTERFACE_V1,
+    .name              = "DSP56001",
+    .init              = dsp56k_if_init,
+    .reset             = dsp56k_if_reset,
+    .shutdown          = dsp56k_if_shutdown,
+    .generate          = dsp56k_if_generate,
+    .read_reg          = dsp56k_if_read_reg,
+    .write_reg         = dsp56k_if_write_reg,
+    .clock             = dsp56k_if_clock,
+    .start_async       = dsp56k_if_start_async,
+    .run_async         = dsp56k_if_run_async,
+};
+
+/**
+ * @brief Component entry point (EBIN "Entry Offset")
+ */
+const audio_interface_t *dsp56001_entry(void)
+{
+    return &s_dsp56k_interface;
+}
@@ -0,0 +1,1211 @@
+/**
+ * @file dsp56k_ops.c
+ * @brief DSP56001 instruction handlers and decoder
+ *
+ * dsp56k_decode_op() runs once per cached P word: it picks the handler,
+ * the ALU half of a parallel instruction and the length and clocks,
+ * folding in the extension word the effective address may need. Handlers
+ * then only extract register and address fields.
+ *
+ * Encodings follow the DSP56000 family manual. Parallel instructions are
+ * those with any of bits 23-20 set, plus the class II moves; everything
+ * else is found in s_opcodes, first match wins.
+ */
+
+#include "dsp56k.h"
+
+// Register numbers of the six-bit DDDDDD field; the five-bit fields are its low half
+#define REG_X0          0x04
+#define REG_X1          0x05
+#define REG_Y0          0x06
+#define REG_Y1          0x07
+#define REG_A0          0x08
+#define REG_B0          0x09
+#define REG_A2          0x0A
+#define REG_B2          0x0B
+#define REG_A1          0x0C
+#define REG_B1          0x0D
+#define REG_A           0x0E
+#define REG_B           0x0F
+#define REG_R0          0x10
+#define REG_N0          0x18
+#define REG_M0          0x20
+#define REG_SR          0x39
+#define REG_OMR         0x3A
+#define REG_SP          0x3B
+#define REG_SSH         0x3C
+#define REG_SSL         0x3D
+#define REG_LA          0x3E
+#define REG_LC          0x3F
+
+#define EA_ABS          0x30    ///< Absolute address in the extension word
+#define EA_IMM          0x34    ///< Immediate data in the extension word
+
+#define OP_EA(op)       (((op) >> 8) & 0x3F)
+#define OP_AA(op)       (((op) >> 8) & 0x3F)
+#define OP_PP(op)       (DSP56K_PERIPH_BASE | ((op) & 0x3F))
+#define OP_S(op)        (((op) >> 6) & 1)       ///< 0 X memory, 1 Y memory
+#define OP_W(op)        ((op) & 0x8000)
+
+// ---------------------------------------------------------------------------
+// Registers
+// ---------------------------------------------------------------------------
+
+static uint32_t reg_read(dsp56k_t *dsp, unsigned reg)
+{
+    switch (reg) {
+    case REG_X0 ... REG_Y1:
+        return dsp->xy[reg - REG_X0];
+    case REG_A0:
+    case REG_B0:
+        return (uint32_t)dsp->acc[reg & 1] & 0xFFFFFF;
+    case REG_A2:
+    case REG_B2:
+        return (uint32_t)(dsp->acc[reg & 1] >> 48) & 0xFFFFFF;
+    case REG_A1:
+    case REG_B1:
+        return (uint32_t)(dsp->acc[reg & 1] >> 24) & 0xFFFFFF;
+    case REG_A:
+    case REG_B:
+        return dsp56k_acc_limit24(dsp, dsp->acc[reg & 1]);
+    case REG_R0 ... REG_R0 + 7:
+        return dsp->r[reg & 7];
+    case REG_N0 ... REG_N0 + 7:
+        return dsp->n[reg & 7];
+    case REG_M0 ... REG_M0 + 7:
+        return dsp->m[reg & 7];
+    case REG_SR:
+        return dsp56k_get_sr(dsp);
+    case REG_OMR:
+        return dsp->omr;
+    case REG_SP:
+        return dsp->sp;
+    case REG_SSH: {
+        uint16_t hi, lo;
+
+        dsp56k_pop(dsp, &hi, &lo);
+        return hi;
+    }
+    case REG_SSL:
+        return dsp->ssl[dsp->sp & DSP56K_SP_PTR];
+    case REG_LA:
+        return dsp->la;
+    case REG_LC:
+        return dsp->lc;
+    default:
+        return 0;
+    }
+}
+
+static void reg_write(dsp56k_t *dsp, unsigned reg, uint32_t val)
+{
+    val &= 0xFFFFFF;
+    switch (reg) {
+    case REG_X0 ... REG_Y1:
+        dsp->xy[reg - REG_X0] = val;
+        break;
+    case REG_A0:
+    case REG_B0:
+        dsp->acc[reg & 1] = (dsp->acc[reg & 1] & ~0xFFFFFFLL) | val;
+        break;
+    case REG_A2:
+    case REG_B2:
+        dsp->acc[reg & 1] = (dsp->acc[reg & 1] & 0xFFFFFFFFFFFFLL) | ((int64_t)(int8_t)val * (1LL << 48));
+        break;
+    case REG_A1:
+    case REG_B1:
+        dsp->acc[reg & 1] = (dsp->acc[reg & 1] & ~(0xFFFFFFLL << 24)) | ((int64_t)val << 24);
+        break;
+    case REG_A:
+    case REG_B:
+        dsp->acc[reg & 1] = dsp56k_acc_of24(val);
+        break;
+    case REG_R0 ... REG_R0 + 7:
+        dsp->r[reg & 7] = (uint16_t)val;
+        break;
+    case REG_N0 ... REG_N0 + 7:
+        dsp->n[reg & 7] = (uint16_t)val;
+        break;
+    case REG_M0 ... REG_M0 + 7:
+        dsp->m[reg & 7] = (uint16_t)val;
+        break;
+    case REG_SR:
+        dsp56k_set_sr(dsp, (uint16_t)val);
+        break;
+    case REG_OMR:
+        dsp->omr = (uint8_t)val;
+        break;
+    case REG_SP:
+        dsp->sp = (uint8_t)(val & 0x3F);
+        break;
+    case REG_SSH:
+        dsp56k_push(dsp, (uint16_t)val, dsp->ssl[((dsp->sp & DSP56K_SP_PTR) + 1) & DSP56K_SP_PTR]);
+        break;
+    case REG_SSL:
+        dsp->ssl[dsp->sp & DSP56K_SP_PTR] = (uint16_t)val;
+        break;
+    case REG_LA:
+        dsp->la = (uint16_t)val;
+        dsp56k_loop_update(dsp);
+        break;
+    case REG_LC:
+        dsp->lc = (uint16_t)val;
+        break;
+    default:
+        break;
+    }
+}
+
+static inline uint32_t mem_read(dsp56k_t *dsp, int space, uint32_t addr)
+{
+    return space ? dsp56k_read_y(dsp, addr) : dsp56k_read_x(dsp, addr);
+}
+
+static inline void mem_write(dsp56k_t *dsp, int space, uint32_t addr, uint32_t val)
+{
+    if (space) {
+        dsp56k_write_y(dsp, addr, val);
+    } else {
+        dsp56k_write_x(dsp, addr, val);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Address generation
+// ---------------------------------------------------------------------------
+
+static inline uint32_t agu_bitrev16(uint32_t v)
+{
+    v = ((v >> 1) & 0x5555) | ((v & 0x5555) << 1);
+    v = ((v >> 2) & 0x3333) | ((v & 0x3333) << 2);
+    v = ((v >> 4) & 0x0F0F) | ((v & 0x0F0F) << 4);
+    return ((v >> 8) & 0x00FF) | ((v & 0x00FF) << 8);
+}
+
+/** Rn + @p delta under the modifier Mn */
+static uint16_t agu_add(dsp56k_t *dsp, unsigned n, int32_t delta)
+{
+    uint32_t m = dsp->m[n];
+    uint32_t r = dsp->r[n];
+
+    if (DSP56K_LIKELY(m == 0xFFFF)) {
+        return (uint16_t)(r + (uint32_t)delta);
+    }
+    if (m == 0) {
+        // Reverse carry, for FFT addressing
+        uint32_t rev = agu_bitrev16(r);
+
+        rev = delta >= 0 ? rev + agu_bitrev16((uint32_t)delta) : rev - agu_bitrev16((uint32_t)-delta);
+        return (uint16_t)agu_bitrev16(rev & 0xFFFF);
+    }
+    if (m < 0x8000) {
+        int32_t modulus = (int32_t)m + 1;
+        uint32_t mask = m;
+
+        if (delta >= modulus || -delta >= modulus) {
+            return (uint16_t)(r + (uint32_t)delta);
+        }
+        mask |= mask >> 1;
+        mask |= mask >> 2;
+        mask |= mask >> 4;
+        mask |= mask >> 8;
+
+        uint32_t base = r & ~mask;
+        int32_t offset = (int32_t)(r - base) + delta;
+
+        if (offset >= modulus) {
+            offset -= modulus;
+        } else if (offset < 0) {
+            offset += modulus;
+        }
+        return (uint16_t)(base + (uint32_t)offset);
+    }
+    return (uint16_t)(r + (uint32_t)delta);
+}
+
+/** Address of MMMRRR effective address @p ea, updating Rn */
+static uint32_t agu_ea(dsp56k_t *dsp, unsigned ea, uint32_t ext)
+{
+    unsigned n = ea & 7;
+    uint32_t addr = dsp->r[n];
+
+    switch (ea >> 3) {
+    case 0:
+        dsp->r[n] = agu_add(dsp, n, -(int32_t)(int16_t)dsp->n[n]);
+        break;
+    case 1:
+        dsp->r[n] = agu_add(dsp, n, (int16_t)dsp->n[n]);
+        break;
+    case 2:
+        dsp->r[n] = agu_add(dsp, n, -1);
+        break;
+    case 3:
+        dsp->r[n] = agu_add(dsp, n, 1);
+        break;
+    case 4:
+        break;
+    case 5:
+        addr = agu_add(dsp, n, (int16_t)dsp->n[n]);
+        break;
+    case 6:
+        addr = ext & 0xFFFF;
+        break;
+    default:
+        addr = dsp->r[n] = agu_add(dsp, n, -1);
+        break;
+    }
+    return addr;
+}
+
+/** Source value of a read through @p ea: memory, or the immediate word */
+static inline uint32_t ea_read(dsp56k_t *dsp, int space, unsigned ea, uint32_t ext)
+{
+    if (ea == EA_IMM) {
+        return ext;
+    }
+    return mem_read(dsp, space, agu_ea(dsp, ea, ext));
+}
+
+// ---------------------------------------------------------------------------
+// Conditions
+// ---------------------------------------------------------------------------
+
+static bool dsp56k_cond(dsp56k_t *dsp, unsigned cc)
+{
+    uint16_t sr;
+    bool nv, nr;
+
+    dsp56k_flags(dsp);
+    sr = dsp->sr;
+    nv = !(sr & DSP56K_SR_N) != !(sr & DSP56K_SR_V);
+    nr = (sr & DSP56K_SR_Z) || !(sr & (DSP56K_SR_U | DSP56K_SR_E));
+
+    switch (cc & 0xF) {
+    case 0x0: return !(sr & DSP56K_SR_C);                   // CC
+    case 0x1: return !nv;                                   // GE
+    case 0x2: return !(sr & DSP56K_SR_Z);                   // NE
+    case 0x3: return !(sr & DSP56K_SR_N);                   // PL
+    case 0x4: return !nr;                                   // NN
+    case 0x5: return !(sr & DSP56K_SR_E);                   // EC
+    case 0x6: return !(sr & DSP56K_SR_L);                   // LC
+    case 0x7: return !((sr & DSP56K_SR_Z) || nv);           // GT
+    case 0x8: return sr & DSP56K_SR_C;                      // CS
+    case 0x9: return nv;                                    // LT
+    case 0xA: return sr & DSP56K_SR_Z;                      // EQ
+    case 0xB: return sr & DSP56K_SR_N;                      // MI
+    case 0xC: return nr;                                    // NR
+    case 0xD: return sr & DSP56K_SR_E;                      // ES
+    case 0xE: return sr & DSP56K_SR_L;                      // LS
+    default:  return (sr & DSP56K_SR_Z) || nv;              // LE
+    }
+}
+
+/**
+ * @brief A jump to itself waiting on a flag: nothing changes before the next event
+ *
+ * Events and host accesses are what stop the run loop, so the remaining
+ * clocks to there would all be spent on the same test.
+ */
+static inline void dsp56k_spin(dsp56k_t *dsp, uint32_t target, const dsp56k_insn_t *insn)
+{
+    if (target == dsp->pc - insn->words && dsp->cycle < dsp->stop_at) {
+        dsp->cycle = dsp->stop_at;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Parallel moves
+// ---------------------------------------------------------------------------
+
+static void op_par_none(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    insn->alu(dsp, insn->op);
+}
+
+/** #xx,D: the value was placed in ext by the decoder */
+static void op_par_imm(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    insn->alu(dsp, insn->op);
+    reg_write(dsp, (insn->op >> 16) & 0x1F, insn->ext);
+}
+
+static void op_par_reg(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t val = reg_read(dsp, (insn->op >> 13) & 0x1F);
+
+    insn->alu(dsp, insn->op);
+    reg_write(dsp, (insn->op >> 8) & 0x1F, val);
+}
+
+static void op_par_update(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    agu_ea(dsp, (insn->op >> 8) & 0x1F, 0);
+    insn->alu(dsp, insn->op);
+}
+
+/** X: or Y: move with one register, short absolute or effective address */
+static void op_par_mem(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+    unsigned reg = ((op >> 17) & 0x18) | ((op >> 16) & 7);
+    int space = (op >> 19) & 1;
+    unsigned ea = OP_EA(op);
+
+    if (OP_W(op)) {
+        uint32_t val = (op & 0x4000) ? ea_read(dsp, space, ea, insn->ext) : mem_read(dsp, space, OP_AA(op));
+
+        insn->alu(dsp, op);
+        reg_write(dsp, reg, val);
+    } else {
+        uint32_t val = reg_read(dsp, reg);
+        uint32_t addr = (op & 0x4000) ? agu_ea(dsp, ea, insn->ext) : OP_AA(op);
+
+        insn->alu(dsp, op);
+        mem_write(dsp, space, addr, val);
+    }
+}
+
+/** L: move, X and Y at the same address */
+static void op_par_long(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+    unsigned lll = ((op >> 17) & 4) | ((op >> 16) & 3);
+    uint32_t addr = (op & 0x4000) ? agu_ea(dsp, OP_EA(op), insn->ext) : OP_AA(op);
+    uint32_t hi, lo;
+
+    if (OP_W(op)) {
+        hi = dsp56k_read_x(dsp, addr);
+        lo = dsp56k_read_y(dsp, addr);
+        insn->alu(dsp, op);
+        switch (lll) {
+        case 0:
+        case 1:
+            reg_write(dsp, REG_A1 + lll, hi);
+            reg_write(dsp, REG_A0 + lll, lo);
+            break;
+        case 2:
+        case 3:
+            dsp->xy[(lll - 2) * 2 + 1] = hi;
+            dsp->xy[(lll - 2) * 2] = lo;
+            break;
+        case 4:
+        case 5:
+            dsp->acc[lll & 1] = dsp56k_acc_of24(hi) | lo;
+            break;
+        default:
+            dsp->acc[lll & 1] = dsp56k_acc_of24(hi);
+            dsp->acc[(lll & 1) ^ 1] = dsp56k_acc_of24(lo);
+            break;
+        }
+        return;
+    }
+
+    switch (lll) {
+    case 0:
+    case 1:
+        hi = reg_read(dsp, REG_A1 + lll);
+        lo = reg_read(dsp, REG_A0 + lll);
+        break;
+    case 2:
+    case 3:
+        hi = dsp->xy[(lll - 2) * 2 + 1];
+        lo = dsp->xy[(lll - 2) * 2];
+        break;
+    case 4:
+    case 5: {
+        int64_t v = dsp->acc[lll & 1];
+        int64_t top = v >> 47;
+
+        if (top != 0 && top != -1) {
+            dsp->sr |= DSP56K_SR_L;
+            v = v < 0 ? -(1LL << 47) : (1LL << 47) - 1;
+        }
+        hi = (uint32_t)(v >> 24) & 0xFFFFFF;
+        lo = (uint32_t)v & 0xFFFFFF;
+        break;
+    }
+    default:
+        hi = dsp56k_acc_limit24(dsp, dsp->acc[lll & 1]);
+        lo = dsp56k_acc_limit24(dsp, dsp->acc[(lll & 1) ^ 1]);
+        break;
+    }
+    insn->alu(dsp, op);
+    dsp56k_write_x(dsp, addr, hi);
+    dsp56k_write_y(dsp, addr, lo);
+}
+
+/** X: and Y: at once, the second address register from the other bank */
+static void op_par_xy(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    static const uint8_t modes[4] = { 4, 1, 2, 3 };
+    static const uint8_t xregs[4] = { REG_X0, REG_X1, REG_A, REG_B };
+    static const uint8_t yregs[4] = { REG_Y0, REG_Y1, REG_A, REG_B };
+    uint32_t op = insn->op;
+    unsigned xr = (op >> 8) & 7;
+    unsigned yr = ((op >> 13) & 3) | (xr & 4 ? 0 : 4);
+    uint32_t xaddr = agu_ea(dsp, (unsigned)modes[(op >> 11) & 3] << 3 | xr, 0);
+    uint32_t yaddr = agu_ea(dsp, (unsigned)modes[(op >> 20) & 3] << 3 | yr, 0);
+    unsigned xreg = xregs[(op >> 18) & 3];
+    unsigned yreg = yregs[(op >> 16) & 3];
+    uint32_t xval = OP_W(op) ? dsp56k_read_x(dsp, xaddr) : reg_read(dsp, xreg);
+    uint32_t yval = (op & 0x400000) ? dsp56k_read_y(dsp, yaddr) : reg_read(dsp, yreg);
+
+    insn->alu(dsp, op);
+    if (OP_W(op)) {
+        reg_write(dsp, xreg, xval);
+    } else {
+        dsp56k_write_x(dsp, xaddr, xval);
+    }
+    if (op & 0x400000) {
+        reg_write(dsp, yreg, yval);
+    } else {
+        dsp56k_write_y(dsp, yaddr, yval);
+    }
+}
+
+/** Class I X:R: X move, and A or B to Y0 or Y1 */
+static void op_par_xr(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    static const uint8_t xregs[4] = { REG_X0, REG_X1, REG_A, REG_B };
+    uint32_t op = insn->op;
+    unsigned xreg = xregs[(op >> 18) & 3];
+    uint32_t rval = dsp56k_acc_limit24(dsp, dsp->acc[(op >> 17) & 1]);
+    uint32_t xval = 0, addr = 0;
+
+    if (OP_W(op)) {
+        xval = ea_read(dsp, 0, OP_EA(op), insn->ext);
+    } else {
+        xval = reg_read(dsp, xreg);
+        addr = agu_ea(dsp, OP_EA(op), insn->ext);
+    }
+    insn->alu(dsp, op);
+    if (OP_W(op)) {
+        reg_write(dsp, xreg, xval);
+    } else {
+        dsp56k_write_x(dsp, addr, xval);
+    }
+    dsp->xy[2 + ((op >> 16) & 1)] = rval;
+}
+
+/** Class I R:Y: A or B to X0 or X1, and Y move */
+static void op_par_ry(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    static const uint8_t yregs[4] = { REG_Y0, REG_Y1, REG_A, REG_B };
+    uint32_t op = insn->op;
+    unsigned yreg = yregs[(op >> 16) & 3];
+    uint32_t rval = dsp56k_acc_limit24(dsp, dsp->acc[(op >> 19) & 1]);
+    uint32_t yval = 0, addr = 0;
+
+    if (OP_W(op)) {
+        yval = ea_read(dsp, 1, OP_EA(op), insn->ext);
+    } else {
+        yval = reg_read(dsp, yreg);
+        addr = agu_ea(dsp, OP_EA(op), insn->ext);
+    }
+    insn->alu(dsp, op);
+    if (OP_W(op)) {
+        reg_write(dsp, yreg, yval);
+    } else {
+        dsp56k_write_y(dsp, addr, yval);
+    }
+    dsp->xy[(op >> 18) & 1] = rval;
+}
+
+/** Class II: accumulator to X: or Y:, X0 or Y0 to the accumulator */
+static void op_par_class2(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+    int d = (op >> 16) & 1;
+    int space = (op >> 15) & 1;
+    uint32_t mval = dsp56k_acc_limit24(dsp, dsp->acc[d]);
+    uint32_t rval = dsp->xy[space ? 2 : 0];
+    uint32_t addr = agu_ea(dsp, OP_EA(op), insn->ext);
+
+    insn->alu(dsp, op);
+    mem_write(dsp, space, addr, mval);
+    dsp->acc[d] = dsp56k_acc_of24(rval);
+}
+
+// ---------------------------------------------------------------------------
+// Program control
+// ---------------------------------------------------------------------------
+
+static void op_nop(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+}
+
+void dsp56k_illegal(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_interrupt(dsp, DSP56K_VEC_ILLEGAL, 3);
+}
+
+static void op_swi(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_interrupt(dsp, DSP56K_VEC_SWI, 3);
+}
+
+static void op_rti(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint16_t pc, sr;
+
+    dsp56k_pop(dsp, &pc, &sr);
+    dsp->pc = pc;
+    dsp56k_set_sr(dsp, sr);
+}
+
+static void op_rts(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint16_t pc, sr;
+
+    dsp56k_pop(dsp, &pc, &sr);
+    dsp->pc = pc;
+}
+
+static void op_reset(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_periph_reset(dsp);
+    dsp56k_service_now(dsp);
+}
+
+static void op_wait(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp->stopped = true;
+    dsp56k_service_now(dsp);
+}
+
+static void op_enddo(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint16_t pc, sr;
+
+    dsp56k_pop(dsp, &pc, &sr);
+    dsp->sr = (dsp->sr & ~DSP56K_SR_LF) | (sr & DSP56K_SR_LF);
+    dsp56k_pop(dsp, &dsp->la, &dsp->lc);
+    dsp56k_loop_update(dsp);
+}
+
+static void op_jmp(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t target = insn->op & 0xFFF;
+
+    dsp56k_spin(dsp, target, insn);
+    dsp->pc = target;
+}
+
+static void op_jmp_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp->pc = agu_ea(dsp, OP_EA(insn->op), insn->ext);
+}
+
+static void op_jcc(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    if (dsp56k_cond(dsp, insn->op >> 12)) {
+        dsp->pc = insn->op & 0xFFF;
+    }
+}
+
+static void op_jcc_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t target = agu_ea(dsp, OP_EA(insn->op), insn->ext);
+
+    if (dsp56k_cond(dsp, insn->op)) {
+        dsp->pc = target;
+    }
+}
+
+static inline void dsp56k_call(dsp56k_t *dsp, uint32_t target)
+{
+    dsp56k_push(dsp, (uint16_t)dsp->pc, dsp56k_get_sr(dsp));
+    dsp->pc = target;
+}
+
+void dsp56k_op_jsr(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_call(dsp, insn->op & 0xFFF);
+}
+
+void dsp56k_op_jsr_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_call(dsp, agu_ea(dsp, OP_EA(insn->op), insn->ext));
+}
+
+static void op_jscc(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    if (dsp56k_cond(dsp, insn->op >> 12)) {
+        dsp56k_call(dsp, insn->op & 0xFFF);
+    }
+}
+
+static void op_jscc_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t target = agu_ea(dsp, OP_EA(insn->op), insn->ext);
+
+    if (dsp56k_cond(dsp, insn->op)) {
+        dsp56k_call(dsp, target);
+    }
+}
+
+/** DO: stack LA and LC, then the first loop address and SR */
+static void dsp56k_do(dsp56k_t *dsp, const dsp56k_insn_t *insn, uint32_t count)
+{
+    dsp56k_push(dsp, dsp->la, dsp->lc);
+    dsp->la = (uint16_t)insn->ext;
+    dsp->lc = (uint16_t)count;
+    dsp56k_push(dsp, (uint16_t)dsp->pc, dsp56k_get_sr(dsp));
+    dsp->sr |= DSP56K_SR_LF;
+    dsp56k_loop_update(dsp);
+}
+
+static void op_do_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_do(dsp, insn, mem_read(dsp, OP_S(insn->op), agu_ea(dsp, OP_EA(insn->op), 0)));
+}
+
+static void op_do_aa(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_do(dsp, insn, mem_read(dsp, OP_S(insn->op), OP_AA(insn->op)));
+}
+
+static void op_do_imm(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_do(dsp, insn, ((insn->op >> 8) & 0xFF) | ((insn->op & 0xF) << 8));
+}
+
+static void op_do_reg(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_do(dsp, insn, reg_read(dsp, OP_EA(insn->op)));
+}
+
+/** REP: the next instruction @p count times, 0 meaning 65536, not interruptible */
+static void dsp56k_rep(dsp56k_t *dsp, uint32_t count)
+{
+    dsp56k_insn_t next = *dsp56k_lookup(dsp, dsp->pc);
+    uint32_t n = count & 0xFFFF ? count & 0xFFFF : 0x10000;
+
+    dsp->pc += next.words;
+    dsp->cycle += (uint64_t)next.clocks * n;
+    for (uint32_t i = 0; i < n; i++) {
+        next.run(dsp, &next);
+    }
+    dsp->stats.instructions += n;
+}
+
+static void op_rep_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_rep(dsp, mem_read(dsp, OP_S(insn->op), agu_ea(dsp, OP_EA(insn->op), 0)));
+}
+
+static void op_rep_aa(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_rep(dsp, mem_read(dsp, OP_S(insn->op), OP_AA(insn->op)));
+}
+
+static void op_rep_imm(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_rep(dsp, ((insn->op >> 8) & 0xFF) | ((insn->op & 0xF) << 8));
+}
+
+static void op_rep_reg(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_rep(dsp, reg_read(dsp, OP_EA(insn->op)));
+}
+
+// ---------------------------------------------------------------------------
+// Register and immediate operations
+// ---------------------------------------------------------------------------
+
+static void op_andi(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t imm = (insn->op >> 8) & 0xFF;
+
+    switch (insn->op & 3) {
+    case 0:
+        dsp56k_set_sr(dsp, dsp56k_get_sr(dsp) & (uint16_t)((imm << 8) | 0xFF));
+        break;
+    case 1:
+        dsp56k_set_sr(dsp, dsp56k_get_sr(dsp) & (uint16_t)(0xFF00 | imm));
+        break;
+    case 2:
+        dsp->omr &= (uint8_t)imm;
+        break;
+    default:
+        break;
+    }
+}
+
+static void op_ori(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t imm = (insn->op >> 8) & 0xFF;
+
+    switch (insn->op & 3) {
+    case 0:
+        dsp56k_set_sr(dsp, dsp56k_get_sr(dsp) | (uint16_t)(imm << 8));
+        break;
+    case 1:
+        dsp56k_set_sr(dsp, dsp56k_get_sr(dsp) | (uint16_t)imm);
+        break;
+    case 2:
+        dsp->omr |= (uint8_t)imm;
+        break;
+    default:
+        break;
+    }
+}
+
+/** One non-restoring division step; only C, V and L change */
+static void op_div(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    static const uint8_t srcs[4] = { 0, 2, 1, 3 };     // X0, Y0, X1, Y1
+    int d = (insn->op >> 3) & 1;
+    int64_t acc = dsp->acc[d];
+    int64_t s = dsp56k_acc_of24(dsp->xy[srcs[(insn->op >> 4) & 3]]);
+    int64_t shifted = dsp56k_sx56((int64_t)(((uint64_t)acc << 1) | (dsp->sr & DSP56K_SR_C)));
+    int64_t r = (acc < 0) != (s < 0) ? shifted + s : shifted - s;
+    uint16_t sr = dsp->sr & ~(DSP56K_SR_C | DSP56K_SR_V);
+
+    r = dsp56k_sx56(r);
+    if (r >= 0) {
+        sr |= DSP56K_SR_C;
+    }
+    if ((acc ^ shifted) < 0) {
+        sr |= DSP56K_SR_V | DSP56K_SR_L;
+    }
+    dsp->sr = sr;
+    dsp->acc[d] = r;
+}
+
+/** One normalisation step: shift D towards bit 46 and count in Rn */
+static void op_norm(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    int d = (insn->op >> 3) & 1;
+    unsigned n = (insn->op >> 8) & 7;
+    int64_t v = dsp->acc[d];
+    int64_t r = v;
+    uint16_t sr;
+
+    dsp56k_flags(dsp);
+    sr = dsp->sr & ~DSP56K_SR_V;
+    if (!(sr & (DSP56K_SR_E | DSP56K_SR_Z)) && (sr & DSP56K_SR_U)) {
+        r = dsp56k_sx56(v * 2);
+        dsp->r[n]--;
+        if ((v ^ r) < 0) {
+            sr |= DSP56K_SR_V | DSP56K_SR_L;
+        }
+    } else if (sr & DSP56K_SR_E) {
+        r = v >> 1;
+        dsp->r[n]++;
+    }
+    dsp->sr = sr;
+    dsp->acc[d] = r;
+    dsp->lazy_res = r;
+    dsp->lazy = true;
+}
+
+static void op_tcc(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    static const uint8_t srcs[8] = { 0, 0, 0, 0, 0, 2, 1, 3 };      // acc, -, X0, Y0, X1, Y1
+    uint32_t op = insn->op;
+    int d = (op >> 3) & 1;
+    int j = (op >> 4) & 7;
+
+    if (!dsp56k_cond(dsp, op >> 12)) {
+        return;
+    }
+    dsp->acc[d] = j == 0 ? dsp->acc[d ^ 1] : dsp56k_acc_of24(dsp->xy[srcs[j]]);
+    if (op & 0x010000) {
+        dsp->r[op & 7] = dsp->r[(op >> 8) & 7];
+    }
+}
+
+static void op_lua(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+    unsigned n = (op >> 8) & 7;
+    int32_t delta;
+
+    switch ((op >> 11) & 3) {
+    case 0:
+        delta = -(int32_t)(int16_t)dsp->n[n];
+        break;
+    case 1:
+        delta = (int16_t)dsp->n[n];
+        break;
+    case 2:
+        delta = -1;
+        break;
+    default:
+        delta = 1;
+        break;
+    }
+    reg_write(dsp, (op & 8 ? REG_N0 : REG_R0) | (op & 7), agu_add(dsp, n, delta));
+}
+
+// ---------------------------------------------------------------------------
+// MOVEC, MOVEM, MOVEP
+// ---------------------------------------------------------------------------
+
+#define OP_CTRL(op)     (REG_M0 | ((op) & 0x1F))
+
+static void op_movec_reg(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+
+    if (OP_W(op)) {
+        reg_write(dsp, OP_CTRL(op), reg_read(dsp, OP_EA(op)));
+    } else {
+        reg_write(dsp, OP_EA(op), reg_read(dsp, OP_CTRL(op)));
+    }
+}
+
+static void op_movec_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+
+    if (OP_W(op)) {
+        reg_write(dsp, OP_CTRL(op), ea_read(dsp, OP_S(op), OP_EA(op), insn->ext));
+    } else {
+        uint32_t val = reg_read(dsp, OP_CTRL(op));
+
+        mem_write(dsp, OP_S(op), agu_ea(dsp, OP_EA(op), insn->ext), val);
+    }
+}
+
+static void op_movec_aa(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+
+    if (OP_W(op)) {
+        reg_write(dsp, OP_CTRL(op), mem_read(dsp, OP_S(op), OP_AA(op)));
+    } else {
+        mem_write(dsp, OP_S(op), OP_AA(op), reg_read(dsp, OP_CTRL(op)));
+    }
+}
+
+static void op_movec_imm(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    reg_write(dsp, OP_CTRL(insn->op), (insn->op >> 8) & 0xFF);
+}
+
+static void op_movem_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+    unsigned reg = op & 0x3F;
+
+    if (OP_W(op)) {
+        unsigned ea = OP_EA(op);
+
+        reg_write(dsp, reg, ea == EA_IMM ? insn->ext : dsp56k_read_p(dsp, agu_ea(dsp, ea, insn->ext)));
+    } else {
+        uint32_t val = reg_read(dsp, reg);
+
+        dsp56k_write_p(dsp, agu_ea(dsp, OP_EA(op), insn->ext), val);
+    }
+}
+
+static void op_movem_aa(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+
+    if (OP_W(op)) {
+        reg_write(dsp, op & 0x3F, dsp56k_read_p(dsp, OP_AA(op)));
+    } else {
+        dsp56k_write_p(dsp, OP_AA(op), reg_read(dsp, op & 0x3F));
+    }
+}
+
+/** Peripheral space of MOVEP, bit 16: 0 X:pp, 1 Y:pp */
+#define OP_PP_SPACE(op) (((op) >> 16) & 1)
+
+static void op_movep_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+
+    if (OP_W(op)) {
+        mem_write(dsp, OP_PP_SPACE(op), OP_PP(op), ea_read(dsp, OP_S(op), OP_EA(op), insn->ext));
+    } else {
+        uint32_t val = mem_read(dsp, OP_PP_SPACE(op), OP_PP(op));
+
+        mem_write(dsp, OP_S(op), agu_ea(dsp, OP_EA(op), insn->ext), val);
+    }
+}
+
+static void op_movep_p(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+
+    if (OP_W(op)) {
+        mem_write(dsp, OP_PP_SPACE(op), OP_PP(op), dsp56k_read_p(dsp, agu_ea(dsp, OP_EA(op), insn->ext)));
+    } else {
+        uint32_t val = mem_read(dsp, OP_PP_SPACE(op), OP_PP(op));
+
+        dsp56k_write_p(dsp, agu_ea(dsp, OP_EA(op), insn->ext), val);
+    }
+}
+
+static void op_movep_reg(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+
+    if (OP_W(op)) {
+        mem_write(dsp, OP_PP_SPACE(op), OP_PP(op), reg_read(dsp, OP_EA(op)));
+    } else {
+        reg_write(dsp, OP_EA(op), mem_read(dsp, OP_PP_SPACE(op), OP_PP(op)));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Bit manipulation: bit 16 and bit 5 pick the operation
+// ---------------------------------------------------------------------------
+
+#define BIT_OP(op)      ((((op) >> 15) & 2) | (((op) >> 5) & 1))    ///< CLR, SET, CHG, TST
+
+/** BCLR, BSET, BCHG or BTST on @p val: C is the bit before, the new value returned */
+static uint32_t dsp56k_bit(dsp56k_t *dsp, uint32_t op, uint32_t val)
+{
+    uint32_t bit = 1u << (op & 0x1F);
+
+    dsp->sr = (dsp->sr & ~DSP56K_SR_C) | ((val & bit) ? DSP56K_SR_C : 0);
+    switch (BIT_OP(op)) {
+    case 0:
+        return val & ~bit;
+    case 1:
+        return val | bit;
+    case 2:
+        return val ^ bit;
+    default:
+        return val;
+    }
+}
+
+static void dsp56k_bit_mem(dsp56k_t *dsp, uint32_t op, uint32_t addr)
+{
+    int space = OP_S(op);
+    uint32_t val = mem_read(dsp, space, addr);
+    uint32_t res = dsp56k_bit(dsp, op, val);
+
+    if (BIT_OP(op) != 3) {
+        mem_write(dsp, space, addr, res);
+    }
+}
+
+static void op_bit_aa(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_bit_mem(dsp, insn->op, OP_AA(insn->op));
+}
+
+static void op_bit_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_bit_mem(dsp, insn->op, agu_ea(dsp, OP_EA(insn->op), insn->ext));
+}
+
+static void op_bit_pp(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_bit_mem(dsp, insn->op, DSP56K_PERIPH_BASE | OP_AA(insn->op));
+}
+
+static void op_bit_reg(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    uint32_t op = insn->op;
+    uint32_t res = dsp56k_bit(dsp, op, reg_read(dsp, OP_EA(op)));
+
+    if (BIT_OP(op) != 3) {
+        reg_write(dsp, OP_EA(op), res);
+    }
+}
+
+/** JCLR, JSET, JSCLR or JSSET once the bit is known */
+static void dsp56k_jbit(dsp56k_t *dsp, const dsp56k_insn_t *insn, uint32_t val)
+{
+    uint32_t op = insn->op;
+    bool set = (val >> (op & 0x1F)) & 1;
+    uint32_t target = insn->ext & 0xFFFF;
+
+    if (set != !!(op & 0x20)) {
+        return;
+    }
+    if (op & 0x10000) {
+        dsp56k_call(dsp, target);
+    } else {
+        dsp56k_spin(dsp, target, insn);
+        dsp->pc = target;
+    }
+}
+
+static void op_jbit_aa(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_jbit(dsp, insn, mem_read(dsp, OP_S(insn->op), OP_AA(insn->op)));
+}
+
+static void op_jbit_ea(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_jbit(dsp, insn, mem_read(dsp, OP_S(insn->op), agu_ea(dsp, OP_EA(insn->op), 0)));
+}
+
+static void op_jbit_pp(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_jbit(dsp, insn, mem_read(dsp, OP_S(insn->op), DSP56K_PERIPH_BASE | OP_AA(insn->op)));
+}
+
+static void op_jbit_reg(dsp56k_t *dsp, const dsp56k_insn_t *insn)
+{
+    dsp56k_jbit(dsp, insn, reg_read(dsp, OP_EA(insn->op)));
+}
+
+// ---------------------------------------------------------------------------
+// Decoder
+// ---------------------------------------------------------------------------
+
+#define F_EA        0x01    ///< MMMRRR in bits 13-8 may take an extension word
+#define F_ALU       0x02    ///< Has an ALU half in the low byte
+
+typedef struct {
+    uint32_t mask;
+    uint32_t value;
+    dsp56k_handler_t run;
+    uint8_t words;
+    uint8_t clocks;
+    uint8_t flags;
+} dsp56k_opcode_t;
+
+/** Instructions without a parallel move, bits 23-20 clear; first match wins */
+static const dsp56k_opcode_t s_opcodes[] = {
+    { 0xFFFFFF, 0x000000, op_nop,           1, 2, 0 },
+    { 0xFFFFFF, 0x000004, op_rti,           1, 4, 0 },
+    { 0xFFFFFF, 0x000005, dsp56k_illegal,   1, 8, 0 },
+    { 0xFFFFFF, 0x000006, op_swi,           1, 8, 0 },
+    { 0xFFFFFF, 0x00000C, op_rts,           1, 4, 0 },
+    { 0xFFFFFF, 0x000084, op_reset,         1, 4, 0 },
+    { 0xFFFFFF, 0x000086, op_wait,          1, 2, 0 },
+    { 0xFFFFFF, 0x000087, op_wait,          1, 2, 0 },      // STOP, woken like WAIT
+    { 0xFFFFFF, 0x00008C, op_enddo,         1, 2, 0 },
+    { 0xFF00FC, 0x0000B8, op_andi,          1, 2, 0 },
+    { 0xFF00FC, 0x0000F8, op_ori,           1, 2, 0 },
+    { 0xFFFFC7, 0x018040, op_div,           1, 2, 0 },
+    { 0xFFF8F7, 0x01D815, op_norm,          1, 2, 0 },
+    { 0xFF0F87, 0x020000, op_tcc,           1, 2, 0 },
+    { 0xFF0880, 0x030000, op_tcc,           1, 2, 0 },
+    { 0xFFE0F0, 0x044010, op_lua,           1, 4, 0 },
+    { 0xFF40E0, 0x0440A0, op_movec_reg,     1, 2, 0 },
+    { 0xFF40A0, 0x054020, op_movec_ea,      1, 2, F_EA },
+    { 0xFF40A0, 0x050020, op_movec_aa,      1, 2, 0 },
+    { 0xFF00E0, 0x0500A0, op_movec_imm,     1, 2, 0 },
+    { 0xFFC0BF, 0x064000, op_do_ea,         2, 6, 0 },
+    { 0xFFC0BF, 0x060000, op_do_aa,         2, 6, 0 },
+    { 0xFF00F0, 0x060080, op_do_imm,        2, 6, 0 },
+    { 0xFFC0FF, 0x06C000, op_do_reg,        2, 6, 0 },
+    { 0xFFC0BF, 0x064020, op_rep_ea,        1, 4, 0 },
+    { 0xFFC0BF, 0x060020, op_rep_aa,        1, 4, 0 },
+    { 0xFF00F0, 0x0600A0, op_rep_imm,       1, 4, 0 },
+    { 0xFFC0FF, 0x06C020, op_rep_reg,       1, 4, 0 },
+    { 0xFF40C0, 0x074080, op_movem_ea,      1, 6, F_EA },
+    { 0xFF40C0, 0x070000, op_movem_aa,      1, 6, 0 },
+    { 0xFEC000, 0x080000, op_par_class2,    1, 2, F_EA | F_ALU },
+    { 0xFEC000, 0x088000, op_par_class2,    1, 2, F_EA | F_ALU },
+    { 0xFE4080, 0x084080, op_movep_ea,      1, 4, F_EA },
+    { 0xFE40C0, 0x084040, op_movep_p,       1, 6, F_EA },
+    { 0xFE40C0, 0x084000, op_movep_reg,     1, 4, 0 },
+    { 0xFFC0FF, 0x0AC080, op_jmp_ea,        1, 4, F_EA },
+    { 0xFFC0F0, 0x0AC0A0, op_jcc_ea,        1, 4, F_EA },
+    { 0xFFC0FF, 0x0BC080, dsp56k_op_jsr_ea, 1, 4, F_EA },
+    { 0xFFC0F0, 0x0BC0A0, op_jscc_ea,       1, 4, F_EA },
+    { 0xFEC080, 0x0A0000, op_bit_aa,        1, 4, 0 },
+    { 0xFEC080, 0x0A4000, op_bit_ea,        1, 4, F_EA },
+    { 0xFEC080, 0x0A8000, op_bit_pp,        1, 4, 0 },
+    { 0xFEC0C0, 0x0AC040, op_bit_reg,       1, 4, 0 },
+    { 0xFEC080, 0x0A0080, op_jbit_aa,       2, 6, 0 },
+    { 0xFEC080, 0x0A4080, op_jbit_ea,       2, 6, 0 },
+    { 0xFEC080, 0x0A8080, op_jbit_pp,       2, 6, 0 },
+    { 0xFEC0C0, 0x0AC000, op_jbit_reg,      2, 6, 0 },
+    { 0xFFF000, 0x0C0000, op_jmp,           1, 4, 0 },
+    { 0xFFF000, 0x0D0000, dsp56k_op_jsr,    1, 4, 0 },
+    { 0xFF0000, 0x0E0000, op_jcc,           1, 4, 0 },
+    { 0xFF0000, 0x0F0000, op_jscc,          1, 4, 0 },
+};
+
+/** Extension word and extra clocks of the effective address in bits 13-8 */
+static void decode_ea(dsp56k_insn_t *insn, uint32_t op)
+{
+    unsigned ea = OP_EA(op);
+
+    if (ea == EA_ABS || ea == EA_IMM) {
+        insn->words++;
+        insn->clocks += 2;
+    } else if ((ea >> 3) == 5 || (ea >> 3) == 7) {
+        insn->clocks += 2;
+    }
+}
+
+static void decode_illegal(dsp56k_insn_t *insn)
+{
+    insn->run = dsp56k_illegal;
+    insn->words = 1;
+    insn->clocks = 8;
+}
+
+static void decode_parallel(dsp56k_insn_t *insn, uint32_t op)
+{
+    insn->words = 1;
+    insn->clocks = 2;
+
+    if (op & 0x800000) {
+        insn->run = op_par_xy;
+    } else if ((op & 0xC00000) == 0x400000) {
+        insn->run = (op & 0xF40000) == 0x400000 ? op_par_long : op_par_mem;
+        if (op & 0x4000) {
+            decode_ea(insn, op);
+        }
+    } else if ((op & 0xE00000) == 0x200000) {
+        unsigned reg = (op >> 16) & 0x1F;
+
+        if (reg >= REG_X0) {
+            uint32_t imm = (op >> 8) & 0xFF;
+            bool frac = reg <= REG_Y1 || reg == REG_A || reg == REG_B;
+
+            insn->run = op_par_imm;
+            insn->ext = frac ? imm << 16 : imm;
+        } else if ((op & 0xFFFF00) == 0x200000) {
+            insn->run = op_par_none;
+        } else if ((op & 0xFFE000) == 0x204000) {
+            insn->run = op_par_update;
+        } else if ((op & 0xFC0000) == 0x200000) {
+            insn->run = op_par_reg;
+        } else {
+            decode_illegal(insn);
+        }
+    } else {
+        insn->run = (op & 0x4000) ? op_par_ry : op_par_xr;
+        decode_ea(insn, op);
+    }
+}
+
+void dsp56k_decode_op(dsp56k_insn_t *insn, uint32_t op, uint32_t ext)
+{
+    insn->op = op;
+    insn->ext = ext;
+    insn->alu = dsp56k_alu_table[op & 0xFF];
+
+    if (op & 0xF00000) {
+        decode_parallel(insn, op);
+        if (!insn->alu) {
+            decode_illegal(insn);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(s_opcodes) / sizeof(s_opcodes[0]); i++) {
+        const dsp56k_opcode_t *o = &s_opcodes[i];
+
+        if ((op & o->mask) == o->value) {
+            insn->run = o->run;
+            insn->words = o->words;
+            insn->clocks = o->clocks;
+            if (o->flags & F_EA) {
+                decode_ea(insn, op);
+            }
+            if ((o->flags & F_ALU) && !insn->alu) {
+                decode_illegal(insn);
+            }
+            return;
+        }
+    }
+    decode_illegal(insn);
+}
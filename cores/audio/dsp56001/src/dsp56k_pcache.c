@@ -0,0 +1,43 @@
+/**
+ * @file dsp56k_pcache.c
+ * @brief Decoded P-memory cache
+ *
+ * Slot (pc & mask) holds the decoding of P:pc when its tag is pc. Two
+ * words of an instruction are decoded together, so a write drops the slot
+ * of the word written and of the word before it.
+ */
+
+#include "dsp56k.h"
+
+const dsp56k_insn_t *dsp56k_decode(dsp56k_t *dsp, uint32_t pc)
+{
+    dsp56k_insn_t *insn = &dsp->pcache[pc & (DSP56K_PCACHE_WORDS - 1)];
+
+    dsp56k_decode_op(insn, dsp56k_read_p(dsp, pc), dsp56k_read_p(dsp, (pc + 1) & 0xFFFF));
+    insn->tag = (int32_t)pc;
+    dsp->stats.decodes++;
+    return insn;
+}
+
+void dsp56k_pcache_flush(dsp56k_t *dsp)
+{
+    for (int i = 0; i < DSP56K_PCACHE_WORDS; i++) {
+        dsp->pcache[i].tag = DSP56K_PCACHE_EMPTY;
+    }
+}
+
+static inline void dsp56k_pcache_drop(dsp56k_t *dsp, uint32_t addr)
+{
+    dsp56k_insn_t *insn = &dsp->pcache[addr & (DSP56K_PCACHE_WORDS - 1)];
+
+    if (insn->tag == (int32_t)addr) {
+        insn->tag = DSP56K_PCACHE_EMPTY;
+        dsp->stats.invalidations++;
+    }
+}
+
+void dsp56k_p_written(dsp56k_t *dsp, uint32_t addr)
+{
+    dsp56k_pcache_drop(dsp, addr);
+    dsp56k_pcache_drop(dsp, (addr - 1) & 0xFFFF);
+}
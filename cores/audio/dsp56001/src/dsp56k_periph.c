@@ -0,0 +1,377 @@
+/**
+ * @file dsp56k_periph.c
+ * @brief DSP56001 host interface and SSI, both sides
+ *
+ * The host side is only ever touched while the DSP is stopped at the host's
+ * time (see dsp56k_sync.c), so both sides work on the same registers
+ * without locks. The SSI runs on a clock of its own, the frame rate the
+ * Falcon crossbar gives it: one event per time slot, DC + 1 slots a frame.
+ * Slots 0 and 1 of each frame sent are the left and right samples queued
+ * for generate(); slots 0 and 1 received come from dsp56k_ssi_feed().
+ */
+
+#include <string.h>
+#include "dsp56k.h"
+
+#define PERIPH(dsp, addr)   ((dsp)->periph[(addr) - DSP56K_PERIPH_BASE])
+
+// ---------------------------------------------------------------------------
+// Interrupt conditions
+// ---------------------------------------------------------------------------
+
+void dsp56k_irq_update(dsp56k_t *dsp)
+{
+    uint32_t pending = 0;
+
+    if ((dsp->hcr & DSP56K_HCR_HCIE) && (dsp->hsr & DSP56K_HSR_HCP)) {
+        pending |= 1u << DSP56K_IRQ_HOST_CMD;
+    }
+    if ((dsp->hcr & DSP56K_HCR_HRIE) && (dsp->hsr & DSP56K_HSR_HRDF)) {
+        pending |= 1u << DSP56K_IRQ_HOST_RX;
+    }
+    if ((dsp->hcr & DSP56K_HCR_HTIE) && (dsp->hsr & DSP56K_HSR_HTDE)) {
+        pending |= 1u << DSP56K_IRQ_HOST_TX;
+    }
+    if ((dsp->crb & DSP56K_CRB_RIE) && (dsp->ssisr & DSP56K_SSISR_RDF)) {
+        pending |= 1u << ((dsp->ssisr & DSP56K_SSISR_ROE) ? DSP56K_IRQ_SSI_RX_EXC : DSP56K_IRQ_SSI_RX);
+    }
+    if ((dsp->crb & DSP56K_CRB_TIE) && (dsp->ssisr & DSP56K_SSISR_TDE)) {
+        pending |= 1u << ((dsp->ssisr & DSP56K_SSISR_TUE) ? DSP56K_IRQ_SSI_TX_EXC : DSP56K_IRQ_SSI_TX);
+    }
+    if (pending & ~dsp->pending) {
+        dsp56k_service_now(dsp);
+    }
+    dsp->pending = pending;
+}
+
+// ---------------------------------------------------------------------------
+// Host interface
+// ---------------------------------------------------------------------------
+
+/** Host TX to DSP HRX, if both sides allow */
+static void dsp56k_host_to_dsp(dsp56k_t *dsp)
+{
+    if (!(dsp->isr & DSP56K_ISR_TXDE) && !(dsp->hsr & DSP56K_HSR_HRDF)) {
+        dsp->hrx = ((uint32_t)dsp->tx[0] << 16) | ((uint32_t)dsp->tx[1] << 8) | dsp->tx[2];
+        dsp->hsr |= DSP56K_HSR_HRDF;
+        dsp->isr |= DSP56K_ISR_TXDE;
+    }
+}
+
+/** DSP HTX to host RX, if both sides allow */
+static void dsp56k_dsp_to_host(dsp56k_t *dsp)
+{
+    if (!(dsp->hsr & DSP56K_HSR_HTDE) && !(dsp->isr & DSP56K_ISR_RXDF)) {
+        dsp->rx[0] = (uint8_t)(dsp->htx >> 16);
+        dsp->rx[1] = (uint8_t)(dsp->htx >> 8);
+        dsp->rx[2] = (uint8_t)dsp->htx;
+        dsp->isr |= DSP56K_ISR_RXDF;
+        dsp->hsr |= DSP56K_HSR_HTDE;
+    }
+}
+
+static uint8_t dsp56k_host_isr(dsp56k_t *dsp)
+{
+    uint8_t isr = dsp->isr & (DSP56K_ISR_RXDF | DSP56K_ISR_TXDE);
+
+    if ((isr & DSP56K_ISR_TXDE) && !(dsp->hsr & DSP56K_HSR_HRDF)) {
+        isr |= DSP56K_ISR_TRDY;
+    }
+    if (dsp->hcr & DSP56K_HCR_HF2) {
+        isr |= DSP56K_ISR_HF2;
+    }
+    if (dsp->hcr & DSP56K_HCR_HF3) {
+        isr |= DSP56K_ISR_HF3;
+    }
+    if (((dsp->icr & DSP56K_ICR_RREQ) && (isr & DSP56K_ISR_RXDF)) ||
+        ((dsp->icr & DSP56K_ICR_TREQ) && (isr & DSP56K_ISR_TXDE))) {
+        isr |= DSP56K_ISR_HREQ;
+    }
+    return isr;
+}
+
+uint8_t dsp56k_host_read(dsp56k_t *dsp, uint32_t reg)
+{
+    uint8_t val = 0;
+
+    dsp56k_host_sync(dsp);
+    switch (reg & 7) {
+    case DSP56K_HOST_ICR:
+        val = dsp->icr;
+        break;
+    case DSP56K_HOST_CVR:
+        val = dsp->cvr;
+        break;
+    case DSP56K_HOST_ISR:
+        val = dsp56k_host_isr(dsp);
+        break;
+    case DSP56K_HOST_IVR:
+        val = dsp->ivr;
+        break;
+    case DSP56K_HOST_RXH:
+    case DSP56K_HOST_RXM:
+        val = dsp->rx[(reg & 7) - DSP56K_HOST_RXH];
+        break;
+    case DSP56K_HOST_RXL:
+        val = dsp->rx[2];
+        dsp->isr &= ~DSP56K_ISR_RXDF;
+        dsp56k_dsp_to_host(dsp);
+        dsp56k_irq_update(dsp);
+        break;
+    default:
+        break;
+    }
+    return val;
+}
+
+void dsp56k_host_write(dsp56k_t *dsp, uint32_t reg, uint8_t val)
+{
+    dsp56k_host_sync(dsp);
+    switch (reg & 7) {
+    case DSP56K_HOST_ICR:
+        dsp->icr = val & ~DSP56K_ICR_INIT;
+        dsp->hsr = (dsp->hsr & ~(DSP56K_HSR_HF0 | DSP56K_HSR_HF1)) |
+                   ((val & DSP56K_ICR_HF0) ? DSP56K_HSR_HF0 : 0) |
+                   ((val & DSP56K_ICR_HF1) ? DSP56K_HSR_HF1 : 0);
+        if (val & DSP56K_ICR_INIT) {
+            if (val & DSP56K_ICR_TREQ) {
+                dsp->isr |= DSP56K_ISR_TXDE;
+                dsp->hsr &= ~DSP56K_HSR_HRDF;
+            }
+            if (val & DSP56K_ICR_RREQ) {
+                dsp->isr &= ~DSP56K_ISR_RXDF;
+                dsp->hsr |= DSP56K_HSR_HTDE;
+            }
+        }
+        break;
+    case DSP56K_HOST_CVR:
+        dsp->cvr = val;
+        if (val & DSP56K_CVR_HC) {
+            dsp->hsr |= DSP56K_HSR_HCP;
+            dsp->host_vector = (uint8_t)((val & DSP56K_CVR_HV) * 2);
+        }
+        break;
+    case DSP56K_HOST_IVR:
+        dsp->ivr = val;
+        break;
+    case DSP56K_HOST_RXH:
+    case DSP56K_HOST_RXM:
+        dsp->tx[(reg & 7) - DSP56K_HOST_RXH] = val;
+        break;
+    case DSP56K_HOST_RXL:
+        dsp->tx[2] = val;
+        dsp->isr &= ~DSP56K_ISR_TXDE;
+        dsp56k_host_to_dsp(dsp);
+        break;
+    default:
+        break;
+    }
+    dsp56k_irq_update(dsp);
+    // Flags, boot words and commands are looked at before the next instruction
+    dsp56k_service_now(dsp);
+}
+
+// ---------------------------------------------------------------------------
+// SSI
+// ---------------------------------------------------------------------------
+
+/** Cycle slot @p n of the count is due */
+static uint64_t dsp56k_ssi_slot_time(dsp56k_t *dsp, uint64_t n)
+{
+    uint32_t slots = ((dsp->cra >> DSP56K_CRA_DC_SHIFT) & DSP56K_CRA_DC_MASK) + 1;
+
+    return dsp->ssi_base + n * dsp->config.dsp_hz / ((uint64_t)dsp->config.ssi_rate * slots);
+}
+
+/** Restart the slot clock after a control register write, slot 0 one slot later */
+static void dsp56k_ssi_configure(dsp56k_t *dsp)
+{
+    dsp->ssi_slot = 0;
+    dsp->ssi_slots = 0;
+    dsp->ssi_base = dsp->cycle;
+    if ((dsp->crb & (DSP56K_CRB_TE | DSP56K_CRB_RE)) && dsp->config.ssi_rate) {
+        dsp->ssi_next = dsp56k_ssi_slot_time(dsp, 1);
+    } else {
+        dsp->ssi_next = UINT64_MAX;
+    }
+    dsp56k_service_now(dsp);
+}
+
+void dsp56k_periph_event(dsp56k_t *dsp)
+{
+    uint32_t slots = ((dsp->cra >> DSP56K_CRA_DC_SHIFT) & DSP56K_CRA_DC_MASK) + 1;
+    uint32_t slot = dsp->ssi_slot;
+
+    if (dsp->crb & DSP56K_CRB_TE) {
+        if (dsp->ssisr & DSP56K_SSISR_TDE) {
+            dsp->ssisr |= DSP56K_SSISR_TUE;
+        } else {
+            dsp->ssi_shift = dsp->ssi_tx;
+            dsp->ssisr |= DSP56K_SSISR_TDE;
+        }
+        if (slot < 2) {
+            dsp->ssi_frame[slot] = (int16_t)(dsp56k_sx24(dsp->ssi_shift) >> 8);
+        }
+    }
+    if (dsp->crb & DSP56K_CRB_RE) {
+        if (slot == 0) {
+            uint32_t tail = dsp->in_tail;
+
+            if (tail != __atomic_load_n(&dsp->in_head, __ATOMIC_ACQUIRE)) {
+                memcpy(dsp->ssi_in, dsp->in_ring[tail & (DSP56K_SSI_RING - 1)], sizeof(dsp->ssi_in));
+                __atomic_store_n(&dsp->in_tail, tail + 1, __ATOMIC_RELEASE);
+            } else {
+                memset(dsp->ssi_in, 0, sizeof(dsp->ssi_in));
+            }
+        }
+        if (dsp->ssisr & DSP56K_SSISR_RDF) {
+            dsp->ssisr |= DSP56K_SSISR_ROE;
+        }
+        dsp->ssi_rx = slot < 2 ? ((uint32_t)dsp->ssi_in[slot] << 8) & 0xFFFFFF : 0;
+        dsp->ssisr |= DSP56K_SSISR_RDF;
+    }
+    if (slot == 0) {
+        dsp->ssisr |= DSP56K_SSISR_TFS | DSP56K_SSISR_RFS;
+    } else {
+        dsp->ssisr &= ~(DSP56K_SSISR_TFS | DSP56K_SSISR_RFS);
+    }
+
+    if (++slot >= slots) {
+        slot = 0;
+        if (dsp->crb & DSP56K_CRB_TE) {
+            uint32_t head = dsp->out_head;
+
+            // A full ring means nobody is listening: drop rather than stall the DSP
+            if (head - __atomic_load_n(&dsp->out_tail, __ATOMIC_ACQUIRE) < DSP56K_SSI_RING) {
+                memcpy(dsp->out_ring[head & (DSP56K_SSI_RING - 1)], dsp->ssi_frame, sizeof(dsp->ssi_frame));
+                __atomic_store_n(&dsp->out_head, head + 1, __ATOMIC_RELEASE);
+            }
+        }
+        dsp->stats.ssi_frames++;
+    }
+    dsp->ssi_slot = slot;
+    dsp->ssi_slots++;
+    dsp->ssi_next = dsp56k_ssi_slot_time(dsp, dsp->ssi_slots + 1);
+    dsp56k_irq_update(dsp);
+}
+
+int dsp56k_ssi_generate(dsp56k_t *dsp, int16_t *out, int frames)
+{
+    uint32_t tail = dsp->out_tail;
+    uint32_t avail = __atomic_load_n(&dsp->out_head, __ATOMIC_ACQUIRE) - tail;
+    int n = frames < (int)avail ? frames : (int)avail;
+
+    for (int i = 0; i < n; i++) {
+        memcpy(out + 2 * i, dsp->out_ring[(tail + i) & (DSP56K_SSI_RING - 1)], 2 * sizeof(int16_t));
+    }
+    __atomic_store_n(&dsp->out_tail, tail + n, __ATOMIC_RELEASE);
+    if (n < frames) {
+        memset(out + 2 * n, 0, (size_t)(frames - n) * 2 * sizeof(int16_t));
+        dsp->stats.ssi_underruns += frames - n;
+    }
+    return n;
+}
+
+int dsp56k_ssi_feed(dsp56k_t *dsp, const int16_t *in, int frames)
+{
+    uint32_t head = dsp->in_head;
+    uint32_t space = DSP56K_SSI_RING - (head - __atomic_load_n(&dsp->in_tail, __ATOMIC_ACQUIRE));
+    int n = frames < (int)space ? frames : (int)space;
+
+    for (int i = 0; i < n; i++) {
+        memcpy(dsp->in_ring[(head + i) & (DSP56K_SSI_RING - 1)], in + 2 * i, 2 * sizeof(int16_t));
+    }
+    __atomic_store_n(&dsp->in_head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// DSP side
+// ---------------------------------------------------------------------------
+
+uint32_t dsp56k_periph_read(dsp56k_t *dsp, uint32_t addr)
+{
+    uint32_t val;
+
+    switch (addr) {
+    case DSP56K_HCR:
+        return dsp->hcr;
+    case DSP56K_HSR:
+        return dsp->hsr;
+    case DSP56K_HRX:
+        val = dsp->hrx;
+        dsp->hsr &= ~DSP56K_HSR_HRDF;
+        dsp56k_host_to_dsp(dsp);
+        dsp56k_irq_update(dsp);
+        return val;
+    case DSP56K_CRA:
+        return dsp->cra;
+    case DSP56K_CRB:
+        return dsp->crb;
+    case DSP56K_SSISR:
+        return dsp->ssisr;
+    case DSP56K_SSI_RX:
+        dsp->ssisr &= ~(DSP56K_SSISR_RDF | DSP56K_SSISR_ROE);
+        dsp56k_irq_update(dsp);
+        return dsp->ssi_rx;
+    default:
+        return PERIPH(dsp, addr);
+    }
+}
+
+void dsp56k_periph_write(dsp56k_t *dsp, uint32_t addr, uint32_t val)
+{
+    switch (addr) {
+    case DSP56K_HCR:
+        dsp->hcr = (uint8_t)(val & 0x1F);
+        break;
+    case DSP56K_HSR:
+        // HF0-HF1 belong to the host, HRDF, HTDE and HCP to the port
+        break;
+    case DSP56K_HRX:
+        dsp->htx = val;
+        dsp->hsr &= ~DSP56K_HSR_HTDE;
+        dsp56k_dsp_to_host(dsp);
+        break;
+    case DSP56K_CRA:
+        dsp->cra = val;
+        dsp56k_ssi_configure(dsp);
+        break;
+    case DSP56K_CRB:
+        dsp->crb = val;
+        dsp56k_ssi_configure(dsp);
+        break;
+    case DSP56K_SSISR:
+        break;
+    case DSP56K_SSI_RX:
+        dsp->ssi_tx = val;
+        dsp->ssisr &= ~(DSP56K_SSISR_TDE | DSP56K_SSISR_TUE);
+        break;
+    case DSP56K_IPR:
+        PERIPH(dsp, addr) = val;
+        dsp56k_service_now(dsp);
+        break;
+    default:
+        PERIPH(dsp, addr) = val;
+        break;
+    }
+    dsp56k_irq_update(dsp);
+}
+
+void dsp56k_periph_reset(dsp56k_t *dsp)
+{
+    memset(dsp->periph, 0, sizeof(dsp->periph));
+    dsp->hcr = 0;
+    dsp->hsr = DSP56K_HSR_HTDE;
+    dsp->icr = 0;
+    dsp->cvr = DSP56K_VEC_HOST_CMD / 2;
+    dsp->isr = DSP56K_ISR_TXDE;
+    dsp->ivr = 0x0F;
+    dsp->host_vector = DSP56K_VEC_HOST_CMD;
+    dsp->cra = 0;
+    dsp->crb = 0;
+    dsp->ssisr = DSP56K_SSISR_TDE;
+    dsp->ssi_slot = 0;
+    dsp->ssi_next = UINT64_MAX;
+    dsp->pending = 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file dsp56k_sync.c
+ * @brief Lock-step between the host CPU and a DSP on another core
+ *
+ * The host publishes how far it has got as the horizon; the DSP core runs
+ * up to it and publishes where it stopped. The DSP never runs ahead, so
+ * whatever the host reads from the port is what it would read on a real
+ * Falcon at that cycle. The host only waits when the DSP falls more than
+ * the window behind, or when it touches the host port: that needs the DSP
+ * to have caught up, after which the DSP stays idle until the horizon
+ * moves again and the host has the state to itself.
+ *
+ * Without dsp56k_start_async() everything runs inline in the host's
+ * dsp56k_host_clock() calls.
+ */
+
+#include "dsp56k.h"
+
+static inline uint64_t dsp56k_dsp_time(dsp56k_t *dsp)
+{
+    return __atomic_load_n(&dsp->dsp_time, __ATOMIC_ACQUIRE);
+}
+
+void dsp56k_host_clock(dsp56k_t *dsp, int host_cycles)
+{
+    dsp->host_frac += (uint64_t)host_cycles * dsp->config.dsp_hz;
+    dsp->host_time += dsp->host_frac / dsp->config.host_hz;
+    dsp->host_frac %= dsp->config.host_hz;
+
+    if (!dsp->async) {
+        dsp56k_execute(dsp, dsp->host_time);
+        return;
+    }
+    __atomic_store_n(&dsp->horizon, dsp->host_time, __ATOMIC_RELEASE);
+    if (dsp56k_dsp_time(dsp) + dsp->config.window < dsp->host_time) {
+        dsp->stats.window_waits++;
+        while (dsp56k_dsp_time(dsp) + dsp->config.window < dsp->host_time) {
+        }
+    }
+}
+
+void dsp56k_host_sync(dsp56k_t *dsp)
+{
+    if (!dsp->async) {
+        return;
+    }
+    if (dsp56k_dsp_time(dsp) < dsp->host_time) {
+        dsp->stats.host_waits++;
+        while (dsp56k_dsp_time(dsp) < dsp->host_time) {
+        }
+    }
+}
+
+void dsp56k_start_async(dsp56k_t *dsp)
+{
+    dsp->async = true;
+    __atomic_store_n(&dsp->dsp_time, dsp->cycle, __ATOMIC_RELAXED);
+    __atomic_store_n(&dsp->horizon, dsp->host_time, __ATOMIC_RELEASE);
+}
+
+int dsp56k_run_async(dsp56k_t *dsp)
+{
+    uint64_t horizon = __atomic_load_n(&dsp->horizon, __ATOMIC_ACQUIRE);
+    uint64_t start = dsp->cycle;
+
+    if (start >= horizon) {
+        return 0;
+    }
+    dsp56k_execute(dsp, horizon - start > DSP56K_ASYNC_CHUNK ? start + DSP56K_ASYNC_CHUNK : horizon);
+    __atomic_store_n(&dsp->dsp_time, dsp->cycle, __ATOMIC_RELEASE);
+    return (int)(dsp->cycle - start);
+}
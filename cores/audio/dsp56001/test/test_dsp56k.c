@@ -0,0 +1,415 @@
+/**
+ * @file test_dsp56k.c
+ * @brief DSP56001 core: ALU and flags, addressing, loops, decode cache,
+ *        host port, SSI and interrupts
+ *
+ * Programs are hand-assembled; the comment next to each word is its
+ * source line.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "dsp56k.h"
+
+#define SIM_RATE        48000
+
+static dsp56k_t s_dsp;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void sim_init(bool boot_from_host)
+{
+    dsp56k_config_t config = {
+        .dsp_hz = DSP56K_CLOCK_HZ,
+        .host_hz = DSP56K_HOST_HZ,
+        .ssi_rate = SIM_RATE,
+        .boot_from_host = boot_from_host,
+    };
+
+    dsp56k_init(&s_dsp, &config);
+}
+
+static void sim_load(uint32_t addr, const uint32_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dsp56k_write_p(&s_dsp, addr + (uint32_t)i, words[i]);
+    }
+}
+
+#define SIM_LOAD(addr, program)     sim_load(addr, program, sizeof(program) / sizeof(program[0]))
+
+static void sim_run(uint64_t clocks)
+{
+    dsp56k_execute(&s_dsp, s_dsp.cycle + clocks);
+}
+
+static uint16_t sim_sr(void)
+{
+    return dsp56k_get_sr(&s_dsp);
+}
+
+static void test_alu_mac_and_flags(void)
+{
+    static const uint32_t program[] = {
+        0x44F400, 0x400000,     // move #>$400000,x0
+        0x46F400, 0x200000,     // move #>$200000,y0
+        0x2000D0,               // mpy x0,y0,a
+        0x2000D2,               // mac x0,y0,a
+        0x57F400, 0x7FFFFF,     // move #>$7fffff,b
+        0x200048,               // add x0,b
+        0x0C0009,               // jmp *
+    };
+
+    sim_init(false);
+    SIM_LOAD(0, program);
+    sim_run(40);
+
+    /* 0.5 x 0.25 twice */
+    TEST_ASSERT_EQUAL_INT64(0x200000LL << 24, s_dsp.acc[0]);
+    /* Past +1.0 into the extension: E, not V */
+    TEST_ASSERT_EQUAL_INT64(0xBFFFFFLL << 24, s_dsp.acc[1]);
+    TEST_ASSERT_EQUAL_HEX16(DSP56K_SR_E, sim_sr() & (DSP56K_SR_E | DSP56K_SR_V | DSP56K_SR_N | DSP56K_SR_Z));
+    /* Moved out, B is limited and L latches */
+    TEST_ASSERT_EQUAL_HEX32(0x7FFFFF, dsp56k_acc_limit24(&s_dsp, s_dsp.acc[1]));
+
+    /* Compare, subtract below zero, convergent rounding */
+    static const uint32_t more[] = {
+        0x200013,               // clr a
+        0x200045,               // cmp x0,a
+        0x200044,               // sub x0,a
+        0x200011,               // rnd a
+        0x0C0004,               // jmp *
+    };
+    sim_init(false);
+    SIM_LOAD(0, more);
+    s_dsp.xy[0] = 0x400000;
+    sim_run(2);
+    TEST_ASSERT_EQUAL_HEX16(DSP56K_SR_Z | DSP56K_SR_U, sim_sr() & (DSP56K_SR_Z | DSP56K_SR_U | DSP56K_SR_N));
+    sim_run(2);
+    TEST_ASSERT_EQUAL_HEX16(DSP56K_SR_N | DSP56K_SR_C, sim_sr() & (DSP56K_SR_N | DSP56K_SR_C | DSP56K_SR_Z));
+    sim_run(4);
+    TEST_ASSERT_EQUAL_INT64(-(0x400000LL << 24), s_dsp.acc[0]);
+
+    s_dsp.acc[0] = 0x1800000;           // 1.5 LSBs of A1 rounds up to 2
+    s_dsp.pc = 3;
+    sim_run(2);
+    TEST_ASSERT_EQUAL_INT64(0x2000000, s_dsp.acc[0]);
+    s_dsp.acc[0] = 0x2800000;           // 2.5 rounds to even
+    s_dsp.pc = 3;
+    sim_run(2);
+    TEST_ASSERT_EQUAL_INT64(0x2000000, s_dsp.acc[0]);
+}
+
+static void test_division(void)
+{
+    static const uint32_t program[] = {
+        0x0600A0 | (24 << 8),   // rep #24
+        0x018040,               // div x0,a
+        0x0C0002,               // jmp *
+    };
+
+    /* 0.125 / 0.5 = 0.25 in A0 after 24 steps, the carry bit first cleared */
+    sim_init(false);
+    SIM_LOAD(0, program);
+    s_dsp.acc[0] = 0x100000LL << 24;
+    s_dsp.xy[0] = 0x400000;
+    s_dsp.sr &= ~DSP56K_SR_C;
+    sim_run(60);
+    TEST_ASSERT_EQUAL_HEX32(0x200000, (uint32_t)s_dsp.acc[0] & 0xFFFFFF);
+}
+
+static void test_modulo_and_reverse_addressing(void)
+{
+    static const uint32_t program[] = {
+        0x300000,               // move #0,r0
+        0x0503A0,               // movec #3,m0
+        0x445800,               // move x0,x:(r0)+
+        0x445800,               // move x0,x:(r0)+
+        0x445800,               // move x0,x:(r0)+
+        0x445800,               // move x0,x:(r0)+
+        0x445800,               // move x0,x:(r0)+
+        0x0C0007,               // jmp *
+    };
+
+    sim_init(false);
+    SIM_LOAD(0, program);
+    s_dsp.xy[0] = 0x123456;
+    sim_run(30);
+
+    /* Modulo 4 from 0: five writes wrap to 1 */
+    TEST_ASSERT_EQUAL_UINT16(1, s_dsp.r[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x123456, s_dsp.x_int[3]);
+    TEST_ASSERT_EQUAL_HEX32(0, s_dsp.x_int[4]);
+
+    /* Bit-reversed by N = 4 over 8 points: 0 4 2 6 1 5 3 7 */
+    static const uint32_t fft[] = {
+        0x300000,               // move #0,r0
+        0x380400,               // move #4,n0
+        0x0500A0,               // movec #0,m0
+        0x204800,               // move (r0)+n0
+        0x0C0004,               // jmp *
+    };
+    static const uint16_t order[] = { 4, 2, 6, 1, 5, 3, 7, 0 };
+    sim_init(false);
+    SIM_LOAD(0, fft);
+    sim_run(6);
+    for (int i = 0; i < 8; i++) {
+        s_dsp.pc = 3;
+        sim_run(2);
+        TEST_ASSERT_EQUAL_UINT16(order[i], s_dsp.r[0]);
+    }
+}
+
+static void test_do_rep_and_subroutines(void)
+{
+    static const uint32_t program[] = {
+        0x200013,               // clr a
+        0x241000,               // move #$10,x0
+        0x060580, 0x000005,     // do #5,_end
+        0x0D0010,               // jsr $10
+        0x200040,               // add x0,a      _end
+        0x0603A0,               // rep #3
+        0x200040,               // add x0,a
+        0x0C0008,               // jmp *
+    };
+    static const uint32_t sub[] = {
+        0x200048,               // add x0,b
+        0x00000C,               // rts
+    };
+
+    sim_init(false);
+    SIM_LOAD(0, program);
+    SIM_LOAD(0x10, sub);
+    sim_run(200);
+
+    /* Five passes through the loop and its call, then three more adds */
+    TEST_ASSERT_EQUAL_INT64(8 * (0x100000LL << 24), s_dsp.acc[0]);
+    TEST_ASSERT_EQUAL_INT64(5 * (0x100000LL << 24), s_dsp.acc[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, s_dsp.sp & DSP56K_SP_PTR);
+    TEST_ASSERT_FALSE(s_dsp.sr & DSP56K_SR_LF);
+    TEST_ASSERT_EQUAL_UINT32(8, s_dsp.pc);
+}
+
+static void test_self_modifying_code(void)
+{
+    static const uint32_t program[] = {
+        0x0D0010,               // jsr $10
+        0x47F400, 0x200040,     // move #>$200040,y1   (add x0,a)
+        0x071007,               // movem y1,p:$10
+        0x0D0010,               // jsr $10
+        0x477000, 0x004100,     // move y1,x:$4100      P:$4100 through the X alias
+        0x0BF080, 0x004100,     // jsr >$4100
+        0x0C0009,               // jmp *
+    };
+    static const uint32_t sub[] = {
+        0x000000,               // nop
+        0x00000C,               // rts
+    };
+
+    sim_init(false);
+    SIM_LOAD(0, program);
+    SIM_LOAD(0x10, sub);
+    s_dsp.ext[0x4100] = 0x000000;           // nop
+    s_dsp.ext[0x4101] = 0x00000C;           // rts
+    s_dsp.xy[0] = 0x100000;
+
+    /* Run the nop at $4100 once first, so the cache holds it */
+    s_dsp.pc = 7;
+    sim_run(14);
+    TEST_ASSERT_EQUAL_UINT32(9, s_dsp.pc);
+    TEST_ASSERT_EQUAL_INT64(0, s_dsp.acc[0]);
+
+    s_dsp.pc = 0;
+    sim_run(60);
+    TEST_ASSERT_EQUAL_UINT32(9, s_dsp.pc);
+    TEST_ASSERT_EQUAL_INT64(2 * (0x100000LL << 24), s_dsp.acc[0]);
+    TEST_ASSERT_TRUE(s_dsp.stats.invalidations >= 2);
+}
+
+static void host_write_word(uint32_t word)
+{
+    dsp56k_host_write(&s_dsp, DSP56K_HOST_RXH, (uint8_t)(word >> 16));
+    dsp56k_host_write(&s_dsp, DSP56K_HOST_RXM, (uint8_t)(word >> 8));
+    dsp56k_host_write(&s_dsp, DSP56K_HOST_RXL, (uint8_t)word);
+}
+
+static uint32_t host_read_word(void)
+{
+    uint32_t word = (uint32_t)dsp56k_host_read(&s_dsp, DSP56K_HOST_RXH) << 16;
+
+    word |= (uint32_t)dsp56k_host_read(&s_dsp, DSP56K_HOST_RXM) << 8;
+    return word | dsp56k_host_read(&s_dsp, DSP56K_HOST_RXL);
+}
+
+/** Host clocks until the host sees @p bit in ISR, or a few thousand */
+static bool host_wait(uint8_t bit)
+{
+    for (int i = 0; i < 1000; i++) {
+        if (dsp56k_host_read(&s_dsp, DSP56K_HOST_ISR) & bit) {
+            return true;
+        }
+        dsp56k_host_clock(&s_dsp, 4);
+    }
+    return false;
+}
+
+static void test_host_boot_and_echo(void)
+{
+    static const uint32_t program[] = {
+        0x0AA980, 0x000000,     // jclr #0,x:$ffe9,*
+        0x56F000, 0x00FFEB,     // move x:$ffeb,a
+        0x200032,               // asl a
+        0x0AA981, 0x000005,     // jclr #1,x:$ffe9,*
+        0x567000, 0x00FFEB,     // move a,x:$ffeb
+        0x0C0000,               // jmp $0
+    };
+
+    sim_init(true);
+    for (size_t i = 0; i < sizeof(program) / sizeof(program[0]); i++) {
+        TEST_ASSERT_TRUE(host_wait(DSP56K_ISR_TXDE));
+        host_write_word(program[i]);
+    }
+    /* HF0 ends the bootstrap early */
+    dsp56k_host_write(&s_dsp, DSP56K_HOST_ICR, DSP56K_ICR_HF0);
+    dsp56k_host_clock(&s_dsp, 8);
+    TEST_ASSERT_FALSE(s_dsp.booting);
+    dsp56k_host_write(&s_dsp, DSP56K_HOST_ICR, 0);
+
+    for (uint32_t word = 0x000123; word < 0x100000; word = word * 5 + 1) {
+        TEST_ASSERT_TRUE(host_wait(DSP56K_ISR_TXDE));
+        host_write_word(word);
+        TEST_ASSERT_TRUE(host_wait(DSP56K_ISR_RXDF));
+        TEST_ASSERT_EQUAL_HEX32(word * 2, host_read_word());
+    }
+    /* The loop was decoded once */
+    TEST_ASSERT_TRUE(s_dsp.stats.decodes < 16);
+}
+
+static void test_ssi_fast_interrupt_to_generate(void)
+{
+    static const uint32_t program[] = {
+        0x300000,               // move #0,r0
+        0x0501A0,               // movec #1,m0
+        0x08F4BF, 0x003000,     // movep #$3000,x:$ffff     SSI at level 2
+        0x08F4AC, 0x006100,     // movep #$6100,x:$ffec     24 bits, 2 slots
+        0x08F4AD, 0x005000,     // movep #$5000,x:$ffed     TE, TIE
+        0x00FCB8,               // andi #$fc,mr
+        0x0C0009,               // jmp *
+    };
+    static const uint32_t vector[] = {
+        0x08D8AF,               // movep x:(r0)+,x:$ffef
+        0x000000,               // nop
+        0x08D8AF,               // movep x:(r0)+,x:$ffef    underrun
+        0x000000,               // nop
+    };
+    int16_t out[2 * 256];
+
+    sim_init(false);
+    SIM_LOAD(0, program);
+    SIM_LOAD(DSP56K_VEC_SSI_TX, vector);
+    s_dsp.x_int[0] = 0x123400;
+    s_dsp.x_int[1] = 0xEDCC00;
+
+    /* A little over 5 ms of 68030 time */
+    for (int i = 0; i < 101; i++) {
+        dsp56k_host_clock(&s_dsp, DSP56K_HOST_HZ / 20000);
+    }
+    TEST_ASSERT_EQUAL(240, dsp56k_ssi_generate(&s_dsp, out, 240));
+    for (int i = 0; i < 240; i++) {
+        TEST_ASSERT_EQUAL_HEX16(0x1234, (uint16_t)out[2 * i]);
+        TEST_ASSERT_EQUAL_HEX16(0xEDCC, (uint16_t)out[2 * i + 1]);
+    }
+    TEST_ASSERT_TRUE(s_dsp.stats.interrupts >= 480);
+    TEST_ASSERT_FALSE(s_dsp.ssisr & DSP56K_SSISR_TUE);
+
+    /* Past what the DSP has sent the block is silence, counted */
+    int n = dsp56k_ssi_generate(&s_dsp, out, 16);
+    TEST_ASSERT_TRUE(n < 16);
+    TEST_ASSERT_EQUAL(16 - n, s_dsp.stats.ssi_underruns);
+    TEST_ASSERT_EQUAL(0, out[31]);
+}
+
+static void test_host_command_long_interrupt(void)
+{
+    static const uint32_t program[] = {
+        0x0AA822,               // bset #2,x:$ffe8          HCIE
+        0x08F4BF, 0x000C00,     // movep #$0c00,x:$ffff     host at level 2
+        0x00FCB8,               // andi #$fc,mr
+        0x0C0004,               // jmp *
+    };
+    static const uint32_t handler[] = {
+        0x200040,               // add x0,a
+        0x000004,               // rti
+    };
+
+    sim_init(false);
+    SIM_LOAD(0, program);
+    dsp56k_write_p(&s_dsp, 0x2A, 0x0D0040);     // jsr $40
+    SIM_LOAD(0x40, handler);
+    s_dsp.xy[0] = 0x100000;
+    dsp56k_host_clock(&s_dsp, 16);
+    TEST_ASSERT_EQUAL_UINT32(4, s_dsp.pc);
+
+    /* Vector $2A is HV = $15 */
+    dsp56k_host_write(&s_dsp, DSP56K_HOST_CVR, DSP56K_CVR_HC | 0x15);
+    TEST_ASSERT_TRUE(dsp56k_host_read(&s_dsp, DSP56K_HOST_CVR) & DSP56K_CVR_HC);
+    dsp56k_host_clock(&s_dsp, 16);
+    TEST_ASSERT_FALSE(dsp56k_host_read(&s_dsp, DSP56K_HOST_CVR) & DSP56K_CVR_HC);
+    TEST_ASSERT_EQUAL_INT64(0x100000LL << 24, s_dsp.acc[0]);
+    TEST_ASSERT_EQUAL_UINT32(4, s_dsp.pc);
+    TEST_ASSERT_EQUAL_UINT8(0, s_dsp.sp & DSP56K_SP_PTR);
+    TEST_ASSERT_EQUAL_HEX16(0, s_dsp.sr & DSP56K_SR_I);
+    TEST_ASSERT_EQUAL(1, s_dsp.stats.interrupts);
+}
+
+static void test_lock_step(void)
+{
+    static const uint32_t program[] = {
+        0x0D0010,               // jsr $10
+        0x0C0001,               // jmp *
+    };
+
+    sim_init(false);
+    SIM_LOAD(0, program);
+    dsp56k_start_async(&s_dsp);
+
+    /* The DSP runs nothing until the host has, then exactly as far */
+    TEST_ASSERT_EQUAL(0, dsp56k_run_async(&s_dsp));
+    dsp56k_host_clock(&s_dsp, 3);
+    TEST_ASSERT_EQUAL(6, dsp56k_run_async(&s_dsp));
+    TEST_ASSERT_EQUAL(0, dsp56k_run_async(&s_dsp));
+    TEST_ASSERT_EQUAL_UINT64(6, s_dsp.host_time);
+
+    /* Chunked: a long host slice takes several calls */
+    dsp56k_host_clock(&s_dsp, DSP56K_ASYNC_CHUNK);
+    int total = 0, calls = 0, n;
+    while ((n = dsp56k_run_async(&s_dsp)) > 0) {
+        total += n;
+        calls++;
+    }
+    TEST_ASSERT_EQUAL(2 * DSP56K_ASYNC_CHUNK, total);
+    TEST_ASSERT_EQUAL(2, calls);
+    TEST_ASSERT_EQUAL_UINT64(s_dsp.host_time, s_dsp.dsp_time);
+    TEST_ASSERT_EQUAL(0, s_dsp.stats.window_waits);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_alu_mac_and_flags);
+    RUN_TEST(test_division);
+    RUN_TEST(test_modulo_and_reverse_addressing);
+    RUN_TEST(test_do_rep_and_subroutines);
+    RUN_TEST(test_self_modifying_code);
+    RUN_TEST(test_host_boot_and_echo);
+    RUN_TEST(test_ssi_fast_interrupt_to_generate);
+    RUN_TEST(test_host_command_long_interrupt);
+    RUN_TEST(test_lock_step);
+    return UNITY_END();
+}
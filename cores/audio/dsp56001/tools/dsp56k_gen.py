@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""
+Generate the DSP56001 internal data ROMs.
+
+- dsp56k_rom_x: X:$0100-$01FF, the positive halves of the G.711 expansion
+  tables, 128 words of mu-law then 128 of A-law. Entry i is the linear
+  magnitude of code byte i (mu-law bits inverted, A-law bits XORed with
+  $55, as they come off the line) as a 24-bit fraction.
+- dsp56k_rom_y: Y:$0100-$01FF, one full cycle of a sine in 256 points,
+  scaled to the largest positive 24-bit fraction.
+
+Generated rather than computed at init because an EBIN resolves no
+symbols against the firmware, libm included.
+
+Usage: dsp56k_gen.py --output <dsp56k_rom.c>
+"""
+
+import argparse
+import math
+
+ROM_WORDS = 256             # Must match DSP56K_ROM_WORDS in src/dsp56k.h
+FRAC_MAX = 0x7FFFFF
+
+
+def mulaw_magnitude(code):
+    """16-bit linear magnitude of a mu-law code byte, sign ignored"""
+    u = ~code & 0x7F
+    exponent = (u >> 4) & 7
+    mantissa = u & 0x0F
+    return (((mantissa << 3) + 0x84) << exponent) - 0x84
+
+
+def alaw_magnitude(code):
+    """16-bit linear magnitude of an A-law code byte, sign ignored"""
+    a = (code ^ 0x55) & 0x7F
+    exponent = (a >> 4) & 7
+    mantissa = a & 0x0F
+    if exponent == 0:
+        return (mantissa << 4) + 8
+    return ((mantissa << 4) + 0x108) << (exponent - 1)
+
+
+def x_rom():
+    return [mulaw_magnitude(i) << 8 for i in range(128)] + [alaw_magnitude(i) << 8 for i in range(128)]
+
+
+def y_rom():
+    return [round(FRAC_MAX * math.sin(2 * math.pi * i / ROM_WORDS)) & 0xFFFFFF for i in range(ROM_WORDS)]
+
+
+def c_rows(rows, per_line):
+    out = []
+    for i in range(0, len(rows), per_line):
+        out.append("    " + ", ".join("0x%06X" % v for v in rows[i:i + per_line]) + ",")
+    return "\n".join(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("--output", required=True)
+    args = ap.parse_args()
+
+    assert len(x_rom()) == ROM_WORDS and max(x_rom()) <= FRAC_MAX
+    lines = [
+        "/* Generated by tools/dsp56k_gen.py, do not edit */",
+        "",
+        "#include \"dsp56k.h\"",
+        "",
+        "const uint32_t dsp56k_rom_x[DSP56K_ROM_WORDS] = {",
+        c_rows(x_rom(), 8),
+        "};",
+        "",
+        "const uint32_t dsp56k_rom_y[DSP56K_ROM_WORDS] = {",
+        c_rows(y_rom(), 8),
+        "};",
+        "",
+    ]
+    with open(args.output, "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
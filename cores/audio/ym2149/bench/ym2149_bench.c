@@ -0,0 +1,171 @@
+/**
+ * @file ym2149_bench.c
+ * @brief Host benchmark for the YM2149 renderer
+ *
+ * Plays the register-dump tunes of the unit tests, a digidrum (level
+ * rewritten at 8 kHz) and a worst case with every source live at its
+ * fastest rate through ym2149_generate() one 50 Hz frame at a time, and
+ * reports host cycles per output sample, the figure that carries over to
+ * the ESP32-P4, with the share of a 400 MHz core that makes at 48 kHz.
+ *
+ * Usage: ym2149_bench [host_mhz] [seconds]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ym2149.h"
+#include "ym2149_tunes.h"
+
+#define BENCH_RATE          48000
+#define BENCH_FRAME_CYCLES  160000      /**< 50 Hz VBL */
+#define BENCH_FRAME_SAMPLES (BENCH_RATE / 50)
+#define BENCH_P4_CLOCK_MHZ  400.0
+#define BENCH_PASSES        5           /**< Best of, to ride out host noise */
+
+typedef void (*bench_frame_fn)(ym2149_t *ym, int frame);
+
+static ym2149_t s_ym;
+static int16_t s_out[BENCH_FRAME_SAMPLES * 2];
+static const ym2149_tune_t *s_tune;
+
+/** Host clock from /proc/cpuinfo, 0 if unknown */
+static double bench_host_mhz(void)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0.0;
+
+    if (!f) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "cpu MHz", 7) == 0) {
+            const char *colon = strchr(line, ':');
+            if (colon) {
+                mhz = atof(colon + 1);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    return mhz;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_tune_frame(ym2149_t *ym, int frame)
+{
+    const uint8_t *regs = s_tune->regs[frame % YM2149_TUNE_FRAMES];
+
+    for (int reg = 0; reg < 14; reg++) {
+        if (reg != YM2149_R_ENV_SHAPE || regs[reg] != 0xFF) {
+            ym2149_write(ym, (uint8_t)reg, regs[reg]);
+        }
+    }
+    ym2149_clock(ym, BENCH_FRAME_CYCLES);
+}
+
+/** 160 level writes per frame, one per 8 kHz timer interrupt */
+static void bench_digidrum_frame(ym2149_t *ym, int frame)
+{
+    static uint8_t levels[160];
+
+    if (!frame) {
+        ym2149_write(ym, YM2149_R_MIXER, 0x3F);
+        for (int i = 0; i < 160; i++) {
+            levels[i] = (uint8_t)lrint(11 + 4 * sin(2 * M_PI * i / 16));
+        }
+    }
+    for (int i = 0; i < 160; i++) {
+        ym2149_write(ym, YM2149_R_LEVEL_A, levels[i]);
+        ym2149_clock(ym, BENCH_FRAME_CYCLES / 160);
+    }
+}
+
+/** Tones at 62.5 kHz, noise at 125 kHz and an envelope step every tick */
+static void bench_worst_frame(ym2149_t *ym, int frame)
+{
+    if (!frame) {
+        static const uint8_t regs[14] = { 2, 0, 2, 0, 3, 0, 1, 0x00, 0x10, 15, 15, 1, 0, 0x0A };
+
+        for (int reg = 0; reg < 14; reg++) {
+            ym2149_write(ym, (uint8_t)reg, regs[reg]);
+        }
+    }
+    ym2149_clock(ym, BENCH_FRAME_CYCLES);
+}
+
+/**
+ * @return Host seconds per output sample, best of BENCH_PASSES
+ */
+static double bench_run(bench_frame_fn frame_fn, int frames, ym2149_stats_t *stats)
+{
+    ym2149_config_t config = {
+        .clock_hz = YM2149_CLOCK_HZ,
+        .cpu_hz = YM2149_CPU_HZ,
+        .sample_rate = BENCH_RATE,
+    };
+    double best = 0.0;
+
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double elapsed = 0.0;
+
+        ym2149_init(&s_ym, &config);
+        for (int frame = 0; frame < frames; frame++) {
+            frame_fn(&s_ym, frame);
+
+            double t0 = bench_now();
+            ym2149_generate(&s_ym, s_out, BENCH_FRAME_SAMPLES);
+            elapsed += bench_now() - t0;
+        }
+        if (!pass || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    *stats = s_ym.stats;
+    return best / ((double)frames * BENCH_FRAME_SAMPLES);
+}
+
+static void bench_report(const char *name, double s_per_sample, const ym2149_stats_t *stats,
+                         double host_mhz)
+{
+    printf("  %-10s %7.1f ns/sample  %5.2f events %5.2f steps per sample",
+           name, s_per_sample * 1e9, (double)stats->events / stats->samples,
+           (double)stats->steps / stats->samples);
+    if (host_mhz > 0.0) {
+        double cycles = s_per_sample * host_mhz * 1e6;
+        printf(", %6.0f cycles/sample, %.2f%% of %.0f MHz", cycles,
+               cycles * BENCH_RATE / (BENCH_P4_CLOCK_MHZ * 1e6) * 100, BENCH_P4_CLOCK_MHZ);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    double host_mhz = argc > 1 ? atof(argv[1]) : bench_host_mhz();
+    int frames = (argc > 2 ? atoi(argv[2]) : 20) * 50;
+    ym2149_stats_t stats;
+
+    printf("ym2149_bench: %d Hz, %d frames per case (best of %d)", BENCH_RATE, frames, BENCH_PASSES);
+    if (host_mhz > 0.0) {
+        printf(", host %.0f MHz\n", host_mhz);
+    } else {
+        printf(", host clock unknown (pass it as the first argument)\n");
+    }
+
+    for (size_t i = 0; i < sizeof(s_ym2149_tunes) / sizeof(s_ym2149_tunes[0]); i++) {
+        s_tune = &s_ym2149_tunes[i];
+        bench_report(s_tune->name, bench_run(bench_tune_frame, frames, &stats), &stats, host_mhz);
+    }
+    bench_report("digidrum", bench_run(bench_digidrum_frame, frames, &stats), &stats, host_mhz);
+    bench_report("worst", bench_run(bench_worst_frame, frames, &stats), &stats, host_mhz);
+    return 0;
+}
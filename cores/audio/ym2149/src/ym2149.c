@@ -0,0 +1,429 @@
+/**
+ * @file ym2149.c
+ * @brief Yamaha YM2149 PSG, band-limited block renderer
+ */
+
+#include <string.h>
+#include "ym2149.h"
+
+#define YM2149_TICK_DIV     8           ///< PSG clocks per tick
+#define YM2149_HP_SHIFT     9           ///< DC blocker, 15 Hz at 48 kHz like the ST's output capacitor
+
+// Bits of ym2149_t::live, above one per tone channel
+#define YM2149_LIVE_NOISE   0x08
+#define YM2149_LIVE_ENV     0x10
+
+static const uint8_t s_reg_mask[16] = {
+    0xFF, 0x0F, 0xFF, 0x0F, 0xFF, 0x0F, 0x1F, 0xFF,
+    0x1F, 0x1F, 0x1F, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF,
+};
+
+static inline uint32_t ym2149_tick_rate(const ym2149_t *ym)
+{
+    return ym->config.clock_hz / YM2149_TICK_DIV;
+}
+
+static inline uint64_t ym2149_cycles_to_tick(const ym2149_t *ym, uint64_t cycles)
+{
+    return cycles * ym2149_tick_rate(ym) / ym->config.cpu_hz;
+}
+
+/**
+ * @brief Run a counter @p ticks ticks ahead
+ *
+ * @return Times it expired and reloaded
+ */
+static inline uint32_t ym2149_advance(uint32_t *count, uint32_t period, uint32_t ticks)
+{
+    if (ticks < *count) {
+        *count -= ticks;
+        return 0;
+    }
+    if (ticks == *count) {
+        *count = period;
+        return 1;
+    }
+    ticks -= *count;
+    *count = period - ticks % period;
+    return 1 + ticks / period;
+}
+
+/**
+ * @brief New period for a running counter
+ *
+ * Like the chip's comparator: a counter already past the new period
+ * expires on the next tick.
+ */
+static void ym2149_set_period(uint32_t *period, uint32_t *count, uint32_t p)
+{
+    uint32_t elapsed = *period - *count;
+
+    *count = elapsed >= p ? 1 : p - elapsed;
+    *period = p;
+}
+
+static inline bool ym2149_env_holds(const ym2149_t *ym)
+{
+    return ym->env_pos >= 32 && (!(ym->env_shape & 8) || (ym->env_shape & 1));
+}
+
+static inline void ym2149_env_step(ym2149_t *ym, uint32_t steps)
+{
+    uint32_t pos = ym->env_pos + steps;
+
+    ym->env_pos = (uint8_t)(pos < YM2149_ENV_STEPS ? pos : 32 + (pos - 32) % 64);
+}
+
+/**
+ * @brief Work out which counters can move the output
+ *
+ * A tone masked in the mixer or on a silent channel, unused noise and an
+ * envelope nobody listens to are not events; tones and the envelope are
+ * advanced arithmetically instead, noise is left alone.
+ */
+static void ym2149_update_live(ym2149_t *ym)
+{
+    uint8_t mixer = ym->r[YM2149_R_MIXER];
+    uint8_t live = 0;
+    bool env_used = false;
+
+    for (int ch = 0; ch < 3; ch++) {
+        uint8_t amp = ym->r[YM2149_R_LEVEL_A + ch];
+
+        if (!amp) {
+            continue;
+        }
+        if (!(mixer & (1 << ch)) && ym->tone_period[ch] > 1) {
+            live |= 1 << ch;
+        }
+        if (!(mixer & (8 << ch))) {
+            live |= YM2149_LIVE_NOISE;
+        }
+        env_used |= (amp & 0x10) != 0;
+    }
+    if (env_used && !ym2149_env_holds(ym)) {
+        live |= YM2149_LIVE_ENV;
+    }
+    ym->live = live;
+}
+
+static int32_t ym2149_level(const ym2149_t *ym)
+{
+    uint8_t mixer = ym->r[YM2149_R_MIXER];
+    uint8_t noise = ym->lfsr & 1;
+    int32_t sum = 0;
+
+    for (int ch = 0; ch < 3; ch++) {
+        uint8_t amp = ym->r[YM2149_R_LEVEL_A + ch];
+
+        if (!((ym->tone_out[ch] | (mixer >> ch)) & (noise | (mixer >> (ch + 3))) & 1)) {
+            continue;
+        }
+        if (amp & 0x10) {
+            sum += ym2149_volume[ym2149_env_shapes[ym->env_shape][ym->env_pos]];
+        } else if (amp) {
+            sum += ym2149_volume[amp * 2 + 1];
+        }
+    }
+    return sum;
+}
+
+static void ym2149_apply(ym2149_t *ym, uint8_t reg, uint8_t val)
+{
+    ym->r[reg] = val;
+
+    switch (reg) {
+    case 0: case 1: case 2: case 3: case 4: case 5: {
+        int ch = reg >> 1;
+        uint32_t p = ym->r[ch * 2] | ((uint32_t)ym->r[ch * 2 + 1] << 8);
+
+        ym2149_set_period(&ym->tone_period[ch], &ym->tone_count[ch], p ? p : 1);
+        if (ym->tone_period[ch] <= 1) {
+            ym->tone_out[ch] = 1;
+        }
+        break;
+    }
+    case YM2149_R_NOISE:
+        ym2149_set_period(&ym->noise_period, &ym->noise_count, (val ? val : 1) * 2);
+        break;
+    case YM2149_R_ENV_FINE:
+    case YM2149_R_ENV_COARSE: {
+        uint32_t p = ym->r[YM2149_R_ENV_FINE] | ((uint32_t)ym->r[YM2149_R_ENV_COARSE] << 8);
+
+        ym2149_set_period(&ym->env_period, &ym->env_count, p ? p : 1);
+        break;
+    }
+    case YM2149_R_ENV_SHAPE:
+        ym->env_shape = val & 15;
+        ym->env_pos = 0;
+        ym->env_count = ym->env_period;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Insert a band-limited step of @p delta at tick boundary @p t of the block
+ */
+static void ym2149_insert_step(ym2149_t *ym, uint32_t t, int32_t delta)
+{
+    uint32_t pos = 0;       // Samples into the block, 1/4096 resolution
+
+    if (t) {
+        uint64_t ticks = (((uint64_t)t << 32) - ym->frac) >> 16;
+        pos = (uint32_t)((ticks * ym->sample_step) >> 36);
+    }
+
+    /* Split between the two nearest kernel phases, exactly delta in total */
+    int32_t d1 = (delta * (int32_t)(pos & 63)) >> 6;
+    int32_t d0 = delta - d1;
+    const int16_t *k0 = ym2149_blep[(pos >> 6) & (YM2149_BLEP_PHASES - 1)];
+    const int16_t *k1 = k0 + YM2149_BLEP_TAPS;
+    int32_t *acc = &ym->acc[pos >> 12];
+
+    for (int i = 0; i < YM2149_BLEP_TAPS; i++) {
+        acc[i] += d0 * k0[i] + d1 * k1[i];
+    }
+    ym->stats.steps++;
+}
+
+/**
+ * @brief Apply the logged writes due by tick boundary @p t of the block
+ *
+ * @return Whether any was applied
+ */
+static bool ym2149_apply_due(ym2149_t *ym, uint32_t t)
+{
+    bool applied = false;
+
+    while (ym->log_head < ym->log_count && ym->log[ym->log_head].tick <= ym->tick + t) {
+        const ym2149_write_t *w = &ym->log[ym->log_head++];
+
+        if (w->tick < ym->tick) {
+            ym->stats.late_writes++;
+        }
+        ym2149_apply(ym, w->reg, w->val);
+        applied = true;
+    }
+    if (ym->log_head == ym->log_count && ym->late_mask) {
+        for (int reg = 0; reg < 16; reg++) {
+            if (ym->late_mask & (1 << reg)) {
+                ym2149_apply(ym, (uint8_t)reg, ym->late_val[reg]);
+            }
+        }
+        ym->late_mask = 0;
+        applied = true;
+    }
+    if (applied) {
+        ym2149_update_live(ym);
+    }
+    return applied;
+}
+
+static void ym2149_render_block(ym2149_t *ym, int16_t *out, int n)
+{
+    uint64_t end = ym->frac + (uint64_t)n * ym->tick_step;
+    uint32_t ticks = (uint32_t)(end >> 32);
+    uint32_t t = 0;
+
+    for (;;) {
+        bool changed = ym2149_apply_due(ym, t);
+
+        if (changed) {
+            int32_t level = ym2149_level(ym);
+            if (level != ym->level) {
+                ym2149_insert_step(ym, t, level - ym->level);
+                ym->level = level;
+            }
+        }
+        if (t == ticks) {
+            break;
+        }
+
+        /* Nearest event: block end, next write or a live counter expiring */
+        uint32_t step = ticks - t;
+        uint8_t live = ym->live;
+
+        if (ym->log_head < ym->log_count) {
+            uint64_t next = ym->log[ym->log_head].tick - ym->tick - t;
+            if (next < step) {
+                step = (uint32_t)next;
+            }
+        }
+        for (int ch = 0; ch < 3; ch++) {
+            if ((live & (1 << ch)) && ym->tone_count[ch] < step) {
+                step = ym->tone_count[ch];
+            }
+        }
+        if ((live & YM2149_LIVE_NOISE) && ym->noise_count < step) {
+            step = ym->noise_count;
+        }
+        if ((live & YM2149_LIVE_ENV) && ym->env_count < step) {
+            step = ym->env_count;
+        }
+
+        /* Everything moves by step ticks at once */
+        t += step;
+        ym->stats.events++;
+        for (int ch = 0; ch < 3; ch++) {
+            if (ym->tone_period[ch] > 1) {
+                ym->tone_out[ch] ^= ym2149_advance(&ym->tone_count[ch], ym->tone_period[ch], step) & 1;
+            }
+        }
+        if ((live & YM2149_LIVE_NOISE) && ym2149_advance(&ym->noise_count, ym->noise_period, step)) {
+            uint32_t bit = (ym->lfsr ^ (ym->lfsr >> 3)) & 1;
+            ym->lfsr = (ym->lfsr >> 1) | (bit << 16);
+        }
+        if (!ym2149_env_holds(ym)) {
+            uint32_t steps = ym2149_advance(&ym->env_count, ym->env_period, step);
+            if (steps) {
+                ym2149_env_step(ym, steps);
+                if ((live & YM2149_LIVE_ENV) && ym2149_env_holds(ym)) {
+                    ym->live &= ~YM2149_LIVE_ENV;
+                }
+            }
+        }
+
+        if (live) {
+            int32_t level = ym2149_level(ym);
+            if (level != ym->level) {
+                ym2149_insert_step(ym, t, level - ym->level);
+                ym->level = level;
+            }
+        }
+    }
+
+    /* Integrate the deltas into samples */
+    for (int i = 0; i < n; i++) {
+        int32_t v;
+
+        ym->integ += ym->acc[i];
+        v = ym->integ >> 15;
+        ym->integ -= ym->integ >> YM2149_HP_SHIFT;
+        if (v > INT16_MAX) {
+            v = INT16_MAX;
+        } else if (v < INT16_MIN) {
+            v = INT16_MIN;
+        }
+        out[i * 2] = (int16_t)v;
+        out[i * 2 + 1] = (int16_t)v;
+    }
+    memmove(ym->acc, ym->acc + n, YM2149_BLEP_TAPS * sizeof(ym->acc[0]));
+    memset(ym->acc + YM2149_BLEP_TAPS, 0, (size_t)n * sizeof(ym->acc[0]));
+
+    ym->tick += ticks;
+    ym->frac = (uint32_t)end;
+}
+
+bool ym2149_init(ym2149_t *ym, const ym2149_config_t *config)
+{
+    uint32_t tick_rate = config->clock_hz / YM2149_TICK_DIV;
+
+    if (!config->sample_rate || !config->cpu_hz || config->sample_rate >= tick_rate) {
+        return false;
+    }
+
+    memset(ym, 0, sizeof(*ym));
+    ym->config = *config;
+    ym->tick_step = ((uint64_t)tick_rate << 32) / config->sample_rate;
+    ym->sample_step = (uint32_t)(((uint64_t)config->sample_rate << 32) / tick_rate);
+    ym2149_reset(ym);
+    return true;
+}
+
+void ym2149_reset(ym2149_t *ym)
+{
+    memset(ym->regs, 0, sizeof(ym->regs));
+    memset(ym->r, 0, sizeof(ym->r));
+    ym->select = 0;
+    for (int ch = 0; ch < 3; ch++) {
+        ym->tone_period[ch] = 1;
+        ym->tone_count[ch] = 1;
+        ym->tone_out[ch] = 1;
+    }
+    ym->noise_period = 2;
+    ym->noise_count = 2;
+    ym->lfsr = 1;
+    ym->env_period = 1;
+    ym->env_count = 1;
+    ym->env_shape = 0;
+    ym->env_pos = 0;
+    ym->live = 0;
+    ym->log_head = 0;
+    ym->log_count = 0;
+    ym->late_mask = 0;
+
+    /* Silence from here on; the samples already in flight ring out */
+    if (ym->level) {
+        ym2149_insert_step(ym, 0, -ym->level);
+        ym->level = 0;
+    }
+    ym->tick = ym2149_cycles_to_tick(ym, ym->now);
+    ym->frac = 0;
+}
+
+void ym2149_clock(ym2149_t *ym, int cycles)
+{
+    ym->now += (uint64_t)cycles;
+}
+
+void ym2149_write(ym2149_t *ym, uint8_t reg, uint8_t val)
+{
+    reg &= 15;
+    val &= s_reg_mask[reg];
+    ym->regs[reg] = val;
+    ym->stats.writes++;
+
+    if (reg >= YM2149_R_PORT_A) {
+        if (ym->config.port_write) {
+            ym->config.port_write(ym->config.port_ctx, reg - YM2149_R_PORT_A, val);
+        }
+        return;
+    }
+    if (ym->log_count == YM2149_LOG_MAX) {
+        ym->late_mask |= 1 << reg;
+        ym->late_val[reg] = val;
+        ym->stats.log_overflows++;
+        return;
+    }
+    ym->log[ym->log_count++] = (ym2149_write_t) {
+        .tick = ym2149_cycles_to_tick(ym, ym->now),
+        .reg = reg,
+        .val = val,
+    };
+}
+
+uint8_t ym2149_read_reg(ym2149_t *ym, uint32_t addr)
+{
+    if (addr & 2) {
+        return 0xFF;
+    }
+    return ym->select < 16 ? ym->regs[ym->select] : 0xFF;
+}
+
+void ym2149_write_reg(ym2149_t *ym, uint32_t addr, uint8_t val)
+{
+    if (!(addr & 2)) {
+        ym->select = val;
+    } else if (ym->select < 16) {
+        ym2149_write(ym, ym->select, val);
+    }
+}
+
+void ym2149_generate(ym2149_t *ym, int16_t *out, int samples)
+{
+    while (samples > 0) {
+        int n = samples < YM2149_BLOCK ? samples : YM2149_BLOCK;
+
+        ym2149_render_block(ym, out, n);
+        out += n * 2;
+        samples -= n;
+        ym->stats.samples += (uint64_t)n;
+    }
+
+    /* Keep the writes still ahead of the rendered position */
+    memmove(ym->log, ym->log + ym->log_head, (size_t)(ym->log_count - ym->log_head) * sizeof(ym->log[0]));
+    ym->log_count -= ym->log_head;
+    ym->log_head = 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file ym2149.h
+ * @brief Yamaha YM2149 PSG, band-limited block renderer
+ *
+ * The PSG is not stepped per clock. Its counters run at the 2 MHz / 8
+ * tick rate, and a block of output samples is rendered by jumping from
+ * one event to the next: the nearest tone toggle, noise shift, envelope
+ * step or register write is found with a min() over the counters, and
+ * all counters advance by that many ticks at once. Between events
+ * nothing is computed.
+ *
+ * Each event that changes the summed channel level inserts a band-limited
+ * step (BLEP) at its exact sub-sample position: the level change is
+ * spread over YM2149_BLEP_TAPS output samples through a windowed-sinc
+ * impulse table, interpolated between its two nearest phases, and the
+ * output is the running integral of those deltas. A 62.5 kHz square comes out as its band-limited self instead of
+ * aliasing down into the audible range, without oversampling.
+ *
+ * Levels come from a 32-step logarithmic table and the envelope from
+ * unrolled shape tables, both generated by tools/ym2149_gen.py. The three
+ * channels add linearly. Tone periods of 0 and 1 hold the channel high,
+ * which is what sample replay routines rely on; unused noise does not
+ * advance its shift register.
+ *
+ * Register writes are logged with the CPU cycle they happened on, like the
+ * Shifter's palette writes, and take effect at that tick when the block
+ * containing it is rendered. The log is consumed by ym2149_generate().
+ * The output lags by YM2149_BLEP_TAPS / 2 - 1 samples.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "component_api.h"
+
+// Register addresses (IMPLEMENTATION_PLAN.md, Phase 2 memory map)
+#define YM2149_REG_SELECT       0xFF8800    ///< Write: register number, read: its value
+#define YM2149_REG_DATA         0xFF8802    ///< Write: value of the selected register
+
+#define YM2149_CLOCK_HZ         2000000     ///< Atari ST: CPU clock / 4
+#define YM2149_CPU_HZ           8000000
+
+#define YM2149_ENV_STEPS        96          ///< First ramp, then two repeating ramps
+#define YM2149_BLEP_PHASES      64
+#define YM2149_BLEP_TAPS        16
+#define YM2149_BLOCK            256         ///< Samples rendered per pass
+#define YM2149_LOG_MAX          256         ///< Register writes between two generate() calls
+
+// Registers
+#define YM2149_R_TONE_A         0           ///< Fine, coarse (4 bits) per channel
+#define YM2149_R_NOISE          6           ///< 5 bits
+#define YM2149_R_MIXER          7           ///< Tone off bits 0-2, noise off bits 3-5, port directions 6-7
+#define YM2149_R_LEVEL_A        8           ///< Fixed level bits 0-3, envelope bit 4
+#define YM2149_R_ENV_FINE       11
+#define YM2149_R_ENV_COARSE     12
+#define YM2149_R_ENV_SHAPE      13          ///< Writing restarts the envelope
+#define YM2149_R_PORT_A         14
+#define YM2149_R_PORT_B         15
+
+extern const uint16_t ym2149_volume[32];
+extern const uint8_t ym2149_env_shapes[16][YM2149_ENV_STEPS];
+extern const int16_t ym2149_blep[YM2149_BLEP_PHASES + 1][YM2149_BLEP_TAPS];
+
+typedef struct {
+    uint32_t clock_hz;          ///< PSG clock
+    uint32_t cpu_hz;            ///< Clock of the cycles given to ym2149_clock()
+    uint32_t sample_rate;
+    /** Port A/B writes (ST: floppy select, printer strobe), as they happen. Optional. */
+    void (*port_write)(void *ctx, int port, uint8_t val);
+    void *port_ctx;
+} ym2149_config_t;
+
+/**
+ * @brief One logged register write
+ */
+typedef struct {
+    uint64_t tick;              ///< PSG tick it takes effect at
+    uint8_t reg;
+    uint8_t val;
+} ym2149_write_t;
+
+typedef struct {
+    uint64_t samples;
+    uint64_t events;            ///< Counter events processed
+    uint64_t steps;             ///< Band-limited steps inserted
+    uint64_t writes;
+    uint64_t late_writes;       ///< Logged behind the rendered position, applied at block start
+    uint64_t log_overflows;     ///< Writes past YM2149_LOG_MAX, applied after the logged ones
+} ym2149_stats_t;
+
+typedef struct {
+    ym2149_config_t config;
+
+    uint8_t regs[16];           ///< As the CPU sees them, every write applied
+    uint8_t select;
+
+    // Render state, at the rendered position
+    uint8_t r[16];              ///< Registers applied so far
+    uint32_t tone_period[3];
+    uint32_t tone_count[3];     ///< Ticks to the next toggle
+    uint8_t tone_out[3];
+    uint32_t noise_period;      ///< In ticks, twice the register
+    uint32_t noise_count;
+    uint32_t lfsr;              ///< 17 bits
+    uint32_t env_period;
+    uint32_t env_count;
+    uint8_t env_shape;
+    uint8_t env_pos;            ///< Index into ym2149_env_shapes[env_shape]
+    uint8_t live;               ///< Sources whose events can change the output, YM2149_LIVE_*
+    int32_t level;              ///< Sum of the channels, last inserted
+
+    uint64_t now;               ///< CPU cycles clocked
+    uint64_t tick;              ///< Whole ticks rendered
+    uint32_t frac;              ///< Rendered position past tick, 0.32
+    uint64_t tick_step;         ///< Ticks per sample, 32.32
+    uint32_t sample_step;       ///< Samples per tick, 0.32
+
+    ym2149_write_t log[YM2149_LOG_MAX];
+    int log_head;               ///< First write not applied yet
+    int log_count;
+    uint16_t late_mask;         ///< Overflowed writes, see ym2149_stats_t::log_overflows
+    uint8_t late_val[16];
+
+    int32_t acc[YM2149_BLOCK + YM2149_BLEP_TAPS];  ///< Step deltas, Q15
+    int32_t integ;              ///< Running integral of acc[], Q15
+
+    ym2149_stats_t stats;
+} ym2149_t;
+
+/**
+ * @return false for a zero rate or one not below the 250 kHz tick rate
+ */
+bool ym2149_init(ym2149_t *ym, const ym2149_config_t *config);
+void ym2149_reset(ym2149_t *ym);
+
+/**
+ * @brief Advance the clock by @p cycles CPU cycles
+ *
+ * Only moves the time register writes are stamped with; rendering is done
+ * by ym2149_generate().
+ */
+void ym2149_clock(ym2149_t *ym, int cycles);
+
+uint8_t ym2149_read_reg(ym2149_t *ym, uint32_t addr);
+void ym2149_write_reg(ym2149_t *ym, uint32_t addr, uint8_t val);
+
+/**
+ * @brief Write register @p reg at the current cycle, bypassing the select latch
+ */
+void ym2149_write(ym2149_t *ym, uint8_t reg, uint8_t val);
+
+/**
+ * @brief Render @p samples stereo frames (left and right equal) into @p out
+ */
+void ym2149_generate(ym2149_t *ym, int16_t *out, int samples);
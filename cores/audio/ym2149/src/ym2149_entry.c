@@ -0,0 +1,73 @@
+/**
+ * @file ym2149_entry.c
+ * @brief audio_interface_t adapter for the YM2149
+ *
+ * As with the CPU and video components, the interface has no context
+ * argument, so the single PSG instance lives here. The Atari ST clocks it
+ * at 2 MHz from the 8 MHz CPU clock.
+ */
+
+#include <stddef.h>
+#include "ym2149.h"
+
+static ym2149_t s_ym;
+
+static int ym2149_if_init(uint32_t sample_rate)
+{
+    ym2149_config_t config = {
+        .clock_hz = YM2149_CLOCK_HZ,
+        .cpu_hz = YM2149_CPU_HZ,
+        .sample_rate = sample_rate,
+    };
+
+    return ym2149_init(&s_ym, &config) ? 0 : -1;
+}
+
+static void ym2149_if_reset(void)
+{
+    ym2149_reset(&s_ym);
+}
+
+static void ym2149_if_shutdown(void)
+{
+}
+
+static void ym2149_if_generate(int16_t *buffer, int samples)
+{
+    ym2149_generate(&s_ym, buffer, samples);
+}
+
+static uint8_t ym2149_if_read_reg(uint32_t addr)
+{
+    return ym2149_read_reg(&s_ym, addr);
+}
+
+static void ym2149_if_write_reg(uint32_t addr, uint8_t val)
+{
+    ym2149_write_reg(&s_ym, addr, val);
+}
+
+static void ym2149_if_clock(int cycles)
+{
+    ym2149_clock(&s_ym, cycles);
+}
+
+static const audio_interface_t s_ym2149_interface = {
+    .interface_version = AUDIO_INTERFACE_V1,
+    .name              = "YM2149",
+    .init              = ym2149_if_init,
+    .reset             = ym2149_if_reset,
+    .shutdown          = ym2149_if_shutdown,
+    .generate          = ym2149_if_generate,
+    .read_reg          = ym2149_if_read_reg,
+    .write_reg         = ym2149_if_write_reg,
+    .clock             = ym2149_if_clock,
+};
+
+/**
+ * @brief Component entry point (EBIN "Entry Offset")
+ */
+const audio_interface_t *ym2149_entry(void)
+{
+    return &s_ym2149_interface;
+}
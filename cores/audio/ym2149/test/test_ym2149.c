@@ -0,0 +1,295 @@
+/**
+ * @file test_ym2149.c
+ * @brief YM2149 unit tests
+ *
+ * The PSG runs at the ST's 2 MHz from an 8 MHz CPU clock and renders at
+ * 48 kHz. Spectra are measured with a Goertzel filter over whole seconds,
+ * so that every test tone falls on a bin.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "ym2149.h"
+#include "ym2149_tunes.h"
+
+#define TEST_RATE           48000
+#define TEST_VBL_CYCLES     160000      ///< 50 Hz
+#define TEST_VBL_SAMPLES    (TEST_RATE / 50)
+#define TEST_DELAY          (YM2149_BLEP_TAPS / 2 - 1)
+
+static ym2149_t s_ym;
+static int16_t s_out[TEST_RATE * 2];
+static float s_mono[TEST_RATE];
+
+/* FNV-1a of each tune's output, from this renderer; see test_golden_tunes */
+static const uint32_t s_golden[] = {
+    0x2B513BC5,     // chords
+    0x15504311,     // buzzer
+    0x64530875,     // drums
+};
+
+void setUp(void)
+{
+    ym2149_config_t cfg = {
+        .clock_hz = YM2149_CLOCK_HZ,
+        .cpu_hz = YM2149_CPU_HZ,
+        .sample_rate = TEST_RATE,
+    };
+
+    TEST_ASSERT_TRUE(ym2149_init(&s_ym, &cfg));
+}
+
+void tearDown(void)
+{
+}
+
+/** Render @p samples and keep the left channel as floats */
+static void render(int samples)
+{
+    ym2149_generate(&s_ym, s_out, samples);
+    for (int i = 0; i < samples; i++) {
+        s_mono[i] = s_out[i * 2];
+    }
+}
+
+/** Amplitude of @p freq in s_mono[0..n) */
+static double goertzel(int n, double freq)
+{
+    double w = 2 * M_PI * freq / TEST_RATE;
+    double c = 2 * cos(w), s1 = 0, s2 = 0;
+
+    for (int i = 0; i < n; i++) {
+        double s0 = s_mono[i] + c * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    return sqrt(s1 * s1 + s2 * s2 - c * s1 * s2) * 2 / n;
+}
+
+static double db(double ratio)
+{
+    return 20 * log10(ratio);
+}
+
+static void test_tables(void)
+{
+    /* 1.5 dB per level, 0 silent */
+    TEST_ASSERT_EQUAL(0, ym2149_volume[0]);
+    for (int i = 2; i < 32; i++) {
+        TEST_ASSERT_TRUE(fabs(db((double)ym2149_volume[i] / ym2149_volume[i - 1]) - 1.5) < 0.1);
+    }
+
+    /* \/\/ triangle: down, up, then down again, looping over the last 64 */
+    const uint8_t *tri = ym2149_env_shapes[0x0A];
+    TEST_ASSERT_EQUAL(31, tri[0]);
+    TEST_ASSERT_EQUAL(0, tri[31]);
+    TEST_ASSERT_EQUAL(0, tri[32]);
+    TEST_ASSERT_EQUAL(31, tri[63]);
+    TEST_ASSERT_EQUAL(31, tri[64]);
+
+    /* /~~~ attack and hold, \___ decay and hold */
+    TEST_ASSERT_EQUAL(31, ym2149_env_shapes[0x0D][95]);
+    TEST_ASSERT_EQUAL(0, ym2149_env_shapes[0x09][95]);
+    TEST_ASSERT_EQUAL(0, ym2149_env_shapes[0x04][40]);
+
+    /* Every phase of the step kernel has unity gain */
+    for (int p = 0; p <= YM2149_BLEP_PHASES; p++) {
+        int32_t sum = 0;
+        for (int k = 0; k < YM2149_BLEP_TAPS; k++) {
+            sum += ym2149_blep[p][k];
+        }
+        TEST_ASSERT_EQUAL(32768, sum);
+    }
+}
+
+static void test_registers(void)
+{
+    ym2149_write_reg(&s_ym, YM2149_REG_SELECT, YM2149_R_TONE_A + 1);
+    ym2149_write_reg(&s_ym, YM2149_REG_DATA, 0xFF);
+    TEST_ASSERT_EQUAL(0x0F, ym2149_read_reg(&s_ym, YM2149_REG_SELECT));
+    ym2149_write_reg(&s_ym, YM2149_REG_SELECT, YM2149_R_NOISE);
+    ym2149_write_reg(&s_ym, YM2149_REG_DATA, 0xFF);
+    TEST_ASSERT_EQUAL(0x1F, ym2149_read_reg(&s_ym, YM2149_REG_SELECT));
+    ym2149_write_reg(&s_ym, YM2149_REG_SELECT, YM2149_R_PORT_A);
+    ym2149_write_reg(&s_ym, YM2149_REG_DATA, 0x07);
+    TEST_ASSERT_EQUAL(0x07, ym2149_read_reg(&s_ym, YM2149_REG_SELECT));
+
+    /* Ports are not sound and are not logged for rendering */
+    TEST_ASSERT_EQUAL(2, s_ym.log_count);
+    ym2149_write_reg(&s_ym, YM2149_REG_SELECT, 16);
+    TEST_ASSERT_EQUAL(0xFF, ym2149_read_reg(&s_ym, YM2149_REG_SELECT));
+}
+
+static void test_tone_frequency(void)
+{
+    /* A4: 2 MHz / (16 * 284) = 440.1 Hz, fixed level 15 */
+    ym2149_write(&s_ym, YM2149_R_TONE_A, 284 & 0xFF);
+    ym2149_write(&s_ym, YM2149_R_TONE_A + 1, 284 >> 8);
+    ym2149_write(&s_ym, YM2149_R_MIXER, 0x3E);
+    ym2149_write(&s_ym, YM2149_R_LEVEL_A, 15);
+    render(TEST_RATE);
+
+    /* Past the pre-ringing of the first edge: 2 * 440.1 * 0.99 s */
+    int crossings = 0;
+    for (int i = TEST_RATE / 100 + 1; i < TEST_RATE; i++) {
+        crossings += (s_mono[i - 1] < 0) != (s_mono[i] < 0);
+    }
+    TEST_ASSERT_TRUE(crossings >= 871 && crossings <= 872);
+
+    /* Square wave of 9000: fundamental 4 / pi * 4500 */
+    double fund = goertzel(TEST_RATE, 2000000.0 / (16 * 284));
+    TEST_ASSERT_TRUE(fabs(fund - 4 / M_PI * 4500) < 200);
+}
+
+static void test_band_limited(void)
+{
+    /*
+     * 5 kHz square: its 35, 45, 55 and 65 kHz harmonics would fold to 13,
+     * 3, 7 and 17 kHz if the edges were stepped on the sample grid.
+     */
+    static const double aliases[] = { 3000, 7000, 13000, 17000 };
+
+    ym2149_write(&s_ym, YM2149_R_TONE_A, 25);
+    ym2149_write(&s_ym, YM2149_R_MIXER, 0x3E);
+    ym2149_write(&s_ym, YM2149_R_LEVEL_A, 15);
+    render(TEST_RATE);
+
+    double fund = goertzel(TEST_RATE, 5000);
+    TEST_ASSERT_TRUE(fund > 5000);
+    for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++) {
+        double a = db(goertzel(TEST_RATE, aliases[i]) / fund);
+        if (a > -70) {
+            printf("alias at %.0f Hz: %.1f dB\n", aliases[i], a);
+        }
+        TEST_ASSERT_TRUE(a < -70);
+    }
+
+    /* The third harmonic is in band and kept */
+    TEST_ASSERT_TRUE(fabs(db(goertzel(TEST_RATE, 15000) / fund) - db(1.0 / 3)) < 3);
+}
+
+static void test_write_lands_on_its_cycle(void)
+{
+    /* Channel A held high (tone off), level 15 written 10 ms in */
+    ym2149_write(&s_ym, YM2149_R_MIXER, 0x3F);
+    ym2149_clock(&s_ym, YM2149_CPU_HZ / 100);
+    ym2149_write(&s_ym, YM2149_R_LEVEL_A, 15);
+    render(960);
+
+    int edge = TEST_RATE / 100 + TEST_DELAY;
+    TEST_ASSERT_EQUAL(0, s_mono[edge - 8]);
+    TEST_ASSERT_TRUE(s_mono[edge - 1] < 4500);
+    TEST_ASSERT_TRUE(s_mono[edge + 1] > 4500);
+    TEST_ASSERT_TRUE(s_mono[edge + 8] > 8500);
+    TEST_ASSERT_EQUAL(0, s_ym.stats.late_writes);
+
+    /* Behind the rendered position: applied at the start of the next block */
+    ym2149_write(&s_ym, YM2149_R_LEVEL_A, 0);
+    render(64);
+    TEST_ASSERT_EQUAL(1, s_ym.stats.late_writes);
+}
+
+static void test_envelope_hold(void)
+{
+    /* /~~~ over 32 steps of 1000 ticks, then level 31 for good */
+    ym2149_write(&s_ym, YM2149_R_MIXER, 0x3F);
+    ym2149_write(&s_ym, YM2149_R_LEVEL_A, 0x10);
+    ym2149_write(&s_ym, YM2149_R_ENV_FINE, 1000 & 0xFF);
+    ym2149_write(&s_ym, YM2149_R_ENV_COARSE, 1000 >> 8);
+    ym2149_write(&s_ym, YM2149_R_ENV_SHAPE, 0x0D);
+    render(TEST_RATE / 4);
+
+    uint64_t events = s_ym.stats.events;
+    int ramp = 32 * 1000 * TEST_RATE / 250000;
+    for (int i = 1; i < ramp; i++) {
+        TEST_ASSERT_TRUE(s_mono[i] >= s_mono[i - 1] - 300);
+    }
+    render(TEST_RATE / 4);
+    /* Held: nothing left to do but the block ends */
+    TEST_ASSERT_TRUE(s_ym.stats.events - events <= (uint64_t)TEST_RATE / 4 / YM2149_BLOCK + 1);
+    TEST_ASSERT_EQUAL(0, s_ym.level - ym2149_volume[31]);
+}
+
+static void test_digidrum(void)
+{
+    /*
+     * Sample replay as ST software does it: tones held high, channel A's
+     * fixed level rewritten from a timer at 8 kHz, here a 500 Hz sine.
+     */
+    ym2149_write(&s_ym, YM2149_R_MIXER, 0x3F);
+    for (int frame = 0; frame < 50; frame++) {
+        for (int i = 0; i < 160; i++) {
+            int n = frame * 160 + i;
+            int level = (int)lrint(11 + 4 * sin(2 * M_PI * 500 * n / 8000));
+            ym2149_write(&s_ym, YM2149_R_LEVEL_A, (uint8_t)level);
+            ym2149_clock(&s_ym, YM2149_CPU_HZ / 8000);
+        }
+        ym2149_generate(&s_ym, s_out + frame * TEST_VBL_SAMPLES * 2, TEST_VBL_SAMPLES);
+    }
+    for (int i = 0; i < TEST_RATE; i++) {
+        s_mono[i] = s_out[i * 2];
+    }
+
+    double tone = goertzel(TEST_RATE, 500);
+    TEST_ASSERT_TRUE(tone > 1000);
+    TEST_ASSERT_TRUE(db(goertzel(TEST_RATE, 8000 - 500) / tone) < -20);
+    TEST_ASSERT_EQUAL(0, s_ym.stats.log_overflows);
+    TEST_ASSERT_EQUAL(0, s_ym.stats.late_writes);
+}
+
+/** Play a register dump as a VBL routine would and hash the output */
+static uint32_t play_tune(const ym2149_tune_t *tune)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int frame = 0; frame < YM2149_TUNE_FRAMES; frame++) {
+        for (int reg = 0; reg < 14; reg++) {
+            if (reg != YM2149_R_ENV_SHAPE || tune->regs[frame][reg] != 0xFF) {
+                ym2149_write_reg(&s_ym, YM2149_REG_SELECT, (uint8_t)reg);
+                ym2149_write_reg(&s_ym, YM2149_REG_DATA, tune->regs[frame][reg]);
+            }
+        }
+        ym2149_clock(&s_ym, TEST_VBL_CYCLES);
+        ym2149_generate(&s_ym, s_out, TEST_VBL_SAMPLES);
+        for (int i = 0; i < TEST_VBL_SAMPLES * 2; i++) {
+            hash = (hash ^ (uint16_t)s_out[i]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void test_golden_tunes(void)
+{
+    bool match = true;
+
+    for (size_t i = 0; i < sizeof(s_ym2149_tunes) / sizeof(s_ym2149_tunes[0]); i++) {
+        uint32_t hash;
+
+        setUp();
+        hash = play_tune(&s_ym2149_tunes[i]);
+        if (hash != s_golden[i]) {
+            printf("%s: 0x%08lX, golden 0x%08lX\n", s_ym2149_tunes[i].name,
+                   (unsigned long)hash, (unsigned long)s_golden[i]);
+            match = false;
+        }
+        TEST_ASSERT_EQUAL(0, s_ym.stats.late_writes);
+        TEST_ASSERT_TRUE(s_ym.stats.steps > 0);
+    }
+    TEST_ASSERT_TRUE(match);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tables);
+    RUN_TEST(test_registers);
+    RUN_TEST(test_tone_frequency);
+    RUN_TEST(test_band_limited);
+    RUN_TEST(test_write_lands_on_its_cycle);
+    RUN_TEST(test_envelope_hold);
+    RUN_TEST(test_digidrum);
+    RUN_TEST(test_golden_tunes);
+    return UNITY_END();
+}
@@ -0,0 +1,335 @@
+/**
+ * @file ym2149_tunes.h
+ * @brief Register-dump tunes for the YM2149 tests and benchmark
+ *
+ * Synthetic dumps written for these tests, in the layout of the .YM
+ * format: registers 0-13 once per 50 Hz VBL, register 13 = 0xFF leaving
+ * the envelope running. Between them they cover tones, noise, fixed and
+ * envelope levels and an envelope at audio rate (buzzer).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define YM2149_TUNE_FRAMES  100
+
+typedef struct {
+    const char *name;
+    const uint8_t (*regs)[14];     // YM2149_TUNE_FRAMES dumps
+} ym2149_tune_t;
+
+static const uint8_t s_tune_chords[YM2149_TUNE_FRAMES][14] = {
+    { 0x1C, 0x01, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x8E, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x8E, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x8E, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x8E, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x8E, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x8E, 0x00, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x7B, 0x01, 0x70, 0x04, 0x00, 0x38, 0x07, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xB3, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x66, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xB3, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x66, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xB3, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x66, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xB3, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x66, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xB3, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x66, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xB3, 0x00, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x66, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x1C, 0x01, 0xDE, 0x01, 0x98, 0x05, 0x00, 0x38, 0x07, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x77, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x77, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x77, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x77, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x77, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x77, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xBE, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0x3F, 0x01, 0xBC, 0x03, 0x00, 0x38, 0x07, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x3F, 0x01, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xFD, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0F, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xD5, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x3F, 0x01, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0E, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xFD, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xD5, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0D, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x3F, 0x01, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xFD, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xD5, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0C, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x3F, 0x01, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xFD, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0B, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xD5, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x3F, 0x01, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x0A, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xFD, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xD5, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x09, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x3F, 0x01, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xFD, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0xD5, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x08, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+    { 0x9F, 0x00, 0xAA, 0x01, 0xFC, 0x04, 0x00, 0x38, 0x07, 0x0A, 0x0D, 0x00, 0x00, 0xFF },
+};
+
+static const uint8_t s_tune_buzzer[YM2149_TUNE_FRAMES][14] = {
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0x08 },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0x08 },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x47, 0x00, 0xFF },
+    { 0x1C, 0x01, 0x00, 0x00, 0x70, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x47, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x3C, 0x00, 0x0A },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0xEF, 0x00, 0x00, 0x00, 0xBC, 0x03, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x3C, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0x0A },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x03, 0x2A, 0x0B, 0x0C, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x0B, 0x00, 0x10, 0x50, 0x00, 0xFF },
+    { 0x3F, 0x01, 0x00, 0x00, 0xFC, 0x04, 0x00, 0x3A, 0x09, 0x00, 0x10, 0x50, 0x00, 0xFF },
+};
+
+static const uint8_t s_tune_drums[YM2149_TUNE_FRAMES][14] = {
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x38, 0x02, 0x00, 0x00, 0x08, 0x2D, 0x00, 0x10, 0x00, 0x84, 0x03, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+    { 0x12, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0x00 },
+    { 0xFA, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x10, 0x00, 0x00, 0xB0, 0x04, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x08, 0xD0, 0x07, 0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x01, 0x3F, 0x00, 0x00, 0x00, 0xD0, 0x07, 0xFF },
+};
+
+static const ym2149_tune_t s_ym2149_tunes[] = {
+    { "chords", s_tune_chords },
+    { "buzzer", s_tune_buzzer },
+    { "drums", s_tune_drums },
+};
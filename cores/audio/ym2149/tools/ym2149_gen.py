@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+Generate the YM2149 lookup tables.
+
+- ym2149_volume: the 32 logarithmic output levels of the YM2149 DAC,
+  1.5 dB apart, level 0 silent. A fixed 4-bit volume v uses level 2v + 1.
+- ym2149_env_shapes: the 16 envelope shapes unrolled over 96 steps: the
+  first 32-step ramp, then 64 steps that repeat forever (two ramps, which
+  covers the alternating shapes), so the envelope is a counter and a table
+  lookup.
+- ym2149_blep: band-limited impulses for step insertion, a Blackman
+  windowed sinc cut off at 0.45 of the output rate, YM2149_BLEP_PHASES + 1
+  sub-sample positions of YM2149_BLEP_TAPS taps (the last one a whole
+  sample on, for interpolating between phases), each summing to exactly
+  1 << 15 so that integrated steps land on the right level.
+
+The tables do not depend on the clock or the output rate. They are
+generated rather than computed at init because an EBIN resolves no
+symbols against the firmware, libm included.
+
+Usage: ym2149_gen.py --output <ym2149_tables.c>
+"""
+
+import argparse
+import math
+
+LEVEL_MAX = 9000            # Per channel: three channels and the ringing of a step stay in int16
+STEP_DB = 1.5
+ENV_STEPS = 96
+BLEP_PHASES = 64            # Must match YM2149_BLEP_PHASES in src/ym2149.h
+BLEP_TAPS = 16              # Must match YM2149_BLEP_TAPS
+BLEP_CUTOFF = 0.45          # Of the output rate
+
+
+def volume_table():
+    return [0] + [round(LEVEL_MAX * 10 ** (-(31 - i) * STEP_DB / 20)) for i in range(1, 32)]
+
+
+def env_shape(shape):
+    cont, att, alt, hold = shape & 8, shape & 4, shape & 2, shape & 1
+    up = list(range(32))
+    down = up[::-1]
+    first = up if att else down
+
+    if not cont:
+        return first + [0] * 64
+    if hold:
+        last = first[-1]
+        return first + [31 - last if alt else last] * 64
+    second = (down if att else up) if alt else first
+    return first + second + first
+
+
+def blep_table():
+    half = BLEP_TAPS // 2
+    table = []
+    for p in range(BLEP_PHASES + 1):
+        frac = p / BLEP_PHASES
+        taps = []
+        for k in range(BLEP_TAPS):
+            t = k - half - frac + 1
+            x = 2 * BLEP_CUTOFF * t
+            sinc = 1.0 if x == 0 else math.sin(math.pi * x) / (math.pi * x)
+            w = (t + half) / BLEP_TAPS
+            window = 0.42 - 0.5 * math.cos(2 * math.pi * w) + 0.08 * math.cos(4 * math.pi * w) \
+                if 0 <= w <= 1 else 0.0
+            taps.append(sinc * window)
+        total = sum(taps)
+        q = [round(v / total * 32768) for v in taps]
+        q[half] += 32768 - sum(q)       # Exact DC gain despite rounding
+        table.append(q)
+    return table
+
+
+def c_rows(rows, per_line):
+    out = []
+    for i in range(0, len(rows), per_line):
+        out.append("    " + ", ".join("%d" % v for v in rows[i:i + per_line]) + ",")
+    return "\n".join(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("--output", required=True)
+    args = ap.parse_args()
+
+    lines = [
+        "/* Generated by tools/ym2149_gen.py, do not edit */",
+        "",
+        "#include \"ym2149.h\"",
+        "",
+        "const uint16_t ym2149_volume[32] = {",
+        c_rows(volume_table(), 8),
+        "};",
+        "",
+        "const uint8_t ym2149_env_shapes[16][YM2149_ENV_STEPS] = {",
+    ]
+    for shape in range(16):
+        lines.append("    {  /* %X */" % shape)
+        lines.append("    " + c_rows(env_shape(shape), 16).replace("\n", "\n    "))
+        lines.append("    },")
+    lines += [
+        "};",
+        "",
+        "const int16_t ym2149_blep[YM2149_BLEP_PHASES + 1][YM2149_BLEP_TAPS] = {",
+    ]
+    for row in blep_table():
+        lines.append("    { " + ", ".join("%d" % v for v in row) + " },")
+    lines += ["};", ""]
+
+    assert len(env_shape(0)) == ENV_STEPS
+    with open(args.output, "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,229 @@
+/**
+ * @file m68k_bench.c
+ * @brief Host benchmark for the MC68000 core
+ *
+ * Runs a fixed instruction mix (moves, ALU, immediate, shifts, branches,
+ * MOVEM, BSR/RTS, DBcc) through cpu_interface_t::execute() in scanline-sized
+ * slices and reports emulated MHz and emulated MHz per host MHz, the figure
+ * that carries over to the ESP32-P4 clock. The mix is run once interpreted
+ * and once with the block cache, and the final states are compared.
+ *
+ * m68k_bench_eager is the same program linked against a core built with
+ * M68K_EAGER_FLAGS=1; comparing the two shows what lazy flags save. On an
+ * x86 host the difference is smaller than the run-to-run spread, so each
+ * mode reports its median and worst pass next to the best. Compare the two
+ * builds pinned to one core with many passes, e.g.
+ *
+ *     taskset -c 0 m68k_bench 2100 400 50
+ *
+ * Usage: m68k_bench [host_mhz] [emulated_mcycles] [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "component_api.h"
+#include "m68k_bench_prog.h"
+
+#ifndef M68K_EAGER_FLAGS
+#define M68K_EAGER_FLAGS    0
+#endif
+
+extern const cpu_interface_t *m68000_entry(void);
+
+#define BENCH_RAM_SIZE      0x100000
+#define BENCH_ST_CLOCK_MHZ  8.0
+#define BENCH_P4_CLOCK_MHZ  400.0
+#define BENCH_PASSES        5           /**< Default pass count */
+
+static uint8_t s_ram[BENCH_RAM_SIZE];
+
+static uint8_t bench_read_byte(uint32_t addr)
+{
+    return s_ram[addr & (BENCH_RAM_SIZE - 1)];
+}
+
+static uint16_t bench_read_word(uint32_t addr)
+{
+    addr &= BENCH_RAM_SIZE - 2;
+    return (uint16_t)((s_ram[addr] << 8) | s_ram[addr + 1]);
+}
+
+static uint32_t bench_read_long(uint32_t addr)
+{
+    return ((uint32_t)bench_read_word(addr) << 16) | bench_read_word(addr + 2);
+}
+
+static void bench_write_byte(uint32_t addr, uint8_t val)
+{
+    s_ram[addr & (BENCH_RAM_SIZE - 1)] = val;
+}
+
+static void bench_write_word(uint32_t addr, uint16_t val)
+{
+    addr &= BENCH_RAM_SIZE - 2;
+    s_ram[addr] = (uint8_t)(val >> 8);
+    s_ram[addr + 1] = (uint8_t)val;
+}
+
+static void bench_write_long(uint32_t addr, uint32_t val)
+{
+    bench_write_word(addr, (uint16_t)(val >> 16));
+    bench_write_word(addr + 2, (uint16_t)val);
+}
+
+static const bus_interface_t s_bus = {
+    .read_byte     = bench_read_byte,
+    .read_word     = bench_read_word,
+    .read_long     = bench_read_long,
+    .write_byte    = bench_write_byte,
+    .write_word    = bench_write_word,
+    .write_long    = bench_write_long,
+    .int_ack       = NULL,
+    .reset_devices = NULL,
+};
+
+static void bench_load(void)
+{
+    memset(s_ram, 0, sizeof(s_ram));
+    bench_write_long(0, BENCH_SSP);             // Reset SSP
+    bench_write_long(4, BENCH_PROG_START);      // Reset PC
+    bench_load_program(&s_bus);
+}
+
+/** Host clock from /proc/cpuinfo, 0 if unknown */
+static double bench_host_mhz(void)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0.0;
+
+    if (!f) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "cpu MHz", 7) == 0) {
+            const char *colon = strchr(line, ':');
+            if (colon) {
+                mhz = atof(colon + 1);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    return mhz;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Run @p slices execute() slices with the given cpu_config_t flags
+ *
+ * @return Host seconds spent in execute(), or a negative value if the CPU
+ *         left the program
+ */
+static double bench_run(const cpu_interface_t *cpu, uint32_t flags, int64_t slices,
+                        cpu_state_t *state)
+{
+    cpu_config_t config = { .clock_hz = 8000000, .flags = flags };
+
+    bench_load();
+    cpu->set_bus(&s_bus);
+    cpu->init(&config);
+    cpu->reset();
+
+    double t0 = bench_now();
+    for (int64_t i = 0; i < slices; i++) {
+        cpu->execute(BENCH_SLICE);
+    }
+    double elapsed = bench_now() - t0;
+
+    cpu->get_state(state);
+    cpu->shutdown();
+    if (state->pc < BENCH_PROG_START || state->pc >= BENCH_PROG_END) {
+        fprintf(stderr, "m68k_bench: CPU left the program, PC=%06lx\n",
+                (unsigned long)state->pc);
+        return -1.0;
+    }
+    return elapsed;
+}
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/** Best pass as emulated MHz, with the median and worst passes for the spread */
+static void bench_report(const char *mode, uint64_t cycles, double *times, int passes,
+                         double host_mhz)
+{
+    double emu_mhz;
+
+    qsort(times, (size_t)passes, sizeof(times[0]), bench_cmp_double);
+    emu_mhz = (double)cycles / times[0] / 1e6;
+    printf("  %-12s %8.2f MHz emulated (%.1fx a %.0f MHz ST)", mode,
+           emu_mhz, emu_mhz / BENCH_ST_CLOCK_MHZ, BENCH_ST_CLOCK_MHZ);
+    if (host_mhz > 0.0) {
+        double ratio = emu_mhz / host_mhz;
+        printf(", %.4f per host MHz, %.1f MHz at %.0f MHz",
+               ratio, ratio * BENCH_P4_CLOCK_MHZ, BENCH_P4_CLOCK_MHZ);
+    }
+    printf("\n  %-12s %8.2f MHz median, %.2f MHz worst\n", "",
+           (double)cycles / times[passes / 2] / 1e6, (double)cycles / times[passes - 1] / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    double host_mhz = argc > 1 ? atof(argv[1]) : bench_host_mhz();
+    double mcycles = argc > 2 ? atof(argv[2]) : 100.0;
+    int passes = argc > 3 ? atoi(argv[3]) : BENCH_PASSES;
+    int64_t slices = (int64_t)(mcycles * 1e6) / BENCH_SLICE;
+    const cpu_interface_t *cpu = m68000_entry();
+    cpu_state_t interp, cached;
+
+    if (passes < 1) {
+        passes = 1;
+    }
+    double *t_interp = malloc((size_t)passes * sizeof(double));
+    double *t_cached = malloc((size_t)passes * sizeof(double));
+    if (!t_interp || !t_cached) {
+        return 1;
+    }
+
+    // Same program, same slices: both modes must end in the same state
+    for (int pass = 0; pass < passes; pass++) {
+        t_interp[pass] = bench_run(cpu, 0, slices, &interp);
+        t_cached[pass] = bench_run(cpu, CPU_CONFIG_BLOCK_CACHE, slices, &cached);
+        if (t_interp[pass] < 0.0 || t_cached[pass] < 0.0) {
+            return 1;
+        }
+    }
+    if (memcmp(interp.d, cached.d, sizeof(interp.d)) != 0 ||
+        memcmp(interp.a, cached.a, sizeof(interp.a)) != 0 ||
+        interp.pc != cached.pc || interp.sr != cached.sr || interp.cycles != cached.cycles) {
+        fprintf(stderr, "m68k_bench: block cache diverged from the interpreter\n");
+        return 1;
+    }
+
+    printf("m68k_bench: %s flags, %lld cycles per mode (%d-cycle slices, %d passes)",
+           M68K_EAGER_FLAGS ? "eager" : "lazy", (long long)interp.cycles, BENCH_SLICE, passes);
+    if (host_mhz > 0.0) {
+        printf(", host %.0f MHz\n", host_mhz);
+    } else {
+        printf(", host clock unknown (pass it as the first argument)\n");
+    }
+    bench_report("interpreter", interp.cycles, t_interp, passes, host_mhz);
+    bench_report("block cache", cached.cycles, t_cached, passes, host_mhz);
+    printf("  speedup      %8.2fx (best passes)\n", t_interp[0] / t_cached[0]);
+    free(t_interp);
+    free(t_cached);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file m68k_bench_prog.h
+ * @brief Instruction mix shared by the host benchmarks
+ *
+ * m68k_bench and the esptari_memory bench run this same program so their
+ * numbers can be compared. Both expect SSP $10000 and PC BENCH_PROG_START
+ * in the reset vectors.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "component_api.h"
+
+#define BENCH_PROG_START    0x1000
+#define BENCH_PROG_END      0x1048
+#define BENCH_SSP           0x10000
+#define BENCH_SLICE         512         /**< One ST scanline at 8 MHz */
+
+/**
+ * Fixed mix, assembled by hand. Outer loop reloads the pointers, the inner
+ * loop runs 64 times over a 256-byte source buffer.
+ */
+static const uint16_t s_bench_program[] = {
+    0x41F9, 0x0002, 0x0000,     // 1000  lea     $20000,a0
+    0x43F9, 0x0003, 0x0000,     // 1006  lea     $30000,a1
+    0x7E3F,                     // 100C  moveq   #63,d7
+    0x7000,                     // 100E  moveq   #0,d0
+    0x7200,                     // 1010  moveq   #0,d1
+    0x2018,                     // 1012  move.l  (a0)+,d0
+    0xD280,                     // 1014  add.l   d0,d1
+    0x32C1,                     // 1016  move.w  d1,(a1)+
+    0x0281, 0x00FF, 0x00FF,     // 1018  andi.l  #$00FF00FF,d1
+    0xE349,                     // 101E  lsl.w   #1,d1
+    0xB240,                     // 1020  cmp.w   d0,d1
+    0x6502,                     // 1022  bcs.s   $1026
+    0x5241,                     // 1024  addq.w  #1,d1
+    0x3428, 0xFFFC,             // 1026  move.w  -4(a0),d2
+    0xD642,                     // 102A  add.w   d2,d3
+    0xB742,                     // 102C  eor.w   d3,d2
+    0xE48B,                     // 102E  lsr.l   #2,d3
+    0x48E7, 0xF000,             // 1030  movem.l d0-d3,-(a7)
+    0x4CDF, 0x000F,             // 1034  movem.l (a7)+,d0-d3
+    0x6106,                     // 1038  bsr.s   $1040
+    0x51CF, 0xFFD6,             // 103A  dbf     d7,$1012
+    0x60C0,                     // 103E  bra.s   $1000
+    0x4A42,                     // 1040  tst.w   d2
+    0x6702,                     // 1042  beq.s   $1046
+    0x4442,                     // 1044  neg.w   d2
+    0x4E75,                     // 1046  rts
+};
+
+/** Write the program and its 256-byte source buffer through @p bus */
+static inline void bench_load_program(const bus_interface_t *bus)
+{
+    for (size_t i = 0; i < sizeof(s_bench_program) / sizeof(s_bench_program[0]); i++) {
+        bus->write_word(BENCH_PROG_START + (uint32_t)i * 2, s_bench_program[i]);
+    }
+    for (uint32_t i = 0; i < 0x100; i++) {
+        bus->write_byte(0x20000 + i, (uint8_t)(i * 37 + 11));
+    }
+}
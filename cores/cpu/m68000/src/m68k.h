@@ -0,0 +1,244 @@
+/**
+ * @file m68k.h
+ * @brief MC68000 core internal state and bus helpers
+ *
+ * The core is table driven: m68k_optable holds one handler per 16-bit
+ * opcode (65536 entries). The table and the handlers are generated at build
+ * time by tools/m68k_gen.py; every handler is a thin wrapper that calls one
+ * of the always-inline operation bodies in m68k_ops.h with its size and
+ * effective-address modes as compile-time constants, so the EA decoding is
+ * folded away per handler.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "component_api.h"
+
+#define M68K_INLINE         static inline __attribute__((always_inline))
+#define M68K_LIKELY(x)      __builtin_expect(!!(x), 1)
+#define M68K_UNLIKELY(x)    __builtin_expect(!!(x), 0)
+
+#define M68K_ADDR_MASK      0x00FFFFFF      // 24-bit address bus
+
+// Block cache code-page granularity (see m68k_bcache.c)
+#define M68K_BC_PAGE_SHIFT  8
+#define M68K_BC_PAGES       ((M68K_ADDR_MASK + 1) >> M68K_BC_PAGE_SHIFT)
+
+// Status register, system byte
+#define M68K_SR_T           0x8000
+#define M68K_SR_S           0x2000
+#define M68K_SR_IPL         0x0700
+#define M68K_SR_MASK        0xA71F          // Implemented bits on the 68000
+
+// Condition code register
+#define M68K_CCR_X          0x10
+#define M68K_CCR_N          0x08
+#define M68K_CCR_Z          0x04
+#define M68K_CCR_V          0x02
+#define M68K_CCR_C          0x01
+
+// Exception vector numbers (MC68000 UM Table 6-2)
+#define M68K_VEC_RESET_SSP      0
+#define M68K_VEC_RESET_PC       1
+#define M68K_VEC_BUS_ERROR      2
+#define M68K_VEC_ADDRESS_ERROR  3
+#define M68K_VEC_ILLEGAL        4
+#define M68K_VEC_ZERO_DIVIDE    5
+#define M68K_VEC_CHK            6
+#define M68K_VEC_TRAPV          7
+#define M68K_VEC_PRIVILEGE      8
+#define M68K_VEC_TRACE          9
+#define M68K_VEC_LINE_A         10
+#define M68K_VEC_LINE_F         11
+#define M68K_VEC_SPURIOUS       24
+#define M68K_VEC_AUTOVECTOR     24          // + level
+#define M68K_VEC_TRAP           32          // + n
+
+/**
+ * @brief Operation whose flags are still pending (see m68k_flags.h)
+ *
+ * Ops from M68K_LAZY_ADD on define X themselves; the others keep it in ccr.
+ */
+enum {
+    M68K_LAZY_NONE = 0,     ///< ccr holds all five flags
+    M68K_LAZY_LOGIC,
+    M68K_LAZY_CMP,
+    M68K_LAZY_ADD,
+    M68K_LAZY_SUB,
+};
+
+/**
+ * @brief MC68000 CPU context
+ *
+ * D0-D7 and A0-A7 share one array so that the EA register field can index
+ * address registers as dar[8 + n] and index words can select either bank
+ * with a single lookup.
+ */
+typedef struct m68k_cpu {
+    uint32_t dar[16];       ///< D0-D7, A0-A7 (A7 is the active stack pointer)
+    uint32_t pc;            ///< Address of the next word to fetch
+    uint32_t ppc;           ///< Address of the instruction being executed
+    uint32_t osp;           ///< Inactive stack pointer (USP in supervisor mode, SSP in user mode)
+    uint16_t sr;            ///< System byte (T, S, IPL); the CCR lives in ccr
+    uint8_t  ccr;           ///< X N Z V C, only X is current while lazy_op is set
+    uint8_t  lazy_op;       ///< M68K_LAZY_*
+    uint32_t lazy_src;      ///< Pending flag operands, sign bit moved to bit 31
+    uint32_t lazy_dst;
+    uint32_t lazy_res;
+
+    int      cycles;        ///< Cycles left in the current execute() slice
+    int      slice;         ///< Cycles requested for the current slice
+
+    int      irq_level;     ///< Level currently asserted by the GLUE/MFP
+    bool     nmi_pending;   ///< Level 7 edge latched
+    bool     service;       ///< Slow-path work pending (interrupts, trace)
+    bool     trace_pending; ///< Trace exception due after this instruction
+    bool     stopped;       ///< STOP executed, waiting for an interrupt
+    bool     halted;        ///< Double fault, only reset recovers
+
+    const bus_interface_t *bus;
+    uint64_t total_cycles;  ///< Cycles executed since reset
+
+    struct m68k_bcache *bcache; ///< Block cache, NULL when running interpreted
+    const uint8_t *code_pages;  ///< Bitmap of pages holding cached blocks
+    /** Dispatch table: m68k_optable, or a copy of it in placed memory */
+    void (*const *optable)(struct m68k_cpu *cpu, uint16_t op);
+} m68k_cpu_t;
+
+typedef void (*m68k_handler_t)(m68k_cpu_t *cpu, uint16_t op);
+
+/** Generated by tools/m68k_gen.py, one entry per opcode */
+extern const m68k_handler_t m68k_optable[0x10000];
+
+/** Number of distinct specialized handlers in m68k_optable */
+extern const int m68k_handler_count;
+
+void m68k_init(m68k_cpu_t *cpu, const bus_interface_t *bus);
+void m68k_reset(m68k_cpu_t *cpu);
+int  m68k_execute(m68k_cpu_t *cpu, int cycles);
+void m68k_end_slice(m68k_cpu_t *cpu);
+void m68k_set_irq(m68k_cpu_t *cpu, int level);
+void m68k_set_nmi(m68k_cpu_t *cpu);
+void m68k_set_sr(m68k_cpu_t *cpu, uint16_t sr);
+void m68k_exception(m68k_cpu_t *cpu, int vector, uint32_t return_pc);
+void m68k_get_state(m68k_cpu_t *cpu, cpu_state_t *state);
+void m68k_set_state(m68k_cpu_t *cpu, const cpu_state_t *state);
+
+bool m68k_bcache_enable(m68k_cpu_t *cpu, bool enable);
+void m68k_bcache_flush(m68k_cpu_t *cpu);
+void m68k_bcache_invalidate(m68k_cpu_t *cpu, uint32_t addr, uint32_t len);
+void m68k_bcache_step(m68k_cpu_t *cpu);
+
+// Operand sizes are passed around as byte counts: 1, 2 or 4
+M68K_INLINE uint32_t m68k_sz_mask(int sz)
+{
+    return sz == 1 ? 0xFFu : sz == 2 ? 0xFFFFu : 0xFFFFFFFFu;
+}
+
+M68K_INLINE uint32_t m68k_sz_msb(int sz)
+{
+    return sz == 1 ? 0x80u : sz == 2 ? 0x8000u : 0x80000000u;
+}
+
+// ---------------------------------------------------------------------------
+// Bus access. Every CPU memory access goes through these so the bus can map
+// RAM, ROM and I/O; the 68000 only drives 24 address lines.
+// ---------------------------------------------------------------------------
+
+M68K_INLINE uint32_t m68k_read8(m68k_cpu_t *cpu, uint32_t addr)
+{
+    return cpu->bus->read_byte(addr & M68K_ADDR_MASK);
+}
+
+M68K_INLINE uint32_t m68k_read16(m68k_cpu_t *cpu, uint32_t addr)
+{
+    return cpu->bus->read_word(addr & M68K_ADDR_MASK);
+}
+
+M68K_INLINE uint32_t m68k_read32(m68k_cpu_t *cpu, uint32_t addr)
+{
+    return cpu->bus->read_long(addr & M68K_ADDR_MASK);
+}
+
+/**
+ * @brief Drop cached blocks overlapping a CPU write
+ *
+ * Costs one load and a not-taken branch when the block cache is off. Only
+ * the first and last byte are checked; a write spans at most two pages.
+ */
+M68K_INLINE void m68k_code_write(m68k_cpu_t *cpu, uint32_t addr, uint32_t len)
+{
+    const uint8_t *pages = cpu->code_pages;
+
+    if (M68K_UNLIKELY(pages != NULL)) {
+        uint32_t first = addr >> M68K_BC_PAGE_SHIFT;
+        uint32_t last = ((addr + len - 1) & M68K_ADDR_MASK) >> M68K_BC_PAGE_SHIFT;
+        if ((pages[first >> 3] >> (first & 7)) & 1 || (pages[last >> 3] >> (last & 7)) & 1) {
+            m68k_bcache_invalidate(cpu, addr, len);
+        }
+    }
+}
+
+M68K_INLINE void m68k_write8(m68k_cpu_t *cpu, uint32_t addr, uint32_t val)
+{
+    addr &= M68K_ADDR_MASK;
+    m68k_code_write(cpu, addr, 1);
+    cpu->bus->write_byte(addr, (uint8_t)val);
+}
+
+M68K_INLINE void m68k_write16(m68k_cpu_t *cpu, uint32_t addr, uint32_t val)
+{
+    addr &= M68K_ADDR_MASK;
+    m68k_code_write(cpu, addr, 2);
+    cpu->bus->write_word(addr, (uint16_t)val);
+}
+
+M68K_INLINE void m68k_write32(m68k_cpu_t *cpu, uint32_t addr, uint32_t val)
+{
+    addr &= M68K_ADDR_MASK;
+    m68k_code_write(cpu, addr, 4);
+    cpu->bus->write_long(addr, val);
+}
+
+M68K_INLINE uint32_t m68k_fetch16(m68k_cpu_t *cpu)
+{
+    uint32_t w = m68k_read16(cpu, cpu->pc);
+    cpu->pc += 2;
+    return w;
+}
+
+M68K_INLINE uint32_t m68k_fetch32(m68k_cpu_t *cpu)
+{
+    uint32_t l = m68k_read32(cpu, cpu->pc);
+    cpu->pc += 4;
+    return l;
+}
+
+M68K_INLINE void m68k_push16(m68k_cpu_t *cpu, uint32_t val)
+{
+    cpu->dar[15] -= 2;
+    m68k_write16(cpu, cpu->dar[15], val);
+}
+
+M68K_INLINE void m68k_push32(m68k_cpu_t *cpu, uint32_t val)
+{
+    cpu->dar[15] -= 4;
+    m68k_write32(cpu, cpu->dar[15], val);
+}
+
+M68K_INLINE uint32_t m68k_pop16(m68k_cpu_t *cpu)
+{
+    uint32_t v = m68k_read16(cpu, cpu->dar[15]);
+    cpu->dar[15] += 2;
+    return v;
+}
+
+M68K_INLINE uint32_t m68k_pop32(m68k_cpu_t *cpu)
+{
+    uint32_t v = m68k_read32(cpu, cpu->dar[15]);
+    cpu->dar[15] += 4;
+    return v;
+}
@@ -0,0 +1,233 @@
+/**
+ * @file m68k_bcache.c
+ * @brief Basic-block cache for the MC68000 core
+ *
+ * Hot straight-line code is recorded once into an array of micro-ops
+ * (handler, opcode, address) and replayed without the opcode fetch through
+ * the bus and the m68k_optable lookup. Extension words are still read by
+ * the handlers, so only opcode words are cached.
+ *
+ * A block starts at an address that has been reached M68K_BC_HOT times and
+ * runs until the PC stops advancing sequentially (a taken branch, jump or
+ * exception), slow-path work is raised or the block is full. Replay checks
+ * each micro-op address against the PC, so a branch that goes the other way
+ * than it did while recording simply leaves the block.
+ *
+ * Blocks are keyed on the 24-bit bus address, the one writes are checked
+ * against, so code reached through a PC with the top byte set is cached
+ * and invalidated like any other.
+ *
+ * Coherency: every page (256 bytes) holding a cached block is marked in a
+ * bitmap that the CPU write helpers test; a write to a marked page drops
+ * all blocks on that page. Writes that do not come from the CPU (DMA,
+ * program loading) must call cpu_interface_t::invalidate.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "m68k.h"
+
+#define M68K_BC_BLOCKS      512     // Direct mapped on (pc >> 1)
+#define M68K_BC_MAX_OPS     16
+#define M68K_BC_HOT         4       // Visits before a block is recorded
+#define M68K_BC_MAX_INSN    10      // Longest 68000 instruction in bytes
+#define M68K_BC_EMPTY       0xFFFFFFFFu
+
+typedef struct {
+    m68k_handler_t handler;
+    uint32_t pc;            ///< Bus address of the opcode
+    uint16_t op;
+} m68k_uop_t;
+
+typedef struct {
+    uint32_t start;         ///< Address of the first opcode, M68K_BC_EMPTY if free
+    uint32_t end;           ///< One past the last byte the block may decode
+    uint16_t count;         ///< Recorded micro-ops, 0 while still warming up
+    uint16_t heat;          ///< Visits while warming up, replacement credit once recorded
+    m68k_uop_t ops[M68K_BC_MAX_OPS];
+} m68k_block_t;
+
+typedef struct m68k_bcache {
+    m68k_block_t blocks[M68K_BC_BLOCKS];
+    uint8_t pages[M68K_BC_PAGES / 8];
+    uint32_t records;
+    uint32_t invalidations;
+} m68k_bcache_t;
+
+static void bcache_mark(m68k_bcache_t *bc, uint32_t start, uint32_t end)
+{
+    if (end > M68K_ADDR_MASK + 1) {
+        end = M68K_ADDR_MASK + 1;
+    }
+    for (uint32_t p = start >> M68K_BC_PAGE_SHIFT; p <= ((end - 1) >> M68K_BC_PAGE_SHIFT); p++) {
+        bc->pages[p >> 3] |= (uint8_t)(1u << (p & 7));
+    }
+}
+
+static void bcache_reset(m68k_bcache_t *bc)
+{
+    for (int i = 0; i < M68K_BC_BLOCKS; i++) {
+        bc->blocks[i].start = M68K_BC_EMPTY;
+        bc->blocks[i].count = 0;
+        bc->blocks[i].heat = 0;
+    }
+    memset(bc->pages, 0, sizeof(bc->pages));
+}
+
+/**
+ * @brief Turn the block cache on or off
+ *
+ * @return false if the cache could not be allocated; the core then keeps
+ *         running interpreted
+ */
+bool m68k_bcache_enable(m68k_cpu_t *cpu, bool enable)
+{
+    if (!enable) {
+        free(cpu->bcache);
+        cpu->bcache = NULL;
+        cpu->code_pages = NULL;
+        return true;
+    }
+    if (!cpu->bcache) {
+        cpu->bcache = malloc(sizeof(m68k_bcache_t));
+        if (!cpu->bcache) {
+            return false;
+        }
+        cpu->bcache->records = 0;
+        cpu->bcache->invalidations = 0;
+        bcache_reset(cpu->bcache);
+        cpu->code_pages = cpu->bcache->pages;
+    }
+    return true;
+}
+
+void m68k_bcache_flush(m68k_cpu_t *cpu)
+{
+    if (cpu->bcache) {
+        bcache_reset(cpu->bcache);
+    }
+}
+
+/**
+ * @brief Drop every block on the pages touched by [addr, addr + len)
+ *
+ * Page granular, so the page bits can be cleared afterwards and further
+ * writes to the same data are free until code there is recorded again.
+ */
+void m68k_bcache_invalidate(m68k_cpu_t *cpu, uint32_t addr, uint32_t len)
+{
+    m68k_bcache_t *bc = cpu->bcache;
+
+    if (!bc || len == 0) {
+        return;
+    }
+    addr &= M68K_ADDR_MASK;
+    uint32_t last = len > M68K_ADDR_MASK - addr ? M68K_ADDR_MASK : addr + len - 1;
+    uint32_t lo = addr & ~((1u << M68K_BC_PAGE_SHIFT) - 1);
+    uint32_t hi = (last | ((1u << M68K_BC_PAGE_SHIFT) - 1)) + 1;     // At most 1 << 24
+
+    for (int i = 0; i < M68K_BC_BLOCKS; i++) {
+        m68k_block_t *b = &bc->blocks[i];
+        if (b->start != M68K_BC_EMPTY && b->start < hi && b->end > lo) {
+            // The replay loop rereads count, so a block that overwrites
+            // itself stops right after the write
+            b->start = M68K_BC_EMPTY;
+            b->count = 0;
+            b->heat = 0;
+        }
+    }
+    for (uint32_t p = lo >> M68K_BC_PAGE_SHIFT; p < (hi >> M68K_BC_PAGE_SHIFT); p++) {
+        bc->pages[p >> 3] &= (uint8_t)~(1u << (p & 7));
+    }
+    bc->invalidations++;
+}
+
+/**
+ * @brief Interpret instructions from cpu->pc, recording them into @p b
+ */
+static void bcache_record(m68k_cpu_t *cpu, m68k_bcache_t *bc, m68k_block_t *b)
+{
+    uint32_t start = cpu->pc & M68K_ADDR_MASK;
+
+    b->start = start;
+    b->end = start + M68K_BC_MAX_INSN;
+    b->count = 0;
+    bcache_mark(bc, start, b->end);
+    bc->records++;
+
+    for (;;) {
+        uint32_t pc = cpu->pc & M68K_ADDR_MASK;
+        cpu->ppc = cpu->pc;
+        uint16_t op = (uint16_t)m68k_fetch16(cpu);
+        m68k_handler_t handler = cpu->optable[op];
+
+        handler(cpu, op);
+        if (b->start != start) {
+            return;     // Invalidated by its own write
+        }
+        b->ops[b->count].handler = handler;
+        b->ops[b->count].pc = pc;
+        b->ops[b->count].op = op;
+        b->count++;
+
+        uint32_t next = cpu->pc & M68K_ADDR_MASK;
+        if (next <= pc || next > pc + M68K_BC_MAX_INSN ||
+            b->count == M68K_BC_MAX_OPS || cpu->cycles <= 0 || cpu->service) {
+            return;
+        }
+        b->end = next + M68K_BC_MAX_INSN;
+        bcache_mark(bc, next, b->end);
+    }
+}
+
+/**
+ * @brief Run one block, or one interpreted instruction when none is cached
+ *
+ * Called from m68k_execute() in place of the plain fetch/dispatch. Stops at
+ * the same instruction boundaries as the interpreter (cycles exhausted or
+ * slow-path work raised), so both produce identical state per slice.
+ */
+void m68k_bcache_step(m68k_cpu_t *cpu)
+{
+    m68k_bcache_t *bc = cpu->bcache;
+    uint32_t pc = cpu->pc & M68K_ADDR_MASK;
+    m68k_block_t *b = &bc->blocks[(pc >> 1) & (M68K_BC_BLOCKS - 1)];
+
+    if (b->start == pc) {
+        if (b->count) {
+            const m68k_uop_t *u = b->ops;
+            for (int i = 0; i < b->count; i++, u++) {
+                if ((cpu->pc & M68K_ADDR_MASK) != u->pc) {
+                    break;      // Left the recorded path
+                }
+                // Step the PC itself to keep its top byte, as the interpreter does
+                cpu->ppc = cpu->pc;
+                cpu->pc += 2;
+                u->handler(cpu, u->op);
+                if (cpu->cycles <= 0 || cpu->service) {
+                    break;
+                }
+            }
+            if (b->heat < M68K_BC_HOT) {
+                b->heat++;
+            }
+            return;
+        }
+        if (++b->heat >= M68K_BC_HOT) {
+            bcache_record(cpu, bc, b);
+            return;
+        }
+    } else if (b->count && b->heat) {
+        // Slot holds a live block; make the newcomer wait for it to cool
+        b->heat--;
+    } else {
+        b->start = pc;
+        b->end = pc;
+        b->count = 0;
+        b->heat = 1;
+    }
+
+    cpu->ppc = cpu->pc;
+    uint16_t op = (uint16_t)m68k_fetch16(cpu);
+    cpu->optable[op](cpu, op);
+}
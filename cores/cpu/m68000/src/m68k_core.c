@@ -0,0 +1,233 @@
+/**
+ * @file m68k_core.c
+ * @brief MC68000 CPU emulation core
+ *
+ * Execution loop, exception processing and interrupt handling. Instruction
+ * decoding is a single indexed call through m68k_optable; everything that is
+ * not per-instruction work (interrupts, trace, STOP) is kept off the hot
+ * path behind cpu->service.
+ */
+
+#include <string.h>
+#include "m68k.h"
+#include "m68k_flags.h"
+
+/** Interrupt acknowledge + exception processing, MC68000 UM Table 8-14 */
+#define M68K_CYC_INTERRUPT  44
+#define M68K_CYC_TRACE      34
+
+void m68k_init(m68k_cpu_t *cpu, const bus_interface_t *bus)
+{
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->bus = bus;
+    cpu->optable = m68k_optable;
+}
+
+/**
+ * @brief Load a new SR, swapping stack pointers on an S bit change
+ */
+void m68k_set_sr(m68k_cpu_t *cpu, uint16_t sr)
+{
+    uint16_t old = cpu->sr;
+
+    sr &= M68K_SR_MASK;
+    if ((old ^ sr) & M68K_SR_S) {
+        uint32_t sp = cpu->dar[15];
+        cpu->dar[15] = cpu->osp;
+        cpu->osp = sp;
+    }
+    cpu->sr = sr & 0xFF00;
+    m68k_set_ccr(cpu, sr);
+
+    // A lower mask may unblock a pending interrupt, T arms tracing
+    if (cpu->irq_level || cpu->nmi_pending || (sr & M68K_SR_T)) {
+        cpu->service = true;
+    }
+}
+
+/**
+ * @brief Group 1/2 exception processing
+ *
+ * Enters supervisor mode, stacks PC and SR and loads the handler address.
+ * The caller charges the cycles, which differ per exception type.
+ */
+void m68k_exception(m68k_cpu_t *cpu, int vector, uint32_t return_pc)
+{
+    uint16_t old_sr = m68k_get_sr(cpu);
+
+    m68k_set_sr(cpu, (uint16_t)((old_sr | M68K_SR_S) & ~M68K_SR_T));
+    cpu->trace_pending = false;
+    m68k_push32(cpu, return_pc);
+    m68k_push16(cpu, old_sr);
+    cpu->pc = m68k_read32(cpu, (uint32_t)vector * 4);
+}
+
+void m68k_reset(m68k_cpu_t *cpu)
+{
+    cpu->stopped = false;
+    cpu->halted = false;
+    cpu->trace_pending = false;
+    cpu->nmi_pending = false;
+    cpu->sr = M68K_SR_S | M68K_SR_IPL;
+    m68k_set_ccr(cpu, 0);
+    cpu->dar[15] = m68k_read32(cpu, M68K_VEC_RESET_SSP * 4);
+    cpu->pc = m68k_read32(cpu, M68K_VEC_RESET_PC * 4);
+    cpu->total_cycles = 0;
+    cpu->service = cpu->irq_level != 0;
+    // The memory map may change across a reset (ROM overlay at address 0)
+    m68k_bcache_flush(cpu);
+}
+
+void m68k_set_irq(m68k_cpu_t *cpu, int level)
+{
+    // Level 7 is non-maskable and edge triggered
+    if (level == 7 && cpu->irq_level != 7) {
+        cpu->nmi_pending = true;
+    }
+    cpu->irq_level = level;
+    if (level) {
+        cpu->service = true;
+    }
+}
+
+void m68k_set_nmi(m68k_cpu_t *cpu)
+{
+    cpu->nmi_pending = true;
+    cpu->service = true;
+}
+
+/**
+ * @brief Take an interrupt if one above the current mask is pending
+ *
+ * @return true if an interrupt was taken
+ */
+static bool m68k_check_interrupts(m68k_cpu_t *cpu)
+{
+    int mask = (cpu->sr & M68K_SR_IPL) >> 8;
+    int level = cpu->irq_level;
+
+    if (cpu->nmi_pending) {
+        cpu->nmi_pending = false;
+        level = 7;
+    } else if (level <= mask) {
+        return false;
+    }
+
+    int vector = cpu->bus->int_ack ? cpu->bus->int_ack(level) : -1;
+    if (vector < 0) {
+        vector = M68K_VEC_AUTOVECTOR + level;
+    }
+    cpu->stopped = false;
+    m68k_exception(cpu, vector, cpu->pc);
+    cpu->sr = (uint16_t)((cpu->sr & ~M68K_SR_IPL) | (level << 8));
+    cpu->cycles -= M68K_CYC_INTERRUPT;
+    return true;
+}
+
+/**
+ * @brief Slow path run between instructions while cpu->service is set
+ *
+ * Order matches the 68000 priority: trace of the previous instruction, then
+ * interrupts. Clears cpu->service once nothing is left to watch.
+ */
+static void m68k_service(m68k_cpu_t *cpu)
+{
+    if (cpu->trace_pending) {
+        cpu->trace_pending = false;
+        m68k_exception(cpu, M68K_VEC_TRACE, cpu->pc);
+        cpu->cycles -= M68K_CYC_TRACE;
+    }
+
+    m68k_check_interrupts(cpu);
+
+    if (cpu->sr & M68K_SR_T) {
+        cpu->trace_pending = true;
+        return;
+    }
+    int mask = (cpu->sr & M68K_SR_IPL) >> 8;
+    if (!cpu->stopped && !cpu->nmi_pending && cpu->irq_level <= mask) {
+        cpu->service = false;
+    }
+}
+
+/**
+ * @brief Run for at least @p cycles clock cycles
+ *
+ * The last instruction may overshoot the budget; the overshoot is included
+ * in the return value so the scheduler can carry it into the next slice.
+ *
+ * @return Cycles actually consumed
+ */
+int m68k_execute(m68k_cpu_t *cpu, int cycles)
+{
+    cpu->cycles = cycles;
+    cpu->slice = cycles;
+
+    if (M68K_UNLIKELY(cpu->halted)) {
+        cpu->total_cycles += (uint64_t)cycles;
+        return cycles;
+    }
+
+    do {
+        if (M68K_UNLIKELY(cpu->service)) {
+            m68k_service(cpu);
+            if (cpu->stopped) {
+                // Idle until an interrupt; burn the rest of the slice
+                cpu->cycles = 0;
+                break;
+            }
+        }
+        if (cpu->bcache) {
+            m68k_bcache_step(cpu);
+            continue;
+        }
+        cpu->ppc = cpu->pc;
+        uint16_t op = (uint16_t)m68k_fetch16(cpu);
+        cpu->optable[op](cpu, op);
+    } while (cpu->cycles > 0);
+
+    int used = cpu->slice - cpu->cycles;
+    cpu->total_cycles += (uint64_t)used;
+    return used;
+}
+
+/**
+ * @brief Make execute() return after the current instruction
+ *
+ * Used by the debugger and by chip register writes that change the next
+ * event deadline.
+ */
+void m68k_end_slice(m68k_cpu_t *cpu)
+{
+    cpu->slice -= cpu->cycles;
+    cpu->cycles = 0;
+}
+
+void m68k_get_state(m68k_cpu_t *cpu, cpu_state_t *state)
+{
+    bool super = (cpu->sr & M68K_SR_S) != 0;
+
+    memcpy(state->d, &cpu->dar[0], sizeof(state->d));
+    memcpy(state->a, &cpu->dar[8], sizeof(state->a));
+    state->pc = cpu->pc;
+    state->sr = m68k_get_sr(cpu);
+    state->usp = super ? cpu->osp : cpu->dar[15];
+    state->ssp = super ? cpu->dar[15] : cpu->osp;
+    state->cycles = cpu->total_cycles;
+}
+
+void m68k_set_state(m68k_cpu_t *cpu, const cpu_state_t *state)
+{
+    bool super = (state->sr & M68K_SR_S) != 0;
+
+    memcpy(&cpu->dar[0], state->d, sizeof(state->d));
+    memcpy(&cpu->dar[8], state->a, sizeof(state->a));
+    cpu->pc = state->pc;
+    cpu->sr = state->sr & M68K_SR_MASK & 0xFF00;
+    m68k_set_ccr(cpu, state->sr);
+    cpu->dar[15] = super ? state->ssp : state->usp;
+    cpu->osp = super ? state->usp : state->ssp;
+    cpu->total_cycles = state->cycles;
+    cpu->stopped = false;
+    cpu->service = true;
+}
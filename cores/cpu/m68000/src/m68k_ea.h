@@ -0,0 +1,199 @@
+/**
+ * @file m68k_ea.h
+ * @brief MC68000 effective address modes
+ *
+ * The mode argument of every function here is always a compile-time
+ * constant in the generated handlers, so each switch collapses to the code
+ * for a single addressing mode. Only the register number is decoded at run
+ * time from the opcode.
+ */
+
+#pragma once
+
+#include "m68k.h"
+
+/**
+ * @brief Addressing modes, with mode 7 split by its register field
+ *
+ * The numbering must match EA_MODES in tools/m68k_gen.py.
+ */
+enum {
+    EA_DN   = 0,    // Dn
+    EA_AN   = 1,    // An
+    EA_AI   = 2,    // (An)
+    EA_PI   = 3,    // (An)+
+    EA_PD   = 4,    // -(An)
+    EA_DI   = 5,    // d16(An)
+    EA_IX   = 6,    // d8(An,Xn)
+    EA_AW   = 7,    // abs.W
+    EA_AL   = 8,    // abs.L
+    EA_PCDI = 9,    // d16(PC)
+    EA_PCIX = 10,   // d8(PC,Xn)
+    EA_IMM  = 11,   // #imm
+};
+
+#define M68K_DREG(cpu, n)   ((cpu)->dar[(n)])
+#define M68K_AREG(cpu, n)   ((cpu)->dar[8 + (n)])
+
+/**
+ * @brief Effective address calculation time, MC68000 UM Table 8-1
+ */
+M68K_INLINE int m68k_ea_time(int mode, int sz)
+{
+    bool l = (sz == 4);
+    switch (mode) {
+    case EA_DN:
+    case EA_AN:   return 0;
+    case EA_AI:
+    case EA_PI:   return l ? 8 : 4;
+    case EA_PD:   return l ? 10 : 6;
+    case EA_DI:   return l ? 12 : 8;
+    case EA_IX:   return l ? 14 : 10;
+    case EA_AW:   return l ? 12 : 8;
+    case EA_AL:   return l ? 16 : 12;
+    case EA_PCDI: return l ? 12 : 8;
+    case EA_PCIX: return l ? 14 : 10;
+    default:      return l ? 8 : 4;     // #imm
+    }
+}
+
+/**
+ * @brief Destination EA time for MOVE, MC68000 UM Table 8-2
+ *
+ * Same as the source table except -(An), which costs no extra cycles as a
+ * MOVE destination.
+ */
+M68K_INLINE int m68k_ea_dst_time(int mode, int sz)
+{
+    return mode == EA_PD ? m68k_ea_time(EA_AI, sz) : m68k_ea_time(mode, sz);
+}
+
+/** Brief extension word index: d8(base, Xn.W/L) */
+M68K_INLINE uint32_t m68k_ea_index(m68k_cpu_t *cpu, uint32_t base)
+{
+    uint32_t ext = m68k_fetch16(cpu);
+    uint32_t xn = cpu->dar[ext >> 12];
+    if (!(ext & 0x0800)) {
+        xn = (uint32_t)(int16_t)xn;
+    }
+    return base + xn + (uint32_t)(int8_t)ext;
+}
+
+/**
+ * @brief Compute the address of a memory operand
+ *
+ * Applies the (An)+ / -(An) side effects; byte accesses through A7 keep the
+ * stack word aligned.
+ */
+M68K_INLINE uint32_t m68k_ea_addr(m68k_cpu_t *cpu, int mode, int reg, int sz)
+{
+    uint32_t a, step;
+
+    switch (mode) {
+    case EA_AI:
+        return M68K_AREG(cpu, reg);
+    case EA_PI:
+        step = (sz == 1 && reg == 7) ? 2 : (uint32_t)sz;
+        a = M68K_AREG(cpu, reg);
+        M68K_AREG(cpu, reg) = a + step;
+        return a;
+    case EA_PD:
+        step = (sz == 1 && reg == 7) ? 2 : (uint32_t)sz;
+        M68K_AREG(cpu, reg) -= step;
+        return M68K_AREG(cpu, reg);
+    case EA_DI:
+        a = M68K_AREG(cpu, reg);
+        return a + (uint32_t)(int16_t)m68k_fetch16(cpu);
+    case EA_IX:
+        return m68k_ea_index(cpu, M68K_AREG(cpu, reg));
+    case EA_AW:
+        return (uint32_t)(int16_t)m68k_fetch16(cpu);
+    case EA_AL:
+        return m68k_fetch32(cpu);
+    case EA_PCDI:
+        a = cpu->pc;
+        return a + (uint32_t)(int16_t)m68k_fetch16(cpu);
+    case EA_PCIX:
+        return m68k_ea_index(cpu, cpu->pc);
+    default:
+        return 0;
+    }
+}
+
+M68K_INLINE uint32_t m68k_read_sz(m68k_cpu_t *cpu, uint32_t addr, int sz)
+{
+    return sz == 1 ? m68k_read8(cpu, addr) : sz == 2 ? m68k_read16(cpu, addr) : m68k_read32(cpu, addr);
+}
+
+M68K_INLINE void m68k_write_sz(m68k_cpu_t *cpu, uint32_t addr, uint32_t val, int sz)
+{
+    if (sz == 1) {
+        m68k_write8(cpu, addr, val);
+    } else if (sz == 2) {
+        m68k_write16(cpu, addr, val);
+    } else {
+        m68k_write32(cpu, addr, val);
+    }
+}
+
+/** Immediate operand; byte immediates occupy the low half of a word */
+M68K_INLINE uint32_t m68k_fetch_imm(m68k_cpu_t *cpu, int sz)
+{
+    return sz == 1 ? (m68k_fetch16(cpu) & 0xFF) : sz == 2 ? m68k_fetch16(cpu) : m68k_fetch32(cpu);
+}
+
+/**
+ * @brief Read an operand
+ *
+ * @param addr Receives the operand address for memory modes, so that a
+ *             read-modify-write can store back without recomputing the EA
+ * @return Operand zero-extended to 32 bits
+ */
+M68K_INLINE uint32_t m68k_ea_read(m68k_cpu_t *cpu, int mode, int reg, int sz, uint32_t *addr)
+{
+    switch (mode) {
+    case EA_DN:
+        return M68K_DREG(cpu, reg) & m68k_sz_mask(sz);
+    case EA_AN:
+        return M68K_AREG(cpu, reg) & m68k_sz_mask(sz);
+    case EA_IMM:
+        return m68k_fetch_imm(cpu, sz);
+    default:
+        *addr = m68k_ea_addr(cpu, mode, reg, sz);
+        return m68k_read_sz(cpu, *addr, sz);
+    }
+}
+
+/** Store to a data register, leaving the bits above the operand size */
+M68K_INLINE void m68k_set_dreg(m68k_cpu_t *cpu, int reg, uint32_t val, int sz)
+{
+    if (sz == 1) {
+        M68K_DREG(cpu, reg) = (M68K_DREG(cpu, reg) & ~0xFFu) | (val & 0xFF);
+    } else if (sz == 2) {
+        M68K_DREG(cpu, reg) = (M68K_DREG(cpu, reg) & ~0xFFFFu) | (val & 0xFFFF);
+    } else {
+        M68K_DREG(cpu, reg) = val;
+    }
+}
+
+/** Write back to an operand previously read with m68k_ea_read() */
+M68K_INLINE void m68k_ea_write(m68k_cpu_t *cpu, int mode, int reg, int sz, uint32_t addr, uint32_t val)
+{
+    if (mode == EA_DN) {
+        m68k_set_dreg(cpu, reg, val, sz);
+    } else if (mode == EA_AN) {
+        M68K_AREG(cpu, reg) = val;
+    } else {
+        m68k_write_sz(cpu, addr, val, sz);
+    }
+}
+
+/** Write-only destination (MOVE, CLR, Scc): computes the EA itself */
+M68K_INLINE void m68k_ea_store(m68k_cpu_t *cpu, int mode, int reg, int sz, uint32_t val)
+{
+    if (mode == EA_DN) {
+        m68k_set_dreg(cpu, reg, val, sz);
+    } else {
+        m68k_write_sz(cpu, m68k_ea_addr(cpu, mode, reg, sz), val, sz);
+    }
+}
@@ -0,0 +1,162 @@
+/**
+ * @file m68k_entry.c
+ * @brief cpu_interface_t adapter for the MC68000 core
+ *
+ * The component interface has no context argument, so the single CPU
+ * instance a component provides lives here; all core code works on the
+ * m68k_cpu_t passed to it.
+ *
+ * The component itself is loaded into PSRAM. If the firmware offers placed
+ * storage (cpu_config_t::alloc_hot), the register file ("cpu_regs") and a
+ * copy of the opcode table ("opcode_table") move there for as long as the
+ * component is initialized; otherwise the static copies below are used.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "m68k.h"
+
+#define M68K_DEFAULT_CLOCK_HZ   8000000
+
+static m68k_cpu_t s_cpu_static;
+static m68k_cpu_t *s_cpu = &s_cpu_static;
+static cpu_config_t s_config;
+
+/** Give placed storage back and return to the static copies */
+static void m68000_release_hot(void)
+{
+    const bus_interface_t *bus = s_cpu->bus;
+    bool placed_regs = s_cpu != &s_cpu_static;
+    bool placed_table = s_cpu->optable && s_cpu->optable != m68k_optable;
+
+    s_cpu = &s_cpu_static;
+    s_cpu->bus = bus;
+    s_cpu->optable = m68k_optable;
+    if (!s_config.free_hot) {
+        return;
+    }
+    if (placed_table) {
+        s_config.free_hot("opcode_table");
+    }
+    if (placed_regs) {
+        s_config.free_hot("cpu_regs");
+    }
+}
+
+static int m68000_init(void *config)
+{
+    const bus_interface_t *bus;
+
+    m68k_bcache_enable(s_cpu, false);
+    m68000_release_hot();
+    bus = s_cpu->bus;
+
+    s_config = (cpu_config_t) { .clock_hz = M68K_DEFAULT_CLOCK_HZ };
+    if (config) {
+        s_config = *(const cpu_config_t *)config;
+    }
+    if (s_config.alloc_hot) {
+        m68k_cpu_t *regs = s_config.alloc_hot("cpu_regs", sizeof(m68k_cpu_t));
+        if (regs) {
+            s_cpu = regs;
+        }
+    }
+    m68k_init(s_cpu, bus);
+    if (s_config.alloc_hot) {
+        m68k_handler_t *table = s_config.alloc_hot("opcode_table", sizeof(m68k_optable));
+        if (table) {
+            memcpy(table, m68k_optable, sizeof(m68k_optable));
+            s_cpu->optable = table;
+        }
+    }
+    if (s_config.flags & CPU_CONFIG_BLOCK_CACHE) {
+        // Fall back to the interpreter if there is no room for the cache
+        m68k_bcache_enable(s_cpu, true);
+    }
+    return 0;
+}
+
+static void m68000_reset(void)
+{
+    m68k_reset(s_cpu);
+}
+
+static void m68000_shutdown(void)
+{
+    m68k_bcache_enable(s_cpu, false);
+    m68000_release_hot();
+    s_cpu->bus = NULL;
+}
+
+static int m68000_execute(int cycles)
+{
+    return m68k_execute(s_cpu, cycles);
+}
+
+static void m68000_stop(void)
+{
+    m68k_end_slice(s_cpu);
+}
+
+static int m68000_get_elapsed(void)
+{
+    return s_cpu->slice - s_cpu->cycles;
+}
+
+static void m68000_get_state(cpu_state_t *state)
+{
+    m68k_get_state(s_cpu, state);
+}
+
+static void m68000_set_state(const cpu_state_t *state)
+{
+    m68k_set_state(s_cpu, state);
+}
+
+static void m68000_set_irq(int level)
+{
+    m68k_set_irq(s_cpu, level);
+}
+
+static void m68000_set_nmi(void)
+{
+    m68k_set_nmi(s_cpu);
+}
+
+static void m68000_set_bus(const bus_interface_t *bus)
+{
+    s_cpu->bus = bus;
+}
+
+static void m68000_invalidate(uint32_t addr, uint32_t len)
+{
+    m68k_bcache_invalidate(s_cpu, addr & M68K_ADDR_MASK, len);
+}
+
+static const cpu_interface_t s_m68000_interface = {
+    .interface_version = CPU_INTERFACE_V1,
+    .name              = "MC68000",
+    .features          = CPU_FEATURE_BLOCK_CACHE,
+    .init              = m68000_init,
+    .reset             = m68000_reset,
+    .shutdown          = m68000_shutdown,
+    .execute           = m68000_execute,
+    .stop              = m68000_stop,
+    .get_elapsed       = m68000_get_elapsed,
+    .get_state         = m68000_get_state,
+    .set_state         = m68000_set_state,
+    .set_irq           = m68000_set_irq,
+    .set_nmi           = m68000_set_nmi,
+    .set_bus           = m68000_set_bus,
+    .invalidate        = m68000_invalidate,
+    .disassemble       = NULL,
+    .set_breakpoint    = NULL,
+};
+
+/**
+ * @brief Component entry point (EBIN "Entry Offset")
+ */
+const cpu_interface_t *m68000_entry(void)
+{
+    return &s_m68000_interface;
+}
@@ -0,0 +1,339 @@
+/**
+ * @file m68k_flags.h
+ * @brief MC68000 condition code computation
+ *
+ * All instruction bodies update the CCR through these helpers and read it
+ * back through m68k_get_ccr()/m68k_get_x()/m68k_test_cc(), so the flag
+ * representation is private to this file.
+ *
+ * Flags are evaluated lazily: MOVE/logic, ADD, SUB and CMP only record the
+ * operation and its operands, and the five flags are computed when
+ * something reads them (Bcc/Scc/DBcc, MOVE from SR, exceptions,
+ * get_state()). Most results are overwritten before that happens.
+ * Operands are stored shifted left so their sign bit is bit 31, which
+ * makes the flag formulas size independent and lets m68k_test_cc() answer
+ * the common conditions straight from the operands.
+ *
+ * Building with M68K_EAGER_FLAGS=1 selects the eager reference
+ * implementation, used by the benchmark to measure the difference.
+ *
+ * Flag rules follow the MC68000 Programmer's Reference Manual, section 3.
+ */
+
+#pragma once
+
+#include "m68k.h"
+
+#ifndef M68K_EAGER_FLAGS
+#define M68K_EAGER_FLAGS    0
+#endif
+
+M68K_INLINE uint32_t m68k_nz(uint32_t res, int sz)
+{
+    uint32_t f = (res & m68k_sz_mask(sz)) ? 0 : M68K_CCR_Z;
+    if (res & m68k_sz_msb(sz)) {
+        f |= M68K_CCR_N;
+    }
+    return f;
+}
+
+/** Evaluate condition @p cc against materialized flags @p f */
+M68K_INLINE bool m68k_cc_eval(int cc, uint32_t f)
+{
+    bool n = f & M68K_CCR_N, z = f & M68K_CCR_Z, v = f & M68K_CCR_V, c = f & M68K_CCR_C;
+
+    switch (cc) {
+    case 0x0: return true;                  // T
+    case 0x1: return false;                 // F
+    case 0x2: return !c && !z;              // HI
+    case 0x3: return c || z;                // LS
+    case 0x4: return !c;                    // CC
+    case 0x5: return c;                     // CS
+    case 0x6: return !z;                    // NE
+    case 0x7: return z;                     // EQ
+    case 0x8: return !v;                    // VC
+    case 0x9: return v;                     // VS
+    case 0xA: return !n;                    // PL
+    case 0xB: return n;                     // MI
+    case 0xC: return n == v;                // GE
+    case 0xD: return n != v;                // LT
+    case 0xE: return !z && (n == v);        // GT
+    default:  return z || (n != v);         // LE
+    }
+}
+
+#if M68K_EAGER_FLAGS
+
+/** MOVE, AND, OR, EOR, NOT, TST, CLR...: N Z set, V C cleared, X kept */
+M68K_INLINE void m68k_flags_logic(m68k_cpu_t *cpu, uint32_t res, int sz)
+{
+    cpu->ccr = (uint8_t)((cpu->ccr & M68K_CCR_X) | m68k_nz(res, sz));
+}
+
+/** ADD, ADDI, ADDQ: all five flags, X = C */
+M68K_INLINE void m68k_flags_add(m68k_cpu_t *cpu, uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    uint32_t msb = m68k_sz_msb(sz);
+    uint32_t f = m68k_nz(res, sz);
+    if (((src ^ res) & (dst ^ res)) & msb) {
+        f |= M68K_CCR_V;
+    }
+    if (((src & dst) | (~res & (src | dst))) & msb) {
+        f |= M68K_CCR_C | M68K_CCR_X;
+    }
+    cpu->ccr = (uint8_t)f;
+}
+
+/** SUB, SUBI, SUBQ, NEG (src - 0): all five flags, X = C */
+M68K_INLINE void m68k_flags_sub(m68k_cpu_t *cpu, uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    uint32_t msb = m68k_sz_msb(sz);
+    uint32_t f = m68k_nz(res, sz);
+    if (((src ^ dst) & (res ^ dst)) & msb) {
+        f |= M68K_CCR_V;
+    }
+    if (((src & res) | (~dst & (src | res))) & msb) {
+        f |= M68K_CCR_C | M68K_CCR_X;
+    }
+    cpu->ccr = (uint8_t)f;
+}
+
+/** CMP, CMPA, CMPI, CMPM: as SUB but X is not affected */
+M68K_INLINE void m68k_flags_cmp(m68k_cpu_t *cpu, uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    uint32_t msb = m68k_sz_msb(sz);
+    uint32_t f = (cpu->ccr & M68K_CCR_X) | m68k_nz(res, sz);
+    if (((src ^ dst) & (res ^ dst)) & msb) {
+        f |= M68K_CCR_V;
+    }
+    if (((src & res) | (~dst & (src | res))) & msb) {
+        f |= M68K_CCR_C;
+    }
+    cpu->ccr = (uint8_t)f;
+}
+
+/** Set the whole CCR, for shifts, MOVE to CCR, RTR and friends */
+M68K_INLINE void m68k_set_ccr(m68k_cpu_t *cpu, uint32_t ccr)
+{
+    cpu->ccr = (uint8_t)(ccr & 0x1F);
+}
+
+M68K_INLINE uint32_t m68k_get_ccr(m68k_cpu_t *cpu)
+{
+    return cpu->ccr;
+}
+
+M68K_INLINE uint32_t m68k_get_x(m68k_cpu_t *cpu)
+{
+    return (cpu->ccr >> 4) & 1;
+}
+
+M68K_INLINE bool m68k_test_cc(m68k_cpu_t *cpu, int cc)
+{
+    return m68k_cc_eval(cc, cpu->ccr);
+}
+
+#else // Lazy flags
+
+/** Shift that moves the sign bit of a @p sz byte operand to bit 31 */
+M68K_INLINE int m68k_lazy_shift(int sz)
+{
+    return 32 - 8 * sz;
+}
+
+M68K_INLINE uint32_t m68k_lazy_carry_add(const m68k_cpu_t *cpu)
+{
+    uint32_t s = cpu->lazy_src, d = cpu->lazy_dst, r = cpu->lazy_res;
+    return ((s & d) | (~r & (s | d))) >> 31;
+}
+
+M68K_INLINE uint32_t m68k_lazy_carry_sub(const m68k_cpu_t *cpu)
+{
+    // Operands share the same shift, so the borrow is an unsigned compare
+    return cpu->lazy_src > cpu->lazy_dst;
+}
+
+/**
+ * @brief Current X flag
+ *
+ * ADD and SUB define X; logic ops and CMP keep the previous one, which is
+ * then in cpu->ccr.
+ */
+M68K_INLINE uint32_t m68k_get_x(m68k_cpu_t *cpu)
+{
+    switch (cpu->lazy_op) {
+    case M68K_LAZY_ADD: return m68k_lazy_carry_add(cpu);
+    case M68K_LAZY_SUB: return m68k_lazy_carry_sub(cpu);
+    default:            return (cpu->ccr >> 4) & 1;
+    }
+}
+
+/** Park X in cpu->ccr before recording an op that does not change it */
+M68K_INLINE void m68k_lazy_keep_x(m68k_cpu_t *cpu)
+{
+    if (cpu->lazy_op >= M68K_LAZY_ADD) {
+        cpu->ccr = (uint8_t)(m68k_get_x(cpu) << 4);
+    }
+}
+
+/** MOVE, AND, OR, EOR, NOT, TST, CLR...: N Z set, V C cleared, X kept */
+M68K_INLINE void m68k_flags_logic(m68k_cpu_t *cpu, uint32_t res, int sz)
+{
+    m68k_lazy_keep_x(cpu);
+    cpu->lazy_op = M68K_LAZY_LOGIC;
+    cpu->lazy_res = res << m68k_lazy_shift(sz);
+}
+
+/** ADD, ADDI, ADDQ: all five flags, X = C */
+M68K_INLINE void m68k_flags_add(m68k_cpu_t *cpu, uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    int sh = m68k_lazy_shift(sz);
+
+    cpu->lazy_op = M68K_LAZY_ADD;
+    cpu->lazy_src = src << sh;
+    cpu->lazy_dst = dst << sh;
+    cpu->lazy_res = res << sh;
+}
+
+/** SUB, SUBI, SUBQ, NEG (src - 0): all five flags, X = C */
+M68K_INLINE void m68k_flags_sub(m68k_cpu_t *cpu, uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    int sh = m68k_lazy_shift(sz);
+
+    cpu->lazy_op = M68K_LAZY_SUB;
+    cpu->lazy_src = src << sh;
+    cpu->lazy_dst = dst << sh;
+    cpu->lazy_res = res << sh;
+}
+
+/** CMP, CMPA, CMPI, CMPM: as SUB but X is not affected */
+M68K_INLINE void m68k_flags_cmp(m68k_cpu_t *cpu, uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    int sh = m68k_lazy_shift(sz);
+
+    m68k_lazy_keep_x(cpu);
+    cpu->lazy_op = M68K_LAZY_CMP;
+    cpu->lazy_src = src << sh;
+    cpu->lazy_dst = dst << sh;
+    cpu->lazy_res = res << sh;
+}
+
+/** Set the whole CCR, for shifts, MOVE to CCR, RTR and friends */
+M68K_INLINE void m68k_set_ccr(m68k_cpu_t *cpu, uint32_t ccr)
+{
+    cpu->ccr = (uint8_t)(ccr & 0x1F);
+    cpu->lazy_op = M68K_LAZY_NONE;
+}
+
+/**
+ * @brief Materialize the CCR from the recorded operation
+ *
+ * The result is written back, so repeated reads are cheap.
+ */
+M68K_INLINE uint32_t m68k_get_ccr(m68k_cpu_t *cpu)
+{
+    uint32_t s = cpu->lazy_src, d = cpu->lazy_dst, r = cpu->lazy_res;
+    uint32_t f;
+
+    switch (cpu->lazy_op) {
+    case M68K_LAZY_NONE:
+        return cpu->ccr;
+    case M68K_LAZY_LOGIC:
+        f = cpu->ccr & M68K_CCR_X;
+        break;
+    case M68K_LAZY_ADD:
+        f = (((s ^ r) & (d ^ r)) >> 31) * M68K_CCR_V;
+        f |= m68k_lazy_carry_add(cpu) * (M68K_CCR_C | M68K_CCR_X);
+        break;
+    case M68K_LAZY_SUB:
+        f = (((s ^ d) & (r ^ d)) >> 31) * M68K_CCR_V;
+        f |= m68k_lazy_carry_sub(cpu) * (M68K_CCR_C | M68K_CCR_X);
+        break;
+    default:    // M68K_LAZY_CMP
+        f = cpu->ccr & M68K_CCR_X;
+        f |= (((s ^ d) & (r ^ d)) >> 31) * M68K_CCR_V;
+        f |= m68k_lazy_carry_sub(cpu) * M68K_CCR_C;
+        break;
+    }
+    f |= (r >> 31) * M68K_CCR_N;
+    f |= (r == 0) * M68K_CCR_Z;
+    cpu->ccr = (uint8_t)f;
+    cpu->lazy_op = M68K_LAZY_NONE;
+    return f;
+}
+
+/**
+ * @brief Evaluate a condition code (Bcc, DBcc, Scc)
+ *
+ * @p cc is the 4-bit condition field; with a constant argument each case
+ * folds to one or two compares in the specialized handler. After CMP/SUB
+ * the conditions are plain signed or unsigned compares of the operands,
+ * after logic ops V and C are known to be clear; anything else goes
+ * through the materialized CCR.
+ */
+M68K_INLINE bool m68k_test_cc(m68k_cpu_t *cpu, int cc)
+{
+    uint32_t d = cpu->lazy_dst, s = cpu->lazy_src, r = cpu->lazy_res;
+
+    if (cc <= 0x1) {
+        return cc == 0x0;
+    }
+    switch (cpu->lazy_op) {
+    case M68K_LAZY_LOGIC:
+        switch (cc) {
+        case 0x2: return r != 0;                    // HI
+        case 0x3: return r == 0;                    // LS
+        case 0x4: return true;                      // CC
+        case 0x5: return false;                     // CS
+        case 0x6: return r != 0;                    // NE
+        case 0x7: return r == 0;                    // EQ
+        case 0x8: return true;                      // VC
+        case 0x9: return false;                     // VS
+        case 0xA: case 0xC: return (int32_t)r >= 0; // PL, GE
+        case 0xB: case 0xD: return (int32_t)r < 0;  // MI, LT
+        case 0xE: return (int32_t)r > 0;            // GT
+        default:  return (int32_t)r <= 0;           // LE
+        }
+    case M68K_LAZY_SUB:
+    case M68K_LAZY_CMP:
+        switch (cc) {
+        case 0x2: return d > s;                     // HI
+        case 0x3: return d <= s;                    // LS
+        case 0x4: return d >= s;                    // CC
+        case 0x5: return d < s;                     // CS
+        case 0x6: return d != s;                    // NE
+        case 0x7: return d == s;                    // EQ
+        case 0xA: return (int32_t)r >= 0;           // PL
+        case 0xB: return (int32_t)r < 0;            // MI
+        case 0xC: return (int32_t)d >= (int32_t)s;  // GE
+        case 0xD: return (int32_t)d < (int32_t)s;   // LT
+        case 0xE: return (int32_t)d > (int32_t)s;   // GT
+        case 0xF: return (int32_t)d <= (int32_t)s;  // LE
+        default:  break;                            // VC, VS
+        }
+        break;
+    default:
+        break;
+    }
+    return m68k_cc_eval(cc, m68k_get_ccr(cpu));
+}
+
+#endif // M68K_EAGER_FLAGS
+
+M68K_INLINE uint16_t m68k_get_sr(m68k_cpu_t *cpu)
+{
+    return (uint16_t)(cpu->sr | m68k_get_ccr(cpu));
+}
+
+/**
+ * ADDX, SUBX, NEGX, ABCD, SBCD, NBCD: Z is only ever cleared, so multi
+ * precision chains test the whole value. @p nvcx holds the N V C X result.
+ */
+M68K_INLINE void m68k_flags_extend(m68k_cpu_t *cpu, uint32_t res, int sz, uint32_t nvcx)
+{
+    uint32_t z = m68k_get_ccr(cpu) & M68K_CCR_Z;
+    if (res & m68k_sz_mask(sz)) {
+        z = 0;
+    }
+    m68k_set_ccr(cpu, nvcx | z);
+}
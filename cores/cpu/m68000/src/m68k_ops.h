@@ -0,0 +1,1018 @@
+/**
+ * @file m68k_ops.h
+ * @brief MC68000 instruction bodies
+ *
+ * Each m68k_op_* function implements one instruction family. They are only
+ * ever called from the generated handlers in m68k_optable.c with constant
+ * size/mode/kind arguments, which is what turns this single generic body
+ * into one specialized, branch-free handler per addressing combination.
+ *
+ * Cycle counts are from the MC68000 User Manual, section 8. Multiply and
+ * divide use the data-dependent formulas; divides charge the worst case.
+ */
+
+#pragma once
+
+#include "m68k.h"
+#include "m68k_ea.h"
+#include "m68k_flags.h"
+
+#define RX                  ((op >> 9) & 7)
+#define RY                  (op & 7)
+#define USE_CYCLES(n)       (cpu->cycles -= (n))
+
+/** Exception processing times (UM Table 8-14) */
+#define M68K_CYC_TRAP       34
+#define M68K_CYC_ILLEGAL    34
+#define M68K_CYC_PRIVILEGE  34
+#define M68K_CYC_ZERO_DIV   38
+#define M68K_CYC_CHK        40
+
+enum { ALU_ADD, ALU_SUB, ALU_CMP, ALU_AND, ALU_OR, ALU_EOR };
+enum { BIT_TST, BIT_CHG, BIT_CLR, BIT_SET };
+enum { SHIFT_AS, SHIFT_LS, SHIFT_ROX, SHIFT_RO };
+
+M68K_INLINE bool m68k_supervisor(const m68k_cpu_t *cpu)
+{
+    return (cpu->sr & M68K_SR_S) != 0;
+}
+
+M68K_INLINE void m68k_privilege_violation(m68k_cpu_t *cpu)
+{
+    m68k_exception(cpu, M68K_VEC_PRIVILEGE, cpu->ppc);
+    USE_CYCLES(M68K_CYC_PRIVILEGE);
+}
+
+M68K_INLINE uint32_t m68k_sext(uint32_t v, int sz)
+{
+    return sz == 1 ? (uint32_t)(int8_t)v : sz == 2 ? (uint32_t)(int16_t)v : v;
+}
+
+// ---------------------------------------------------------------------------
+// Data movement
+// ---------------------------------------------------------------------------
+
+/** MOVE <ea>,<ea> */
+M68K_INLINE void m68k_op_move(m68k_cpu_t *cpu, uint16_t op, int sz, int sm, int dm)
+{
+    uint32_t addr;
+    uint32_t v = m68k_ea_read(cpu, sm, RY, sz, &addr);
+    m68k_ea_store(cpu, dm, RX, sz, v);
+    m68k_flags_logic(cpu, v, sz);
+    USE_CYCLES(4 + m68k_ea_time(sm, sz) + m68k_ea_dst_time(dm, sz));
+}
+
+/** MOVEA <ea>,An: word sources are sign-extended, flags untouched */
+M68K_INLINE void m68k_op_movea(m68k_cpu_t *cpu, uint16_t op, int sz, int sm)
+{
+    uint32_t addr;
+    uint32_t v = m68k_ea_read(cpu, sm, RY, sz, &addr);
+    M68K_AREG(cpu, RX) = m68k_sext(v, sz);
+    USE_CYCLES(4 + m68k_ea_time(sm, sz));
+}
+
+/** MOVEQ #d8,Dn */
+M68K_INLINE void m68k_op_moveq(m68k_cpu_t *cpu, uint16_t op)
+{
+    uint32_t v = (uint32_t)(int8_t)op;
+    M68K_DREG(cpu, RX) = v;
+    m68k_flags_logic(cpu, v, 4);
+    USE_CYCLES(4);
+}
+
+/** LEA <ea>,An */
+M68K_INLINE void m68k_op_lea(m68k_cpu_t *cpu, uint16_t op, int sm)
+{
+    static const uint8_t t[] = { [EA_AI] = 4, [EA_DI] = 8, [EA_IX] = 12, [EA_AW] = 8,
+                                 [EA_AL] = 12, [EA_PCDI] = 8, [EA_PCIX] = 12 };
+    M68K_AREG(cpu, RX) = m68k_ea_addr(cpu, sm, RY, 4);
+    USE_CYCLES(t[sm]);
+}
+
+/** PEA <ea> */
+M68K_INLINE void m68k_op_pea(m68k_cpu_t *cpu, uint16_t op, int sm)
+{
+    static const uint8_t t[] = { [EA_AI] = 12, [EA_DI] = 16, [EA_IX] = 20, [EA_AW] = 16,
+                                 [EA_AL] = 20, [EA_PCDI] = 16, [EA_PCIX] = 20 };
+    uint32_t a = m68k_ea_addr(cpu, sm, RY, 4);
+    m68k_push32(cpu, a);
+    USE_CYCLES(t[sm]);
+}
+
+/** EXG Dx,Dy / Ax,Ay / Dx,Ay; @p kind is the opmode field (8, 9 or 17) */
+M68K_INLINE void m68k_op_exg(m68k_cpu_t *cpu, uint16_t op, int kind)
+{
+    int x = RX, y = RY + 8;
+    uint32_t t;
+
+    if (kind == 9) {
+        x += 8;
+    } else if (kind == 8) {
+        y -= 8;
+    }
+    t = cpu->dar[x];
+    cpu->dar[x] = cpu->dar[y];
+    cpu->dar[y] = t;
+    USE_CYCLES(6);
+}
+
+/** SWAP Dn */
+M68K_INLINE void m68k_op_swap(m68k_cpu_t *cpu, uint16_t op)
+{
+    uint32_t v = M68K_DREG(cpu, RY);
+    v = (v >> 16) | (v << 16);
+    M68K_DREG(cpu, RY) = v;
+    m68k_flags_logic(cpu, v, 4);
+    USE_CYCLES(4);
+}
+
+/** EXT.W Dn (sz 2) / EXT.L Dn (sz 4) */
+M68K_INLINE void m68k_op_ext(m68k_cpu_t *cpu, uint16_t op, int sz)
+{
+    uint32_t v = M68K_DREG(cpu, RY);
+    v = (sz == 2) ? (uint32_t)(int8_t)v : (uint32_t)(int16_t)v;
+    m68k_set_dreg(cpu, RY, v, sz);
+    m68k_flags_logic(cpu, v, sz);
+    USE_CYCLES(4);
+}
+
+/** MOVEM <list>,<ea> */
+M68K_INLINE void m68k_op_movem_r2m(m68k_cpu_t *cpu, uint16_t op, int sz, int dm)
+{
+    static const uint8_t t[] = { [EA_AI] = 8, [EA_PD] = 8, [EA_DI] = 12, [EA_IX] = 14,
+                                 [EA_AW] = 12, [EA_AL] = 16 };
+    uint32_t mask = m68k_fetch16(cpu);
+    int n = 0;
+
+    if (dm == EA_PD) {
+        // Mask is reversed for predecrement: bit 0 is A7. The register being
+        // decremented is stored with its initial value.
+        uint32_t a = M68K_AREG(cpu, RY);
+        for (int i = 0; i < 16; i++) {
+            if (mask & (1u << i)) {
+                a -= (uint32_t)sz;
+                m68k_write_sz(cpu, a, cpu->dar[15 - i], sz);
+                n++;
+            }
+        }
+        M68K_AREG(cpu, RY) = a;
+    } else {
+        uint32_t a = m68k_ea_addr(cpu, dm, RY, sz);
+        for (int i = 0; i < 16; i++) {
+            if (mask & (1u << i)) {
+                m68k_write_sz(cpu, a, cpu->dar[i], sz);
+                a += (uint32_t)sz;
+                n++;
+            }
+        }
+    }
+    USE_CYCLES(t[dm] + n * (sz == 4 ? 8 : 4));
+}
+
+/** MOVEM <ea>,<list>: word loads are sign-extended to the whole register */
+M68K_INLINE void m68k_op_movem_m2r(m68k_cpu_t *cpu, uint16_t op, int sz, int sm)
+{
+    static const uint8_t t[] = { [EA_AI] = 12, [EA_PI] = 12, [EA_DI] = 16, [EA_IX] = 18,
+                                 [EA_AW] = 16, [EA_AL] = 20, [EA_PCDI] = 16, [EA_PCIX] = 18 };
+    uint32_t mask = m68k_fetch16(cpu);
+    uint32_t a = (sm == EA_PI) ? M68K_AREG(cpu, RY) : m68k_ea_addr(cpu, sm, RY, sz);
+    int n = 0;
+
+    for (int i = 0; i < 16; i++) {
+        if (mask & (1u << i)) {
+            cpu->dar[i] = m68k_sext(m68k_read_sz(cpu, a, sz), sz);
+            a += (uint32_t)sz;
+            n++;
+        }
+    }
+    if (sm == EA_PI) {
+        M68K_AREG(cpu, RY) = a;
+    }
+    USE_CYCLES(t[sm] + n * (sz == 4 ? 8 : 4));
+}
+
+/** MOVEP Dx,d16(Ay) and MOVEP d16(Ay),Dx; @p opmode is bits 8-6 (4-7) */
+M68K_INLINE void m68k_op_movep(m68k_cpu_t *cpu, uint16_t op, int opmode)
+{
+    uint32_t a = M68K_AREG(cpu, RY) + (uint32_t)(int16_t)m68k_fetch16(cpu);
+    uint32_t d = M68K_DREG(cpu, RX);
+
+    switch (opmode) {
+    case 4:
+        m68k_set_dreg(cpu, RX, (m68k_read8(cpu, a) << 8) | m68k_read8(cpu, a + 2), 2);
+        USE_CYCLES(16);
+        break;
+    case 5:
+        M68K_DREG(cpu, RX) = (m68k_read8(cpu, a) << 24) | (m68k_read8(cpu, a + 2) << 16) |
+                             (m68k_read8(cpu, a + 4) << 8) | m68k_read8(cpu, a + 6);
+        USE_CYCLES(24);
+        break;
+    case 6:
+        m68k_write8(cpu, a, d >> 8);
+        m68k_write8(cpu, a + 2, d);
+        USE_CYCLES(16);
+        break;
+    default:
+        m68k_write8(cpu, a, d >> 24);
+        m68k_write8(cpu, a + 2, d >> 16);
+        m68k_write8(cpu, a + 4, d >> 8);
+        m68k_write8(cpu, a + 6, d);
+        USE_CYCLES(24);
+        break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Integer arithmetic and logic
+// ---------------------------------------------------------------------------
+
+M68K_INLINE uint32_t m68k_alu(m68k_cpu_t *cpu, int kind, int sz, uint32_t src, uint32_t dst)
+{
+    uint32_t mask = m68k_sz_mask(sz);
+    uint32_t res;
+
+    switch (kind) {
+    case ALU_ADD:
+        res = (dst + src) & mask;
+        m68k_flags_add(cpu, src, dst, res, sz);
+        return res;
+    case ALU_SUB:
+        res = (dst - src) & mask;
+        m68k_flags_sub(cpu, src, dst, res, sz);
+        return res;
+    case ALU_CMP:
+        res = (dst - src) & mask;
+        m68k_flags_cmp(cpu, src, dst, res, sz);
+        return res;
+    case ALU_AND:
+        res = dst & src;
+        break;
+    case ALU_OR:
+        res = dst | src;
+        break;
+    default:
+        res = dst ^ src;
+        break;
+    }
+    m68k_flags_logic(cpu, res, sz);
+    return res;
+}
+
+/** ADD/SUB/CMP/AND/OR <ea>,Dn */
+M68K_INLINE void m68k_op_alu_to_dn(m68k_cpu_t *cpu, uint16_t op, int kind, int sz, int sm)
+{
+    uint32_t addr;
+    uint32_t src = m68k_ea_read(cpu, sm, RY, sz, &addr);
+    uint32_t dst = M68K_DREG(cpu, RX) & m68k_sz_mask(sz);
+    uint32_t res = m68k_alu(cpu, kind, sz, src, dst);
+    int cyc = 4;
+
+    if (kind != ALU_CMP) {
+        m68k_set_dreg(cpu, RX, res, sz);
+    }
+    if (sz == 4) {
+        cyc = (kind != ALU_CMP && (sm == EA_DN || sm == EA_AN || sm == EA_IMM)) ? 8 : 6;
+    }
+    USE_CYCLES(cyc + m68k_ea_time(sm, sz));
+}
+
+/** ADD/SUB/AND/OR Dn,<mem> and EOR Dn,<ea> */
+M68K_INLINE void m68k_op_alu_to_ea(m68k_cpu_t *cpu, uint16_t op, int kind, int sz, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t src = M68K_DREG(cpu, RX) & m68k_sz_mask(sz);
+    uint32_t dst = m68k_ea_read(cpu, dm, RY, sz, &addr);
+    uint32_t res = m68k_alu(cpu, kind, sz, src, dst);
+
+    m68k_ea_write(cpu, dm, RY, sz, addr, res);
+    if (dm == EA_DN) {
+        USE_CYCLES(sz == 4 ? 8 : 4);
+    } else {
+        USE_CYCLES((sz == 4 ? 12 : 8) + m68k_ea_time(dm, sz));
+    }
+}
+
+/** ORI/ANDI/SUBI/ADDI/EORI/CMPI #imm,<ea> */
+M68K_INLINE void m68k_op_alu_imm(m68k_cpu_t *cpu, uint16_t op, int kind, int sz, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t src = m68k_fetch_imm(cpu, sz);
+    uint32_t dst = m68k_ea_read(cpu, dm, RY, sz, &addr);
+    uint32_t res = m68k_alu(cpu, kind, sz, src, dst);
+
+    if (kind != ALU_CMP) {
+        m68k_ea_write(cpu, dm, RY, sz, addr, res);
+    }
+    if (dm == EA_DN) {
+        USE_CYCLES(sz != 4 ? 8 : (kind == ALU_AND || kind == ALU_CMP) ? 14 : 16);
+    } else if (kind == ALU_CMP) {
+        USE_CYCLES((sz == 4 ? 12 : 8) + m68k_ea_time(dm, sz));
+    } else {
+        USE_CYCLES((sz == 4 ? 20 : 12) + m68k_ea_time(dm, sz));
+    }
+}
+
+/** ADDQ/SUBQ #<1-8>,<ea>; address register targets use all 32 bits, no flags */
+M68K_INLINE void m68k_op_addq(m68k_cpu_t *cpu, uint16_t op, int kind, int sz, int dm)
+{
+    uint32_t data = RX ? RX : 8;
+    uint32_t addr = 0;
+
+    if (dm == EA_AN) {
+        M68K_AREG(cpu, RY) += (kind == ALU_ADD) ? data : (uint32_t)-data;
+        USE_CYCLES(8);
+        return;
+    }
+    uint32_t dst = m68k_ea_read(cpu, dm, RY, sz, &addr);
+    uint32_t res = m68k_alu(cpu, kind, sz, data, dst);
+    m68k_ea_write(cpu, dm, RY, sz, addr, res);
+    if (dm == EA_DN) {
+        USE_CYCLES(sz == 4 ? 8 : 4);
+    } else {
+        USE_CYCLES((sz == 4 ? 12 : 8) + m68k_ea_time(dm, sz));
+    }
+}
+
+/** ADDA/SUBA/CMPA <ea>,An: the source is sign-extended to 32 bits */
+M68K_INLINE void m68k_op_adda(m68k_cpu_t *cpu, uint16_t op, int kind, int sz, int sm)
+{
+    uint32_t addr;
+    uint32_t src = m68k_sext(m68k_ea_read(cpu, sm, RY, sz, &addr), sz);
+    uint32_t dst = M68K_AREG(cpu, RX);
+
+    if (kind == ALU_CMP) {
+        m68k_flags_cmp(cpu, src, dst, dst - src, 4);
+        USE_CYCLES(6 + m68k_ea_time(sm, sz));
+        return;
+    }
+    M68K_AREG(cpu, RX) = (kind == ALU_ADD) ? dst + src : dst - src;
+    if (sz == 2) {
+        USE_CYCLES(8 + m68k_ea_time(sm, sz));
+    } else {
+        USE_CYCLES(((sm == EA_DN || sm == EA_AN || sm == EA_IMM) ? 8 : 6) + m68k_ea_time(sm, sz));
+    }
+}
+
+/** N V C X bits of an extended add (ADDX/ABCD style chains) */
+M68K_INLINE uint32_t m68k_addx_bits(uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    uint32_t msb = m68k_sz_msb(sz);
+    uint32_t f = (res & msb) ? M68K_CCR_N : 0;
+    if (((src ^ res) & (dst ^ res)) & msb) {
+        f |= M68K_CCR_V;
+    }
+    if (((src & dst) | (~res & (src | dst))) & msb) {
+        f |= M68K_CCR_C | M68K_CCR_X;
+    }
+    return f;
+}
+
+/** N V C X bits of an extended subtract (dst - src - X) */
+M68K_INLINE uint32_t m68k_subx_bits(uint32_t src, uint32_t dst, uint32_t res, int sz)
+{
+    uint32_t msb = m68k_sz_msb(sz);
+    uint32_t f = (res & msb) ? M68K_CCR_N : 0;
+    if (((src ^ dst) & (res ^ dst)) & msb) {
+        f |= M68K_CCR_V;
+    }
+    if (((src & res) | (~dst & (src | res))) & msb) {
+        f |= M68K_CCR_C | M68K_CCR_X;
+    }
+    return f;
+}
+
+/** ADDX/SUBX Dy,Dx (@p mem false) or -(Ay),-(Ax) (@p mem true) */
+M68K_INLINE void m68k_op_addx(m68k_cpu_t *cpu, uint16_t op, int kind, int sz, bool mem)
+{
+    uint32_t mask = m68k_sz_mask(sz);
+    uint32_t x = m68k_get_x(cpu);
+    uint32_t src, dst, res, addr = 0;
+
+    if (mem) {
+        src = m68k_read_sz(cpu, m68k_ea_addr(cpu, EA_PD, RY, sz), sz);
+        addr = m68k_ea_addr(cpu, EA_PD, RX, sz);
+        dst = m68k_read_sz(cpu, addr, sz);
+    } else {
+        src = M68K_DREG(cpu, RY) & mask;
+        dst = M68K_DREG(cpu, RX) & mask;
+    }
+    if (kind == ALU_ADD) {
+        res = (dst + src + x) & mask;
+        m68k_flags_extend(cpu, res, sz, m68k_addx_bits(src, dst, res, sz));
+    } else {
+        res = (dst - src - x) & mask;
+        m68k_flags_extend(cpu, res, sz, m68k_subx_bits(src, dst, res, sz));
+    }
+    if (mem) {
+        m68k_write_sz(cpu, addr, res, sz);
+        USE_CYCLES(sz == 4 ? 30 : 18);
+    } else {
+        m68k_set_dreg(cpu, RX, res, sz);
+        USE_CYCLES(sz == 4 ? 8 : 4);
+    }
+}
+
+/** CMPM (Ay)+,(Ax)+ */
+M68K_INLINE void m68k_op_cmpm(m68k_cpu_t *cpu, uint16_t op, int sz)
+{
+    uint32_t src = m68k_read_sz(cpu, m68k_ea_addr(cpu, EA_PI, RY, sz), sz);
+    uint32_t dst = m68k_read_sz(cpu, m68k_ea_addr(cpu, EA_PI, RX, sz), sz);
+    m68k_alu(cpu, ALU_CMP, sz, src, dst);
+    USE_CYCLES(sz == 4 ? 20 : 12);
+}
+
+/** CLR/NEG/NEGX/NOT <ea> share the same timing */
+M68K_INLINE void m68k_unary_cycles(m68k_cpu_t *cpu, int sz, int dm)
+{
+    if (dm == EA_DN) {
+        USE_CYCLES(sz == 4 ? 6 : 4);
+    } else {
+        USE_CYCLES((sz == 4 ? 12 : 8) + m68k_ea_time(dm, sz));
+    }
+}
+
+/** CLR <ea> */
+M68K_INLINE void m68k_op_clr(m68k_cpu_t *cpu, uint16_t op, int sz, int dm)
+{
+    m68k_ea_store(cpu, dm, RY, sz, 0);
+    m68k_flags_logic(cpu, 0, sz);
+    m68k_unary_cycles(cpu, sz, dm);
+}
+
+/** NEG <ea> */
+M68K_INLINE void m68k_op_neg(m68k_cpu_t *cpu, uint16_t op, int sz, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t dst = m68k_ea_read(cpu, dm, RY, sz, &addr);
+    uint32_t res = m68k_alu(cpu, ALU_SUB, sz, dst, 0);
+    m68k_ea_write(cpu, dm, RY, sz, addr, res);
+    m68k_unary_cycles(cpu, sz, dm);
+}
+
+/** NEGX <ea> */
+M68K_INLINE void m68k_op_negx(m68k_cpu_t *cpu, uint16_t op, int sz, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t dst = m68k_ea_read(cpu, dm, RY, sz, &addr);
+    uint32_t res = (0 - dst - m68k_get_x(cpu)) & m68k_sz_mask(sz);
+    m68k_flags_extend(cpu, res, sz, m68k_subx_bits(dst, 0, res, sz));
+    m68k_ea_write(cpu, dm, RY, sz, addr, res);
+    m68k_unary_cycles(cpu, sz, dm);
+}
+
+/** NOT <ea> */
+M68K_INLINE void m68k_op_not(m68k_cpu_t *cpu, uint16_t op, int sz, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t res = ~m68k_ea_read(cpu, dm, RY, sz, &addr) & m68k_sz_mask(sz);
+    m68k_flags_logic(cpu, res, sz);
+    m68k_ea_write(cpu, dm, RY, sz, addr, res);
+    m68k_unary_cycles(cpu, sz, dm);
+}
+
+/** TST <ea> */
+M68K_INLINE void m68k_op_tst(m68k_cpu_t *cpu, uint16_t op, int sz, int dm)
+{
+    uint32_t addr;
+    m68k_flags_logic(cpu, m68k_ea_read(cpu, dm, RY, sz, &addr), sz);
+    USE_CYCLES(4 + m68k_ea_time(dm, sz));
+}
+
+/** TAS <ea>: test, then set bit 7 (read-modify-write cycle) */
+M68K_INLINE void m68k_op_tas(m68k_cpu_t *cpu, uint16_t op, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t v = m68k_ea_read(cpu, dm, RY, 1, &addr);
+    m68k_flags_logic(cpu, v, 1);
+    m68k_ea_write(cpu, dm, RY, 1, addr, v | 0x80);
+    USE_CYCLES(dm == EA_DN ? 4 : 10 + m68k_ea_time(dm, 1));
+}
+
+/** MULU/MULS <ea>,Dn: 16x16 -> 32 */
+M68K_INLINE void m68k_op_mul(m68k_cpu_t *cpu, uint16_t op, bool is_signed, int sm)
+{
+    uint32_t addr;
+    uint32_t src = m68k_ea_read(cpu, sm, RY, 2, &addr);
+    uint32_t res;
+    int n;
+
+    if (is_signed) {
+        res = (uint32_t)((int32_t)(int16_t)src * (int32_t)(int16_t)M68K_DREG(cpu, RX));
+        n = __builtin_popcount((src ^ (src << 1)) & 0xFFFF);   // 01/10 transitions
+    } else {
+        res = src * (M68K_DREG(cpu, RX) & 0xFFFF);
+        n = __builtin_popcount(src);
+    }
+    M68K_DREG(cpu, RX) = res;
+    m68k_flags_logic(cpu, res, 4);
+    USE_CYCLES(38 + 2 * n + m68k_ea_time(sm, 2));
+}
+
+/** DIVU/DIVS <ea>,Dn: 32/16 -> 16r:16q */
+M68K_INLINE void m68k_op_div(m68k_cpu_t *cpu, uint16_t op, bool is_signed, int sm)
+{
+    uint32_t addr;
+    uint32_t src = m68k_ea_read(cpu, sm, RY, 2, &addr);
+    uint32_t dst = M68K_DREG(cpu, RX);
+    uint32_t q, r;
+
+    if (src == 0) {
+        m68k_exception(cpu, M68K_VEC_ZERO_DIVIDE, cpu->pc);
+        USE_CYCLES(M68K_CYC_ZERO_DIV + m68k_ea_time(sm, 2));
+        return;
+    }
+    bool overflow;
+
+    if (is_signed) {
+        int32_t sd = (int32_t)dst, ss = (int16_t)src;
+        if (sd == INT32_MIN && ss == -1) {
+            overflow = true;
+            q = r = 0;
+        } else {
+            int32_t sq = sd / ss;
+            overflow = sq < -32768 || sq > 32767;
+            q = (uint32_t)sq & 0xFFFF;
+            r = (uint32_t)(sd % ss) & 0xFFFF;   // remainder takes the dividend's sign
+        }
+    } else {
+        q = dst / src;
+        r = dst % src;
+        overflow = q > 0xFFFF;
+    }
+    if (overflow) {
+        // Overflow: V set, C cleared, operand unchanged
+        m68k_set_ccr(cpu, (m68k_get_ccr(cpu) & (M68K_CCR_X | M68K_CCR_N | M68K_CCR_Z)) | M68K_CCR_V);
+    } else {
+        M68K_DREG(cpu, RX) = (r << 16) | q;
+        m68k_flags_logic(cpu, q, 2);
+    }
+    USE_CYCLES((is_signed ? 158 : 140) + m68k_ea_time(sm, 2));
+}
+
+/** ABCD/SBCD Dy,Dx or -(Ay),-(Ax) */
+M68K_INLINE void m68k_op_bcd(m68k_cpu_t *cpu, uint16_t op, int kind, bool mem)
+{
+    uint32_t x = m68k_get_x(cpu);
+    uint32_t src, dst, res, addr = 0;
+    bool carry;
+
+    if (mem) {
+        src = m68k_read8(cpu, m68k_ea_addr(cpu, EA_PD, RY, 1));
+        addr = m68k_ea_addr(cpu, EA_PD, RX, 1);
+        dst = m68k_read8(cpu, addr);
+    } else {
+        src = M68K_DREG(cpu, RY) & 0xFF;
+        dst = M68K_DREG(cpu, RX) & 0xFF;
+    }
+    if (kind == ALU_ADD) {
+        uint32_t lo = (src & 0x0F) + (dst & 0x0F) + x;
+        res = (src & 0xF0) + (dst & 0xF0) + lo;
+        if (lo > 9) {
+            res += 6;
+        }
+        carry = res > 0x99;
+        if (carry) {
+            res -= 0xA0;
+        }
+    } else {
+        int32_t lo = (int32_t)(dst & 0x0F) - (int32_t)(src & 0x0F) - (int32_t)x;
+        int32_t sres = (int32_t)(dst & 0xF0) - (int32_t)(src & 0xF0) + lo;
+        if (lo < 0) {
+            sres -= 6;
+        }
+        carry = sres < 0;
+        if (carry) {
+            sres += 0xA0;
+        }
+        res = (uint32_t)sres;
+    }
+    res &= 0xFF;
+    m68k_flags_extend(cpu, res, 1, (carry ? (M68K_CCR_C | M68K_CCR_X) : 0) | ((res & 0x80) ? M68K_CCR_N : 0));
+    if (mem) {
+        m68k_write8(cpu, addr, res);
+        USE_CYCLES(18);
+    } else {
+        m68k_set_dreg(cpu, RX, res, 1);
+        USE_CYCLES(6);
+    }
+}
+
+/** NBCD <ea>: 0 - <ea> - X in decimal */
+M68K_INLINE void m68k_op_nbcd(m68k_cpu_t *cpu, uint16_t op, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t v = m68k_ea_read(cpu, dm, RY, 1, &addr);
+    int32_t lo = -(int32_t)(v & 0x0F) - (int32_t)m68k_get_x(cpu);
+    int32_t sres = -(int32_t)(v & 0xF0) + lo;
+    bool carry;
+
+    if (lo < 0) {
+        sres -= 6;
+    }
+    carry = sres < 0;
+    if (carry) {
+        sres += 0xA0;
+    }
+    uint32_t res = (uint32_t)sres & 0xFF;
+    m68k_flags_extend(cpu, res, 1, (carry ? (M68K_CCR_C | M68K_CCR_X) : 0) | ((res & 0x80) ? M68K_CCR_N : 0));
+    m68k_ea_write(cpu, dm, RY, 1, addr, res);
+    USE_CYCLES(dm == EA_DN ? 6 : 8 + m68k_ea_time(dm, 1));
+}
+
+/** CHK <ea>,Dn */
+M68K_INLINE void m68k_op_chk(m68k_cpu_t *cpu, uint16_t op, int sm)
+{
+    uint32_t addr;
+    int32_t bound = (int16_t)m68k_ea_read(cpu, sm, RY, 2, &addr);
+    int32_t d = (int16_t)M68K_DREG(cpu, RX);
+    uint32_t ccr = m68k_get_ccr(cpu) & M68K_CCR_X;
+
+    if (d < 0 || d > bound) {
+        m68k_set_ccr(cpu, ccr | (d < 0 ? M68K_CCR_N : 0));
+        m68k_exception(cpu, M68K_VEC_CHK, cpu->pc);
+        USE_CYCLES(M68K_CYC_CHK + m68k_ea_time(sm, 2));
+    } else {
+        m68k_set_ccr(cpu, (m68k_get_ccr(cpu) & ~M68K_CCR_N));
+        USE_CYCLES(10 + m68k_ea_time(sm, 2));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Shifts and rotates
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Shift/rotate @p v by @p cnt and update the CCR
+ *
+ * @p type and @p left are constants in every caller; counts of 0 leave the
+ * operand alone but still set N/Z (and C = X for ROXd).
+ */
+M68K_INLINE uint32_t m68k_shift(m68k_cpu_t *cpu, int type, bool left, int sz, uint32_t v, uint32_t cnt)
+{
+    const uint32_t mask = m68k_sz_mask(sz), msb = m68k_sz_msb(sz);
+    const uint32_t bits = (uint32_t)sz * 8;
+    uint32_t x = m68k_get_x(cpu);
+    uint32_t res = v, c = 0, ovf = 0;
+
+    if (cnt == 0) {
+        c = (type == SHIFT_ROX) ? x : 0;
+        m68k_set_ccr(cpu, (x << 4) | m68k_nz(v, sz) | c);
+        return v;
+    }
+
+    switch (type) {
+    case SHIFT_AS:
+        if (left) {
+            if (cnt < bits) {
+                uint32_t top = (cnt + 1 >= bits) ? mask : (mask & ~(mask >> (cnt + 1)));
+                res = (v << cnt) & mask;
+                c = (v >> (bits - cnt)) & 1;
+                ovf = (v & top) != 0 && (v & top) != top;
+            } else {
+                res = 0;
+                c = (cnt == bits) ? (v & 1) : 0;
+                ovf = v != 0;
+            }
+        } else {
+            bool neg = (v & msb) != 0;
+            if (cnt < bits) {
+                res = (v >> cnt) | (neg ? (mask & ~(mask >> cnt)) : 0);
+                c = (v >> (cnt - 1)) & 1;
+            } else {
+                res = neg ? mask : 0;
+                c = neg ? 1 : 0;
+            }
+        }
+        x = c;
+        break;
+    case SHIFT_LS:
+        if (left) {
+            res = (cnt < bits) ? (v << cnt) & mask : 0;
+            c = (cnt <= bits) ? (v >> (bits - cnt)) & 1 : 0;
+        } else {
+            res = (cnt < bits) ? v >> cnt : 0;
+            c = (cnt <= bits) ? (v >> (cnt - 1)) & 1 : 0;
+        }
+        x = c;
+        break;
+    case SHIFT_ROX:
+        for (uint32_t n = cnt % (bits + 1); n; n--) {
+            if (left) {
+                uint32_t out = (res & msb) ? 1 : 0;
+                res = ((res << 1) | x) & mask;
+                x = out;
+            } else {
+                uint32_t out = res & 1;
+                res = (res >> 1) | (x ? msb : 0);
+                x = out;
+            }
+        }
+        c = x;
+        break;
+    default: {
+        uint32_t n = cnt & (bits - 1);
+        if (n) {
+            res = left ? ((v << n) | (v >> (bits - n))) & mask
+                       : ((v >> n) | (v << (bits - n))) & mask;
+        }
+        c = left ? (res & 1) : ((res & msb) ? 1 : 0);
+        break;
+    }
+    }
+    m68k_set_ccr(cpu, (x << 4) | m68k_nz(res, sz) | (ovf ? M68K_CCR_V : 0) | c);
+    return res;
+}
+
+/** ASd/LSd/ROXd/ROd #n,Dy or Dx,Dy */
+M68K_INLINE void m68k_op_shift_reg(m68k_cpu_t *cpu, uint16_t op, int type, bool left, int sz, bool by_reg)
+{
+    uint32_t cnt = by_reg ? (M68K_DREG(cpu, RX) & 63) : (RX ? RX : 8);
+    uint32_t v = M68K_DREG(cpu, RY) & m68k_sz_mask(sz);
+
+    m68k_set_dreg(cpu, RY, m68k_shift(cpu, type, left, sz, v, cnt), sz);
+    USE_CYCLES((sz == 4 ? 8 : 6) + 2 * (int)cnt);
+}
+
+/** ASd/LSd/ROXd/ROd <ea>: word operand, shift by one */
+M68K_INLINE void m68k_op_shift_mem(m68k_cpu_t *cpu, uint16_t op, int type, bool left, int dm)
+{
+    uint32_t addr = 0;
+    uint32_t v = m68k_ea_read(cpu, dm, RY, 2, &addr);
+    m68k_write16(cpu, addr, m68k_shift(cpu, type, left, 2, v, 1));
+    USE_CYCLES(8 + m68k_ea_time(dm, 2));
+}
+
+// ---------------------------------------------------------------------------
+// Bit manipulation
+// ---------------------------------------------------------------------------
+
+/** BTST/BCHG/BCLR/BSET, bit number from Dn (@p is_static false) or #imm */
+M68K_INLINE void m68k_op_bit(m68k_cpu_t *cpu, uint16_t op, int kind, bool is_static, int dm)
+{
+    uint32_t bit = is_static ? (m68k_fetch16(cpu) & 0xFF) : M68K_DREG(cpu, RX);
+    uint32_t addr = 0, v, m;
+    int sz = (dm == EA_DN) ? 4 : 1;
+
+    bit &= (dm == EA_DN) ? 31 : 7;
+    m = 1u << bit;
+    v = m68k_ea_read(cpu, dm, RY, sz, &addr);
+    m68k_set_ccr(cpu, (m68k_get_ccr(cpu) & ~M68K_CCR_Z) | ((v & m) ? 0 : M68K_CCR_Z));
+
+    if (kind != BIT_TST) {
+        v = (kind == BIT_CHG) ? (v ^ m) : (kind == BIT_CLR) ? (v & ~m) : (v | m);
+        m68k_ea_write(cpu, dm, RY, sz, addr, v);
+    }
+
+    int base;
+    if (dm == EA_DN) {
+        static const uint8_t dyn[] = { 6, 8, 10, 8 }, imm[] = { 10, 12, 14, 12 };
+        base = is_static ? imm[kind] : dyn[kind];
+    } else {
+        base = (kind == BIT_TST ? 4 : 8) + (is_static ? 4 : 0);
+        base += m68k_ea_time(dm, 1);
+    }
+    USE_CYCLES(base);
+}
+
+// ---------------------------------------------------------------------------
+// Program control
+// ---------------------------------------------------------------------------
+
+/** Bcc/BRA with 8-bit (@p wide false) or 16-bit displacement */
+M68K_INLINE void m68k_op_bcc(m68k_cpu_t *cpu, uint16_t op, int cc, bool wide)
+{
+    uint32_t base = cpu->pc;
+
+    if (m68k_test_cc(cpu, cc)) {
+        cpu->pc = base + (wide ? (uint32_t)(int16_t)m68k_read16(cpu, base) : (uint32_t)(int8_t)op);
+        USE_CYCLES(10);
+    } else {
+        if (wide) {
+            cpu->pc += 2;
+        }
+        USE_CYCLES(wide ? 12 : 8);
+    }
+}
+
+/** BSR */
+M68K_INLINE void m68k_op_bsr(m68k_cpu_t *cpu, uint16_t op, bool wide)
+{
+    uint32_t base = cpu->pc;
+    uint32_t disp = wide ? (uint32_t)(int16_t)m68k_read16(cpu, base) : (uint32_t)(int8_t)op;
+
+    m68k_push32(cpu, wide ? base + 2 : base);
+    cpu->pc = base + disp;
+    USE_CYCLES(18);
+}
+
+/** DBcc Dn,<label> */
+M68K_INLINE void m68k_op_dbcc(m68k_cpu_t *cpu, uint16_t op, int cc)
+{
+    uint32_t base = cpu->pc;
+
+    if (m68k_test_cc(cpu, cc)) {
+        cpu->pc += 2;
+        USE_CYCLES(12);
+        return;
+    }
+    uint32_t cnt = (M68K_DREG(cpu, RY) - 1) & 0xFFFF;
+    m68k_set_dreg(cpu, RY, cnt, 2);
+    if (cnt != 0xFFFF) {
+        cpu->pc = base + (uint32_t)(int16_t)m68k_read16(cpu, base);
+        USE_CYCLES(10);
+    } else {
+        cpu->pc += 2;
+        USE_CYCLES(14);
+    }
+}
+
+/** Scc <ea> */
+M68K_INLINE void m68k_op_scc(m68k_cpu_t *cpu, uint16_t op, int cc, int dm)
+{
+    bool t = m68k_test_cc(cpu, cc);
+    m68k_ea_store(cpu, dm, RY, 1, t ? 0xFF : 0x00);
+    if (dm == EA_DN) {
+        USE_CYCLES(t ? 6 : 4);
+    } else {
+        USE_CYCLES(8 + m68k_ea_time(dm, 1));
+    }
+}
+
+/** JMP <ea> */
+M68K_INLINE void m68k_op_jmp(m68k_cpu_t *cpu, uint16_t op, int sm)
+{
+    static const uint8_t t[] = { [EA_AI] = 8, [EA_DI] = 10, [EA_IX] = 14, [EA_AW] = 10,
+                                 [EA_AL] = 12, [EA_PCDI] = 10, [EA_PCIX] = 14 };
+    cpu->pc = m68k_ea_addr(cpu, sm, RY, 4);
+    USE_CYCLES(t[sm]);
+}
+
+/** JSR <ea> */
+M68K_INLINE void m68k_op_jsr(m68k_cpu_t *cpu, uint16_t op, int sm)
+{
+    static const uint8_t t[] = { [EA_AI] = 16, [EA_DI] = 18, [EA_IX] = 22, [EA_AW] = 18,
+                                 [EA_AL] = 20, [EA_PCDI] = 18, [EA_PCIX] = 22 };
+    uint32_t target = m68k_ea_addr(cpu, sm, RY, 4);
+    m68k_push32(cpu, cpu->pc);
+    cpu->pc = target;
+    USE_CYCLES(t[sm]);
+}
+
+M68K_INLINE void m68k_op_rts(m68k_cpu_t *cpu, uint16_t op)
+{
+    cpu->pc = m68k_pop32(cpu);
+    USE_CYCLES(16);
+}
+
+M68K_INLINE void m68k_op_rtr(m68k_cpu_t *cpu, uint16_t op)
+{
+    m68k_set_ccr(cpu, m68k_pop16(cpu));
+    cpu->pc = m68k_pop32(cpu);
+    USE_CYCLES(20);
+}
+
+M68K_INLINE void m68k_op_rte(m68k_cpu_t *cpu, uint16_t op)
+{
+    if (!m68k_supervisor(cpu)) {
+        m68k_privilege_violation(cpu);
+        return;
+    }
+    uint32_t sr = m68k_pop16(cpu);
+    cpu->pc = m68k_pop32(cpu);
+    m68k_set_sr(cpu, (uint16_t)sr);
+    USE_CYCLES(20);
+}
+
+M68K_INLINE void m68k_op_link(m68k_cpu_t *cpu, uint16_t op)
+{
+    m68k_push32(cpu, M68K_AREG(cpu, RY));
+    M68K_AREG(cpu, RY) = cpu->dar[15];
+    cpu->dar[15] += (uint32_t)(int16_t)m68k_fetch16(cpu);
+    USE_CYCLES(16);
+}
+
+M68K_INLINE void m68k_op_unlk(m68k_cpu_t *cpu, uint16_t op)
+{
+    cpu->dar[15] = M68K_AREG(cpu, RY);
+    M68K_AREG(cpu, RY) = m68k_pop32(cpu);
+    USE_CYCLES(12);
+}
+
+M68K_INLINE void m68k_op_trap(m68k_cpu_t *cpu, uint16_t op)
+{
+    m68k_exception(cpu, M68K_VEC_TRAP + (op & 15), cpu->pc);
+    USE_CYCLES(M68K_CYC_TRAP);
+}
+
+M68K_INLINE void m68k_op_trapv(m68k_cpu_t *cpu, uint16_t op)
+{
+    if (m68k_get_ccr(cpu) & M68K_CCR_V) {
+        m68k_exception(cpu, M68K_VEC_TRAPV, cpu->pc);
+        USE_CYCLES(M68K_CYC_TRAP);
+    } else {
+        USE_CYCLES(4);
+    }
+}
+
+M68K_INLINE void m68k_op_nop(m68k_cpu_t *cpu, uint16_t op)
+{
+    USE_CYCLES(4);
+}
+
+/** Unimplemented or illegal encodings; Line A and Line F get their own vectors */
+M68K_INLINE void m68k_op_illegal(m68k_cpu_t *cpu, uint16_t op, int vector)
+{
+    m68k_exception(cpu, vector, cpu->ppc);
+    USE_CYCLES(M68K_CYC_ILLEGAL);
+}
+
+// ---------------------------------------------------------------------------
+// System control
+// ---------------------------------------------------------------------------
+
+/** ORI/ANDI/EORI #imm,CCR (@p to_sr false) or #imm,SR */
+M68K_INLINE void m68k_op_logic_sr(m68k_cpu_t *cpu, uint16_t op, int kind, bool to_sr)
+{
+    if (to_sr && !m68k_supervisor(cpu)) {
+        m68k_privilege_violation(cpu);
+        return;
+    }
+    uint32_t imm = m68k_fetch16(cpu);
+    uint32_t v = to_sr ? m68k_get_sr(cpu) : m68k_get_ccr(cpu);
+
+    v = (kind == ALU_AND) ? (v & imm) : (kind == ALU_OR) ? (v | imm) : (v ^ imm);
+    if (to_sr) {
+        m68k_set_sr(cpu, (uint16_t)v);
+    } else {
+        m68k_set_ccr(cpu, v);
+    }
+    USE_CYCLES(20);
+}
+
+/** MOVE SR,<ea> (not privileged on the 68000) */
+M68K_INLINE void m68k_op_move_from_sr(m68k_cpu_t *cpu, uint16_t op, int dm)
+{
+    m68k_ea_store(cpu, dm, RY, 2, m68k_get_sr(cpu));
+    USE_CYCLES(dm == EA_DN ? 6 : 8 + m68k_ea_time(dm, 2));
+}
+
+/** MOVE <ea>,CCR */
+M68K_INLINE void m68k_op_move_to_ccr(m68k_cpu_t *cpu, uint16_t op, int sm)
+{
+    uint32_t addr;
+    m68k_set_ccr(cpu, m68k_ea_read(cpu, sm, RY, 2, &addr));
+    USE_CYCLES(12 + m68k_ea_time(sm, 2));
+}
+
+/** MOVE <ea>,SR */
+M68K_INLINE void m68k_op_move_to_sr(m68k_cpu_t *cpu, uint16_t op, int sm)
+{
+    uint32_t addr;
+
+    if (!m68k_supervisor(cpu)) {
+        m68k_privilege_violation(cpu);
+        return;
+    }
+    m68k_set_sr(cpu, (uint16_t)m68k_ea_read(cpu, sm, RY, 2, &addr));
+    USE_CYCLES(12 + m68k_ea_time(sm, 2));
+}
+
+/** MOVE An,USP / MOVE USP,An */
+M68K_INLINE void m68k_op_move_usp(m68k_cpu_t *cpu, uint16_t op)
+{
+    if (!m68k_supervisor(cpu)) {
+        m68k_privilege_violation(cpu);
+        return;
+    }
+    if (op & 8) {
+        M68K_AREG(cpu, RY) = cpu->osp;
+    } else {
+        cpu->osp = M68K_AREG(cpu, RY);
+    }
+    USE_CYCLES(4);
+}
+
+M68K_INLINE void m68k_op_reset(m68k_cpu_t *cpu, uint16_t op)
+{
+    if (!m68k_supervisor(cpu)) {
+        m68k_privilege_violation(cpu);
+        return;
+    }
+    if (cpu->bus->reset_devices) {
+        cpu->bus->reset_devices();
+    }
+    USE_CYCLES(132);
+}
+
+/** STOP #imm: load SR and idle until an interrupt above the new mask */
+M68K_INLINE void m68k_op_stop(m68k_cpu_t *cpu, uint16_t op)
+{
+    if (!m68k_supervisor(cpu)) {
+        m68k_privilege_violation(cpu);
+        return;
+    }
+    m68k_set_sr(cpu, (uint16_t)m68k_fetch16(cpu));
+    cpu->stopped = true;
+    cpu->service = true;
+    USE_CYCLES(4);
+}
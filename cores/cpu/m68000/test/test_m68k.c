@@ -0,0 +1,589 @@
+/**
+ * @file test_m68k.c
+ * @brief MC68000 core unit tests
+ *
+ * Each test assembles a few opcodes at $1000 into a flat 1 MB test bus and
+ * single-steps them; execute(1) always runs exactly one instruction and
+ * returns its cycle count. The block cache tests run whole slices and
+ * compare against the interpreter.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "m68k.h"
+#include "m68k_flags.h"
+
+#define TEST_RAM_SIZE   0x100000
+#define TEST_ORG        0x1000
+#define TEST_SSP        0x10000
+#define TEST_HANDLER    0x2000
+
+static uint8_t s_ram[TEST_RAM_SIZE];
+static m68k_cpu_t s_cpu;
+
+static uint8_t test_read_byte(uint32_t addr)
+{
+    return s_ram[addr & (TEST_RAM_SIZE - 1)];
+}
+
+static uint16_t test_read_word(uint32_t addr)
+{
+    addr &= TEST_RAM_SIZE - 2;
+    return (uint16_t)((s_ram[addr] << 8) | s_ram[addr + 1]);
+}
+
+static uint32_t test_read_long(uint32_t addr)
+{
+    return ((uint32_t)test_read_word(addr) << 16) | test_read_word(addr + 2);
+}
+
+static void test_write_byte(uint32_t addr, uint8_t val)
+{
+    s_ram[addr & (TEST_RAM_SIZE - 1)] = val;
+}
+
+static void test_write_word(uint32_t addr, uint16_t val)
+{
+    addr &= TEST_RAM_SIZE - 2;
+    s_ram[addr] = (uint8_t)(val >> 8);
+    s_ram[addr + 1] = (uint8_t)val;
+}
+
+static void test_write_long(uint32_t addr, uint32_t val)
+{
+    test_write_word(addr, (uint16_t)(val >> 16));
+    test_write_word(addr + 2, (uint16_t)val);
+}
+
+static const bus_interface_t s_bus = {
+    .read_byte  = test_read_byte,
+    .read_word  = test_read_word,
+    .read_long  = test_read_long,
+    .write_byte = test_write_byte,
+    .write_word = test_write_word,
+    .write_long = test_write_long,
+};
+
+/** Load @p words at TEST_ORG, point every vector at TEST_HANDLER and reset */
+static void load(const uint16_t *words, size_t count)
+{
+    memset(s_ram, 0, sizeof(s_ram));
+    for (uint32_t v = 2; v < 64; v++) {
+        test_write_long(v * 4, TEST_HANDLER);
+    }
+    test_write_long(0, TEST_SSP);
+    test_write_long(4, TEST_ORG);
+    for (size_t i = 0; i < count; i++) {
+        test_write_word(TEST_ORG + (uint32_t)i * 2, words[i]);
+    }
+    m68k_init(&s_cpu, &s_bus);
+    m68k_reset(&s_cpu);
+}
+
+#define LOAD(...) do { \
+        static const uint16_t prog[] = { __VA_ARGS__ }; \
+        load(prog, sizeof(prog) / sizeof(prog[0])); \
+    } while (0)
+
+static int step(void)
+{
+    return m68k_execute(&s_cpu, 1);
+}
+
+static uint32_t ccr(void)
+{
+    return m68k_get_ccr(&s_cpu);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    m68k_bcache_enable(&s_cpu, false);
+}
+
+void test_optable_complete(void)
+{
+    TEST_ASSERT_GREATER_THAN(1000, m68k_handler_count);
+    for (uint32_t op = 0; op < 0x10000; op++) {
+        TEST_ASSERT_NOT_NULL(m68k_optable[op]);
+    }
+}
+
+void test_reset_loads_vectors(void)
+{
+    LOAD(0x4E71);
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG, s_cpu.pc);
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP, s_cpu.dar[15]);
+    TEST_ASSERT_EQUAL_HEX16(0x2700, m68k_get_sr(&s_cpu));
+}
+
+void test_move_w_dn_dn(void)
+{
+    LOAD(0x3200);                       // move.w d0,d1
+    s_cpu.dar[0] = 0x12348000;
+    s_cpu.dar[1] = 0xAAAA5555;
+    TEST_ASSERT_EQUAL_INT(4, step());
+    TEST_ASSERT_EQUAL_HEX32(0xAAAA8000, s_cpu.dar[1]);
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_N, ccr());
+}
+
+void test_move_l_postinc_timing(void)
+{
+    LOAD(0x2018);                       // move.l (a0)+,d0
+    s_cpu.dar[8] = 0x3000;
+    test_write_long(0x3000, 0xDEADBEEF);
+    TEST_ASSERT_EQUAL_INT(12, step());
+    TEST_ASSERT_EQUAL_HEX32(0xDEADBEEF, s_cpu.dar[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x3004, s_cpu.dar[8]);
+}
+
+void test_moveq_sign_extends(void)
+{
+    LOAD(0x70FF);                       // moveq #-1,d0
+    TEST_ASSERT_EQUAL_INT(4, step());
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, s_cpu.dar[0]);
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_N, ccr());
+}
+
+void test_add_w_overflow(void)
+{
+    LOAD(0xD240);                       // add.w d0,d1
+    s_cpu.dar[0] = 0x7FFF;
+    s_cpu.dar[1] = 0x0001;
+    TEST_ASSERT_EQUAL_INT(4, step());
+    TEST_ASSERT_EQUAL_HEX32(0x8000, s_cpu.dar[1]);
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_N | M68K_CCR_V, ccr());
+}
+
+void test_sub_b_borrow_sets_x(void)
+{
+    LOAD(0x9200);                       // sub.b d0,d1
+    s_cpu.dar[0] = 0x01;
+    s_cpu.dar[1] = 0x00;
+    step();
+    TEST_ASSERT_EQUAL_HEX32(0xFF, s_cpu.dar[1]);
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_X | M68K_CCR_N | M68K_CCR_C, ccr());
+}
+
+void test_addx_keeps_z(void)
+{
+    LOAD(0xD340, 0xD340);               // addx.w d0,d1 twice
+    s_cpu.dar[0] = 0;
+    s_cpu.dar[1] = 0;
+    m68k_set_ccr(&s_cpu, M68K_CCR_Z);
+    step();
+    TEST_ASSERT_BITS(M68K_CCR_Z, M68K_CCR_Z, ccr());
+    s_cpu.dar[0] = 1;
+    step();
+    TEST_ASSERT_EQUAL_HEX32(1, s_cpu.dar[1]);
+    TEST_ASSERT_BITS(M68K_CCR_Z, 0, ccr());
+}
+
+enum { REF_LOGIC, REF_ADD, REF_SUB, REF_CMP };
+
+static int64_t ref_sext(uint32_t v, int sz)
+{
+    int bits = 8 * sz;
+    int64_t m = (int64_t)1 << bits;
+    int64_t x = (int64_t)(v & (uint32_t)(m - 1));
+    return x >= m / 2 ? x - m : x;
+}
+
+/** Reference CCR computed with wide arithmetic */
+static uint32_t ref_ccr(int kind, uint32_t s, uint32_t d, int sz, uint32_t x_in)
+{
+    uint64_t mask = m68k_sz_mask(sz);
+    int64_t smin = -(int64_t)(mask / 2) - 1, smax = (int64_t)(mask / 2);
+    uint64_t us = s & mask, ud = d & mask, ures;
+    int64_t sres;
+    uint32_t f = 0;
+
+    if (kind == REF_LOGIC) {
+        ures = ud;
+        sres = 0;
+        f = x_in ? M68K_CCR_X : 0;
+    } else if (kind == REF_ADD) {
+        ures = ud + us;
+        sres = ref_sext(d, sz) + ref_sext(s, sz);
+        f = ures > mask ? M68K_CCR_C | M68K_CCR_X : 0;
+    } else {
+        ures = ud - us;
+        sres = ref_sext(d, sz) - ref_sext(s, sz);
+        f = us > ud ? M68K_CCR_C : 0;
+        if (kind == REF_SUB) {
+            f |= (f & M68K_CCR_C) ? M68K_CCR_X : 0;
+        } else if (x_in) {
+            f |= M68K_CCR_X;
+        }
+    }
+    if (sres < smin || sres > smax) {
+        f |= M68K_CCR_V;
+    }
+    ures &= mask;
+    f |= ures == 0 ? M68K_CCR_Z : 0;
+    f |= (ures & m68k_sz_msb(sz)) ? M68K_CCR_N : 0;
+    return f;
+}
+
+static void record_flags(int kind, uint32_t s, uint32_t d, int sz, uint32_t x_in)
+{
+    m68k_set_ccr(&s_cpu, x_in ? M68K_CCR_X : 0);
+    switch (kind) {
+    case REF_LOGIC: m68k_flags_logic(&s_cpu, d, sz); break;
+    case REF_ADD:   m68k_flags_add(&s_cpu, s, d, d + s, sz); break;
+    case REF_SUB:   m68k_flags_sub(&s_cpu, s, d, d - s, sz); break;
+    default:        m68k_flags_cmp(&s_cpu, s, d, d - s, sz); break;
+    }
+}
+
+void test_flags_match_reference(void)
+{
+    static const uint32_t vals[] = {
+        0, 1, 2, 0x7F, 0x80, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFFFF,
+        0x12345678, 0x7FFFFFFF, 0x80000000, 0x80000001, 0xFFFFFFFF,
+    };
+    static const int sizes[] = { 1, 2, 4 };
+    const int nvals = sizeof(vals) / sizeof(vals[0]);
+
+    LOAD(0x4E71);
+    for (int kind = REF_LOGIC; kind <= REF_CMP; kind++) {
+        for (int si = 0; si < 3; si++) {
+            for (int i = 0; i < nvals; i++) {
+                for (int j = 0; j < nvals; j++) {
+                    for (uint32_t x = 0; x < 2; x++) {
+                        int sz = sizes[si];
+                        uint32_t want = ref_ccr(kind, vals[i], vals[j], sz, x);
+
+                        // test_cc() may materialize, so record afresh each time
+                        for (int cc = 0; cc < 16; cc++) {
+                            record_flags(kind, vals[i], vals[j], sz, x);
+                            TEST_ASSERT_EQUAL(m68k_cc_eval(cc, want), m68k_test_cc(&s_cpu, cc));
+                        }
+                        record_flags(kind, vals[i], vals[j], sz, x);
+                        TEST_ASSERT_EQUAL_HEX32(want >> 4, m68k_get_x(&s_cpu));
+                        TEST_ASSERT_EQUAL_HEX32(want, m68k_get_ccr(&s_cpu));
+                        TEST_ASSERT_EQUAL_HEX32(want, m68k_get_ccr(&s_cpu));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void test_flags_x_survives_logic_and_cmp(void)
+{
+    // subq.b #1,d0 borrows; move.w d1,d2 and cmp.w d1,d2 must keep X
+    LOAD(0x5300, 0x3401, 0xB441, 0x4E71);
+    s_cpu.dar[0] = 0;
+    s_cpu.dar[1] = 5;
+    step();
+    step();
+    step();
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_X | M68K_CCR_Z, ccr());
+    TEST_ASSERT_EQUAL_HEX16(0x2714, m68k_get_sr(&s_cpu));
+}
+
+void test_bcc_timing(void)
+{
+    LOAD(0x6702, 0x4E71, 0x4E71);       // beq.s *+4
+    m68k_set_ccr(&s_cpu, 0);
+    TEST_ASSERT_EQUAL_INT(8, step());
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 2, s_cpu.pc);
+
+    LOAD(0x6702, 0x4E71, 0x4E71);
+    m68k_set_ccr(&s_cpu, M68K_CCR_Z);
+    TEST_ASSERT_EQUAL_INT(10, step());
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 4, s_cpu.pc);
+}
+
+void test_dbf_loop(void)
+{
+    LOAD(0x7003, 0x51C8, 0xFFFE);       // moveq #3,d0 ; dbf d0,*
+    step();
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(10, step());
+        TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 2, s_cpu.pc);
+    }
+    TEST_ASSERT_EQUAL_INT(14, step());
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 6, s_cpu.pc);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFF, s_cpu.dar[0]);
+}
+
+void test_bsr_rts(void)
+{
+    LOAD(0x6102, 0x4E71, 0x4E75);       // bsr.s *+4 ; nop ; rts
+    TEST_ASSERT_EQUAL_INT(18, step());
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 4, s_cpu.pc);
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP - 4, s_cpu.dar[15]);
+    TEST_ASSERT_EQUAL_INT(16, step());
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 2, s_cpu.pc);
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP, s_cpu.dar[15]);
+}
+
+void test_movem_round_trip(void)
+{
+    // movem.l d0-d1,-(a7) ; movem.l (a7)+,d2-d3
+    LOAD(0x48E7, 0xC000, 0x4CDF, 0x000C);
+    s_cpu.dar[0] = 0x11111111;
+    s_cpu.dar[1] = 0x22222222;
+    TEST_ASSERT_EQUAL_INT(8 + 2 * 8, step());
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP - 8, s_cpu.dar[15]);
+    TEST_ASSERT_EQUAL_HEX32(0x11111111, test_read_long(TEST_SSP - 8));
+    TEST_ASSERT_EQUAL_INT(12 + 2 * 8, step());
+    TEST_ASSERT_EQUAL_HEX32(0x11111111, s_cpu.dar[2]);
+    TEST_ASSERT_EQUAL_HEX32(0x22222222, s_cpu.dar[3]);
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP, s_cpu.dar[15]);
+}
+
+void test_lsl_l_carry_out(void)
+{
+    LOAD(0xE988);                       // lsl.l #4,d0
+    s_cpu.dar[0] = 0x10000001;
+    TEST_ASSERT_EQUAL_INT(8 + 2 * 4, step());
+    TEST_ASSERT_EQUAL_HEX32(0x00000010, s_cpu.dar[0]);
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_X | M68K_CCR_C, ccr());
+}
+
+void test_asr_w_sign_fill(void)
+{
+    LOAD(0xE240);                       // asr.w #1,d0
+    s_cpu.dar[0] = 0x8001;
+    TEST_ASSERT_EQUAL_INT(8, step());
+    TEST_ASSERT_EQUAL_HEX32(0xC000, s_cpu.dar[0]);
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_X | M68K_CCR_N | M68K_CCR_C, ccr());
+}
+
+void test_divu(void)
+{
+    LOAD(0x80C1);                       // divu d1,d0
+    s_cpu.dar[0] = 100000;
+    s_cpu.dar[1] = 7;
+    step();
+    TEST_ASSERT_EQUAL_HEX32((5u << 16) | 14285u, s_cpu.dar[0]);
+    TEST_ASSERT_EQUAL_HEX32(0, ccr() & (M68K_CCR_V | M68K_CCR_Z | M68K_CCR_N));
+}
+
+void test_divu_by_zero_traps(void)
+{
+    LOAD(0x80C1);                       // divu d1,d0
+    s_cpu.dar[1] = 0;
+    step();
+    TEST_ASSERT_EQUAL_HEX32(TEST_HANDLER, s_cpu.pc);
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 2, test_read_long(TEST_SSP - 4));
+}
+
+void test_trap_stacks_sr_and_pc(void)
+{
+    LOAD(0x46FC, 0x0000, 0x4E43);       // move #0,sr ; trap #3
+    s_cpu.osp = 0x8000;
+    step();
+    TEST_ASSERT_EQUAL_HEX32(0x8000, s_cpu.dar[15]);
+    TEST_ASSERT_EQUAL_INT(34, step());
+    TEST_ASSERT_EQUAL_HEX32(TEST_HANDLER, s_cpu.pc);
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP - 6, s_cpu.dar[15]);
+    TEST_ASSERT_EQUAL_HEX16(0x0000, test_read_word(TEST_SSP - 6));
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 6, test_read_long(TEST_SSP - 4));
+    TEST_ASSERT_BITS(M68K_SR_S, M68K_SR_S, m68k_get_sr(&s_cpu));
+}
+
+void test_privilege_violation(void)
+{
+    LOAD(0x46FC, 0x0000, 0x46FC, 0x2700);   // move #0,sr ; move #$2700,sr
+    s_cpu.osp = 0x8000;
+    step();
+    step();
+    TEST_ASSERT_EQUAL_HEX32(TEST_HANDLER, s_cpu.pc);
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 4, test_read_long(TEST_SSP - 4));
+}
+
+void test_interrupt_masking(void)
+{
+    LOAD(0x4E71, 0x46FC, 0x2300, 0x4E71);   // nop ; move #$2300,sr ; nop
+    m68k_set_irq(&s_cpu, 4);
+    step();
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 2, s_cpu.pc);
+    step();
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 6, s_cpu.pc);
+    step();
+    // Autovector 4 taken before the nop, then the handler's first opcode
+    TEST_ASSERT_EQUAL_HEX16(0x2400, m68k_get_sr(&s_cpu) & 0xFF00);
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 6, test_read_long(TEST_SSP - 4));
+}
+
+void test_stop_waits_for_interrupt(void)
+{
+    LOAD(0x4E72, 0x2000);               // stop #$2000
+    step();
+    TEST_ASSERT_TRUE(s_cpu.stopped);
+    TEST_ASSERT_EQUAL_INT(512, m68k_execute(&s_cpu, 512));
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 4, s_cpu.pc);
+    m68k_set_irq(&s_cpu, 2);
+    m68k_execute(&s_cpu, 1);
+    TEST_ASSERT_FALSE(s_cpu.stopped);
+    TEST_ASSERT_EQUAL_HEX32(TEST_ORG + 4, test_read_long(TEST_SSP - 4));
+}
+
+void test_execute_reports_overshoot(void)
+{
+    LOAD(0x4E71, 0x4E71, 0x4E71);       // nop x3
+    TEST_ASSERT_EQUAL_INT(8, m68k_execute(&s_cpu, 5));
+    TEST_ASSERT_EQUAL_UINT64(8, s_cpu.total_cycles);
+}
+
+void test_state_round_trip(void)
+{
+    cpu_state_t state;
+
+    LOAD(0x4E71);
+    s_cpu.dar[3] = 0x33;
+    m68k_set_ccr(&s_cpu, M68K_CCR_X | M68K_CCR_C);
+    m68k_get_state(&s_cpu, &state);
+    TEST_ASSERT_EQUAL_HEX16(0x2711, state.sr);
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP, state.ssp);
+
+    state.sr = 0x0004;
+    state.usp = 0x4000;
+    m68k_set_state(&s_cpu, &state);
+    TEST_ASSERT_EQUAL_HEX32(0x4000, s_cpu.dar[15]);
+    TEST_ASSERT_EQUAL_HEX32(TEST_SSP, s_cpu.osp);
+    TEST_ASSERT_EQUAL_HEX32(M68K_CCR_Z, ccr());
+    TEST_ASSERT_EQUAL_HEX32(0x33, s_cpu.dar[3]);
+}
+
+static const uint16_t s_bc_loop[] = {
+    0x7000,                     // 1000  moveq   #0,d0
+    0x7264,                     // 1002  moveq   #100,d1
+    0xD081,                     // 1004  add.l   d1,d0
+    0xE388,                     // 1006  lsl.l   #1,d0
+    0x0A80, 0x1234, 0x5678,     // 1008  eori.l  #$12345678,d0
+    0x51C9, 0xFFF4,             // 100E  dbf     d1,$1004
+    0x60FE,                     // 1012  bra.s   *
+};
+
+void test_bcache_matches_interpreter(void)
+{
+    cpu_state_t interp, cached;
+
+    load(s_bc_loop, sizeof(s_bc_loop) / sizeof(s_bc_loop[0]));
+    for (int i = 0; i < 100; i++) {
+        m68k_execute(&s_cpu, 37);
+    }
+    m68k_get_state(&s_cpu, &interp);
+
+    load(s_bc_loop, sizeof(s_bc_loop) / sizeof(s_bc_loop[0]));
+    TEST_ASSERT_TRUE(m68k_bcache_enable(&s_cpu, true));
+    for (int i = 0; i < 100; i++) {
+        m68k_execute(&s_cpu, 37);
+    }
+    m68k_get_state(&s_cpu, &cached);
+
+    // The loop page is marked, so blocks were recorded
+    TEST_ASSERT_BITS(1u << 0, 1u << 0, s_cpu.code_pages[0x10 >> 3]);
+    TEST_ASSERT_EQUAL_HEX32(interp.d[0], cached.d[0]);
+    TEST_ASSERT_EQUAL_HEX32(interp.d[1], cached.d[1]);
+    TEST_ASSERT_EQUAL_HEX32(interp.pc, cached.pc);
+    TEST_ASSERT_EQUAL_HEX16(interp.sr, cached.sr);
+    TEST_ASSERT_EQUAL_UINT64(interp.cycles, cached.cycles);
+}
+
+void test_bcache_self_modifying_code(void)
+{
+    // Run a hot loop, patch its addq #1 into addq #2, run it again
+    LOAD(0x7000,                    // 1000  moveq   #0,d0
+         0x7413,                    // 1002  moveq   #19,d2
+         0x5280,                    // 1004  addq.l  #1,d0
+         0x51CA, 0xFFFC,            // 1006  dbf     d2,$1004
+         0x4A83,                    // 100A  tst.l   d3
+         0x66FE,                    // 100C  bne.s   *
+         0x7601,                    // 100E  moveq   #1,d3
+         0x31FC, 0x5480, 0x1004,    // 1010  move.w  #$5480,$1004.w
+         0x7413,                    // 1016  moveq   #19,d2
+         0x60EA);                   // 1018  bra.s   $1004
+    TEST_ASSERT_TRUE(m68k_bcache_enable(&s_cpu, true));
+    m68k_execute(&s_cpu, 2000);
+    TEST_ASSERT_EQUAL_HEX32(0x100C, s_cpu.pc & ~1u);
+    TEST_ASSERT_EQUAL_UINT32(20 + 40, s_cpu.dar[0]);
+}
+
+void test_bcache_external_invalidate(void)
+{
+    LOAD(0x5280,                    // 1000  addq.l  #1,d0
+         0x60FC);                   // 1002  bra.s   $1000
+    TEST_ASSERT_TRUE(m68k_bcache_enable(&s_cpu, true));
+    m68k_execute(&s_cpu, 1000);
+    TEST_ASSERT_GREATER_THAN(0, (int32_t)s_cpu.dar[0]);
+
+    // Patch behind the CPU's back, as DMA or the program loader would
+    test_write_word(0x1000, 0x5380);    // subq.l #1,d0
+    m68k_bcache_invalidate(&s_cpu, 0x1000, 2);
+    s_cpu.dar[0] = 0;
+    m68k_execute(&s_cpu, 1000);
+    TEST_ASSERT_LESS_THAN(0, (int32_t)s_cpu.dar[0]);
+}
+
+void test_bcache_masks_the_pc(void)
+{
+    // The self-modifying loop again, entered through a PC with the top byte set
+    LOAD(0x4EF9, 0xFF00, 0x1100);   // 1000  jmp     $FF001100
+    static const uint16_t loop[] = {
+        0x7000,                     // 1100  moveq   #0,d0
+        0x7413,                     // 1102  moveq   #19,d2
+        0x5280,                     // 1104  addq.l  #1,d0
+        0x51CA, 0xFFFC,             // 1106  dbf     d2,$1104
+        0x4A83,                     // 110A  tst.l   d3
+        0x66FE,                     // 110C  bne.s   *
+        0x7601,                     // 110E  moveq   #1,d3
+        0x31FC, 0x5480, 0x1104,     // 1110  move.w  #$5480,$1104.w
+        0x7413,                     // 1116  moveq   #19,d2
+        0x60EA,                     // 1118  bra.s   $1104
+    };
+    for (size_t i = 0; i < sizeof(loop) / sizeof(loop[0]); i++) {
+        test_write_word(0x1100 + (uint32_t)i * 2, loop[i]);
+    }
+    TEST_ASSERT_TRUE(m68k_bcache_enable(&s_cpu, true));
+    m68k_execute(&s_cpu, 2000);
+    TEST_ASSERT_EQUAL_HEX32(0xFF00110C, s_cpu.pc & ~1u);
+    TEST_ASSERT_EQUAL_UINT32(20 + 40, s_cpu.dar[0]);
+
+    // A write reaching the top of the address space stays inside the page bitmap
+    m68k_bcache_invalidate(&s_cpu, 0xFFFFF0, 0x100);
+    m68k_bcache_invalidate(&s_cpu, 0xFF001100, 2);
+    TEST_ASSERT_BITS(1u << 1, 0, s_cpu.code_pages[0x11 >> 3]);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_optable_complete);
+    RUN_TEST(test_reset_loads_vectors);
+    RUN_TEST(test_move_w_dn_dn);
+    RUN_TEST(test_move_l_postinc_timing);
+    RUN_TEST(test_moveq_sign_extends);
+    RUN_TEST(test_add_w_overflow);
+    RUN_TEST(test_sub_b_borrow_sets_x);
+    RUN_TEST(test_addx_keeps_z);
+    RUN_TEST(test_flags_match_reference);
+    RUN_TEST(test_flags_x_survives_logic_and_cmp);
+    RUN_TEST(test_bcc_timing);
+    RUN_TEST(test_dbf_loop);
+    RUN_TEST(test_bsr_rts);
+    RUN_TEST(test_movem_round_trip);
+    RUN_TEST(test_lsl_l_carry_out);
+    RUN_TEST(test_asr_w_sign_fill);
+    RUN_TEST(test_divu);
+    RUN_TEST(test_divu_by_zero_traps);
+    RUN_TEST(test_trap_stacks_sr_and_pc);
+    RUN_TEST(test_privilege_violation);
+    RUN_TEST(test_interrupt_masking);
+    RUN_TEST(test_stop_waits_for_interrupt);
+    RUN_TEST(test_execute_reports_overshoot);
+    RUN_TEST(test_state_round_trip);
+    RUN_TEST(test_bcache_matches_interpreter);
+    RUN_TEST(test_bcache_self_modifying_code);
+    RUN_TEST(test_bcache_external_invalidate);
+    RUN_TEST(test_bcache_masks_the_pc);
+    return UNITY_END();
+}
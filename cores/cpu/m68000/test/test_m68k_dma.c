@@ -0,0 +1,165 @@
+/**
+ * @file test_m68k_dma.c
+ * @brief MC68000 block cache against the real memory system
+ *
+ * The CPU runs through its component interface on mem_bus(), with the
+ * interface's invalidate() registered with esptari_memory, as the machine
+ * wires it. Code the block cache has recorded is then replaced by DMA and
+ * by a program load behind the bus, and the new code has to run. Last, the
+ * same runs with the register file and opcode table in placed storage.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esptari_memory.h"
+
+#define TEST_RAM_SIZE   (512 * 1024)
+#define TEST_ROM_SIZE   (192 * 1024)
+#define TEST_ORG        0x1000
+#define TEST_SSP        0x10000
+
+const cpu_interface_t *m68000_entry(void);
+
+static uint8_t s_ram[TEST_RAM_SIZE];
+static uint8_t s_rom[TEST_ROM_SIZE];
+static esptari_memory_t s_mem;
+static const cpu_interface_t *s_cpu;
+
+// addq.l #1,d0 / bra.s * - 2
+static const uint8_t s_count_up[4] = { 0x52, 0x80, 0x60, 0xFC };
+// subq.l #1,d0 / bra.s * - 2
+static const uint8_t s_count_down[4] = { 0x53, 0x80, 0x60, 0xFC };
+
+void setUp(void)
+{
+    static const uint8_t vectors[8] = {
+        TEST_SSP >> 24, (TEST_SSP >> 16) & 0xFF, (TEST_SSP >> 8) & 0xFF, TEST_SSP & 0xFF,
+        TEST_ORG >> 24, (TEST_ORG >> 16) & 0xFF, (TEST_ORG >> 8) & 0xFF, TEST_ORG & 0xFF,
+    };
+    cpu_config_t config = {
+        .clock_hz = 8000000,
+        .flags = CPU_CONFIG_BLOCK_CACHE,
+    };
+
+    memset(s_ram, 0, sizeof(s_ram));
+    memset(s_rom, 0, sizeof(s_rom));
+    memcpy(s_rom, vectors, sizeof(vectors));
+    mem_load_image(s_rom, sizeof(s_rom));
+    s_mem = (esptari_memory_t) {
+        .ram      = s_ram,
+        .rom      = s_rom,
+        .ram_size = TEST_RAM_SIZE,
+        .rom_size = TEST_ROM_SIZE,
+        .rom_base = MEM_ROM_BASE_ST,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, mem_init(&s_mem));
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(TEST_ORG, s_count_up, sizeof(s_count_up)));
+
+    s_cpu = m68000_entry();
+    s_cpu->set_bus(mem_bus());
+    TEST_ASSERT_EQUAL(0, s_cpu->init(&config));
+    mem_set_invalidate_callback(s_cpu->invalidate);
+    s_cpu->reset();
+}
+
+void tearDown(void)
+{
+    mem_set_invalidate_callback(NULL);
+    s_cpu->shutdown();
+}
+
+static int32_t d0_after(int cycles)
+{
+    cpu_state_t state;
+
+    s_cpu->get_state(&state);
+    state.d[0] = 0;
+    s_cpu->set_state(&state);
+    s_cpu->execute(cycles);
+    s_cpu->get_state(&state);
+    return (int32_t)state.d[0];
+}
+
+static void test_dma_over_cached_code(void)
+{
+    TEST_ASSERT_GREATER_THAN(0, d0_after(2000));
+
+    // The FDC DMA reads a sector over the loop
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(TEST_ORG, s_count_down, sizeof(s_count_down)));
+    TEST_ASSERT_LESS_THAN(0, d0_after(2000));
+}
+
+static void test_program_load_over_cached_code(void)
+{
+    TEST_ASSERT_GREATER_THAN(0, d0_after(2000));
+
+    // The program loader copies straight into RAM, then converts in place
+    memcpy(s_ram + TEST_ORG, s_count_down, sizeof(s_count_down));
+    mem_load_image(s_ram + TEST_ORG, sizeof(s_count_down));
+    TEST_ASSERT_LESS_THAN(0, d0_after(2000));
+}
+
+// Stand-in for place_alloc_by_name(), counting what is out
+static void *s_hot[2];
+static int s_hot_out;
+
+static void *test_alloc_hot(const char *item, size_t size)
+{
+    int i = strcmp(item, "cpu_regs") == 0 ? 0 : strcmp(item, "opcode_table") == 0 ? 1 : -1;
+
+    TEST_ASSERT_GREATER_OR_EQUAL(0, i);
+    TEST_ASSERT_NULL(s_hot[i]);
+    s_hot[i] = malloc(size);
+    memset(s_hot[i], 0xA5, size);
+    s_hot_out++;
+    return s_hot[i];
+}
+
+static void test_free_hot(const char *item)
+{
+    int i = strcmp(item, "cpu_regs") == 0 ? 0 : 1;
+
+    TEST_ASSERT_NOT_NULL(s_hot[i]);
+    free(s_hot[i]);
+    s_hot[i] = NULL;
+    s_hot_out--;
+}
+
+static void test_placed_regs_and_optable(void)
+{
+    cpu_config_t config = {
+        .clock_hz = 8000000,
+        .flags = CPU_CONFIG_BLOCK_CACHE,
+        .alloc_hot = test_alloc_hot,
+        .free_hot = test_free_hot,
+    };
+
+    s_cpu->shutdown();
+    s_cpu->set_bus(mem_bus());
+    TEST_ASSERT_EQUAL(0, s_cpu->init(&config));
+    TEST_ASSERT_EQUAL(2, s_hot_out);
+    s_cpu->reset();
+    TEST_ASSERT_GREATER_THAN(0, d0_after(2000));
+    TEST_ASSERT_EQUAL(ESP_OK, mem_dma_write(TEST_ORG, s_count_down, sizeof(s_count_down)));
+    TEST_ASSERT_LESS_THAN(0, d0_after(2000));
+
+    // Initializing again gives the old storage back first
+    TEST_ASSERT_EQUAL(0, s_cpu->init(&config));
+    TEST_ASSERT_EQUAL(2, s_hot_out);
+    s_cpu->shutdown();
+    TEST_ASSERT_EQUAL(0, s_hot_out);
+
+    // tearDown() shuts down again, from the static copies
+    s_cpu->set_bus(mem_bus());
+    TEST_ASSERT_EQUAL(0, s_cpu->init(NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dma_over_cached_code);
+    RUN_TEST(test_program_load_over_cached_code);
+    RUN_TEST(test_placed_regs_and_optable);
+    return UNITY_END();
+}
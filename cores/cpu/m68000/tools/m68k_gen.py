@@ -0,0 +1,347 @@
+#!/usr/bin/env python3
+"""
+Generate the MC68000 opcode handler table.
+
+Walks all 65536 opcode words, decodes each one the way the 68000 does and
+maps it to a handler specialized for its instruction, operand size and
+effective-address modes. Every distinct specialization becomes one small C
+function that calls the matching always-inline body in src/m68k_ops.h with
+constant arguments; the compiler then folds the EA/size switches away.
+Encodings the 68000 does not implement map to the illegal instruction
+handler (or Line A / Line F).
+
+Usage: m68k_gen.py --output <m68k_optable.c>
+"""
+
+import argparse
+import sys
+
+# Mode index -> C enumerator, must match the enum in src/m68k_ea.h
+EA_MODES = ["EA_DN", "EA_AN", "EA_AI", "EA_PI", "EA_PD", "EA_DI", "EA_IX",
+            "EA_AW", "EA_AL", "EA_PCDI", "EA_PCIX", "EA_IMM"]
+EA_SHORT = ["dn", "an", "ai", "pi", "pd", "di", "ix", "aw", "al", "pcdi", "pcix", "imm"]
+
+DN, AN, AI, PI, PD, DI, IX, AW, AL, PCDI, PCIX, IMM = range(12)
+
+# Addressing categories, MC68000 PRM Table 2-4
+ALL = set(range(12))
+DATA = ALL - {AN}
+MEMORY = ALL - {DN, AN}
+ALTERABLE = {DN, AN, AI, PI, PD, DI, IX, AW, AL}
+DATA_ALT = ALTERABLE - {AN}
+MEM_ALT = DATA_ALT - {DN}
+CONTROL = {AI, DI, IX, AW, AL, PCDI, PCIX}
+CONTROL_ALT = {AI, DI, IX, AW, AL}
+
+SIZES = {0: 1, 1: 2, 2: 4}          # standard 2-bit size field
+SZ_NAME = {1: "b", 2: "w", 4: "l"}
+ALU_OPS = {0: "ALU_OR", 1: "ALU_AND", 2: "ALU_SUB", 3: "ALU_ADD", 5: "ALU_EOR", 6: "ALU_CMP"}
+SHIFT_TYPES = ["SHIFT_AS", "SHIFT_LS", "SHIFT_ROX", "SHIFT_RO"]
+BIT_OPS = ["BIT_TST", "BIT_CHG", "BIT_CLR", "BIT_SET"]
+CONDITIONS = ["t", "f", "hi", "ls", "cc", "cs", "ne", "eq",
+              "vc", "vs", "pl", "mi", "ge", "lt", "gt", "le"]
+
+
+def ea(mode, reg):
+    """Split mode 7 by its register field; None for unassigned encodings."""
+    if mode < 7:
+        return mode
+    return {0: AW, 1: AL, 2: PCDI, 3: PCIX, 4: IMM}.get(reg)
+
+
+def h(name, body, *args):
+    """Build a (handler name, C call) pair."""
+    call = "m68k_op_%s(cpu, op%s)" % (body, "".join(", " + str(a) for a in args))
+    return "h_" + name, call
+
+
+def lower(s):
+    return s.split("_", 1)[1].lower()
+
+
+ILLEGAL = h("illegal", "illegal", "M68K_VEC_ILLEGAL")
+
+
+def decode_group0(op, m, r, src):
+    if op & 0x0100:
+        if m == 1:
+            return h("movep_%d" % ((op >> 6) & 7), "movep", (op >> 6) & 7)
+        kind = (op >> 6) & 3
+        allowed = DATA if kind == 0 else DATA_ALT
+        if src not in allowed:
+            return None
+        return h("%s_dyn_%s" % (lower(BIT_OPS[kind]), EA_SHORT[src]), "bit", BIT_OPS[kind], "false", EA_MODES[src])
+
+    sel = (op >> 9) & 7
+    if sel == 4:
+        kind = (op >> 6) & 3
+        allowed = (DATA - {IMM}) if kind == 0 else DATA_ALT
+        if src not in allowed:
+            return None
+        return h("%s_imm_%s" % (lower(BIT_OPS[kind]), EA_SHORT[src]), "bit", BIT_OPS[kind], "true", EA_MODES[src])
+    if sel not in ALU_OPS:
+        return None
+    kind = ALU_OPS[sel]
+    low = op & 0xFF
+    if kind in ("ALU_OR", "ALU_AND", "ALU_EOR") and low in (0x3C, 0x7C):
+        to_sr = low == 0x7C
+        return h("%si_%s" % (lower(kind), "sr" if to_sr else "ccr"), "logic_sr", kind, "true" if to_sr else "false")
+    size = SIZES.get((op >> 6) & 3)
+    if size is None or src not in DATA_ALT:
+        return None
+    return h("%si_%s_%s" % (lower(kind), SZ_NAME[size], EA_SHORT[src]), "alu_imm", kind, size, EA_MODES[src])
+
+
+def decode_move(op, m, r, src):
+    size = {1: 1, 3: 2, 2: 4}[op >> 12]
+    dm = ea((op >> 6) & 7, (op >> 9) & 7)
+    if src is None or (size == 1 and src == AN):
+        return None
+    if dm == AN:
+        if size == 1:
+            return None
+        return h("movea_%s_%s" % (SZ_NAME[size], EA_SHORT[src]), "movea", size, EA_MODES[src])
+    if dm not in DATA_ALT:
+        return None
+    return h("move_%s_%s_%s" % (SZ_NAME[size], EA_SHORT[src], EA_SHORT[dm]), "move", size, EA_MODES[src], EA_MODES[dm])
+
+
+def decode_group4(op, m, r, src):
+    fixed = {
+        0x4AFC: ILLEGAL,
+        0x4E70: h("reset", "reset"),
+        0x4E71: h("nop", "nop"),
+        0x4E72: h("stop", "stop"),
+        0x4E73: h("rte", "rte"),
+        0x4E75: h("rts", "rts"),
+        0x4E76: h("trapv", "trapv"),
+        0x4E77: h("rtr", "rtr"),
+    }
+    if op in fixed:
+        return fixed[op]
+    if op & 0xFFF0 == 0x4E40:
+        return h("trap", "trap")
+    if op & 0xFFF8 == 0x4E50:
+        return h("link", "link")
+    if op & 0xFFF8 == 0x4E58:
+        return h("unlk", "unlk")
+    if op & 0xFFF0 == 0x4E60:
+        return h("move_usp", "move_usp")
+    if op & 0xFFC0 in (0x4E80, 0x4EC0):
+        if src not in CONTROL:
+            return None
+        name = "jsr" if op & 0xFFC0 == 0x4E80 else "jmp"
+        return h("%s_%s" % (name, EA_SHORT[src]), name, EA_MODES[src])
+    if op & 0x0100:
+        opmode = (op >> 6) & 3
+        if opmode == 3 and src in CONTROL:
+            return h("lea_%s" % EA_SHORT[src], "lea", EA_MODES[src])
+        if opmode == 2 and src in DATA:
+            return h("chk_%s" % EA_SHORT[src], "chk", EA_MODES[src])
+        return None
+
+    sub = (op >> 8) & 0xF
+    size_bits = (op >> 6) & 3
+    if sub in (0x0, 0x2, 0x4, 0x6):
+        if size_bits == 3:
+            if sub == 0x0 and src in DATA_ALT:
+                return h("move_from_sr_%s" % EA_SHORT[src], "move_from_sr", EA_MODES[src])
+            if sub == 0x4 and src in DATA:
+                return h("move_to_ccr_%s" % EA_SHORT[src], "move_to_ccr", EA_MODES[src])
+            if sub == 0x6 and src in DATA:
+                return h("move_to_sr_%s" % EA_SHORT[src], "move_to_sr", EA_MODES[src])
+            return None
+        if src not in DATA_ALT:
+            return None
+        size = SIZES[size_bits]
+        name = {0x0: "negx", 0x2: "clr", 0x4: "neg", 0x6: "not"}[sub]
+        return h("%s_%s_%s" % (name, SZ_NAME[size], EA_SHORT[src]), name, size, EA_MODES[src])
+    if sub == 0x8:
+        if size_bits == 0:
+            return h("nbcd_%s" % EA_SHORT[src], "nbcd", EA_MODES[src]) if src in DATA_ALT else None
+        if size_bits == 1:
+            if m == 0:
+                return h("swap", "swap")
+            return h("pea_%s" % EA_SHORT[src], "pea", EA_MODES[src]) if src in CONTROL else None
+        size = 2 if size_bits == 2 else 4
+        if m == 0:
+            return h("ext_%s" % SZ_NAME[size], "ext", size)
+        if src in CONTROL_ALT | {PD}:
+            return h("movem_r2m_%s_%s" % (SZ_NAME[size], EA_SHORT[src]), "movem_r2m", size, EA_MODES[src])
+        return None
+    if sub == 0xA:
+        if size_bits == 3:
+            return h("tas_%s" % EA_SHORT[src], "tas", EA_MODES[src]) if src in DATA_ALT else None
+        size = SIZES[size_bits]
+        return h("tst_%s_%s" % (SZ_NAME[size], EA_SHORT[src]), "tst", size, EA_MODES[src]) if src in DATA_ALT else None
+    if sub == 0xC and size_bits >= 2:
+        size = 2 if size_bits == 2 else 4
+        if src in CONTROL | {PI}:
+            return h("movem_m2r_%s_%s" % (SZ_NAME[size], EA_SHORT[src]), "movem_m2r", size, EA_MODES[src])
+    return None
+
+
+def decode_group5(op, m, r, src):
+    if (op >> 6) & 3 == 3:
+        cc = (op >> 8) & 0xF
+        if m == 1:
+            return h("db%s" % CONDITIONS[cc], "dbcc", cc)
+        if src not in DATA_ALT:
+            return None
+        return h("s%s_%s" % (CONDITIONS[cc], EA_SHORT[src]), "scc", cc, EA_MODES[src])
+    size = SIZES[(op >> 6) & 3]
+    kind = "ALU_SUB" if op & 0x0100 else "ALU_ADD"
+    if src not in ALTERABLE or (size == 1 and src == AN):
+        return None
+    return h("%sq_%s_%s" % (lower(kind), SZ_NAME[size], EA_SHORT[src]), "addq", kind, size, EA_MODES[src])
+
+
+def decode_group6(op, m, r, src):
+    cc = (op >> 8) & 0xF
+    wide = (op & 0xFF) == 0
+    suffix = "w" if wide else "b"
+    flag = "true" if wide else "false"
+    if cc == 1:
+        return h("bsr_" + suffix, "bsr", flag)
+    return h("b%s_%s" % ("ra" if cc == 0 else CONDITIONS[cc], suffix), "bcc", cc, flag)
+
+
+def decode_alu_group(op, m, r, src, kind):
+    """Shared decoding for OR (8), SUB (9), CMP/EOR (B), AND (C), ADD (D)."""
+    opmode = (op >> 6) & 7
+    if opmode in (3, 7):
+        if kind in ("ALU_OR", "ALU_AND"):
+            if src not in DATA:
+                return None
+            signed = "true" if opmode == 7 else "false"
+            body = "div" if kind == "ALU_OR" else "mul"
+            name = "%s%s" % (body, "s" if opmode == 7 else "u")
+            return h("%s_%s" % (name, EA_SHORT[src]), body, signed, EA_MODES[src])
+        if src is None:
+            return None
+        size = 2 if opmode == 3 else 4
+        name = {"ALU_SUB": "suba", "ALU_ADD": "adda", "ALU_CMP": "cmpa"}[kind]
+        return h("%s_%s_%s" % (name, SZ_NAME[size], EA_SHORT[src]), "adda", kind, size, EA_MODES[src])
+
+    size = SIZES[opmode & 3]
+    if opmode < 4:
+        if src is None or (src == AN and (size == 1 or kind in ("ALU_OR", "ALU_AND"))):
+            return None
+        return h("%s_%s_%s_dn" % (lower(kind), SZ_NAME[size], EA_SHORT[src]), "alu_to_dn", kind, size, EA_MODES[src])
+
+    if m in (0, 1):
+        mem = "true" if m == 1 else "false"
+        tag = "mm" if m == 1 else "rr"
+        if kind in ("ALU_ADD", "ALU_SUB"):
+            return h("%sx_%s_%s" % (lower(kind), SZ_NAME[size], tag), "addx", kind, size, mem)
+        if kind == "ALU_CMP" and m == 1:
+            return h("cmpm_%s" % SZ_NAME[size], "cmpm", size)
+        if kind in ("ALU_OR", "ALU_AND") and opmode == 4:
+            bcd = "ALU_SUB" if kind == "ALU_OR" else "ALU_ADD"
+            return h("%s_%s" % ("sbcd" if kind == "ALU_OR" else "abcd", tag), "bcd", bcd, mem)
+        if kind == "ALU_AND" and opmode in (5, 6):
+            exg = (op >> 3) & 0x1F
+            if exg in (0x08, 0x09, 0x11):
+                return h("exg_%d" % exg, "exg", exg)
+            return None
+        if kind == "ALU_CMP" and m == 0:
+            kind = "ALU_EOR"
+        else:
+            return None
+    if kind == "ALU_CMP":
+        kind = "ALU_EOR"
+    allowed = DATA_ALT if kind == "ALU_EOR" else MEM_ALT
+    if src not in allowed:
+        return None
+    return h("%s_%s_dn_%s" % (lower(kind), SZ_NAME[size], EA_SHORT[src]), "alu_to_ea", kind, size, EA_MODES[src])
+
+
+def decode_shift(op, m, r, src):
+    left = "true" if op & 0x0100 else "false"
+    d = "l" if op & 0x0100 else "r"
+    if (op >> 6) & 3 == 3:
+        if op & 0x0800 or src not in MEM_ALT:
+            return None
+        t = (op >> 9) & 3
+        return h("%s%s_mem_%s" % (lower(SHIFT_TYPES[t]), d, EA_SHORT[src]), "shift_mem", SHIFT_TYPES[t], left, EA_MODES[src])
+    size = SIZES[(op >> 6) & 3]
+    t = (op >> 3) & 3
+    by_reg = op & 0x20
+    return h("%s%s_%s_%s" % (lower(SHIFT_TYPES[t]), d, SZ_NAME[size], "r" if by_reg else "i"),
+             "shift_reg", SHIFT_TYPES[t], left, size, "true" if by_reg else "false")
+
+
+def decode(op):
+    m = (op >> 3) & 7
+    r = op & 7
+    src = ea(m, r)
+    group = op >> 12
+
+    if group == 0x0:
+        return decode_group0(op, m, r, src)
+    if group in (0x1, 0x2, 0x3):
+        return decode_move(op, m, r, src)
+    if group == 0x4:
+        return decode_group4(op, m, r, src)
+    if group == 0x5:
+        return decode_group5(op, m, r, src)
+    if group == 0x6:
+        return decode_group6(op, m, r, src)
+    if group == 0x7:
+        return None if op & 0x0100 else h("moveq", "moveq")
+    if group == 0x8:
+        return decode_alu_group(op, m, r, src, "ALU_OR")
+    if group == 0x9:
+        return decode_alu_group(op, m, r, src, "ALU_SUB")
+    if group == 0xA:
+        return h("line_a", "illegal", "M68K_VEC_LINE_A")
+    if group == 0xB:
+        return decode_alu_group(op, m, r, src, "ALU_CMP")
+    if group == 0xC:
+        return decode_alu_group(op, m, r, src, "ALU_AND")
+    if group == 0xD:
+        return decode_alu_group(op, m, r, src, "ALU_ADD")
+    if group == 0xE:
+        return decode_shift(op, m, r, src)
+    return h("line_f", "illegal", "M68K_VEC_LINE_F")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--output", required=True, help="generated C file")
+    args = parser.parse_args()
+
+    handlers = {}
+    table = []
+    for op in range(0x10000):
+        name, call = decode(op) or ILLEGAL
+        prev = handlers.setdefault(name, call)
+        if prev != call:
+            sys.exit("m68k_gen: handler %s has conflicting bodies:\n  %s\n  %s" % (name, prev, call))
+        table.append(name)
+
+    out = ["/*",
+           " * Generated by tools/m68k_gen.py - do not edit.",
+           " *",
+           " * %d specialized handlers for 65536 opcodes." % len(handlers),
+           " */",
+           "",
+           '#include "m68k_ops.h"',
+           ""]
+    for name in sorted(handlers):
+        out.append("static void %s(m68k_cpu_t *cpu, uint16_t op) { %s; }" % (name, handlers[name]))
+    out.append("")
+    out.append("const m68k_handler_t m68k_optable[0x10000] = {")
+    for i in range(0, 0x10000, 4):
+        out.append("    " + " ".join("%s," % n for n in table[i:i + 4]) + "  // %04X" % i)
+    out.append("};")
+    out.append("")
+    out.append("const int m68k_handler_count = %d;" % len(handlers))
+    out.append("")
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
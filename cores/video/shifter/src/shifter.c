@@ -0,0 +1,383 @@
+/**
+ * @file shifter.c
+ * @brief Atari ST Shifter, scanline renderer
+ */
+
+#include <string.h>
+#include "shifter.h"
+
+#define SHIFTER_ADDR_MASK       0x3FFFFF    // 4 MB of ST RAM
+
+// Line timing in CPU cycles. The display window start is approximate;
+// without border emulation only the offset of mid-line palette writes
+// depends on it.
+#define SHIFTER_LINE_CYCLES_50  512
+#define SHIFTER_LINE_CYCLES_60  508
+#define SHIFTER_LINE_CYCLES_71  224
+#define SHIFTER_DE_START_50     56
+#define SHIFTER_DE_START_60     52
+#define SHIFTER_DE_START_71     0
+
+uint16_t shifter_st_to_rgb565(uint16_t color)
+{
+    uint16_t r = (color >> 8) & 7, g = (color >> 4) & 7, b = color & 7;
+
+    // Replicate the top bits so $777 is full white
+    return (uint16_t)((((r << 2) | (r >> 1)) << 11) | (((g << 3) | g) << 5) |
+                      ((b << 2) | (b >> 1)));
+}
+
+// ---------------------------------------------------------------------------
+// Mode
+// ---------------------------------------------------------------------------
+
+static int shifter_planes(const shifter_t *s)
+{
+    return s->res == SHIFTER_RES_LOW ? 4 : s->res == SHIFTER_RES_MEDIUM ? 2 : 1;
+}
+
+static int shifter_width(const shifter_t *s)
+{
+    return s->res == SHIFTER_RES_LOW ? 320 : 640;
+}
+
+int shifter_line_cycles(const shifter_t *s)
+{
+    if (s->res == SHIFTER_RES_HIGH) {
+        return SHIFTER_LINE_CYCLES_71;
+    }
+    return (s->sync & SHIFTER_SYNC_50HZ) ? SHIFTER_LINE_CYCLES_50 : SHIFTER_LINE_CYCLES_60;
+}
+
+int shifter_de_start(const shifter_t *s)
+{
+    if (s->res == SHIFTER_RES_HIGH) {
+        return SHIFTER_DE_START_71;
+    }
+    return (s->sync & SHIFTER_SYNC_50HZ) ? SHIFTER_DE_START_50 : SHIFTER_DE_START_60;
+}
+
+void shifter_get_mode(const shifter_t *s, video_mode_t *mode)
+{
+    mode->width = (uint16_t)shifter_width(s);
+    mode->height = s->res == SHIFTER_RES_HIGH ? 400 : 200;
+    mode->planes = (uint8_t)shifter_planes(s);
+    mode->refresh_hz = s->res == SHIFTER_RES_HIGH ? 71 : (s->sync & SHIFTER_SYNC_50HZ) ? 50 : 60;
+}
+
+// ---------------------------------------------------------------------------
+// Colour tables
+// ---------------------------------------------------------------------------
+
+/** Update rgb[] after palette entry @p index changed */
+static void shifter_set_rgb(shifter_t *s, int index)
+{
+    s->pal_sig_dirty = true;
+    if (s->res == SHIFTER_RES_HIGH) {
+        // Monochrome: bit 0 of colour 0 selects normal or inverted video
+        if (index == 0) {
+            bool inverted = !(s->palette[0] & 1);
+            s->lut.rgb[0] = inverted ? 0x0000 : 0xFFFF;
+            s->lut.rgb[1] = inverted ? 0xFFFF : 0x0000;
+        }
+        return;
+    }
+    s->lut.rgb[index] = shifter_st_to_rgb565(s->palette[index]);
+}
+
+/** Colour tables and kernel after a reset or resolution change */
+static void shifter_rebuild_rgb(shifter_t *s)
+{
+    for (int i = 15; i >= 0; i--) {
+        shifter_set_rgb(s, i);
+    }
+    s->lut.pair_dirty = true;
+    s->convert = c2p_get(shifter_planes(s), C2P_IMPL_AUTO);
+}
+
+static uint32_t shifter_palette_sig(shifter_t *s)
+{
+    if (s->pal_sig_dirty) {
+        // Monochrome shows colour 0 only
+        int entries = s->res == SHIFTER_RES_HIGH ? 1 : 16;
+        uint32_t h = 2166136261u;
+        for (int i = 0; i < entries; i++) {
+            h = (h ^ s->palette[i]) * 16777619u;
+        }
+        s->pal_sig = h;
+        s->pal_sig_dirty = false;
+    }
+    return s->pal_sig;
+}
+
+// ---------------------------------------------------------------------------
+// Lifecycle and registers
+// ---------------------------------------------------------------------------
+
+void shifter_init(shifter_t *s, const video_config_t *config)
+{
+    memset(s, 0, sizeof(*s));
+    if (config) {
+        s->config = *config;
+    }
+    shifter_reset(s);
+}
+
+void shifter_reset(shifter_t *s)
+{
+    memset(s->palette, 0, sizeof(s->palette));
+    memset(s->palette_end, 0, sizeof(s->palette_end));
+    s->res = SHIFTER_RES_LOW;
+    s->sync = SHIFTER_SYNC_50HZ;
+    s->base = 0;
+    s->counter = 0;
+    s->vpos = 0;
+    s->line_start = 0;
+    s->log_count = 0;
+    memset(s->pending, 0, sizeof(s->pending));
+    memset(s->dirty, 0, sizeof(s->dirty));
+    memset(s->line_age, 0, sizeof(s->line_age));
+    s->force_frame = true;
+    s->force_next = true;
+    shifter_rebuild_rgb(s);
+}
+
+static uint64_t shifter_now(const shifter_t *s)
+{
+    return s->config.get_cycle ? s->config.get_cycle(s->config.cycle_ctx) : 0;
+}
+
+static void shifter_write_palette(shifter_t *s, int index, uint16_t val)
+{
+    val &= 0x777;
+    s->palette_end[index] = val;
+
+    if (s->res == SHIFTER_RES_HIGH && index != 0) {
+        // Not shown in monochrome: keep it for a later colour mode, but
+        // out of the log so the line stays on the fast path
+        s->palette[index] = val;
+        return;
+    }
+
+    if (!s->config.get_cycle) {
+        // No clock: nothing to time the write against
+        s->palette[index] = val;
+        shifter_set_rgb(s, index);
+        s->lut.pair_dirty = true;
+        return;
+    }
+
+    if (s->log_count == SHIFTER_LOG_MAX) {
+        // Fold the oldest write into the start-of-line palette. Exact for
+        // writes made in the blanking area, which is where bulk palette
+        // loads happen.
+        s->palette[s->log[0].index] = s->log[0].value;
+        shifter_set_rgb(s, s->log[0].index);
+        s->lut.pair_dirty = true;
+        memmove(&s->log[0], &s->log[1], (SHIFTER_LOG_MAX - 1) * sizeof(s->log[0]));
+        s->log_count--;
+        s->stats.log_overflows++;
+    }
+    s->log[s->log_count++] = (shifter_write_t) {
+        .cycle = shifter_now(s),
+        .index = (uint8_t)index,
+        .value = val,
+    };
+}
+
+void shifter_write_reg(shifter_t *s, uint32_t addr, uint16_t val)
+{
+    addr &= 0xFFFFFF;
+    if (addr >= SHIFTER_REG_PALETTE && addr < SHIFTER_REG_PALETTE + 32) {
+        shifter_write_palette(s, (addr - SHIFTER_REG_PALETTE) >> 1, val);
+        return;
+    }
+
+    // Byte registers take their value in bits 0-7
+    switch (addr) {
+    case SHIFTER_REG_BASE_HI:
+        s->base = (s->base & 0x00FF00) | ((uint32_t)(val & 0x3F) << 16);
+        break;
+    case SHIFTER_REG_BASE_MID:
+        s->base = (s->base & 0x3F0000) | ((uint32_t)(val & 0xFF) << 8);
+        break;
+    case SHIFTER_REG_SYNC:
+        s->sync = (uint8_t)(val & 0x03);
+        break;
+    case SHIFTER_REG_RES:
+        if ((val & 3) != 3 && (val & 3) != s->res) {
+            s->res = (uint8_t)(val & 3);
+            shifter_rebuild_rgb(s);
+            s->force_frame = true;
+            s->force_next = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+uint16_t shifter_read_reg(shifter_t *s, uint32_t addr)
+{
+    addr &= 0xFFFFFF;
+    if (addr >= SHIFTER_REG_PALETTE && addr < SHIFTER_REG_PALETTE + 32) {
+        return s->palette_end[(addr - SHIFTER_REG_PALETTE) >> 1];
+    }
+
+    switch (addr) {
+    case SHIFTER_REG_BASE_HI:   return (s->base >> 16) & 0xFF;
+    case SHIFTER_REG_BASE_MID:  return (s->base >> 8) & 0xFF;
+    case SHIFTER_REG_COUNT_HI:  return (s->counter >> 16) & 0xFF;
+    case SHIFTER_REG_COUNT_MID: return (s->counter >> 8) & 0xFF;
+    case SHIFTER_REG_COUNT_LO:  return s->counter & 0xFF;
+    case SHIFTER_REG_SYNC:      return s->sync;
+    case SHIFTER_REG_RES:       return s->res;
+    default:                    return 0xFFFF;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Rendering
+// ---------------------------------------------------------------------------
+
+static void shifter_line_fast(shifter_t *s, uint16_t *out, int groups)
+{
+    if (s->lut.pair_dirty) {
+        c2p_lut_update(&s->lut);
+        s->stats.pair_rebuilds++;
+    }
+    s->convert(s->fetch, out, groups, &s->lut);
+    s->stats.fast_lines++;
+}
+
+/** @p line_rgb, if not NULL, receives the palette at the first pixel */
+static void shifter_line_split(shifter_t *s, uint16_t *out, int planes, int groups,
+                               uint16_t *line_rgb)
+{
+    uint8_t index[SHIFTER_MAX_WIDTH];
+    int width = groups * 16;
+    int ppc = s->res == SHIFTER_RES_LOW ? 1 : s->res == SHIFTER_RES_MEDIUM ? 2 : 4;
+    uint64_t de_start = s->line_start + (uint64_t)shifter_de_start(s);
+    int x = 0;
+
+    c2p_to_index(s->fetch, index, groups, planes);
+
+    for (int i = 0; i <= s->log_count; i++) {
+        int end = width;
+        if (i < s->log_count) {
+            const shifter_write_t *wr = &s->log[i];
+            int64_t px = wr->cycle <= de_start ? 0 : (int64_t)(wr->cycle - de_start) * ppc;
+            end = px > width ? width : (int)px;
+        }
+        if (x == 0 && end > 0 && line_rgb) {
+            memcpy(line_rgb, s->lut.rgb, 16 * sizeof(uint16_t));
+        }
+        for (; x < end; x++) {
+            out[x] = s->lut.rgb[index[x]];
+        }
+        if (i < s->log_count) {
+            s->palette[s->log[i].index] = s->log[i].value;
+            shifter_set_rgb(s, s->log[i].index);
+        }
+    }
+
+    s->log_count = 0;
+    s->lut.pair_dirty = true;
+    s->stats.split_lines++;
+}
+
+void shifter_mark_written(shifter_t *s, uint32_t addr, uint32_t len)
+{
+    uint32_t line_bytes = (uint32_t)(shifter_width(s) / 16 * shifter_planes(s) * 2);
+    uint32_t screen = line_bytes * (s->res == SHIFTER_RES_HIGH ? 400 : 200);
+    uint32_t start = addr & SHIFTER_ADDR_MASK;
+
+    if (len == 0 || start + len <= s->base || start >= s->base + screen) {
+        return;
+    }
+    uint32_t first = start > s->base ? (start - s->base) / line_bytes : 0;
+    uint32_t last = (start + len - 1 - s->base) / line_bytes;
+    if (last >= VIDEO_MAX_LINES) {
+        last = VIDEO_MAX_LINES - 1;
+    }
+    for (uint32_t l = first; l <= last; l++) {
+        s->pending[l / 32] |= 1u << (l % 32);
+    }
+}
+
+void shifter_get_dirty(const shifter_t *s, uint32_t *bitmap)
+{
+    memcpy(bitmap, s->dirty, sizeof(s->dirty));
+}
+
+const uint16_t *shifter_get_line_palettes(const shifter_t *s)
+{
+    // Skipped lines keep last frame's entry, which they only skip if equal
+    return &s->line_rgb[0][0];
+}
+
+/**
+ * @brief Decide whether @p line changed since last frame and must be drawn
+ */
+static bool shifter_line_needs_draw(shifter_t *s, int line)
+{
+    uint32_t bit = 1u << (line % 32);
+    uint32_t *pending = &s->pending[line / 32];
+    uint32_t sig = shifter_palette_sig(s);
+    bool changed = s->force_frame || (*pending & bit) || s->log_count > 0 ||
+                   sig != s->line_sig[line];
+
+    if (changed) {
+        *pending &= ~bit;
+        s->dirty[line / 32] |= bit;
+        s->line_sig[line] = sig;
+        s->line_age[line] = 0;
+    } else if (s->line_age[line] < UINT8_MAX) {
+        s->line_age[line]++;
+    }
+    return s->config.buffer_count == 0 || s->line_age[line] < s->config.buffer_count;
+}
+
+void shifter_render_line(shifter_t *s, int line, uint16_t *out)
+{
+    int planes = shifter_planes(s);
+    int groups = shifter_width(s) / 16;
+    size_t words = (size_t)groups * (size_t)planes;
+    int line_cycles = shifter_line_cycles(s);
+
+    if (line == 0) {
+        s->counter = s->base;
+        if (s->config.get_cycle) {
+            // Called at the end of line 0
+            uint64_t now = shifter_now(s);
+            s->line_start = now > (uint64_t)line_cycles ? now - (uint64_t)line_cycles : 0;
+        }
+        memset(s->dirty, 0, sizeof(s->dirty));
+        s->force_frame = s->force_next || s->base != s->frame_base;
+        s->force_next = false;
+        s->frame_base = s->base;
+    }
+
+    bool in_frame = line >= 0 && line < VIDEO_MAX_LINES;
+    bool draw = !in_frame || shifter_line_needs_draw(s, line);
+    if (draw) {
+        uint16_t *line_rgb = in_frame ? s->line_rgb[line] : NULL;
+        if (!s->config.fetch || s->config.fetch(s->counter, s->fetch, words) != 0) {
+            memset(s->fetch, 0, words * sizeof(s->fetch[0]));
+        }
+        if (s->log_count == 0) {
+            if (line_rgb) {
+                memcpy(line_rgb, s->lut.rgb, 16 * sizeof(uint16_t));
+            }
+            shifter_line_fast(s, out, groups);
+        } else {
+            shifter_line_split(s, out, planes, groups, line_rgb);
+        }
+    } else {
+        s->stats.skipped_lines++;
+    }
+    s->counter = (s->counter + (uint32_t)words * 2) & SHIFTER_ADDR_MASK;
+
+    s->line_start += (uint64_t)line_cycles;
+    s->vpos = line + 1;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file shifter.h
+ * @brief Atari ST Shifter, scanline renderer
+ *
+ * The Shifter is not stepped with the CPU. Palette writes are logged with
+ * the CPU cycle they happened on, and each line is rendered once, at the
+ * end of its HBL, by replaying the log: the line is drawn in segments, and
+ * each logged write takes effect at the pixel the beam had reached. Raster
+ * bars and split palettes come out right without rendering per CPU slice.
+ *
+ * In monochrome only colour 0 is shown, so writes to colours 1-15 are
+ * stored without being logged.
+ *
+ * Lines without palette writes, the vast majority, take the fast path: the
+ * esptari_video c2p kernel for the resolution, two pixels per lookup
+ * through a table of RGB565 pairs that is only rebuilt after the palette
+ * changed.
+ *
+ * Resolution, sync and video base writes apply from the next line. Border
+ * tricks (sync/resolution switching mid-line) are not emulated.
+ *
+ * Each line also remembers whether it changed since the previous frame:
+ * RAM writes inside the screen (shifter_mark_written()), palette writes
+ * during the line, a different palette at line start than last frame, or
+ * a new resolution or video base. With config.buffer_count set, clean
+ * lines are neither fetched nor converted once every output buffer holds
+ * them, and the per-frame dirty bitmap tells the streaming layer which
+ * rows to send.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "component_api.h"
+#include "esptari_c2p.h"
+
+// Register addresses (IMPLEMENTATION_PLAN.md, Phase 2 memory map)
+#define SHIFTER_REG_BASE_HI     0xFF8201
+#define SHIFTER_REG_BASE_MID    0xFF8203
+#define SHIFTER_REG_COUNT_HI    0xFF8205
+#define SHIFTER_REG_COUNT_MID   0xFF8207
+#define SHIFTER_REG_COUNT_LO    0xFF8209
+#define SHIFTER_REG_SYNC        0xFF820A
+#define SHIFTER_REG_PALETTE     0xFF8240
+#define SHIFTER_REG_RES         0xFF8260
+
+#define SHIFTER_RES_LOW         0       ///< 320x200, 4 planes
+#define SHIFTER_RES_MEDIUM      1       ///< 640x200, 2 planes
+#define SHIFTER_RES_HIGH        2       ///< 640x400, 1 plane, 71 Hz
+
+#define SHIFTER_SYNC_50HZ       0x02
+
+#define SHIFTER_MAX_WIDTH       640
+#define SHIFTER_LINE_BYTES      160     ///< Low and medium; high uses 80
+#define SHIFTER_LOG_MAX         64      ///< Palette writes per line
+
+/**
+ * @brief One logged palette write
+ */
+typedef struct {
+    uint64_t cycle;
+    uint8_t index;              ///< Palette entry 0-15
+    uint16_t value;
+} shifter_write_t;
+
+typedef struct {
+    uint64_t fast_lines;        ///< Lines rendered through the pair table
+    uint64_t split_lines;       ///< Lines rendered in segments from the log
+    uint64_t pair_rebuilds;
+    uint64_t log_overflows;     ///< Writes past SHIFTER_LOG_MAX, applied at line end
+    uint64_t skipped_lines;     ///< Clean lines already in every output buffer
+} shifter_stats_t;
+
+typedef struct {
+    video_config_t config;
+
+    uint16_t palette[16];       ///< At the start of the line being drawn
+    uint16_t palette_end[16];   ///< After every write so far
+    uint8_t res;
+    uint8_t sync;
+    uint32_t base;              ///< Video base, reloaded into counter at line 0
+    uint32_t counter;           ///< Video address counter
+
+    uint64_t line_start;        ///< CPU cycle the current line began
+    int vpos;                   ///< Next line to render
+
+    shifter_write_t log[SHIFTER_LOG_MAX];
+    int log_count;
+
+    c2p_lut_t lut;              ///< RGB565 of palette[] and its pair table
+    c2p_line_fn convert;        ///< Planar to RGB565 kernel for res
+
+    uint16_t fetch[SHIFTER_LINE_BYTES / 2];
+
+    uint32_t pending[VIDEO_DIRTY_WORDS];    ///< Lines written since last drawn
+    uint32_t dirty[VIDEO_DIRTY_WORDS];      ///< Lines changed in this frame
+    uint32_t line_sig[VIDEO_MAX_LINES];     ///< Palette signature at line start, last frame
+    uint8_t line_age[VIDEO_MAX_LINES];      ///< Frames since the line last changed
+    uint32_t pal_sig;
+    bool pal_sig_dirty;
+    bool force_frame;           ///< Every line of this frame is dirty
+    bool force_next;            ///< ... and of the next one
+    uint32_t frame_base;        ///< Video base of the previous frame
+    uint16_t line_rgb[VIDEO_MAX_LINES][16]; ///< RGB565 palette at each line's first pixel
+
+    shifter_stats_t stats;
+} shifter_t;
+
+void shifter_init(shifter_t *s, const video_config_t *config);
+void shifter_reset(shifter_t *s);
+
+uint16_t shifter_read_reg(shifter_t *s, uint32_t addr);
+void shifter_write_reg(shifter_t *s, uint32_t addr, uint16_t val);
+
+/**
+ * @brief Render visible line @p line as RGB565 into @p out
+ *
+ * Call at the end of the line's HBL. Consumes the palette log.
+ */
+void shifter_render_line(shifter_t *s, int line, uint16_t *out);
+
+/**
+ * @brief Note a RAM write; lines of the screen it touches become dirty
+ */
+void shifter_mark_written(shifter_t *s, uint32_t addr, uint32_t len);
+
+/** Dirty bitmap of the lines rendered since line 0 */
+void shifter_get_dirty(const shifter_t *s, uint32_t *bitmap);
+
+/** line_rgb[] as VIDEO_MAX_LINES x 16 RGB565 */
+const uint16_t *shifter_get_line_palettes(const shifter_t *s);
+
+void shifter_get_mode(const shifter_t *s, video_mode_t *mode);
+
+/** CPU cycles per line in the current mode */
+int shifter_line_cycles(const shifter_t *s);
+
+/** Cycle within the line at which the display window opens */
+int shifter_de_start(const shifter_t *s);
+
+/** ST palette word ($0RGB, 3 bits each) to RGB565 */
+uint16_t shifter_st_to_rgb565(uint16_t color);
@@ -0,0 +1,162 @@
+/**
+ * @file shifter_entry.c
+ * @brief video_interface_t adapter for the ST Shifter
+ *
+ * As with the CPU components, the interface has no context argument, so
+ * the single Shifter instance lives here. Its palettes, the pair table and
+ * the per-line RGB565 palettes are read for every pixel, so when the
+ * firmware offers placed storage (video_config_t::alloc_hot) the whole
+ * state moves there as "palette_lut" instead of staying in this
+ * component's PSRAM .bss.
+ */
+
+#include <stddef.h>
+#include "shifter.h"
+
+static shifter_t s_shifter_static;
+static shifter_t *s_shifter = &s_shifter_static;
+static component_free_hot_fn s_free_hot;
+
+static void shifter_release_hot(void)
+{
+    if (s_shifter != &s_shifter_static && s_free_hot) {
+        s_free_hot("palette_lut");
+    }
+    s_shifter = &s_shifter_static;
+    s_free_hot = NULL;
+}
+
+static int shifter_if_init(void *config)
+{
+    const video_config_t *cfg = config;
+
+    shifter_release_hot();
+    if (cfg && cfg->alloc_hot) {
+        shifter_t *placed = cfg->alloc_hot("palette_lut", sizeof(shifter_t));
+        if (placed) {
+            s_shifter = placed;
+            s_free_hot = cfg->free_hot;
+        }
+    }
+    shifter_init(s_shifter, cfg);
+    return 0;
+}
+
+static void shifter_if_reset(void)
+{
+    shifter_reset(s_shifter);
+}
+
+static void shifter_if_shutdown(void)
+{
+    shifter_release_hot();
+}
+
+static void shifter_if_render_scanline(int line, uint8_t *buffer)
+{
+    shifter_render_line(s_shifter, line, (uint16_t *)buffer);
+}
+
+static void shifter_if_render_frame(uint8_t *framebuffer)
+{
+    video_mode_t mode;
+
+    shifter_get_mode(s_shifter, &mode);
+    for (int line = 0; line < mode.height; line++) {
+        shifter_render_line(s_shifter, line,
+                            (uint16_t *)framebuffer + (size_t)line * mode.width);
+    }
+}
+
+static int shifter_if_get_hpos(void)
+{
+    uint64_t now;
+
+    if (!s_shifter->config.get_cycle) {
+        return 0;
+    }
+    now = s_shifter->config.get_cycle(s_shifter->config.cycle_ctx);
+    return now > s_shifter->line_start ? (int)((now - s_shifter->line_start) %
+                                              (uint64_t)shifter_line_cycles(s_shifter)) : 0;
+}
+
+static int shifter_if_get_vpos(void)
+{
+    return s_shifter->vpos;
+}
+
+static bool shifter_if_in_vblank(void)
+{
+    video_mode_t mode;
+
+    shifter_get_mode(s_shifter, &mode);
+    return s_shifter->vpos >= mode.height;
+}
+
+static bool shifter_if_in_hblank(void)
+{
+    video_mode_t mode;
+    int ppc = s_shifter->res == SHIFTER_RES_LOW ? 1 : s_shifter->res == SHIFTER_RES_MEDIUM ? 2 : 4;
+    int x = (shifter_if_get_hpos() - shifter_de_start(s_shifter)) * ppc;
+
+    shifter_get_mode(s_shifter, &mode);
+    return x < 0 || x >= mode.width;
+}
+
+static uint16_t shifter_if_read_reg(uint32_t addr)
+{
+    return shifter_read_reg(s_shifter, addr);
+}
+
+static void shifter_if_write_reg(uint32_t addr, uint16_t val)
+{
+    shifter_write_reg(s_shifter, addr, val);
+}
+
+static void shifter_if_get_mode(video_mode_t *mode)
+{
+    shifter_get_mode(s_shifter, mode);
+}
+
+static void shifter_if_mark_written(uint32_t addr, uint32_t len)
+{
+    shifter_mark_written(s_shifter, addr, len);
+}
+
+static void shifter_if_get_dirty(uint32_t *bitmap)
+{
+    shifter_get_dirty(s_shifter, bitmap);
+}
+
+static const uint16_t *shifter_if_get_line_palettes(void)
+{
+    return shifter_get_line_palettes(s_shifter);
+}
+
+static const video_interface_t s_shifter_interface = {
+    .interface_version = VIDEO_INTERFACE_V1,
+    .name              = "ST Shifter",
+    .init              = shifter_if_init,
+    .reset             = shifter_if_reset,
+    .shutdown          = shifter_if_shutdown,
+    .render_scanline   = shifter_if_render_scanline,
+    .render_frame      = shifter_if_render_frame,
+    .get_hpos          = shifter_if_get_hpos,
+    .get_vpos          = shifter_if_get_vpos,
+    .in_vblank         = shifter_if_in_vblank,
+    .in_hblank         = shifter_if_in_hblank,
+    .read_reg          = shifter_if_read_reg,
+    .write_reg         = shifter_if_write_reg,
+    .get_mode          = shifter_if_get_mode,
+    .mark_written      = shifter_if_mark_written,
+    .get_dirty         = shifter_if_get_dirty,
+    .get_line_palettes = shifter_if_get_line_palettes,
+};
+
+/**
+ * @brief Component entry point (EBIN "Entry Offset")
+ */
+const video_interface_t *shifter_entry(void)
+{
+    return &s_shifter_interface;
+}
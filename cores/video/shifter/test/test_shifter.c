@@ -0,0 +1,411 @@
+/**
+ * @file test_shifter.c
+ * @brief ST Shifter unit tests
+ *
+ * Video RAM is a flat array of 68000 words; the cycle counter is a plain
+ * variable the tests move along the line by hand.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "shifter.h"
+
+#define TEST_VRAM_WORDS     0x8000
+#define TEST_LINE_CYCLES    512
+#define TEST_DE_START       56
+
+static uint16_t s_vram[TEST_VRAM_WORDS];
+static uint64_t s_cycle;
+static shifter_t s_sh;
+static uint16_t s_line[SHIFTER_MAX_WIDTH];
+
+static uint64_t test_get_cycle(void *ctx)
+{
+    return s_cycle;
+}
+
+static int test_fetch(uint32_t addr, uint16_t *dst, size_t words)
+{
+    memcpy(dst, &s_vram[(addr / 2) % TEST_VRAM_WORDS], words * sizeof(uint16_t));
+    return 0;
+}
+
+static void setup(bool clocked)
+{
+    video_config_t cfg = {
+        .clock_hz  = 8000000,
+        .get_cycle = clocked ? test_get_cycle : NULL,
+        .fetch     = test_fetch,
+    };
+
+    memset(s_vram, 0, sizeof(s_vram));
+    s_cycle = 0;
+    shifter_init(&s_sh, &cfg);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/** Low-res line where pixel x has colour x & 15 */
+static void fill_ramp(uint32_t addr)
+{
+    for (int g = 0; g < 20; g++) {
+        for (int p = 0; p < 4; p++) {
+            uint16_t w = 0;
+            for (int x = 0; x < 16; x++) {
+                if ((x >> p) & 1) {
+                    w |= (uint16_t)(0x8000 >> x);
+                }
+            }
+            s_vram[addr / 2 + g * 4 + p] = w;
+        }
+    }
+}
+
+static void set_palette_ramp(void)
+{
+    for (int i = 0; i < 16; i++) {
+        shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE + i * 2, (uint16_t)((i & 7) << 8 | (i >> 1)));
+    }
+}
+
+static void test_rgb565_conversion(void)
+{
+    TEST_ASSERT_EQUAL_HEX16(0x0000, shifter_st_to_rgb565(0x000));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, shifter_st_to_rgb565(0x777));
+    TEST_ASSERT_EQUAL_HEX16(0xF800, shifter_st_to_rgb565(0x700));
+    TEST_ASSERT_EQUAL_HEX16(0x001F, shifter_st_to_rgb565(0x007));
+}
+
+static void test_low_res_planar_decode(void)
+{
+    setup(false);
+    fill_ramp(0);
+    set_palette_ramp();
+
+    shifter_render_line(&s_sh, 0, s_line);
+    for (int x = 0; x < 320; x++) {
+        uint16_t want = shifter_st_to_rgb565(s_sh.palette[x & 15]);
+        TEST_ASSERT_EQUAL_HEX16(want, s_line[x]);
+    }
+    TEST_ASSERT_EQUAL(1, s_sh.stats.fast_lines);
+}
+
+static void test_video_counter_advances(void)
+{
+    setup(false);
+    shifter_write_reg(&s_sh, SHIFTER_REG_BASE_HI, 0x01);
+    shifter_write_reg(&s_sh, SHIFTER_REG_BASE_MID, 0x80);
+    shifter_render_line(&s_sh, 0, s_line);
+    shifter_render_line(&s_sh, 1, s_line);
+    TEST_ASSERT_EQUAL_HEX16(0x01, shifter_read_reg(&s_sh, SHIFTER_REG_COUNT_HI));
+    TEST_ASSERT_EQUAL_HEX16(0x81, shifter_read_reg(&s_sh, SHIFTER_REG_COUNT_MID));
+    TEST_ASSERT_EQUAL_HEX16(0x40, shifter_read_reg(&s_sh, SHIFTER_REG_COUNT_LO));
+}
+
+static void test_mid_line_palette_split(void)
+{
+    setup(true);
+    // Colour 0 everywhere, black; turned red 100 pixels into line 0
+    s_cycle = TEST_DE_START + 100;
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE, 0x700);
+    s_cycle = TEST_LINE_CYCLES;
+    shifter_render_line(&s_sh, 0, s_line);
+
+    TEST_ASSERT_EQUAL_HEX16(0x0000, s_line[99]);
+    TEST_ASSERT_EQUAL_HEX16(0xF800, s_line[100]);
+    TEST_ASSERT_EQUAL_HEX16(0xF800, s_line[319]);
+    TEST_ASSERT_EQUAL(1, s_sh.stats.split_lines);
+
+    // Next line has no writes: fast path, red from the first pixel
+    s_cycle += TEST_LINE_CYCLES;
+    shifter_render_line(&s_sh, 1, s_line);
+    TEST_ASSERT_EQUAL_HEX16(0xF800, s_line[0]);
+    TEST_ASSERT_EQUAL(1, s_sh.stats.fast_lines);
+}
+
+static void test_raster_bars(void)
+{
+    setup(true);
+    // One colour per line, written in the left border of each line
+    for (int line = 0; line < 8; line++) {
+        s_cycle = (uint64_t)line * TEST_LINE_CYCLES + 8;
+        shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE, (uint16_t)line);
+        s_cycle = (uint64_t)(line + 1) * TEST_LINE_CYCLES;
+        shifter_render_line(&s_sh, line, s_line);
+        TEST_ASSERT_EQUAL_HEX16(shifter_st_to_rgb565((uint16_t)line), s_line[0]);
+        TEST_ASSERT_EQUAL_HEX16(shifter_st_to_rgb565((uint16_t)line), s_line[319]);
+    }
+    TEST_ASSERT_EQUAL(8, s_sh.stats.split_lines);
+
+    // Each line's palette is the one its first pixel was drawn with
+    const uint16_t *pal = shifter_get_line_palettes(&s_sh);
+    for (int line = 0; line < 8; line++) {
+        TEST_ASSERT_EQUAL_HEX16(shifter_st_to_rgb565((uint16_t)line), pal[line * 16]);
+    }
+}
+
+static void test_writes_in_blanking_apply_from_line_start(void)
+{
+    setup(true);
+    fill_ramp(0);
+    // Palette loaded during VBL, more writes than the log holds
+    s_cycle = 1000;
+    for (int n = 0; n < SHIFTER_LOG_MAX + 16; n++) {
+        shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE + (n & 15) * 2, (uint16_t)n);
+    }
+    s_cycle = 5000 + TEST_LINE_CYCLES;
+    shifter_render_line(&s_sh, 0, s_line);
+
+    for (int x = 0; x < 16; x++) {
+        uint16_t final = (uint16_t)((SHIFTER_LOG_MAX + x) & 0x777);
+        TEST_ASSERT_EQUAL_HEX16(shifter_st_to_rgb565(final), s_line[x]);
+    }
+    TEST_ASSERT_EQUAL(16, s_sh.stats.log_overflows);
+    TEST_ASSERT_EQUAL_HEX16((SHIFTER_LOG_MAX + 15) & 0x777, shifter_read_reg(&s_sh, SHIFTER_REG_PALETTE + 30));
+}
+
+static void test_medium_res(void)
+{
+    setup(false);
+    shifter_write_reg(&s_sh, SHIFTER_REG_RES, SHIFTER_RES_MEDIUM);
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE + 2, 0x070);
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE + 4, 0x007);
+    s_vram[0] = 0x8000;     // Plane 0, pixel 0 -> colour 1
+    s_vram[1] = 0x4000;     // Plane 1, pixel 1 -> colour 2
+    shifter_render_line(&s_sh, 0, s_line);
+
+    TEST_ASSERT_EQUAL_HEX16(0x07E0, s_line[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x001F, s_line[1]);
+    TEST_ASSERT_EQUAL_HEX16(0x0000, s_line[2]);
+}
+
+static void test_mono_inversion(void)
+{
+    video_mode_t mode;
+
+    setup(false);
+    shifter_write_reg(&s_sh, SHIFTER_REG_RES, SHIFTER_RES_HIGH);
+    shifter_get_mode(&s_sh, &mode);
+    TEST_ASSERT_EQUAL(640, mode.width);
+    TEST_ASSERT_EQUAL(400, mode.height);
+    TEST_ASSERT_EQUAL(71, mode.refresh_hz);
+
+    s_vram[0] = 0x8000;
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE, 0x777);
+    shifter_render_line(&s_sh, 0, s_line);
+    TEST_ASSERT_EQUAL_HEX16(0x0000, s_line[0]);     // Black ink on white
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, s_line[1]);
+
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE, 0x000);
+    shifter_render_line(&s_sh, 0, s_line);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, s_line[0]);
+}
+
+static void test_mono_ignores_colour_entries(void)
+{
+    setup(true);
+    shifter_write_reg(&s_sh, SHIFTER_REG_RES, SHIFTER_RES_HIGH);
+    s_vram[0] = 0x8000;
+    shifter_render_line(&s_sh, 0, s_line);
+
+    // Mid-line writes to colours 1-15 change nothing in mono: fast path, line clean
+    s_cycle = 100;
+    for (int i = 1; i < 16; i++) {
+        shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE + i * 2, 0x700);
+    }
+    s_cycle = 224 * 2;
+    shifter_render_line(&s_sh, 1, s_line);
+    TEST_ASSERT_EQUAL(0, s_sh.stats.split_lines);
+    TEST_ASSERT_EQUAL(2, s_sh.stats.fast_lines);
+    TEST_ASSERT_EQUAL_HEX16(0x700, shifter_read_reg(&s_sh, SHIFTER_REG_PALETTE + 30));
+
+    // Colour 0 still splits the line
+    s_cycle += 100;
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE, 0x001);
+    s_cycle = 224 * 3;
+    shifter_render_line(&s_sh, 2, s_line);
+    TEST_ASSERT_EQUAL(1, s_sh.stats.split_lines);
+
+    // Back in colour, the entries written in mono are in place
+    shifter_write_reg(&s_sh, SHIFTER_REG_RES, SHIFTER_RES_LOW);
+    s_vram[0] = 0x8000;     // Pixel 0 -> colour 1
+    s_cycle += TEST_LINE_CYCLES;
+    shifter_render_line(&s_sh, 0, s_line);
+    TEST_ASSERT_EQUAL_HEX16(0xF800, s_line[0]);
+}
+
+static void test_pair_table_rebuilt_only_on_change(void)
+{
+    setup(false);
+    shifter_render_line(&s_sh, 0, s_line);
+    uint64_t rebuilds = s_sh.stats.pair_rebuilds;
+    for (int line = 1; line < 200; line++) {
+        shifter_render_line(&s_sh, line, s_line);
+    }
+    TEST_ASSERT_EQUAL(rebuilds, s_sh.stats.pair_rebuilds);
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE, 0x123);
+    shifter_render_line(&s_sh, 0, s_line);
+    TEST_ASSERT_EQUAL(rebuilds + 1, s_sh.stats.pair_rebuilds);
+}
+
+static void render_frame_lines(void)
+{
+    for (int line = 0; line < 200; line++) {
+        shifter_render_line(&s_sh, line, s_line);
+    }
+}
+
+static int dirty_count(void)
+{
+    uint32_t bitmap[VIDEO_DIRTY_WORDS];
+    int n = 0;
+
+    shifter_get_dirty(&s_sh, bitmap);
+    for (int i = 0; i < VIDEO_MAX_LINES; i++) {
+        n += (bitmap[i / 32] >> (i % 32)) & 1;
+    }
+    return n;
+}
+
+static void setup_double_buffered(void)
+{
+    video_config_t cfg = { .fetch = test_fetch, .buffer_count = 2 };
+
+    memset(s_vram, 0, sizeof(s_vram));
+    shifter_init(&s_sh, &cfg);
+}
+
+static void test_clean_lines_skipped_once_in_every_buffer(void)
+{
+    setup_double_buffered();
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(200, dirty_count());
+    // Second buffer still needs the lines, though nothing changed
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(0, dirty_count());
+    TEST_ASSERT_EQUAL(0, s_sh.stats.skipped_lines);
+
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(0, dirty_count());
+    TEST_ASSERT_EQUAL(200, s_sh.stats.skipped_lines);
+}
+
+static void test_screen_write_dirties_its_line(void)
+{
+    uint32_t bitmap[VIDEO_DIRTY_WORDS];
+
+    setup_double_buffered();
+    shifter_write_reg(&s_sh, SHIFTER_REG_BASE_MID, 0x80);   // $8000
+    for (int f = 0; f < 3; f++) {
+        render_frame_lines();
+    }
+    uint64_t fast = s_sh.stats.fast_lines;
+
+    shifter_mark_written(&s_sh, 0x8000 + 5 * 160 + 10, 2);
+    shifter_mark_written(&s_sh, 0x7FFE, 2);                 // Below the screen
+    shifter_mark_written(&s_sh, 0x8000 + 200 * 160, 4);     // Above it
+    render_frame_lines();
+
+    shifter_get_dirty(&s_sh, bitmap);
+    TEST_ASSERT_EQUAL_HEX32(1u << 5, bitmap[0]);
+    TEST_ASSERT_EQUAL(1, dirty_count());
+    TEST_ASSERT_EQUAL(fast + 1, s_sh.stats.fast_lines);
+
+    // Drawn once more for the other buffer, then skipped again
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(fast + 2, s_sh.stats.fast_lines);
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(fast + 2, s_sh.stats.fast_lines);
+}
+
+static void test_palette_and_base_changes_dirty_the_frame(void)
+{
+    setup_double_buffered();
+    for (int f = 0; f < 3; f++) {
+        render_frame_lines();
+    }
+    shifter_write_reg(&s_sh, SHIFTER_REG_PALETTE + 6, 0x123);
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(200, dirty_count());
+
+    render_frame_lines();
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(0, dirty_count());
+    shifter_write_reg(&s_sh, SHIFTER_REG_BASE_HI, 0x01);
+    render_frame_lines();
+    TEST_ASSERT_EQUAL(200, dirty_count());
+}
+
+const video_interface_t *shifter_entry(void);
+
+static void *s_hot;
+
+static void *test_alloc_hot(const char *item, size_t size)
+{
+    TEST_ASSERT_EQUAL_STRING("palette_lut", item);
+    TEST_ASSERT_NULL(s_hot);
+    s_hot = malloc(size);
+    return s_hot;
+}
+
+static void test_free_hot(const char *item)
+{
+    TEST_ASSERT_EQUAL_STRING("palette_lut", item);
+    free(s_hot);
+    s_hot = NULL;
+}
+
+static void test_component_state_in_placed_storage(void)
+{
+    const video_interface_t *vi = shifter_entry();
+    video_config_t cfg = {
+        .fetch = test_fetch,
+        .alloc_hot = test_alloc_hot,
+        .free_hot = test_free_hot,
+    };
+    uint16_t line[SHIFTER_MAX_WIDTH];
+
+    memset(s_vram, 0, sizeof(s_vram));
+    fill_ramp(0);
+    TEST_ASSERT_EQUAL(0, vi->init(&cfg));
+    TEST_ASSERT_NOT_NULL(s_hot);
+    vi->write_reg(SHIFTER_REG_PALETTE + 5 * 2, 0x777);
+    TEST_ASSERT_EQUAL_HEX16(0x777, vi->read_reg(SHIFTER_REG_PALETTE + 5 * 2) & 0x777);
+    TEST_ASSERT_EQUAL_HEX16(0x777, ((shifter_t *)s_hot)->palette_end[5]);
+    vi->render_scanline(0, (uint8_t *)line);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, line[5]);
+
+    vi->shutdown();
+    TEST_ASSERT_NULL(s_hot);
+    // Without the callbacks it runs from its own copy
+    TEST_ASSERT_EQUAL(0, vi->init(NULL));
+    TEST_ASSERT_NULL(s_hot);
+    vi->shutdown();
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rgb565_conversion);
+    RUN_TEST(test_low_res_planar_decode);
+    RUN_TEST(test_video_counter_advances);
+    RUN_TEST(test_mid_line_palette_split);
+    RUN_TEST(test_raster_bars);
+    RUN_TEST(test_writes_in_blanking_apply_from_line_start);
+    RUN_TEST(test_medium_res);
+    RUN_TEST(test_mono_inversion);
+    RUN_TEST(test_mono_ignores_colour_entries);
+    RUN_TEST(test_pair_table_rebuilt_only_on_change);
+    RUN_TEST(test_clean_lines_skipped_once_in_every_buffer);
+    RUN_TEST(test_screen_write_dirties_its_line);
+    RUN_TEST(test_palette_and_base_changes_dirty_the_frame);
+    RUN_TEST(test_component_state_in_placed_storage);
+    return UNITY_END();
+}
@@ -0,0 +1,204 @@
+/**
+ * @file audio_codec_bench.c
+ * @brief Host benchmark of the /ws/stream audio encoders
+ *
+ * Encodes the same seconds of 48 kHz stereo with every codec built in, at
+ * each frame length, through ws_audio_encode_msg() in 20 ms messages as
+ * the sender task does. Reports host time per second of audio, the share
+ * of a 400 MHz core that makes when scaled by clock, the compression
+ * against PCM and, for ADPCM, the SNR after decoding.
+ *
+ * Opus is only measured when the bench was configured with libopus found.
+ *
+ * Usage: audio_codec_bench [host_mhz] [seconds]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ws_audio_codec.h"
+
+#define BENCH_RATE          48000
+#define BENCH_MSG_MS        20
+#define BENCH_MSG_SAMPLES   (BENCH_RATE * BENCH_MSG_MS / 1000)
+#define BENCH_P4_CLOCK_MHZ  400.0
+#define BENCH_PASSES        3           /**< Best of, to ride out host noise */
+
+typedef struct {
+    ws_audio_codec_t codec;
+    uint32_t frame_us;
+} bench_case_t;
+
+static int16_t *s_in;
+static int16_t *s_out;
+static uint8_t s_msg[sizeof(ws_mux_audio_header_t) + BENCH_MSG_SAMPLES * 4];
+static uint8_t s_coded[16384];
+
+/** Host clock from /proc/cpuinfo, 0 if unknown */
+static double bench_host_mhz(void)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0.0;
+
+    if (!f) {
+        return 0.0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "cpu MHz", 7) == 0) {
+            const char *colon = strchr(line, ':');
+            if (colon) {
+                mhz = atof(colon + 1);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    return mhz;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/** Decode an ADPCM message into s_out at @p at */
+static void bench_decode(const uint8_t *msg, uint32_t at)
+{
+    ws_audio_coded_header_t header;
+    uint32_t pos = sizeof(header);
+
+    memcpy(&header, msg, sizeof(header));
+    for (uint32_t i = 0; i < header.frame_count; i++) {
+        uint16_t len;
+
+        memcpy(&len, msg + pos, sizeof(len));
+        ws_audio_adpcm_decode(msg + pos + sizeof(len), len, 2, header.frame_samples,
+                              s_out + 2 * (at + i * header.frame_samples));
+        pos += sizeof(len) + len;
+    }
+}
+
+static double bench_snr_db(uint32_t samples)
+{
+    double signal = 0, noise = 0;
+
+    for (uint32_t i = 0; i < samples * 2; i++) {
+        double d = (double)s_in[i] - s_out[i];
+
+        signal += (double)s_in[i] * s_in[i];
+        noise += d * d;
+    }
+    return 10 * log10(signal / (noise + 1e-9));
+}
+
+/** Seconds of host time to encode @p samples, best of BENCH_PASSES */
+static double bench_run(const bench_case_t *c, uint32_t samples, ws_audio_encoder_stats_t *stats)
+{
+    ws_audio_encoder_config_t config = {
+        .codec = c->codec,
+        .sample_rate = BENCH_RATE,
+        .channels = 2,
+        .frame_us = c->frame_us,
+        .opus_bitrate = 128000,
+        .opus_complexity = 5,
+    };
+    ws_audio_encoder_t *enc = malloc(sizeof(*enc));
+    double best = 1e9;
+
+    for (int pass = 0; pass < BENCH_PASSES && enc; pass++) {
+        if (ws_audio_encoder_init(enc, &config) != ESP_OK) {
+            break;
+        }
+
+        double start = bench_now();
+        for (uint32_t at = 0; at + BENCH_MSG_SAMPLES <= samples; at += BENCH_MSG_SAMPLES) {
+            ws_mux_audio_header_t header = {
+                .type = WS_MUX_MSG_AUDIO,
+                .timestamp = (uint32_t)((uint64_t)at * 1000 / BENCH_RATE),
+                .sample_count = BENCH_MSG_SAMPLES,
+            };
+            uint32_t coded;
+
+            memcpy(s_msg, &header, sizeof(header));
+            memcpy(s_msg + sizeof(header), s_in + 2 * at, BENCH_MSG_SAMPLES * 4);
+            coded = ws_audio_encode_msg(enc, s_msg, sizeof(s_msg), s_coded, sizeof(s_coded));
+            if (coded && c->codec == WS_AUDIO_CODEC_ADPCM && pass == 0) {
+                bench_decode(s_coded, at);
+            }
+        }
+        double elapsed = bench_now() - start;
+
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        *stats = enc->stats;
+        ws_audio_encoder_deinit(enc);
+    }
+    free(enc);
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t frame_us[] = { 2500, 5000, 10000 };
+    double host_mhz = argc > 1 ? atof(argv[1]) : bench_host_mhz();
+    int seconds = argc > 2 ? atoi(argv[2]) : 10;
+    uint32_t samples = (uint32_t)seconds * BENCH_RATE;
+
+    s_in = malloc(samples * 4);
+    s_out = calloc(samples, 4);
+    if (!s_in || !s_out || seconds <= 0) {
+        return 1;
+    }
+    // Music-like material: chords, a sweep and a little noise
+    srand(1);
+    for (uint32_t i = 0; i < samples; i++) {
+        double t = (double)i / BENCH_RATE;
+        double l = 7000 * sin(2 * M_PI * 220 * t) + 4000 * sin(2 * M_PI * 277.2 * t)
+                   + 2500 * sin(2 * M_PI * 3300 * t);
+        double r = 6000 * sin(2 * M_PI * 330 * t) + 5000 * sin(2 * M_PI * (100 + 400 * fmod(t, 5.0)) * t);
+
+        s_in[2 * i] = (int16_t)lrint(l + (rand() % 601 - 300));
+        s_in[2 * i + 1] = (int16_t)lrint(r + (rand() % 601 - 300));
+    }
+
+    printf("audio_codec_bench: %d s of 48 kHz stereo in %d ms messages (best of %d)",
+           seconds, BENCH_MSG_MS, BENCH_PASSES);
+    if (host_mhz > 0.0) {
+        printf(", host %.0f MHz\n", host_mhz);
+    } else {
+        printf(", host clock unknown (pass it as the first argument)\n");
+    }
+
+    for (int codec = WS_AUDIO_CODEC_ADPCM; codec < WS_AUDIO_CODEC_COUNT; codec++) {
+        if (!(ws_audio_codec_available() & WS_AUDIO_CODEC_BIT(codec))) {
+            printf("  %-6s not built in\n", ws_audio_codec_name((ws_audio_codec_t)codec));
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(frame_us) / sizeof(frame_us[0]); i++) {
+            bench_case_t c = { (ws_audio_codec_t)codec, frame_us[i] };
+            ws_audio_encoder_stats_t stats = { 0 };
+            double s_per_s = bench_run(&c, samples, &stats) / seconds;
+
+            printf("  %-6s %4.1f ms %8.1f us/s, ratio %.2f:1, %6.1f kbit/s",
+                   ws_audio_codec_name(c.codec), frame_us[i] / 1000.0, s_per_s * 1e6,
+                   stats.coded_bytes ? (double)stats.pcm_bytes / stats.coded_bytes : 0.0,
+                   stats.coded_bytes * 8.0 / seconds / 1000);
+            if (c.codec == WS_AUDIO_CODEC_ADPCM) {
+                printf(", SNR %.1f dB", bench_snr_db(samples));
+            }
+            if (host_mhz > 0.0) {
+                printf(", %.2f%% of %.0f MHz", s_per_s * host_mhz / BENCH_P4_CLOCK_MHZ * 100, BENCH_P4_CLOCK_MHZ);
+            }
+            printf("\n");
+        }
+    }
+    free(s_in);
+    free(s_out);
+    return 0;
+}
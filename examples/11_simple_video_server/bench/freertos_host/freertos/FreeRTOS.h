@@ -0,0 +1,73 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Just enough of FreeRTOS on pthreads to run the stream pipeline on a host
+ *
+ * Ticks are milliseconds. Only what frame_ring.c and frame_pipeline.c use.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define portMAX_DELAY       0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+/** Absolute CLOCK_MONOTONIC deadline @p ticks from now */
+static inline struct timespec host_deadline(TickType_t ticks)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static inline void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**
+ * @brief Wait on @p cond until @p ready() or @p ticks pass, with @p mutex held
+ *
+ * @return Whether @p ready() became true
+ */
+static inline int host_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t ticks,
+                            int (*ready)(void *), void *arg)
+{
+    struct timespec deadline = host_deadline(ticks);
+
+    while (!ready(arg)) {
+        if (ticks == 0) {
+            return 0;
+        }
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, mutex);
+        } else if (pthread_cond_timedwait(cond, mutex, &deadline) == ETIMEDOUT) {
+            return ready(arg);
+        }
+    }
+    return 1;
+}
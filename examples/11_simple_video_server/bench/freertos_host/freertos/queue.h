@@ -0,0 +1,87 @@
+/**
+ * @file queue.h
+ * @brief Copying FIFO queues for the host FreeRTOS stand-in
+ */
+
+#pragma once
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+} *QueueHandle_t;
+
+static inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q));
+
+    if (q) {
+        q->items = calloc(length, item_size);
+        if (!q->items) {
+            free(q);
+            return NULL;
+        }
+        pthread_mutex_init(&q->mutex, NULL);
+        host_cond_init(&q->cond);
+        q->length = length;
+        q->item_size = item_size;
+    }
+    return q;
+}
+
+static inline void vQueueDelete(QueueHandle_t q)
+{
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->mutex);
+    free(q->items);
+    free(q);
+}
+
+static inline int host_queue_has_space(void *arg)
+{
+    QueueHandle_t q = arg;
+    return q->count < q->length;
+}
+
+static inline int host_queue_has_item(void *arg)
+{
+    return ((QueueHandle_t)arg)->count > 0;
+}
+
+static inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    BaseType_t ret = pdFAIL;
+
+    pthread_mutex_lock(&q->mutex);
+    if (host_wait(&q->cond, &q->mutex, ticks, host_queue_has_space, q)) {
+        memcpy(q->items + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_broadcast(&q->cond);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    BaseType_t ret = pdFAIL;
+
+    pthread_mutex_lock(&q->mutex);
+    if (host_wait(&q->cond, &q->mutex, ticks, host_queue_has_item, q)) {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->cond);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
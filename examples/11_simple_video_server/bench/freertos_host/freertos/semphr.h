@@ -0,0 +1,71 @@
+/**
+ * @file semphr.h
+ * @brief Counting semaphores for the host FreeRTOS stand-in; mutexes are count 1
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_sem {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+} *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t host_sem_create(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t sem = calloc(1, sizeof(*sem));
+
+    if (sem) {
+        pthread_mutex_init(&sem->mutex, NULL);
+        host_cond_init(&sem->cond);
+        sem->count = initial;
+        sem->max = max;
+    }
+    return sem;
+}
+
+#define xSemaphoreCreateBinary()                host_sem_create(1, 0)
+#define xSemaphoreCreateMutex()                 host_sem_create(1, 1)
+#define xSemaphoreCreateCounting(max, initial)  host_sem_create(max, initial)
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->mutex);
+    free(sem);
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    BaseType_t ret = pdFAIL;
+
+    pthread_mutex_lock(&sem->mutex);
+    if (sem->count < sem->max) {
+        sem->count++;
+        ret = pdPASS;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->mutex);
+    return ret;
+}
+
+static inline int host_sem_ready(void *arg)
+{
+    return ((SemaphoreHandle_t)arg)->count > 0;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    BaseType_t ret = pdFAIL;
+
+    pthread_mutex_lock(&sem->mutex);
+    if (host_wait(&sem->cond, &sem->mutex, ticks, host_sem_ready, sem)) {
+        sem->count--;
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&sem->mutex);
+    return ret;
+}
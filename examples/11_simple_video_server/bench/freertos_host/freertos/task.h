@@ -0,0 +1,61 @@
+/**
+ * @file task.h
+ * @brief Tasks as detached pthreads for the host FreeRTOS stand-in
+ *
+ * Priorities and stack sizes are ignored; vTaskDelete() only deletes the
+ * calling task.
+ */
+
+#pragma once
+
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef pthread_t TaskHandle_t;
+
+typedef struct host_task {
+    TaskFunction_t fn;
+    void *arg;
+} host_task_t;
+
+static inline void *host_task_main(void *arg)
+{
+    host_task_t task = *(host_task_t *)arg;
+
+    free(arg);
+    task.fn(task.arg);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_size,
+                                     void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+    pthread_t thread;
+    host_task_t *task = malloc(sizeof(*task));
+
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&thread, NULL, host_task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle) {
+        *handle = thread;
+    }
+    return pdPASS;
+}
+
+#define vTaskDelete(task)   pthread_exit(NULL)
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000u);
+}
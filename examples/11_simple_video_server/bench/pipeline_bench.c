@@ -0,0 +1,455 @@
+/**
+ * @file pipeline_bench.c
+ * @brief Host throughput benchmark of the stream pipeline
+ *
+ * Streams from a synthetic sensor to one client twice with the same
+ * encoder and link. First as the old stream handler did it, dequeue,
+ * encode, send, requeue in one loop. Then through frame_pipeline and
+ * frame_ring, where capture, encode and send overlap. Reports frames per
+ * second for both and the per-stage latency histograms of the pipeline.
+ *
+ * - sensor: BENCH_WIDTH x BENCH_HEIGHT RGB565 at a fixed frame rate into
+ *   BENCH_BUFFERS driver buffers (EXAMPLE_CAMERA_VIDEO_BUFFER_NUMBER);
+ *   a frame with no free buffer is lost, as with the V4L2 driver
+ * - encoder: the luma half of a baseline JPEG encoder in software, 8x8
+ *   DCT and quantisation, run encode_passes times to bring a host's speed
+ *   near the target's; the output is sized from the coefficients left
+ * - link: sending takes length / bandwidth
+ *
+ * Usage: pipeline_bench [seconds] [sensor_fps] [link_kbytes_per_s] [encode_passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "frame_pipeline.h"
+
+#define BENCH_WIDTH         640
+#define BENCH_HEIGHT        480
+#define BENCH_FRAME_SIZE    (BENCH_WIDTH * BENCH_HEIGHT * 2)
+#define BENCH_JPEG_SIZE     (BENCH_WIDTH * BENCH_HEIGHT)
+#define BENCH_BUFFERS       2           /**< EXAMPLE_CAMERA_VIDEO_BUFFER_NUMBER default */
+#define BENCH_RING          4           /**< EXAMPLE_STREAM_FRAME_BUFFER_NUMBER default */
+#define BENCH_QUALITY       80
+
+typedef enum {
+    BENCH_BUF_DRIVER,
+    BENCH_BUF_FILLED,
+    BENCH_BUF_USER,
+} bench_buf_state_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint8_t *data[BENCH_BUFFERS];
+    bench_buf_state_t state[BENCH_BUFFERS];
+    uint32_t seq[BENCH_BUFFERS];
+    uint32_t next_seq;
+    uint32_t overruns;          // Frames lost for want of a buffer
+    uint32_t period_us;
+    volatile bool running;
+} bench_sensor_t;
+
+static bench_sensor_t s_sensor;
+static float s_dct[8][8];
+static uint16_t s_quant[64];
+static uint32_t s_link_bytes_per_s;
+static int s_encode_passes;
+
+// ---------------------------------------------------------------------------
+// Sensor
+// ---------------------------------------------------------------------------
+
+/** Moving gradient with a noisy band, roughly camera-like in compressed size */
+static void bench_fill(uint8_t *data, uint32_t seq)
+{
+    uint16_t *px = (uint16_t *)data;
+    uint32_t noise = seq * 2654435761u;
+
+    for (int y = 0; y < BENCH_HEIGHT; y++) {
+        for (int x = 0; x < BENCH_WIDTH; x++) {
+            int v = (x + y + (int)seq * 4) & 0xFF;
+            if ((y / 32) % 8 == 0) {
+                noise = noise * 1664525u + 1013904223u;
+                v ^= (int)(noise >> 30);
+            }
+            px[y * BENCH_WIDTH + x] = (uint16_t)(((v >> 3) << 11) | ((v >> 2) << 5) | ((255 - v) >> 3));
+        }
+    }
+}
+
+static void *bench_sensor_main(void *arg)
+{
+    bench_sensor_t *sensor = arg;
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (sensor->running) {
+        next.tv_nsec += (long)sensor->period_us * 1000;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        int free_buf = -1;
+        pthread_mutex_lock(&sensor->mutex);
+        for (int i = 0; i < BENCH_BUFFERS; i++) {
+            if (sensor->state[i] == BENCH_BUF_DRIVER) {
+                free_buf = i;
+                break;
+            }
+        }
+        if (free_buf < 0) {
+            sensor->overruns++;
+        }
+        pthread_mutex_unlock(&sensor->mutex);
+        if (free_buf < 0) {
+            continue;
+        }
+
+        // Only this thread touches a buffer the driver holds
+        bench_fill(sensor->data[free_buf], sensor->next_seq);
+        pthread_mutex_lock(&sensor->mutex);
+        sensor->seq[free_buf] = sensor->next_seq++;
+        sensor->state[free_buf] = BENCH_BUF_FILLED;
+        pthread_cond_broadcast(&sensor->cond);
+        pthread_mutex_unlock(&sensor->mutex);
+    }
+    return NULL;
+}
+
+static int bench_oldest_filled(const bench_sensor_t *sensor)
+{
+    int found = -1;
+
+    for (int i = 0; i < BENCH_BUFFERS; i++) {
+        if (sensor->state[i] == BENCH_BUF_FILLED && (found < 0 || sensor->seq[i] < sensor->seq[found])) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+static esp_err_t bench_dequeue(void *ctx, TickType_t timeout, frame_pipeline_buf_t *buf)
+{
+    bench_sensor_t *sensor = ctx;
+    struct timespec deadline = host_deadline(timeout);
+    int i;
+
+    pthread_mutex_lock(&sensor->mutex);
+    while ((i = bench_oldest_filled(sensor)) < 0) {
+        if (pthread_cond_timedwait(&sensor->cond, &sensor->mutex, &deadline) != 0) {
+            pthread_mutex_unlock(&sensor->mutex);
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    sensor->state[i] = BENCH_BUF_USER;
+    pthread_mutex_unlock(&sensor->mutex);
+
+    buf->index = (uint32_t)i;
+    buf->data = sensor->data[i];
+    buf->size = BENCH_FRAME_SIZE;
+    return ESP_OK;
+}
+
+static void bench_requeue(void *ctx, const frame_pipeline_buf_t *buf)
+{
+    bench_sensor_t *sensor = ctx;
+
+    pthread_mutex_lock(&sensor->mutex);
+    sensor->state[buf->index] = BENCH_BUF_DRIVER;
+    pthread_mutex_unlock(&sensor->mutex);
+}
+
+// ---------------------------------------------------------------------------
+// Software encoder
+// ---------------------------------------------------------------------------
+
+static void bench_encoder_init(int quality)
+{
+    static const uint8_t luma[64] = {
+        16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+        14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+        49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+    };
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+    for (int i = 0; i < 64; i++) {
+        int q = (luma[i] * scale + 50) / 100;
+        s_quant[i] = (uint16_t)(q < 1 ? 1 : q);
+    }
+    for (int u = 0; u < 8; u++) {
+        for (int x = 0; x < 8; x++) {
+            s_dct[u][x] = (u ? 0.5f : 0.35355339f) * cosf((2 * x + 1) * u * 3.14159265f / 16);
+        }
+    }
+}
+
+/** One pass over the frame, @return the size the JPEG would have */
+static uint32_t bench_encode_pass(const uint16_t *px)
+{
+    uint32_t len = 623;     // Headers and tables
+
+    for (int by = 0; by < BENCH_HEIGHT; by += 8) {
+        for (int bx = 0; bx < BENCH_WIDTH; bx += 8) {
+            float block[8][8], rows[8][8];
+
+            for (int y = 0; y < 8; y++) {
+                for (int x = 0; x < 8; x++) {
+                    uint16_t p = px[(by + y) * BENCH_WIDTH + bx + x];
+                    block[y][x] = 0.299f * ((p >> 11) << 3) + 0.587f * (((p >> 5) & 0x3F) << 2) +
+                                  0.114f * ((p & 0x1F) << 3) - 128.0f;
+                }
+            }
+            for (int y = 0; y < 8; y++) {
+                for (int u = 0; u < 8; u++) {
+                    float sum = 0;
+                    for (int x = 0; x < 8; x++) {
+                        sum += s_dct[u][x] * block[y][x];
+                    }
+                    rows[y][u] = sum;
+                }
+            }
+            for (int v = 0; v < 8; v++) {
+                for (int u = 0; u < 8; u++) {
+                    float sum = 0;
+                    for (int y = 0; y < 8; y++) {
+                        sum += s_dct[v][y] * rows[y][u];
+                    }
+                    int q = (int)lrintf(sum / s_quant[v * 8 + u]);
+                    if (q) {
+                        // About what the Huffman coder spends on a non-zero coefficient
+                        len += q > 15 || q < -15 ? 3 : 2;
+                    }
+                }
+            }
+            len++;  // End of block
+        }
+    }
+    return len;
+}
+
+static esp_err_t bench_encode(void *ctx, const frame_pipeline_buf_t *buf, uint8_t *dst, uint32_t dst_size, uint32_t *dst_size_out)
+{
+    uint32_t len = 0;
+
+    for (int pass = 0; pass < s_encode_passes; pass++) {
+        len = bench_encode_pass((const uint16_t *)buf->data);
+    }
+    if (len > dst_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(dst, 0xA5, len);
+    *dst_size_out = len;
+    return ESP_OK;
+}
+
+static const frame_pipeline_ops_t s_bench_ops = {
+    .dequeue = bench_dequeue,
+    .requeue = bench_requeue,
+    .encode = bench_encode,
+};
+
+// ---------------------------------------------------------------------------
+// Link
+// ---------------------------------------------------------------------------
+
+static void bench_send(uint32_t len)
+{
+    usleep((useconds_t)((uint64_t)len * 1000000 / s_link_bytes_per_s));
+}
+
+// ---------------------------------------------------------------------------
+// Runs
+// ---------------------------------------------------------------------------
+
+static double bench_now(void)
+{
+    return frame_pipeline_now_us() * 1e-6;
+}
+
+static void bench_sensor_start(pthread_t *thread, int fps)
+{
+    pthread_mutex_lock(&s_sensor.mutex);
+    for (int i = 0; i < BENCH_BUFFERS; i++) {
+        s_sensor.state[i] = BENCH_BUF_DRIVER;
+    }
+    s_sensor.overruns = 0;
+    pthread_mutex_unlock(&s_sensor.mutex);
+
+    s_sensor.period_us = 1000000 / fps;
+    s_sensor.running = true;
+    pthread_create(thread, NULL, bench_sensor_main, &s_sensor);
+}
+
+static uint32_t bench_sensor_stop(pthread_t thread)
+{
+    s_sensor.running = false;
+    pthread_join(thread, NULL);
+    return s_sensor.overruns;
+}
+
+/** The pre-pipeline stream handler: one frame at a time, camera buffer held until sent */
+static double bench_sequential(double seconds, int fps, uint32_t *lost)
+{
+    static uint8_t jpeg[BENCH_JPEG_SIZE];
+    pthread_t sensor;
+    uint32_t frames = 0;
+
+    bench_sensor_start(&sensor, fps);
+    double start = bench_now();
+    while (bench_now() - start < seconds) {
+        frame_pipeline_buf_t buf;
+        uint32_t len;
+
+        if (bench_dequeue(&s_sensor, pdMS_TO_TICKS(100), &buf) != ESP_OK) {
+            continue;
+        }
+        if (bench_encode(NULL, &buf, jpeg, sizeof(jpeg), &len) == ESP_OK) {
+            bench_send(len);
+            frames++;
+        }
+        bench_requeue(&s_sensor, &buf);
+    }
+    double elapsed = bench_now() - start;
+    *lost = bench_sensor_stop(sensor);
+    return frames / elapsed;
+}
+
+typedef struct {
+    frame_ring_t *ring;
+    frame_pipeline_t *pipeline;
+    frame_ring_client_t *client;
+    volatile bool running;
+    uint32_t frames;
+} bench_client_t;
+
+static void *bench_client_main(void *arg)
+{
+    bench_client_t *bc = arg;
+
+    while (bc->running) {
+        const frame_ring_slot_t *slot;
+
+        if (frame_ring_read(bc->ring, bc->client, pdMS_TO_TICKS(100), &slot) != ESP_OK) {
+            continue;
+        }
+        int64_t start_us = frame_pipeline_now_us();
+        bench_send(slot->len);
+        frame_pipeline_record_send(bc->pipeline, bc->client, start_us, slot->timestamp_us, slot->len);
+        frame_ring_release(bc->ring, bc->client, slot, true);
+        bc->frames++;
+    }
+    return NULL;
+}
+
+static double bench_pipelined(double seconds, int fps, uint32_t *lost, frame_pipeline_stats_t *stats,
+                              frame_ring_stats_t *ring_stats)
+{
+    static frame_ring_t ring;
+    static frame_pipeline_t pipeline;
+    uint8_t *bufs[BENCH_RING];
+    pthread_t sensor, client;
+    bench_client_t bc = { .ring = &ring, .pipeline = &pipeline, .running = true };
+
+    for (int i = 0; i < BENCH_RING; i++) {
+        bufs[i] = malloc(BENCH_JPEG_SIZE);
+    }
+    frame_pipeline_config_t config = {
+        .ops = &s_bench_ops,
+        .ctx = &s_sensor,
+        .ring = &ring,
+        .buffer_count = BENCH_BUFFERS,
+    };
+    if (frame_ring_init(&ring, bufs, BENCH_RING, BENCH_JPEG_SIZE) != ESP_OK ||
+        frame_ring_attach(&ring, 0, &bc.client) != ESP_OK) {
+        fprintf(stderr, "pipeline_bench: ring setup failed\n");
+        exit(1);
+    }
+
+    bench_sensor_start(&sensor, fps);
+    if (frame_pipeline_start(&pipeline, &config) != ESP_OK) {
+        fprintf(stderr, "pipeline_bench: pipeline setup failed\n");
+        exit(1);
+    }
+    pthread_create(&client, NULL, bench_client_main, &bc);
+
+    double start = bench_now();
+    usleep((useconds_t)(seconds * 1e6));
+    uint32_t frames = bc.frames;
+    double elapsed = bench_now() - start;
+
+    frame_pipeline_get_stats(&pipeline, stats);
+    frame_ring_get_stats(&ring, ring_stats);
+    bc.running = false;
+    pthread_join(client, NULL);
+    frame_pipeline_remove_client(&pipeline, bc.client);
+    frame_pipeline_stop(&pipeline);
+    *lost = bench_sensor_stop(sensor);
+    frame_ring_detach(&ring, bc.client);
+    frame_ring_deinit(&ring);
+    for (int i = 0; i < BENCH_RING; i++) {
+        free(bufs[i]);
+    }
+    return frames / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+    int fps = argc > 2 ? atoi(argv[2]) : 30;
+    s_link_bytes_per_s = (argc > 3 ? (uint32_t)atoi(argv[3]) : 1500) * 1000;
+    s_encode_passes = argc > 4 ? atoi(argv[4]) : 5;
+
+    pthread_mutex_init(&s_sensor.mutex, NULL);
+    host_cond_init(&s_sensor.cond);
+    for (int i = 0; i < BENCH_BUFFERS; i++) {
+        s_sensor.data[i] = malloc(BENCH_FRAME_SIZE);
+    }
+    bench_encoder_init(BENCH_QUALITY);
+
+    // Encoder cost on its own, for reading the results
+    static uint8_t jpeg[BENCH_JPEG_SIZE];
+    frame_pipeline_buf_t probe = { .data = s_sensor.data[0], .size = BENCH_FRAME_SIZE };
+    uint32_t len = 0;
+    bench_fill(s_sensor.data[0], 0);
+    double t0 = bench_now();
+    for (int i = 0; i < 5; i++) {
+        bench_encode(NULL, &probe, jpeg, sizeof(jpeg), &len);
+    }
+    double encode_ms = (bench_now() - t0) * 200;
+
+    printf("pipeline_bench: %dx%d RGB565 at %d fps, %d camera buffers, %d ring slots\n",
+           BENCH_WIDTH, BENCH_HEIGHT, fps, BENCH_BUFFERS, BENCH_RING);
+    printf("  encode %.1f ms, %u bytes, send %.1f ms at %u kB/s\n\n", encode_ms, len,
+           len * 1000.0 / s_link_bytes_per_s, s_link_bytes_per_s / 1000);
+
+    uint32_t lost_seq, lost_pipe;
+    frame_pipeline_stats_t stats;
+    frame_ring_stats_t ring_stats;
+    double seq_fps = bench_sequential(seconds, fps, &lost_seq);
+    double pipe_fps = bench_pipelined(seconds, fps, &lost_pipe, &stats, &ring_stats);
+
+    printf("  %-10s %8s %12s\n", "mode", "fps", "sensor lost");
+    printf("  %-10s %8.1f %12u\n", "sequential", seq_fps, lost_seq);
+    printf("  %-10s %8.1f %12u   %.2fx\n\n", "pipelined", pipe_fps, lost_pipe, pipe_fps / seq_fps);
+
+    printf("  pipeline: %u encoded, %u capture drops, %u ring drops, client dropped %u\n",
+           ring_stats.published, stats.capture_drops, ring_stats.producer_drops,
+           ring_stats.client_count ? ring_stats.clients[0].dropped : 0);
+    printf("  %-8s %7s %9s %9s %9s %9s\n", "stage", "count", "avg us", "p50 us", "p99 us", "max us");
+    for (int i = 0; i < FRAME_STAGE_COUNT; i++) {
+        const frame_hist_t *h = &stats.hist[i];
+        printf("  %-8s %7u %9.0f %9u %9u %9u\n", frame_pipeline_stage_name(i), h->count,
+               h->count ? (double)h->total_us / h->count : 0.0,
+               frame_hist_percentile(h, 50), frame_hist_percentile(h, 99), h->max_us);
+    }
+    return 0;
+}
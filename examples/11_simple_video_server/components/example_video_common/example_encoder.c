@@ -4,6 +4,9 @@
  * SPDX-License-Identifier: ESPRESSIF MIT
  */
 
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_check.h"
@@ -16,25 +19,107 @@
 #include "esp_jpeg_enc.h"
 #endif
 #include "example_video_common.h"
+#include "example_encoder_priv.h"
 
 typedef struct example_encoder {
 #if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
     jpeg_encode_cfg_t jpeg_enc_config;
 #else
     jpeg_enc_handle_t jpeg_handle;
+    uint8_t applied_quality;        /* Quality jpeg_handle is set to */
 #endif
+    uint8_t quality;
     uint32_t jpeg_out_buf_size;
+    uint32_t jpeg_in_size;
 } example_encoder_t;
 
+/**
+ * @brief One encode, run on the scheduler task
+ */
+typedef struct example_encoder_job {
+    example_encoder_t *encoder;
+    uint8_t quality;
+    uint8_t *src_buf;
+    uint32_t src_size;
+    uint8_t *dst_buf;
+    uint32_t dst_size;
+    uint32_t *dst_size_out;
+} example_encoder_job_t;
+
+#define EXAMPLE_JPEG_SCHED_TASK_STACK_SIZE  (4 * 1024)
+#define EXAMPLE_JPEG_SCHED_TASK_PRIORITY    6
+
 static const char *TAG = "example_encoder";
 
-#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
 /**
- * @brief JPEG hardware encoder handle to provide a single instance for all video streams
+ * @brief JPEG engine shared by all encoder instances and the job scheduler in front of it
+ *
+ * Without the hardware engine the jobs run esp_jpeg_enc on the scheduler task, so the
+ * queueing is the same either way.
  */
-static jpeg_encoder_handle_t s_jpeg_hw_handle;
-static uint32_t s_jpeg_hw_ref_count;
+typedef struct example_jpeg_engine {
+#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
+    jpeg_encoder_handle_t hw_handle;
+#endif
+    example_jpeg_sched_handle_t sched;
+    uint32_t ref_count;
+} example_jpeg_engine_t;
+
+static example_jpeg_engine_t s_jpeg_engine;
+
+static esp_err_t jpeg_engine_acquire(void)
+{
+    esp_err_t ret;
+
+    if (s_jpeg_engine.ref_count) {
+        s_jpeg_engine.ref_count++;
+        return ESP_OK;
+    }
+
+#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
+    jpeg_encode_engine_cfg_t encode_eng_cfg = {
+        .timeout_ms = 5000,
+    };
+    ESP_RETURN_ON_ERROR(jpeg_new_encoder_engine(&encode_eng_cfg, &s_jpeg_engine.hw_handle), TAG, "failed to create jpeg encoder engine");
+#endif
+
+    example_jpeg_sched_config_t sched_config = {
+        .stack_size = EXAMPLE_JPEG_SCHED_TASK_STACK_SIZE,
+        .task_priority = EXAMPLE_JPEG_SCHED_TASK_PRIORITY,
+    };
+    ret = example_jpeg_sched_create(&sched_config, &s_jpeg_engine.sched);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "failed to create jpeg scheduler");
+#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
+        jpeg_del_encoder_engine(s_jpeg_engine.hw_handle);
+        s_jpeg_engine.hw_handle = NULL;
 #endif
+        return ret;
+    }
+
+    s_jpeg_engine.ref_count = 1;
+
+    return ESP_OK;
+}
+
+static void jpeg_engine_release(void)
+{
+    if (!s_jpeg_engine.ref_count) {
+        ESP_LOGW(TAG, "jpeg encoder engine ref count already 0, possible double deinit");
+        return;
+    }
+
+    if (--s_jpeg_engine.ref_count) {
+        return;
+    }
+
+    example_jpeg_sched_delete(s_jpeg_engine.sched);
+    s_jpeg_engine.sched = NULL;
+#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
+    jpeg_del_encoder_engine(s_jpeg_engine.hw_handle);
+    s_jpeg_engine.hw_handle = NULL;
+#endif
+}
 
 /**
  * @brief Initialize the encoder
@@ -56,7 +141,6 @@ esp_err_t example_encoder_init(example_encoder_config_t *config, example_encoder
     uint32_t jpeg_enc_input_src_size;
 #if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
     jpeg_encode_cfg_t jpeg_enc_config = {0};
-    jpeg_encoder_handle_t jpeg_handle = NULL;
 #else
     jpeg_enc_handle_t jpeg_handle = NULL;
     jpeg_enc_config_t jpeg_enc_config = {0};
@@ -106,13 +190,6 @@ esp_err_t example_encoder_init(example_encoder_config_t *config, example_encoder
         ESP_LOGE(TAG, "Unsupported format");
         return ESP_ERR_NOT_SUPPORTED;
     }
-
-    if (!s_jpeg_hw_handle) {
-        jpeg_encode_engine_cfg_t encode_eng_cfg = {
-            .timeout_ms = 5000,
-        };
-        ESP_RETURN_ON_ERROR(jpeg_new_encoder_engine(&encode_eng_cfg, &jpeg_handle), TAG, "failed to create jpeg encoder engine");
-    }
 #else
     jpeg_enc_config.quality = config->quality;
 
@@ -154,31 +231,73 @@ esp_err_t example_encoder_init(example_encoder_config_t *config, example_encoder
     encoder = (example_encoder_t *)calloc(1, sizeof(example_encoder_t));
     ESP_GOTO_ON_FALSE(encoder, ESP_ERR_NO_MEM, fail0, TAG, "failed to alloc example encoder");
 
+    ESP_GOTO_ON_ERROR(jpeg_engine_acquire(), fail1, TAG, "failed to acquire jpeg encoder engine");
+
 #if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
     encoder->jpeg_enc_config = jpeg_enc_config;
-    if (!s_jpeg_hw_ref_count) {
-        s_jpeg_hw_ref_count++;
-        s_jpeg_hw_handle = jpeg_handle;
-    }
 #else
     encoder->jpeg_handle = jpeg_handle;
+    encoder->applied_quality = config->quality;
 #endif
+    encoder->quality = config->quality;
 
     encoder->jpeg_out_buf_size = jpeg_enc_input_src_size * 3 / 4;
+    encoder->jpeg_in_size = jpeg_enc_input_src_size;
 
     *ret_handle = encoder;
 
     return ESP_OK;
 
+fail1:
+    free(encoder);
 fail0:
-#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    jpeg_del_encoder_engine(jpeg_handle);
-#else
+#if !CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
     jpeg_enc_close(jpeg_handle);
 #endif
     return ret;
 }
 
+/**
+ * @brief Allocate an output buffer of at least the given size
+ */
+esp_err_t example_encoder_output_alloc(uint32_t request_size, uint8_t **buf, uint32_t *size)
+{
+    uint8_t *jpeg_out_buf;
+
+#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
+    size_t jpeg_out_buf_size;
+    jpeg_encode_memory_alloc_cfg_t jpeg_enc_output_mem_cfg = {
+        .buffer_direction = JPEG_DEC_ALLOC_OUTPUT_BUFFER,
+    };
+
+    jpeg_out_buf = (uint8_t *)jpeg_alloc_encoder_mem(request_size, &jpeg_enc_output_mem_cfg, &jpeg_out_buf_size);
+    ESP_RETURN_ON_FALSE(jpeg_out_buf, ESP_ERR_NO_MEM, TAG, "failed to alloc jpeg output buf");
+#else
+    uint32_t jpeg_out_buf_size;
+
+    jpeg_out_buf = jpeg_calloc_align(request_size, 128);
+    ESP_RETURN_ON_FALSE(jpeg_out_buf, ESP_ERR_NO_MEM, TAG, "failed to alloc jpeg output buf");
+    jpeg_out_buf_size = request_size;
+#endif
+
+    *buf = jpeg_out_buf;
+    *size = jpeg_out_buf_size;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Free a buffer from example_encoder_output_alloc()
+ */
+void example_encoder_output_free(uint8_t *buf)
+{
+#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
+    free(buf);
+#else
+    jpeg_free_align(buf);
+#endif
+}
+
 /**
  * @brief Get the encoder output buffer
  *
@@ -191,40 +310,20 @@ fail0:
 esp_err_t example_encoder_alloc_output_buffer(example_encoder_handle_t handle, uint8_t **buf, uint32_t *size)
 {
 #if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    if (!s_jpeg_hw_ref_count) {
+    if (!s_jpeg_engine.ref_count) {
         ESP_LOGE(TAG, "jpeg hardware encoder is not initialized");
         return ESP_ERR_INVALID_STATE;
     }
 #endif
 
-    uint8_t *jpeg_out_buf;
     example_encoder_t *encoder = (example_encoder_t *)handle;
     if (!encoder || !buf || !size) {
         ESP_LOGE(TAG, "invalid argument");
         return ESP_ERR_INVALID_ARG;
     }
 
-#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    size_t jpeg_out_buf_size;
-    jpeg_encode_memory_alloc_cfg_t jpeg_enc_output_mem_cfg = {
-        .buffer_direction = JPEG_DEC_ALLOC_OUTPUT_BUFFER,
-    };
-
     // Note that a larger JPEG_ENC_QUALITY means better image quality, so you need to increase the allocated buffer size
-    jpeg_out_buf = (uint8_t *)jpeg_alloc_encoder_mem(encoder->jpeg_out_buf_size, &jpeg_enc_output_mem_cfg, &jpeg_out_buf_size);
-    ESP_RETURN_ON_FALSE(jpeg_out_buf, ESP_ERR_NO_MEM, TAG, "failed to alloc jpeg output buf");
-#else
-    uint32_t jpeg_out_buf_size;
-
-    jpeg_out_buf = jpeg_calloc_align(encoder->jpeg_out_buf_size, 128);
-    ESP_RETURN_ON_FALSE(jpeg_out_buf, ESP_ERR_NO_MEM, TAG, "failed to alloc jpeg output buf");
-    jpeg_out_buf_size = encoder->jpeg_out_buf_size;
-#endif
-
-    *buf = jpeg_out_buf;
-    *size = jpeg_out_buf_size;
-
-    return ESP_OK;
+    return example_encoder_output_alloc(encoder->jpeg_out_buf_size, buf, size);
 }
 
 /**
@@ -238,7 +337,7 @@ esp_err_t example_encoder_alloc_output_buffer(example_encoder_handle_t handle, u
 esp_err_t example_encoder_free_output_buffer(example_encoder_handle_t handle, uint8_t *buf)
 {
 #if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    if (!s_jpeg_hw_ref_count) {
+    if (!s_jpeg_engine.ref_count) {
         ESP_LOGE(TAG, "jpeg hardware encoder is not initialized");
         return ESP_ERR_INVALID_STATE;
     }
@@ -249,11 +348,7 @@ esp_err_t example_encoder_free_output_buffer(example_encoder_handle_t handle, ui
         return ESP_ERR_INVALID_ARG;
     }
 
-#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    free(buf);
-#else
-    jpeg_free_align(buf);
-#endif
+    example_encoder_output_free(buf);
     return ESP_OK;
 }
 
@@ -272,27 +367,96 @@ esp_err_t example_encoder_free_output_buffer(example_encoder_handle_t handle, ui
 esp_err_t example_encoder_process(example_encoder_handle_t handle, uint8_t *src_buf, uint32_t src_size,
                                   uint8_t *dst_buf, uint32_t dst_size, uint32_t *dst_size_out)
 {
+    example_encoder_job_config_t job_config = {
+        .priority = EXAMPLE_JPEG_PRIO_LIVE,
+    };
+
+    return example_encoder_process_job(handle, &job_config, src_buf, src_size, dst_buf, dst_size, dst_size_out);
+}
+
+/**
+ * @brief Encode one job with the encoder's configuration, on the scheduler task
+ */
+static esp_err_t encoder_job_run(void *ctx)
+{
+    example_encoder_job_t *job = (example_encoder_job_t *)ctx;
+    example_encoder_t *encoder = job->encoder;
+
 #if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    if (!s_jpeg_hw_ref_count) {
-        ESP_LOGE(TAG, "jpeg hardware encoder is not initialized");
-        return ESP_ERR_INVALID_STATE;
+    jpeg_encode_cfg_t jpeg_enc_config = encoder->jpeg_enc_config;
+
+    jpeg_enc_config.image_quality = job->quality;
+    return jpeg_encoder_process(s_jpeg_engine.hw_handle, &jpeg_enc_config, job->src_buf, job->src_size,
+                                job->dst_buf, job->dst_size, job->dst_size_out);
+#else
+    /* The jobs of all encoders run on this one task, so the handle is never used concurrently */
+    if (job->quality != encoder->applied_quality) {
+        ESP_RETURN_ON_ERROR(jpeg_enc_set_quality(encoder->jpeg_handle, job->quality), TAG, "failed to set jpeg quality");
+        encoder->applied_quality = job->quality;
     }
+    return jpeg_enc_process(encoder->jpeg_handle, job->src_buf, job->src_size, job->dst_buf, job->dst_size, (int *)job->dst_size_out);
 #endif
+}
+
+/**
+ * @brief Process the encoder with per-job settings
+ *
+ * @param handle Encoder handle
+ * @param job_config Job priority and quality
+ * @param src_buf Source buffer
+ * @param src_size Source buffer size
+ * @param dst_buf Destination buffer
+ * @param dst_size Destination buffer size
+ * @param dst_size_out Output destination buffer size
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_process_job(example_encoder_handle_t handle, const example_encoder_job_config_t *job_config,
+                                      uint8_t *src_buf, uint32_t src_size,
+                                      uint8_t *dst_buf, uint32_t dst_size, uint32_t *dst_size_out)
+{
+    if (!s_jpeg_engine.ref_count) {
+        ESP_LOGE(TAG, "jpeg encoder engine is not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    if (!handle || !src_buf || !src_size || !dst_buf || !dst_size || !dst_size_out) {
+    if (!handle || !job_config || !src_buf || !src_size || !dst_buf || !dst_size || !dst_size_out) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t ret = ESP_OK;
     example_encoder_t *encoder = (example_encoder_t *)handle;
+    example_encoder_job_t job = {
+        .encoder = encoder,
+        .quality = job_config->quality ? job_config->quality : encoder->quality,
+        .src_buf = src_buf,
+        .src_size = src_size,
+        .dst_buf = dst_buf,
+        .dst_size = dst_size,
+        .dst_size_out = dst_size_out,
+    };
 
-#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    ret = jpeg_encoder_process(s_jpeg_hw_handle, &encoder->jpeg_enc_config, src_buf, src_size, dst_buf, dst_size, dst_size_out);
-#else
-    ret = jpeg_enc_process(encoder->jpeg_handle, src_buf, src_size, dst_buf, dst_size, (int *)dst_size_out);
-#endif
+    return example_jpeg_sched_run(s_jpeg_engine.sched, job_config->priority, encoder_job_run, &job);
+}
 
-    return ret;
+/**
+ * @brief Get the statistics of the scheduler in front of the shared JPEG engine
+ *
+ * @param stats Scheduler statistics
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if no encoder is initialized
+ */
+esp_err_t example_encoder_get_sched_stats(example_jpeg_sched_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_jpeg_engine.ref_count) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    example_jpeg_sched_get_stats(s_jpeg_engine.sched, stats);
+
+    return ESP_OK;
 }
 
 /**
@@ -305,19 +469,20 @@ esp_err_t example_encoder_process(example_encoder_handle_t handle, uint8_t *src_
  */
 esp_err_t example_encoder_set_jpeg_quality(example_encoder_handle_t handle, uint8_t quality)
 {
-    esp_err_t ret = ESP_OK;
     example_encoder_t *encoder = (example_encoder_t *)handle;
     if (!encoder) {
         ESP_LOGE(TAG, "example encoder is not initialized");
         return ESP_ERR_INVALID_ARG;
     }
+    if (quality < 1 || quality > 100) {
+        ESP_LOGE(TAG, "invalid jpeg quality %u", quality);
+        return ESP_ERR_INVALID_ARG;
+    }
 
-#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    encoder->jpeg_enc_config.image_quality = quality;
-#else
-    ret = jpeg_enc_set_quality(encoder->jpeg_handle, quality);
-#endif
-    return ret;
+    /* Applied by the next job, so a job already queued keeps the quality it was submitted with */
+    encoder->quality = quality;
+
+    return ESP_OK;
 }
 
 /**
@@ -334,20 +499,22 @@ esp_err_t example_encoder_deinit(example_encoder_handle_t handle)
         return ESP_ERR_INVALID_ARG;
     }
 
-#if CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
-    if (s_jpeg_hw_ref_count) {
-        s_jpeg_hw_ref_count--;
-        if (!s_jpeg_hw_ref_count) {
-            jpeg_del_encoder_engine(s_jpeg_hw_handle);
-            s_jpeg_hw_handle = NULL;
-        }
-    } else {
-        ESP_LOGW(TAG, "jpeg hardware encoder ref count already 0, possible double deinit");
-    }
-#else
+    jpeg_engine_release();
+#if !CONFIG_EXAMPLE_SELECT_JPEG_HW_DRIVER
     jpeg_enc_close(encoder->jpeg_handle);
 #endif
     free(encoder);
 
     return ESP_OK;
 }
+
+/**
+ * @brief Get the output buffer size the encoder was sized for and the uncompressed frame size
+ */
+void example_encoder_get_buffer_sizes(example_encoder_handle_t handle, uint32_t *out_size, uint32_t *in_size)
+{
+    example_encoder_t *encoder = (example_encoder_t *)handle;
+
+    *out_size = encoder->jpeg_out_buf_size;
+    *in_size = encoder->jpeg_in_size;
+}
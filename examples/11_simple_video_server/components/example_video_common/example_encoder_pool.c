@@ -0,0 +1,362 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: ESPRESSIF MIT
+ */
+
+/**
+ * @file example_encoder_pool.c
+ * @brief Encoder output buffers sized from the recent frames
+ *
+ * Only needs the encoder's allocator and sizes from example_encoder_priv.h,
+ * so the sizing runs on the host for tests.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "example_encoder_pool.h"
+#include "example_encoder_priv.h"
+
+#define EXAMPLE_ENCODER_POOL_ALIGN          128     /* Cache line size of PSRAM */
+#define EXAMPLE_ENCODER_POOL_WINDOW         32      /* Frames per size window */
+#define EXAMPLE_ENCODER_POOL_HEADROOM_PCT   50
+
+typedef struct example_encoder_pool_buf {
+    uint8_t *buf;
+    uint32_t size;
+    bool in_use;
+} example_encoder_pool_buf_t;
+
+typedef struct example_encoder_pool {
+    example_encoder_handle_t encoder;
+    SemaphoreHandle_t lock;
+    uint32_t min_size;
+    uint32_t headroom_pct;
+    uint32_t window_max;        /* Largest frame of the current window */
+    uint32_t prev_window_max;   /* Largest frame of the previous window */
+    uint32_t window_frames;
+    example_encoder_pool_stats_t stats;
+    uint32_t buffer_count;
+    example_encoder_pool_buf_t bufs[EXAMPLE_ENCODER_POOL_MAX_BUFFERS];
+} example_encoder_pool_t;
+
+static const char *TAG = "example_encoder_pool";
+
+static uint32_t pool_align(uint32_t size)
+{
+    return (size + EXAMPLE_ENCODER_POOL_ALIGN - 1) & ~(EXAMPLE_ENCODER_POOL_ALIGN - 1);
+}
+
+/**
+ * @brief Size for the largest frame of the last two windows plus headroom, called with the lock held
+ */
+static void pool_update_target(example_encoder_pool_t *pool)
+{
+    uint32_t largest = pool->window_max > pool->prev_window_max ? pool->window_max : pool->prev_window_max;
+    uint64_t target;
+
+    if (!largest) {
+        return;
+    }
+
+    target = (uint64_t)largest * (100 + pool->headroom_pct) / 100;
+    if (target < pool->min_size) {
+        target = pool->min_size;
+    } else if (target > pool->stats.max_size) {
+        target = pool->stats.max_size;
+    }
+    pool->stats.target_size = pool_align((uint32_t)target);
+}
+
+/**
+ * @brief Reallocate a pool buffer that is too small or more than twice too large, called with the lock held
+ *
+ * The new buffer is allocated before the old one is freed, so the old one stays valid on failure.
+ */
+static esp_err_t pool_fit_buf(example_encoder_pool_t *pool, example_encoder_pool_buf_t *pbuf)
+{
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t target = pool->stats.target_size;
+
+    if (pbuf->buf && pbuf->size >= target && pbuf->size / 2 <= target) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(example_encoder_output_alloc(target, &buf, &size), TAG, "failed to alloc pool buffer of %" PRIu32 " bytes", target);
+    if (pbuf->buf) {
+        if (size > pbuf->size) {
+            pool->stats.grows++;
+        } else {
+            pool->stats.shrinks++;
+        }
+        example_encoder_output_free(pbuf->buf);
+        pool->stats.allocated_bytes -= pbuf->size;
+    } else {
+        pool->stats.buffers++;
+    }
+
+    pbuf->buf = buf;
+    pbuf->size = size;
+    pool->stats.allocated_bytes += size;
+    if (pool->stats.allocated_bytes > pool->stats.peak_bytes) {
+        pool->stats.peak_bytes = pool->stats.allocated_bytes;
+    }
+
+    return ESP_OK;
+}
+
+static example_encoder_pool_buf_t *pool_find_buf(example_encoder_pool_t *pool, const uint8_t *buf)
+{
+    for (uint32_t i = 0; i < pool->buffer_count; i++) {
+        if (pool->bufs[i].buf == buf && pool->bufs[i].in_use) {
+            return &pool->bufs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Create a pool of cache-aligned output buffers for the encoder
+ *
+ * @param handle Encoder handle, must outlive the pool
+ * @param config Pool configuration
+ * @param ret_pool Pool handle
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_pool_create(example_encoder_handle_t handle, const example_encoder_pool_config_t *config,
+                                      example_encoder_pool_handle_t *ret_pool)
+{
+    uint32_t out_size;
+    uint32_t in_size;
+    if (!handle || !config || !ret_pool || !config->buffer_count || config->buffer_count > EXAMPLE_ENCODER_POOL_MAX_BUFFERS) {
+        ESP_LOGE(TAG, "invalid argument");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    example_encoder_pool_t *pool = (example_encoder_pool_t *)calloc(1, sizeof(example_encoder_pool_t));
+    ESP_RETURN_ON_FALSE(pool, ESP_ERR_NO_MEM, TAG, "failed to alloc encoder pool");
+
+    pool->lock = xSemaphoreCreateMutex();
+    if (!pool->lock) {
+        free(pool);
+        ESP_LOGE(TAG, "failed to create encoder pool lock");
+        return ESP_ERR_NO_MEM;
+    }
+
+    example_encoder_get_buffer_sizes(handle, &out_size, &in_size);
+    pool->encoder = handle;
+    pool->buffer_count = config->buffer_count;
+    pool->headroom_pct = config->headroom_pct ? config->headroom_pct : EXAMPLE_ENCODER_POOL_HEADROOM_PCT;
+    pool->min_size = config->min_size ? config->min_size : out_size / 16;
+    pool->stats.max_size = pool_align(in_size);
+    if (pool->min_size > pool->stats.max_size) {
+        pool->min_size = pool->stats.max_size;
+    }
+
+    /* Start at the old fixed size until frames have been recorded */
+    pool->stats.target_size = pool_align(out_size);
+
+    *ret_pool = pool;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Take a buffer from the pool
+ *
+ * @param pool Pool handle
+ * @param buf Output buffer
+ * @param size Output buffer size
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if every buffer is handed out or other value on failure
+ */
+esp_err_t example_encoder_pool_get(example_encoder_pool_handle_t pool, uint8_t **buf, uint32_t *size)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    example_encoder_pool_t *p = (example_encoder_pool_t *)pool;
+    example_encoder_pool_buf_t *pbuf = NULL;
+    if (!p || !buf || !size) {
+        ESP_LOGE(TAG, "invalid argument");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(p->lock, portMAX_DELAY);
+
+    /* Prefer a buffer that is already allocated */
+    for (uint32_t i = 0; i < p->buffer_count; i++) {
+        if (!p->bufs[i].in_use && (!pbuf || (!pbuf->buf && p->bufs[i].buf))) {
+            pbuf = &p->bufs[i];
+        }
+    }
+
+    if (pbuf) {
+        ret = pool_fit_buf(p, pbuf);
+        if (ret == ESP_OK) {
+            pbuf->in_use = true;
+            p->stats.in_use++;
+            *buf = pbuf->buf;
+            *size = pbuf->size;
+        }
+    }
+
+    xSemaphoreGive(p->lock);
+
+    return ret;
+}
+
+/**
+ * @brief Give a buffer back to the pool
+ *
+ * @param pool Pool handle
+ * @param buf Buffer from example_encoder_pool_get()
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_pool_put(example_encoder_pool_handle_t pool, uint8_t *buf)
+{
+    esp_err_t ret = ESP_OK;
+    example_encoder_pool_t *p = (example_encoder_pool_t *)pool;
+    if (!p || !buf) {
+        ESP_LOGE(TAG, "invalid argument");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(p->lock, portMAX_DELAY);
+    example_encoder_pool_buf_t *pbuf = pool_find_buf(p, buf);
+    if (pbuf) {
+        pbuf->in_use = false;
+        p->stats.in_use--;
+    } else {
+        ESP_LOGE(TAG, "buffer %p is not from this pool", buf);
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreGive(p->lock);
+
+    return ret;
+}
+
+/**
+ * @brief Reallocate a buffer that is still handed out if its size no longer fits the frames
+ *
+ * @param pool Pool handle
+ * @param buf Buffer from example_encoder_pool_get(), replaced on reallocation
+ * @param size Buffer size, updated on reallocation
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_pool_fit(example_encoder_pool_handle_t pool, uint8_t **buf, uint32_t *size)
+{
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+    example_encoder_pool_t *p = (example_encoder_pool_t *)pool;
+    if (!p || !buf || !size) {
+        ESP_LOGE(TAG, "invalid argument");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(p->lock, portMAX_DELAY);
+    example_encoder_pool_buf_t *pbuf = pool_find_buf(p, *buf);
+    if (pbuf) {
+        ret = pool_fit_buf(p, pbuf);
+        *buf = pbuf->buf;
+        *size = pbuf->size;
+    }
+    xSemaphoreGive(p->lock);
+
+    return ret;
+}
+
+/**
+ * @brief Record the size of an encoded frame
+ *
+ * @param pool Pool handle
+ * @param frame_size Encoded size, or EXAMPLE_ENCODER_POOL_OVERFLOW if encoding failed
+ */
+void example_encoder_pool_record(example_encoder_pool_handle_t pool, uint32_t frame_size)
+{
+    example_encoder_pool_t *p = (example_encoder_pool_t *)pool;
+    if (!p) {
+        return;
+    }
+
+    xSemaphoreTake(p->lock, portMAX_DELAY);
+
+    if (frame_size == EXAMPLE_ENCODER_POOL_OVERFLOW) {
+        uint64_t needed = (uint64_t)p->stats.target_size * 2;
+
+        /* Held for two windows like a frame of that size */
+        if (needed > p->stats.max_size) {
+            needed = p->stats.max_size;
+        }
+        frame_size = (uint32_t)(needed * 100 / (100 + p->headroom_pct));
+        p->stats.overflows++;
+    } else if (frame_size > p->stats.largest_frame) {
+        p->stats.largest_frame = frame_size;
+    }
+
+    if (frame_size > p->window_max) {
+        p->window_max = frame_size;
+    }
+    if (++p->window_frames == EXAMPLE_ENCODER_POOL_WINDOW) {
+        p->prev_window_max = p->window_max;
+        p->window_max = 0;
+        p->window_frames = 0;
+    }
+    pool_update_target(p);
+
+    xSemaphoreGive(p->lock);
+}
+
+/**
+ * @brief Get the pool statistics
+ *
+ * @param pool Pool handle
+ * @param stats Pool statistics
+ */
+void example_encoder_pool_get_stats(example_encoder_pool_handle_t pool, example_encoder_pool_stats_t *stats)
+{
+    example_encoder_pool_t *p = (example_encoder_pool_t *)pool;
+    if (!p || !stats) {
+        return;
+    }
+
+    xSemaphoreTake(p->lock, portMAX_DELAY);
+    *stats = p->stats;
+    xSemaphoreGive(p->lock);
+}
+
+/**
+ * @brief Free the pool and its buffers
+ *
+ * @param pool Pool handle
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if a buffer is still handed out
+ */
+esp_err_t example_encoder_pool_delete(example_encoder_pool_handle_t pool)
+{
+    example_encoder_pool_t *p = (example_encoder_pool_t *)pool;
+    if (!p) {
+        ESP_LOGE(TAG, "invalid argument");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_RETURN_ON_FALSE(!p->stats.in_use, ESP_ERR_INVALID_STATE, TAG, "%" PRIu32 " pool buffers still in use", p->stats.in_use);
+
+    for (uint32_t i = 0; i < p->buffer_count; i++) {
+        if (p->bufs[i].buf) {
+            example_encoder_output_free(p->bufs[i].buf);
+        }
+    }
+    vSemaphoreDelete(p->lock);
+    free(p);
+
+    return ESP_OK;
+}
@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: ESPRESSIF MIT
+ */
+
+/**
+ * @file example_encoder_priv.h
+ * @brief Encoder internals the output buffer pool builds on
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "example_encoder_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocate an output buffer of at least the given size
+ *
+ * @param request_size Bytes needed
+ * @param buf Output buffer, cache-aligned
+ * @param size Bytes allocated, at least @p request_size
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_output_alloc(uint32_t request_size, uint8_t **buf, uint32_t *size);
+
+/**
+ * @brief Free a buffer from example_encoder_output_alloc()
+ */
+void example_encoder_output_free(uint8_t *buf);
+
+/**
+ * @brief Get the output buffer size the encoder was sized for and the uncompressed frame size
+ */
+void example_encoder_get_buffer_sizes(example_encoder_handle_t handle, uint32_t *out_size, uint32_t *in_size);
+
+#ifdef __cplusplus
+}
+#endif
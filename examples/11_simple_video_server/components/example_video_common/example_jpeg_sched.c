@@ -0,0 +1,335 @@
+/**
+ * @file example_jpeg_sched.c
+ * @brief Priority job queue in front of the single JPEG engine
+ */
+
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "example_jpeg_sched.h"
+
+#define EXAMPLE_JPEG_SCHED_IDLE_MS              100     /* Worker wakeup to look at running */
+
+typedef enum {
+    JOB_FREE = 0,
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+} job_state_t;
+
+typedef struct example_jpeg_job {
+    job_state_t state;
+    example_jpeg_prio_t prio;
+    uint32_t seq;
+    example_jpeg_job_fn_t fn;
+    void *ctx;
+    esp_err_t result;
+    int64_t submit_us;
+    SemaphoreHandle_t done;
+} example_jpeg_job_t;
+
+typedef struct example_jpeg_sched {
+    SemaphoreHandle_t lock;         /* Guards everything below */
+    SemaphoreHandle_t wake;         /* Given on every submission */
+    SemaphoreHandle_t free_jobs;    /* Counts free job slots */
+    SemaphoreHandle_t exited;
+    volatile bool running;
+    uint32_t still_max_wait_us;     /* 0: never run a still job without a gap */
+    uint32_t seq;
+    int64_t last_submit_us[EXAMPLE_JPEG_PRIO_COUNT];
+    example_jpeg_sched_stats_t stats;
+    example_jpeg_job_t jobs[EXAMPLE_JPEG_SCHED_MAX_JOBS];
+} example_jpeg_sched_t;
+
+static int64_t sched_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Exponential average with weight 1/8 for the new sample, seeded by the first
+ */
+static uint32_t sched_ewma(uint32_t avg, uint32_t sample)
+{
+    if (avg == 0) {
+        return sample;
+    }
+    return (uint32_t)((int64_t)avg + ((int64_t)sample - avg) / 8);
+}
+
+/**
+ * @brief Whether a still job started now ends before the next frame is expected
+ *
+ * @param retry_us Set to when the answer changes by itself if no frame arrives, 0 if it does not
+ */
+static bool sched_still_fits(example_jpeg_sched_t *sched, int64_t now_us, int64_t *retry_us)
+{
+    uint32_t still_us = sched->stats.run_avg_us[EXAMPLE_JPEG_PRIO_STILL];
+    bool fits = true;
+
+    /* Until one has run, assume a still job takes as long as the slowest frame */
+    for (int p = 0; !still_us && p < EXAMPLE_JPEG_PRIO_STILL; p++) {
+        if (sched->stats.run_avg_us[p] > still_us) {
+            still_us = sched->stats.run_avg_us[p];
+        }
+    }
+
+    *retry_us = 0;
+    for (int p = 0; p < EXAMPLE_JPEG_PRIO_STILL; p++) {
+        uint32_t interval_us = sched->stats.interval_avg_us[p];
+        int64_t stale_us = sched->last_submit_us[p] + 2 * (int64_t)interval_us;
+
+        /* A stream that stopped submitting does not reserve the engine */
+        if (!interval_us || now_us >= stale_us) {
+            continue;
+        }
+        if (now_us + still_us > sched->last_submit_us[p] + interval_us) {
+            fits = false;
+            if (!*retry_us || stale_us < *retry_us) {
+                *retry_us = stale_us;
+            }
+        }
+    }
+
+    return fits;
+}
+
+/**
+ * @brief Pick the next job to run, called with the lock held
+ *
+ * @param wait_us Set to how long to sleep if nothing can run yet
+ */
+static example_jpeg_job_t *sched_pick(example_jpeg_sched_t *sched, int64_t now_us, int64_t *wait_us)
+{
+    example_jpeg_job_t *best = NULL;
+
+    *wait_us = EXAMPLE_JPEG_SCHED_IDLE_MS * 1000;
+    for (int i = 0; i < EXAMPLE_JPEG_SCHED_MAX_JOBS; i++) {
+        example_jpeg_job_t *job = &sched->jobs[i];
+
+        if (job->state == JOB_QUEUED &&
+                (!best || job->prio < best->prio || (job->prio == best->prio && (int32_t)(job->seq - best->seq) < 0))) {
+            best = job;
+        }
+    }
+
+    if (!best || best->prio != EXAMPLE_JPEG_PRIO_STILL) {
+        return best;
+    }
+
+    int64_t retry_us;
+    int64_t deadline_us = sched->still_max_wait_us ? best->submit_us + sched->still_max_wait_us : INT64_MAX;
+    if (now_us >= deadline_us) {
+        sched->stats.still_forced++;
+        return best;
+    }
+    if (sched_still_fits(sched, now_us, &retry_us)) {
+        return best;
+    }
+
+    /* A frame arriving wakes the worker earlier */
+    if (retry_us && retry_us < deadline_us) {
+        deadline_us = retry_us;
+    }
+    if (deadline_us - now_us < *wait_us) {
+        *wait_us = deadline_us - now_us;
+    }
+    return NULL;
+}
+
+static void sched_task(void *arg)
+{
+    example_jpeg_sched_t *sched = (example_jpeg_sched_t *)arg;
+
+    while (sched->running) {
+        int64_t wait_us;
+        int64_t start_us = sched_now_us();
+
+        xSemaphoreTake(sched->lock, portMAX_DELAY);
+        example_jpeg_job_t *job = sched_pick(sched, start_us, &wait_us);
+        if (job) {
+            uint32_t waited_us = (uint32_t)(start_us - job->submit_us);
+
+            job->state = JOB_RUNNING;
+            sched->stats.jobs[job->prio]++;
+            sched->stats.wait_total_us[job->prio] += waited_us;
+            if (waited_us > sched->stats.wait_max_us[job->prio]) {
+                sched->stats.wait_max_us[job->prio] = waited_us;
+            }
+        }
+        xSemaphoreGive(sched->lock);
+
+        if (!job) {
+            TickType_t ticks = pdMS_TO_TICKS((wait_us + 999) / 1000);
+
+            xSemaphoreTake(sched->wake, ticks ? ticks : 1);
+            continue;
+        }
+
+        esp_err_t result = job->fn(job->ctx);
+        uint32_t run_us = (uint32_t)(sched_now_us() - start_us);
+
+        xSemaphoreTake(sched->lock, portMAX_DELAY);
+        sched->stats.run_avg_us[job->prio] = sched_ewma(sched->stats.run_avg_us[job->prio], run_us ? run_us : 1);
+        job->result = result;
+        job->state = JOB_DONE;
+        xSemaphoreGive(sched->lock);
+        xSemaphoreGive(job->done);
+    }
+
+    xSemaphoreGive(sched->exited);
+    vTaskDelete(NULL);
+}
+
+static void sched_free(example_jpeg_sched_t *sched)
+{
+    for (int i = 0; i < EXAMPLE_JPEG_SCHED_MAX_JOBS; i++) {
+        if (sched->jobs[i].done) {
+            vSemaphoreDelete(sched->jobs[i].done);
+        }
+    }
+    if (sched->exited) {
+        vSemaphoreDelete(sched->exited);
+    }
+    if (sched->free_jobs) {
+        vSemaphoreDelete(sched->free_jobs);
+    }
+    if (sched->wake) {
+        vSemaphoreDelete(sched->wake);
+    }
+    if (sched->lock) {
+        vSemaphoreDelete(sched->lock);
+    }
+    free(sched);
+}
+
+esp_err_t example_jpeg_sched_create(const example_jpeg_sched_config_t *config, example_jpeg_sched_handle_t *ret_handle)
+{
+    if (!config || !ret_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    example_jpeg_sched_t *sched = (example_jpeg_sched_t *)calloc(1, sizeof(example_jpeg_sched_t));
+    if (!sched) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sched->lock = xSemaphoreCreateMutex();
+    sched->wake = xSemaphoreCreateBinary();
+    sched->free_jobs = xSemaphoreCreateCounting(EXAMPLE_JPEG_SCHED_MAX_JOBS, EXAMPLE_JPEG_SCHED_MAX_JOBS);
+    sched->exited = xSemaphoreCreateBinary();
+    bool ok = sched->lock && sched->wake && sched->free_jobs && sched->exited;
+    for (int i = 0; ok && i < EXAMPLE_JPEG_SCHED_MAX_JOBS; i++) {
+        sched->jobs[i].done = xSemaphoreCreateBinary();
+        ok = sched->jobs[i].done != NULL;
+    }
+    if (!ok) {
+        sched_free(sched);
+        return ESP_ERR_NO_MEM;
+    }
+
+    sched->still_max_wait_us = config->still_max_wait_ms * 1000;
+    sched->running = true;
+    if (xTaskCreate(sched_task, "jpeg_sched", config->stack_size, sched, config->task_priority, NULL) != pdPASS) {
+        sched_free(sched);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *ret_handle = sched;
+
+    return ESP_OK;
+}
+
+esp_err_t example_jpeg_sched_run(example_jpeg_sched_handle_t handle, example_jpeg_prio_t prio,
+                                 example_jpeg_job_fn_t fn, void *ctx)
+{
+    example_jpeg_sched_t *sched = (example_jpeg_sched_t *)handle;
+    example_jpeg_job_t *job = NULL;
+    uint32_t queued = 0;
+
+    if (!sched || !fn || prio >= EXAMPLE_JPEG_PRIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(sched->free_jobs, portMAX_DELAY);
+
+    int64_t now_us = sched_now_us();
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    for (int i = 0; i < EXAMPLE_JPEG_SCHED_MAX_JOBS; i++) {
+        if (sched->jobs[i].state == JOB_FREE && !job) {
+            job = &sched->jobs[i];
+        } else if (sched->jobs[i].state == JOB_QUEUED) {
+            queued++;
+        }
+    }
+    job->state = JOB_QUEUED;
+    job->prio = prio;
+    job->seq = sched->seq++;
+    job->fn = fn;
+    job->ctx = ctx;
+    job->submit_us = now_us;
+    if (sched->last_submit_us[prio]) {
+        sched->stats.interval_avg_us[prio] = sched_ewma(sched->stats.interval_avg_us[prio],
+                                                        (uint32_t)(now_us - sched->last_submit_us[prio]));
+    }
+    sched->last_submit_us[prio] = now_us;
+    if (queued + 1 > sched->stats.max_queued) {
+        sched->stats.max_queued = queued + 1;
+    }
+    xSemaphoreGive(sched->lock);
+
+    xSemaphoreGive(sched->wake);
+    xSemaphoreTake(job->done, portMAX_DELAY);
+
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    esp_err_t result = job->result;
+    job->state = JOB_FREE;
+    xSemaphoreGive(sched->lock);
+    xSemaphoreGive(sched->free_jobs);
+
+    return result;
+}
+
+void example_jpeg_sched_get_stats(example_jpeg_sched_handle_t handle, example_jpeg_sched_stats_t *stats)
+{
+    example_jpeg_sched_t *sched = (example_jpeg_sched_t *)handle;
+
+    if (!sched || !stats) {
+        return;
+    }
+
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    *stats = sched->stats;
+    xSemaphoreGive(sched->lock);
+}
+
+esp_err_t example_jpeg_sched_delete(example_jpeg_sched_handle_t handle)
+{
+    example_jpeg_sched_t *sched = (example_jpeg_sched_t *)handle;
+    bool busy = false;
+
+    if (!sched) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    for (int i = 0; i < EXAMPLE_JPEG_SCHED_MAX_JOBS; i++) {
+        busy |= sched->jobs[i].state != JOB_FREE;
+    }
+    xSemaphoreGive(sched->lock);
+    if (busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sched->running = false;
+    xSemaphoreGive(sched->wake);
+    xSemaphoreTake(sched->exited, portMAX_DELAY);
+    sched_free(sched);
+
+    return ESP_OK;
+}
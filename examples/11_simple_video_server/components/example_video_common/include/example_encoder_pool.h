@@ -0,0 +1,148 @@
+/**
+ * @file example_encoder_pool.h
+ * @brief Encoder output buffers sized from the recent frames
+ *
+ * The pool hands out cache-aligned output buffers and refits them as the
+ * encoded frames grow and shrink, so a stream does not keep buffers of
+ * the uncompressed frame size around for the frames it never produces.
+ *
+ * The pool only needs FreeRTOS semaphores and the encoder's allocator, so
+ * the sizing runs on the host for tests.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Example encoder handle
+ */
+typedef void *example_encoder_handle_t;
+
+typedef void *example_encoder_pool_handle_t;
+
+/**
+ * @brief Maximum number of buffers one encoder output pool can hand out
+ */
+#define EXAMPLE_ENCODER_POOL_MAX_BUFFERS    16
+
+/**
+ * @brief Frame size to record for a frame that did not fit its output buffer
+ */
+#define EXAMPLE_ENCODER_POOL_OVERFLOW       0
+
+/**
+ * @brief Example encoder output buffer pool configuration
+ */
+typedef struct example_encoder_pool_config {
+    uint32_t buffer_count;      /**< Buffers handed out at once, at most EXAMPLE_ENCODER_POOL_MAX_BUFFERS */
+    uint32_t min_size;          /**< Smallest buffer size, 0: 1/16 of the encoder's default output size */
+    uint8_t headroom_pct;       /**< Buffer size above the largest recent frame, 0: 50% */
+} example_encoder_pool_config_t;
+
+/**
+ * @brief Example encoder output buffer pool statistics
+ */
+typedef struct example_encoder_pool_stats {
+    uint32_t target_size;       /**< Size buffers are refitted to */
+    uint32_t max_size;          /**< Upper bound of target_size, the uncompressed frame size */
+    uint32_t buffers;           /**< Buffers allocated */
+    uint32_t in_use;            /**< Buffers handed out */
+    uint32_t allocated_bytes;   /**< Bytes allocated now */
+    uint32_t peak_bytes;        /**< Most bytes allocated at any time */
+    uint32_t largest_frame;     /**< Largest frame recorded */
+    uint32_t grows;             /**< Buffers reallocated larger */
+    uint32_t shrinks;           /**< Buffers reallocated smaller */
+    uint32_t overflows;         /**< Frames that did not fit */
+} example_encoder_pool_stats_t;
+
+/**
+ * @brief Create a pool of cache-aligned output buffers for the encoder
+ *
+ * Buffers are allocated on first use and kept when given back, so a
+ * pipeline that always has a few frames in flight stops allocating once
+ * it has warmed up. Their size follows the frames recorded with
+ * example_encoder_pool_record(): the largest frame of the last two
+ * windows of 32 frames plus the headroom, bounded by the uncompressed
+ * frame size. A buffer more than twice that size, or smaller, is
+ * reallocated the next time it is handed out or refitted.
+ *
+ * @param handle Encoder handle, must outlive the pool
+ * @param config Pool configuration
+ * @param ret_pool Pool handle
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_pool_create(example_encoder_handle_t handle, const example_encoder_pool_config_t *config,
+                                      example_encoder_pool_handle_t *ret_pool);
+
+/**
+ * @brief Take a buffer from the pool
+ *
+ * @param pool Pool handle
+ * @param buf Output buffer
+ * @param size Output buffer size
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if every buffer is handed out or other value on failure
+ */
+esp_err_t example_encoder_pool_get(example_encoder_pool_handle_t pool, uint8_t **buf, uint32_t *size);
+
+/**
+ * @brief Give a buffer back to the pool, for example once its frame has been sent
+ *
+ * @param pool Pool handle
+ * @param buf Buffer from example_encoder_pool_get()
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_pool_put(example_encoder_pool_handle_t pool, uint8_t *buf);
+
+/**
+ * @brief Reallocate a buffer that is still handed out if its size no longer fits the frames
+ *
+ * For buffers that are kept rather than given back between frames. On
+ * failure the old buffer stays valid.
+ *
+ * @param pool Pool handle
+ * @param buf Buffer from example_encoder_pool_get(), replaced on reallocation
+ * @param size Buffer size, updated on reallocation
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_pool_fit(example_encoder_pool_handle_t pool, uint8_t **buf, uint32_t *size);
+
+/**
+ * @brief Record the size of an encoded frame
+ *
+ * @param pool Pool handle
+ * @param frame_size Encoded size, or EXAMPLE_ENCODER_POOL_OVERFLOW if encoding failed. The
+ *                   encoders do not tell a full output buffer from other errors, so every
+ *                   failure doubles the buffer size, up to the uncompressed frame size.
+ */
+void example_encoder_pool_record(example_encoder_pool_handle_t pool, uint32_t frame_size);
+
+/**
+ * @brief Get the pool statistics
+ *
+ * @param pool Pool handle
+ * @param stats Pool statistics
+ */
+void example_encoder_pool_get_stats(example_encoder_pool_handle_t pool, example_encoder_pool_stats_t *stats);
+
+/**
+ * @brief Free the pool and its buffers
+ *
+ * @param pool Pool handle
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if a buffer is still handed out
+ */
+esp_err_t example_encoder_pool_delete(example_encoder_pool_handle_t pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file example_jpeg_sched.h
+ * @brief Priority job queue in front of the single JPEG engine
+ *
+ * Every encoder instance shares one worker task that runs the encode jobs
+ * one at a time, the most urgent first and in submission order within a
+ * priority. Each job carries its own encoder configuration, so instances
+ * with different sizes, formats and qualities can share the engine.
+ *
+ * Still jobs (screenshots, captures) must not delay frames. The scheduler
+ * learns the arrival interval of the live and preview jobs and how long a
+ * still job takes, and only starts a still job when it will be done
+ * before the next frame is expected. A still job that never finds such a
+ * gap waits until the streams pause or stop; only if still_max_wait_ms is
+ * set does it run anyway after that long, at the cost of delaying a frame.
+ *
+ * The scheduler only needs FreeRTOS semaphores and tasks, so the same
+ * queueing runs on the host for tests.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXAMPLE_JPEG_SCHED_MAX_JOBS     8
+
+/**
+ * @brief JPEG job priority, most urgent first
+ */
+typedef enum example_jpeg_prio {
+    EXAMPLE_JPEG_PRIO_LIVE = 0,         /**< Live stream frames, e.g. the emulator display */
+    EXAMPLE_JPEG_PRIO_PREVIEW,          /**< Camera preview frames */
+    EXAMPLE_JPEG_PRIO_STILL,            /**< Screenshots and captures, run between frames */
+    EXAMPLE_JPEG_PRIO_COUNT,
+} example_jpeg_prio_t;
+
+typedef void *example_jpeg_sched_handle_t;
+
+/**
+ * @brief Job body, runs on the scheduler task
+ */
+typedef esp_err_t (*example_jpeg_job_fn_t)(void *ctx);
+
+/**
+ * @brief JPEG scheduler configuration
+ */
+typedef struct example_jpeg_sched_config {
+    uint32_t stack_size;                /**< Worker task stack size */
+    uint32_t task_priority;             /**< Worker task priority */
+    uint32_t still_max_wait_ms;         /**< Longest a still job waits for a gap, 0: until there is one */
+} example_jpeg_sched_config_t;
+
+/**
+ * @brief JPEG scheduler statistics
+ */
+typedef struct example_jpeg_sched_stats {
+    uint32_t jobs[EXAMPLE_JPEG_PRIO_COUNT];             /**< Jobs run */
+    uint32_t wait_max_us[EXAMPLE_JPEG_PRIO_COUNT];      /**< Longest time from submission to start */
+    uint64_t wait_total_us[EXAMPLE_JPEG_PRIO_COUNT];
+    uint32_t run_avg_us[EXAMPLE_JPEG_PRIO_COUNT];       /**< Smoothed job duration */
+    uint32_t interval_avg_us[EXAMPLE_JPEG_PRIO_COUNT];  /**< Smoothed time between submissions */
+    uint32_t still_forced;                              /**< Still jobs run without a gap after still_max_wait_ms, if set */
+    uint32_t max_queued;                                /**< Most jobs queued at once */
+} example_jpeg_sched_stats_t;
+
+/**
+ * @brief Create the scheduler and start its worker task
+ *
+ * @param config Scheduler configuration
+ * @param ret_handle Scheduler handle
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_jpeg_sched_create(const example_jpeg_sched_config_t *config, example_jpeg_sched_handle_t *ret_handle);
+
+/**
+ * @brief Run a job on the scheduler task and wait for it
+ *
+ * Blocks while EXAMPLE_JPEG_SCHED_MAX_JOBS jobs are already queued.
+ *
+ * @param handle Scheduler handle
+ * @param prio Job priority
+ * @param fn Job body
+ * @param ctx Argument of @p fn
+ *
+ * @return The result of @p fn, or ESP_ERR_INVALID_ARG
+ */
+esp_err_t example_jpeg_sched_run(example_jpeg_sched_handle_t handle, example_jpeg_prio_t prio,
+                                 example_jpeg_job_fn_t fn, void *ctx);
+
+/**
+ * @brief Get the scheduler statistics
+ *
+ * @param handle Scheduler handle
+ * @param stats Scheduler statistics
+ */
+void example_jpeg_sched_get_stats(example_jpeg_sched_handle_t handle, example_jpeg_sched_stats_t *stats);
+
+/**
+ * @brief Stop the worker task and free the scheduler
+ *
+ * @param handle Scheduler handle
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if jobs are still queued
+ */
+esp_err_t example_jpeg_sched_delete(example_jpeg_sched_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,8 @@
 #include "esp_video_init.h"
 #include "esp_video_ioctl.h"
 #include "example_video_common_board.h"
+#include "example_jpeg_sched.h"
+#include "example_encoder_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -168,11 +170,6 @@ extern "C" {
 #define EXAMPLE_CAM_DEV_PATH                            ESP_VIDEO_SPI_DEVICE_NAME
 #endif /* CONFIG_EXAMPLE_ENABLE_MIPI_CSI_CAM_SENSOR */
 
-/**
- * @brief Example encoder handle
- */
-typedef void *example_encoder_handle_t;
-
 /**
  * @brief Example encoder configuration
  */
@@ -183,6 +180,14 @@ typedef struct example_encoder_config {
     uint8_t quality;            /**< Image quality */
 } example_encoder_config_t;
 
+/**
+ * @brief Example encoder per-job settings
+ */
+typedef struct example_encoder_job_config {
+    example_jpeg_prio_t priority;   /**< Queue priority on the shared JPEG engine */
+    uint8_t quality;                /**< JPEG quality of this job, 0: the encoder's quality */
+} example_encoder_job_config_t;
+
 /**
  * @brief Initialize the video system
  *
@@ -243,10 +248,40 @@ esp_err_t example_encoder_free_output_buffer(example_encoder_handle_t handle, ui
 esp_err_t example_encoder_process(example_encoder_handle_t handle, uint8_t *src_buf, uint32_t src_size, uint8_t *dst_buf, uint32_t dst_size, uint32_t *dst_size_out);
 
 /**
- * @brief Set the JPEG quality
+ * @brief Process the encoder with per-job settings
+ *
+ * All encoder instances share one JPEG engine. Jobs queue in front of it
+ * by priority and run with the size, format and quality of their encoder,
+ * or the job's own quality. example_encoder_process() submits live jobs.
+ *
+ * @param handle Encoder handle
+ * @param job_config Job priority and quality
+ * @param src_buf Source buffer
+ * @param src_size Source buffer size
+ * @param dst_buf Destination buffer
+ * @param dst_size Destination buffer size
+ * @param dst_size_out Output destination buffer size
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t example_encoder_process_job(example_encoder_handle_t handle, const example_encoder_job_config_t *job_config,
+                                      uint8_t *src_buf, uint32_t src_size,
+                                      uint8_t *dst_buf, uint32_t dst_size, uint32_t *dst_size_out);
+
+/**
+ * @brief Get the statistics of the scheduler in front of the shared JPEG engine
+ *
+ * @param stats Scheduler statistics
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if no encoder is initialized
+ */
+esp_err_t example_encoder_get_sched_stats(example_jpeg_sched_stats_t *stats);
+
+/**
+ * @brief Set the JPEG quality of the jobs submitted from now on
  *
  * @param handle Encoder handle
- * @param quality JPEG quality
+ * @param quality JPEG quality, 1 to 100
  *
  * @return ESP_OK on success or other value on failure
  */
@@ -16,6 +16,92 @@ export type Resolution = {
   height: number;
 };
 
+export type StreamClient = {
+  socket: number;
+  queueDepth: number;
+  framesSent: number;
+  framesDropped: number;
+};
+
+export type WsStreamClient = {
+  socket: number;
+  refreshHz: number;
+  ticks: number;
+  lateTicks: number;
+  repeats: number;
+  framesSent: number;
+  framesDropped: number;
+  audioMessages: number;
+  audioSamples: number;
+  audioMaxBacklog: number;
+};
+
+export type StageLatency = {
+  count: number;
+  avgUs: number;
+  p50Us: number;
+  p99Us: number;
+  maxUs: number;
+  buckets: number[];
+};
+
+export type AdaptiveQuality = {
+  quality: number;
+  maxQuality: number;
+  skip: number;
+  budgetBytes: number;
+  frameBytes: number;
+  linkBytesPerS: number;
+  latencyUs: number;
+  queueDepth: number;
+  adjustments: number;
+  framesSkipped: number;
+};
+
+export type OutputPool = {
+  targetSize: number;
+  maxSize: number;
+  buffers: number;
+  inUse: number;
+  allocatedBytes: number;
+  peakBytes: number;
+  largestFrame: number;
+  grows: number;
+  shrinks: number;
+  overflows: number;
+};
+
+export type JpegJobStats = {
+  jobs: number;
+  waitMaxUs: number;
+  waitAvgUs: number;
+  runAvgUs: number;
+  intervalAvgUs: number;
+};
+
+export type JpegEngineStats = {
+  live: JpegJobStats;
+  preview: JpegJobStats;
+  still: JpegJobStats;
+  stillForced: number;
+  maxQueued: number;
+};
+
+export type StreamStats = {
+  framesEncoded: number;
+  framesDropped: number;
+  bufferCount: number;
+  clients: StreamClient[];
+  wsClients?: WsStreamClient[];
+  captureDropped?: number;
+  encodeErrors?: number;
+  latencyBucketBaseUs?: number;
+  latency?: Record<'dequeue' | 'queue' | 'encode' | 'send' | 'total', StageLatency>;
+  adaptive?: AdaptiveQuality;
+  outputPool?: OutputPool;
+  jpegEngine?: JpegEngineStats;
+};
+
 export type Camera = {
   index: string | number;
   name?: string;
@@ -26,4 +112,5 @@ export type Camera = {
   currentQuality?: number;
   currentResolution: Resolution;
   imageFormats: ImageFormat[];
+  stream?: StreamStats;
 };
@@ -0,0 +1,324 @@
+/**
+ * @file frame_pipeline.c
+ * @brief Capture, encode and send as separate stages for the stream ring
+ */
+
+#include <string.h>
+#include <time.h>
+#include "freertos/task.h"
+#include "frame_pipeline.h"
+
+#define FRAME_PIPELINE_POLL_MS  100     // How often idle tasks look at running
+
+static const char *const s_stage_names[FRAME_STAGE_COUNT] = {
+    [FRAME_STAGE_DEQUEUE] = "dequeue",
+    [FRAME_STAGE_QUEUE]   = "queue",
+    [FRAME_STAGE_ENCODE]  = "encode",
+    [FRAME_STAGE_SEND]    = "send",
+    [FRAME_STAGE_TOTAL]   = "total",
+};
+
+int64_t frame_pipeline_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void frame_hist_add(frame_hist_t *hist, uint32_t us)
+{
+    int i = 0;
+
+    while (i < FRAME_HIST_BUCKETS - 1 && us >= ((uint32_t)FRAME_HIST_BASE_US << i)) {
+        i++;
+    }
+    hist->bucket[i]++;
+    hist->count++;
+    hist->total_us += us;
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+}
+
+uint32_t frame_hist_percentile(const frame_hist_t *hist, int percent)
+{
+    uint64_t target = ((uint64_t)hist->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+    for (int i = 0; i < FRAME_HIST_BUCKETS - 1; i++) {
+        seen += hist->bucket[i];
+        if (seen >= target) {
+            uint32_t bound = (uint32_t)FRAME_HIST_BASE_US << i;
+            return bound < hist->max_us ? bound : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
+
+const char *frame_pipeline_stage_name(frame_stage_t stage)
+{
+    return stage < FRAME_STAGE_COUNT ? s_stage_names[stage] : "unknown";
+}
+
+static void record(frame_pipeline_t *pipeline, frame_stage_t stage, int64_t us)
+{
+    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+    frame_hist_add(&pipeline->hist[stage], us > 0 ? (uint32_t)us : 0);
+    xSemaphoreGive(pipeline->lock);
+}
+
+static void count(frame_pipeline_t *pipeline, uint32_t *counter)
+{
+    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+    (*counter)++;
+    xSemaphoreGive(pipeline->lock);
+}
+
+/**
+ * @brief Ask the controller whether to encode this frame and at which quality
+ */
+static bool quality_begin_frame(frame_pipeline_t *pipeline, const frame_pipeline_buf_t *buf)
+{
+    const frame_pipeline_config_t *config = &pipeline->config;
+
+    if (!config->quality) {
+        return true;
+    }
+
+    uint32_t depth = frame_ring_max_queue_depth(config->ring);
+    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+    bool encode = quality_ctrl_begin_frame(config->quality, depth);
+    uint8_t quality = config->quality->quality;
+    xSemaphoreGive(pipeline->lock);
+
+    if (encode && quality != pipeline->encoder_quality && config->ops->set_quality) {
+        if (config->ops->set_quality(config->ctx, quality) == ESP_OK) {
+            pipeline->encoder_quality = quality;
+        }
+    }
+    return encode;
+}
+
+static void capture_task(void *arg)
+{
+    frame_pipeline_t *pipeline = (frame_pipeline_t *)arg;
+    const frame_pipeline_config_t *config = &pipeline->config;
+
+    while (pipeline->running) {
+        frame_pipeline_buf_t buf;
+
+        /* Nobody watching: leave the camera buffers with the driver */
+        if (!frame_ring_wait_readers(config->ring, pdMS_TO_TICKS(FRAME_PIPELINE_POLL_MS))) {
+            continue;
+        }
+
+        int64_t start_us = frame_pipeline_now_us();
+        esp_err_t ret = config->ops->dequeue(config->ctx, pdMS_TO_TICKS(FRAME_PIPELINE_POLL_MS), &buf);
+        if (ret == ESP_ERR_TIMEOUT) {
+            continue;
+        } else if (ret != ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        buf.capture_us = frame_pipeline_now_us();
+        record(pipeline, FRAME_STAGE_DEQUEUE, buf.capture_us - start_us);
+
+        /* The frame rate counts frames dropped here too, not just those encoded */
+        if (config->quality) {
+            xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+            quality_ctrl_on_capture(config->quality, buf.capture_us);
+            xSemaphoreGive(pipeline->lock);
+        }
+
+        if (xQueueSend(pipeline->encode_queue, &buf, 0) != pdPASS) {
+            config->ops->requeue(config->ctx, &buf);
+            count(pipeline, &pipeline->capture_drops);
+        }
+    }
+
+    xSemaphoreGive(pipeline->done);
+    vTaskDelete(NULL);
+}
+
+static void encode_task(void *arg)
+{
+    frame_pipeline_t *pipeline = (frame_pipeline_t *)arg;
+    const frame_pipeline_config_t *config = &pipeline->config;
+
+    while (pipeline->running) {
+        frame_pipeline_buf_t buf;
+        uint32_t len = 0;
+        esp_err_t ret = ESP_OK;
+
+        if (xQueueReceive(pipeline->encode_queue, &buf, pdMS_TO_TICKS(FRAME_PIPELINE_POLL_MS)) != pdPASS) {
+            continue;
+        }
+
+        int64_t start_us = frame_pipeline_now_us();
+        record(pipeline, FRAME_STAGE_QUEUE, start_us - buf.capture_us);
+
+        if (!quality_begin_frame(pipeline, &buf)) {
+            config->ops->requeue(config->ctx, &buf);
+            continue;
+        }
+
+        /* NULL: every slot is still being sent, the ring counts the drop */
+        frame_ring_slot_t *slot = frame_ring_begin_write(config->ring);
+        if (slot) {
+            if (config->ops->prepare_output) {
+                config->ops->prepare_output(config->ctx, &slot->buf, &slot->size);
+            }
+            if (slot->buf) {
+                ret = config->ops->encode(config->ctx, &buf, slot->buf, slot->size, &len);
+            } else {
+                ret = ESP_ERR_NO_MEM;
+            }
+            record(pipeline, FRAME_STAGE_ENCODE, frame_pipeline_now_us() - start_us);
+        }
+        config->ops->requeue(config->ctx, &buf);
+
+        if (slot) {
+            if (ret == ESP_OK) {
+                frame_ring_commit(config->ring, slot, len, buf.capture_us);
+                if (config->quality) {
+                    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+                    quality_ctrl_on_encoded(config->quality, len);
+                    xSemaphoreGive(pipeline->lock);
+                }
+            } else {
+                frame_ring_abort(config->ring, slot);
+                count(pipeline, &pipeline->encode_errors);
+            }
+        }
+    }
+
+    xSemaphoreGive(pipeline->done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t frame_pipeline_start(frame_pipeline_t *pipeline, const frame_pipeline_config_t *config)
+{
+    if (!pipeline || !config || !config->ops || !config->ring || config->buffer_count < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->config = *config;
+    pipeline->encode_queue = xQueueCreate(config->buffer_count - 1, sizeof(frame_pipeline_buf_t));
+    pipeline->lock = xSemaphoreCreateMutex();
+    pipeline->done = xSemaphoreCreateCounting(2, 0);
+    if (!pipeline->encode_queue || !pipeline->lock || !pipeline->done) {
+        goto fail0;
+    }
+
+    pipeline->running = true;
+    if (xTaskCreate(capture_task, "frame_capture", config->stack_size, pipeline, config->priority, NULL) != pdPASS) {
+        goto fail0;
+    }
+    if (xTaskCreate(encode_task, "frame_encode", config->stack_size, pipeline, config->priority, NULL) != pdPASS) {
+        pipeline->running = false;
+        xSemaphoreTake(pipeline->done, portMAX_DELAY);
+        goto fail0;
+    }
+
+    return ESP_OK;
+
+fail0:
+    pipeline->running = false;
+    if (pipeline->done) {
+        vSemaphoreDelete(pipeline->done);
+    }
+    if (pipeline->lock) {
+        vSemaphoreDelete(pipeline->lock);
+    }
+    if (pipeline->encode_queue) {
+        vQueueDelete(pipeline->encode_queue);
+    }
+    memset(pipeline, 0, sizeof(*pipeline));
+    return ESP_ERR_NO_MEM;
+}
+
+void frame_pipeline_stop(frame_pipeline_t *pipeline)
+{
+    frame_pipeline_buf_t buf;
+
+    if (!pipeline->running) {
+        return;
+    }
+
+    pipeline->running = false;
+    xSemaphoreTake(pipeline->done, portMAX_DELAY);
+    xSemaphoreTake(pipeline->done, portMAX_DELAY);
+
+    while (xQueueReceive(pipeline->encode_queue, &buf, 0) == pdPASS) {
+        pipeline->config.ops->requeue(pipeline->config.ctx, &buf);
+    }
+
+    vSemaphoreDelete(pipeline->done);
+    vSemaphoreDelete(pipeline->lock);
+    vQueueDelete(pipeline->encode_queue);
+    memset(pipeline, 0, sizeof(*pipeline));
+}
+
+static int client_index(const frame_pipeline_t *pipeline, const frame_ring_client_t *client)
+{
+    return (int)(client - pipeline->config.ring->clients);
+}
+
+void frame_pipeline_record_send(frame_pipeline_t *pipeline, const frame_ring_client_t *client,
+                                int64_t start_us, int64_t capture_us, uint32_t bytes)
+{
+    int64_t now_us = frame_pipeline_now_us();
+    uint32_t send_us = (uint32_t)(now_us - start_us);
+    uint32_t total_us = (uint32_t)(now_us - capture_us);
+
+    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+    frame_hist_add(&pipeline->hist[FRAME_STAGE_SEND], send_us);
+    frame_hist_add(&pipeline->hist[FRAME_STAGE_TOTAL], total_us);
+    if (pipeline->config.quality) {
+        quality_ctrl_on_sent(pipeline->config.quality, client_index(pipeline, client), bytes, send_us, total_us);
+    }
+    xSemaphoreGive(pipeline->lock);
+}
+
+void frame_pipeline_remove_client(frame_pipeline_t *pipeline, const frame_ring_client_t *client)
+{
+    if (!pipeline->config.quality) {
+        return;
+    }
+
+    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+    quality_ctrl_remove_client(pipeline->config.quality, client_index(pipeline, client));
+    xSemaphoreGive(pipeline->lock);
+}
+
+void frame_pipeline_set_max_quality(frame_pipeline_t *pipeline, uint8_t max_quality)
+{
+    if (!pipeline->config.quality) {
+        return;
+    }
+
+    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+    quality_ctrl_set_max_quality(pipeline->config.quality, max_quality);
+    xSemaphoreGive(pipeline->lock);
+
+    /* The caller has just set the encoder itself, reapply on the next frame */
+    pipeline->encoder_quality = 0;
+}
+
+void frame_pipeline_get_stats(frame_pipeline_t *pipeline, frame_pipeline_stats_t *stats)
+{
+    xSemaphoreTake(pipeline->lock, portMAX_DELAY);
+    stats->capture_drops = pipeline->capture_drops;
+    stats->encode_errors = pipeline->encode_errors;
+    stats->adaptive = pipeline->config.quality != NULL;
+    if (stats->adaptive) {
+        stats->quality = *pipeline->config.quality;
+    }
+    memcpy(stats->hist, pipeline->hist, sizeof(stats->hist));
+    xSemaphoreGive(pipeline->lock);
+}
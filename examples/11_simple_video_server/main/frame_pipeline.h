@@ -0,0 +1,188 @@
+/**
+ * @file frame_pipeline.h
+ * @brief Capture, encode and send as separate stages for the stream ring
+ *
+ * The capture task dequeues camera buffers and hands them to the encode
+ * task through a bounded queue; the encode task writes JPEGs into the
+ * frame ring and returns the camera buffers; stream clients send from the
+ * ring in their own tasks. While the socket drains, the encoder is
+ * already working on the next frame and the driver refilling the
+ * previous buffer.
+ *
+ * The queue holds at most one buffer fewer than the driver has, so the
+ * driver always has one to fill. When it is full, the capture stage hands
+ * the newest buffer straight back and counts a drop rather than stalling.
+ *
+ * Each stage records its latency in a histogram of power-of-two buckets.
+ *
+ * With a quality controller configured, the encode task asks it about
+ * every frame, skips the frames it says to skip and passes quality
+ * changes to the encoder; sent frames feed it back through
+ * frame_pipeline_record_send().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "frame_ring.h"
+#include "quality_ctrl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_HIST_BUCKETS      13
+#define FRAME_HIST_BASE_US      250     // Upper bound of bucket 0, doubling per bucket
+
+/**
+ * @brief Latency histogram, bucket i counts samples below FRAME_HIST_BASE_US << i
+ *
+ * The last bucket takes everything longer.
+ */
+typedef struct frame_hist {
+    uint32_t bucket[FRAME_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+} frame_hist_t;
+
+typedef enum {
+    FRAME_STAGE_DEQUEUE = 0,    // Waiting for the camera
+    FRAME_STAGE_QUEUE,          // Captured, waiting for the encoder
+    FRAME_STAGE_ENCODE,
+    FRAME_STAGE_SEND,           // One frame to one client
+    FRAME_STAGE_TOTAL,          // Capture to sent
+    FRAME_STAGE_COUNT,
+} frame_stage_t;
+
+typedef struct frame_pipeline_buf {
+    uint32_t index;             // Driver buffer index
+    uint8_t *data;
+    uint32_t size;
+    int64_t capture_us;         // CLOCK_MONOTONIC
+} frame_pipeline_buf_t;
+
+/**
+ * @brief Frame source and encoder the pipeline drives
+ */
+typedef struct frame_pipeline_ops {
+    /**
+     * @brief Wait for the next captured buffer
+     *
+     * A source that keeps streaming may block past @p timeout; it only
+     * bounds how long frame_pipeline_stop() waits.
+     *
+     * @return ESP_ERR_TIMEOUT if none arrived within @p timeout
+     */
+    esp_err_t (*dequeue)(void *ctx, TickType_t timeout, frame_pipeline_buf_t *buf);
+
+    /**
+     * @brief Give a buffer back to the source
+     */
+    void (*requeue)(void *ctx, const frame_pipeline_buf_t *buf);
+
+    /**
+     * @brief Swap the ring slot buffer for one sized for the next frame, optional
+     *
+     * Leaves @p dst alone if it still fits or no other buffer is available.
+     * @p dst is NULL for a slot whose buffer the ring has given back; the
+     * frame is dropped if it stays NULL.
+     */
+    void (*prepare_output)(void *ctx, uint8_t **dst, uint32_t *dst_size);
+
+    esp_err_t (*encode)(void *ctx, const frame_pipeline_buf_t *buf, uint8_t *dst, uint32_t dst_size, uint32_t *dst_size_out);
+
+    /**
+     * @brief Change the JPEG quality of the following encodes, optional
+     */
+    esp_err_t (*set_quality)(void *ctx, uint8_t quality);
+} frame_pipeline_ops_t;
+
+typedef struct frame_pipeline_config {
+    const frame_pipeline_ops_t *ops;
+    void *ctx;
+    frame_ring_t *ring;         // Encoded frames go here
+    quality_ctrl_t *quality;    // Initialized by the caller, NULL: fixed quality
+    int buffer_count;           // Buffers the source has, at least 2
+    uint32_t stack_size;
+    int priority;
+} frame_pipeline_config_t;
+
+typedef struct frame_pipeline {
+    frame_pipeline_config_t config;
+    QueueHandle_t encode_queue;
+    SemaphoreHandle_t lock;     // Guards hist, the counters and the quality controller
+    SemaphoreHandle_t done;     // Given by each task as it exits
+    volatile bool running;
+    uint32_t capture_drops;     // Encoder queue full
+    uint32_t encode_errors;
+    uint8_t encoder_quality;    // Last quality passed to set_quality, 0: none yet
+    frame_hist_t hist[FRAME_STAGE_COUNT];
+} frame_pipeline_t;
+
+typedef struct frame_pipeline_stats {
+    uint32_t capture_drops;
+    uint32_t encode_errors;
+    bool adaptive;              // quality is valid
+    quality_ctrl_t quality;
+    frame_hist_t hist[FRAME_STAGE_COUNT];
+} frame_pipeline_stats_t;
+
+/**
+ * @brief Start the capture and encode tasks
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t frame_pipeline_start(frame_pipeline_t *pipeline, const frame_pipeline_config_t *config);
+
+/**
+ * @brief Stop both tasks and return every queued buffer to the source
+ */
+void frame_pipeline_stop(frame_pipeline_t *pipeline);
+
+/**
+ * @brief Record one frame sent to one client
+ *
+ * @param client The ring client it was sent to; the controller budgets for the slowest one
+ * @param capture_us Capture time of the frame, from its ring slot
+ * @param bytes Size of the frame
+ */
+void frame_pipeline_record_send(frame_pipeline_t *pipeline, const frame_ring_client_t *client,
+                                int64_t start_us, int64_t capture_us, uint32_t bytes);
+
+/**
+ * @brief Drop a leaving client's throughput from the controller, call before frame_ring_detach()
+ */
+void frame_pipeline_remove_client(frame_pipeline_t *pipeline, const frame_ring_client_t *client);
+
+/**
+ * @brief Cap the quality the controller may pick
+ *
+ * Does nothing without a quality controller. The controller's quality is
+ * passed to the encoder again on the next frame.
+ */
+void frame_pipeline_set_max_quality(frame_pipeline_t *pipeline, uint8_t max_quality);
+
+void frame_pipeline_get_stats(frame_pipeline_t *pipeline, frame_pipeline_stats_t *stats);
+
+const char *frame_pipeline_stage_name(frame_stage_t stage);
+
+int64_t frame_pipeline_now_us(void);
+
+void frame_hist_add(frame_hist_t *hist, uint32_t us);
+
+/**
+ * @brief Upper bound of the bucket holding the given percentile
+ *
+ * @return 0 for an empty histogram, max_us for the last bucket
+ */
+uint32_t frame_hist_percentile(const frame_hist_t *hist, int percent);
+
+#ifdef __cplusplus
+}
+#endif
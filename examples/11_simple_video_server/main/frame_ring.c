@@ -0,0 +1,263 @@
+/**
+ * @file frame_ring.c
+ * @brief Refcounted ring of encoded frames shared by all stream clients
+ */
+
+#include <string.h>
+#include "frame_ring.h"
+
+esp_err_t frame_ring_init(frame_ring_t *ring, uint8_t *const bufs[], int count, uint32_t size)
+{
+    if (!ring || !bufs || count < 2 || count > FRAME_RING_MAX_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->lock = xSemaphoreCreateMutex();
+    ring->readers = xSemaphoreCreateBinary();
+    for (int i = 0; i < FRAME_RING_MAX_CLIENTS; i++) {
+        ring->clients[i].ready = xSemaphoreCreateBinary();
+        if (!ring->clients[i].ready) {
+            frame_ring_deinit(ring);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!ring->lock || !ring->readers) {
+        frame_ring_deinit(ring);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < count; i++) {
+        ring->slots[i].buf = bufs[i];
+        ring->slots[i].size = size;
+    }
+    ring->slot_count = count;
+    return ESP_OK;
+}
+
+void frame_ring_deinit(frame_ring_t *ring)
+{
+    for (int i = 0; i < FRAME_RING_MAX_CLIENTS; i++) {
+        if (ring->clients[i].ready) {
+            vSemaphoreDelete(ring->clients[i].ready);
+        }
+    }
+    if (ring->readers) {
+        vSemaphoreDelete(ring->readers);
+    }
+    if (ring->lock) {
+        vSemaphoreDelete(ring->lock);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+void frame_ring_set_release_buf(frame_ring_t *ring, frame_ring_release_buf_t release_buf, void *ctx)
+{
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    ring->release_buf = release_buf;
+    ring->release_ctx = ctx;
+    xSemaphoreGive(ring->lock);
+}
+
+/**
+ * @brief Detach the buffer of a slot no client can read any more, called with the lock held
+ *
+ * @return The buffer to hand to release_buf once the lock is dropped, or NULL
+ */
+static uint8_t *frame_ring_unread_buf(frame_ring_t *ring, frame_ring_slot_t *slot)
+{
+    uint8_t *buf = slot->buf;
+
+    if (!ring->release_buf || !buf || slot->refs || slot == ring->latest) {
+        return NULL;
+    }
+    slot->buf = NULL;
+    slot->size = 0;
+    return buf;
+}
+
+esp_err_t frame_ring_attach(frame_ring_t *ring, int sockfd, frame_ring_client_t **ret_client)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    for (int i = 0; i < FRAME_RING_MAX_CLIENTS; i++) {
+        frame_ring_client_t *client = &ring->clients[i];
+
+        if (!client->in_use) {
+            client->in_use = true;
+            client->sockfd = sockfd;
+            client->last_seq = ring->seq;
+            client->sent = 0;
+            client->dropped = 0;
+            xSemaphoreTake(client->ready, 0);
+            ring->client_count++;
+            *ret_client = client;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(ring->lock);
+
+    if (ret == ESP_OK) {
+        xSemaphoreGive(ring->readers);
+    }
+    return ret;
+}
+
+void frame_ring_detach(frame_ring_t *ring, frame_ring_client_t *client)
+{
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    client->in_use = false;
+    ring->client_count--;
+    xSemaphoreGive(ring->lock);
+}
+
+bool frame_ring_wait_readers(frame_ring_t *ring, TickType_t timeout)
+{
+    while (1) {
+        xSemaphoreTake(ring->lock, portMAX_DELAY);
+        int count = ring->client_count;
+        xSemaphoreGive(ring->lock);
+
+        if (count > 0) {
+            return true;
+        }
+        if (xSemaphoreTake(ring->readers, timeout) != pdPASS) {
+            return false;
+        }
+    }
+}
+
+frame_ring_slot_t *frame_ring_begin_write(frame_ring_t *ring)
+{
+    frame_ring_slot_t *slot = NULL;
+
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    for (int i = 0; i < ring->slot_count; i++) {
+        frame_ring_slot_t *s = &ring->slots[i];
+
+        /* Clients only ever take the latest frame, so any other unreferenced slot is free */
+        if (s->refs == 0 && s != ring->latest && (!slot || s->seq < slot->seq)) {
+            slot = s;
+        }
+    }
+    if (slot) {
+        slot->seq = 0;
+    } else {
+        ring->producer_drops++;
+    }
+    xSemaphoreGive(ring->lock);
+
+    return slot;
+}
+
+void frame_ring_commit(frame_ring_t *ring, frame_ring_slot_t *slot, uint32_t len, int64_t timestamp_us)
+{
+    uint8_t *unread = NULL;
+
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    frame_ring_slot_t *prev = ring->latest;
+    slot->len = len;
+    slot->timestamp_us = timestamp_us;
+    slot->seq = ++ring->seq;
+    ring->latest = slot;
+    if (prev) {
+        unread = frame_ring_unread_buf(ring, prev);
+    }
+    for (int i = 0; i < FRAME_RING_MAX_CLIENTS; i++) {
+        if (ring->clients[i].in_use) {
+            xSemaphoreGive(ring->clients[i].ready);
+        }
+    }
+    xSemaphoreGive(ring->lock);
+
+    if (unread) {
+        ring->release_buf(ring->release_ctx, unread);
+    }
+}
+
+void frame_ring_abort(frame_ring_t *ring, frame_ring_slot_t *slot)
+{
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    slot->len = 0;
+    xSemaphoreGive(ring->lock);
+}
+
+esp_err_t frame_ring_read(frame_ring_t *ring, frame_ring_client_t *client, TickType_t timeout,
+                          const frame_ring_slot_t **ret_slot)
+{
+    while (1) {
+        xSemaphoreTake(ring->lock, portMAX_DELAY);
+        frame_ring_slot_t *slot = ring->latest;
+        if (slot && slot->seq != client->last_seq) {
+            client->dropped += slot->seq - client->last_seq - 1;
+            client->last_seq = slot->seq;
+            slot->refs++;
+            xSemaphoreGive(ring->lock);
+
+            *ret_slot = slot;
+            return ESP_OK;
+        }
+        xSemaphoreGive(ring->lock);
+
+        if (xSemaphoreTake(client->ready, timeout) != pdPASS) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+}
+
+void frame_ring_release(frame_ring_t *ring, frame_ring_client_t *client, const frame_ring_slot_t *slot, bool sent)
+{
+    uint8_t *unread;
+
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    ((frame_ring_slot_t *)slot)->refs--;
+    if (sent) {
+        client->sent++;
+    }
+    unread = frame_ring_unread_buf(ring, (frame_ring_slot_t *)slot);
+    xSemaphoreGive(ring->lock);
+
+    if (unread) {
+        ring->release_buf(ring->release_ctx, unread);
+    }
+}
+
+void frame_ring_get_stats(frame_ring_t *ring, frame_ring_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    stats->published = ring->seq;
+    stats->producer_drops = ring->producer_drops;
+    for (int i = 0; i < FRAME_RING_MAX_CLIENTS; i++) {
+        const frame_ring_client_t *client = &ring->clients[i];
+
+        if (client->in_use) {
+            frame_ring_client_stats_t *cs = &stats->clients[stats->client_count++];
+            cs->sockfd = client->sockfd;
+            cs->queue_depth = ring->seq - client->last_seq;
+            cs->sent = client->sent;
+            cs->dropped = client->dropped;
+        }
+    }
+    xSemaphoreGive(ring->lock);
+}
+
+uint32_t frame_ring_max_queue_depth(frame_ring_t *ring)
+{
+    uint32_t depth = 0;
+
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    for (int i = 0; i < FRAME_RING_MAX_CLIENTS; i++) {
+        const frame_ring_client_t *client = &ring->clients[i];
+
+        if (client->in_use && ring->seq - client->last_seq > depth) {
+            depth = ring->seq - client->last_seq;
+        }
+    }
+    xSemaphoreGive(ring->lock);
+
+    return depth;
+}
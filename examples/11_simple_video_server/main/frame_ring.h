@@ -0,0 +1,165 @@
+/**
+ * @file frame_ring.h
+ * @brief Refcounted ring of encoded frames shared by all stream clients
+ *
+ * One producer per camera encodes each frame once into a free slot and
+ * publishes it. Every client reads the most recent frame by reference and
+ * sends it straight from the slot, so N viewers cost one encode and no
+ * copies. A client that falls behind skips to the newest frame and counts
+ * the ones it missed. The producer never waits for a client: if every
+ * slot is still referenced, it drops the frame instead.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_RING_MAX_SLOTS    8
+#define FRAME_RING_MAX_CLIENTS  6       // Per camera, /stream and /ws/stream clients together
+
+/**
+ * @brief Takes back the buffer of a slot no client can read any more
+ */
+typedef void (*frame_ring_release_buf_t)(void *ctx, uint8_t *buf);
+
+typedef struct frame_ring_slot {
+    uint8_t *buf;               // The producer may swap it between begin_write and commit, NULL once given back
+    uint32_t size;              // Capacity of buf
+    uint32_t len;               // Bytes of the published frame
+    uint32_t seq;               // Frame number, 0 while unused
+    int64_t timestamp_us;       // Capture time, CLOCK_MONOTONIC
+    uint16_t refs;              // Clients sending from this slot
+} frame_ring_slot_t;
+
+typedef struct frame_ring_client {
+    bool in_use;
+    int sockfd;
+    SemaphoreHandle_t ready;    // Given on every published frame
+    uint32_t last_seq;          // Last frame read
+    uint32_t sent;
+    uint32_t dropped;           // Frames published but never read
+} frame_ring_client_t;
+
+typedef struct frame_ring {
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t readers;  // Given when a client attaches
+    frame_ring_slot_t slots[FRAME_RING_MAX_SLOTS];
+    int slot_count;
+    frame_ring_slot_t *latest;
+    uint32_t seq;
+    uint32_t producer_drops;    // No free slot to encode into
+    frame_ring_release_buf_t release_buf;
+    void *release_ctx;
+    int client_count;
+    frame_ring_client_t clients[FRAME_RING_MAX_CLIENTS];
+} frame_ring_t;
+
+typedef struct frame_ring_client_stats {
+    int sockfd;
+    uint32_t queue_depth;       // Frames published since the last one read
+    uint32_t sent;
+    uint32_t dropped;
+} frame_ring_client_stats_t;
+
+typedef struct frame_ring_stats {
+    uint32_t published;
+    uint32_t producer_drops;
+    int client_count;
+    frame_ring_client_stats_t clients[FRAME_RING_MAX_CLIENTS];
+} frame_ring_stats_t;
+
+/**
+ * @brief Initialize the ring over caller-owned buffers
+ *
+ * @param bufs Slot buffers of @p size bytes each
+ * @param count Number of slots, 2 to FRAME_RING_MAX_SLOTS
+ *
+ * @return ESP_OK on success or other value on failure
+ */
+esp_err_t frame_ring_init(frame_ring_t *ring, uint8_t *const bufs[], int count, uint32_t size);
+
+/**
+ * @brief Free the ring's semaphores, the slot buffers stay with the caller
+ */
+void frame_ring_deinit(frame_ring_t *ring);
+
+/**
+ * @brief Give each slot buffer to @p release_buf as soon as no client can read its frame
+ *
+ * That is when its last reader releases a slot that is no longer the
+ * latest, or when a new frame replaces a latest frame nobody is sending.
+ * The slot is left with a NULL buffer and the producer provides a new one
+ * before writing to it again. Without this, slots keep their buffers.
+ */
+void frame_ring_set_release_buf(frame_ring_t *ring, frame_ring_release_buf_t release_buf, void *ctx);
+
+/**
+ * @brief Register a client, which then reads frames published after this call
+ *
+ * @return ESP_ERR_NO_MEM if FRAME_RING_MAX_CLIENTS are attached
+ */
+esp_err_t frame_ring_attach(frame_ring_t *ring, int sockfd, frame_ring_client_t **ret_client);
+
+void frame_ring_detach(frame_ring_t *ring, frame_ring_client_t *client);
+
+/**
+ * @brief Block the producer until at least one client is attached
+ *
+ * @return true if a client is attached
+ */
+bool frame_ring_wait_readers(frame_ring_t *ring, TickType_t timeout);
+
+/**
+ * @brief Take the oldest slot no client is sending from
+ *
+ * @return NULL if every slot is in use; the producer drops the frame
+ */
+frame_ring_slot_t *frame_ring_begin_write(frame_ring_t *ring);
+
+/**
+ * @brief Publish the frame written to @p slot and wake every client
+ */
+void frame_ring_commit(frame_ring_t *ring, frame_ring_slot_t *slot, uint32_t len, int64_t timestamp_us);
+
+/**
+ * @brief Give back a slot whose frame could not be produced
+ */
+void frame_ring_abort(frame_ring_t *ring, frame_ring_slot_t *slot);
+
+/**
+ * @brief Reference the newest frame the client has not read yet
+ *
+ * The slot stays valid until frame_ring_release().
+ *
+ * @return ESP_ERR_TIMEOUT if no new frame arrived within @p timeout
+ */
+esp_err_t frame_ring_read(frame_ring_t *ring, frame_ring_client_t *client, TickType_t timeout,
+                          const frame_ring_slot_t **ret_slot);
+
+/**
+ * @brief Drop the reference taken by frame_ring_read()
+ *
+ * @param sent Whether the frame reached the client
+ */
+void frame_ring_release(frame_ring_t *ring, frame_ring_client_t *client, const frame_ring_slot_t *slot, bool sent);
+
+void frame_ring_get_stats(frame_ring_t *ring, frame_ring_stats_t *stats);
+
+/**
+ * @brief Frames published since the slowest client last read one
+ *
+ * @return 0 without clients
+ */
+uint32_t frame_ring_max_queue_depth(frame_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file quality_ctrl.c
+ * @brief Closed-loop JPEG quality and frame skip for the stream
+ */
+
+#include <string.h>
+#include "quality_ctrl.h"
+
+#define QUALITY_CTRL_HOLD_FRAMES    3       // Encoded frames for the averages to follow a change
+#define QUALITY_CTRL_LINK_SHARE     85      // Percent of the measured link to use
+#define QUALITY_CTRL_OVER_PCT       110     // Size above budget that lowers the quality
+#define QUALITY_CTRL_UNDER_PCT      75      // Size below budget that allows raising it
+#define QUALITY_CTRL_LATENCY_OK_PCT 70      // Latency below target that allows raising it
+#define QUALITY_CTRL_MIN_STEP       2
+#define QUALITY_CTRL_MAX_STEP       15
+
+/** Exponential average with weight 1/4 for the new sample, seeded by the first */
+static uint32_t ewma(uint32_t avg, uint32_t sample)
+{
+    if (avg == 0) {
+        return sample;
+    }
+    return (uint32_t)((int64_t)avg + ((int64_t)sample - avg) / 4);
+}
+
+static uint8_t clamp_quality(const quality_ctrl_config_t *config, int quality)
+{
+    if (quality < config->min_quality) {
+        return config->min_quality;
+    }
+    if (quality > config->max_quality) {
+        return config->max_quality;
+    }
+    return (uint8_t)quality;
+}
+
+void quality_ctrl_init(quality_ctrl_t *ctrl, const quality_ctrl_config_t *config)
+{
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->config = *config;
+    if (ctrl->config.max_quality < ctrl->config.min_quality) {
+        ctrl->config.max_quality = ctrl->config.min_quality;
+    }
+    ctrl->quality = clamp_quality(&ctrl->config, config->initial_quality);
+}
+
+static void quality_ctrl_adjust(quality_ctrl_t *ctrl)
+{
+    const quality_ctrl_config_t *config = &ctrl->config;
+    bool emergency = ctrl->queue_depth >= 3;
+
+    if ((ctrl->hold && !emergency) || ctrl->interval_us == 0) {
+        return;
+    }
+
+    uint64_t budget_per_s = config->target_bytes_per_s;
+    if (ctrl->link_bytes_per_s) {
+        uint64_t link = (uint64_t)ctrl->link_bytes_per_s * QUALITY_CTRL_LINK_SHARE / 100;
+        if (budget_per_s == 0 || link < budget_per_s) {
+            budget_per_s = link;
+        }
+    }
+    uint64_t frame_interval_us = (uint64_t)ctrl->interval_us * (ctrl->skip + 1);
+    ctrl->budget_bytes = (uint32_t)(budget_per_s * frame_interval_us / 1000000);
+
+    uint32_t size_pct = ctrl->budget_bytes ? (uint32_t)((uint64_t)ctrl->frame_bytes * 100 / ctrl->budget_bytes) : 0;
+    uint32_t latency_pct = config->target_latency_us ? (uint32_t)((uint64_t)ctrl->latency_us * 100 / config->target_latency_us) : 0;
+    bool congested = ctrl->queue_depth >= 2 || latency_pct > 100;
+
+    if (size_pct > QUALITY_CTRL_OVER_PCT || congested) {
+        if (ctrl->quality > config->min_quality) {
+            uint32_t over = size_pct > latency_pct ? size_pct : latency_pct;
+            int step = over > 100 ? (int)(over - 100) / 5 : 0;     // One step per 5% over
+
+            if (step < QUALITY_CTRL_MIN_STEP) {
+                step = QUALITY_CTRL_MIN_STEP;
+            } else if (step > QUALITY_CTRL_MAX_STEP) {
+                step = QUALITY_CTRL_MAX_STEP;
+            }
+            ctrl->quality = clamp_quality(config, ctrl->quality - step);
+        } else if (ctrl->skip < config->max_skip) {
+            ctrl->skip++;
+        } else {
+            return;
+        }
+    } else if (size_pct < QUALITY_CTRL_UNDER_PCT && latency_pct < QUALITY_CTRL_LATENCY_OK_PCT && ctrl->queue_depth == 0) {
+        if (ctrl->skip > 0) {
+            ctrl->skip--;
+        } else if (ctrl->quality < config->max_quality) {
+            ctrl->quality++;
+        } else {
+            return;
+        }
+    } else {
+        return;
+    }
+
+    ctrl->adjustments++;
+    ctrl->hold = QUALITY_CTRL_HOLD_FRAMES;
+}
+
+void quality_ctrl_on_capture(quality_ctrl_t *ctrl, int64_t capture_us)
+{
+    if (ctrl->last_capture_us && capture_us > ctrl->last_capture_us) {
+        ctrl->interval_us = ewma(ctrl->interval_us, (uint32_t)(capture_us - ctrl->last_capture_us));
+    }
+    ctrl->last_capture_us = capture_us;
+}
+
+bool quality_ctrl_begin_frame(quality_ctrl_t *ctrl, uint32_t queue_depth)
+{
+    ctrl->queue_depth = queue_depth;
+
+    if (ctrl->skip_count < ctrl->skip) {
+        ctrl->skip_count++;
+        ctrl->skipped++;
+        return false;
+    }
+    ctrl->skip_count = 0;
+
+    quality_ctrl_adjust(ctrl);
+    return true;
+}
+
+void quality_ctrl_on_encoded(quality_ctrl_t *ctrl, uint32_t bytes)
+{
+    ctrl->frame_bytes = ewma(ctrl->frame_bytes, bytes);
+    ctrl->encoded++;
+    if (ctrl->hold) {
+        ctrl->hold--;
+    }
+}
+
+/** The slowest client sets the pace: every client is sent the same frames */
+static void quality_ctrl_update_link(quality_ctrl_t *ctrl)
+{
+    ctrl->link_bytes_per_s = 0;
+    for (int i = 0; i < QUALITY_CTRL_MAX_CLIENTS; i++) {
+        uint32_t rate = ctrl->client_bytes_per_s[i];
+
+        if (rate && (!ctrl->link_bytes_per_s || rate < ctrl->link_bytes_per_s)) {
+            ctrl->link_bytes_per_s = rate;
+        }
+    }
+}
+
+void quality_ctrl_on_sent(quality_ctrl_t *ctrl, int client, uint32_t bytes, uint32_t send_us, uint32_t latency_us)
+{
+    if (send_us && client >= 0 && client < QUALITY_CTRL_MAX_CLIENTS) {
+        uint64_t rate = (uint64_t)bytes * 1000000 / send_us;
+        ctrl->client_bytes_per_s[client] = ewma(ctrl->client_bytes_per_s[client], rate > UINT32_MAX ? UINT32_MAX : (uint32_t)rate);
+        quality_ctrl_update_link(ctrl);
+    }
+    ctrl->send_us = ewma(ctrl->send_us, send_us);
+    ctrl->latency_us = ewma(ctrl->latency_us, latency_us);
+}
+
+void quality_ctrl_remove_client(quality_ctrl_t *ctrl, int client)
+{
+    if (client >= 0 && client < QUALITY_CTRL_MAX_CLIENTS) {
+        ctrl->client_bytes_per_s[client] = 0;
+        quality_ctrl_update_link(ctrl);
+    }
+}
+
+void quality_ctrl_set_max_quality(quality_ctrl_t *ctrl, uint8_t max_quality)
+{
+    ctrl->config.max_quality = max_quality < ctrl->config.min_quality ? ctrl->config.min_quality : max_quality;
+    ctrl->quality = clamp_quality(&ctrl->config, ctrl->quality);
+}
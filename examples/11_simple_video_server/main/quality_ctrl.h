@@ -0,0 +1,104 @@
+/**
+ * @file quality_ctrl.h
+ * @brief Closed-loop JPEG quality and frame skip for the stream
+ *
+ * Once per captured frame the controller compares the smoothed encoded
+ * frame size with a per-frame byte budget and the smoothed capture-to-sent
+ * latency with its target, and moves the JPEG quality: down fast, in
+ * proportion to the overshoot, and up one step at a time once there is
+ * clear headroom. At the minimum quality it starts skipping frames, and
+ * it stops skipping before it raises the quality again.
+ *
+ * The budget is the lower of the configured bitrate and 85% of the link
+ * throughput, divided by the encoded frame rate. Every client is sent the
+ * same frames, so the link is the slowest client: throughput is measured
+ * from send times per client and the lowest one counts. The frame rate
+ * comes from every captured frame, those the pipeline dropped before the
+ * encoder included. A queue depth of two or more (a client has not read
+ * the last two frames) counts as congestion whatever the sizes say.
+ *
+ * Pure bookkeeping without locks or clocks: the caller passes timestamps
+ * and serialises the calls.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QUALITY_CTRL_MAX_CLIENTS    8
+
+typedef struct quality_ctrl_config {
+    uint32_t target_bytes_per_s;    // 0: follow the measured link only
+    uint32_t target_latency_us;     // Capture to sent
+    uint8_t min_quality;
+    uint8_t max_quality;
+    uint8_t initial_quality;
+    uint8_t max_skip;               // Frames dropped between two encodes, 0: never skip
+} quality_ctrl_config_t;
+
+typedef struct quality_ctrl {
+    quality_ctrl_config_t config;
+    uint8_t quality;
+    uint8_t skip;                   // Encode one frame in skip + 1
+    uint8_t skip_count;
+    uint8_t hold;                   // Frames to wait before the next adjustment
+    int64_t last_capture_us;
+    uint32_t interval_us;           // Smoothed capture interval
+    uint32_t frame_bytes;           // Smoothed encoded size, 0 until the first frame
+    uint32_t link_bytes_per_s;      // Throughput of the slowest client, 0 until the first send
+    uint32_t client_bytes_per_s[QUALITY_CTRL_MAX_CLIENTS];  // Smoothed per client, 0: nothing sent
+    uint32_t latency_us;            // Smoothed capture to sent
+    uint32_t send_us;
+    uint32_t queue_depth;
+    uint32_t budget_bytes;          // Per-frame budget of the last decision
+    uint32_t encoded;
+    uint32_t skipped;
+    uint32_t adjustments;
+} quality_ctrl_t;
+
+void quality_ctrl_init(quality_ctrl_t *ctrl, const quality_ctrl_config_t *config);
+
+/**
+ * @brief Every frame the camera delivered, in capture order, whether or not it reaches the encoder
+ *
+ * @param capture_us When it was captured
+ */
+void quality_ctrl_on_capture(quality_ctrl_t *ctrl, int64_t capture_us);
+
+/**
+ * @brief Decide on a captured frame that reached the encoder
+ *
+ * @param queue_depth Frames the slowest client has not read yet
+ *
+ * @return false to skip the frame; otherwise encode it at ctrl->quality
+ */
+bool quality_ctrl_begin_frame(quality_ctrl_t *ctrl, uint32_t queue_depth);
+
+void quality_ctrl_on_encoded(quality_ctrl_t *ctrl, uint32_t bytes);
+
+/**
+ * @brief One frame reached one client
+ *
+ * @param client Index of the client, below QUALITY_CTRL_MAX_CLIENTS
+ * @param latency_us Capture to sent
+ */
+void quality_ctrl_on_sent(quality_ctrl_t *ctrl, int client, uint32_t bytes, uint32_t send_us, uint32_t latency_us);
+
+/**
+ * @brief Forget the throughput of a client that left, before its index is reused
+ */
+void quality_ctrl_remove_client(quality_ctrl_t *ctrl, int client);
+
+/**
+ * @brief Change the quality ceiling, e.g. after the user picked a quality
+ */
+void quality_ctrl_set_max_quality(quality_ctrl_t *ctrl, uint8_t max_quality);
+
+#ifdef __cplusplus
+}
+#endif
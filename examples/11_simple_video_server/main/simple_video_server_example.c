@@ -10,9 +10,11 @@
 #include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/errno.h>
+#include <sys/socket.h>
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "cJSON.h"
 #include "esp_event.h"
 #include "esp_err.h"
@@ -27,11 +29,50 @@
 #include "lwip/inet.h"
 #include "lwip/apps/netbiosns.h"
 #include "example_video_common.h"
+#include "frame_pipeline.h"
+#if CONFIG_EXAMPLE_WS_STREAM
+#include "ws_stream.h"
+#endif
 
 #define EXAMPLE_CAMERA_VIDEO_BUFFER_NUMBER  CONFIG_EXAMPLE_CAMERA_VIDEO_BUFFER_NUMBER
 
 #define EXAMPLE_JPEG_ENC_QUALITY            CONFIG_EXAMPLE_JPEG_COMPRESSION_QUALITY
 
+#define EXAMPLE_STREAM_FRAME_NUMBER         CONFIG_EXAMPLE_STREAM_FRAME_BUFFER_NUMBER
+#define EXAMPLE_STREAM_READ_TIMEOUT_MS      1000
+#define EXAMPLE_STREAM_TASK_STACK_SIZE      (4 * 1024)
+#define EXAMPLE_STREAM_TASK_PRIORITY        5
+
+#if CONFIG_EXAMPLE_STREAM_ADAPTIVE_QUALITY
+#define EXAMPLE_STREAM_TARGET_BYTES_PER_S   (CONFIG_EXAMPLE_STREAM_TARGET_KBYTES_PER_S * 1000)
+#define EXAMPLE_STREAM_TARGET_LATENCY_US    (CONFIG_EXAMPLE_STREAM_TARGET_LATENCY_MS * 1000)
+#define EXAMPLE_STREAM_MIN_QUALITY          CONFIG_EXAMPLE_STREAM_MIN_QUALITY
+#define EXAMPLE_STREAM_MAX_SKIP             CONFIG_EXAMPLE_STREAM_MAX_SKIP
+#endif
+
+#if CONFIG_EXAMPLE_WS_STREAM
+#define EXAMPLE_WS_STREAM_REFRESH_HZ        CONFIG_EXAMPLE_WS_STREAM_REFRESH_HZ
+#define EXAMPLE_WS_STREAM_SAMPLE_RATE       CONFIG_EXAMPLE_WS_STREAM_SAMPLE_RATE
+#define EXAMPLE_WS_STREAM_CHANNELS          2
+#define EXAMPLE_WS_STREAM_COALESCE_MS       CONFIG_EXAMPLE_WS_STREAM_AUDIO_COALESCE_MS
+#define EXAMPLE_WS_STREAM_MAX_DELAY_MS      (2 * CONFIG_EXAMPLE_WS_STREAM_AUDIO_COALESCE_MS)
+#define EXAMPLE_WS_STREAM_FIFO_MS           250
+#define EXAMPLE_WS_STREAM_TONE_HZ           440
+#define EXAMPLE_WS_STREAM_FRAME_US          CONFIG_EXAMPLE_WS_STREAM_AUDIO_FRAME_US
+#define EXAMPLE_WS_STREAM_CORE              1       // Audio encoders off the emulator's core
+#if CONFIG_EXAMPLE_WS_STREAM_OPUS
+#define EXAMPLE_WS_STREAM_OPUS_BITRATE      (CONFIG_EXAMPLE_WS_STREAM_OPUS_BITRATE * 1000)
+#define EXAMPLE_WS_STREAM_OPUS_COMPLEXITY   CONFIG_EXAMPLE_WS_STREAM_OPUS_COMPLEXITY
+#define EXAMPLE_WS_STREAM_OPUS_MAX_LOAD     (CONFIG_EXAMPLE_WS_STREAM_OPUS_MAX_LOAD * 10)
+#define EXAMPLE_WS_STREAM_STACK_SIZE        (24 * 1024)     // libopus keeps its work arrays on the stack
+#else
+#define EXAMPLE_WS_STREAM_OPUS_BITRATE      0
+#define EXAMPLE_WS_STREAM_OPUS_COMPLEXITY   0
+#define EXAMPLE_WS_STREAM_OPUS_MAX_LOAD     0
+#define EXAMPLE_WS_STREAM_STACK_SIZE        EXAMPLE_STREAM_TASK_STACK_SIZE
+#endif
+#endif
+
 #define EXAMPLE_MDNS_INSTANCE               CONFIG_EXAMPLE_MDNS_INSTANCE
 #define EXAMPLE_MDNS_HOST_NAME              CONFIG_EXAMPLE_MDNS_HOST_NAME
 
@@ -60,8 +101,7 @@ typedef struct web_cam_video {
     uint8_t index;
 
     example_encoder_handle_t encoder_handle;
-    uint8_t *jpeg_out_buf;
-    uint32_t jpeg_out_size;
+    example_encoder_pool_handle_t out_pool;
 
     uint8_t *buffer[EXAMPLE_CAMERA_VIDEO_BUFFER_NUMBER];
     uint32_t buffer_size;
@@ -73,7 +113,14 @@ typedef struct web_cam_video {
 
     uint32_t frame_rate;
 
-    SemaphoreHandle_t sem;
+    frame_ring_t ring;
+    uint8_t *ring_buf[EXAMPLE_STREAM_FRAME_NUMBER];
+    uint32_t ring_buf_size;
+    frame_pipeline_t pipeline;
+    quality_ctrl_t quality_ctrl;
+#if CONFIG_EXAMPLE_WS_STREAM
+    ws_stream_source_t ws_source;
+#endif
 
     uint32_t support_control_jpeg_quality   : 1;
 } web_cam_video_t;
@@ -136,6 +183,8 @@ static esp_err_t capture_video_image(httpd_req_t *req, web_cam_video_t *video, b
     struct v4l2_buffer buf;
     const char *type_str = is_jpeg ? "JPEG" : "binary";
     uint32_t jpeg_encoded_size;
+    uint8_t *jpeg_buf = NULL;
+    uint32_t jpeg_buf_size;
 
     memset(&buf, 0, sizeof(buf));
     buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -150,12 +199,18 @@ static esp_err_t capture_video_image(httpd_req_t *req, web_cam_video_t *video, b
         ESP_GOTO_ON_ERROR(httpd_resp_send(req, (char *)video->buffer[buf.index], buf.bytesused), fail0, TAG, "failed to send %s", type_str);
         jpeg_encoded_size = buf.bytesused;
     } else {
-        ESP_GOTO_ON_FALSE(xSemaphoreTake(video->sem, portMAX_DELAY) == pdPASS, ESP_FAIL, fail0, TAG, "failed to take semaphore");
-        ret = example_encoder_process(video->encoder_handle, video->buffer[buf.index], video->buffer_size,
-                                      video->jpeg_out_buf, video->jpeg_out_size, &jpeg_encoded_size);
-        xSemaphoreGive(video->sem);
-        ESP_GOTO_ON_ERROR(ret, fail0, TAG, "failed to encode video frame");
-        ESP_GOTO_ON_ERROR(httpd_resp_send(req, (char *)video->jpeg_out_buf, jpeg_encoded_size), fail0, TAG, "failed to send %s", type_str);
+        ESP_GOTO_ON_ERROR(example_encoder_pool_get(video->out_pool, &jpeg_buf, &jpeg_buf_size), fail0, TAG, "failed to get jpeg output buf");
+        /* Runs between stream frames, at the user's quality rather than the adapted one */
+        example_encoder_job_config_t job_config = {
+            .priority = EXAMPLE_JPEG_PRIO_STILL,
+            .quality = video->jpeg_quality,
+        };
+        ret = example_encoder_process_job(video->encoder_handle, &job_config, video->buffer[buf.index], video->buffer_size,
+                                          jpeg_buf, jpeg_buf_size, &jpeg_encoded_size);
+        example_encoder_pool_record(video->out_pool, ret == ESP_OK ? jpeg_encoded_size : EXAMPLE_ENCODER_POOL_OVERFLOW);
+        ESP_GOTO_ON_ERROR(ret, fail1, TAG, "failed to encode video frame");
+        ESP_GOTO_ON_ERROR(httpd_resp_send(req, (char *)jpeg_buf, jpeg_encoded_size), fail1, TAG, "failed to send %s", type_str);
+        example_encoder_pool_put(video->out_pool, jpeg_buf);
     }
 
     ESP_RETURN_ON_ERROR(ioctl(video->fd, VIDIOC_QBUF, &buf), TAG, "failed to queue video frame");
@@ -166,11 +221,146 @@ static esp_err_t capture_video_image(httpd_req_t *req, web_cam_video_t *video, b
 
     return ESP_OK;
 
+fail1:
+    example_encoder_pool_put(video->out_pool, jpeg_buf);
 fail0:
     ioctl(video->fd, VIDIOC_QBUF, &buf);
     return ret;
 }
 
+static cJSON *get_stream_json(web_cam_video_t *video)
+{
+    frame_ring_stats_t stats;
+    cJSON *stream = cJSON_CreateObject();
+    cJSON *clients = cJSON_CreateArray();
+
+    frame_ring_get_stats(&video->ring, &stats);
+    cJSON_AddNumberToObject(stream, "framesEncoded", stats.published);
+    cJSON_AddNumberToObject(stream, "framesDropped", stats.producer_drops);
+    cJSON_AddNumberToObject(stream, "bufferCount", video->ring.slot_count);
+
+    for (int i = 0; i < stats.client_count; i++) {
+        cJSON *client = cJSON_CreateObject();
+
+        cJSON_AddNumberToObject(client, "socket", stats.clients[i].sockfd);
+        cJSON_AddNumberToObject(client, "queueDepth", stats.clients[i].queue_depth);
+        cJSON_AddNumberToObject(client, "framesSent", stats.clients[i].sent);
+        cJSON_AddNumberToObject(client, "framesDropped", stats.clients[i].dropped);
+        cJSON_AddItemToArray(clients, client);
+    }
+    cJSON_AddItemToObject(stream, "clients", clients);
+
+#if CONFIG_EXAMPLE_WS_STREAM
+    ws_stream_client_stats_t ws_stats[WS_STREAM_MAX_CLIENTS];
+    int ws_count = ws_stream_get_stats(&video->ws_source, ws_stats, WS_STREAM_MAX_CLIENTS);
+    cJSON *ws_clients = cJSON_CreateArray();
+
+    for (int i = 0; i < ws_count; i++) {
+        const ws_mux_stats_t *mux = &ws_stats[i].mux;
+        cJSON *client = cJSON_CreateObject();
+
+        cJSON_AddNumberToObject(client, "socket", ws_stats[i].sockfd);
+        cJSON_AddNumberToObject(client, "refreshHz", ws_stats[i].refresh_hz);
+        cJSON_AddNumberToObject(client, "ticks", mux->ticks);
+        cJSON_AddNumberToObject(client, "lateTicks", mux->late_ticks);
+        cJSON_AddNumberToObject(client, "repeats", mux->repeats);
+        cJSON_AddNumberToObject(client, "framesSent", mux->video_sent);
+        cJSON_AddNumberToObject(client, "framesDropped", mux->video_dropped);
+        cJSON_AddNumberToObject(client, "audioMessages", mux->audio_msgs);
+        cJSON_AddNumberToObject(client, "audioSamples", (double)mux->audio_samples);
+        cJSON_AddNumberToObject(client, "audioMaxBacklog", mux->audio_max_backlog);
+        cJSON_AddStringToObject(client, "audioCodec", ws_audio_codec_name(ws_stats[i].codec));
+        cJSON_AddNumberToObject(client, "audioCodedBytes", (double)ws_stats[i].encoder.coded_bytes);
+        cJSON_AddNumberToObject(client, "audioEncodeLoad", ws_audio_encoder_load_permille(&ws_stats[i].encoder) / 10.0);
+        cJSON_AddItemToArray(ws_clients, client);
+    }
+    cJSON_AddItemToObject(stream, "wsClients", ws_clients);
+#endif
+
+    frame_pipeline_stats_t pipeline_stats;
+    cJSON *latency = cJSON_CreateObject();
+
+    frame_pipeline_get_stats(&video->pipeline, &pipeline_stats);
+    cJSON_AddNumberToObject(stream, "captureDropped", pipeline_stats.capture_drops);
+    cJSON_AddNumberToObject(stream, "encodeErrors", pipeline_stats.encode_errors);
+    for (int i = 0; i < FRAME_STAGE_COUNT; i++) {
+        const frame_hist_t *hist = &pipeline_stats.hist[i];
+        cJSON *stage = cJSON_CreateObject();
+        cJSON *buckets = cJSON_CreateArray();
+
+        cJSON_AddNumberToObject(stage, "count", hist->count);
+        cJSON_AddNumberToObject(stage, "avgUs", hist->count ? (double)(hist->total_us / hist->count) : 0);
+        cJSON_AddNumberToObject(stage, "p50Us", frame_hist_percentile(hist, 50));
+        cJSON_AddNumberToObject(stage, "p99Us", frame_hist_percentile(hist, 99));
+        cJSON_AddNumberToObject(stage, "maxUs", hist->max_us);
+        for (int j = 0; j < FRAME_HIST_BUCKETS; j++) {
+            cJSON_AddItemToArray(buckets, cJSON_CreateNumber(hist->bucket[j]));
+        }
+        cJSON_AddItemToObject(stage, "buckets", buckets);
+        cJSON_AddItemToObject(latency, frame_pipeline_stage_name(i), stage);
+    }
+    cJSON_AddNumberToObject(stream, "latencyBucketBaseUs", FRAME_HIST_BASE_US);
+    cJSON_AddItemToObject(stream, "latency", latency);
+
+    if (video->out_pool) {
+        example_encoder_pool_stats_t pool_stats;
+        cJSON *pool = cJSON_CreateObject();
+
+        example_encoder_pool_get_stats(video->out_pool, &pool_stats);
+        cJSON_AddNumberToObject(pool, "targetSize", pool_stats.target_size);
+        cJSON_AddNumberToObject(pool, "maxSize", pool_stats.max_size);
+        cJSON_AddNumberToObject(pool, "buffers", pool_stats.buffers);
+        cJSON_AddNumberToObject(pool, "inUse", pool_stats.in_use);
+        cJSON_AddNumberToObject(pool, "allocatedBytes", pool_stats.allocated_bytes);
+        cJSON_AddNumberToObject(pool, "peakBytes", pool_stats.peak_bytes);
+        cJSON_AddNumberToObject(pool, "largestFrame", pool_stats.largest_frame);
+        cJSON_AddNumberToObject(pool, "grows", pool_stats.grows);
+        cJSON_AddNumberToObject(pool, "shrinks", pool_stats.shrinks);
+        cJSON_AddNumberToObject(pool, "overflows", pool_stats.overflows);
+        cJSON_AddItemToObject(stream, "outputPool", pool);
+    }
+
+    example_jpeg_sched_stats_t sched_stats;
+    if (video->encoder_handle && example_encoder_get_sched_stats(&sched_stats) == ESP_OK) {
+        static const char *prio_names[EXAMPLE_JPEG_PRIO_COUNT] = { "live", "preview", "still" };
+        cJSON *engine = cJSON_CreateObject();
+
+        /* Shared by all cameras */
+        for (int i = 0; i < EXAMPLE_JPEG_PRIO_COUNT; i++) {
+            cJSON *prio = cJSON_CreateObject();
+
+            cJSON_AddNumberToObject(prio, "jobs", sched_stats.jobs[i]);
+            cJSON_AddNumberToObject(prio, "waitMaxUs", sched_stats.wait_max_us[i]);
+            cJSON_AddNumberToObject(prio, "waitAvgUs", sched_stats.jobs[i] ? (double)(sched_stats.wait_total_us[i] / sched_stats.jobs[i]) : 0);
+            cJSON_AddNumberToObject(prio, "runAvgUs", sched_stats.run_avg_us[i]);
+            cJSON_AddNumberToObject(prio, "intervalAvgUs", sched_stats.interval_avg_us[i]);
+            cJSON_AddItemToObject(engine, prio_names[i], prio);
+        }
+        cJSON_AddNumberToObject(engine, "stillForced", sched_stats.still_forced);
+        cJSON_AddNumberToObject(engine, "maxQueued", sched_stats.max_queued);
+        cJSON_AddItemToObject(stream, "jpegEngine", engine);
+    }
+
+    if (pipeline_stats.adaptive) {
+        const quality_ctrl_t *ctrl = &pipeline_stats.quality;
+        cJSON *adaptive = cJSON_CreateObject();
+
+        cJSON_AddNumberToObject(adaptive, "quality", ctrl->quality);
+        cJSON_AddNumberToObject(adaptive, "maxQuality", ctrl->config.max_quality);
+        cJSON_AddNumberToObject(adaptive, "skip", ctrl->skip);
+        cJSON_AddNumberToObject(adaptive, "budgetBytes", ctrl->budget_bytes);
+        cJSON_AddNumberToObject(adaptive, "frameBytes", ctrl->frame_bytes);
+        cJSON_AddNumberToObject(adaptive, "linkBytesPerS", ctrl->link_bytes_per_s);
+        cJSON_AddNumberToObject(adaptive, "latencyUs", ctrl->latency_us);
+        cJSON_AddNumberToObject(adaptive, "queueDepth", ctrl->queue_depth);
+        cJSON_AddNumberToObject(adaptive, "adjustments", ctrl->adjustments);
+        cJSON_AddNumberToObject(adaptive, "framesSkipped", ctrl->skipped);
+        cJSON_AddItemToObject(stream, "adaptive", adaptive);
+    }
+
+    return stream;
+}
+
 static char *get_cameras_json(web_cam_t *web_cam)
 {
     cJSON *root = cJSON_CreateObject();
@@ -236,6 +426,7 @@ static char *get_cameras_json(web_cam_t *web_cam)
         cJSON_AddItemToArray(image_formats, image_format);
 
         cJSON_AddItemToObject(camera, "imageFormats", image_formats);
+        cJSON_AddItemToObject(camera, "stream", get_stream_json(&web_cam->video[i]));
         cJSON_AddItemToArray(cameras, camera);
     }
 
@@ -290,6 +481,7 @@ static esp_err_t set_camera_jpeg_quality(web_cam_video_t *video, int quality)
 
     if (video->support_control_jpeg_quality) {
         ESP_LOGI(TAG, "video%d: set jpeg quality %d success", video->index, quality_reset);
+        frame_pipeline_set_max_quality(&video->pipeline, video->jpeg_quality);
     }
 
     return ret;
@@ -396,73 +588,209 @@ static esp_err_t static_file_handler(httpd_req_t *req)
     return ESP_FAIL;
 }
 
-static esp_err_t image_stream_handler(httpd_req_t *req)
+static esp_err_t stream_dequeue(void *ctx, TickType_t timeout, frame_pipeline_buf_t *fbuf)
 {
-    esp_err_t ret;
     struct v4l2_buffer buf;
-    char http_string[128];
-    bool locked = false;
-    web_cam_video_t *video = (web_cam_video_t *)req->user_ctx;
+    web_cam_video_t *video = (web_cam_video_t *)ctx;
 
-    ESP_RETURN_ON_FALSE(snprintf(http_string, sizeof(http_string), "%" PRIu32, video->frame_rate) > 0,
-                        ESP_FAIL, TAG, "failed to format framerate buffer");
+    /* Blocks until the sensor delivers, which it does continuously while streaming */
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    ESP_RETURN_ON_ERROR(ioctl(video->fd, VIDIOC_DQBUF, &buf), TAG, "failed to receive video frame");
+    if (!(buf.flags & V4L2_BUF_FLAG_DONE)) {
+        ioctl(video->fd, VIDIOC_QBUF, &buf);
+        return ESP_ERR_TIMEOUT;
+    }
 
-    ESP_RETURN_ON_ERROR(httpd_resp_set_type(req, STREAM_CONTENT_TYPE), TAG, "failed to set content type");
-    ESP_RETURN_ON_ERROR(httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*"), TAG, "failed to set access control allow origin");
-    ESP_RETURN_ON_ERROR(httpd_resp_set_hdr(req, "X-Framerate", http_string), TAG, "failed to set x framerate");
+    fbuf->index = buf.index;
+    fbuf->data = video->buffer[buf.index];
+    fbuf->size = buf.bytesused;
+    return ESP_OK;
+}
 
-    while (1) {
-        int hlen;
-        struct timespec ts;
-        uint32_t jpeg_encoded_size;
+static void stream_requeue(void *ctx, const frame_pipeline_buf_t *fbuf)
+{
+    struct v4l2_buffer buf;
+    web_cam_video_t *video = (web_cam_video_t *)ctx;
 
-        locked = false;
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index  = fbuf->index;
+    if (ioctl(video->fd, VIDIOC_QBUF, &buf) != 0) {
+        ESP_LOGE(TAG, "video%d: failed to queue video frame", video->index);
+    }
+}
 
-        memset(&buf, 0, sizeof(buf));
-        buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        ESP_RETURN_ON_ERROR(ioctl(video->fd, VIDIOC_DQBUF, &buf), TAG, "failed to receive video frame");
-        if (!(buf.flags & V4L2_BUF_FLAG_DONE)) {
-            ESP_RETURN_ON_ERROR(ioctl(video->fd, VIDIOC_QBUF, &buf), TAG, "failed to queue video frame");
-            continue;
-        }
+static esp_err_t stream_encode(void *ctx, const frame_pipeline_buf_t *fbuf, uint8_t *dst, uint32_t dst_size, uint32_t *dst_size_out)
+{
+    esp_err_t ret;
+    web_cam_video_t *video = (web_cam_video_t *)ctx;
 
-        ESP_GOTO_ON_ERROR(httpd_resp_send_chunk(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY)), fail0, TAG, "failed to send boundary");
+    if (video->pixel_format == V4L2_PIX_FMT_JPEG) {
+        /* Copy once so the V4L2 buffer goes straight back to the driver */
+        ESP_RETURN_ON_FALSE(fbuf->size <= dst_size, ESP_ERR_INVALID_SIZE, TAG, "JPEG frame too large");
+        memcpy(dst, fbuf->data, fbuf->size);
+        *dst_size_out = fbuf->size;
+        return ESP_OK;
+    }
 
-        if (video->pixel_format == V4L2_PIX_FMT_JPEG) {
-            video->jpeg_out_buf = video->buffer[buf.index];
-            jpeg_encoded_size = buf.bytesused;
-        } else {
-            ESP_GOTO_ON_FALSE(xSemaphoreTake(video->sem, portMAX_DELAY) == pdPASS, ESP_FAIL, fail0, TAG, "failed to take semaphore");
-            locked = true;
+    ret = example_encoder_process(video->encoder_handle, fbuf->data, video->buffer_size, dst, dst_size, dst_size_out);
+    example_encoder_pool_record(video->out_pool, ret == ESP_OK ? *dst_size_out : EXAMPLE_ENCODER_POOL_OVERFLOW);
+    return ret;
+}
 
-            ESP_GOTO_ON_ERROR(example_encoder_process(video->encoder_handle, video->buffer[buf.index], video->buffer_size,
-                              video->jpeg_out_buf, video->jpeg_out_size, &jpeg_encoded_size),
-                              fail0, TAG, "failed to encode video frame");
-        }
+static void stream_prepare_output(void *ctx, uint8_t **dst, uint32_t *dst_size)
+{
+    web_cam_video_t *video = (web_cam_video_t *)ctx;
+
+    /* Sensor JPEGs are copied into fixed buffers of the sensor buffer size */
+    if (!video->out_pool) {
+        return;
+    }
+
+    /* The ring gave the slot's last buffer back once every reader was done with it */
+    if (!*dst) {
+        example_encoder_pool_get(video->out_pool, dst, dst_size);
+    } else {
+        example_encoder_pool_fit(video->out_pool, dst, dst_size);
+    }
+}
+
+static void stream_release_buf(void *ctx, uint8_t *buf)
+{
+    web_cam_video_t *video = (web_cam_video_t *)ctx;
+
+    example_encoder_pool_put(video->out_pool, buf);
+}
+
+/**
+ * @brief Quality picked by the controller, leaves the user's jpeg_quality alone
+ */
+static esp_err_t stream_set_quality(void *ctx, uint8_t quality)
+{
+    web_cam_video_t *video = (web_cam_video_t *)ctx;
+
+    if (video->pixel_format == V4L2_PIX_FMT_JPEG) {
+        struct v4l2_ext_controls controls = {0};
+        struct v4l2_ext_control control[1];
+        struct v4l2_query_ext_ctrl qctrl = {0};
+
+        qctrl.id = V4L2_CID_JPEG_COMPRESSION_QUALITY;
+        ESP_RETURN_ON_ERROR(ioctl(video->fd, VIDIOC_QUERY_EXT_CTRL, &qctrl), TAG, "failed to query jpeg compression quality");
+        int value = quality < qctrl.minimum ? qctrl.minimum : quality > qctrl.maximum ? qctrl.maximum : quality;
+        value = qctrl.minimum + ((value - qctrl.minimum) / qctrl.step) * qctrl.step;
+
+        controls.ctrl_class = V4L2_CID_JPEG_CLASS;
+        controls.count = 1;
+        controls.controls = control;
+        control[0].id = V4L2_CID_JPEG_COMPRESSION_QUALITY;
+        control[0].value = value;
+        ESP_RETURN_ON_ERROR(ioctl(video->fd, VIDIOC_S_EXT_CTRLS, &controls), TAG, "failed to set jpeg compression quality");
+        return ESP_OK;
+    }
+
+    return example_encoder_set_jpeg_quality(video->encoder_handle, quality);
+}
+
+static const frame_pipeline_ops_t s_stream_ops = {
+    .dequeue = stream_dequeue,
+    .requeue = stream_requeue,
+    .prepare_output = stream_prepare_output,
+    .encode = stream_encode,
+    .set_quality = stream_set_quality,
+};
 
-        ESP_GOTO_ON_ERROR(clock_gettime(CLOCK_MONOTONIC, &ts), fail0, TAG, "failed to get time");
-        ESP_GOTO_ON_FALSE((hlen = snprintf(http_string, sizeof(http_string), STREAM_PART, jpeg_encoded_size, ts.tv_sec, ts.tv_nsec)) > 0,
-                          ESP_FAIL, fail0, TAG, "failed to format part buffer");
-        ESP_GOTO_ON_ERROR(httpd_resp_send_chunk(req, http_string, hlen), fail0, TAG, "failed to send boundary");
+/**
+ * @brief Whether a stream client has closed or lost its connection, checked while no frames are sent
+ */
+static bool stream_client_gone(int sockfd)
+{
+    char byte;
+    int len = recv(sockfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
 
-        ESP_GOTO_ON_ERROR(httpd_resp_send_chunk(req, (char *)video->jpeg_out_buf, jpeg_encoded_size), fail0, TAG, "failed to send jpeg");
-        if (locked) {
-            xSemaphoreGive(video->sem);
-            locked = false;
+    /* 0 is an orderly close; any error but an empty socket means the connection is dead */
+    return len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+/**
+ * @brief Send frames from the ring to one client until it disconnects
+ */
+static void stream_client_task(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    httpd_req_t *req = (httpd_req_t *)arg;
+    web_cam_video_t *video = (web_cam_video_t *)req->user_ctx;
+    frame_ring_client_t *client;
+    char http_string[128];
+    char frame_rate_str[16];
+
+    snprintf(frame_rate_str, sizeof(frame_rate_str), "%" PRIu32, video->frame_rate);
+    httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "X-Framerate", frame_rate_str);
+
+    if (frame_ring_attach(&video->ring, httpd_req_to_sockfd(req), &client) != ESP_OK) {
+        ESP_LOGW(TAG, "video%d: too many stream clients", video->index);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Too many stream clients");
+        httpd_req_async_handler_complete(req);
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "video%d: stream client %d connected", video->index, httpd_req_to_sockfd(req));
+
+    while (ret == ESP_OK) {
+        const frame_ring_slot_t *slot;
+        int hlen;
+
+        if (frame_ring_read(&video->ring, client, pdMS_TO_TICKS(EXAMPLE_STREAM_READ_TIMEOUT_MS), &slot) != ESP_OK) {
+            /* Without frames no send fails, so a client that left would keep its task and ring slot */
+            if (stream_client_gone(client->sockfd)) {
+                ret = ESP_FAIL;
+            }
+            continue;
         }
 
-        ESP_RETURN_ON_ERROR(ioctl(video->fd, VIDIOC_QBUF, &buf), TAG, "failed to queue video frame");
+        int64_t start_us = frame_pipeline_now_us();
+        hlen = snprintf(http_string, sizeof(http_string), STREAM_PART, (unsigned)slot->len,
+                        (int)(slot->timestamp_us / 1000000), (int)(slot->timestamp_us % 1000000));
+        ret = httpd_resp_send_chunk(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
+        if (ret == ESP_OK) {
+            ret = httpd_resp_send_chunk(req, http_string, hlen);
+        }
+        if (ret == ESP_OK) {
+            /* Sent straight from the ring slot, shared with the other clients */
+            ret = httpd_resp_send_chunk(req, (const char *)slot->buf, slot->len);
+        }
+        if (ret == ESP_OK) {
+            frame_pipeline_record_send(&video->pipeline, client, start_us, slot->timestamp_us, slot->len);
+        }
+        frame_ring_release(&video->ring, client, slot, ret == ESP_OK);
     }
 
-    return ESP_OK;
+    ESP_LOGI(TAG, "video%d: stream client %d left after %" PRIu32 " frames, %" PRIu32 " dropped",
+             video->index, client->sockfd, client->sent, client->dropped);
+    frame_pipeline_remove_client(&video->pipeline, client);
+    frame_ring_detach(&video->ring, client);
+    httpd_req_async_handler_complete(req);
+    vTaskDelete(NULL);
+}
 
-fail0:
-    if (locked) {
-        xSemaphoreGive(video->sem);
+static esp_err_t image_stream_handler(httpd_req_t *req)
+{
+    httpd_req_t *async_req;
+
+    /* Hand the connection to its own task so the server keeps accepting viewers */
+    ESP_RETURN_ON_ERROR(httpd_req_async_handler_begin(req, &async_req), TAG, "failed to begin async handler");
+    if (xTaskCreate(stream_client_task, "stream_client", EXAMPLE_STREAM_TASK_STACK_SIZE, async_req,
+                    EXAMPLE_STREAM_TASK_PRIORITY, NULL) != pdPASS) {
+        httpd_req_async_handler_complete(async_req);
+        ESP_LOGE(TAG, "failed to create stream client task");
+        return ESP_ERR_NO_MEM;
     }
-    ioctl(video->fd, VIDIOC_QBUF, &buf);
-    return ret;
+
+    return ESP_OK;
 }
 
 static esp_err_t capture_image_handler(httpd_req_t *req)
@@ -493,6 +821,98 @@ static esp_err_t capture_binary_handler(httpd_req_t *req)
     return capture_video_image(req, &web_cam->video[desc.index], false);
 }
 
+static void free_stream_buffers(web_cam_video_t *video)
+{
+    for (int i = 0; i < EXAMPLE_STREAM_FRAME_NUMBER; i++) {
+        if (!video->ring_buf[i]) {
+            continue;
+        }
+        if (video->pixel_format == V4L2_PIX_FMT_JPEG) {
+            free(video->ring_buf[i]);
+        } else {
+            example_encoder_pool_put(video->out_pool, video->ring_buf[i]);
+        }
+        video->ring_buf[i] = NULL;
+    }
+}
+
+static esp_err_t init_web_cam_stream(web_cam_video_t *video)
+{
+    esp_err_t ret;
+
+    if (video->pixel_format == V4L2_PIX_FMT_JPEG) {
+        video->ring_buf_size = video->buffer_size;
+        for (int i = 0; i < EXAMPLE_STREAM_FRAME_NUMBER; i++) {
+            video->ring_buf[i] = malloc(video->ring_buf_size);
+            ESP_GOTO_ON_FALSE(video->ring_buf[i], ESP_ERR_NO_MEM, fail0, TAG, "failed to alloc stream buffer");
+        }
+    } else {
+        /* Slots take pool buffers as frames are encoded and give them back once sent */
+        video->ring_buf_size = 0;
+    }
+
+    ESP_GOTO_ON_ERROR(frame_ring_init(&video->ring, video->ring_buf, EXAMPLE_STREAM_FRAME_NUMBER, video->ring_buf_size),
+                      fail0, TAG, "failed to init frame ring");
+    if (video->out_pool) {
+        frame_ring_set_release_buf(&video->ring, stream_release_buf, video);
+    }
+
+    frame_pipeline_config_t pipeline_config = {
+        .ops = &s_stream_ops,
+        .ctx = video,
+        .ring = &video->ring,
+        .buffer_count = EXAMPLE_CAMERA_VIDEO_BUFFER_NUMBER,
+        .stack_size = EXAMPLE_STREAM_TASK_STACK_SIZE,
+        .priority = EXAMPLE_STREAM_TASK_PRIORITY,
+    };
+
+#if CONFIG_EXAMPLE_STREAM_ADAPTIVE_QUALITY
+    /* Sensors without a quality control keep streaming at their fixed quality */
+    if (video->support_control_jpeg_quality) {
+        quality_ctrl_config_t quality_config = {
+            .target_bytes_per_s = EXAMPLE_STREAM_TARGET_BYTES_PER_S,
+            .target_latency_us = EXAMPLE_STREAM_TARGET_LATENCY_US,
+            .min_quality = EXAMPLE_STREAM_MIN_QUALITY,
+            .max_quality = video->jpeg_quality,
+            .initial_quality = video->jpeg_quality,
+            .max_skip = EXAMPLE_STREAM_MAX_SKIP,
+        };
+
+        quality_ctrl_init(&video->quality_ctrl, &quality_config);
+        pipeline_config.quality = &video->quality_ctrl;
+    }
+#endif
+    ESP_GOTO_ON_ERROR(frame_pipeline_start(&video->pipeline, &pipeline_config), fail1, TAG, "failed to start stream pipeline");
+
+#if CONFIG_EXAMPLE_WS_STREAM
+    video->ws_source.ring = &video->ring;
+    video->ws_source.pipeline = &video->pipeline;
+    video->ws_source.width = video->width;
+    video->ws_source.height = video->height;
+    video->ws_source.index = video->index;
+#endif
+
+    return ESP_OK;
+
+fail1:
+    frame_ring_deinit(&video->ring);
+fail0:
+    free_stream_buffers(video);
+    return ret;
+}
+
+static void deinit_web_cam_stream(web_cam_video_t *video)
+{
+    frame_pipeline_stop(&video->pipeline);
+
+    /* The encoder may have swapped slot buffers for refitted ones */
+    for (int i = 0; i < video->ring.slot_count; i++) {
+        video->ring_buf[i] = video->ring.slots[i].buf;
+    }
+    frame_ring_deinit(&video->ring);
+    free_stream_buffers(video);
+}
+
 static esp_err_t init_web_cam_video(web_cam_video_t *video, const web_cam_video_config_t *config, int index)
 {
     int fd;
@@ -587,22 +1007,24 @@ static esp_err_t init_web_cam_video(web_cam_video_t *video, const web_cam_video_
         encoder_config.quality = EXAMPLE_JPEG_ENC_QUALITY;
         ESP_GOTO_ON_ERROR(example_encoder_init(&encoder_config, &video->encoder_handle), fail0, TAG, "failed to init encoder");
 
-        ESP_GOTO_ON_ERROR(example_encoder_alloc_output_buffer(video->encoder_handle, &video->jpeg_out_buf, &video->jpeg_out_size),
-                          fail1, TAG, "failed to alloc jpeg output buf");
+        /* Stream ring slots plus one for /capture */
+        example_encoder_pool_config_t pool_config = {
+            .buffer_count = EXAMPLE_STREAM_FRAME_NUMBER + 1,
+        };
+        ESP_GOTO_ON_ERROR(example_encoder_pool_create(video->encoder_handle, &pool_config, &video->out_pool),
+                          fail1, TAG, "failed to create jpeg output pool");
 
         video->support_control_jpeg_quality = 1;
     }
 
-    video->sem = xSemaphoreCreateBinary();
-    ESP_GOTO_ON_FALSE(video->sem, ESP_ERR_NO_MEM, fail2, TAG, "failed to create semaphore");
-    xSemaphoreGive(video->sem);
+    ESP_GOTO_ON_ERROR(init_web_cam_stream(video), fail2, TAG, "failed to init stream");
 
     return ESP_OK;
 
 fail2:
     if (video->pixel_format != V4L2_PIX_FMT_JPEG) {
-        example_encoder_free_output_buffer(video->encoder_handle, video->jpeg_out_buf);
-        video->jpeg_out_buf = NULL;
+        example_encoder_pool_delete(video->out_pool);
+        video->out_pool = NULL;
     }
 fail1:
     if (video->pixel_format != V4L2_PIX_FMT_JPEG) {
@@ -617,13 +1039,10 @@ fail0:
 
 static esp_err_t deinit_web_cam_video(web_cam_video_t *video)
 {
-    if (video->sem) {
-        vSemaphoreDelete(video->sem);
-        video->sem = NULL;
-    }
+    deinit_web_cam_stream(video);
 
     if (video->pixel_format != V4L2_PIX_FMT_JPEG) {
-        example_encoder_free_output_buffer(video->encoder_handle, video->jpeg_out_buf);
+        example_encoder_pool_delete(video->out_pool);
         example_encoder_deinit(video->encoder_handle);
     }
 
@@ -764,11 +1183,24 @@ static esp_err_t http_server_init(web_cam_t *web_cam)
             .user_ctx = (void *) &web_cam->video[i]
         };
 
+#if CONFIG_EXAMPLE_WS_STREAM
+        httpd_uri_t ws_stream_uri = {
+            .uri = "/ws/stream",
+            .method = HTTP_GET,
+            .handler = ws_stream_handler,
+            .user_ctx = (void *) &web_cam->video[i].ws_source,
+            .is_websocket = true,
+        };
+#endif
+
         config.stack_size = 1024 * 6;
         config.server_port += 1;
         config.ctrl_port += 1;
         if (httpd_start(&stream_httpd, &config) == ESP_OK) {
             httpd_register_uri_handler(stream_httpd, &stream_0_uri);
+#if CONFIG_EXAMPLE_WS_STREAM
+            httpd_register_uri_handler(stream_httpd, &ws_stream_uri);
+#endif
         }
     }
 
@@ -781,6 +1213,29 @@ static esp_err_t start_cam_web_server(const web_cam_video_config_t *config, int
     web_cam_t *web_cam;
 
     ESP_RETURN_ON_ERROR(new_web_cam(config, config_count, &web_cam), TAG, "Failed to new web cam");
+
+#if CONFIG_EXAMPLE_WS_STREAM
+    ws_stream_config_t ws_config = {
+        .refresh_hz = EXAMPLE_WS_STREAM_REFRESH_HZ,
+        .sample_rate = EXAMPLE_WS_STREAM_SAMPLE_RATE,
+        .channels = EXAMPLE_WS_STREAM_CHANNELS,
+        .coalesce_ms = EXAMPLE_WS_STREAM_COALESCE_MS,
+        .max_delay_ms = EXAMPLE_WS_STREAM_MAX_DELAY_MS,
+        .fifo_ms = EXAMPLE_WS_STREAM_FIFO_MS,
+        .frame_us = EXAMPLE_WS_STREAM_FRAME_US,
+        .opus_bitrate = EXAMPLE_WS_STREAM_OPUS_BITRATE,
+        .opus_complexity = EXAMPLE_WS_STREAM_OPUS_COMPLEXITY,
+        .opus_max_load_permille = EXAMPLE_WS_STREAM_OPUS_MAX_LOAD,
+        .stack_size = EXAMPLE_WS_STREAM_STACK_SIZE,
+        .task_priority = EXAMPLE_STREAM_TASK_PRIORITY,
+        .task_core = EXAMPLE_WS_STREAM_CORE,
+    };
+    ESP_GOTO_ON_ERROR(ws_stream_init(&ws_config), fail0, TAG, "Failed to init ws stream");
+#if CONFIG_EXAMPLE_WS_STREAM_TEST_TONE
+    ESP_GOTO_ON_ERROR(ws_stream_start_test_tone(EXAMPLE_WS_STREAM_TONE_HZ), fail0, TAG, "Failed to start test tone");
+#endif
+#endif
+
     ESP_GOTO_ON_ERROR(http_server_init(web_cam), fail0, TAG, "Failed to init http server");
 
     return ESP_OK;
@@ -0,0 +1,331 @@
+/**
+ * @file ws_audio_codec.c
+ * @brief Compressed audio for /ws/stream: IMA ADPCM, or Opus when built in
+ */
+
+#include <string.h>
+#include "ws_audio_codec.h"
+
+#ifdef WS_AUDIO_HAVE_OPUS
+#include "opus.h"
+#endif
+
+#define WS_AUDIO_ADPCM_HEADER       4       // Per channel: predictor, index, reserved
+#define WS_AUDIO_ADPCM_MAX_INDEX    88
+
+static const char *const s_names[WS_AUDIO_CODEC_COUNT] = { "pcm", "adpcm", "opus" };
+
+static const int16_t s_adpcm_steps[WS_AUDIO_ADPCM_MAX_INDEX + 1] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t s_adpcm_index_step[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+uint32_t ws_audio_codec_available(void)
+{
+    uint32_t mask = WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_PCM) | WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_ADPCM);
+
+#ifdef WS_AUDIO_HAVE_OPUS
+    mask |= WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_OPUS);
+#endif
+    return mask;
+}
+
+const char *ws_audio_codec_name(ws_audio_codec_t codec)
+{
+    return codec < WS_AUDIO_CODEC_COUNT ? s_names[codec] : "?";
+}
+
+uint32_t ws_audio_codec_parse_offer(const char *offer)
+{
+    uint32_t mask = 0;
+
+    while (offer && *offer) {
+        size_t len = strcspn(offer, ",");
+
+        for (int codec = 0; codec < WS_AUDIO_CODEC_COUNT; codec++) {
+            if (len == strlen(s_names[codec]) && !strncmp(offer, s_names[codec], len)) {
+                mask |= WS_AUDIO_CODEC_BIT(codec);
+            }
+        }
+        offer += len;
+        offer += *offer == ',';
+    }
+
+    return mask;
+}
+
+ws_audio_codec_t ws_audio_codec_pick(uint32_t offer, bool opus_allowed)
+{
+    offer &= ws_audio_codec_available();
+    if (opus_allowed && (offer & WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_OPUS))) {
+        return WS_AUDIO_CODEC_OPUS;
+    }
+    if (offer & WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_ADPCM)) {
+        return WS_AUDIO_CODEC_ADPCM;
+    }
+    return WS_AUDIO_CODEC_PCM;
+}
+
+static uint32_t ws_audio_adpcm_frame_bytes(uint8_t channels, uint32_t samples)
+{
+    return channels * WS_AUDIO_ADPCM_HEADER + (samples * channels + 1) / 2;
+}
+
+esp_err_t ws_audio_encoder_init(ws_audio_encoder_t *enc, const ws_audio_encoder_config_t *config)
+{
+    if (!enc || !config || !config->sample_rate || !config->channels || config->channels > 2 ||
+            (config->frame_us != 2500 && config->frame_us != 5000 && config->frame_us != 10000) ||
+            (uint64_t)config->sample_rate * config->frame_us % 1000000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->codec == WS_AUDIO_CODEC_PCM || config->codec >= WS_AUDIO_CODEC_COUNT ||
+            !(ws_audio_codec_available() & WS_AUDIO_CODEC_BIT(config->codec))) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    memset(enc, 0, sizeof(*enc));
+    enc->config = *config;
+    enc->frame_samples = (uint32_t)((uint64_t)config->sample_rate * config->frame_us / 1000000);
+    if (enc->frame_samples > WS_AUDIO_FRAME_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (config->codec == WS_AUDIO_CODEC_ADPCM) {
+        enc->max_frame_bytes = ws_audio_adpcm_frame_bytes(config->channels, enc->frame_samples);
+        return ESP_OK;
+    }
+
+#ifdef WS_AUDIO_HAVE_OPUS
+    int err;
+    OpusEncoder *opus = opus_encoder_create((opus_int32)config->sample_rate, config->channels,
+                                            OPUS_APPLICATION_RESTRICTED_LOWDELAY, &err);
+
+    if (err == OPUS_BAD_ARG) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (err != OPUS_OK) {
+        return err == OPUS_ALLOC_FAIL ? ESP_ERR_NO_MEM : ESP_FAIL;
+    }
+    opus_encoder_ctl(opus, OPUS_SET_BITRATE((opus_int32)config->opus_bitrate));
+    opus_encoder_ctl(opus, OPUS_SET_COMPLEXITY(config->opus_complexity));
+    enc->opus = opus;
+    enc->max_frame_bytes = WS_AUDIO_OPUS_MAX_FRAME;
+#endif
+
+    return ESP_OK;
+}
+
+void ws_audio_encoder_deinit(ws_audio_encoder_t *enc)
+{
+#ifdef WS_AUDIO_HAVE_OPUS
+    if (enc->opus) {
+        opus_encoder_destroy(enc->opus);
+    }
+#endif
+    enc->opus = NULL;
+}
+
+uint32_t ws_audio_encoder_max_msg(const ws_audio_encoder_t *enc, uint32_t samples)
+{
+    uint32_t frames = samples / enc->frame_samples;
+
+    return sizeof(ws_audio_coded_header_t) + frames * (sizeof(uint16_t) + enc->max_frame_bytes);
+}
+
+/**
+ * @brief One sample through the IMA step, updating the decoder state it mirrors
+ */
+static uint8_t ws_audio_adpcm_encode_sample(ws_audio_adpcm_state_t *state, int16_t sample)
+{
+    int step = s_adpcm_steps[state->index];
+    int diff = sample - state->predictor;
+    int delta = step >> 3;
+    uint8_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        delta += step;
+    }
+
+    int predictor = state->predictor + (code & 8 ? -delta : delta);
+    state->predictor = (int16_t)(predictor > INT16_MAX ? INT16_MAX : predictor < INT16_MIN ? INT16_MIN : predictor);
+
+    int index = state->index + s_adpcm_index_step[code & 7];
+    state->index = (uint8_t)(index < 0 ? 0 : index > WS_AUDIO_ADPCM_MAX_INDEX ? WS_AUDIO_ADPCM_MAX_INDEX : index);
+
+    return code;
+}
+
+static int16_t ws_audio_adpcm_decode_sample(ws_audio_adpcm_state_t *state, uint8_t code)
+{
+    int step = s_adpcm_steps[state->index];
+    int delta = step >> 3;
+
+    if (code & 4) {
+        delta += step;
+    }
+    if (code & 2) {
+        delta += step >> 1;
+    }
+    if (code & 1) {
+        delta += step >> 2;
+    }
+
+    int predictor = state->predictor + (code & 8 ? -delta : delta);
+    state->predictor = (int16_t)(predictor > INT16_MAX ? INT16_MAX : predictor < INT16_MIN ? INT16_MIN : predictor);
+
+    int index = state->index + s_adpcm_index_step[code & 7];
+    state->index = (uint8_t)(index < 0 ? 0 : index > WS_AUDIO_ADPCM_MAX_INDEX ? WS_AUDIO_ADPCM_MAX_INDEX : index);
+
+    return state->predictor;
+}
+
+static uint32_t ws_audio_adpcm_encode(ws_audio_encoder_t *enc, const int16_t *pcm, uint8_t *out)
+{
+    uint8_t channels = enc->config.channels;
+    uint32_t nibbles = enc->frame_samples * channels;
+    uint8_t *data = out + channels * WS_AUDIO_ADPCM_HEADER;
+
+    for (int c = 0; c < channels; c++) {
+        uint8_t *header = out + c * WS_AUDIO_ADPCM_HEADER;
+
+        memcpy(header, &enc->adpcm[c].predictor, sizeof(int16_t));
+        header[2] = enc->adpcm[c].index;
+        header[3] = 0;
+    }
+
+    for (uint32_t n = 0; n < nibbles; n++) {
+        uint8_t code = ws_audio_adpcm_encode_sample(&enc->adpcm[n % channels], pcm[n]);
+
+        if (n & 1) {
+            data[n / 2] |= (uint8_t)(code << 4);
+        } else {
+            data[n / 2] = code;
+        }
+    }
+
+    return ws_audio_adpcm_frame_bytes(channels, enc->frame_samples);
+}
+
+uint32_t ws_audio_encode_frame(ws_audio_encoder_t *enc, const int16_t *pcm, uint8_t *out, uint32_t cap)
+{
+    if (enc->config.codec == WS_AUDIO_CODEC_ADPCM) {
+        return cap < enc->max_frame_bytes ? 0 : ws_audio_adpcm_encode(enc, pcm, out);
+    }
+
+#ifdef WS_AUDIO_HAVE_OPUS
+    opus_int32 len = opus_encode(enc->opus, pcm, (int)enc->frame_samples, out,
+                                 (opus_int32)(cap < WS_AUDIO_OPUS_MAX_FRAME ? cap : WS_AUDIO_OPUS_MAX_FRAME));
+
+    return len > 0 ? (uint32_t)len : 0;
+#else
+    return 0;
+#endif
+}
+
+uint32_t ws_audio_encode_msg(ws_audio_encoder_t *enc, const uint8_t *pcm_msg, uint32_t pcm_len,
+                             uint8_t *out, uint32_t cap)
+{
+    ws_mux_audio_header_t in;
+    ws_audio_coded_header_t header;
+    uint32_t frame_bytes = enc->frame_samples * enc->config.channels * sizeof(int16_t);
+    uint32_t pos = sizeof(header);
+
+    if (pcm_len < sizeof(in) || cap < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&in, pcm_msg, sizeof(in));
+    if (in.type != WS_MUX_MSG_AUDIO || in.sample_count % enc->frame_samples ||
+            in.sample_count / enc->frame_samples > UINT8_MAX ||
+            pcm_len != sizeof(in) + in.sample_count * enc->config.channels * sizeof(int16_t)) {
+        return 0;
+    }
+
+    header.type = WS_MUX_MSG_AUDIO_CODED;
+    header.timestamp = in.timestamp;
+    header.codec = (uint8_t)enc->config.codec;
+    header.frame_count = (uint8_t)(in.sample_count / enc->frame_samples);
+    header.frame_samples = (uint16_t)enc->frame_samples;
+    memcpy(out, &header, sizeof(header));
+
+    for (uint32_t i = 0; i < header.frame_count; i++) {
+        /* The samples follow a 9-byte header: copy them out to an aligned frame */
+        memcpy(enc->frame, pcm_msg + sizeof(in) + i * frame_bytes, frame_bytes);
+
+        if (cap - pos < sizeof(uint16_t)) {
+            return 0;
+        }
+        uint32_t len = ws_audio_encode_frame(enc, enc->frame, out + pos + sizeof(uint16_t),
+                                             cap - pos - sizeof(uint16_t));
+        if (!len) {
+            return 0;
+        }
+        uint16_t len16 = (uint16_t)len;
+        memcpy(out + pos, &len16, sizeof(len16));
+        pos += sizeof(len16) + len;
+
+        enc->stats.frames++;
+        enc->stats.pcm_bytes += frame_bytes;
+        enc->stats.audio_us += enc->config.frame_us;
+    }
+    enc->stats.coded_bytes += pos - sizeof(header);
+
+    return pos;
+}
+
+void ws_audio_encoder_add_time(ws_audio_encoder_t *enc, uint64_t encode_us)
+{
+    enc->stats.encode_us += encode_us;
+}
+
+uint32_t ws_audio_encoder_load_permille(const ws_audio_encoder_stats_t *stats)
+{
+    return stats->audio_us ? (uint32_t)(stats->encode_us * 1000 / stats->audio_us) : 0;
+}
+
+esp_err_t ws_audio_adpcm_decode(const uint8_t *frame, uint32_t len, uint8_t channels, uint32_t samples,
+                                int16_t *pcm)
+{
+    ws_audio_adpcm_state_t state[2];
+    const uint8_t *data = frame + channels * WS_AUDIO_ADPCM_HEADER;
+
+    if (!channels || channels > 2 || len != ws_audio_adpcm_frame_bytes(channels, samples)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (int c = 0; c < channels; c++) {
+        const uint8_t *header = frame + c * WS_AUDIO_ADPCM_HEADER;
+
+        memcpy(&state[c].predictor, header, sizeof(int16_t));
+        state[c].index = header[2] > WS_AUDIO_ADPCM_MAX_INDEX ? WS_AUDIO_ADPCM_MAX_INDEX : header[2];
+    }
+
+    for (uint32_t n = 0; n < samples * channels; n++) {
+        uint8_t code = n & 1 ? data[n / 2] >> 4 : data[n / 2] & 0x0f;
+
+        pcm[n] = ws_audio_adpcm_decode_sample(&state[n % channels], code);
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file ws_audio_codec.h
+ * @brief Compressed audio for /ws/stream: IMA ADPCM, or Opus when built in
+ *
+ * 48 kHz stereo PCM is 1.5 Mbit/s, as much as a modest JPEG stream. A
+ * client lists the decoders it has with /ws/stream?codecs=opus,adpcm and
+ * the server picks one for the session: Opus if offered, built in and the
+ * encoders already running leave it the CPU, otherwise ADPCM if offered,
+ * otherwise PCM. A client that offers nothing gets PCM as before.
+ *
+ * Audio is cut into codec frames of 2.5, 5 or 10 ms, the Opus low-delay
+ * sizes, and the mux only ever hands over whole frames, so a sample waits
+ * at most one frame plus the coalescing delay before it is encoded.
+ *
+ * ADPCM is 4 bits per sample, a quarter of PCM, at a few cycles per
+ * sample. Every frame starts with each channel's predictor and step index,
+ * so it decodes on its own. Opus needs libopus (opus.h) and
+ * WS_AUDIO_HAVE_OPUS defined; it costs far more CPU and is therefore
+ * measured per encoder, for the server to decide whether another client
+ * can have it.
+ *
+ * Coded message, binary like the others:
+ *
+ *     ws_audio_coded_header_t
+ *     frame_count x { uint16_t len; uint8_t data[len]; }
+ *
+ * ADPCM frame, per channel { int16_t predictor; uint8_t index; uint8_t 0; }
+ * then one nibble per sample, low nibble first, channels interleaved.
+ *
+ * Pure code without locks or clocks like ws_mux: the caller times the
+ * encodes it wants accounted for.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ws_mux.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* From the same code space as esptari_stream.h */
+#define WS_MUX_MSG_AUDIO_CODED      0x07
+
+#define WS_AUDIO_OPUS_MAX_FRAME     1275    // Largest Opus packet
+#define WS_AUDIO_FRAME_MAX          480     // Sample frames, 10 ms at 48 kHz
+
+typedef enum {
+    WS_AUDIO_CODEC_PCM = 0,
+    WS_AUDIO_CODEC_ADPCM,
+    WS_AUDIO_CODEC_OPUS,
+    WS_AUDIO_CODEC_COUNT,
+} ws_audio_codec_t;
+
+#define WS_AUDIO_CODEC_BIT(codec)   (1u << (codec))
+
+/**
+ * @brief Coded audio message, followed by frame_count length-prefixed frames
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // WS_MUX_MSG_AUDIO_CODED
+    uint32_t timestamp;     // Time of the first sample, milliseconds
+    uint8_t  codec;         // ws_audio_codec_t
+    uint8_t  frame_count;
+    uint16_t frame_samples; // Sample frames per codec frame
+} ws_audio_coded_header_t;
+
+typedef struct ws_audio_encoder_config {
+    ws_audio_codec_t codec;         // ADPCM or OPUS
+    uint32_t sample_rate;
+    uint8_t channels;
+    uint32_t frame_us;              // 2500, 5000 or 10000
+    uint32_t opus_bitrate;          // Bits per second
+    int opus_complexity;            // 0 to 10
+} ws_audio_encoder_config_t;
+
+typedef struct ws_audio_encoder_stats {
+    uint32_t frames;
+    uint64_t pcm_bytes;
+    uint64_t coded_bytes;           // Frames with their length prefixes
+    uint64_t audio_us;              // Audio encoded
+    uint64_t encode_us;             // Time the caller reported spending on it
+} ws_audio_encoder_stats_t;
+
+typedef struct ws_audio_adpcm_state {
+    int16_t predictor;
+    uint8_t index;
+} ws_audio_adpcm_state_t;
+
+typedef struct ws_audio_encoder {
+    ws_audio_encoder_config_t config;
+    uint32_t frame_samples;
+    uint32_t max_frame_bytes;
+    ws_audio_adpcm_state_t adpcm[2];
+    void *opus;                     // OpusEncoder
+    int16_t frame[WS_AUDIO_FRAME_MAX * 2];  // Aligned copy of the frame being encoded
+    ws_audio_encoder_stats_t stats;
+} ws_audio_encoder_t;
+
+/** Codecs this build can encode */
+uint32_t ws_audio_codec_available(void);
+
+const char *ws_audio_codec_name(ws_audio_codec_t codec);
+
+/**
+ * @brief Parse a client's comma-separated list of decoders ("opus,adpcm")
+ *
+ * @return WS_AUDIO_CODEC_BIT()s of the known names; unknown ones are ignored
+ */
+uint32_t ws_audio_codec_parse_offer(const char *offer);
+
+/**
+ * @brief Codec of a session: Opus if offered and allowed, then ADPCM, then PCM
+ *
+ * @param opus_allowed Whether the CPU can take one more Opus encoder
+ */
+ws_audio_codec_t ws_audio_codec_pick(uint32_t offer, bool opus_allowed);
+
+/**
+ * @return ESP_ERR_INVALID_ARG for a bad rate, channel count or frame length,
+ *         ESP_ERR_NOT_SUPPORTED for a codec not built in,
+ *         ESP_ERR_NO_MEM or ESP_FAIL if the Opus encoder cannot be created
+ */
+esp_err_t ws_audio_encoder_init(ws_audio_encoder_t *enc, const ws_audio_encoder_config_t *config);
+void ws_audio_encoder_deinit(ws_audio_encoder_t *enc);
+
+/**
+ * @brief Largest coded message for @p samples sample frames, for sizing buffers
+ */
+uint32_t ws_audio_encoder_max_msg(const ws_audio_encoder_t *enc, uint32_t samples);
+
+/**
+ * @brief Encode one codec frame of interleaved PCM
+ *
+ * @return Bytes written, 0 if @p cap is too small or the encoder failed
+ */
+uint32_t ws_audio_encode_frame(ws_audio_encoder_t *enc, const int16_t *pcm, uint8_t *out, uint32_t cap);
+
+/**
+ * @brief Turn a PCM message from ws_mux_take_audio() into a coded message
+ *
+ * The mux must have been set up with frame_samples = enc->frame_samples,
+ * so the message holds whole codec frames.
+ *
+ * @return Bytes written, 0 on a malformed message, a full @p out or an
+ *         encoder failure
+ */
+uint32_t ws_audio_encode_msg(ws_audio_encoder_t *enc, const uint8_t *pcm_msg, uint32_t pcm_len,
+                             uint8_t *out, uint32_t cap);
+
+/**
+ * @brief Account @p encode_us spent on the last ws_audio_encode_msg()
+ */
+void ws_audio_encoder_add_time(ws_audio_encoder_t *enc, uint64_t encode_us);
+
+/**
+ * @brief Share of one core the encoder has needed, in 1/1000s of real time
+ */
+uint32_t ws_audio_encoder_load_permille(const ws_audio_encoder_stats_t *stats);
+
+/**
+ * @brief Decode one ADPCM frame of @p samples sample frames, the browser's counterpart
+ *
+ * @return ESP_ERR_INVALID_SIZE if @p len does not match
+ */
+esp_err_t ws_audio_adpcm_decode(const uint8_t *frame, uint32_t len, uint8_t channels, uint32_t samples,
+                                int16_t *pcm);
+
+#ifdef __cplusplus
+}
+#endif
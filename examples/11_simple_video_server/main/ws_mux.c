@@ -0,0 +1,166 @@
+/**
+ * @file ws_mux.c
+ * @brief Video and audio multiplexing of one /ws/stream client
+ */
+
+#include <string.h>
+#include "ws_mux.h"
+
+#define WS_MUX_BACKLOG_PCT      50      // Queued audio that makes a tick drop its frame
+
+esp_err_t ws_mux_init(ws_mux_t *mux, const ws_mux_config_t *config, uint8_t *audio_buf, uint32_t audio_cap)
+{
+    if (!mux || !config || !audio_buf || !config->refresh_hz || config->refresh_hz > 1000 ||
+            !config->sample_rate || !config->channels || !config->max_delay_ms) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(mux, 0, sizeof(*mux));
+    mux->config = *config;
+    mux->period_us = 1000000 / config->refresh_hz;
+    mux->frame_bytes = config->channels * sizeof(int16_t);
+    mux->granule_bytes = (config->frame_samples ? config->frame_samples : 1) * mux->frame_bytes;
+    mux->coalesce_bytes = (uint32_t)((uint64_t)config->sample_rate * config->coalesce_ms / 1000) * mux->frame_bytes;
+    mux->coalesce_bytes += (mux->granule_bytes - mux->coalesce_bytes % mux->granule_bytes) % mux->granule_bytes;
+    if (mux->coalesce_bytes < mux->granule_bytes) {
+        mux->coalesce_bytes = mux->granule_bytes;
+    }
+    if ((uint64_t)audio_cap * 1000 < (uint64_t)ws_mux_audio_bytes_per_s(config) * 2 * config->max_delay_ms ||
+            audio_cap < 2 * mux->coalesce_bytes) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mux->audio_buf = audio_buf;
+    mux->audio_cap = audio_cap - audio_cap % mux->frame_bytes;
+
+    return ESP_OK;
+}
+
+uint32_t ws_mux_audio_bytes_per_s(const ws_mux_config_t *config)
+{
+    return config->sample_rate * config->channels * sizeof(int16_t);
+}
+
+esp_err_t ws_mux_push_audio(ws_mux_t *mux, int64_t now_us, int64_t timestamp_us, const int16_t *pcm, uint32_t samples)
+{
+    uint32_t bytes = samples * mux->frame_bytes;
+
+    if (mux->audio_len + bytes > mux->audio_cap) {
+        mux->stats.audio_refused++;
+        return ESP_ERR_NO_MEM;
+    }
+    if (!bytes) {
+        return ESP_OK;
+    }
+
+    if (!mux->audio_len) {
+        mux->audio_ts_us = (uint64_t)timestamp_us << 16;
+        mux->audio_queued_us = now_us;
+    }
+
+    uint32_t tail = (mux->audio_head + mux->audio_len) % mux->audio_cap;
+    uint32_t first = mux->audio_cap - tail < bytes ? mux->audio_cap - tail : bytes;
+    memcpy(mux->audio_buf + tail, pcm, first);
+    memcpy(mux->audio_buf, (const uint8_t *)pcm + first, bytes - first);
+    mux->audio_len += bytes;
+    if (mux->audio_len > mux->stats.audio_max_backlog) {
+        mux->stats.audio_max_backlog = mux->audio_len;
+    }
+
+    return ESP_OK;
+}
+
+ws_mux_action_t ws_mux_next(ws_mux_t *mux, int64_t now_us, int64_t *wait_us)
+{
+    if (!mux->next_tick_us) {
+        mux->next_tick_us = now_us;
+    }
+
+    if (now_us >= mux->next_tick_us) {
+        /* The frame follows the sound queued before it, never the other way round */
+        if (mux->audio_len >= mux->granule_bytes) {
+            return WS_MUX_AUDIO;
+        }
+
+        int64_t missed = (now_us - mux->next_tick_us) / mux->period_us;
+        mux->stats.late_ticks += (uint32_t)missed;
+        mux->next_tick_us += (missed + 1) * mux->period_us;
+        mux->stats.ticks++;
+        return WS_MUX_VIDEO;
+    }
+
+    int64_t due_us = mux->next_tick_us;
+    if (mux->audio_len >= mux->granule_bytes) {
+        int64_t flush_us = mux->audio_queued_us + (int64_t)mux->config.max_delay_ms * 1000;
+
+        if (mux->audio_len >= mux->coalesce_bytes || now_us >= flush_us) {
+            return WS_MUX_AUDIO;
+        }
+        if (flush_us < due_us) {
+            due_us = flush_us;
+        }
+    }
+
+    *wait_us = due_us - now_us;
+    return WS_MUX_IDLE;
+}
+
+uint32_t ws_mux_take_audio(ws_mux_t *mux, uint8_t *msg, uint32_t cap)
+{
+    ws_mux_audio_header_t header;
+
+    if (mux->audio_len < mux->granule_bytes || cap < sizeof(header) + mux->granule_bytes) {
+        return 0;
+    }
+
+    uint32_t bytes = cap - sizeof(header);
+    if (bytes > mux->audio_len) {
+        bytes = mux->audio_len;
+    }
+    bytes -= bytes % mux->granule_bytes;
+    uint32_t samples = bytes / mux->frame_bytes;
+
+    header.type = WS_MUX_MSG_AUDIO;
+    header.timestamp = (uint32_t)((mux->audio_ts_us >> 16) / 1000);
+    header.sample_count = samples;
+    memcpy(msg, &header, sizeof(header));
+
+    uint32_t first = mux->audio_cap - mux->audio_head < bytes ? mux->audio_cap - mux->audio_head : bytes;
+    memcpy(msg + sizeof(header), mux->audio_buf + mux->audio_head, first);
+    memcpy(msg + sizeof(header) + first, mux->audio_buf, bytes - first);
+    mux->audio_head = (mux->audio_head + bytes) % mux->audio_cap;
+    mux->audio_len -= bytes;
+
+    /* What is left was queued with the chunk just sent, so it keeps the same deadline */
+    mux->audio_ts_us += ((uint64_t)samples * 1000000 << 16) / mux->config.sample_rate;
+    mux->stats.audio_msgs++;
+    mux->stats.audio_samples += samples;
+
+    return sizeof(header) + bytes;
+}
+
+bool ws_mux_video_frame(ws_mux_t *mux, bool fresh)
+{
+    if (!fresh) {
+        mux->stats.repeats++;
+        return false;
+    }
+
+    /* Audio piling up while frames go out means the link is full: give it to the audio */
+    if ((uint64_t)mux->audio_len * 100 > (uint64_t)mux->audio_cap * WS_MUX_BACKLOG_PCT) {
+        mux->stats.video_dropped++;
+        return false;
+    }
+
+    mux->stats.video_sent++;
+    return true;
+}
+
+void ws_mux_video_header(ws_mux_video_header_t *header, int64_t timestamp_us, uint32_t frame_number,
+                         uint16_t width, uint16_t height)
+{
+    header->type = WS_MUX_MSG_VIDEO_JPEG;
+    header->timestamp = (uint32_t)(timestamp_us / 1000);
+    header->frame_number = frame_number;
+    header->width = width;
+    header->height = height;
+}
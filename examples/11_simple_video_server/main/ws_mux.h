@@ -0,0 +1,161 @@
+/**
+ * @file ws_mux.h
+ * @brief Video and audio multiplexing of one /ws/stream client
+ *
+ * Decides what goes on the socket next. Video is paced to the emulated
+ * vertical rate (50, 60 or 71 Hz): at every tick the newest frame goes
+ * out, frames between ticks are never sent. A tick that comes late
+ * because a send overran is not made up for, and under backpressure the
+ * frame of a tick is dropped.
+ *
+ * Audio is never dropped. Producers queue PCM into a per-client FIFO and
+ * the mux coalesces the small chunks into messages of at least
+ * coalesce_ms, or less once the oldest sample waited max_delay_ms. Queued
+ * audio is always flushed before a frame, so a large frame never holds
+ * up the sound. A full FIFO refuses the whole chunk and the producer
+ * waits; a client that cannot keep up with the audio is closed rather
+ * than given a gap. For a compressed session (ws_audio_codec.h) messages
+ * hold whole codec frames only; the rest waits for the producer.
+ *
+ * Pure bookkeeping without locks or clocks like quality_ctrl: the caller
+ * passes timestamps and serialises the calls.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Message types, from the same code space as esptari_stream.h */
+#define WS_MUX_MSG_AUDIO        0x02
+#define WS_MUX_MSG_VIDEO_JPEG   0x05
+
+/**
+ * @brief Video message (IMPLEMENTATION_PLAN.md, 3.4), followed by the JPEG
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // WS_MUX_MSG_VIDEO_JPEG
+    uint32_t timestamp;     // Capture time, milliseconds
+    uint32_t frame_number;
+    uint16_t width;
+    uint16_t height;
+} ws_mux_video_header_t;
+
+/**
+ * @brief Audio message, followed by sample_count interleaved int16 frames
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // WS_MUX_MSG_AUDIO
+    uint32_t timestamp;     // Time of the first sample, milliseconds
+    uint32_t sample_count;  // Sample frames, one int16 per channel each
+} ws_mux_audio_header_t;
+
+typedef enum {
+    WS_MUX_IDLE = 0,        // Nothing to send before *wait_us
+    WS_MUX_AUDIO,           // Send ws_mux_take_audio()
+    WS_MUX_VIDEO,           // A vertical tick, send the newest frame if ws_mux_video_frame() agrees
+} ws_mux_action_t;
+
+typedef struct ws_mux_config {
+    uint32_t refresh_hz;    // Emulated vertical rate, 50, 60 or 71
+    uint32_t sample_rate;
+    uint8_t channels;
+    uint32_t coalesce_ms;   // Shortest audio message while the audio is on time
+    uint32_t max_delay_ms;  // Longest a sample waits for the message to fill up
+    uint32_t frame_samples; // Messages hold whole multiples of this many sample frames, 0 for any
+} ws_mux_config_t;
+
+typedef struct ws_mux_stats {
+    uint32_t ticks;
+    uint32_t late_ticks;        // Ticks skipped because a send overran them
+    uint32_t repeats;           // Ticks without a new frame
+    uint32_t video_sent;
+    uint32_t video_dropped;     // Frames of a tick dropped under backpressure
+    uint32_t audio_msgs;
+    uint64_t audio_samples;
+    uint32_t audio_refused;     // Pushes refused by a full FIFO, retried by the producer
+    uint32_t audio_max_backlog; // Most bytes queued at once
+} ws_mux_stats_t;
+
+typedef struct ws_mux {
+    ws_mux_config_t config;
+    uint32_t period_us;
+    uint32_t frame_bytes;       // One sample frame
+    uint32_t coalesce_bytes;
+    uint32_t granule_bytes;     // Whole codec frames, or one sample frame
+    int64_t next_tick_us;       // 0 until the first call to ws_mux_next()
+    uint8_t *audio_buf;
+    uint32_t audio_cap;
+    uint32_t audio_head;
+    uint32_t audio_len;
+    uint64_t audio_ts_us;       // Timestamp of the oldest queued sample, in us << 16 for exact steps
+    int64_t audio_queued_us;    // When the oldest queued sample was pushed
+    ws_mux_stats_t stats;
+} ws_mux_t;
+
+/**
+ * @brief Initialize the mux over a caller-owned audio FIFO
+ *
+ * @param audio_buf FIFO of @p audio_cap bytes, at least 2 * max_delay_ms of audio
+ *
+ * @return ESP_ERR_INVALID_ARG for a bad rate, format or FIFO size
+ */
+esp_err_t ws_mux_init(ws_mux_t *mux, const ws_mux_config_t *config, uint8_t *audio_buf, uint32_t audio_cap);
+
+/**
+ * @brief Queue interleaved PCM, all of it or nothing
+ *
+ * @param now_us When it is queued
+ * @param timestamp_us Time of the first sample
+ * @param samples Sample frames
+ *
+ * @return ESP_ERR_NO_MEM if the FIFO has no room for the whole chunk
+ */
+esp_err_t ws_mux_push_audio(ws_mux_t *mux, int64_t now_us, int64_t timestamp_us, const int16_t *pcm, uint32_t samples);
+
+/**
+ * @brief Pick what to send next
+ *
+ * Returning WS_MUX_VIDEO consumes the tick.
+ *
+ * @param wait_us Set to how long nothing is due for WS_MUX_IDLE
+ */
+ws_mux_action_t ws_mux_next(ws_mux_t *mux, int64_t now_us, int64_t *wait_us);
+
+/**
+ * @brief Dequeue one audio message, header included
+ *
+ * @param cap Size of @p msg, which bounds the message
+ *
+ * @return Bytes written, 0 if no audio is queued
+ */
+uint32_t ws_mux_take_audio(ws_mux_t *mux, uint8_t *msg, uint32_t cap);
+
+/**
+ * @brief Decide on the frame of a tick
+ *
+ * @param fresh Whether a frame newer than the last one sent is available
+ *
+ * @return true to send it
+ */
+bool ws_mux_video_frame(ws_mux_t *mux, bool fresh);
+
+/**
+ * @brief Fill in a video message header
+ */
+void ws_mux_video_header(ws_mux_video_header_t *header, int64_t timestamp_us, uint32_t frame_number,
+                         uint16_t width, uint16_t height);
+
+/**
+ * @brief Bytes of audio messages per second, for sizing the FIFO
+ */
+uint32_t ws_mux_audio_bytes_per_s(const ws_mux_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,524 @@
+/**
+ * @file ws_stream.c
+ * @brief /ws/stream: JPEG frames and PCM audio on one WebSocket
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "ws_stream.h"
+
+#define WS_STREAM_AUDIO_MSG_MS      40      // Longest audio message
+#define WS_STREAM_CLIENT_POLL_MS    100     // Sender wakeup to notice a closed socket
+#define WS_STREAM_TONE_CHUNK        64      // Sample frames per tone push, like a small emulator buffer
+#define WS_STREAM_TONE_PERIOD_MS    5
+#define WS_STREAM_TONE_STACK_SIZE   (3 * 1024)
+#define WS_STREAM_TONE_PRIORITY     5
+#define WS_STREAM_OPUS_GUESS        100     // Load of an Opus encoder before one was measured, permille
+
+typedef struct ws_stream_client {
+    bool in_use;
+    volatile bool closing;
+    httpd_handle_t hd;
+    int fd;
+    ws_stream_source_t *source;
+    frame_ring_client_t *ring_client;
+    SemaphoreHandle_t lock;         // Guards everything above and the mux
+    SemaphoreHandle_t wake;         // Audio queued or closing
+    SemaphoreHandle_t space;        // Audio dequeued
+    ws_mux_t mux;
+    uint8_t *fifo;
+    uint8_t *msg;                   // One audio message
+    uint32_t msg_size;
+    ws_audio_codec_t codec;
+    ws_audio_encoder_t enc;         // Sender task only
+    ws_audio_encoder_stats_t enc_stats; // Copy of enc.stats under the lock
+    uint8_t *coded;                 // msg encoded
+    uint32_t coded_size;
+} ws_stream_client_t;
+
+typedef struct ws_stream {
+    ws_stream_config_t config;
+    SemaphoreHandle_t lock;         // Guards in_use of the clients
+    ws_stream_client_t clients[WS_STREAM_MAX_CLIENTS];
+} ws_stream_t;
+
+static const char *TAG = "ws_stream";
+
+static ws_stream_t s_ws;
+
+static void ws_stream_delete_semaphore(SemaphoreHandle_t *sem)
+{
+    if (*sem) {
+        vSemaphoreDelete(*sem);
+        *sem = NULL;
+    }
+}
+
+esp_err_t ws_stream_init(const ws_stream_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && config->channels && config->channels <= 2, ESP_ERR_INVALID_ARG, TAG, "invalid config");
+    ESP_RETURN_ON_FALSE(config->frame_us == 2500 || config->frame_us == 5000 || config->frame_us == 10000,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid codec frame");
+    ESP_RETURN_ON_FALSE(!s_ws.lock, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    s_ws.config = *config;
+    s_ws.lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_ws.lock, ESP_ERR_NO_MEM, TAG, "failed to create lock");
+    for (int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+        ws_stream_client_t *client = &s_ws.clients[i];
+
+        client->lock = xSemaphoreCreateMutex();
+        client->wake = xSemaphoreCreateBinary();
+        client->space = xSemaphoreCreateBinary();
+        ESP_GOTO_ON_FALSE(client->lock && client->wake && client->space, ESP_ERR_NO_MEM, fail0, TAG,
+                          "failed to create client semaphores");
+    }
+
+    return ESP_OK;
+
+fail0:
+    for (int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+        ws_stream_delete_semaphore(&s_ws.clients[i].lock);
+        ws_stream_delete_semaphore(&s_ws.clients[i].wake);
+        ws_stream_delete_semaphore(&s_ws.clients[i].space);
+    }
+    ws_stream_delete_semaphore(&s_ws.lock);
+    return ret;
+}
+
+static esp_err_t ws_stream_send(ws_stream_client_t *client, httpd_ws_type_t type, const void *data, size_t len,
+                                bool fragmented, bool final)
+{
+    httpd_ws_frame_t frame = {
+        .final = final,
+        .fragmented = fragmented,
+        .type = type,
+        .payload = (uint8_t *)data,
+        .len = len,
+    };
+
+    return httpd_ws_send_frame_async(client->hd, client->fd, &frame);
+}
+
+/**
+ * @brief The frame of a tick: the newest one, unless the mux drops it
+ */
+static esp_err_t ws_stream_send_frame(ws_stream_client_t *client)
+{
+    esp_err_t ret = ESP_OK;
+    ws_stream_source_t *source = client->source;
+    const frame_ring_slot_t *slot;
+    bool fresh = frame_ring_read(source->ring, client->ring_client, 0, &slot) == ESP_OK;
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    bool send = ws_mux_video_frame(&client->mux, fresh);
+    xSemaphoreGive(client->lock);
+    if (!fresh) {
+        return ESP_OK;
+    }
+
+    if (send) {
+        ws_mux_video_header_t header;
+        int64_t start_us = frame_pipeline_now_us();
+
+        ws_mux_video_header(&header, slot->timestamp_us, slot->seq, source->width, source->height);
+        ret = ws_stream_send(client, HTTPD_WS_TYPE_BINARY, &header, sizeof(header), true, false);
+        if (ret == ESP_OK) {
+            /* Sent straight from the ring slot, shared with the other clients */
+            ret = ws_stream_send(client, HTTPD_WS_TYPE_CONTINUE, slot->buf, slot->len, true, true);
+        }
+        if (ret == ESP_OK && source->pipeline) {
+            frame_pipeline_record_send(source->pipeline, client->ring_client, start_us, slot->timestamp_us, slot->len);
+        }
+    }
+    frame_ring_release(source->ring, client->ring_client, slot, send && ret == ESP_OK);
+
+    return ret;
+}
+
+/**
+ * @brief An audio message as taken from the mux, encoded here on the sender's core
+ */
+static esp_err_t ws_stream_send_audio(ws_stream_client_t *client, uint32_t audio_len)
+{
+    if (client->codec == WS_AUDIO_CODEC_PCM) {
+        return ws_stream_send(client, HTTPD_WS_TYPE_BINARY, client->msg, audio_len, false, true);
+    }
+
+    int64_t start_us = frame_pipeline_now_us();
+    uint32_t len = ws_audio_encode_msg(&client->enc, client->msg, audio_len, client->coded, client->coded_size);
+
+    ws_audio_encoder_add_time(&client->enc, frame_pipeline_now_us() - start_us);
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    client->enc_stats = client->enc.stats;
+    xSemaphoreGive(client->lock);
+    ESP_RETURN_ON_FALSE(len, ESP_FAIL, TAG, "ws client %d: failed to encode audio", client->fd);
+
+    return ws_stream_send(client, HTTPD_WS_TYPE_BINARY, client->coded, len, false, true);
+}
+
+static void ws_stream_client_free(ws_stream_client_t *client)
+{
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    if (client->ring_client) {
+        if (client->source->pipeline) {
+            frame_pipeline_remove_client(client->source->pipeline, client->ring_client);
+        }
+        frame_ring_detach(client->source->ring, client->ring_client);
+        client->ring_client = NULL;
+    }
+    free(client->fifo);
+    client->fifo = NULL;
+    free(client->msg);
+    client->msg = NULL;
+    free(client->coded);
+    client->coded = NULL;
+    ws_audio_encoder_deinit(&client->enc);
+    client->in_use = false;
+    xSemaphoreGive(client->lock);
+
+    /* A producer waiting for room finds the client gone */
+    xSemaphoreGive(client->space);
+}
+
+static void ws_stream_client_task(void *arg)
+{
+    esp_err_t ret;
+    ws_stream_client_t *client = (ws_stream_client_t *)arg;
+    char hello[224];
+
+    int len = snprintf(hello, sizeof(hello),
+                       "{\"type\":\"hello\",\"refreshHz\":%" PRIu32 ",\"sampleRate\":%" PRIu32 ",\"channels\":%u,"
+                       "\"audioCodec\":\"%s\",\"audioFrameSamples\":%" PRIu32 ",\"width\":%u,\"height\":%u}",
+                       client->mux.config.refresh_hz, client->mux.config.sample_rate, client->mux.config.channels,
+                       ws_audio_codec_name(client->codec), client->mux.config.frame_samples,
+                       client->source->width, client->source->height);
+    ret = ws_stream_send(client, HTTPD_WS_TYPE_TEXT, hello, len, false, true);
+
+    while (ret == ESP_OK && !client->closing &&
+            httpd_ws_get_fd_info(client->hd, client->fd) == HTTPD_WS_CLIENT_WEBSOCKET) {
+        int64_t wait_us = 0;
+        uint32_t audio_len = 0;
+
+        xSemaphoreTake(client->lock, portMAX_DELAY);
+        ws_mux_action_t action = ws_mux_next(&client->mux, frame_pipeline_now_us(), &wait_us);
+        if (action == WS_MUX_AUDIO) {
+            audio_len = ws_mux_take_audio(&client->mux, client->msg, client->msg_size);
+        }
+        xSemaphoreGive(client->lock);
+
+        switch (action) {
+        case WS_MUX_AUDIO:
+            xSemaphoreGive(client->space);
+            ret = ws_stream_send_audio(client, audio_len);
+            break;
+        case WS_MUX_VIDEO:
+            ret = ws_stream_send_frame(client);
+            break;
+        default: {
+            TickType_t ticks = pdMS_TO_TICKS((wait_us + 999) / 1000);
+
+            if (ticks > pdMS_TO_TICKS(WS_STREAM_CLIENT_POLL_MS)) {
+                ticks = pdMS_TO_TICKS(WS_STREAM_CLIENT_POLL_MS);
+            }
+            xSemaphoreTake(client->wake, ticks ? ticks : 1);
+            break;
+        }
+        }
+    }
+
+    ESP_LOGI(TAG, "video%d: ws client %d left after %" PRIu32 " frames, %" PRIu32 " dropped, %" PRIu32 " late ticks",
+             client->source->index, client->fd, client->mux.stats.video_sent, client->mux.stats.video_dropped,
+             client->mux.stats.late_ticks);
+    ws_stream_client_free(client);
+    vTaskDelete(NULL);
+}
+
+static uint32_t ws_stream_query_hz(httpd_req_t *req)
+{
+    char query[64];
+    char value[8];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "hz", value, sizeof(value)) == ESP_OK) {
+        int hz = atoi(value);
+
+        if (hz == 50 || hz == 60 || hz == 71) {
+            return hz;
+        }
+        ESP_LOGW(TAG, "unsupported refresh rate %s, using %" PRIu32, value, s_ws.config.refresh_hz);
+    }
+
+    return s_ws.config.refresh_hz;
+}
+
+static uint32_t ws_stream_query_codecs(httpd_req_t *req)
+{
+    char query[64];
+    char value[32];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "codecs", value, sizeof(value)) == ESP_OK) {
+        return ws_audio_codec_parse_offer(value);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Whether the Opus encoders running, plus one more, fit in the budget
+ *
+ * A new encoder is assumed to cost what the running ones do on average.
+ */
+static bool ws_stream_opus_allowed(void)
+{
+    uint32_t load = 0;
+    uint32_t measured = 0;
+    uint32_t running = 0;
+
+    for (int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+        ws_stream_client_t *client = &s_ws.clients[i];
+
+        xSemaphoreTake(client->lock, portMAX_DELAY);
+        if (client->in_use && client->fifo && client->codec == WS_AUDIO_CODEC_OPUS) {
+            uint32_t permille = ws_audio_encoder_load_permille(&client->enc_stats);
+
+            running++;
+            if (client->enc_stats.audio_us) {
+                load += permille;
+                measured++;
+            }
+        }
+        xSemaphoreGive(client->lock);
+    }
+
+    uint32_t each = measured ? load / measured : WS_STREAM_OPUS_GUESS;
+    return (running + 1) * each <= s_ws.config.opus_max_load_permille;
+}
+
+static esp_err_t ws_stream_open(httpd_req_t *req)
+{
+    esp_err_t ret;
+    ws_stream_source_t *source = (ws_stream_source_t *)req->user_ctx;
+    ws_stream_client_t *client = NULL;
+    const ws_stream_config_t *config = &s_ws.config;
+    ws_mux_config_t mux_config = {
+        .refresh_hz = ws_stream_query_hz(req),
+        .sample_rate = config->sample_rate,
+        .channels = config->channels,
+        .coalesce_ms = config->coalesce_ms,
+        .max_delay_ms = config->max_delay_ms,
+    };
+    ws_audio_encoder_config_t enc_config = {
+        .sample_rate = config->sample_rate,
+        .channels = config->channels,
+        .frame_us = config->frame_us,
+        .opus_bitrate = config->opus_bitrate,
+        .opus_complexity = config->opus_complexity,
+    };
+    uint32_t bytes_per_s = ws_mux_audio_bytes_per_s(&mux_config);
+    uint32_t fifo_size = (uint32_t)((uint64_t)bytes_per_s * config->fifo_ms / 1000);
+    uint32_t msg_samples = bytes_per_s * WS_STREAM_AUDIO_MSG_MS / 1000 / (config->channels * sizeof(int16_t));
+
+    ESP_RETURN_ON_FALSE(s_ws.lock, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    uint32_t offer = ws_stream_query_codecs(req);
+    if (offer && (uint64_t)config->sample_rate * config->frame_us % 1000000) {
+        /* 44.1 kHz in 2.5 or 5 ms frames: compressed audio needs whole samples per frame */
+        ESP_LOGW(TAG, "video%d: %" PRIu32 " Hz is not a whole number of samples per %" PRIu32 " us frame, sending PCM",
+                 source->index, config->sample_rate, config->frame_us);
+        offer = 0;
+    }
+    ws_audio_codec_t codec = ws_audio_codec_pick(offer, offer && ws_stream_opus_allowed());
+    enc_config.codec = codec;
+
+    xSemaphoreTake(s_ws.lock, portMAX_DELAY);
+    for (int i = 0; i < WS_STREAM_MAX_CLIENTS && !client; i++) {
+        if (!s_ws.clients[i].in_use) {
+            client = &s_ws.clients[i];
+            client->in_use = true;
+        }
+    }
+    xSemaphoreGive(s_ws.lock);
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_NO_MEM, TAG, "video%d: too many ws clients", source->index);
+
+    client->closing = false;
+    client->hd = req->handle;
+    client->fd = httpd_req_to_sockfd(req);
+    client->source = source;
+    client->msg_size = sizeof(ws_mux_audio_header_t) + bytes_per_s * WS_STREAM_AUDIO_MSG_MS / 1000;
+    client->codec = codec;
+    client->coded_size = 0;
+    memset(&client->enc_stats, 0, sizeof(client->enc_stats));
+    if (codec != WS_AUDIO_CODEC_PCM) {
+        ESP_GOTO_ON_ERROR(ws_audio_encoder_init(&client->enc, &enc_config), fail0, TAG, "failed to init %s encoder",
+                          ws_audio_codec_name(codec));
+        mux_config.frame_samples = client->enc.frame_samples;
+        client->coded_size = ws_audio_encoder_max_msg(&client->enc, msg_samples);
+    }
+    client->fifo = malloc(fifo_size);
+    client->msg = malloc(client->msg_size);
+    client->coded = client->coded_size ? malloc(client->coded_size) : NULL;
+    xSemaphoreTake(client->wake, 0);
+    xSemaphoreTake(client->space, 0);
+    ESP_GOTO_ON_FALSE(client->fifo && client->msg && (client->coded || !client->coded_size), ESP_ERR_NO_MEM, fail0, TAG,
+                      "failed to alloc audio buffers");
+    ESP_GOTO_ON_ERROR(ws_mux_init(&client->mux, &mux_config, client->fifo, fifo_size), fail0, TAG, "failed to init mux");
+    ESP_GOTO_ON_ERROR(frame_ring_attach(source->ring, client->fd, &client->ring_client), fail0, TAG,
+                      "video%d: too many stream clients", source->index);
+
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(ws_stream_client_task, "ws_client", config->stack_size, client,
+                                              config->task_priority, NULL, config->task_core) == pdPASS,
+                      ESP_ERR_NO_MEM, fail0, TAG, "failed to create ws client task");
+
+    ESP_LOGI(TAG, "video%d: ws client %d connected at %" PRIu32 " Hz, %s audio", source->index, client->fd,
+             mux_config.refresh_hz, ws_audio_codec_name(codec));
+
+    return ESP_OK;
+
+fail0:
+    ws_stream_client_free(client);
+    return ret;
+}
+
+esp_err_t ws_stream_handler(httpd_req_t *req)
+{
+    httpd_ws_frame_t frame = {0};
+    uint8_t payload[64];
+
+    if (req->method == HTTP_GET) {
+        /* Handshake done, the connection stays with the server task for incoming frames */
+        return ws_stream_open(req);
+    }
+
+    /* Nothing is expected from the client yet; read and drop what it sends */
+    ESP_RETURN_ON_ERROR(httpd_ws_recv_frame(req, &frame, 0), TAG, "failed to get ws frame length");
+    if (frame.len) {
+        ESP_RETURN_ON_FALSE(frame.len <= sizeof(payload), ESP_ERR_INVALID_SIZE, TAG, "ws frame too large");
+        frame.payload = payload;
+        ESP_RETURN_ON_ERROR(httpd_ws_recv_frame(req, &frame, frame.len), TAG, "failed to receive ws frame");
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ws_stream_push_audio(int64_t timestamp_us, const int16_t *pcm, uint32_t samples, TickType_t timeout)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(pcm || !samples, ESP_ERR_INVALID_ARG, TAG, "invalid pcm");
+
+    for (int i = 0; s_ws.lock && i < WS_STREAM_MAX_CLIENTS; i++) {
+        ws_stream_client_t *client = &s_ws.clients[i];
+
+        while (1) {
+            esp_err_t push_ret;
+
+            xSemaphoreTake(client->lock, portMAX_DELAY);
+            if (!client->in_use || client->closing || !client->fifo) {
+                xSemaphoreGive(client->lock);
+                break;
+            }
+            if (samples * client->mux.frame_bytes > client->mux.audio_cap) {
+                xSemaphoreGive(client->lock);
+                ret = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+            push_ret = ws_mux_push_audio(&client->mux, frame_pipeline_now_us(), timestamp_us, pcm, samples);
+            xSemaphoreGive(client->lock);
+
+            if (push_ret == ESP_OK) {
+                xSemaphoreGive(client->wake);
+                break;
+            }
+            if (xSemaphoreTake(client->space, timeout) != pdPASS) {
+                ESP_LOGW(TAG, "ws client %d cannot keep up with the audio, closing", client->fd);
+                xSemaphoreTake(client->lock, portMAX_DELAY);
+                client->closing = true;
+                xSemaphoreGive(client->lock);
+                xSemaphoreGive(client->wake);
+                break;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int ws_stream_get_stats(const ws_stream_source_t *source, ws_stream_client_stats_t *stats, int max)
+{
+    int count = 0;
+
+    for (int i = 0; s_ws.lock && i < WS_STREAM_MAX_CLIENTS && count < max; i++) {
+        ws_stream_client_t *client = &s_ws.clients[i];
+
+        xSemaphoreTake(client->lock, portMAX_DELAY);
+        if (client->in_use && client->fifo && client->source == source) {
+            stats[count].sockfd = client->fd;
+            stats[count].index = source->index;
+            stats[count].refresh_hz = client->mux.config.refresh_hz;
+            stats[count].codec = client->codec;
+            stats[count].mux = client->mux.stats;
+            stats[count].encoder = client->enc_stats;
+            count++;
+        }
+        xSemaphoreGive(client->lock);
+    }
+
+    return count;
+}
+
+static void ws_stream_tone_task(void *arg)
+{
+    uint32_t tone_hz = (uint32_t)(uintptr_t)arg;
+    uint32_t rate = s_ws.config.sample_rate;
+    uint8_t channels = s_ws.config.channels;
+    int16_t pcm[WS_STREAM_TONE_CHUNK * 2];
+    float phase = 0;
+    float step = 2 * (float)M_PI * tone_hz / rate;
+    uint64_t pushed = 0;
+    int64_t start_us = frame_pipeline_now_us();
+
+    while (1) {
+        uint64_t due = (uint64_t)(frame_pipeline_now_us() - start_us) * rate / 1000000;
+
+        while (pushed + WS_STREAM_TONE_CHUNK <= due) {
+            for (int i = 0; i < WS_STREAM_TONE_CHUNK; i++) {
+                int16_t value = (int16_t)(sinf(phase) * 8192);
+
+                for (int c = 0; c < channels; c++) {
+                    pcm[i * channels + c] = value;
+                }
+                phase += step;
+                if (phase > 2 * (float)M_PI) {
+                    phase -= 2 * (float)M_PI;
+                }
+            }
+            ws_stream_push_audio(start_us + (int64_t)(pushed * 1000000 / rate), pcm, WS_STREAM_TONE_CHUNK,
+                                 pdMS_TO_TICKS(s_ws.config.fifo_ms));
+            pushed += WS_STREAM_TONE_CHUNK;
+        }
+        vTaskDelay(pdMS_TO_TICKS(WS_STREAM_TONE_PERIOD_MS));
+    }
+}
+
+esp_err_t ws_stream_start_test_tone(uint32_t tone_hz)
+{
+    ESP_RETURN_ON_FALSE(s_ws.lock, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(tone_hz && tone_hz < s_ws.config.sample_rate / 2, ESP_ERR_INVALID_ARG, TAG, "invalid tone");
+
+    ESP_RETURN_ON_FALSE(xTaskCreate(ws_stream_tone_task, "ws_tone", WS_STREAM_TONE_STACK_SIZE, (void *)(uintptr_t)tone_hz,
+                                    WS_STREAM_TONE_PRIORITY, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "failed to create tone task");
+
+    return ESP_OK;
+}
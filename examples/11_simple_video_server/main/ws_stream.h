@@ -0,0 +1,111 @@
+/**
+ * @file ws_stream.h
+ * @brief /ws/stream: JPEG frames and PCM audio on one WebSocket
+ *
+ * Every client gets a sender task that reads the camera's frame ring like
+ * a /stream client and multiplexes it with the audio through a ws_mux_t:
+ * one frame per emulated vertical tick, audio coalesced and never
+ * dropped. The first message is a text hello with the stream parameters,
+ * all others are binary ws_mux_video_header_t or ws_mux_audio_header_t
+ * messages. A frame goes out as two fragments, the header and then the
+ * JPEG straight from its ring slot, which the browser reassembles.
+ *
+ * A client picks its tick rate with /ws/stream?hz=50, 60 or 71, and lists
+ * the audio decoders it has with codecs=opus,adpcm (ws_audio_codec.h).
+ * The hello names the codec picked; compressed audio then goes out as
+ * ws_audio_coded_header_t messages, encoded by the sender task, which
+ * runs on the core given in the config so the emulator's core never
+ * spends a cycle on it.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "frame_ring.h"
+#include "frame_pipeline.h"
+#include "ws_mux.h"
+#include "ws_audio_codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WS_STREAM_MAX_CLIENTS   4
+
+/**
+ * @brief Video of one camera, the user_ctx of its /ws/stream handler
+ */
+typedef struct ws_stream_source {
+    frame_ring_t *ring;
+    frame_pipeline_t *pipeline;     // Send times go to its stats, may be NULL
+    uint16_t width;
+    uint16_t height;
+    int index;
+} ws_stream_source_t;
+
+typedef struct ws_stream_config {
+    uint32_t refresh_hz;            // Tick rate of clients that do not ask for one
+    uint32_t sample_rate;
+    uint8_t channels;
+    uint32_t coalesce_ms;
+    uint32_t max_delay_ms;
+    uint32_t fifo_ms;               // Audio queued per client before the producer waits
+    uint32_t frame_us;              // Codec frame, 2500, 5000 or 10000
+    uint32_t opus_bitrate;
+    int opus_complexity;
+    uint32_t opus_max_load_permille;    // Share of the sender core all Opus encoders may take
+    uint32_t stack_size;            // Sender task of each client, encoder included
+    uint32_t task_priority;
+    int task_core;                  // Sender tasks, and so the audio encoders
+} ws_stream_config_t;
+
+typedef struct ws_stream_client_stats {
+    int sockfd;
+    int index;                      // Camera
+    uint32_t refresh_hz;
+    ws_audio_codec_t codec;
+    ws_mux_stats_t mux;
+    ws_audio_encoder_stats_t encoder;   // Zero for PCM
+} ws_stream_client_stats_t;
+
+/**
+ * @brief Set up the client table, once before registering any handler
+ */
+esp_err_t ws_stream_init(const ws_stream_config_t *config);
+
+/**
+ * @brief WebSocket handler of /ws/stream, register with is_websocket set
+ */
+esp_err_t ws_stream_handler(httpd_req_t *req);
+
+/**
+ * @brief Queue interleaved PCM for every client
+ *
+ * Waits up to @p timeout for each client with a full audio queue. A client
+ * still full after that cannot keep up and is closed; its audio is not
+ * thinned out.
+ *
+ * @param samples Sample frames
+ *
+ * @return ESP_ERR_INVALID_SIZE if the chunk is larger than a client's queue
+ */
+esp_err_t ws_stream_push_audio(int64_t timestamp_us, const int16_t *pcm, uint32_t samples, TickType_t timeout);
+
+/**
+ * @brief Statistics of the clients of one camera
+ *
+ * @return Number of entries written
+ */
+int ws_stream_get_stats(const ws_stream_source_t *source, ws_stream_client_stats_t *stats, int max);
+
+/**
+ * @brief Push a sine tone, a stand-in for the emulator's sound in this example
+ */
+esp_err_t ws_stream_start_test_tone(uint32_t tone_hz);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file esp_check.h
+ * @brief The esp_check macros the encoder pool uses, on a host
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define ESP_RETURN_ON_ERROR(x, tag, fmt, ...) do {                  \
+        esp_err_t err_rc_ = (x);                                    \
+        if (err_rc_ != ESP_OK) {                                    \
+            ESP_LOGE(tag, "%s(%d): " fmt, __func__, __LINE__, ##__VA_ARGS__); \
+            return err_rc_;                                         \
+        }                                                           \
+    } while (0)
+
+#define ESP_RETURN_ON_FALSE(a, err_code, tag, fmt, ...) do {        \
+        if (!(a)) {                                                 \
+            ESP_LOGE(tag, "%s(%d): " fmt, __func__, __LINE__, ##__VA_ARGS__); \
+            return err_code;                                        \
+        }                                                           \
+    } while (0)
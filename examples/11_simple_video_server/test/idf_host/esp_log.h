@@ -0,0 +1,13 @@
+/**
+ * @file esp_log.h
+ * @brief Just enough of esp_log to build the encoder pool on a host
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...)     fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)     fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)     ((void)(tag))
+#define ESP_LOGD(tag, fmt, ...)     ((void)(tag))
@@ -0,0 +1,97 @@
+/**
+ * @file opus.h
+ * @brief Just enough of libopus to build and run the Opus path of ws_audio_codec.c on a host
+ *
+ * Packets are a fixed share of the bitrate filled with a counter, not
+ * audio; the tests only check that frames come out and are framed right.
+ */
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int32_t opus_int32;
+typedef int16_t opus_int16;
+
+#define OPUS_OK                                 0
+#define OPUS_BAD_ARG                            -1
+#define OPUS_BUFFER_TOO_SMALL                   -2
+#define OPUS_ALLOC_FAIL                         -7
+
+#define OPUS_APPLICATION_RESTRICTED_LOWDELAY    2051
+
+#define OPUS_SET_BITRATE_REQUEST                4002
+#define OPUS_SET_COMPLEXITY_REQUEST             4010
+#define OPUS_SET_BITRATE(x)                     OPUS_SET_BITRATE_REQUEST, (opus_int32)(x)
+#define OPUS_SET_COMPLEXITY(x)                  OPUS_SET_COMPLEXITY_REQUEST, (opus_int32)(x)
+
+typedef struct OpusEncoder {
+    opus_int32 sample_rate;
+    int channels;
+    opus_int32 bitrate;
+    uint8_t seq;
+} OpusEncoder;
+
+static inline OpusEncoder *opus_encoder_create(opus_int32 fs, int channels, int application, int *error)
+{
+    OpusEncoder *st;
+
+    if ((fs != 8000 && fs != 12000 && fs != 16000 && fs != 24000 && fs != 48000) ||
+            channels < 1 || channels > 2 || application != OPUS_APPLICATION_RESTRICTED_LOWDELAY) {
+        *error = OPUS_BAD_ARG;
+        return NULL;
+    }
+    st = calloc(1, sizeof(*st));
+    if (!st) {
+        *error = OPUS_ALLOC_FAIL;
+        return NULL;
+    }
+    st->sample_rate = fs;
+    st->channels = channels;
+    st->bitrate = 64000;
+    *error = OPUS_OK;
+    return st;
+}
+
+static inline void opus_encoder_destroy(OpusEncoder *st)
+{
+    free(st);
+}
+
+static inline int opus_encoder_ctl(OpusEncoder *st, int request, ...)
+{
+    va_list ap;
+    opus_int32 value;
+
+    va_start(ap, request);
+    value = va_arg(ap, opus_int32);
+    va_end(ap);
+    if (request == OPUS_SET_BITRATE_REQUEST) {
+        st->bitrate = value;
+    } else if (request != OPUS_SET_COMPLEXITY_REQUEST) {
+        return OPUS_BAD_ARG;
+    }
+    return OPUS_OK;
+}
+
+static inline opus_int32 opus_encode(OpusEncoder *st, const opus_int16 *pcm, int frame_size,
+                                     unsigned char *data, opus_int32 max_data_bytes)
+{
+    opus_int32 len = (opus_int32)((int64_t)st->bitrate * frame_size / st->sample_rate / 8);
+
+    if (frame_size * 400 != st->sample_rate && frame_size * 200 != st->sample_rate &&
+            frame_size * 100 != st->sample_rate) {
+        return OPUS_BAD_ARG;
+    }
+    if (len < 1) {
+        len = 1;
+    }
+    if (len > max_data_bytes) {
+        return OPUS_BUFFER_TOO_SMALL;
+    }
+    memset(data, st->seq++, (size_t)len);
+    return len;
+}
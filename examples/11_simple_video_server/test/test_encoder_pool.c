@@ -0,0 +1,304 @@
+/**
+ * @file test_encoder_pool.c
+ * @brief Encoder output pool sizing on the host
+ *
+ * The encoder's allocator is replaced by malloc with a byte count and a
+ * switch to make it fail, so the tests see every buffer the pool
+ * allocates and frees. Frames are recorded in whole windows of 32.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "example_encoder_pool.h"
+#include "example_encoder_priv.h"
+
+#define POOL_WINDOW         32
+#define POOL_IN_SIZE        (640 * 480 * 2)             // YUV422 VGA, the uncompressed frame
+#define POOL_OUT_SIZE       (POOL_IN_SIZE * 3 / 4)      // The encoder's default output size
+#define POOL_MIN_SIZE       4096                        // Below every frame the tests record
+
+typedef struct {
+    uint32_t out_size;
+    uint32_t in_size;
+} fake_encoder_t;
+
+static fake_encoder_t s_encoder = { POOL_OUT_SIZE, POOL_IN_SIZE };
+static example_encoder_pool_handle_t s_pool;
+static int s_live_allocs;
+static bool s_alloc_fails;
+
+esp_err_t example_encoder_output_alloc(uint32_t request_size, uint8_t **buf, uint32_t *size)
+{
+    if (s_alloc_fails) {
+        return ESP_ERR_NO_MEM;
+    }
+    *buf = malloc(request_size);
+    TEST_ASSERT_NOT_NULL(*buf);
+    *size = request_size;
+    s_live_allocs++;
+    return ESP_OK;
+}
+
+void example_encoder_output_free(uint8_t *buf)
+{
+    free(buf);
+    s_live_allocs--;
+}
+
+void example_encoder_get_buffer_sizes(example_encoder_handle_t handle, uint32_t *out_size, uint32_t *in_size)
+{
+    fake_encoder_t *encoder = (fake_encoder_t *)handle;
+
+    *out_size = encoder->out_size;
+    *in_size = encoder->in_size;
+}
+
+void setUp(void)
+{
+    s_live_allocs = 0;
+    s_alloc_fails = false;
+    s_pool = NULL;
+}
+
+void tearDown(void)
+{
+    if (s_pool) {
+        TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_delete(s_pool));
+    }
+    TEST_ASSERT_EQUAL(0, s_live_allocs);
+}
+
+static void create_pool(uint32_t buffer_count, uint32_t min_size)
+{
+    example_encoder_pool_config_t config = {
+        .buffer_count = buffer_count,
+        .min_size = min_size,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_create(&s_encoder, &config, &s_pool));
+}
+
+static example_encoder_pool_stats_t pool_stats(void)
+{
+    example_encoder_pool_stats_t stats;
+
+    example_encoder_pool_get_stats(s_pool, &stats);
+    return stats;
+}
+
+static void record_frames(uint32_t frame_size, int frames)
+{
+    for (int i = 0; i < frames; i++) {
+        example_encoder_pool_record(s_pool, frame_size);
+    }
+}
+
+/** 128-byte aligned size of a frame plus the default 50% headroom */
+static uint32_t fitted(uint32_t frame_size)
+{
+    return (frame_size * 3 / 2 + 127) & ~127u;
+}
+
+static void test_buffers_are_allocated_on_first_use_and_kept(void)
+{
+    uint8_t *a, *b, *c;
+    uint32_t size;
+
+    create_pool(2, 0);
+    TEST_ASSERT_EQUAL(0, s_live_allocs);
+    TEST_ASSERT_EQUAL(POOL_OUT_SIZE, pool_stats().target_size);
+    TEST_ASSERT_EQUAL(POOL_IN_SIZE, pool_stats().max_size);
+
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &a, &size));
+    TEST_ASSERT_EQUAL(POOL_OUT_SIZE, size);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, a));
+
+    // The allocated buffer comes back rather than a second one
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &b, &size));
+    TEST_ASSERT_EQUAL_PTR(a, b);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &c, &size));
+    TEST_ASSERT_EQUAL(2, s_live_allocs);
+    TEST_ASSERT_EQUAL(2, pool_stats().in_use);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, example_encoder_pool_get(s_pool, &a, &size));
+
+    // Still handed out
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, example_encoder_pool_delete(s_pool));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, example_encoder_pool_put(s_pool, (uint8_t *)&size));
+
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, b));
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, c));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, example_encoder_pool_put(s_pool, c));
+    TEST_ASSERT_EQUAL(2, s_live_allocs);
+}
+
+static void test_shrinks_to_the_frames(void)
+{
+    uint8_t *buf;
+    uint32_t size;
+
+    create_pool(1, POOL_MIN_SIZE);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &buf, &size));
+
+    record_frames(20000, POOL_WINDOW);
+    TEST_ASSERT_EQUAL(fitted(20000), pool_stats().target_size);
+    TEST_ASSERT_EQUAL(20000, pool_stats().largest_frame);
+
+    // Refitted while handed out
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_fit(s_pool, &buf, &size));
+    TEST_ASSERT_EQUAL(fitted(20000), size);
+    TEST_ASSERT_EQUAL(1, pool_stats().shrinks);
+    TEST_ASSERT_EQUAL(0, pool_stats().grows);
+    TEST_ASSERT_EQUAL(1, pool_stats().buffers);
+    TEST_ASSERT_EQUAL(size, pool_stats().allocated_bytes);
+
+    // Up to twice the target is kept
+    record_frames(12000, 2 * POOL_WINDOW);
+    TEST_ASSERT_EQUAL(fitted(12000), pool_stats().target_size);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_fit(s_pool, &buf, &size));
+    TEST_ASSERT_EQUAL(fitted(20000), size);
+    TEST_ASSERT_EQUAL(1, pool_stats().shrinks);
+
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, buf));
+}
+
+static void test_grows_when_a_frame_outgrows_the_buffer(void)
+{
+    uint8_t *buf;
+    uint32_t size;
+
+    create_pool(1, POOL_MIN_SIZE);
+    record_frames(10000, POOL_WINDOW);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &buf, &size));
+    TEST_ASSERT_EQUAL(fitted(10000), size);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, buf));
+
+    // One large frame is enough, the next get reallocates
+    example_encoder_pool_record(s_pool, 40000);
+    TEST_ASSERT_EQUAL(fitted(40000), pool_stats().target_size);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &buf, &size));
+    TEST_ASSERT_EQUAL(fitted(40000), size);
+    TEST_ASSERT_EQUAL(1, pool_stats().grows);
+    TEST_ASSERT_EQUAL(1, s_live_allocs);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, buf));
+}
+
+static void test_large_frame_is_held_for_two_windows(void)
+{
+    create_pool(1, POOL_MIN_SIZE);
+
+    example_encoder_pool_record(s_pool, 50000);
+    record_frames(10000, POOL_WINDOW - 1);
+    TEST_ASSERT_EQUAL(fitted(50000), pool_stats().target_size);
+
+    // The next window still sees it as the previous window's largest
+    record_frames(10000, POOL_WINDOW - 1);
+    TEST_ASSERT_EQUAL(fitted(50000), pool_stats().target_size);
+    example_encoder_pool_record(s_pool, 10000);
+    TEST_ASSERT_EQUAL(fitted(10000), pool_stats().target_size);
+    TEST_ASSERT_EQUAL(50000, pool_stats().largest_frame);
+}
+
+static void test_overflow_doubles_up_to_the_frame_size(void)
+{
+    uint32_t target;
+
+    create_pool(1, POOL_MIN_SIZE);
+    record_frames(10000, POOL_WINDOW);
+    target = pool_stats().target_size;
+
+    example_encoder_pool_record(s_pool, EXAMPLE_ENCODER_POOL_OVERFLOW);
+    TEST_ASSERT_EQUAL(1, pool_stats().overflows);
+    TEST_ASSERT_UINT32_WITHIN(128, 2 * target, pool_stats().target_size);
+    TEST_ASSERT_GREATER_OR_EQUAL(2 * target, pool_stats().target_size);
+    // An overflow is not a frame
+    TEST_ASSERT_EQUAL(10000, pool_stats().largest_frame);
+
+    for (int i = 0; i < 8; i++) {
+        example_encoder_pool_record(s_pool, EXAMPLE_ENCODER_POOL_OVERFLOW);
+    }
+    TEST_ASSERT_EQUAL(9, pool_stats().overflows);
+    TEST_ASSERT_EQUAL(POOL_IN_SIZE, pool_stats().target_size);
+
+    // Held for two windows like a frame of that size, then back to the frames
+    record_frames(10000, 2 * POOL_WINDOW);
+    TEST_ASSERT_EQUAL(fitted(10000), pool_stats().target_size);
+}
+
+static void test_target_is_clamped(void)
+{
+    // 1/16 of the encoder's output size without a min_size
+    create_pool(1, 0);
+
+    record_frames(1000, POOL_WINDOW);
+    TEST_ASSERT_EQUAL(POOL_OUT_SIZE / 16, pool_stats().target_size);
+
+    record_frames(POOL_IN_SIZE, 1);
+    TEST_ASSERT_EQUAL(POOL_IN_SIZE, pool_stats().target_size);
+}
+
+static void test_peak_tracks_the_most_bytes_allocated(void)
+{
+    uint8_t *a, *b;
+    uint32_t a_size, b_size;
+
+    create_pool(2, POOL_MIN_SIZE);
+    record_frames(10000, POOL_WINDOW);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &a, &a_size));
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &b, &b_size));
+    TEST_ASSERT_EQUAL(2 * fitted(10000), pool_stats().allocated_bytes);
+    TEST_ASSERT_EQUAL(2 * fitted(10000), pool_stats().peak_bytes);
+
+    example_encoder_pool_record(s_pool, 30000);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_fit(s_pool, &a, &a_size));
+    TEST_ASSERT_EQUAL(fitted(10000) + fitted(30000), pool_stats().peak_bytes);
+
+    // Shrinking frees bytes but leaves the peak
+    record_frames(10000, 2 * POOL_WINDOW);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_fit(s_pool, &a, &a_size));
+    TEST_ASSERT_EQUAL(2 * fitted(10000), pool_stats().allocated_bytes);
+    TEST_ASSERT_EQUAL(fitted(10000) + fitted(30000), pool_stats().peak_bytes);
+
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, a));
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, b));
+}
+
+static void test_failed_refit_keeps_the_old_buffer(void)
+{
+    uint8_t *buf, *old;
+    uint32_t size;
+
+    create_pool(1, POOL_MIN_SIZE);
+    record_frames(10000, POOL_WINDOW);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_get(s_pool, &buf, &size));
+    old = buf;
+    memset(buf, 0x5A, size);
+
+    example_encoder_pool_record(s_pool, 30000);
+    s_alloc_fails = true;
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, example_encoder_pool_fit(s_pool, &buf, &size));
+    TEST_ASSERT_EQUAL_PTR(old, buf);
+    TEST_ASSERT_EQUAL(fitted(10000), size);
+    TEST_ASSERT_EQUAL_HEX8(0x5A, buf[size - 1]);
+    TEST_ASSERT_EQUAL(0, pool_stats().grows);
+
+    s_alloc_fails = false;
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_fit(s_pool, &buf, &size));
+    TEST_ASSERT_EQUAL(fitted(30000), size);
+    TEST_ASSERT_EQUAL(ESP_OK, example_encoder_pool_put(s_pool, buf));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_buffers_are_allocated_on_first_use_and_kept);
+    RUN_TEST(test_shrinks_to_the_frames);
+    RUN_TEST(test_grows_when_a_frame_outgrows_the_buffer);
+    RUN_TEST(test_large_frame_is_held_for_two_windows);
+    RUN_TEST(test_overflow_doubles_up_to_the_frame_size);
+    RUN_TEST(test_target_is_clamped);
+    RUN_TEST(test_peak_tracks_the_most_bytes_allocated);
+    RUN_TEST(test_failed_refit_keeps_the_old_buffer);
+    return UNITY_END();
+}
@@ -0,0 +1,273 @@
+/**
+ * @file test_jpeg_sched.c
+ * @brief JPEG job scheduler ordering and still-job gaps on the host
+ *
+ * Jobs sleep instead of encoding; the scheduler runs on the pthread
+ * FreeRTOS stand-in of the bench. The timing tests leave several
+ * milliseconds of margin either way.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "example_jpeg_sched.h"
+
+#define ORDER_MAX   16
+
+static example_jpeg_sched_handle_t s_sched;
+static SemaphoreHandle_t s_lock;
+static char s_order[ORDER_MAX + 1];
+static int s_order_len;
+
+typedef struct {
+    char name;
+    uint32_t run_us;
+    SemaphoreHandle_t gate;     // Job blocks on it when set
+} job_arg_t;
+
+typedef struct {
+    example_jpeg_prio_t prio;
+    job_arg_t job;
+    esp_err_t result;
+    SemaphoreHandle_t done;
+} submit_arg_t;
+
+typedef struct {
+    int frames;
+    uint32_t period_us;
+    uint32_t run_us;
+    SemaphoreHandle_t done;
+} stream_arg_t;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void setUp(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    memset(s_order, 0, sizeof(s_order));
+    s_order_len = 0;
+}
+
+void tearDown(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, example_jpeg_sched_delete(s_sched));
+    vSemaphoreDelete(s_lock);
+}
+
+static void create_sched(uint32_t still_max_wait_ms)
+{
+    example_jpeg_sched_config_t config = {
+        .stack_size = 4096,
+        .task_priority = 5,
+        .still_max_wait_ms = still_max_wait_ms,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, example_jpeg_sched_create(&config, &s_sched));
+}
+
+static esp_err_t job_fn(void *ctx)
+{
+    job_arg_t *job = (job_arg_t *)ctx;
+
+    if (job->gate) {
+        xSemaphoreTake(job->gate, portMAX_DELAY);
+    }
+    if (job->run_us) {
+        usleep(job->run_us);
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_order_len < ORDER_MAX) {
+        s_order[s_order_len++] = job->name;
+    }
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+static void submit_task(void *arg)
+{
+    submit_arg_t *submit = (submit_arg_t *)arg;
+
+    submit->result = example_jpeg_sched_run(s_sched, submit->prio, job_fn, &submit->job);
+    xSemaphoreGive(submit->done);
+    vTaskDelete(NULL);
+}
+
+static void submit(submit_arg_t *submit, example_jpeg_prio_t prio, char name, uint32_t run_us)
+{
+    submit->prio = prio;
+    submit->job.name = name;
+    submit->job.run_us = run_us;
+    submit->done = xSemaphoreCreateBinary();
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(submit_task, "submit", 4096, submit, 5, NULL));
+}
+
+static void wait_submitted(submit_arg_t *submit)
+{
+    TEST_ASSERT_EQUAL(pdPASS, xSemaphoreTake(submit->done, 5000));
+    TEST_ASSERT_EQUAL(ESP_OK, submit->result);
+    vSemaphoreDelete(submit->done);
+}
+
+/** Submit a frame every period_us, each taking run_us */
+static void stream_task(void *arg)
+{
+    stream_arg_t *stream = (stream_arg_t *)arg;
+    job_arg_t job = { .name = 'L', .run_us = stream->run_us };
+    int64_t next_us = now_us();
+
+    for (int i = 0; i < stream->frames; i++) {
+        example_jpeg_sched_run(s_sched, EXAMPLE_JPEG_PRIO_LIVE, job_fn, &job);
+        next_us += stream->period_us;
+        int64_t left_us = next_us - now_us();
+        if (left_us > 0) {
+            usleep((useconds_t)left_us);
+        }
+    }
+    xSemaphoreGive(stream->done);
+    vTaskDelete(NULL);
+}
+
+static void test_runs_by_priority_then_fifo(void)
+{
+    submit_arg_t gate = { 0 }, jobs[5] = { 0 };
+
+    create_sched(0);
+
+    // Hold the worker in a job while the others queue up behind it
+    gate.job.gate = xSemaphoreCreateBinary();
+    submit(&gate, EXAMPLE_JPEG_PRIO_LIVE, 'g', 0);
+    usleep(20000);
+    submit(&jobs[0], EXAMPLE_JPEG_PRIO_STILL, 's', 0);
+    usleep(5000);
+    submit(&jobs[1], EXAMPLE_JPEG_PRIO_PREVIEW, 'p', 0);
+    usleep(5000);
+    submit(&jobs[2], EXAMPLE_JPEG_PRIO_LIVE, 'a', 0);
+    usleep(5000);
+    submit(&jobs[3], EXAMPLE_JPEG_PRIO_LIVE, 'b', 0);
+    usleep(5000);
+    submit(&jobs[4], EXAMPLE_JPEG_PRIO_PREVIEW, 'q', 0);
+    usleep(20000);
+
+    xSemaphoreGive(gate.job.gate);
+    wait_submitted(&gate);
+    for (int i = 0; i < 5; i++) {
+        wait_submitted(&jobs[i]);
+    }
+    vSemaphoreDelete(gate.job.gate);
+
+    TEST_ASSERT_EQUAL_STRING("gabpqs", s_order);
+
+    example_jpeg_sched_stats_t stats;
+    example_jpeg_sched_get_stats(s_sched, &stats);
+    TEST_ASSERT_EQUAL(3, stats.jobs[EXAMPLE_JPEG_PRIO_LIVE]);
+    TEST_ASSERT_EQUAL(2, stats.jobs[EXAMPLE_JPEG_PRIO_PREVIEW]);
+    TEST_ASSERT_EQUAL(1, stats.jobs[EXAMPLE_JPEG_PRIO_STILL]);
+    TEST_ASSERT_EQUAL(5, stats.max_queued);
+}
+
+static void test_still_job_waits_for_a_gap(void)
+{
+    stream_arg_t stream = { .frames = 30, .period_us = 40000, .run_us = 10000 };
+    submit_arg_t still = { 0 };
+    example_jpeg_sched_stats_t stats;
+
+    create_sched(2000);
+    stream.done = xSemaphoreCreateBinary();
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(stream_task, "stream", 4096, &stream, 5, NULL));
+
+    // Let the scheduler learn the frame interval, then ask at an awkward moment
+    usleep(8 * 40000 + 33000);
+    submit(&still, EXAMPLE_JPEG_PRIO_STILL, 'S', 15000);
+    wait_submitted(&still);
+
+    TEST_ASSERT_EQUAL(pdPASS, xSemaphoreTake(stream.done, 5000));
+    vSemaphoreDelete(stream.done);
+
+    example_jpeg_sched_get_stats(s_sched, &stats);
+    TEST_ASSERT_EQUAL(30, stats.jobs[EXAMPLE_JPEG_PRIO_LIVE]);
+    TEST_ASSERT_EQUAL(1, stats.jobs[EXAMPLE_JPEG_PRIO_STILL]);
+    TEST_ASSERT_EQUAL(0, stats.still_forced);
+    TEST_ASSERT_TRUE(stats.interval_avg_us[EXAMPLE_JPEG_PRIO_LIVE] > 35000);
+    // A still job in the way would have held a frame for up to 15 ms
+    TEST_ASSERT_TRUE(stats.wait_max_us[EXAMPLE_JPEG_PRIO_LIVE] < 6000);
+}
+
+static void test_still_job_runs_after_max_wait(void)
+{
+    stream_arg_t stream = { .frames = 40, .period_us = 20000, .run_us = 15000 };
+    submit_arg_t still = { 0 };
+    example_jpeg_sched_stats_t stats;
+
+    create_sched(200);
+    stream.done = xSemaphoreCreateBinary();
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(stream_task, "stream", 4096, &stream, 5, NULL));
+
+    // 5 ms gaps never fit a 15 ms still job
+    usleep(8 * 20000);
+    int64_t start_us = now_us();
+    submit(&still, EXAMPLE_JPEG_PRIO_STILL, 'S', 15000);
+    wait_submitted(&still);
+    int64_t took_us = now_us() - start_us;
+
+    TEST_ASSERT_EQUAL(pdPASS, xSemaphoreTake(stream.done, 5000));
+    vSemaphoreDelete(stream.done);
+
+    example_jpeg_sched_get_stats(s_sched, &stats);
+    TEST_ASSERT_EQUAL(1, stats.still_forced);
+    TEST_ASSERT_TRUE(took_us >= 200000 && took_us < 400000);
+}
+
+static void test_still_job_never_forced_without_max_wait(void)
+{
+    stream_arg_t stream = { .frames = 20, .period_us = 20000, .run_us = 15000 };
+    submit_arg_t still = { 0 };
+    example_jpeg_sched_stats_t stats;
+
+    create_sched(0);
+    stream.done = xSemaphoreCreateBinary();
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(stream_task, "stream", 4096, &stream, 5, NULL));
+
+    // 5 ms gaps never fit a 15 ms still job: it waits for the stream to stop
+    usleep(8 * 20000);
+    int64_t start_us = now_us();
+    submit(&still, EXAMPLE_JPEG_PRIO_STILL, 'S', 15000);
+    wait_submitted(&still);
+    int64_t took_us = now_us() - start_us;
+
+    TEST_ASSERT_EQUAL(pdPASS, xSemaphoreTake(stream.done, 5000));
+    vSemaphoreDelete(stream.done);
+
+    example_jpeg_sched_get_stats(s_sched, &stats);
+    TEST_ASSERT_EQUAL(20, stats.jobs[EXAMPLE_JPEG_PRIO_LIVE]);
+    TEST_ASSERT_EQUAL(0, stats.still_forced);
+    // The remaining 12 frames, then two intervals for the stream to go stale
+    TEST_ASSERT_TRUE(took_us >= 11 * 20000);
+    TEST_ASSERT_TRUE(stats.wait_max_us[EXAMPLE_JPEG_PRIO_LIVE] < 6000);
+}
+
+static void test_rejects_bad_jobs(void)
+{
+    create_sched(0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, example_jpeg_sched_run(s_sched, EXAMPLE_JPEG_PRIO_LIVE, NULL, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, example_jpeg_sched_run(s_sched, EXAMPLE_JPEG_PRIO_COUNT, job_fn, NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_runs_by_priority_then_fifo);
+    RUN_TEST(test_still_job_waits_for_a_gap);
+    RUN_TEST(test_still_job_runs_after_max_wait);
+    RUN_TEST(test_still_job_never_forced_without_max_wait);
+    RUN_TEST(test_rejects_bad_jobs);
+    return UNITY_END();
+}
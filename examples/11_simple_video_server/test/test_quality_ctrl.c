@@ -0,0 +1,342 @@
+/**
+ * @file test_quality_ctrl.c
+ * @brief Quality controller against scripted links
+ *
+ * A deterministic simulation: a 30 fps source, frames whose size grows
+ * with the quality, one client that always sends the newest published
+ * frame and a link whose bandwidth follows a script. Time only moves in
+ * the simulation, so every run makes the same decisions.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "quality_ctrl.h"
+
+#define SIM_FRAME_US        33333
+#define SIM_ENCODE_US       5000
+#define SIM_HISTORY         16
+
+typedef struct {
+    int64_t until_us;
+    uint32_t bytes_per_s;
+} sim_phase_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t bytes;
+    int64_t capture_us;
+    int64_t publish_us;
+} sim_frame_t;
+
+typedef struct {
+    quality_ctrl_t ctrl;
+    const sim_phase_t *script;
+    sim_frame_t frames[SIM_HISTORY];
+    uint32_t published;             // Last published seq
+    uint32_t client_seq;            // Last seq the client read
+    int64_t client_free_us;
+    uint64_t sent_bytes;            // In the current window
+    uint32_t sent_frames;
+    uint32_t max_latency_us;
+} sim_t;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/** Encoded size at a quality, growing faster towards the top like JPEG */
+static uint32_t sim_frame_bytes(uint8_t quality)
+{
+    return 4000 + 8u * quality * quality;
+}
+
+static uint32_t sim_bandwidth(const sim_t *sim, int64_t t_us)
+{
+    const sim_phase_t *phase = sim->script;
+
+    while (phase->until_us && t_us >= phase->until_us) {
+        phase++;
+    }
+    return phase->bytes_per_s;
+}
+
+static void sim_init(sim_t *sim, const sim_phase_t *script, uint32_t target_bytes_per_s)
+{
+    quality_ctrl_config_t config = {
+        .target_bytes_per_s = target_bytes_per_s,
+        .target_latency_us = 200000,
+        .min_quality = 20,
+        .max_quality = 90,
+        .initial_quality = 80,
+        .max_skip = 3,
+    };
+
+    memset(sim, 0, sizeof(*sim));
+    sim->script = script;
+    quality_ctrl_init(&sim->ctrl, &config);
+}
+
+/** Newest unread frame published by @p t_us */
+static const sim_frame_t *sim_newest(const sim_t *sim, int64_t t_us)
+{
+    const sim_frame_t *found = NULL;
+
+    for (int i = 0; i < SIM_HISTORY; i++) {
+        const sim_frame_t *f = &sim->frames[i];
+        if (f->seq > sim->client_seq && f->publish_us <= t_us && (!found || f->seq > found->seq)) {
+            found = f;
+        }
+    }
+    return found;
+}
+
+/** First unread frame published after @p t_us */
+static const sim_frame_t *sim_next(const sim_t *sim, int64_t t_us)
+{
+    const sim_frame_t *found = NULL;
+
+    for (int i = 0; i < SIM_HISTORY; i++) {
+        const sim_frame_t *f = &sim->frames[i];
+        if (f->seq > sim->client_seq && f->publish_us > t_us && (!found || f->seq < found->seq)) {
+            found = f;
+        }
+    }
+    return found;
+}
+
+/** Let the client send everything it can start before @p t_us */
+static void sim_client(sim_t *sim, int64_t t_us)
+{
+    while (sim->client_free_us < t_us) {
+        int64_t start = sim->client_free_us;
+        const sim_frame_t *f = sim_newest(sim, start);
+
+        if (!f) {
+            // Idle: the next frame goes out as soon as it is published
+            f = sim_next(sim, start);
+            if (!f || f->publish_us >= t_us) {
+                return;
+            }
+            start = f->publish_us;
+        }
+
+        uint32_t send_us = (uint32_t)((uint64_t)f->bytes * 1000000 / sim_bandwidth(sim, start));
+        sim->client_free_us = start + send_us;
+        sim->client_seq = f->seq;
+        uint32_t latency_us = (uint32_t)(sim->client_free_us - f->capture_us);
+        quality_ctrl_on_sent(&sim->ctrl, 0, f->bytes, send_us, latency_us);
+        sim->sent_bytes += f->bytes;
+        sim->sent_frames++;
+        if (latency_us > sim->max_latency_us) {
+            sim->max_latency_us = latency_us;
+        }
+    }
+}
+
+/** Run until @p until_us, resetting the window counters first */
+static void sim_run(sim_t *sim, int64_t from_us, int64_t until_us)
+{
+    sim->sent_bytes = 0;
+    sim->sent_frames = 0;
+    sim->max_latency_us = 0;
+
+    for (int64_t t = from_us; t < until_us; t += SIM_FRAME_US) {
+        sim_client(sim, t);
+        quality_ctrl_on_capture(&sim->ctrl, t);
+        if (quality_ctrl_begin_frame(&sim->ctrl, sim->published - sim->client_seq)) {
+            uint32_t bytes = sim_frame_bytes(sim->ctrl.quality);
+            sim_frame_t *f = &sim->frames[++sim->published % SIM_HISTORY];
+
+            quality_ctrl_on_encoded(&sim->ctrl, bytes);
+            f->seq = sim->published;
+            f->bytes = bytes;
+            f->capture_us = t;
+            f->publish_us = t + SIM_ENCODE_US;
+        }
+    }
+    sim_client(sim, until_us);
+}
+
+static const sim_phase_t s_wifi_script[] = {
+    { 10000000, 2000000 },      // Good link, the bitrate target limits
+    { 20000000, 500000 },       // Link degrades below the target
+    { 24000000, 100000 },       // Near outage
+    { 0,        1500000 },      // Recovers
+};
+
+static void test_holds_target_bitrate_on_a_good_link(void)
+{
+    static sim_t sim;
+
+    sim_init(&sim, s_wifi_script, 1000000);
+    sim_run(&sim, 0, 4000000);          // Settle
+    sim_run(&sim, 4000000, 10000000);
+
+    double rate = sim.sent_bytes / 6.0;
+    TEST_ASSERT_TRUE(rate <= 1100000 && rate >= 700000);
+    TEST_ASSERT_EQUAL(0, sim.ctrl.skip);
+    TEST_ASSERT_TRUE(sim.ctrl.quality >= 45 && sim.ctrl.quality <= 70);
+    TEST_ASSERT_TRUE(sim.sent_frames >= 29 * 6);
+    TEST_ASSERT_TRUE(sim.max_latency_us < 200000);
+}
+
+static void test_follows_the_link_down_and_back(void)
+{
+    static sim_t sim;
+
+    sim_init(&sim, s_wifi_script, 1000000);
+    sim_run(&sim, 0, 10000000);
+    uint8_t good_quality = sim.ctrl.quality;
+
+    // Degraded link: quality drops within three seconds and latency recovers
+    sim_run(&sim, 10000000, 13000000);
+    TEST_ASSERT_TRUE(sim.ctrl.quality < good_quality - 10);
+    sim_run(&sim, 13000000, 20000000);
+    TEST_ASSERT_TRUE(sim.sent_bytes / 7.0 <= 500000);
+    TEST_ASSERT_TRUE(sim.ctrl.latency_us < 200000);
+    TEST_ASSERT_EQUAL(0, sim.ctrl.skip);
+
+    // Near outage: even the minimum quality is too big, frames are skipped
+    sim_run(&sim, 20000000, 24000000);
+    TEST_ASSERT_EQUAL(20, sim.ctrl.quality);
+    TEST_ASSERT_TRUE(sim.ctrl.skip > 0);
+    TEST_ASSERT_TRUE(sim.ctrl.skipped > 0);
+
+    // Recovery: stop skipping first, then climb back
+    sim_run(&sim, 24000000, 34000000);
+    TEST_ASSERT_EQUAL(0, sim.ctrl.skip);
+    TEST_ASSERT_TRUE(sim.ctrl.quality >= 45);
+    TEST_ASSERT_TRUE(sim.ctrl.latency_us < 200000);
+}
+
+static void test_simulation_is_deterministic(void)
+{
+    static sim_t a, b;
+
+    sim_init(&a, s_wifi_script, 1000000);
+    sim_init(&b, s_wifi_script, 1000000);
+    sim_run(&a, 0, 30000000);
+    sim_run(&b, 0, 30000000);
+    TEST_ASSERT_EQUAL(a.ctrl.adjustments, b.ctrl.adjustments);
+    TEST_ASSERT_EQUAL(a.ctrl.quality, b.ctrl.quality);
+    TEST_ASSERT_EQUAL(a.ctrl.skipped, b.ctrl.skipped);
+    TEST_ASSERT_EQUAL(0, memcmp(&a.ctrl, &b.ctrl, sizeof(a.ctrl)));
+}
+
+static void test_queue_backlog_lowers_quality(void)
+{
+    quality_ctrl_t ctrl;
+    quality_ctrl_config_t config = {
+        .target_latency_us = 200000,
+        .min_quality = 20,
+        .max_quality = 90,
+        .initial_quality = 80,
+    };
+
+    // No bitrate target and a fast link: only the backlog says slow down
+    quality_ctrl_init(&ctrl, &config);
+    for (int i = 0; i < 10; i++) {
+        quality_ctrl_on_capture(&ctrl, i * SIM_FRAME_US);
+        TEST_ASSERT_TRUE(quality_ctrl_begin_frame(&ctrl, 0));
+        quality_ctrl_on_encoded(&ctrl, 20000);
+        quality_ctrl_on_sent(&ctrl, 0, 20000, 2000, 10000);
+    }
+    uint8_t before = ctrl.quality;
+    quality_ctrl_on_capture(&ctrl, 10 * SIM_FRAME_US);
+    quality_ctrl_begin_frame(&ctrl, 3);
+    TEST_ASSERT_TRUE(ctrl.quality < before);
+}
+
+static void test_max_quality_is_a_ceiling(void)
+{
+    quality_ctrl_t ctrl;
+    quality_ctrl_config_t config = {
+        .min_quality = 20,
+        .max_quality = 90,
+        .initial_quality = 95,
+    };
+
+    quality_ctrl_init(&ctrl, &config);
+    TEST_ASSERT_EQUAL(90, ctrl.quality);
+    quality_ctrl_set_max_quality(&ctrl, 60);
+    TEST_ASSERT_EQUAL(60, ctrl.quality);
+    quality_ctrl_set_max_quality(&ctrl, 5);
+    TEST_ASSERT_EQUAL(20, ctrl.quality);
+
+    // Headroom never climbs past the ceiling
+    quality_ctrl_set_max_quality(&ctrl, 25);
+    for (int i = 0; i < 100; i++) {
+        quality_ctrl_on_capture(&ctrl, i * SIM_FRAME_US);
+        quality_ctrl_begin_frame(&ctrl, 0);
+        quality_ctrl_on_encoded(&ctrl, 1000);
+    }
+    TEST_ASSERT_EQUAL(25, ctrl.quality);
+}
+
+static void test_budget_follows_the_slowest_client(void)
+{
+    quality_ctrl_t ctrl;
+    quality_ctrl_config_t config = {
+        .min_quality = 20,
+        .max_quality = 90,
+        .initial_quality = 50,
+    };
+
+    // 1 MB/s and 100 kB/s clients: the slow one sets the link, not their sum
+    quality_ctrl_init(&ctrl, &config);
+    for (int i = 0; i < 50; i++) {
+        quality_ctrl_on_sent(&ctrl, 0, 20000, 20000, 30000);
+        quality_ctrl_on_sent(&ctrl, 1, 20000, 200000, 210000);
+    }
+    TEST_ASSERT_UINT32_WITHIN(5000, 100000, ctrl.link_bytes_per_s);
+
+    // Once it leaves, the fast client alone counts
+    quality_ctrl_remove_client(&ctrl, 1);
+    TEST_ASSERT_UINT32_WITHIN(50000, 1000000, ctrl.link_bytes_per_s);
+    quality_ctrl_remove_client(&ctrl, 0);
+    TEST_ASSERT_EQUAL(0, ctrl.link_bytes_per_s);
+
+    // Out of range indices are ignored
+    quality_ctrl_on_sent(&ctrl, QUALITY_CTRL_MAX_CLIENTS, 20000, 2000, 10000);
+    TEST_ASSERT_EQUAL(0, ctrl.link_bytes_per_s);
+}
+
+static void test_capture_drops_count_in_the_interval(void)
+{
+    quality_ctrl_t ctrl;
+    quality_ctrl_config_t config = {
+        .target_bytes_per_s = 600000,
+        .min_quality = 20,
+        .max_quality = 90,
+        .initial_quality = 50,
+    };
+
+    // Every other frame dropped before the encoder: the camera still runs at 30 fps
+    quality_ctrl_init(&ctrl, &config);
+    for (int i = 0; i < 100; i++) {
+        quality_ctrl_on_capture(&ctrl, i * SIM_FRAME_US);
+        if (i % 2 == 0) {
+            quality_ctrl_begin_frame(&ctrl, 0);
+            quality_ctrl_on_encoded(&ctrl, 20000);
+        }
+    }
+    TEST_ASSERT_UINT32_WITHIN(SIM_FRAME_US / 20, SIM_FRAME_US, ctrl.interval_us);
+    TEST_ASSERT_UINT32_WITHIN(1000, 20000, ctrl.budget_bytes);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_holds_target_bitrate_on_a_good_link);
+    RUN_TEST(test_follows_the_link_down_and_back);
+    RUN_TEST(test_simulation_is_deterministic);
+    RUN_TEST(test_queue_backlog_lowers_quality);
+    RUN_TEST(test_max_quality_is_a_ceiling);
+    RUN_TEST(test_budget_follows_the_slowest_client);
+    RUN_TEST(test_capture_drops_count_in_the_interval);
+    return UNITY_END();
+}
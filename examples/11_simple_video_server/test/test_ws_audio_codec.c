@@ -0,0 +1,263 @@
+/**
+ * @file test_ws_audio_codec.c
+ * @brief /ws/stream audio codecs: negotiation, ADPCM quality, whole-frame messages
+ *
+ * Audio goes the way the sender task takes it: pushed into a ws_mux_t set
+ * up for the codec frame, taken as PCM messages and encoded, then decoded
+ * again frame by frame as the browser would.
+ *
+ * test_ws_audio_codec_opus builds the same tests with WS_AUDIO_HAVE_OPUS
+ * against the libopus stand-in in opus_host, so the Opus path at least
+ * compiles and frames its packets right.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+#include "ws_audio_codec.h"
+
+#define SIM_RATE            48000
+#define SIM_FRAME_US        5000
+#define SIM_FRAME_SAMPLES   240
+#define SIM_SECONDS         1
+#define SIM_FIFO_BYTES      (SIM_RATE * 4 / 4)      // 250 ms
+#define SIM_MSG_CAP         (9 + SIM_RATE * 4 * 40 / 1000)
+
+static ws_audio_encoder_t s_enc;
+static ws_mux_t s_mux;
+static uint8_t s_fifo[SIM_FIFO_BYTES];
+static uint8_t s_msg[SIM_MSG_CAP];
+static uint8_t s_coded[8192];
+static int16_t s_in[SIM_RATE * SIM_SECONDS * 2];
+static int16_t s_out[SIM_RATE * SIM_SECONDS * 2];
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void sim_init(ws_audio_codec_t codec)
+{
+    ws_audio_encoder_config_t enc_config = {
+        .codec = codec,
+        .sample_rate = SIM_RATE,
+        .channels = 2,
+        .frame_us = SIM_FRAME_US,
+        .opus_bitrate = 96000,
+        .opus_complexity = 5,
+    };
+    ws_mux_config_t mux_config = {
+        .refresh_hz = 50,
+        .sample_rate = SIM_RATE,
+        .channels = 2,
+        .coalesce_ms = 10,
+        .max_delay_ms = 20,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, ws_audio_encoder_init(&s_enc, &enc_config));
+    TEST_ASSERT_EQUAL(SIM_FRAME_SAMPLES, s_enc.frame_samples);
+    mux_config.frame_samples = s_enc.frame_samples;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_mux_init(&s_mux, &mux_config, s_fifo, sizeof(s_fifo)));
+}
+
+/** Music-like test signal: two tones per channel and a slow sweep */
+static void sim_signal(void)
+{
+    for (int i = 0; i < SIM_RATE * SIM_SECONDS; i++) {
+        double t = (double)i / SIM_RATE;
+
+        s_in[2 * i] = (int16_t)lrint(9000 * sin(2 * M_PI * 440 * t) + 3000 * sin(2 * M_PI * 3100 * t));
+        s_in[2 * i + 1] = (int16_t)lrint(8000 * sin(2 * M_PI * (200 + 2000 * t) * t) + 2000 * sin(2 * M_PI * 7000 * t));
+    }
+}
+
+static double sim_snr_db(uint32_t samples)
+{
+    double signal = 0, noise = 0;
+
+    for (uint32_t i = 0; i < samples * 2; i++) {
+        double d = (double)s_in[i] - s_out[i];
+
+        signal += (double)s_in[i] * s_in[i];
+        noise += d * d;
+    }
+    return 10 * log10(signal / (noise + 1e-9));
+}
+
+/** Decode a coded message into s_out at @p at, checking its layout */
+static uint32_t sim_decode_msg(const uint8_t *msg, uint32_t len, uint32_t at)
+{
+    ws_audio_coded_header_t header;
+    uint32_t pos = sizeof(header);
+
+    memcpy(&header, msg, sizeof(header));
+    TEST_ASSERT_EQUAL_HEX8(WS_MUX_MSG_AUDIO_CODED, header.type);
+    TEST_ASSERT_EQUAL(WS_AUDIO_CODEC_ADPCM, header.codec);
+    TEST_ASSERT_EQUAL(SIM_FRAME_SAMPLES, header.frame_samples);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)((uint64_t)at * 1000 / SIM_RATE), header.timestamp);
+
+    /* Backwards: every frame carries its own decoder state */
+    uint32_t offsets[16];
+    for (uint32_t i = 0; i < header.frame_count; i++) {
+        uint16_t frame_len;
+
+        offsets[i] = pos;
+        memcpy(&frame_len, msg + pos, sizeof(frame_len));
+        TEST_ASSERT_EQUAL(2 * 4 + SIM_FRAME_SAMPLES, frame_len);
+        pos += sizeof(frame_len) + frame_len;
+    }
+    TEST_ASSERT_EQUAL(len, pos);
+    for (uint32_t i = header.frame_count; i-- > 0;) {
+        TEST_ASSERT_EQUAL(ESP_OK, ws_audio_adpcm_decode(msg + offsets[i] + 2, 2 * 4 + SIM_FRAME_SAMPLES, 2,
+                                                        SIM_FRAME_SAMPLES, s_out + 2 * (at + i * SIM_FRAME_SAMPLES)));
+    }
+
+    return header.frame_count * SIM_FRAME_SAMPLES;
+}
+
+static void test_adpcm_round_trip(void)
+{
+    uint32_t pushed = 0, decoded = 0;
+    int64_t wait_us;
+
+    sim_init(WS_AUDIO_CODEC_ADPCM);
+    sim_signal();
+
+    /* 64-frame chunks at their real time, taken whenever the mux offers a message */
+    for (int64_t now_us = 1; decoded < SIM_RATE * SIM_SECONDS - SIM_FRAME_SAMPLES; now_us += 100) {
+        while (pushed + 64 <= SIM_RATE * SIM_SECONDS && (int64_t)(pushed + 64) * 1000000 / SIM_RATE <= now_us) {
+            TEST_ASSERT_EQUAL(ESP_OK, ws_mux_push_audio(&s_mux, now_us, (int64_t)pushed * 1000000 / SIM_RATE,
+                                                        s_in + 2 * pushed, 64));
+            pushed += 64;
+        }
+
+        ws_mux_action_t action = ws_mux_next(&s_mux, now_us, &wait_us);
+        if (action == WS_MUX_AUDIO) {
+            uint32_t len = ws_mux_take_audio(&s_mux, s_msg, sizeof(s_msg));
+            uint32_t coded = ws_audio_encode_msg(&s_enc, s_msg, len, s_coded, sizeof(s_coded));
+
+            TEST_ASSERT_NOT_EQUAL(0, coded);
+            TEST_ASSERT_TRUE(coded <= ws_audio_encoder_max_msg(&s_enc, (len - sizeof(ws_mux_audio_header_t)) / 4));
+            decoded += sim_decode_msg(s_coded, coded, decoded);
+        } else if (action == WS_MUX_VIDEO) {
+            ws_mux_video_frame(&s_mux, false);
+        }
+    }
+
+    /* 4 bits a sample plus 8 header bytes per 5 ms: about 3.9:1 */
+    TEST_ASSERT_EQUAL(decoded / SIM_FRAME_SAMPLES, s_enc.stats.frames);
+    TEST_ASSERT_TRUE(s_enc.stats.coded_bytes * 38 < s_enc.stats.pcm_bytes * 10);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)decoded * 1000000 / SIM_RATE, s_enc.stats.audio_us);
+    TEST_ASSERT_TRUE(sim_snr_db(decoded) > 30.0);
+
+    ws_audio_encoder_deinit(&s_enc);
+}
+
+static void test_mux_hands_over_whole_frames(void)
+{
+    int16_t pcm[2 * 400] = { 0 };
+    int64_t wait_us;
+
+    sim_init(WS_AUDIO_CODEC_ADPCM);
+
+    /* Less than a frame waits, even past max_delay_ms; the ticks still go */
+    TEST_ASSERT_EQUAL(ESP_OK, ws_mux_push_audio(&s_mux, 0, 0, pcm, 100));
+    TEST_ASSERT_EQUAL(WS_MUX_VIDEO, ws_mux_next(&s_mux, 1000, &wait_us));
+    TEST_ASSERT_EQUAL(WS_MUX_VIDEO, ws_mux_next(&s_mux, 30000, &wait_us));
+    TEST_ASSERT_EQUAL(WS_MUX_IDLE, ws_mux_next(&s_mux, 30000, &wait_us));
+    TEST_ASSERT_EQUAL(0, ws_mux_take_audio(&s_mux, s_msg, sizeof(s_msg)));
+
+    /* 400 queued, over max_delay_ms: one frame goes, 160 stay */
+    TEST_ASSERT_EQUAL(ESP_OK, ws_mux_push_audio(&s_mux, 0, 0, pcm, 300));
+    TEST_ASSERT_EQUAL(WS_MUX_AUDIO, ws_mux_next(&s_mux, 30000, &wait_us));
+    TEST_ASSERT_EQUAL(sizeof(ws_mux_audio_header_t) + SIM_FRAME_SAMPLES * 4,
+                      ws_mux_take_audio(&s_mux, s_msg, sizeof(s_msg)));
+    TEST_ASSERT_EQUAL(160 * 4, s_mux.audio_len);
+
+    /* A message that is not whole frames is refused by the encoder */
+    s_msg[5] = 200;
+    TEST_ASSERT_EQUAL(0, ws_audio_encode_msg(&s_enc, s_msg, sizeof(ws_mux_audio_header_t) + 200 * 4,
+                                             s_coded, sizeof(s_coded)));
+
+    ws_audio_encoder_deinit(&s_enc);
+}
+
+static void test_negotiation(void)
+{
+    uint32_t both = WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_OPUS) | WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_ADPCM);
+    bool opus = ws_audio_codec_available() & WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_OPUS);
+
+    TEST_ASSERT_EQUAL(both, ws_audio_codec_parse_offer("opus,adpcm"));
+    TEST_ASSERT_EQUAL(WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_ADPCM), ws_audio_codec_parse_offer("flac,adpcm,"));
+    TEST_ASSERT_EQUAL(0, ws_audio_codec_parse_offer("adpcmx,"));
+    TEST_ASSERT_EQUAL(0, ws_audio_codec_parse_offer(""));
+
+    /* ADPCM unless Opus is both built in and affordable; PCM for an old client */
+    TEST_ASSERT_EQUAL(WS_AUDIO_CODEC_ADPCM, ws_audio_codec_pick(both, false));
+    TEST_ASSERT_EQUAL(opus ? WS_AUDIO_CODEC_OPUS : WS_AUDIO_CODEC_ADPCM, ws_audio_codec_pick(both, true));
+    TEST_ASSERT_EQUAL(WS_AUDIO_CODEC_PCM, ws_audio_codec_pick(WS_AUDIO_CODEC_BIT(WS_AUDIO_CODEC_OPUS), false));
+    TEST_ASSERT_EQUAL(WS_AUDIO_CODEC_PCM, ws_audio_codec_pick(0, true));
+    TEST_ASSERT_EQUAL_STRING("adpcm", ws_audio_codec_name(WS_AUDIO_CODEC_ADPCM));
+}
+
+#ifdef WS_AUDIO_HAVE_OPUS
+static void test_opus_frames(void)
+{
+    int16_t pcm[2 * 2 * SIM_FRAME_SAMPLES] = { 0 };
+    ws_audio_coded_header_t header;
+    int64_t wait_us;
+
+    sim_init(WS_AUDIO_CODEC_OPUS);
+    TEST_ASSERT_NOT_NULL(s_enc.opus);
+    TEST_ASSERT_EQUAL(WS_AUDIO_OPUS_MAX_FRAME, s_enc.max_frame_bytes);
+
+    TEST_ASSERT_EQUAL(ESP_OK, ws_mux_push_audio(&s_mux, 0, 0, pcm, 2 * SIM_FRAME_SAMPLES));
+    TEST_ASSERT_EQUAL(WS_MUX_AUDIO, ws_mux_next(&s_mux, 30000, &wait_us));
+    uint32_t pcm_len = ws_mux_take_audio(&s_mux, s_msg, sizeof(s_msg));
+    uint32_t len = ws_audio_encode_msg(&s_enc, s_msg, pcm_len, s_coded, sizeof(s_coded));
+
+    /* Two length-prefixed packets of 96 kbit/s over 5 ms */
+    memcpy(&header, s_coded, sizeof(header));
+    TEST_ASSERT_EQUAL(WS_AUDIO_CODEC_OPUS, header.codec);
+    TEST_ASSERT_EQUAL(2, header.frame_count);
+    TEST_ASSERT_EQUAL(sizeof(header) + 2 * (2 + 60), len);
+
+    ws_audio_encoder_deinit(&s_enc);
+    TEST_ASSERT_NULL(s_enc.opus);
+}
+#endif
+
+static void test_rejects_bad_config(void)
+{
+    ws_audio_encoder_config_t config = {
+        .codec = WS_AUDIO_CODEC_ADPCM,
+        .sample_rate = SIM_RATE,
+        .channels = 2,
+        .frame_us = 3000,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ws_audio_encoder_init(&s_enc, &config));
+    config.frame_us = 2500;
+    config.sample_rate = 44100;     // 110.25 samples
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ws_audio_encoder_init(&s_enc, &config));
+    config.sample_rate = SIM_RATE;
+    config.codec = WS_AUDIO_CODEC_PCM;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, ws_audio_encoder_init(&s_enc, &config));
+    TEST_ASSERT_EQUAL(9, sizeof(ws_audio_coded_header_t));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_adpcm_round_trip);
+    RUN_TEST(test_mux_hands_over_whole_frames);
+    RUN_TEST(test_negotiation);
+#ifdef WS_AUDIO_HAVE_OPUS
+    RUN_TEST(test_opus_frames);
+#endif
+    RUN_TEST(test_rejects_bad_config);
+    return UNITY_END();
+}
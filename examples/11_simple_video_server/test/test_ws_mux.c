@@ -0,0 +1,279 @@
+/**
+ * @file test_ws_mux.c
+ * @brief /ws/stream pacing, audio coalescing and drops on simulated links
+ *
+ * A deterministic simulation: a producer pushing 48 kHz stereo in small
+ * chunks, a source that always has a new frame and a link that takes
+ * bytes / bandwidth to send each message. Sample values count up, so the
+ * audio that comes out must be the audio that went in, gapless.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "ws_mux.h"
+
+#define SIM_RATE            48000
+#define SIM_CHUNK           64          // Sample frames per push, 1.33 ms
+#define SIM_FIFO_MS         250
+#define SIM_MSG_CAP         8192
+
+typedef struct {
+    ws_mux_t mux;
+    uint8_t fifo[SIM_RATE * 4 * SIM_FIFO_MS / 1000];
+    uint8_t msg[SIM_MSG_CAP];
+    uint32_t link_bytes_per_s;
+    uint32_t frame_bytes;
+    uint64_t pushed;                // Sample frames queued
+    uint64_t received;              // Sample frames sent, checked against their values
+    uint32_t refused;
+    int64_t max_audio_wait_us;      // Sample time to the end of its message
+} sim_t;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void sim_init(sim_t *sim, uint32_t refresh_hz, uint32_t link_bytes_per_s, uint32_t frame_bytes)
+{
+    ws_mux_config_t config = {
+        .refresh_hz = refresh_hz,
+        .sample_rate = SIM_RATE,
+        .channels = 2,
+        .coalesce_ms = 10,
+        .max_delay_ms = 20,
+    };
+
+    memset(sim, 0, sizeof(*sim));
+    sim->link_bytes_per_s = link_bytes_per_s;
+    sim->frame_bytes = frame_bytes;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_mux_init(&sim->mux, &config, sim->fifo, sizeof(sim->fifo)));
+}
+
+static int64_t sim_sample_us(uint64_t sample)
+{
+    return (int64_t)(sample * 1000000 / SIM_RATE);
+}
+
+static int64_t sim_send_us(const sim_t *sim, uint32_t bytes)
+{
+    return (int64_t)bytes * 1000000 / sim->link_bytes_per_s;
+}
+
+/** Queue every chunk produced by now, the producer waits on a full FIFO */
+static void sim_produce(sim_t *sim, int64_t now_us)
+{
+    int16_t pcm[SIM_CHUNK * 2];
+
+    while (sim_sample_us(sim->pushed + SIM_CHUNK) <= now_us) {
+        for (int i = 0; i < SIM_CHUNK; i++) {
+            pcm[2 * i] = pcm[2 * i + 1] = (int16_t)(sim->pushed + i);
+        }
+        if (ws_mux_push_audio(&sim->mux, now_us, sim_sample_us(sim->pushed), pcm, SIM_CHUNK) != ESP_OK) {
+            sim->refused++;
+            return;
+        }
+        sim->pushed += SIM_CHUNK;
+    }
+}
+
+static void sim_check_audio(sim_t *sim, uint32_t len, int64_t sent_us)
+{
+    ws_mux_audio_header_t header;
+    int16_t sample[2];
+
+    memcpy(&header, sim->msg, sizeof(header));
+    TEST_ASSERT_EQUAL(WS_MUX_MSG_AUDIO, header.type);
+    TEST_ASSERT_EQUAL(sizeof(header) + header.sample_count * 4, len);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)(sim_sample_us(sim->received) / 1000), header.timestamp);
+
+    for (uint32_t i = 0; i < header.sample_count; i++) {
+        memcpy(sample, sim->msg + sizeof(header) + i * 4, sizeof(sample));
+        TEST_ASSERT_EQUAL_INT16((int16_t)(sim->received + i), sample[0]);
+        TEST_ASSERT_EQUAL_INT16((int16_t)(sim->received + i), sample[1]);
+    }
+
+    int64_t wait_us = sent_us - sim_sample_us(sim->received);
+    if (wait_us > sim->max_audio_wait_us) {
+        sim->max_audio_wait_us = wait_us;
+    }
+    sim->received += header.sample_count;
+}
+
+static void sim_run(sim_t *sim, int64_t until_us)
+{
+    int64_t now_us = 1;
+    int64_t wait_us;
+
+    while (now_us < until_us) {
+        sim_produce(sim, now_us);
+
+        switch (ws_mux_next(&sim->mux, now_us, &wait_us)) {
+        case WS_MUX_AUDIO: {
+            uint32_t len = ws_mux_take_audio(&sim->mux, sim->msg, sizeof(sim->msg));
+
+            TEST_ASSERT_NOT_EQUAL(0, len);
+            now_us += sim_send_us(sim, len);
+            sim_check_audio(sim, len, now_us);
+            break;
+        }
+        case WS_MUX_VIDEO:
+            if (ws_mux_video_frame(&sim->mux, true)) {
+                now_us += sim_send_us(sim, sizeof(ws_mux_video_header_t) + sim->frame_bytes);
+            }
+            break;
+        default: {
+            int64_t next_chunk_us = sim_sample_us(sim->pushed + SIM_CHUNK);
+
+            TEST_ASSERT_TRUE(wait_us > 0);
+            now_us = now_us + wait_us < next_chunk_us ? now_us + wait_us : next_chunk_us;
+            break;
+        }
+        }
+    }
+}
+
+static void test_paces_video_to_refresh_rate(void)
+{
+    static const uint32_t rates[] = { 50, 60, 71 };
+    sim_t sim;
+
+    for (int i = 0; i < 3; i++) {
+        sim_init(&sim, rates[i], 10000000, 20000);
+        sim_run(&sim, 2000000);
+
+        TEST_ASSERT_UINT32_WITHIN(1, rates[i] * 2, sim.mux.stats.ticks);
+        TEST_ASSERT_EQUAL(sim.mux.stats.ticks, sim.mux.stats.video_sent);
+        TEST_ASSERT_EQUAL(0, sim.mux.stats.late_ticks);
+        TEST_ASSERT_EQUAL(0, sim.mux.stats.video_dropped);
+    }
+}
+
+static void test_coalesces_small_audio_chunks(void)
+{
+    sim_t sim;
+
+    sim_init(&sim, 50, 10000000, 20000);
+    sim_run(&sim, 2000000);
+
+    /* 1500 pushes; 10 ms messages plus the flushes before the 100 frames */
+    TEST_ASSERT_EQUAL(0, sim.refused);
+    TEST_ASSERT_TRUE(sim.pushed - sim.received < SIM_RATE / 50);
+    TEST_ASSERT_TRUE(sim.mux.stats.audio_msgs <= 200 + 100);
+    TEST_ASSERT_TRUE(sim.mux.stats.audio_msgs >= 100);
+    TEST_ASSERT_TRUE(sim.max_audio_wait_us < 25000);
+}
+
+static void test_slow_link_drops_video_not_audio(void)
+{
+    sim_t sim;
+
+    /* The audio alone needs 192 kB/s, 30 kB frames at 50 Hz another 1.5 MB/s */
+    sim_init(&sim, 50, 300000, 30000);
+    sim_run(&sim, 5000000);
+
+    TEST_ASSERT_EQUAL(0, sim.refused);
+    TEST_ASSERT_TRUE(sim.pushed - sim.received < SIM_RATE / 5);
+    TEST_ASSERT_TRUE(sim.max_audio_wait_us < 200000);
+    TEST_ASSERT_TRUE(sim.mux.stats.late_ticks + sim.mux.stats.video_dropped > 0);
+    TEST_ASSERT_TRUE(sim.mux.stats.video_sent < 5 * 50 / 2);
+    /* Video only gets what the audio leaves, give or take the frame in flight at the end */
+    TEST_ASSERT_TRUE((uint64_t)sim.mux.stats.video_sent * 30000 <= 5ull * (300000 - 192000) + 30000);
+}
+
+static void test_audio_goes_before_frame(void)
+{
+    sim_t sim;
+    int16_t pcm[2 * 4] = { 0 };
+    int64_t wait_us;
+
+    sim_init(&sim, 50, 10000000, 20000);
+    TEST_ASSERT_EQUAL(WS_MUX_VIDEO, ws_mux_next(&sim.mux, 1000, &wait_us));
+    TEST_ASSERT_EQUAL(WS_MUX_IDLE, ws_mux_next(&sim.mux, 2000, &wait_us));
+    TEST_ASSERT_EQUAL(19000, wait_us);
+
+    /* Four samples wait for more, up to max_delay_ms */
+    TEST_ASSERT_EQUAL(ESP_OK, ws_mux_push_audio(&sim.mux, 5000, 5000, pcm, 4));
+    TEST_ASSERT_EQUAL(WS_MUX_IDLE, ws_mux_next(&sim.mux, 6000, &wait_us));
+    TEST_ASSERT_EQUAL(15000, wait_us);
+
+    /* The tick comes first and sends them ahead of its frame */
+    TEST_ASSERT_EQUAL(WS_MUX_AUDIO, ws_mux_next(&sim.mux, 21000, &wait_us));
+    TEST_ASSERT_EQUAL(sizeof(ws_mux_audio_header_t) + 16, ws_mux_take_audio(&sim.mux, sim.msg, sizeof(sim.msg)));
+    TEST_ASSERT_EQUAL(WS_MUX_VIDEO, ws_mux_next(&sim.mux, 21000, &wait_us));
+    TEST_ASSERT_FALSE(ws_mux_video_frame(&sim.mux, false));
+    TEST_ASSERT_EQUAL(1, sim.mux.stats.repeats);
+}
+
+static void test_full_fifo_refuses_whole_chunk(void)
+{
+    sim_t sim;
+    int16_t pcm[2 * 1000] = { 0 };
+    uint32_t chunks = sizeof(sim.fifo) / sizeof(pcm);
+
+    sim_init(&sim, 50, 10000000, 20000);
+    for (uint32_t i = 0; i < chunks; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, ws_mux_push_audio(&sim.mux, 0, 0, pcm, 1000));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, ws_mux_push_audio(&sim.mux, 0, 0, pcm, 1000));
+    TEST_ASSERT_EQUAL(chunks * sizeof(pcm), sim.mux.audio_len);
+    TEST_ASSERT_EQUAL(1, sim.mux.stats.audio_refused);
+
+    /* A backlog this large drops the frame of the tick */
+    TEST_ASSERT_FALSE(ws_mux_video_frame(&sim.mux, true));
+    TEST_ASSERT_EQUAL(1, sim.mux.stats.video_dropped);
+
+    TEST_ASSERT_NOT_EQUAL(0, ws_mux_take_audio(&sim.mux, sim.msg, sizeof(sim.msg)));
+    TEST_ASSERT_EQUAL(ESP_OK, ws_mux_push_audio(&sim.mux, 0, 0, pcm, 1000));
+}
+
+static void test_packet_layout(void)
+{
+    ws_mux_video_header_t header;
+    uint8_t raw[sizeof(header)];
+
+    TEST_ASSERT_EQUAL(13, sizeof(ws_mux_video_header_t));
+    TEST_ASSERT_EQUAL(9, sizeof(ws_mux_audio_header_t));
+
+    ws_mux_video_header(&header, 1234567, 0x01020304, 640, 400);
+    memcpy(raw, &header, sizeof(raw));
+    TEST_ASSERT_EQUAL_HEX8(WS_MUX_MSG_VIDEO_JPEG, raw[0]);
+    TEST_ASSERT_EQUAL_HEX8(1234 & 0xff, raw[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x04, raw[5]);
+    TEST_ASSERT_EQUAL_HEX8(640 & 0xff, raw[9]);
+    TEST_ASSERT_EQUAL_HEX8(400 >> 8, raw[12]);
+}
+
+static void test_rejects_bad_config(void)
+{
+    ws_mux_t mux;
+    uint8_t fifo[1024];
+    ws_mux_config_t config = {
+        .refresh_hz = 50,
+        .sample_rate = SIM_RATE,
+        .channels = 2,
+        .coalesce_ms = 10,
+        .max_delay_ms = 20,
+    };
+
+    /* Less than twice max_delay_ms of audio */
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ws_mux_init(&mux, &config, fifo, sizeof(fifo)));
+    config.refresh_hz = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ws_mux_init(&mux, &config, fifo, sizeof(fifo)));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_paces_video_to_refresh_rate);
+    RUN_TEST(test_coalesces_small_audio_chunks);
+    RUN_TEST(test_slow_link_drops_video_not_audio);
+    RUN_TEST(test_audio_goes_before_frame);
+    RUN_TEST(test_full_fifo_refuses_whole_chunk);
+    RUN_TEST(test_packet_layout);
+    RUN_TEST(test_rejects_bad_config);
+    return UNITY_END();
+}